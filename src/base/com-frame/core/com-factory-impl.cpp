@@ -68,6 +68,29 @@ void ComFactoryImpl::InitTimerMgr()
 	LOG_INF("Init timer manager");
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void ComFactoryImpl::InitMetricsRegistry()
+{
+	IUnknown* registry = CreateComponent(CID_METRICS_REGISTRY, "component factory");
+	if (!registry) {
+		LOG_ERR("Create metrics registry failed!");
+		return;
+	}
+
+	m_metrics_registry = (com::IMetricsRegistry*)registry->QueryInterface(
+		IID_METRICS_REGISTRY);
+	if (!m_metrics_registry) {
+		LOG_ERR("QueryInterface iid-metrics-registry failed!");
+		return;
+	}
+
+	m_metrics_registry->Start();
+
+	LOG_INF("Init metrics registry");
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -114,6 +137,8 @@ bool ComFactoryImpl::Init(const std::string& com_path)
 
 	InitTimerMgr(); // Inhold timer manager
 
+	InitMetricsRegistry(); // Inhold metrics registry
+
 	return true;
 }
 
@@ -155,6 +180,10 @@ void* ComFactoryImpl::QueryInterface(const std::string& cid,
 		return m_timer_mgr;
 	}
 
+	if (strcmp(cid.c_str(), CID_METRICS_REGISTRY) == 0 && m_metrics_registry) {
+		return m_metrics_registry;
+	}
+
 	IUnknown* component = CreateComponent(cid, owner);
 	if (!component) {
 		LOG_ERR("Create component {} failed!", cid);
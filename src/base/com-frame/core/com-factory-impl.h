@@ -9,6 +9,7 @@
 #include "component.h"
 
 #include "if-timer-mgr.h"
+#include "if-metrics-registry.h"
 
 namespace jukey::base
 {
@@ -43,6 +44,7 @@ public:
 
 private:
 	void InitTimerMgr();
+	void InitMetricsRegistry();
 	void DumpComObjs();
 	void TryDumpComObjs();
 	void StartDumpTimer();
@@ -60,6 +62,7 @@ private:
 
 	// Global object(singleton)
 	com::ITimerMgr* m_timer_mgr = nullptr;
+	com::IMetricsRegistry* m_metrics_registry = nullptr;
 
 	uint64_t m_last_dump = 0;
 	uint32_t m_accu_count = 0;
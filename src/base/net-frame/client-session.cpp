@@ -1,4 +1,6 @@
-﻿#include "client-session.h"
+﻿#include <algorithm>
+
+#include "client-session.h"
 #include "net-message.h"
 #include "session-mgr.h"
 #include "common/util-time.h"
@@ -175,6 +177,25 @@ void ClientSession::DoUpdate()
   }
 }
 
+//------------------------------------------------------------------------------
+// Keep the same deadlines as DoUpdate
+//------------------------------------------------------------------------------
+uint64_t ClientSession::DoNextUpdateTime()
+{
+  switch (m_sess_state) {
+  case SESSION_STATE_HANDSHAKING:
+    return m_send_handshake_ts + 3 * 1000000;
+  case SESSION_STATE_TRANSPORTING:
+    return std::min(m_last_send_data_ts + m_sess_param.remote_kai * 1000000,
+      m_last_recv_data_ts + 3 * m_sess_param.local_kai * 1000000);
+  case SESSION_STATE_RECONNECTING:
+    return std::min(m_last_send_reconnect_ts + m_sess_param.local_kai * 1000000,
+      m_last_reconnect_ts + 3 * m_sess_param.local_kai * 1000000);
+  default:
+    return INVALID_UPDATE_TIME;
+  }
+}
+
 //------------------------------------------------------------------------------
 // Handshake response
 //------------------------------------------------------------------------------
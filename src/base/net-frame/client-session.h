@@ -22,6 +22,7 @@ public:
 	virtual void DoInit() override;
 	virtual void DoClose() override;
 	virtual void DoUpdate() override;
+	virtual uint64_t DoNextUpdateTime() override;
 	virtual void OnSessionControlMsg(const SessionPktSP& pkt) override;
 
 private:
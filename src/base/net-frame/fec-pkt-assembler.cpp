@@ -4,6 +4,7 @@
 #include "fec-pkt-assembler.h"
 #include "fec-protocol.h"
 #include "common/util-time.h"
+#include "common-config.h"
 #include "fec/luigi-fec-decoder.h"
 #include "log.h"
 
@@ -45,6 +46,8 @@ void FecPktAssembler::InitStats(base::IComFactory* factory)
 	fmt << "[session:" << m_sess_param.local_sid << "] FEC assembler,";
 
 	m_data_stats.reset(new util::DataStats(factory, g_net_logger, fmt.str(), false));
+	m_data_stats->SetMetricsScope("fec_assembler",
+		{ { "session", std::to_string(m_sess_param.local_sid) } });
 	m_data_stats->Start();
 
 	StatsParam i_decode_fail("decode-fail", StatsType::IACCU, 5000);
@@ -79,14 +82,36 @@ void FecPktAssembler::Update()
 {
 	uint64_t now = jukey::util::Now();
 
+	if (m_last_stats_ts + SESSION_STATS_INTERVAL > now) {
+		return;
+	}
+
 	m_lost_pkt_tracer->Update();
-	m_data_stats->OnData(m_i_fec_lost, m_lost_pkt_tracer->GetInfo().lost_count);
+
+	uint32_t lost_count = m_lost_pkt_tracer->GetInfo().lost_count;
+	m_data_stats->OnData(m_i_fec_lost, lost_count);
 
 	m_recv_pkt_tracer->AddPktCount(m_recv_pkt_count, now - m_last_stats_ts);
 	m_last_stats_ts = now;
+
+	// One more update to clear the statistics after received nothing
+	m_stats_pending = (m_recv_pkt_count != 0 || lost_count != 0);
 	m_recv_pkt_count = 0;
 }
 
+//------------------------------------------------------------------------------
+// Idle assembler needs no update
+//------------------------------------------------------------------------------
+uint64_t FecPktAssembler::NextUpdateTime()
+{
+	if (m_stats_pending || m_recv_pkt_count != 0) {
+		return m_last_stats_ts + SESSION_STATS_INTERVAL;
+	}
+	else {
+		return INVALID_UPDATE_TIME;
+	}
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
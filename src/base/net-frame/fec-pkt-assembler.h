@@ -33,6 +33,7 @@ public:
 	~FecPktAssembler();
 
 	void Update();
+	uint64_t NextUpdateTime();
 	void InputFecData(const com::Buffer& buf);
 	bool GetNextSourceData(com::Buffer& buf);
 	AssemblerInfo GetInfo();
@@ -69,6 +70,9 @@ private:
 	uint64_t m_last_stats_ts = 0;
 	uint32_t m_recv_pkt_count = 0;
 
+	// Tracers need more update
+	bool m_stats_pending = false;
+
 	// Statistics
 	util::DataStatsSP m_data_stats;
 	util::StatsId m_i_decode_fail = INVALID_STATS_ID;
@@ -32,13 +32,37 @@ class ISendQueue
 public:
 	virtual ~ISendQueue() {}
 
-	virtual ISendEntrySP GetNextEntry() = 0;
+	//
+	// @brief Wait until some entries are due and take them out, entries with
+	//        invalid send time are dropped
+	// @return false if the queue is stopped
+	//
+	virtual bool GetDueEntries(std::vector<ISendEntrySP>& entries,
+		uint32_t max_count) = 0;
 
+	//
+	// @brief Add entry, or bring forward the send time of existing entry
+	//
 	virtual void AddEntry(ISendEntrySP entry) = 0;
 
 	virtual void RemoveEntry(uint64_t entry_id) = 0;
 
+	//
+	// @brief Add entry if not exists, otherwise bring forward its send time, or
+	//        reset its send time in any direction if force is true
+	//
 	virtual void UpdateEntry(ISendEntrySP entry, bool force) = 0;
+
+	//
+	// @brief UpdateEntry without force for several entries, the sending thread
+	//        is woken up once and finds all of them due together
+	//
+	virtual void UpdateEntries(const std::vector<ISendEntrySP>& entries) = 0;
+
+	//
+	// @brief Wake up and stop the waiting thread
+	//
+	virtual void Stop() = 0;
 };
 
 typedef std::shared_ptr<ISendQueue> ISendQueueSP;
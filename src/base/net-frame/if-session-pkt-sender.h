@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "common-struct.h"
 #include "session-protocol.h"
 
@@ -24,6 +26,10 @@ public:
 	virtual ~ISessionPktSender() {}
 
 	virtual com::ErrCode SendPkt(uint32_t data_type, const com::Buffer& buf) = 0;
+
+	// sent_count: how many leading packets were sent
+	virtual com::ErrCode SendPkts(uint32_t data_type,
+		const std::vector<com::Buffer>& bufs, uint32_t& sent_count) = 0;
 };
 typedef std::shared_ptr<ISessionPktSender> ISessionPktSenderSP;
 
@@ -9,6 +9,8 @@
 namespace jukey::net
 {
 
+#define INVALID_UPDATE_TIME 0xFFFFFFFFFFFFFFFF
+
 //==============================================================================
 // Session parameters
 // kai: keep alive interval
@@ -51,6 +53,12 @@ public:
 	//
 	virtual void OnUpdate() = 0;
 
+	//
+	// Time to call OnUpdate, INVALID_UPDATE_TIME if nothing to do until next
+	// event arrives
+	//
+	virtual uint64_t NextUpdateTime() = 0;
+
 	//
 	// Received session data
 	//
@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include <vector>
+
 #include "if-unknown.h"
 #include "common-struct.h"
 #include "common-enum.h"
@@ -21,6 +23,11 @@ namespace jukey::net
 struct SessionMgrParam
 {
 	uint32_t thread_count = 0;
+	uint32_t udp_shard_count = 0; // 0: no sharding, otherwise session threads
+	                              // run in UDP shards, thread_count is only
+	                              // used by TCP
+	uint32_t udp_recv_pool_size = 0; // receive buffers of each UDP shard, 0
+	                                 // means UDP_RECV_POOL_BUF_CNT
 	uint32_t ka_interval = 0; // second
 	bool reliable = true;     // support reliable session
 	bool unreliable = true;   // support unreliable session
@@ -49,6 +56,18 @@ struct ListenParam
 	util::IThread*   thread = nullptr;
 };
 
+//==============================================================================
+// Data of one session in a batch
+//==============================================================================
+struct SessionData
+{
+	SessionData() {}
+	SessionData(SessionId id, const com::Buffer& b) : sid(id), buf(b) {}
+
+	SessionId sid = INVALID_SESSION_ID;
+	com::Buffer buf;
+};
+
 //==============================================================================
 // Session manager
 //==============================================================================
@@ -100,6 +119,14 @@ public:
 	//
 	virtual com::ErrCode SendData(SessionId sid, const com::Buffer& buf) = 0;
 
+	//
+	// @brief Send data of several sessions, such as a frame fanned out to many
+	//        receivers. Data of sessions in one session thread is posted with
+	//        one message, so their packets go out with one batch send.
+	// @return ERR_CODE_OK:all posted, other:some are not posted
+	//
+	virtual com::ErrCode SendData(const std::vector<SessionData>& datas) = 0;
+
 	//
 	// @brief Set log level
 	// @param level 0:trace, 1:debug, 2:info, 3:warn, 4:error, 5:critical
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <functional>
+#include <cstring>
 #include "common-struct.h"
 #include "common-enum.h"
 #include "if-unknown.h"
@@ -13,6 +16,22 @@ namespace jukey::net
 #define CID_UDP_MGR "cid-udp-mgr"
 #define IID_UDP_MGR "iid-udp-mgr"
 
+//==============================================================================
+// Binary endpoint copied from socket address, IPv4 address is stored as
+// IPv4-mapped IPv6 address. Receiving path uses it to avoid formatting and
+// parsing host string for every datagram.
+//==============================================================================
+struct BinEndpoint
+{
+	uint8_t addr[16] = { 0 };
+	uint16_t port = 0; // host byte order
+
+	bool operator==(const BinEndpoint& ep) const
+	{
+		return port == ep.port && memcmp(addr, ep.addr, sizeof(addr)) == 0;
+	}
+};
+
 //==============================================================================
 // 
 //==============================================================================
@@ -20,14 +39,16 @@ class IUdpHandler
 {
 public:
 	//
-	// @brief Notify received UDP data
+	// @brief Notify received UDP data, called in the event thread of shard
 	// @param sock which socket received data from
-	// @param ep remote endpoint
+	// @param rep remote endpoint
+	// @param shard shard which the socket belongs to
 	// @param buf received data
 	//
 	virtual void OnRecvUdpData(const com::Endpoint& lep, 
-		const com::Endpoint& rep, 
+		const BinEndpoint& rep, 
 		SocketId sock,
+		uint32_t shard,
 		com::Buffer buf) = 0;
 
 	//
@@ -39,7 +60,26 @@ public:
 };
 
 //==============================================================================
-// 
+// Packet of batch sending
+//==============================================================================
+struct UdpPacket
+{
+	UdpPacket() {}
+	UdpPacket(const com::Endpoint& e, const com::Buffer& b) : ep(e), buf(b) {}
+
+	com::Endpoint ep;
+	com::Buffer buf;
+};
+
+//==============================================================================
+// Task running in the event thread of shard
+//==============================================================================
+typedef std::function<void()> UdpShardTask;
+
+//==============================================================================
+// Sockets are served by shards, each shard is an event thread with its own
+// event base. Server socket is replicated on every shard with SO_REUSEPORT,
+// and the kernel dispatches datagrams of one remote endpoint to the same shard.
 //==============================================================================
 class IUdpMgr : public base::IUnknown
 {
@@ -47,22 +87,42 @@ public:
 	//
 	// @brief Initialize
 	// @param handler event handler
+	// @param shard_count count of event threads, only one shard if SO_REUSEPORT
+	//        is not supported
+	// @param recv_pool_size receive buffers pooled by each shard, 0 means
+	//        UDP_RECV_POOL_BUF_CNT
 	//
-	virtual com::ErrCode Init(IUdpHandler* handler) = 0;
+	virtual com::ErrCode Init(IUdpHandler* handler, uint32_t shard_count,
+		uint32_t recv_pool_size) = 0;
 
 	//
-	// @brief Create server socket with binding
+	// @brief Actual shard count
+	//
+	virtual uint32_t ShardCount() = 0;
+
+	//
+	// @brief Create server socket with binding, one socket for each shard
 	// @param ep local endpoint
+	// @return socket of the first shard, which stands for all shards
 	//
 	virtual Socket CreateServerSocket(const com::Endpoint& ep) = 0;
 
 	//
 	// @brief Create client socket
+	// @param shard which shard serves the socket
 	//
-	virtual Socket CreateClientSocket() = 0;
+	virtual Socket CreateClientSocket(uint32_t shard) = 0;
 
 	//
-	// @brief Stop listen
+	// @brief Run task in the event thread of shard, tasks without delay run in
+	//        posting order
+	// @param delay_us run after delay, 0 means as soon as possible
+	//
+	virtual void PostShardTask(uint32_t shard, const UdpShardTask& task,
+		uint64_t delay_us) = 0;
+
+	//
+	// @brief Stop listen, sockets of all shards are closed for server socket
 	// @param sock socket to be closed
 	//
 	virtual void CloseSocket(Socket sock) = 0;
@@ -75,6 +135,17 @@ public:
 	//
 	virtual com::ErrCode SendData(Socket sock, const com::Endpoint& ep,
 		com::Buffer buf) = 0;
+
+	//
+	// @brief Send a batch of packets with as few system calls as possible,
+	//        consecutive packets to the same endpoint may be merged by GSO
+	// @param sock send data from
+	// @param pkts packets to send
+	// @param sent_count how many leading packets were sent, less than the
+	//        packet count only if failed
+	//
+	virtual com::ErrCode SendBatch(Socket sock,
+		const std::vector<UdpPacket>& pkts, uint32_t& sent_count) = 0;
 };
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "net-common.h"
+#include "if-session-mgr.h"
 
 namespace jukey::net
 {
@@ -17,7 +18,8 @@ enum NetInnerMsgType
 	NET_INNER_MSG_ADD_SESSION       = 0x01010100 + 4,
 	NET_INNER_MSG_REMOVE_SESSION    = 0x01010100 + 5,
 	NET_INNER_MSG_SEND_SESSION_DATA = 0x01010100 + 6,
-	NET_INNER_MSG_ALLOC_SESSION_ID  = 0x01010100 + 7
+	NET_INNER_MSG_ALLOC_SESSION_ID  = 0x01010100 + 7,
+	NET_INNER_MSG_SEND_SESSION_BATCH = 0x01010100 + 8
 };
 
 //==============================================================================
@@ -71,6 +73,15 @@ struct SendSessionDataMsg
 };
 typedef std::shared_ptr<SendSessionDataMsg> SendSessionDataMsgSP;
 
+//==============================================================================
+// NET_INNER_MSG_SEND_SESSION_BATCH
+//==============================================================================
+struct SendSessionBatchMsg
+{
+	std::vector<SessionData> datas;
+};
+typedef std::shared_ptr<SendSessionBatchMsg> SendSessionBatchMsgSP;
+
 //==============================================================================
 // NET_INNER_MSG_REMOVE_SESSION
 //==============================================================================
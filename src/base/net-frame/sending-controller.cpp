@@ -5,7 +5,7 @@
 #include "common/util-time.h"
 #include "data-splitter.h"
 #include "fec-protocol.h"
-#include "fec/luigi-fec-encoder.h"
+#include "fec/fec-codec-cache.h"
 #include "log.h"
 
 
@@ -54,7 +54,7 @@ void SendingController::SetFecParam(const FecParam& param)
 				return;
 			}
 
-			m_fec_encoder.reset(new util::LuigiFecEncoder(param.k, param.r));
+			m_fec_encoder = util::GetFecEncoder(param.k, param.r);
 
 			LOG_INF("[session:{}] Create fec encoder, [{}:{}] -> [{}:{}]",
 				m_sess_param.local_sid,
@@ -315,9 +315,10 @@ SendResult SendingController::SendWithGroupMode(CacheSessionPktList& cache_list)
 
 	uint16_t group = ((FecPktHdr*)m_send_wait_que.front().data.get())->grp;
 
-	// Send whole fec group
-	while (!m_send_wait_que.empty()) {
-		Buffer buf = m_send_wait_que.front();
+	// Collect whole fec group, packets of one group have the same size and
+	// destination, so they can be sent by one batch call
+	std::vector<Buffer> group_bufs;
+	for (const auto& buf : m_send_wait_que) {
 		FecPktHdr* fec_hdr = (FecPktHdr*)buf.data.get();
 
 		// Meet next group, quit
@@ -328,12 +329,21 @@ SendResult SendingController::SendWithGroupMode(CacheSessionPktList& cache_list)
 		// Set the real tx time
 		ses_hdr->ts = static_cast<uint32_t>(util::Now());
 
-		if (ERR_CODE_OK != m_session_pkt_sender->SendPkt(FEC_PKT_TYPE, buf)) {
-			LOG_ERR("[session:{}] Send fec packet failed, fec group:{}, fec sn:{}, "
-				"psn:{}, msn:{}", m_sess_param.local_sid, fec_hdr->grp, fec_hdr->gsn,
-				ses_hdr->psn, ses_hdr->msn);
-			return send_result;
-		}
+		group_bufs.push_back(buf);
+	}
+
+	// Only the packets sent are removed, the rest are sent next time
+	uint32_t sent_count = 0;
+	if (ERR_CODE_OK != m_session_pkt_sender->SendPkts(FEC_PKT_TYPE, group_bufs,
+		sent_count)) {
+		LOG_ERR("[session:{}] Send fec group:{} failed, count:{}, sent:{}",
+			m_sess_param.local_sid, group, group_bufs.size(), sent_count);
+	}
+
+	for (uint32_t i = 0; i < sent_count && i < group_bufs.size(); i++) {
+		const Buffer& buf = group_bufs[i];
+		FecPktHdr* fec_hdr = (FecPktHdr*)buf.data.get();
+		SesPktHdr* ses_hdr = (SesPktHdr*)(buf.data.get() + FEC_PKT_HDR_LEN);
 
 		send_result.send_count += 1;
 		send_result.send_size += buf.data_len;
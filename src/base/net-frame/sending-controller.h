@@ -44,7 +44,7 @@ private:
 	// Send a group of fec data once a time
 	bool m_fec_batch_send = true;
 
-	util::IFecEncoderUP m_fec_encoder;
+	util::IFecEncoderSP m_fec_encoder;
 	FecParam m_fec_param;
 
 	uint16_t m_fec_next_group = 1;
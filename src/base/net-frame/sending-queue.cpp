@@ -1,5 +1,4 @@
 #include "sending-queue.h"
-#include "event/common-event.h"
 #include "log.h"
 #include "common/util-time.h"
 
@@ -14,87 +13,122 @@ namespace jukey::net
 //------------------------------------------------------------------------------
 SendingQueue::SendingQueue()
 {
-	m_sending_event.reset(new CommonEvent());
 }
 
 //------------------------------------------------------------------------------
-// 
+// Send time is queried outside the lock, it's the entry's own state
 //------------------------------------------------------------------------------
-ISendEntrySP SendingQueue::GetNextEntry()
+bool SendingQueue::GetDueEntries(std::vector<ISendEntrySP>& entries,
+	uint32_t max_count)
 {
-	m_mutex.lock();
-	if (m_entry_heap.empty()) {
-		m_sending_event->Reset();
-		m_mutex.unlock();
-		m_sending_event->Wait(WAIT_INFINITE);
-	}
-	else {
-		m_mutex.unlock();
-	}
-
-	m_mutex.lock();
-	if (m_entry_heap.empty()) {
-		LOG_ERR("Empty entry heap!");
-		m_mutex.unlock();
-		return nullptr;
-	}
-
-	ISendEntrySP entry = m_entry_heap.front();
-	PopEntry(entry->GetEntryId());
-	m_mutex.unlock();
+	entries.clear();
+
+	while (entries.empty()) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (!m_stop) {
+				if (m_entry_heap.Empty()) {
+					m_cv.wait(lock);
+					continue;
+				}
+
+				uint64_t now = util::Now();
+				uint64_t send_time = m_entry_heap.TopKey();
+				if (send_time <= now) {
+					break;
+				}
+
+				// Woken up early if an earlier send time arrives
+				m_cv.wait_for(lock, std::chrono::microseconds(send_time - now));
+			}
+
+			if (m_stop) return false;
+
+			// Drain due entries in batch
+			uint64_t now = util::Now();
+			while (!m_entry_heap.Empty() && entries.size() < max_count
+				&& m_entry_heap.TopKey() <= now) {
+				entries.push_back(m_entry_heap.Top());
+				m_entry_heap.Pop();
+			}
+		}
 
-	uint64_t now = util::Now();
-	uint64_t next_send_time = entry->NextSendTime();
-	if (next_send_time == INVALID_SEND_TIME) {
-		entry.reset();
-	}
-	else {
-		if (next_send_time > now) {
-			util::Sleep(next_send_time - now);
+		// Send time may have changed since queued
+		uint64_t now = util::Now();
+		for (size_t i = 0; i < entries.size(); ) {
+			uint64_t send_time = entries[i]->NextSendTime();
+			if (send_time == INVALID_SEND_TIME || send_time > now) {
+				if (send_time != INVALID_SEND_TIME) {
+					PushOrUpdate(entries[i], send_time, false);
+				}
+				entries[i] = entries.back();
+				entries.pop_back();
+			}
+			else {
+				i++;
+			}
 		}
 	}
 
-	return entry;
+	return true;
 }
 
 //------------------------------------------------------------------------------
-// Lock outside
+// 
 //------------------------------------------------------------------------------
-void SendingQueue::PopEntry(uint64_t entry_id)
+void SendingQueue::PushOrUpdate(const ISendEntrySP& entry, uint64_t send_time,
+	bool force)
 {
-	// Remove from heap
-	std::pop_heap(m_entry_heap.begin(), m_entry_heap.end());
-	m_entry_heap.pop_back();
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-	// Remove from map
-	m_entry_map.erase(entry_id);
+	// Wake up sending thread only if the earliest send time changed
+	if (DoPushOrUpdate(entry, send_time, force)) {
+		m_cv.notify_one();
+	}
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void SendingQueue::AddEntry(ISendEntrySP entry)
+bool SendingQueue::DoPushOrUpdate(const ISendEntrySP& entry,
+	uint64_t send_time, bool force)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-
-	// It's very likely that sending thread and protocol thread add the same entry
-	// at the same time
-	if (m_entry_map.find(entry->GetEntryId()) != m_entry_map.end()) {
-		LOG_DBG("Add existing entry:{}!", entry->GetEntryId());
-		return;
+	uint64_t entry_id = entry->GetEntryId();
+
+	uint64_t old_send_time = 0;
+	if (m_entry_heap.GetKey(entry_id, old_send_time)) {
+		// It's very likely that sending thread and protocol thread add the same
+		// entry at the same time
+		if (send_time < old_send_time || (force && send_time != old_send_time)) {
+			m_entry_heap.Update(entry_id, send_time);
+		}
+		else {
+			LOG_DBG("Add existing entry:{}!", entry_id);
+			return false;
+		}
 	}
+	else {
+		m_entry_heap.Push(entry_id, send_time, entry);
 
-	// Add to heap
-	m_entry_heap.push_back(entry);
-	std::push_heap(m_entry_heap.begin(), m_entry_heap.end());
+		LOG_DBG("Add entry:{}, heap size:{}", entry_id, m_entry_heap.Size());
+	}
 
-	// Add to map
-	m_entry_map.insert(std::make_pair(entry->GetEntryId(), entry));
+	return m_entry_heap.TopId() == entry_id;
+}
 
-	LOG_DBG("Add entry:{}, map size:{}, heap size:{}", entry->GetEntryId(),
-		m_entry_map.size(), m_entry_heap.size());
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SendingQueue::AddEntry(ISendEntrySP entry)
+{
+	uint64_t send_time = entry->NextSendTime();
+	if (send_time == INVALID_SEND_TIME) {
+		LOG_DBG("Entry:{} has nothing to send", entry->GetEntryId());
+		return;
+	}
 
-	m_sending_event->Trigger();
+	PushOrUpdate(entry, send_time, false);
 }
 
 //------------------------------------------------------------------------------
@@ -104,29 +138,13 @@ void SendingQueue::RemoveEntry(uint64_t entry_id)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
 
-	// Try to remove entry from map
-	if (m_entry_map.find(entry_id) == m_entry_map.end()) {
-		LOG_DBG("Cannot find entry:{} in map, map size:{}, heap size:{}", entry_id,
-			m_entry_heap.size(), m_entry_heap.size());
-		return;
+	if (m_entry_heap.Remove(entry_id)) {
+		LOG_INF("Remove entry:{}, heap size:{}", entry_id, m_entry_heap.Size());
 	}
 	else {
-		m_entry_map.erase(entry_id);
-		LOG_INF("Remove entry:{} from map, map size:{}", entry_id, m_entry_map.size());
+		LOG_DBG("Cannot find entry:{}, heap size:{}", entry_id,
+			m_entry_heap.Size());
 	}
-
-	// Remove from heap
-	for (auto iter = m_entry_heap.begin(); iter != m_entry_heap.end(); iter++) {
-		if ((*iter)->GetEntryId() == entry_id) {
-			m_entry_heap.erase(iter);
-			std::make_heap(m_entry_heap.begin(), m_entry_heap.end());
-			LOG_INF("Remove entry:{} from heap, head size:{}", entry_id,
-				m_entry_heap.size());
-			return;
-		}
-	}
-
-	LOG_ERR("Remove entry:{} from entry heap failed!", entry_id);
 }
 
 //------------------------------------------------------------------------------
@@ -134,18 +152,54 @@ void SendingQueue::RemoveEntry(uint64_t entry_id)
 //------------------------------------------------------------------------------
 void SendingQueue::UpdateEntry(ISendEntrySP entry, bool force)
 {
-	m_mutex.lock();
-	if (m_entry_map.find(entry->GetEntryId()) != m_entry_map.end()) {
-		m_mutex.unlock();
+	uint64_t send_time = entry->NextSendTime();
+	if (send_time == INVALID_SEND_TIME) {
 		if (force) {
 			RemoveEntry(entry->GetEntryId());
-			AddEntry(entry);
 		}
+		return;
 	}
-	else {
-		m_mutex.unlock();
-		AddEntry(entry);
+
+	PushOrUpdate(entry, send_time, force);
+}
+
+//------------------------------------------------------------------------------
+// Send times are queried before locking, they are the entries' own state
+//------------------------------------------------------------------------------
+void SendingQueue::UpdateEntries(const std::vector<ISendEntrySP>& entries)
+{
+	std::vector<uint64_t> send_times;
+	send_times.reserve(entries.size());
+	for (const auto& entry : entries) {
+		send_times.push_back(entry->NextSendTime());
+	}
+
+	bool notify = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (size_t i = 0; i < entries.size(); i++) {
+			if (send_times[i] != INVALID_SEND_TIME) {
+				notify |= DoPushOrUpdate(entries[i], send_times[i], false);
+			}
+		}
+	}
+
+	if (notify) {
+		m_cv.notify_one();
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SendingQueue::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
 	}
+	m_cv.notify_all();
 }
 
 }
\ No newline at end of file
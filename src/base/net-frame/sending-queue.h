@@ -1,16 +1,18 @@
 #pragma once
 
 #include <mutex>
-#include <unordered_map>
+#include <condition_variable>
 
 #include "if-sending-queue.h"
-#include "event/if-event.h"
+#include "common/indexed-heap.h"
 
 namespace jukey::net
 {
 
 //==============================================================================
-// 
+// Entries are ordered by send time in an indexed heap. The sending thread
+// waits until the earliest send time, and is woken up early when an earlier
+// send time arrives.
 //==============================================================================
 class SendingQueue : public ISendQueue
 {
@@ -18,19 +20,29 @@ public:
 	SendingQueue();
 
 	// ISendQueue
-	virtual ISendEntrySP GetNextEntry() override;
+	virtual bool GetDueEntries(std::vector<ISendEntrySP>& entries,
+		uint32_t max_count) override;
 	virtual void AddEntry(ISendEntrySP entry) override;
 	virtual void RemoveEntry(uint64_t entry_id) override;
 	virtual void UpdateEntry(ISendEntrySP entry, bool force) override;
+	virtual void UpdateEntries(const std::vector<ISendEntrySP>& entries) override;
+	virtual void Stop() override;
 
 private:
-	void PopEntry(uint64_t entry_id);
+	void PushOrUpdate(const ISendEntrySP& entry, uint64_t send_time, bool force);
+
+	// Return true if the earliest send time changed, lock must be held
+	bool DoPushOrUpdate(const ISendEntrySP& entry, uint64_t send_time,
+		bool force);
 
 private:
-	util::IEventSP m_sending_event;
-	std::vector<ISendEntrySP> m_entry_heap;
-	std::unordered_map<uint64_t, ISendEntrySP> m_entry_map;
+	// Key is send time
+	util::IndexedHeap<uint64_t, ISendEntrySP> m_entry_heap;
+
 	std::mutex m_mutex;
+	std::condition_variable m_cv;
+
+	bool m_stop = false;
 };
 
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
-﻿#include "server-session.h"
+﻿#include <algorithm>
+
+#include "server-session.h"
 #include "net-message.h"
 #include "session-mgr.h"
 #include "common/util-time.h"
@@ -112,6 +114,24 @@ void ServerSession::DoUpdate()
 	}
 }
 
+//------------------------------------------------------------------------------
+// Keep the same deadlines as DoUpdate
+//------------------------------------------------------------------------------
+uint64_t ServerSession::DoNextUpdateTime()
+{
+	switch (m_sess_state) {
+	case SESSION_STATE_HANDSHAKING:
+		return m_wait_handshake_ts + 3 * 3000000;
+	case SESSION_STATE_TRANSPORTING:
+		return std::min(m_last_send_data_ts + m_sess_param.remote_kai * 1000000,
+			m_last_recv_data_ts + 3 * m_sess_param.local_kai * 1000000);
+	case SESSION_STATE_RECONNECTING:
+		return m_wait_reconnect_ts + 3 * m_sess_param.local_kai * 1000000;
+	default:
+		return INVALID_UPDATE_TIME;
+	}
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
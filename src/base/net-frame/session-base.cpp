@@ -1,4 +1,5 @@
 ﻿#include <sstream>
+#include <algorithm>
 
 #include "session-base.h"
 #include "net-inner-message.h"
@@ -163,6 +164,23 @@ void SessionBase::OnUpdate()
   DoUpdate(); // derived class process
 }
 
+//------------------------------------------------------------------------------
+// Retransmission timeout is driven by sending queue, not included here
+//------------------------------------------------------------------------------
+uint64_t SessionBase::NextUpdateTime()
+{
+  if (m_sess_state == SESSION_STATE_CLOSED) {
+    return INVALID_UPDATE_TIME;
+  }
+
+  uint64_t next_time = DoNextUpdateTime(); // derived class process
+
+  next_time = std::min(next_time, m_sess_recver->NextUpdateTime());
+  next_time = std::min(next_time, m_fec_pkt_assembler->NextUpdateTime());
+
+  return next_time;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -36,6 +36,7 @@ public:
 	virtual void Init() override;
 	virtual void Close(bool active) override;
 	virtual void OnUpdate() override;
+	virtual uint64_t NextUpdateTime() override;
 	virtual void OnRecvData(const com::Buffer& buf) override;
 	virtual bool OnSendData(const com::Buffer& buf) override;
 	virtual const SessionParam& GetParam() override;
@@ -66,6 +67,7 @@ protected:
 	virtual void DoInit() = 0;
 	virtual void DoClose() = 0;
 	virtual void DoUpdate() = 0;
+	virtual uint64_t DoNextUpdateTime() = 0;
 	virtual void OnSessionControlMsg(const SessionPktSP& pkt) = 0;
 
 protected:
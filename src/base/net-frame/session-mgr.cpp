@@ -71,6 +71,11 @@ bool SessionMgr::CheckSessionMgrParam(const SessionMgrParam& param)
 		return false;
 	}
 
+	if (param.udp_shard_count > 1024) {
+		LOG_ERR("Invalid udp shard count:{}", param.udp_shard_count);
+		return false;
+	}
+
 	return true;
 }
 
@@ -105,17 +110,41 @@ com::ErrCode SessionMgr::Init(const SessionMgrParam& param)
 		return ERR_CODE_FAILED;
 	}
 
-	if (ERR_CODE_OK != m_udp_mgr->Init(this)) {
+	if (ERR_CODE_OK != m_udp_mgr->Init(this, 
+		param.udp_shard_count > 0 ? param.udp_shard_count : 1,
+		param.udp_recv_pool_size)) {
 		LOG_ERR("Init udp manager failed!");
 		return ERR_CODE_FAILED;
 	}
 
-	for (uint32_t i = 0; i < param.thread_count; i++) {
-		SessionThreadSP th(new SessionThread(m_factory, i));
-		th->Start();
-		m_session_threads.push_back(th);
+	// Shard count may be decreased by UDP manager
+	m_sharded = param.udp_shard_count > 0;
+	uint32_t shard_count = m_udp_mgr->ShardCount();
+
+	for (uint32_t i = 0; i < shard_count; i++) {
+		m_udp_tables.push_back(UdpShardTableUP(new UdpShardTable()));
+		m_shard_sid_index.push_back(i);
+	}
+
+	if (m_sharded) {
+		// Session thread N runs in UDP shard N
+		for (uint32_t i = 0; i < shard_count; i++) {
+			SessionThreadSP th(new SessionThread(m_factory, i, m_udp_mgr));
+			th->Start();
+			m_session_threads.push_back(th);
+		}
+	}
+	else {
+		for (uint32_t i = 0; i < param.thread_count; i++) {
+			SessionThreadSP th(new SessionThread(m_factory, i));
+			th->Start();
+			m_session_threads.push_back(th);
+		}
 	}
 
+	LOG_INF("Session thread count:{}, udp shard count:{}, sharded:{}",
+		m_session_threads.size(), shard_count, m_sharded);
+
 	StartThread();
 
 	return ERR_CODE_OK;
@@ -143,6 +172,12 @@ SessionId SessionMgr::GetSessionIdFromSt(uint32_t thread_index)
 //------------------------------------------------------------------------------
 SessionId SessionMgr::GetAvailableSessionId()
 {
+	// Spread client and TCP sessions over shards
+	if (m_sharded) {
+		uint32_t shard = m_next_shard.fetch_add(1, std::memory_order_relaxed);
+		return GetShardSessionId(shard % m_udp_tables.size());
+	}
+
 	std::lock_guard<std::mutex> lock(m_sid_mutex);
 
 	if (m_session_index < 0xFFFF) {
@@ -163,6 +198,57 @@ SessionId SessionMgr::GetAvailableSessionId()
 	}
 }
 
+//------------------------------------------------------------------------------
+// Session ID of shard N satisfies (sid % shard count == N), so that sessions
+// accepted by the shard run in the session thread of the same shard. Caller
+// must hold m_mutex.
+//------------------------------------------------------------------------------
+SessionId SessionMgr::GetShardSessionId(uint32_t shard)
+{
+	std::lock_guard<std::mutex> lock(m_sid_mutex);
+
+	uint32_t shard_count = (uint32_t)m_udp_tables.size();
+
+	// Never used session ID first
+	while (m_shard_sid_index[shard] <= 0xFFFF) {
+		uint32_t sid = m_shard_sid_index[shard];
+		m_shard_sid_index[shard] += shard_count;
+		if (sid != INVALID_SESSION_ID) {
+			return (SessionId)sid;
+		}
+	}
+
+	// Then released session ID
+	for (uint32_t sid = shard; sid <= 0xFFFF; sid += shard_count) {
+		if (sid != INVALID_SESSION_ID && !IsSessionIdInUse((SessionId)sid)) {
+			return (SessionId)sid;
+		}
+	}
+
+	LOG_ERR("Allocate session of shard {} failed!", shard);
+	return INVALID_SESSION_ID;
+}
+
+//------------------------------------------------------------------------------
+// Caller must hold m_mutex
+//------------------------------------------------------------------------------
+bool SessionMgr::IsSessionIdInUse(SessionId sid)
+{
+	if (m_udp_conns.find(sid) != m_udp_conns.end()) {
+		return true;
+	}
+
+	for (const auto& item : m_tcp_map) {
+		if (item.second == sid) return true;
+	}
+
+	for (const auto& item : m_conn_que) {
+		if (item.sid == sid) return true;
+	}
+
+	return false;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -226,12 +312,16 @@ SessionId SessionMgr::CreateSession(const CreateParam& param)
 		m_conn_que.push_back(ConnItem(param, sid));
 	}
 	else if (param.remote_addr.type == com::AddrType::UDP) {
-		SocketId sock = m_udp_mgr->CreateClientSocket();
+		// Socket is served by the shard of session
+		SocketId sock = m_udp_mgr->CreateClientSocket(GetSessionShard(sid));
 		if (sock == INVALID_SOCKET_ID) {
 			LOG_ERR("Create udp client socket failed!");
 			return INVALID_SESSION_ID;
 		}
-		AddClientSession(com::AddrType::UDP, sock, sid, param);
+		ISessionSP session = AddClientSession(com::AddrType::UDP, sock, sid, param);
+		if (session) {
+			PostAddSessionMsg(session);
+		}
 		LOG_INF("Create client udp socket {}", sock);
 	}
 
@@ -269,13 +359,16 @@ bool SessionMgr::DoRemoveSession(SessionId sid)
 
 	// Then udp session
 	if (!found) {
-		for (auto iter = m_udp_map.begin(); iter != m_udp_map.end(); iter++) {
-			if (iter->second == sid) {
-				m_udp_map.erase(iter);
-				LOG_INF("Remove session {} from udp map", sid);
-				found = true;
-				break;
+		auto iter = m_udp_conns.find(sid);
+		if (iter != m_udp_conns.end()) {
+			UdpShardTable& shard_table = *m_udp_tables[GetSessionShard(sid)];
+			{
+				std::lock_guard<std::mutex> lock(shard_table.mutex);
+				shard_table.table.Remove(iter->second);
 			}
+			m_udp_conns.erase(iter);
+			LOG_INF("Remove session {} from udp table", sid);
+			found = true;
 		}
 	}
 
@@ -297,7 +390,7 @@ com::ErrCode SessionMgr::DoCloseSession(SessionId sid, bool active)
 	
 	PostRemoveSessionMsg(sid, active);
 
-	LOG_INF("Total session count:{}", m_tcp_map.size() + m_udp_map.size());
+	LOG_INF("Total session count:{}", m_tcp_map.size() + GetUdpSessionCount());
 
 	return ERR_CODE_OK;
 }
@@ -464,6 +557,46 @@ com::ErrCode SessionMgr::SendData(SessionId sid, const com::Buffer& buf)
 	}
 }
 
+//------------------------------------------------------------------------------
+// One message for each session thread
+//------------------------------------------------------------------------------
+com::ErrCode SessionMgr::SendData(const std::vector<SessionData>& datas)
+{
+	LOG_DBG("Send batch data, count:{}", datas.size());
+
+	std::vector<SendSessionBatchMsgSP> batches(m_session_threads.size());
+
+	for (const auto& data : datas) {
+		if (data.buf.data_len > SEND_DATA_MAX_SIZE) {
+			LOG_ERR("[session:{}] Invalid send data length:{}", data.sid,
+				data.buf.data_len);
+			continue;
+		}
+
+		SendSessionBatchMsgSP& batch = batches[data.sid % batches.size()];
+		if (!batch) {
+			batch.reset(new SendSessionBatchMsg());
+		}
+		batch->datas.push_back(data);
+	}
+
+	ErrCode result = ERR_CODE_OK;
+
+	for (uint32_t i = 0; i < batches.size(); i++) {
+		if (!batches[i]) continue;
+
+		com::CommonMsg msg;
+		msg.msg_type = NET_INNER_MSG_SEND_SESSION_BATCH;
+		msg.msg_data = batches[i];
+
+		if (!m_session_threads[i]->PostMsg(msg)) {
+			result = ERR_CODE_FAILED;
+		}
+	}
+
+	return result;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -472,33 +605,81 @@ SessionThreadSP SessionMgr::GetSessionThread(SessionId sid)
 	return m_session_threads[sid % m_session_threads.size()];
 }
 
+//------------------------------------------------------------------------------
+// Equals to the index of session thread in sharded mode
+//------------------------------------------------------------------------------
+uint32_t SessionMgr::GetSessionShard(SessionId sid)
+{
+	return sid % m_udp_tables.size();
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void SessionMgr::DoAddSession(ISessionSP session, com::AddrType addr_type,
+uint32_t SessionMgr::GetUdpSessionCount()
+{
+	uint32_t count = 0;
+
+	for (auto& shard_table : m_udp_tables) {
+		std::lock_guard<std::mutex> lock(shard_table->mutex);
+		count += shard_table->table.Size();
+	}
+
+	return count;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool SessionMgr::DoAddSession(ISessionSP session, com::AddrType addr_type,
 	SocketId sock, SessionId sid, const com::Endpoint& rep)
 {
 	if (addr_type == com::AddrType::TCP) {
 		m_tcp_map.insert(std::make_pair(sock, sid));
 	}
 	else if (addr_type == com::AddrType::UDP) {
-		m_udp_map.insert(std::make_pair(UdpConn(sock, rep), sid));
+		UdpConnKey key;
+		if (!ParseBinEndpoint(rep, key.rep)) {
+			LOG_ERR("Invalid remote endpoint {}", rep.ToStr());
+			return false;
+		}
+		key.sock = sock;
+
+		UdpShardTable& shard_table = *m_udp_tables[GetSessionShard(sid)];
+		{
+			std::lock_guard<std::mutex> lock(shard_table.mutex);
+			if (!shard_table.table.Insert(key, sid)) {
+				LOG_ERR("[session:{}] Connection exists, remote:{}, sock:{}", sid,
+					rep.ToStr(), sock);
+				return false;
+			}
+		}
+		m_udp_conns.insert(std::make_pair(sid, key));
 	}
 	else {
 		LOG_ERR("Invalid transport type {}", addr_type);
-		return;
+		return false;
 	}
 
-	LOG_INF("[session:{}] Post add session, tcp map count:{}, udp map count:{}", 
-		sid, m_tcp_map.size(), m_udp_map.size());
+	LOG_INF("[session:{}] Add session, tcp map count:{}, udp table count:{}", 
+		sid, m_tcp_map.size(), GetUdpSessionCount());
+
+	return true;
+}
 
-	GetSessionThread(sid)->PostMsg(CommonMsg(NET_INNER_MSG_ADD_SESSION, session));
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionMgr::PostAddSessionMsg(ISessionSP session)
+{
+	GetSessionThread(session->GetParam().local_sid)->PostMsg(
+		CommonMsg(NET_INNER_MSG_ADD_SESSION, session));
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void SessionMgr::AddClientSession(com::AddrType addr_type, SocketId sock,
+ISessionSP SessionMgr::AddClientSession(com::AddrType addr_type, SocketId sock,
 	SessionId sid, const CreateParam& param)
 {
 	LOG_INF("Add client session, type:{}, socket:{}, sid:{}, addr:{}", 
@@ -519,13 +700,17 @@ void SessionMgr::AddClientSession(com::AddrType addr_type, SocketId sock,
 
 	SessionThreadSP st = GetSessionThread(sid);
 	ISessionSP session(new ClientSession(this, st, sparam, param));
-	DoAddSession(session, addr_type, sock, sid, param.remote_addr.ep);
+	if (!DoAddSession(session, addr_type, sock, sid, param.remote_addr.ep)) {
+		return nullptr;
+	}
+
+	return session;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void SessionMgr::AddServerSession(AddrType addr_type, const Endpoint& lep, 
+ISessionSP SessionMgr::AddServerSession(AddrType addr_type, const Endpoint& lep, 
   const Endpoint& rep, SocketId sock, SessionId sid)
 {
 	LOG_INF("Add server session, type:{}, socket:{}, sid:{}, endpoint:{}",
@@ -534,7 +719,7 @@ void SessionMgr::AddServerSession(AddrType addr_type, const Endpoint& lep,
 	ListenItem item = GetListenItemByEndpoint(lep);
 	if (item.param.listen_srv == com::ServiceType::INVALID) {
 		LOG_ERR("Cannot find listen item by local endpoint:{}", lep.ToStr());
-		return;
+		return nullptr;
 	}
 
   SessionParam sparam;
@@ -552,7 +737,11 @@ void SessionMgr::AddServerSession(AddrType addr_type, const Endpoint& lep,
 
 	SessionThreadSP st = GetSessionThread(sid);
 	ISessionSP session(new ServerSession(this, st, sparam, m_mgr_param));	
-	DoAddSession(session, addr_type, sock, sid, rep);
+	if (!DoAddSession(session, addr_type, sock, sid, rep)) {
+		return nullptr;
+	}
+
+	return session;
 }
 
 //------------------------------------------------------------------------------
@@ -568,7 +757,11 @@ void SessionMgr::OnIncommingConn(const Endpoint& lep, const Endpoint& rep,
 
 	SessionId sid = GetAvailableSessionId();
 	if (sid != INVALID_SESSION_ID) {
-		AddServerSession(com::AddrType::TCP, lep, rep, sock, sid);
+		ISessionSP session = AddServerSession(com::AddrType::TCP, lep, rep, sock,
+			sid);
+		if (session) {
+			PostAddSessionMsg(session);
+		}
 	}
 }
 
@@ -585,7 +778,11 @@ void SessionMgr::OnConnectResult(const Endpoint& lep, const Endpoint& rep,
 	for (auto iter = m_conn_que.begin(); iter != m_conn_que.end(); iter++) {
 		if (iter->param.remote_addr.ep == rep) {
 			if (result) {
-				AddClientSession(com::AddrType::TCP, sock, iter->sid, iter->param);
+				ISessionSP session = AddClientSession(com::AddrType::TCP, sock,
+					iter->sid, iter->param);
+				if (session) {
+					PostAddSessionMsg(session);
+				}
 			}
 			else {
 				com::CommonMsg msg;
@@ -684,28 +881,87 @@ SessionMgr::ListenItem SessionMgr::GetListenItemByEndpoint(const Endpoint& ep)
 	return ListenItem();
 }
 
+//------------------------------------------------------------------------------
+// Run to completion in sharded mode, the session belongs to the receiving shard
+//------------------------------------------------------------------------------
+void SessionMgr::DispatchUdpData(SessionId sid, const com::Buffer& buf)
+{
+	if (m_sharded) {
+		GetSessionThread(sid)->RecvDataInShard(sid, buf);
+	}
+	else {
+		PostConnectionDataMsg(sid, buf);
+	}
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void SessionMgr::OnRecvUdpData(const Endpoint& lep, const Endpoint& rep,
-	SocketId sock, com::Buffer buf)
+void SessionMgr::OnRecvUdpData(const Endpoint& lep, const BinEndpoint& rep,
+	SocketId sock, uint32_t shard, com::Buffer buf)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
+	UdpConnKey key(sock, rep);
+
+	UdpShardTable& shard_table = *m_udp_tables[shard];
 
-	auto iter = m_udp_map.find(UdpConn(sock, rep));
-	if (iter == m_udp_map.end()) { // new session
-		SessionId sid = GetAvailableSessionId();
-		if (sid == INVALID_SESSION_ID) {
-			LOG_ERR("Get avaliable session ID failed!");
+	SessionId found_sid = INVALID_SESSION_ID;
+	{
+		std::lock_guard<std::mutex> lock(shard_table.mutex);
+		found_sid = shard_table.table.Find(key);
+	}
+
+	// Old session
+	if (found_sid != INVALID_SESSION_ID) {
+		DispatchUdpData(found_sid, buf);
+		return;
+	}
+
+	// New session
+	ISessionSP session;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// Client session may be added after the lookup
+		{
+			std::lock_guard<std::mutex> table_lock(shard_table.mutex);
+			found_sid = shard_table.table.Find(key);
 		}
-		else {
-			AddServerSession(com::AddrType::UDP, lep, rep, sock, sid);
-			PostConnectionDataMsg(sid, buf);
+
+		if (found_sid == INVALID_SESSION_ID) {
+			// Session is pinned to the shard which received its handshake
+			SessionId sid = m_sharded ? GetShardSessionId(shard)
+				: GetAvailableSessionId();
+			if (sid == INVALID_SESSION_ID) {
+				LOG_ERR("Get avaliable session ID failed!");
+				return;
+			}
+
+			// Host string is only formatted for new session
+			session = AddServerSession(com::AddrType::UDP, lep,
+				FormatBinEndpoint(rep), sock, sid);
+			if (!session) {
+				return;
+			}
+
+			if (!m_sharded) {
+				PostAddSessionMsg(session);
+				PostConnectionDataMsg(sid, buf);
+				return;
+			}
 		}
 	}
-	else { // old session
-		PostConnectionDataMsg(iter->second, buf);
+
+	// Dispatched as an old session, out of the lock
+	if (!session) {
+		DispatchUdpData(found_sid, buf);
+		return;
 	}
+
+	// Removing posted by other threads is processed after adding
+	SessionId sid = session->GetParam().local_sid;
+	SessionThreadSP st = GetSessionThread(sid);
+	st->AddSessionInShard(session);
+	st->RecvDataInShard(sid, buf);
 }
 
 //------------------------------------------------------------------------------
@@ -716,11 +972,24 @@ void SessionMgr::OnSocketClosed(const Endpoint& lep, const Endpoint& rep,
 {
 	LOG_DBG("Udp socket closed, local:{}, remote:{}", lep.ToStr(), rep.ToStr());
 
+	UdpConnKey key;
+	if (!ParseBinEndpoint(rep, key.rep)) {
+		LOG_DBG("Invalid remote endpoint {}", rep.ToStr());
+		return;
+	}
+	key.sock = sock;
+
 	std::lock_guard<std::mutex> lock(m_mutex);
 
-	auto iter = m_udp_map.find(UdpConn(sock, rep));
-	if (iter != m_udp_map.end()) {
-		DoCloseSession(iter->second, false);
+	SessionId sid = INVALID_SESSION_ID;
+	for (auto& shard_table : m_udp_tables) {
+		std::lock_guard<std::mutex> table_lock(shard_table->mutex);
+		sid = shard_table->table.Find(key);
+		if (sid != INVALID_SESSION_ID) break;
+	}
+
+	if (sid != INVALID_SESSION_ID) {
+		DoCloseSession(sid, false);
 	}
 	else {
 		LOG_DBG("Cannot find session to remove!");
@@ -4,6 +4,8 @@
 #include <unordered_map>
 #include <vector>
 #include <mutex>
+#include <memory>
+#include <atomic>
 
 #include "if-session.h"
 #include "proxy-unknown.h"
@@ -13,6 +15,7 @@
 #include "if-udp-mgr.h"
 #include "session-thread.h"
 #include "net-common.h"
+#include "udp-conn-table.h"
 #include "common-error.h"
 #include "thread/common-thread.h"
 
@@ -43,6 +46,7 @@ public:
 	virtual ListenId AddListen(const ListenParam& param) override;
 	virtual com::ErrCode RemoveListen(ListenId lid) override;
 	virtual com::ErrCode SendData(SessionId sid, const com::Buffer& buf) override;
+	virtual com::ErrCode SendData(const std::vector<SessionData>& datas) override;
 	virtual void SetLogLevel(uint8_t level) override;
 
 	base::IComFactory* GetComFactory() { return m_factory; }
@@ -65,27 +69,13 @@ private:
 		SocketId sock = INVALID_SOCKET_ID; // Socket: for udp
 	};
 
-	struct UdpConn
+	// UDP connections of one shard
+	struct UdpShardTable
 	{
-		UdpConn(SocketId c, const com::Endpoint& ep) : sock(c), rep(ep) {}
-
-		SocketId sock;
-		com::Endpoint rep;
-
-		bool operator==(const UdpConn& conn) const
-		{
-			return sock == conn.sock && rep == conn.rep;
-		}
-	};
-
-	struct UdpConnHash
-	{
-		size_t operator()(const UdpConn& conn) const
-		{
-			return std::hash<std::string>()(
-				conn.rep.ToStr().append(std::to_string(conn.sock)));
-		}
+		std::mutex mutex;
+		UdpConnTable table;
 	};
+	typedef std::unique_ptr<UdpShardTable> UdpShardTableUP;
 
 private:
 	// ITcpHandler
@@ -106,8 +96,9 @@ private:
 
 	// IUdpHandler
 	virtual void OnRecvUdpData(const com::Endpoint& lep,
-		const com::Endpoint& rep,
+		const BinEndpoint& rep,
 		SocketId sock,
+		uint32_t shard,
 		com::Buffer buf) override;
 	virtual void OnSocketClosed(const com::Endpoint& lep,
 		const com::Endpoint& rep,
@@ -118,9 +109,15 @@ private:
 
 private:
 	SessionThreadSP GetSessionThread(SessionId sid);
+	uint32_t GetSessionShard(SessionId sid);
 	SessionId GetAvailableSessionId();
+	SessionId GetShardSessionId(uint32_t shard);
+	bool IsSessionIdInUse(SessionId sid);
 	SessionId GetSessionIdFromSt(uint32_t thread_index);
+	uint32_t GetUdpSessionCount();
+	void PostAddSessionMsg(ISessionSP session);
 	void PostConnectionDataMsg(SessionId sid, const com::Buffer& buf);
+	void DispatchUdpData(SessionId sid, const com::Buffer& buf);
 	void PostRemoveSessionMsg(SessionId sid, bool active);
 	bool CheckSessionMgrParam(const SessionMgrParam& param);
 	bool CheckCreateSessionParam(const CreateParam& param);
@@ -130,16 +127,16 @@ private:
 	void InnerCloseSession(SessionId sid);
 	bool DoRemoveSession(SessionId sid);
 
-	void AddClientSession(com::AddrType addr_type,
+	ISessionSP AddClientSession(com::AddrType addr_type,
 		SocketId sock, 
 		SessionId sid, 
 		const CreateParam& param);
-	void AddServerSession(com::AddrType addr_type,
+	ISessionSP AddServerSession(com::AddrType addr_type,
 		const com::Endpoint& lep,
 		const com::Endpoint& rep,
 		SocketId sock,
 		SessionId sid);
-	void DoAddSession(ISessionSP session, 
+	bool DoAddSession(ISessionSP session, 
 		com::AddrType addr_type,
 		SocketId sock, 
 		SessionId sid, 
@@ -159,8 +156,13 @@ private:
 	// For TCP session finding acceleration
 	std::unordered_map<SocketId, SessionId> m_tcp_map;
 
-	// For UDP session finding acceleration
-	std::unordered_map<UdpConn, SessionId, UdpConnHash> m_udp_map;
+	// For UDP session finding acceleration, one table for each UDP shard, so
+	// shards find sessions without contention. Sessions of shard N satisfy
+	// (sid % shard count == N), lock order: m_mutex -> table mutex
+	std::vector<UdpShardTableUP> m_udp_tables;
+
+	// For UDP session removing
+	std::unordered_map<SessionId, UdpConnKey> m_udp_conns;
 
 	// Session negotiation waiting queue
 	std::vector<ConnItem> m_conn_que;
@@ -174,6 +176,16 @@ private:
 	// Session ID allocation
 	uint16_t m_session_index = INVALID_SESSION_ID;
 
+	// Session threads run in UDP shards
+	bool m_sharded = false;
+
+	// Session ID allocation of each shard in sharded mode
+	std::vector<uint32_t> m_shard_sid_index;
+
+	// Shard of the next client or TCP session in sharded mode, sessions are
+	// created from any thread
+	std::atomic<uint32_t> m_next_shard { 0 };
+
 	// Listen ID allocation
 	uint16_t m_listen_index = INVALID_LISTEN_ID;
 
@@ -1,4 +1,5 @@
 #include "session-pkt-sender.h"
+#include "udp-send-batch.h"
 #include "fec-protocol.h"
 #include "log.h"
 
@@ -23,10 +24,8 @@ SessionPktSender::SessionPktSender(base::IComFactory* factory, ITcpMgr* tcp_mgr,
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ErrCode SessionPktSender::SendPkt(uint32_t data_type, const com::Buffer& buf)
+void SessionPktSender::DumpPkt(uint32_t data_type, const com::Buffer& buf)
 {
-	ErrCode ec = ERR_CODE_FAILED;
-
 	if (data_type == SESSION_PKT_DATA) {
 		SesPktHdr* ses_hdr = (SesPktHdr*)(buf.data.get() + buf.start_pos);
 		SessionProtocol::DumpSessionPktHdr(m_sess_param.local_sid, *ses_hdr);
@@ -38,8 +37,21 @@ ErrCode SessionPktSender::SendPkt(uint32_t data_type, const com::Buffer& buf)
 		SesPktHdr* ses_hdr = (SesPktHdr*)(buf.data.get() + FEC_PKT_HDR_LEN);
 		SessionProtocol::DumpSessionPktHdr(m_sess_param.local_sid, *ses_hdr);
 	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ErrCode SessionPktSender::SendPkt(uint32_t data_type, const com::Buffer& buf)
+{
+	DumpPkt(data_type, buf);
 
-	if (m_sess_param.remote_addr.type == com::AddrType::UDP) {
+	UdpSendBatch* batch = UdpSendBatch::Current();
+
+	if (m_sess_param.remote_addr.type == com::AddrType::UDP && batch) {
+		batch->Add(m_udp_mgr, m_sess_param.sock, m_sess_param.remote_addr.ep, buf);
+	}
+	else if (m_sess_param.remote_addr.type == com::AddrType::UDP) {
 		if (ERR_CODE_OK != m_udp_mgr->SendData(m_sess_param.sock,
 			m_sess_param.remote_addr.ep, buf)) {
 			LOG_ERR("[session:{}] Send session packet:{} failed!",
@@ -67,4 +79,62 @@ ErrCode SessionPktSender::SendPkt(uint32_t data_type, const com::Buffer& buf)
 	return ERR_CODE_OK;
 }
 
-}
\ No newline at end of file
+//------------------------------------------------------------------------------
+// Packets are sent with one batch call for UDP, or deferred to the batch of
+// sending thread; TCP is a byte stream and gains nothing from batching
+//------------------------------------------------------------------------------
+ErrCode SessionPktSender::SendPkts(uint32_t data_type,
+	const std::vector<com::Buffer>& bufs, uint32_t& sent_count)
+{
+	sent_count = 0;
+
+	if (m_sess_param.remote_addr.type != com::AddrType::UDP) {
+		for (const auto& buf : bufs) {
+			if (ERR_CODE_OK != SendPkt(data_type, buf)) {
+				return ERR_CODE_FAILED;
+			}
+			sent_count++;
+		}
+		return ERR_CODE_OK;
+	}
+
+	UdpSendBatch* batch = UdpSendBatch::Current();
+	if (batch) {
+		for (const auto& buf : bufs) {
+			DumpPkt(data_type, buf);
+			batch->Add(m_udp_mgr, m_sess_param.sock, m_sess_param.remote_addr.ep,
+				buf);
+			if (m_notify) m_notify->OnSendPkt(data_type, buf.data_len);
+		}
+		sent_count = (uint32_t)bufs.size();
+		return ERR_CODE_OK;
+	}
+
+	std::vector<UdpPacket> pkts;
+	pkts.reserve(bufs.size());
+
+	for (const auto& buf : bufs) {
+		DumpPkt(data_type, buf);
+		pkts.push_back(UdpPacket(m_sess_param.remote_addr.ep, buf));
+	}
+
+	ErrCode result = m_udp_mgr->SendBatch(m_sess_param.sock, pkts, sent_count);
+	if (ERR_CODE_OK != result) {
+		LOG_ERR("[session:{}] Send session packets:{}, count:{} failed, sent:{}",
+			m_sess_param.local_sid, data_type, bufs.size(), sent_count);
+	}
+	else {
+		LOG_DBG("[session:{}] Send session packets:{}, count:{} success",
+			m_sess_param.local_sid, data_type, bufs.size());
+	}
+
+	if (m_notify) {
+		for (uint32_t i = 0; i < sent_count && i < bufs.size(); i++) {
+			m_notify->OnSendPkt(data_type, bufs[i].data_len);
+		}
+	}
+
+	return result;
+}
+
+}
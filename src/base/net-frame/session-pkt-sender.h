@@ -21,8 +21,12 @@ public:
 
 	// ISessionPktSender
 	virtual com::ErrCode SendPkt(uint32_t data_type, const com::Buffer& buf) override;
+	virtual com::ErrCode SendPkts(uint32_t data_type,
+		const std::vector<com::Buffer>& bufs, uint32_t& sent_count) override;
 
 private:
+	void DumpPkt(uint32_t data_type, const com::Buffer& buf);
+
 	ITcpMgr* m_tcp_mgr = nullptr;
 	IUdpMgr* m_udp_mgr = nullptr;
 	SessionParam m_sess_param;
@@ -1,4 +1,5 @@
 ﻿#include <sstream>
+#include <algorithm>
 
 #include "session-receiver.h"
 #include "rtt-filter.h"
@@ -53,6 +54,8 @@ void SessionReceiver::InitStats(base::IComFactory* factory)
 	fmt << "[session:" << m_sess_param.local_sid << "] Session receiver,";
 
 	m_data_stats.reset(new util::DataStats(factory, g_net_logger, fmt.str(), false));
+	m_data_stats->SetMetricsScope("session_receiver",
+		{ { "session", std::to_string(m_sess_param.local_sid) } });
 	m_data_stats->Start();
 
 	StatsParam i_unor_frg("unor-frg", StatsType::IACCU, 5000);
@@ -105,18 +108,53 @@ void SessionReceiver::OnUpdate()
 {
 	uint64_t now = jukey::util::Now();
 
-	m_lost_pkt_tracer->Update();
-	m_data_stats->OnData(m_i_recv_loss, m_lost_pkt_tracer->GetInfo().lost_count);
+	if (m_last_stats_ts + SESSION_STATS_INTERVAL <= now) {
+		m_lost_pkt_tracer->Update();
 
-	m_recv_pkt_tracer->AddPktCount(m_recv_pkt_count, now - m_last_stats_ts);
-	m_last_stats_ts = now;
-	m_recv_pkt_count = 0;
+		uint32_t lost_count = m_lost_pkt_tracer->GetInfo().lost_count;
+		m_data_stats->OnData(m_i_recv_loss, lost_count);
+
+		m_recv_pkt_tracer->AddPktCount(m_recv_pkt_count, now - m_last_stats_ts);
+		m_last_stats_ts = now;
+
+		// One more update to clear the statistics after received nothing
+		m_stats_pending = (m_recv_pkt_count != 0 || lost_count != 0);
+		m_recv_pkt_count = 0;
+	}
 
 	if (m_sess_param.session_type == SessionType::RELIABLE) {
 		SendAck();
 	}
 }
 
+//------------------------------------------------------------------------------
+// Idle receiver needs no update
+//------------------------------------------------------------------------------
+uint64_t SessionReceiver::NextUpdateTime()
+{
+	uint64_t next_time = INVALID_UPDATE_TIME;
+
+	if (m_stats_pending || m_recv_pkt_count != 0) {
+		next_time = m_last_stats_ts + SESSION_STATS_INTERVAL;
+	}
+
+	if (m_sess_param.session_type != SessionType::RELIABLE) {
+		return next_time;
+	}
+
+	// The same conditions as SendAck
+	if (m_next_recv_psn > m_last_send_ack_psn
+		|| m_last_send_ack_msn > m_last_recv_ack2_msn) {
+		next_time = std::min(next_time,
+			m_last_send_ack_ts + SESSION_UPDATE_INTERVAL);
+	}
+	else if (m_cache_que_size > 0) {
+		next_time = std::min(next_time, m_last_send_ack_ts + 20000 + 1);
+	}
+
+	return next_time;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -33,6 +33,7 @@ public:
 	~SessionReceiver();
 
 	void OnUpdate();
+	uint64_t NextUpdateTime();
 	void OnSessionData(const SessionPktSP& pkt);
 	void OnSessionAck2(const SessionPktSP& pkt);
 	SessionPktSP GetSessionMsg();
@@ -106,6 +107,9 @@ private:
 	uint64_t m_last_stats_ts = 0;
 	uint32_t m_recv_pkt_count = 0;
 
+	// Tracers need more update
+	bool m_stats_pending = false;
+
 	// Statistics
 	util::DataStatsSP m_data_stats;
 	util::StatsId m_i_unor_frg = INVALID_STATS_ID;
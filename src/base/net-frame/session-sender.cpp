@@ -55,6 +55,8 @@ void SessionSender::InitStats(base::IComFactory* factory)
 	fmt << "[session:" << m_sess_param.local_sid << "] Session sender,";
 
 	m_data_stats.reset(new util::DataStats(factory, g_net_logger, fmt.str(), false));
+	m_data_stats->SetMetricsScope("session_sender",
+		{ { "session", std::to_string(m_sess_param.local_sid) } });
 	m_data_stats->Start();
 
 	StatsParam i_rto_rtx("rto-rtx", StatsType::IACCU, 5000);
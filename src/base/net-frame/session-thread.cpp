@@ -1,10 +1,13 @@
-﻿#include "session-thread.h"
+﻿#include <algorithm>
+
+#include "session-thread.h"
 #include "net-inner-message.h"
 #include "common-config.h"
 #include "if-timer-mgr.h"
 #include "common/util-time.h"
 #include "event/common-event.h"
 #include "sending-queue.h"
+#include "udp-send-batch.h"
 #include "log.h"
 
 using namespace jukey::util;
@@ -40,6 +43,15 @@ SessionThread::SessionThread(base::IComFactory* factory, uint32_t index)
   assert(m_sending_thread);
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+SessionThread::SessionThread(base::IComFactory* factory, uint32_t index,
+	IUdpMgr* udp_mgr) : SessionThread(factory, index)
+{
+	m_udp_mgr = udp_mgr;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -52,7 +64,12 @@ SessionThread::~SessionThread()
 //------------------------------------------------------------------------------
 void SessionThread::Start()
 {
-	StartThread();
+	if (m_udp_mgr) {
+		LOG_INF("Session thread {} runs in udp shard", m_thread_index);
+	}
+	else {
+		StartThread();
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -61,52 +78,162 @@ void SessionThread::Start()
 void SessionThread::Stop()
 {
   if (m_sending_thread) {
+    m_sending_que->Stop();
+    m_sending_thread->join();
     delete m_sending_thread;
     m_sending_thread = nullptr;
   }
 
-	StopThread();
+	if (m_udp_mgr) {
+		m_stop = true;
+	}
+	else {
+		StopThread();
+	}
+}
+
+//------------------------------------------------------------------------------
+// Thread is kept alive by pending tasks of shard
+//------------------------------------------------------------------------------
+bool SessionThread::PostMsg(const com::CommonMsg& msg)
+{
+	if (!m_udp_mgr) {
+		return ConcurrentThread::PostMsg(msg);
+	}
+
+	SessionThreadSP self = shared_from_this();
+	m_udp_mgr->PostShardTask(m_thread_index, [self, msg]() {
+		self->OnShardMsg(msg);
+	}, 0);
+
+	return true;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void SessionThread::OnRecvSessionData(const com::CommonMsg& msg)
+void SessionThread::AddSessionInShard(ISessionSP session)
 {
-	PCAST_COMMON_MSG_DATA(ConnectionDataMsg);
+	DoAddSession(session);
+	StartShardTimer();
+}
 
-	LOG_DBG("[session:{}] Received data, len:{}", data->sid, data->buf.data_len);
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionThread::RecvDataInShard(SessionId sid, const com::Buffer& buf)
+{
+	DoRecvData(sid, buf);
+	StartShardTimer();
+}
 
-	auto iter = m_sessions.find(data->sid);
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionThread::OnShardMsg(const com::CommonMsg& msg)
+{
+	if (m_stop) return;
+
+	OnThreadMsg(msg);
+	StartShardTimer();
+}
+
+//------------------------------------------------------------------------------
+// Timers put off by an earlier one are not cancelled, they just find nothing
+// due
+//------------------------------------------------------------------------------
+void SessionThread::OnShardTimer(uint64_t timer_ts)
+{
+	if (timer_ts == m_timer_ts) {
+		m_timer_ts = INVALID_UPDATE_TIME;
+	}
+
+	if (m_stop) return;
+
+	UpdateDueSessions();
+	StartShardTimer();
+}
+
+//------------------------------------------------------------------------------
+// Only start a timer if it is earlier than the pending one
+//------------------------------------------------------------------------------
+void SessionThread::StartShardTimer()
+{
+	if (m_update_heap.Empty()) return;
+
+	uint64_t next_time = m_update_heap.TopKey();
+	if (next_time >= m_timer_ts) return;
+
+	m_timer_ts = next_time;
+
+	uint64_t now = util::Now();
+	uint64_t delay = next_time > now ? next_time - now : 0;
+
+	SessionThreadSP self = shared_from_this();
+	m_udp_mgr->PostShardTask(m_thread_index, [self, next_time]() {
+		self->OnShardTimer(next_time);
+	}, delay);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionThread::DoRecvData(SessionId sid, const com::Buffer& buf)
+{
+	LOG_DBG("[session:{}] Received data, len:{}", sid, buf.data_len);
+
+	auto iter = m_sessions.find(sid);
 	if (iter != m_sessions.end()) {
-		iter->second.session->OnRecvData(data->buf);
+		iter->second.session->OnRecvData(buf);
+		// Received data may bring forward or put off the next update
+		ScheduleUpdate(sid, iter->second);
 	}
 	else {
-		LOG_ERR("Cannot find session {}", data->sid);
+		LOG_ERR("Cannot find session {}", sid);
 	}
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void SessionThread::OnAddSession(const com::CommonMsg& msg)
+void SessionThread::OnRecvSessionData(const com::CommonMsg& msg)
 {
-	PCAST_COMMON_MSG_DATA(ISession);
+	PCAST_COMMON_MSG_DATA(ConnectionDataMsg);
+
+	DoRecvData(data->sid, data->buf);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionThread::DoAddSession(ISessionSP session)
+{
+	SessionId sid = session->GetParam().local_sid;
 
-	if (m_sessions.find(data->GetParam().local_sid) == m_sessions.end()) {
-		data->Init(); // Initialize in session thread
+	if (m_sessions.find(sid) == m_sessions.end()) {
+		session->Init(); // Initialize in session thread
 
-    SessionEntry entry(data, false);
-		m_sessions.insert(std::make_pair(data->GetParam().local_sid, entry));
+		auto result = m_sessions.insert(std::make_pair(sid, SessionEntry(session)));
+		ScheduleUpdate(sid, result.first->second);
 
 		LOG_INF("Session thread {} add session {}, total session count:{}",
-			m_thread_index, data->GetParam().local_sid, m_sessions.size());
+			m_thread_index, sid, m_sessions.size());
 	}
 	else {
-		LOG_ERR("Session {} already exists!", data->GetParam().local_sid);
+		LOG_ERR("Session {} already exists!", sid);
 	}
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionThread::OnAddSession(const com::CommonMsg& msg)
+{
+	PCAST_COMMON_MSG_DATA(ISession);
+
+	DoAddSession(data);
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -117,6 +244,7 @@ void SessionThread::OnRemoveSession(const com::CommonMsg& msg)
 	auto iter = m_sessions.find(data->sid);
 	if (iter != m_sessions.end()) {
 		iter->second.session->Close(data->active);
+		m_update_heap.Remove(data->sid);
 		m_sessions.erase(iter);
 		m_sending_que->RemoveEntry(data->sid);
 		LOG_INF("Session thread {} remove session {}, total session count:{}",
@@ -137,6 +265,8 @@ void SessionThread::OnSendSessionData(const com::CommonMsg& msg)
 	auto iter = m_sessions.find(data->sid);
 	if (iter != m_sessions.end()) {
 		iter->second.session->OnSendData(data->buf);
+		// Sending may change the keep-alive and state timeouts
+		ScheduleUpdate(data->sid, iter->second);
 		// ugly!!!
 		m_sending_que->UpdateEntry(
 			std::dynamic_pointer_cast<ISendEntry>(iter->second.session), false);
@@ -147,6 +277,38 @@ void SessionThread::OnSendSessionData(const com::CommonMsg& msg)
 	}
 }
 
+//------------------------------------------------------------------------------
+// All sessions are queued before the sending thread is woken up, so their
+// packets are sent in the same tick
+//------------------------------------------------------------------------------
+void SessionThread::OnSendSessionBatch(const com::CommonMsg& msg)
+{
+	PCAST_COMMON_MSG_DATA(SendSessionBatchMsg);
+
+	std::vector<ISendEntrySP> entries;
+	entries.reserve(data->datas.size());
+
+	for (const auto& item : data->datas) {
+		auto iter = m_sessions.find(item.sid);
+		if (iter == m_sessions.end()) {
+			LOG_DBG("Cannot find session {} to send data", item.sid);
+			continue;
+		}
+
+		iter->second.session->OnSendData(item.buf);
+
+		// Consecutive data of one session is queued and rescheduled once
+		ISendEntrySP entry =
+			std::dynamic_pointer_cast<ISendEntry>(iter->second.session);
+		if (entries.empty() || entries.back() != entry) {
+			entries.push_back(entry);
+			ScheduleUpdate(item.sid, iter->second);
+		}
+	}
+
+	m_sending_que->UpdateEntries(entries);
+}
+
 //------------------------------------------------------------------------------
 // Request available session ID based on the total number of session threads 
 // and the current session thread index
@@ -196,6 +358,9 @@ void SessionThread::OnThreadMsg(const com::CommonMsg& msg)
 	case NET_INNER_MSG_SEND_SESSION_DATA:
 		OnSendSessionData(msg);
 		break;
+	case NET_INNER_MSG_SEND_SESSION_BATCH:
+		OnSendSessionBatch(msg);
+		break;
 	case NET_INNER_MSG_ALLOC_SESSION_ID:
 		OnAllocSessionId(msg);
 		break;
@@ -205,21 +370,75 @@ void SessionThread::OnThreadMsg(const com::CommonMsg& msg)
 }
 
 //------------------------------------------------------------------------------
-// Sending thread
+// Session decides when to update, but not more frequent than update interval
+//------------------------------------------------------------------------------
+void SessionThread::ScheduleUpdate(SessionId sid, SessionEntry& entry)
+{
+	uint64_t next_time = entry.session->NextUpdateTime();
+	if (next_time == INVALID_UPDATE_TIME) {
+		m_update_heap.Remove(sid);
+		return;
+	}
+
+	next_time = std::max(next_time,
+		entry.last_update_ts + SESSION_UPDATE_INTERVAL);
+
+	if (!m_update_heap.Update(sid, next_time)) {
+		m_update_heap.Push(sid, next_time, &entry);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Only sessions with due work are touched
+//------------------------------------------------------------------------------
+void SessionThread::UpdateDueSessions()
+{
+	uint64_t now = util::Now();
+
+	while (!m_update_heap.Empty() && m_update_heap.TopKey() <= now) {
+		SessionId sid = m_update_heap.TopId();
+		SessionEntry* entry = m_update_heap.Top();
+		m_update_heap.Pop();
+
+		entry->last_update_ts = now;
+		entry->session->OnUpdate();
+
+		ScheduleUpdate(sid, *entry);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Sending thread, UDP packets of all due sessions are collected and flushed
+// once per tick
 //------------------------------------------------------------------------------
 void SessionThread::SendingProc()
 {
+  std::vector<ISendEntrySP> entries;
+  entries.reserve(SENDING_QUEUE_BATCH_SIZE);
+
+  UdpSendBatch send_batch;
+  UdpSendBatch::SetCurrent(&send_batch);
+
   while (!m_stop) {
-    ISendEntrySP send_entry = m_sending_que->GetNextEntry();
-    if (send_entry) {
+    // Block until some entries are due, false means queue stopped
+    if (!m_sending_que->GetDueEntries(entries, SENDING_QUEUE_BATCH_SIZE)) {
+      break;
+    }
+
+    for (auto& entry : entries) {
       // Do send data
-      send_entry->SendData();
+      entry->SendData();
       // Has more data to be sent
-      if (send_entry->NextSendTime() != INVALID_SEND_TIME) {
-        m_sending_que->AddEntry(send_entry);
+      if (entry->NextSendTime() != INVALID_SEND_TIME) {
+        m_sending_que->AddEntry(entry);
       }
     }
+
+    send_batch.Flush();
   }
+
+  send_batch.Flush();
+  UdpSendBatch::SetCurrent(nullptr);
 }
 
 //------------------------------------------------------------------------------
@@ -230,20 +449,21 @@ void SessionThread::ThreadProc()
 	LOG_INF("Enter session thread:{}", m_thread_index);
 
   com::CommonMsg msg;
-  uint64_t next_update = 0, now = 0, wait_time = 0;
+  uint64_t now = 0;
+  int64_t wait_time = 0;
 
   while (!m_stop) {
-    now = util::Now();
+    UpdateDueSessions();
 
-    // Update loop
-    if (next_update <= now) {
-      for (auto iter : m_sessions) {
-        iter.second.session->OnUpdate();
-      }
-      next_update = now + SESSION_UPDATE_INTERVAL;
+    // Wait until the earliest update time, wait forever if no session to update
+    if (m_update_heap.Empty()) {
+      wait_time = -1;
+    }
+    else {
+      now = util::Now();
+      uint64_t next_time = m_update_heap.TopKey();
+      wait_time = next_time > now ? next_time - now : 0;
     }
-
-    wait_time = next_update > now ? next_update - now : 0;
 
     if (m_msg_queue.wait_dequeue_timed(msg, wait_time)) {
       if (msg.msg_type == QUIT_THREAD_MSG) {
@@ -8,12 +8,16 @@
 #include "if-session.h"
 #include "if-timer-mgr.h"
 #include "if-sending-queue.h"
+#include "if-udp-mgr.h"
+#include "common/indexed-heap.h"
 
 namespace jukey::net
 {
 
 //==============================================================================
-// 
+// Sessions are processed in its own message thread, or in the event thread of
+// UDP shard with the same index if created with UDP manager (sharded mode),
+// then received data is processed to completion without thread switching.
 //==============================================================================
 class SessionThread 
 	: public util::ConcurrentThread
@@ -21,16 +25,34 @@ class SessionThread
 {
 public:
 	SessionThread(base::IComFactory* factory, uint32_t index);
+	SessionThread(base::IComFactory* factory, uint32_t index, IUdpMgr* udp_mgr);
 	~SessionThread();
 
 	void Start();
 	void Stop();
 
+	// ConcurrentThread, message is posted to shard in sharded mode
+	virtual bool PostMsg(const com::CommonMsg& msg) override;
+
+	//
+	// @brief Add session and process received data directly, only used in
+	//        sharded mode and must be called in the event thread of shard
+	//
+	void AddSessionInShard(ISessionSP session);
+	void RecvDataInShard(SessionId sid, const com::Buffer& buf);
+
 private:
+	void DoAddSession(ISessionSP session);
+	void DoRecvData(SessionId sid, const com::Buffer& buf);
+	void OnShardMsg(const com::CommonMsg& msg);
+	void OnShardTimer(uint64_t timer_ts);
+	void StartShardTimer();
+
 	void OnRecvSessionData(const com::CommonMsg& msg);
 	void OnAddSession(const com::CommonMsg& msg);
 	void OnRemoveSession(const com::CommonMsg& msg);
 	void OnSendSessionData(const com::CommonMsg& msg);
+	void OnSendSessionBatch(const com::CommonMsg& msg);
 	void OnAllocSessionId(const com::CommonMsg& msg);
 
 	// ConcurrentThread
@@ -43,19 +65,32 @@ private:
 private:
 	struct SessionEntry
 	{
-		SessionEntry(ISessionSP s, bool in) : session(s), in_sending_que(in) {}
+		SessionEntry(ISessionSP s) : session(s) {}
 
 		ISessionSP session;
-		bool in_sending_que = false;
+		uint64_t last_update_ts = 0;
 	};
 
+	void ScheduleUpdate(SessionId sid, SessionEntry& entry);
+	void UpdateDueSessions();
+
 private:
 	std::unordered_map<SessionId, SessionEntry> m_sessions;
 
+	// Key is next update time, value points to the entry in m_sessions, and is
+	// removed before the entry is erased
+	util::IndexedHeap<SessionId, SessionEntry*> m_update_heap;
+
 	ISendQueueUP m_sending_que;
 
 	uint32_t m_thread_index = 0;
 
+	// Not null in sharded mode
+	IUdpMgr* m_udp_mgr = nullptr;
+
+	// Earliest pending update timer of shard
+	uint64_t m_timer_ts = INVALID_UPDATE_TIME;
+
 	base::IComFactory* m_factory = nullptr;
 
 	std::thread* m_sending_thread = nullptr;
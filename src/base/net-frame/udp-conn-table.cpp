@@ -0,0 +1,217 @@
+#include <cstring>
+
+#include "udp-conn-table.h"
+
+#ifdef _WIN32
+#include <Winsock2.h>
+#include <Ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// MurmurHash3 finalizer
+//------------------------------------------------------------------------------
+uint64_t Mix64(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint32_t RoundUpPowerOfTwo(uint32_t value)
+{
+	uint32_t result = 16;
+	while (result < value) {
+		result <<= 1;
+	}
+	return result;
+}
+
+}
+
+namespace jukey::net
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool ParseBinEndpoint(const com::Endpoint& ep, BinEndpoint& bep)
+{
+	memset(bep.addr, 0, sizeof(bep.addr));
+	bep.port = ep.port;
+
+	if (inet_pton(AF_INET, ep.host.c_str(), bep.addr + 12) == 1) {
+		bep.addr[10] = 0xff;
+		bep.addr[11] = 0xff;
+		return true;
+	}
+
+	return inet_pton(AF_INET6, ep.host.c_str(), bep.addr) == 1;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+com::Endpoint FormatBinEndpoint(const BinEndpoint& bep)
+{
+	static const uint8_t kMappedPrefix[12] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+	char host[INET6_ADDRSTRLEN] = { 0 };
+	if (memcmp(bep.addr, kMappedPrefix, sizeof(kMappedPrefix)) == 0) {
+		inet_ntop(AF_INET, (void*)(bep.addr + 12), host, sizeof(host));
+	}
+	else {
+		inet_ntop(AF_INET6, (void*)bep.addr, host, sizeof(host));
+	}
+
+	return com::Endpoint(host, bep.port);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint64_t UdpConnKey::Hash() const
+{
+	uint64_t high = 0;
+	uint64_t low = 0;
+	memcpy(&high, rep.addr, sizeof(high));
+	memcpy(&low, rep.addr + 8, sizeof(low));
+
+	return Mix64(high ^ Mix64(low ^ ((uint64_t)rep.port << 32)
+		^ (uint64_t)sock));
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+UdpConnTable::UdpConnTable(uint32_t capacity)
+{
+	m_slots.resize(RoundUpPowerOfTwo(capacity));
+	m_mask = static_cast<uint32_t>(m_slots.size() - 1);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void UdpConnTable::InsertSlot(const Slot& slot)
+{
+	uint32_t index = static_cast<uint32_t>(slot.hash) & m_mask;
+	while (m_slots[index].sid != INVALID_SESSION_ID) {
+		index = (index + 1) & m_mask;
+	}
+	m_slots[index] = slot;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void UdpConnTable::Grow()
+{
+	std::vector<Slot> old_slots(m_slots.size() * 2);
+	old_slots.swap(m_slots);
+	m_mask = static_cast<uint32_t>(m_slots.size() - 1);
+
+	for (const auto& slot : old_slots) {
+		if (slot.sid != INVALID_SESSION_ID) {
+			InsertSlot(slot);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool UdpConnTable::Insert(const UdpConnKey& key, SessionId sid)
+{
+	if (sid == INVALID_SESSION_ID) {
+		return false;
+	}
+
+	if (Find(key) != INVALID_SESSION_ID) {
+		return false;
+	}
+
+	if ((uint64_t)(m_size + 1) * 100 > (uint64_t)m_slots.size() * kMaxLoadPercent) {
+		Grow();
+	}
+
+	Slot slot;
+	slot.key = key;
+	slot.hash = key.Hash();
+	slot.sid = sid;
+	InsertSlot(slot);
+
+	++m_size;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+SessionId UdpConnTable::Find(const UdpConnKey& key) const
+{
+	uint64_t hash = key.Hash();
+	uint32_t index = static_cast<uint32_t>(hash) & m_mask;
+
+	while (m_slots[index].sid != INVALID_SESSION_ID) {
+		if (m_slots[index].hash == hash && m_slots[index].key == key) {
+			return m_slots[index].sid;
+		}
+		index = (index + 1) & m_mask;
+	}
+
+	return INVALID_SESSION_ID;
+}
+
+//------------------------------------------------------------------------------
+// Shift following entries back instead of leaving tombstones, so lookup cost
+// does not degrade with session churn
+//------------------------------------------------------------------------------
+bool UdpConnTable::Remove(const UdpConnKey& key)
+{
+	uint64_t hash = key.Hash();
+	uint32_t index = static_cast<uint32_t>(hash) & m_mask;
+
+	while (true) {
+		if (m_slots[index].sid == INVALID_SESSION_ID) {
+			return false;
+		}
+		if (m_slots[index].hash == hash && m_slots[index].key == key) {
+			break;
+		}
+		index = (index + 1) & m_mask;
+	}
+
+	uint32_t hole = index;
+	uint32_t next = (hole + 1) & m_mask;
+
+	while (m_slots[next].sid != INVALID_SESSION_ID) {
+		uint32_t home = static_cast<uint32_t>(m_slots[next].hash) & m_mask;
+
+		// Entry can move to the hole only if its home is not in (hole, next]
+		if (((next - home) & m_mask) >= ((next - hole) & m_mask)) {
+			m_slots[hole] = m_slots[next];
+			hole = next;
+		}
+		next = (next + 1) & m_mask;
+	}
+
+	m_slots[hole] = Slot();
+	--m_size;
+
+	return true;
+}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <inttypes.h>
+
+#include "common-struct.h"
+#include "net-public.h"
+#include "if-udp-mgr.h"
+
+namespace jukey::net
+{
+
+//
+// @brief Parse binary endpoint from string endpoint
+// @return false:invalid IPv4/IPv6 host
+//
+bool ParseBinEndpoint(const com::Endpoint& ep, BinEndpoint& bep);
+
+//
+// @brief Format binary endpoint to string endpoint
+//
+com::Endpoint FormatBinEndpoint(const BinEndpoint& bep);
+
+//==============================================================================
+// UDP connection key: local socket and remote endpoint
+//==============================================================================
+struct UdpConnKey
+{
+	UdpConnKey() {}
+	UdpConnKey(SocketId s, const BinEndpoint& ep) : sock(s), rep(ep) {}
+
+	bool operator==(const UdpConnKey& key) const
+	{
+		return sock == key.sock && rep == key.rep;
+	}
+
+	uint64_t Hash() const;
+
+	SocketId sock = INVALID_SOCKET_ID;
+	BinEndpoint rep;
+};
+
+//==============================================================================
+// Flat open-addressing table (linear probing, backward shift deletion) used
+// for UDP session demux, no allocation on lookup. Not thread-safe.
+//==============================================================================
+class UdpConnTable
+{
+public:
+	UdpConnTable(uint32_t capacity = 1024);
+
+	//
+	// @brief Insert connection
+	// @return false:connection exists
+	//
+	bool Insert(const UdpConnKey& key, SessionId sid);
+
+	//
+	// @brief Find session of connection
+	// @return INVALID_SESSION_ID:not found
+	//
+	SessionId Find(const UdpConnKey& key) const;
+
+	//
+	// @brief Remove connection
+	// @return false:not found
+	//
+	bool Remove(const UdpConnKey& key);
+
+	uint32_t Size() const { return m_size; }
+
+private:
+	struct Slot
+	{
+		UdpConnKey key;
+		uint64_t hash = 0;
+		SessionId sid = INVALID_SESSION_ID; // INVALID_SESSION_ID: empty slot
+	};
+
+	void Grow();
+	void InsertSlot(const Slot& slot);
+
+private:
+	std::vector<Slot> m_slots;
+	uint32_t m_mask = 0;
+	uint32_t m_size = 0;
+
+	// Keep load factor below 1/2 to make probing sequence short
+	static const uint32_t kMaxLoadPercent = 50;
+};
+
+}
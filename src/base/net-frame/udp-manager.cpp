@@ -9,6 +9,19 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#else
+#include <Ws2tcpip.h>
 #endif
 
 namespace
@@ -21,13 +34,13 @@ using namespace jukey::net;
 //------------------------------------------------------------------------------
 void SocketCallback(Socket sock, short ev, void* arg)
 {
-	UdpManager* obj = static_cast<UdpManager*>(arg);
+	UdpShard* shard = static_cast<UdpShard*>(arg);
 
 	if (ev & EV_WRITE) {
 		LOG_INF("EV_WRITE");
 	}
 	else if (ev & EV_READ) {
-		obj->OnReadData(sock);
+		shard->Manager()->OnReadData(*shard, sock);
 	}
 	else if (ev & EV_CLOSED) {
 		LOG_INF("EV_CLOSED");
@@ -37,18 +50,272 @@ void SocketCallback(Socket sock, short ev, void* arg)
 	}
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TaskCallback(Socket sock, short ev, void* arg)
+{
+	static_cast<UdpShard*>(arg)->RunTasks();
+}
+
+//------------------------------------------------------------------------------
+// One-shot timer owns the task
+//------------------------------------------------------------------------------
+void DelayedTaskCallback(Socket sock, short ev, void* arg)
+{
+	UdpShardTask* task = static_cast<UdpShardTask*>(arg);
+	(*task)();
+	delete task;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+std::string GetUdpShardName(uint32_t index)
+{
+	return std::string("UdpShard_").append(std::to_string(index));
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool IsWouldBlock(int64_t error)
+{
+#ifdef _WINDOWS
+	return error == WSAEWOULDBLOCK;
+#else
+	return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Host string fits in std::string SSO buffer, no heap allocation
+//------------------------------------------------------------------------------
+jukey::com::Endpoint ToEndpoint(const struct sockaddr_in& addr)
+{
+	char host[INET_ADDRSTRLEN] = { 0 };
+	inet_ntop(AF_INET, (void*)&addr.sin_addr, host, sizeof(host));
+
+	return jukey::com::Endpoint(host, ntohs(addr.sin_port));
+}
+
+//------------------------------------------------------------------------------
+// Copy address as IPv4-mapped IPv6 address, no formatting
+//------------------------------------------------------------------------------
+jukey::net::BinEndpoint ToBinEndpoint(const struct sockaddr_in& addr)
+{
+	jukey::net::BinEndpoint bep;
+	bep.addr[10] = 0xff;
+	bep.addr[11] = 0xff;
+	memcpy(bep.addr + 12, &addr.sin_addr, 4);
+	bep.port = ntohs(addr.sin_port);
+
+	return bep;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void ToSockAddr(const jukey::com::Endpoint& ep, struct sockaddr_in& sin)
+{
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = GetSinAddr(ep);
+	sin.sin_port = htons(ep.port);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool SendTo(Socket sock, const struct sockaddr_in& sin,
+	const jukey::com::Buffer& buf)
+{
+	int res = sendto(sock, (char*)(buf.data.get() + buf.start_pos), buf.data_len,
+		0, (sockaddr*)&sin, sizeof(sin));
+	if (res <= 0) {
+		LOG_ERR("sendto failed, error:{}", jukey::util::GetError());
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// UDP_SEGMENT is available since Linux 4.18
+//------------------------------------------------------------------------------
+bool ProbeGso()
+{
+#ifdef _LINUX
+	Socket sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock == -1) {
+		return false;
+	}
+
+	int seg_size = MAX_FRAG_SIZE;
+	bool supported = (0 == setsockopt(sock, SOL_UDP, UDP_SEGMENT, &seg_size,
+		sizeof(seg_size)));
+	close(sock);
+
+	return supported;
+#else
+	return false;
+#endif
+}
+
 }
 
 namespace jukey::net
 {
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+UdpShard::UdpShard(UdpManager* mgr, uint32_t index, uint32_t recv_pool_size)
+	: CommonThread(GetUdpShardName(index), true)
+	, m_mgr(mgr)
+	, m_index(index)
+	, m_recv_pool(UDP_RECV_POOL_BUF_LEN, recv_pool_size)
+	, m_recv_spill(UDP_RECV_BATCH_SIZE * RecvSpillLen())
+{
+}
+
+//------------------------------------------------------------------------------
+// Base class can not stop the thread by the overwritten DoStopThread
+//------------------------------------------------------------------------------
+UdpShard::~UdpShard()
+{
+	Stop();
+
+	if (m_task_ev) {
+		event_free(m_task_ev);
+	}
+
+	if (m_ev_base) {
+		event_base_free(m_ev_base);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint8_t* UdpShard::RecvSpill(uint32_t index)
+{
+	return m_recv_spill.data() + index * RecvSpillLen();
+}
+
+//------------------------------------------------------------------------------
+// Pooled buffer plus spill area can hold the largest datagram
+//------------------------------------------------------------------------------
+uint32_t UdpShard::RecvSpillLen()
+{
+	return UDP_RECV_BUF_LEN - UDP_RECV_POOL_BUF_LEN;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool UdpShard::Init()
+{
+	m_ev_base = event_base_new();
+	if (!m_ev_base) {
+		LOG_ERR("Create event base of shard {} failed!", m_index);
+		return false;
+	}
+
+	m_task_ev = event_new(m_ev_base, -1, 0, TaskCallback, this);
+	if (!m_task_ev) {
+		LOG_ERR("Create task event of shard {} failed!", m_index);
+		return false;
+	}
+
+	StartThread();
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void UdpShard::Stop()
+{
+	StopThread();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void UdpShard::DoStopThread()
+{
+	m_stop = true;
+
+	if (m_ev_base) {
+		event_base_loopbreak(m_ev_base);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Event base is locked, so it is safe to activate event or add timer from any
+// thread
+//------------------------------------------------------------------------------
+void UdpShard::PostTask(const UdpShardTask& task, uint64_t delay_us)
+{
+	if (delay_us == 0) {
+		bool first = false;
+		{
+			std::lock_guard<std::mutex> lock(m_task_mutex);
+			first = m_tasks.empty();
+			m_tasks.push_back(task);
+		}
+		if (first) {
+			event_active(m_task_ev, EV_READ, 0);
+		}
+	}
+	else {
+		struct timeval tv;
+		tv.tv_sec = static_cast<long>(delay_us / 1000000);
+		tv.tv_usec = static_cast<long>(delay_us % 1000000);
+
+		if (0 != event_base_once(m_ev_base, -1, EV_TIMEOUT, DelayedTaskCallback,
+			new UdpShardTask(task), &tv)) {
+			LOG_ERR("Add delayed task to shard {} failed!", m_index);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// Tasks posted while running are left to the next activation
+//------------------------------------------------------------------------------
+void UdpShard::RunTasks()
+{
+	std::vector<UdpShardTask> tasks;
+	{
+		std::lock_guard<std::mutex> lock(m_task_mutex);
+		tasks.swap(m_tasks);
+	}
+
+	for (auto& task : tasks) {
+		task();
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void UdpShard::ThreadProc()
+{
+	LOG_INF("Enter udp shard thread:{}", m_index);
+
+	event_base_loop(m_ev_base, EVLOOP_NO_EXIT_ON_EMPTY);
+
+	LOG_INF("Exit udp shard thread:{}", m_index);
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
 UdpManager::UdpManager(base::IComFactory* factory, const char* owner)
 	: ProxyUnknown(nullptr)
   , ComObjTracer(factory, CID_UDP_MGR, owner)
-	, CommonThread("UdpManager", true)
 {
 }
 
@@ -90,67 +357,172 @@ void* UdpManager::NDQueryInterface(const char* riid)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void UdpManager::OnReadData(Socket sock)
+bool UdpManager::GetLocalEndpoint(Socket sock, com::Endpoint& ep)
 {
-	com::Buffer recv_buf(UDP_RECV_BUF_LEN);
-	int size = sizeof(struct sockaddr);
-	struct sockaddr_in addr;
-  com::Endpoint local_ep;
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-  // Must exist
-  m_mutex.lock();
-  auto iter = m_sock_items.find(sock);
-  if (iter == m_sock_items.end()) {
-    LOG_ERR("Cannot find sock item:{}", sock);
-    m_mutex.unlock();
-    return;
-  }
-  else {
-    local_ep = iter->second.ep;
-    m_mutex.unlock();
-  }
+	auto iter = m_sock_items.find(sock);
+	if (iter == m_sock_items.end()) {
+		LOG_ERR("Cannot find sock item:{}", sock);
+		return false;
+	}
 
-#ifdef _WINDOWS
-	int res = recvfrom(
-		sock, 
-		(char*)recv_buf.data.get(), 
-		UDP_RECV_BUF_LEN, 
-		0, 
-		(sockaddr*)&addr, 
-		&size);
+	ep = iter->second.ep;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Datagram larger than the pooled buffer continues in the spill area, it is
+// copied into a heap buffer of its own
+//------------------------------------------------------------------------------
+com::Buffer UdpManager::TakeRecvData(UdpShard& shard, com::Buffer& buf,
+	uint32_t index, uint32_t len)
+{
+	if (len <= buf.total_len) {
+		buf.data_len = len;
+		return buf;
+	}
+
+	com::Buffer large(len);
+	memcpy(large.data.get(), buf.data.get(), buf.total_len);
+	memcpy(large.data.get() + buf.total_len, shard.RecvSpill(index),
+		len - buf.total_len);
+	large.data_len = len;
+
+	return large;
+}
+
+//------------------------------------------------------------------------------
+// Receive at most UDP_RECV_BATCH_SIZE datagrams into pooled buffers and hand
+// them to the handler, return the received datagram count
+//------------------------------------------------------------------------------
+uint32_t UdpManager::RecvBatch(UdpShard& shard, Socket sock,
+	const com::Endpoint& lep)
+{
+	com::Buffer bufs[UDP_RECV_BATCH_SIZE];
+	struct sockaddr_in addrs[UDP_RECV_BATCH_SIZE];
+	uint32_t count = 0;
+	int64_t error = 0;
+
+	memset(addrs, 0, sizeof(addrs));
+
+#ifdef _LINUX
+	struct iovec iovs[UDP_RECV_BATCH_SIZE][2];
+	struct mmsghdr msgs[UDP_RECV_BATCH_SIZE];
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for (uint32_t i = 0; i < UDP_RECV_BATCH_SIZE; i++) {
+		bufs[i] = shard.RecvPool().Alloc();
+
+		iovs[i][0].iov_base = bufs[i].data.get();
+		iovs[i][0].iov_len = bufs[i].total_len;
+		iovs[i][1].iov_base = shard.RecvSpill(i);
+		iovs[i][1].iov_len = shard.RecvSpillLen();
+
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		msgs[i].msg_hdr.msg_iov = iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 2;
+	}
+
+	int res = recvmmsg(sock, msgs, UDP_RECV_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+	if (res > 0) {
+		count = (uint32_t)res;
+		for (uint32_t i = 0; i < count; i++) {
+			// Can not happen for IPv4, but never hand out a partial datagram
+			if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+				LOG_ERR("Truncated udp data, sock:{}, len:{}", sock, msgs[i].msg_len);
+				continue; // data_len stays 0
+			}
+			bufs[i] = TakeRecvData(shard, bufs[i], i, msgs[i].msg_len);
+		}
+	}
+	else {
+		error = util::GetError();
+	}
 #else
-	int res = recvfrom(
-		sock, 
-		(char*)recv_buf.data.get(), 
-		UDP_RECV_BUF_LEN, 
-		0, 
-		(sockaddr*)&addr, 
-		(socklen_t*)&size);
+	for (; count < UDP_RECV_BATCH_SIZE; count++) {
+		bufs[count] = shard.RecvPool().Alloc();
+		int size = sizeof(addrs[count]);
+
+		WSABUF wsa_bufs[2];
+		wsa_bufs[0].buf = (char*)bufs[count].data.get();
+		wsa_bufs[0].len = bufs[count].total_len;
+		wsa_bufs[1].buf = (char*)shard.RecvSpill(count);
+		wsa_bufs[1].len = shard.RecvSpillLen();
+
+		DWORD recv_len = 0;
+		DWORD flags = 0;
+
+		int res = WSARecvFrom(
+			sock,
+			wsa_bufs,
+			2,
+			&recv_len,
+			&flags,
+			(sockaddr*)&addrs[count],
+			&size,
+			nullptr,
+			nullptr);
+		if (res != 0 || recv_len == 0) {
+			error = util::GetError();
+			break;
+		}
+		bufs[count] = TakeRecvData(shard, bufs[count], count, recv_len);
+	}
 #endif
 
-	// Remote endpoint
-	com::Endpoint remote_ep(inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+	if (count == 0) {
+		// Nothing more to read is not an error
+		if (!IsWouldBlock(error)) {
+			com::Endpoint remote_ep = ToEndpoint(addrs[0]);
+			LOG_WRN("Socket {} recv data failed, error:{}", sock, error);
+			m_udp_handler->OnSocketClosed(lep, remote_ep, sock);
+		}
+		return 0;
+	}
 
-	if (res <= 0) {
-		LOG_WRN("Socket {} recv data failed, error:{}", sock, util::GetError());
-		
-		m_udp_handler->OnSocketClosed(local_ep, remote_ep, sock);
-    return;
+	for (uint32_t i = 0; i < count; i++) {
+		if (bufs[i].data_len == 0) continue;
+
+		// Remote endpoint
+		BinEndpoint remote_ep = ToBinEndpoint(addrs[i]);
+
+		LOG_DBG("Received udp data from:{}, len = {}",
+			ToEndpoint(addrs[i]).ToStr(), bufs[i].data_len);
+
+		// Receive callback
+		m_udp_handler->OnRecvUdpData(lep, remote_ep, sock, shard.Index(),
+			bufs[i]);
 	}
-	
-	// Set data length
-  recv_buf.data_len = res;
 
-  LOG_DBG("Received udp data from:{}, len = {}", remote_ep.ToStr(), res);
+	return count;
+}
 
-  // Receive callback
-	m_udp_handler->OnRecvUdpData(local_ep, remote_ep, sock, recv_buf);
+//------------------------------------------------------------------------------
+// Drain the socket with batched receive, but give other sockets a chance
+//------------------------------------------------------------------------------
+void UdpManager::OnReadData(UdpShard& shard, Socket sock)
+{
+	com::Endpoint local_ep;
+	if (!GetLocalEndpoint(sock, local_ep)) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < UDP_RECV_MAX_BATCHES; i++) {
+		if (RecvBatch(shard, sock, local_ep) < UDP_RECV_BATCH_SIZE) {
+			break;
+		}
+	}
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-com::ErrCode UdpManager::Init(IUdpHandler* handler)
+com::ErrCode UdpManager::Init(IUdpHandler* handler, uint32_t shard_count,
+	uint32_t recv_pool_size)
 {
 	m_udp_handler = handler;
 
@@ -162,15 +534,38 @@ com::ErrCode UdpManager::Init(IUdpHandler* handler)
 	}
 
 	evthread_use_windows_threads();
+
+	// No SO_REUSEPORT load balancing
+	if (shard_count > 1) {
+		LOG_WRN("UDP sharding is not supported, shard count:{}", shard_count);
+		shard_count = 1;
+	}
+#elif defined(EVTHREAD_USE_PTHREADS_IMPLEMENTED)
+	// Shards are accessed by other threads
+	evthread_use_pthreads();
 #endif
 
-	m_ev_base = event_base_new();
-	if (!m_ev_base) {
-		LOG_ERR("Create event base failed!");
-		return com::ErrCode::ERR_CODE_FAILED;
+	if (shard_count == 0) {
+		shard_count = 1;
 	}
 
-	StartThread();
+	m_gso_enabled = ProbeGso();
+	LOG_INF("UDP GSO supported:{}", m_gso_enabled.load());
+
+	if (recv_pool_size == 0) {
+		recv_pool_size = UDP_RECV_POOL_BUF_CNT;
+	}
+
+	for (uint32_t i = 0; i < shard_count; i++) {
+		UdpShardUP shard(new UdpShard(this, i, recv_pool_size));
+		if (!shard->Init()) {
+			return com::ErrCode::ERR_CODE_FAILED;
+		}
+		m_shards.push_back(std::move(shard));
+	}
+
+	LOG_INF("UDP shard count:{}, receive pool size:{}", shard_count,
+		recv_pool_size);
 
 	return com::ErrCode::ERR_CODE_OK;
 }
@@ -178,8 +573,36 @@ com::ErrCode UdpManager::Init(IUdpHandler* handler)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-Socket UdpManager::CreateSocket(const com::Endpoint* ep)
+uint32_t UdpManager::ShardCount()
 {
+	return static_cast<uint32_t>(m_shards.size());
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void UdpManager::PostShardTask(uint32_t shard, const UdpShardTask& task,
+	uint64_t delay_us)
+{
+	if (shard >= m_shards.size()) {
+		LOG_ERR("Invalid shard:{}", shard);
+		return;
+	}
+
+	m_shards[shard]->PostTask(task, delay_us);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+Socket UdpManager::CreateSocket(const com::Endpoint* ep, uint32_t shard,
+	bool reuse_port)
+{
+	if (shard >= m_shards.size()) {
+		LOG_ERR("Invalid shard:{}", shard);
+		return INVALID_SOCKET_ID;
+	}
+
 	Socket sock = ::socket(AF_INET, SOCK_DGRAM, 0);
 	if (sock == -1) {
 		LOG_ERR("Create socket failed, error:{}", util::GetError());
@@ -195,6 +618,17 @@ Socket UdpManager::CreateSocket(const com::Endpoint* ep)
 		return INVALID_SOCKET_ID;
 	}
 
+#ifdef _LINUX
+	// Every shard binds the same address, kernel hashes remote endpoint to pick
+	// the socket
+	if (reuse_port && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (char*)&flag,
+		sizeof(flag)) < 0) {
+		LOG_ERR("setsockopt SO_REUSEPORT failed, error:{}!", util::GetError());
+		evutil_closesocket(sock);
+		return INVALID_SOCKET_ID;
+	}
+#endif
+
 	int buf_size = -1;
 	socklen_t optlen = sizeof(buf_size);
 	if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char*)&buf_size, &optlen) < 0)
@@ -240,22 +674,25 @@ Socket UdpManager::CreateSocket(const com::Endpoint* ep)
 	
 	evutil_make_socket_nonblocking(sock); // non-blocking
 
-	event* ev = event_new(m_ev_base, sock, EV_READ | EV_PERSIST, SocketCallback, this);
+	event* ev = event_new(m_shards[shard]->EventBase(), sock,
+		EV_READ | EV_PERSIST, SocketCallback, m_shards[shard].get());
 	if (!ev) {
 		LOG_ERR("Create udp listen event failed!");
 		return INVALID_SOCKET_ID;
 	}
-	event_add(ev, nullptr);
 
+	// Add item before event, the first datagram may arrive at once
   m_mutex.lock();
 	if (ep) { // udp listen
-		m_sock_items.insert(std::make_pair(sock, UdpSockItem(ev, *ep)));
+		m_sock_items.insert(std::make_pair(sock, UdpSockItem(ev, shard, *ep)));
   }
   else {
-    m_sock_items.insert(std::make_pair(sock, UdpSockItem(ev)));
+    m_sock_items.insert(std::make_pair(sock, UdpSockItem(ev, shard)));
   }
   m_mutex.unlock();
 
+	event_add(ev, nullptr);
+
 	return sock;
 }
 
@@ -264,26 +701,70 @@ Socket UdpManager::CreateSocket(const com::Endpoint* ep)
 //------------------------------------------------------------------------------
 Socket UdpManager::CreateServerSocket(const com::Endpoint& ep)
 {
-	return CreateSocket(&ep);
+	if (m_shards.size() <= 1) {
+		return CreateSocket(&ep, 0, false);
+	}
+
+	std::vector<Socket> socks;
+	for (uint32_t i = 0; i < m_shards.size(); i++) {
+		Socket sock = CreateSocket(&ep, i, true);
+		if (sock == INVALID_SOCKET_ID) {
+			for (auto s : socks) {
+				DoCloseSocket(s);
+			}
+			return INVALID_SOCKET_ID;
+		}
+		socks.push_back(sock);
+	}
+
+	LOG_INF("Create {} server sockets on {}", socks.size(), ep.ToStr());
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_server_socks.insert(std::make_pair(socks.front(), socks));
+
+	return socks.front();
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-Socket UdpManager::CreateClientSocket()
+Socket UdpManager::CreateClientSocket(uint32_t shard)
 {
-	return CreateSocket(nullptr);
+	return CreateSocket(nullptr, shard, false);
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
 void UdpManager::CloseSocket(Socket sock)
+{
+	std::vector<Socket> socks;
+
+	m_mutex.lock();
+	auto iter = m_server_socks.find(sock);
+	if (iter != m_server_socks.end()) {
+		socks.swap(iter->second);
+		m_server_socks.erase(iter);
+	}
+	else {
+		socks.push_back(sock);
+	}
+	m_mutex.unlock();
+
+	for (auto s : socks) {
+		DoCloseSocket(s);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void UdpManager::DoCloseSocket(Socket sock)
 {
   m_mutex.lock();
 	auto iter = m_sock_items.find(sock);
   if (iter != m_sock_items.end()) {
-    event_del(iter->second.ev);
+    event_free(iter->second.ev); // deleted before freed
     LOG_INF("Remove udp socket:{}, ep:{}", sock, iter->second.ep.ToStr());
     m_sock_items.erase(iter);
   }
@@ -299,6 +780,16 @@ void UdpManager::CloseSocket(Socket sock)
 #endif
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool UdpManager::FindSocket(Socket sock)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_sock_items.find(sock) != m_sock_items.end();
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -308,23 +799,15 @@ com::ErrCode UdpManager::SendData(Socket sock, const com::Endpoint& ep,
 	LOG_DBG("Send udp data, sock:{}, ep:{}, len:{}", sock, ep.ToStr(), 
     buf.data_len);
 
-  m_mutex.lock();
-  if (m_sock_items.find(sock) == m_sock_items.end()) {
-    LOG_ERR("Cannot find udp sock:{} to send data!", sock);
-    m_mutex.unlock();
-    return com::ERR_CODE_FAILED;
-  }
-  m_mutex.unlock();
+	if (!FindSocket(sock)) {
+		LOG_ERR("Cannot find udp sock:{} to send data!", sock);
+		return com::ERR_CODE_FAILED;
+	}
 
 	struct sockaddr_in sin;
-	sin.sin_family = AF_INET;
-	sin.sin_addr.s_addr = GetSinAddr(ep);
-	sin.sin_port = htons(ep.port);
+	ToSockAddr(ep, sin);
 
-	int res = sendto(sock, (char*)(buf.data.get() + buf.start_pos), buf.data_len, 
-    0, (sockaddr*)&sin, sizeof(sin));
-	if (res <= 0) {
-		LOG_ERR("sendto failed!");
+	if (!SendTo(sock, sin, buf)) {
 		return com::ErrCode::ERR_CODE_FAILED;
 	}
 
@@ -334,14 +817,159 @@ com::ErrCode UdpManager::SendData(Socket sock, const com::Endpoint& ep,
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void UdpManager::ThreadProc()
+com::ErrCode UdpManager::SendBatch(Socket sock,
+	const std::vector<UdpPacket>& pkts, uint32_t& sent_count)
 {
-	LOG_INF("Enter udp manager thread");
+	sent_count = 0;
 
-	event_base_loop(m_ev_base, EVLOOP_NO_EXIT_ON_EMPTY);
+	if (pkts.empty()) {
+		return com::ErrCode::ERR_CODE_OK;
+	}
+
+	LOG_DBG("Send udp batch, sock:{}, count:{}", sock, pkts.size());
+
+	if (!FindSocket(sock)) {
+		LOG_ERR("Cannot find udp sock:{} to send batch!", sock);
+		return com::ERR_CODE_FAILED;
+	}
+
+#ifdef _LINUX
+	return SendMmsg(sock, pkts, sent_count);
+#else
+	struct sockaddr_in sin;
+	for (size_t i = 0; i < pkts.size(); i++) {
+		// Resolve address only when destination changes
+		if (i == 0 || !(pkts[i].ep == pkts[i - 1].ep)) {
+			ToSockAddr(pkts[i].ep, sin);
+		}
+
+		if (!SendTo(sock, sin, pkts[i].buf)) {
+			return com::ErrCode::ERR_CODE_FAILED;
+		}
+		sent_count++;
+	}
 
-	LOG_INF("Exit udp manager thread");
+	return com::ErrCode::ERR_CODE_OK;
+#endif
 }
 
+#ifdef _LINUX
+//------------------------------------------------------------------------------
+// Consecutive packets to the same endpoint are merged into one GSO message,
+// all segments except the last one must have the same size.
+//------------------------------------------------------------------------------
+com::ErrCode UdpManager::SendMmsg(Socket sock,
+	const std::vector<UdpPacket>& pkts, uint32_t& sent_count)
+{
+	struct mmsghdr msgs[UDP_SEND_BATCH_SIZE];
+	struct iovec iovs[UDP_SEND_BATCH_SIZE];
+	struct sockaddr_in addrs[UDP_SEND_BATCH_SIZE];
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} ctrls[UDP_SEND_BATCH_SIZE];
+
+	// Index of the first packet of each message
+	size_t firsts[UDP_SEND_BATCH_SIZE];
+
+	size_t pos = 0;
+	while (pos < pkts.size()) {
+		bool gso = m_gso_enabled.load(std::memory_order_relaxed);
+		uint32_t msg_cnt = 0;
+		uint32_t iov_cnt = 0;
+
+		while (pos < pkts.size()
+			&& msg_cnt < UDP_SEND_BATCH_SIZE
+			&& iov_cnt < UDP_SEND_BATCH_SIZE) {
+			const UdpPacket& first = pkts[pos];
+
+			// Resolve address only when destination changes
+			if (msg_cnt > 0 && pkts[firsts[msg_cnt - 1]].ep == first.ep) {
+				addrs[msg_cnt] = addrs[msg_cnt - 1];
+			}
+			else {
+				ToSockAddr(first.ep, addrs[msg_cnt]);
+			}
+
+			struct msghdr& hdr = msgs[msg_cnt].msg_hdr;
+			memset(&hdr, 0, sizeof(hdr));
+			hdr.msg_name = &addrs[msg_cnt];
+			hdr.msg_namelen = sizeof(struct sockaddr_in);
+			hdr.msg_iov = &iovs[iov_cnt];
+			firsts[msg_cnt] = pos;
+
+			uint32_t seg_size = first.buf.data_len;
+			uint32_t seg_cnt = 0;
+			uint32_t total_len = 0;
+
+			while (pos < pkts.size() && iov_cnt < UDP_SEND_BATCH_SIZE) {
+				const UdpPacket& pkt = pkts[pos];
+
+				if (seg_cnt > 0 && (!gso
+					|| seg_cnt >= UDP_GSO_MAX_SEGMENTS
+					|| pkt.buf.data_len == 0
+					|| pkt.buf.data_len > seg_size
+					|| total_len + pkt.buf.data_len > UDP_GSO_MAX_BYTES
+					|| !(pkt.ep == first.ep))) {
+					break;
+				}
+
+				iovs[iov_cnt].iov_base = pkt.buf.data.get() + pkt.buf.start_pos;
+				iovs[iov_cnt].iov_len = pkt.buf.data_len;
+				iov_cnt++;
+				seg_cnt++;
+				total_len += pkt.buf.data_len;
+				pos++;
+
+				// Smaller segment must be the last one
+				if (pkt.buf.data_len < seg_size) break;
+			}
+			hdr.msg_iovlen = seg_cnt;
+
+			if (seg_cnt > 1) {
+				hdr.msg_control = ctrls[msg_cnt].buf;
+				hdr.msg_controllen = sizeof(ctrls[msg_cnt].buf);
+
+				struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+				cmsg->cmsg_level = SOL_UDP;
+				cmsg->cmsg_type = UDP_SEGMENT;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+				*(uint16_t*)CMSG_DATA(cmsg) = static_cast<uint16_t>(seg_size);
+			}
+
+			msg_cnt++;
+		}
+
+		uint32_t sent_cnt = 0;
+		while (sent_cnt < msg_cnt) {
+			int res = sendmmsg(sock, msgs + sent_cnt, msg_cnt - sent_cnt, 0);
+			if (res > 0) {
+				sent_cnt += res;
+				sent_count = static_cast<uint32_t>(sent_cnt < msg_cnt
+					? firsts[sent_cnt] : pos);
+				continue;
+			}
+
+			int error = errno;
+			if (error == EINTR) continue;
+
+			// GSO requires checksum offload of the egress device, fallback to
+			// normal sending and rebuild messages from the failed one
+			if (error == EIO && gso) {
+				LOG_WRN("Send GSO message failed, disable GSO");
+				m_gso_enabled = false;
+				pos = firsts[sent_cnt];
+				break;
+			}
+
+			LOG_ERR("sendmmsg failed, error:{}, unsent:{}", error,
+				pkts.size() - firsts[sent_cnt]);
+			return com::ErrCode::ERR_CODE_FAILED;
+		}
+	}
+
+	return com::ErrCode::ERR_CODE_OK;
 }
+#endif
 
+}
\ No newline at end of file
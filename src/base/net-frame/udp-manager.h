@@ -1,22 +1,79 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
 #include "event.h"
 #include "if-udp-mgr.h"
 #include "proxy-unknown.h"
 #include "com-obj-tracer.h"
 #include "thread/common-thread.h"
 #include "net-public.h"
+#include "common/buffer-pool.h"
 
 namespace jukey::net
 {
 
+class UdpManager;
+
+//==============================================================================
+// Event thread of one shard, receive buffers are only used in the thread
+//==============================================================================
+class UdpShard : public util::CommonThread
+{
+public:
+	UdpShard(UdpManager* mgr, uint32_t index, uint32_t recv_pool_size);
+	~UdpShard();
+
+	bool Init();
+	void Stop();
+
+	void PostTask(const UdpShardTask& task, uint64_t delay_us);
+	void RunTasks();
+
+	UdpManager* Manager() { return m_mgr; }
+	uint32_t Index() { return m_index; }
+	event_base* EventBase() { return m_ev_base; }
+	util::BufferPool& RecvPool() { return m_recv_pool; }
+
+	// Receives the part of datagram beyond the pooled buffer
+	uint8_t* RecvSpill(uint32_t index);
+	uint32_t RecvSpillLen();
+
+private:
+	// CommonThread
+	virtual void ThreadProc() override;
+	virtual void DoStopThread() override;
+
+private:
+	UdpManager* m_mgr = nullptr;
+
+	uint32_t m_index = 0;
+
+	event_base* m_ev_base = nullptr;
+
+	// Activated to run tasks without delay
+	event* m_task_ev = nullptr;
+
+	std::mutex m_task_mutex;
+	std::vector<UdpShardTask> m_tasks;
+
+	util::BufferPool m_recv_pool;
+
+	// One spill area for each datagram of a batch
+	std::vector<uint8_t> m_recv_spill;
+};
+typedef std::unique_ptr<UdpShard> UdpShardUP;
+
 //==============================================================================
 // 
 //==============================================================================
 class UdpManager
 	: public base::ProxyUnknown
 	, public base::ComObjTracer
-	, public util::CommonThread
 	, public IUdpMgr
 {
 public:
@@ -27,40 +84,61 @@ public:
 	COMPONENT_IUNKNOWN_IMPL
 
 	// IUdpMgr
-	virtual com::ErrCode Init(IUdpHandler* handler) override;
+	virtual com::ErrCode Init(IUdpHandler* handler, uint32_t shard_count,
+		uint32_t recv_pool_size) override;
+	virtual uint32_t ShardCount() override;
 	virtual Socket CreateServerSocket(const com::Endpoint& ep) override;
-	virtual Socket CreateClientSocket() override;
+	virtual Socket CreateClientSocket(uint32_t shard) override;
+	virtual void PostShardTask(uint32_t shard, const UdpShardTask& task,
+		uint64_t delay_us) override;
 	virtual void CloseSocket(Socket sock) override;
 	virtual com::ErrCode SendData(Socket sock, 
 		const com::Endpoint& ep,
 		com::Buffer buf) override;
+	virtual com::ErrCode SendBatch(Socket sock,
+		const std::vector<UdpPacket>& pkts, uint32_t& sent_count) override;
 
-	void OnReadData(Socket sock);
+	void OnReadData(UdpShard& shard, Socket sock);
 
 private:
-	// CommonThread
-	virtual void ThreadProc() override;
-
 	struct UdpSockItem
 	{
 		UdpSockItem() {}
-		UdpSockItem(event* v) : ev(v) {}
-		UdpSockItem(event* v, const com::Endpoint& p) : ev(v), ep(p) {}
+		UdpSockItem(event* v, uint32_t s) : ev(v), shard(s) {}
+		UdpSockItem(event* v, uint32_t s, const com::Endpoint& p)
+			: ev(v), shard(s), ep(p) {}
 
 		event* ev = nullptr;
+		uint32_t shard = 0;
 		com::Endpoint ep;
 	};
 
-	Socket CreateSocket(const com::Endpoint* ep);
+	Socket CreateSocket(const com::Endpoint* ep, uint32_t shard, bool reuse_port);
+	void DoCloseSocket(Socket sock);
+	bool GetLocalEndpoint(Socket sock, com::Endpoint& ep);
+	uint32_t RecvBatch(UdpShard& shard, Socket sock, const com::Endpoint& lep);
+	com::Buffer TakeRecvData(UdpShard& shard, com::Buffer& buf, uint32_t index,
+		uint32_t len);
+	bool FindSocket(Socket sock);
+#ifdef _LINUX
+	com::ErrCode SendMmsg(Socket sock, const std::vector<UdpPacket>& pkts,
+		uint32_t& sent_count);
+#endif
 
 private:
-	event_base* m_ev_base = nullptr;
+	std::vector<UdpShardUP> m_shards;
 
 	IUdpHandler* m_udp_handler = nullptr;
 
 	std::mutex m_mutex;
 
 	std::unordered_map<Socket, UdpSockItem> m_sock_items;
+
+	// Server socket of the first shard -> server sockets of all shards
+	std::unordered_map<Socket, std::vector<Socket>> m_server_socks;
+
+	// UDP_SEGMENT is supported by kernel and not failed on sending yet
+	std::atomic<bool> m_gso_enabled = false;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "udp-send-batch.h"
+#include "log.h"
+
+using namespace jukey::com;
+
+namespace
+{
+
+thread_local jukey::net::UdpSendBatch* t_send_batch = nullptr;
+
+}
+
+namespace jukey::net
+{
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+UdpSendBatch* UdpSendBatch::Current()
+{
+	return t_send_batch;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void UdpSendBatch::SetCurrent(UdpSendBatch* batch)
+{
+	t_send_batch = batch;
+}
+
+//------------------------------------------------------------------------------
+// Packets of one socket keep the adding order
+//------------------------------------------------------------------------------
+void UdpSendBatch::Add(IUdpMgr* udp_mgr, Socket sock, const Endpoint& ep,
+	const Buffer& buf)
+{
+	SockBatch* batch = nullptr;
+	for (auto& item : m_batches) {
+		if (item.sock == sock && item.udp_mgr == udp_mgr) {
+			batch = &item;
+			break;
+		}
+	}
+
+	if (!batch) {
+		m_batches.push_back(SockBatch());
+		batch = &m_batches.back();
+		batch->udp_mgr = udp_mgr;
+		batch->sock = sock;
+	}
+
+	batch->pkts.push_back(UdpPacket(ep, buf));
+	m_pkt_count++;
+}
+
+//------------------------------------------------------------------------------
+// Sockets idle for a whole tick are forgotten, they may have been closed
+//------------------------------------------------------------------------------
+void UdpSendBatch::Flush()
+{
+	size_t index = 0;
+	for (size_t i = 0; i < m_batches.size(); i++) {
+		SockBatch& batch = m_batches[i];
+		if (batch.pkts.empty()) continue;
+
+		uint32_t sent_count = 0;
+		if (ERR_CODE_OK != batch.udp_mgr->SendBatch(batch.sock, batch.pkts,
+			sent_count)) {
+			LOG_WRN("Send deferred batch failed, sock:{}, count:{}, sent:{}",
+				batch.sock, batch.pkts.size(), sent_count);
+		}
+		batch.pkts.clear();
+
+		if (index != i) {
+			m_batches[index] = std::move(batch);
+		}
+		++index;
+	}
+	m_batches.resize(index);
+
+	m_pkt_count = 0;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "common-struct.h"
+#include "net-public.h"
+#include "if-udp-mgr.h"
+
+namespace jukey::net
+{
+
+//==============================================================================
+// Deferred UDP send batch of one sending thread. While a batch is current in
+// the thread, session packets are collected instead of sent, and one Flush per
+// sending tick hands all packets of a socket to IUdpMgr::SendBatch. Packets of
+// many sessions sharing the server socket, such as SFU fan-out and pacing
+// bursts, go out with a few sendmmsg calls. A packet lost by a failed flush is
+// recovered by the session like any other network loss. Not thread-safe.
+//==============================================================================
+class UdpSendBatch
+{
+public:
+	//
+	// @brief Batch of current thread, null if sending directly
+	//
+	static UdpSendBatch* Current();
+
+	//
+	// @brief Make the batch current in the calling thread, null to detach
+	//
+	static void SetCurrent(UdpSendBatch* batch);
+
+	void Add(IUdpMgr* udp_mgr, Socket sock, const com::Endpoint& ep,
+		const com::Buffer& buf);
+
+	//
+	// @brief Send all collected packets, one SendBatch for each socket
+	//
+	void Flush();
+
+	uint32_t PktCount() { return m_pkt_count; }
+
+private:
+	struct SockBatch
+	{
+		IUdpMgr* udp_mgr = nullptr;
+		Socket sock = INVALID_SOCKET_ID;
+		std::vector<UdpPacket> pkts;
+	};
+
+	// Sockets are few, entries are reused across flushes
+	std::vector<SockBatch> m_batches;
+
+	uint32_t m_pkt_count = 0;
+};
+
+}
@@ -185,7 +185,7 @@ struct SigMsgHdr
 	uint32_t app;   // App ID
 	uint32_t clt;   // Client ID 
 	uint32_t usr;   // User ID
-	uint32_t grp;   // Group ID
+	uint32_t grp;   // Group ID, or channel ID of transport message
 	uint16_t ver:2; // Version
 	uint16_t c:1;   // Clear client route entry, 1:yes, 0:no
 	uint16_t u:1;   // Clear group route entry, 1:yes, 0:no
@@ -11,7 +11,15 @@
 // Session thread 
 ////////////////////////////////////////////////////////////////////////////////
 #define SESSION_THREAD_MSG_QUEUE_SIZE (4 * 1024)
-#define SESSION_UPDATE_INTERVAL       10000 //us
+#define SESSION_UPDATE_INTERVAL       10000 //us, also the ACK delay
+#define SESSION_STATS_INTERVAL        100000 //us
+#define SENDING_QUEUE_BATCH_SIZE      64 // max entries drained per wakeup
+
+////////////////////////////////////////////////////////////////////////////////
+// Session bundle
+////////////////////////////////////////////////////////////////////////////////
+#define SESSION_BUNDLE_ENABLED     0        // streams share one session per service
+#define SESSION_BUNDLE_REQ_TIMEOUT 30000000 // us, route of unanswered request
 
 ////////////////////////////////////////////////////////////////////////////////
 // Network buffer size
@@ -20,6 +28,39 @@
 #define SOCKET_RECV_BUF_LEN (1024 * 1024 * 8)
 #define UDP_RECV_BUF_LEN    (64 * 1024)
 
+////////////////////////////////////////////////////////////////////////////////
+// UDP batch receive
+////////////////////////////////////////////////////////////////////////////////
+#define UDP_RECV_BATCH_SIZE    32   // datagrams per recvmmsg
+#define UDP_RECV_MAX_BATCHES   8    // max batches per read event
+#define UDP_RECV_POOL_BUF_LEN  2048 // larger than MTU, larger datagram is
+                                    // received into the spill buffer
+#define UDP_RECV_POOL_BUF_CNT  1024 // default buffer count of each shard
+
+////////////////////////////////////////////////////////////////////////////////
+// UDP batch send
+////////////////////////////////////////////////////////////////////////////////
+#define UDP_SEND_BATCH_SIZE    64    // datagrams per sendmmsg
+#define UDP_GSO_MAX_SEGMENTS   64    // kernel limit UDP_MAX_SEGMENTS
+#define UDP_GSO_MAX_BYTES      65000 // below max UDP payload
+
+////////////////////////////////////////////////////////////////////////////////
+// Timer manager
+////////////////////////////////////////////////////////////////////////////////
+#define TIMER_WHEEL_THREAD_COUNT 4 // thread is started on demand
+
+////////////////////////////////////////////////////////////////////////////////
+// Metrics registry
+////////////////////////////////////////////////////////////////////////////////
+#define METRICS_COLLECT_INTERVAL 1000 // ms
+
+////////////////////////////////////////////////////////////////////////////////
+// SFU forwarding
+////////////////////////////////////////////////////////////////////////////////
+#define SFU_RELAY_ENABLED          1 // relay original FEC frames if adequate
+#define SFU_RELAY_SWITCH_FEEDBACKS 3 // consecutive state feedbacks to switch
+#define SFU_LAYER_UP_PERCENT       85 // bandwidth percentage for upper layer
+
 ////////////////////////////////////////////////////////////////////////////////
 // Max fragment size
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,4 +93,32 @@
 #define SEND_DATA_MAX_SIZE        8192 * 1024 // 8MB
 #define NACK_REQUEST_MAX_COUNT    256
 #define RECV_CAHCE_QUEUE_MAX_SIZE 4096
-#define RECV_WAIT_QUEUE_MAX_SIZE  4096
\ No newline at end of file
+#define RECV_WAIT_QUEUE_MAX_SIZE  4096
+
+////////////////////////////////////////////////////////////////////////////////
+// Congestion control
+////////////////////////////////////////////////////////////////////////////////
+#define CC_EXECUTOR_MAX_THREAD_COUNT 16 // executor threads, at most core count
+#define CC_MIN_PROCESS_INTERVAL      1  // ms
+#define TFB_LATE_SEQ_COUNT           1024 // late packets reported by feedback
+
+////////////////////////////////////////////////////////////////////////////////
+// Stream scheduler
+////////////////////////////////////////////////////////////////////////////////
+#define STREAM_SCHEDULER_MAX_THREAD_COUNT 16 // worker threads, at most core count
+#define STREAM_SCHEDULER_MAX_SPARE_COUNT  16 // threads serving blocked workers
+#define PIN_LINK_DEFAULT_QUEUE_SIZE       8  // frames of a queued pin link
+#define PIN_LINK_MAX_BLOCK_MS             100 // producer blocking on full link
+
+////////////////////////////////////////////////////////////////////////////////
+// Media frame
+////////////////////////////////////////////////////////////////////////////////
+#define VIDEO_FRAME_POOL_SIZE 8 // frames of a producer element held downstream
+
+////////////////////////////////////////////////////////////////////////////////
+// Record
+////////////////////////////////////////////////////////////////////////////////
+#define RECORD_QUEUE_SIZE        256         // packets queued of each stream
+#define RECORD_QUEUE_MAX_BYTES   (32 << 20)  // bytes queued of a recorder
+#define RECORD_WRITE_BUFFER_SIZE (1 << 20)   // bytes of each file write
+#define RECORD_FRAGMENT_MS       1000        // max duration of a MP4 fragment
\ No newline at end of file
@@ -63,6 +63,13 @@
   (jukey::com::ITimerMgr*)(factory)->QueryInterface(CID_TIMER_MGR, \
     IID_TIMER_MGR, "unknown")
 
+//==============================================================================
+// 
+//==============================================================================
+#define QUERY_METRICS_REGISTRY(factory) \
+  (jukey::com::IMetricsRegistry*)(factory)->QueryInterface(CID_METRICS_REGISTRY, \
+    IID_METRICS_REGISTRY, "unknown")
+
 //==============================================================================
 // DP: Data Pointer
 //==============================================================================
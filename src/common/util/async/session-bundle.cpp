@@ -0,0 +1,318 @@
+#include "session-bundle.h"
+#include "common-error.h"
+#include "common-config.h"
+#include "net-message.h"
+#include "protocol.h"
+#include "common/util-time.h"
+#include "log/util-log.h"
+
+using namespace jukey::net;
+using namespace jukey::com;
+
+namespace jukey::util
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+SessionBundle::SessionBundle(net::ISessionMgr* mgr, const com::Address& addr,
+	net::SessionType type)
+	: m_sess_mgr(mgr)
+	, m_addr(addr)
+	, m_sess_type(type)
+{
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+SessionBundle::~SessionBundle()
+{
+	if (m_session_id != INVALID_SESSION_ID) {
+		m_sess_mgr->CloseSession(m_session_id);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+net::SessionId SessionBundle::AddMember(IThread* member)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_session_id == INVALID_SESSION_ID) {
+		net::CreateParam param;
+		param.remote_addr  = m_addr;
+		param.ka_interval  = 5; // second
+		param.service_type = ServiceType::TRANSPORT;
+		param.session_type = m_sess_type;
+		param.thread       = this;
+
+		m_session_id = m_sess_mgr->CreateSession(param);
+		if (m_session_id == INVALID_SESSION_ID) {
+			UTIL_ERR("Create bundle session failed, addr:{}", m_addr.ToStr());
+			return INVALID_SESSION_ID;
+		}
+
+		UTIL_INF("Start to create bundle session:{}, addr:{}", m_session_id,
+			m_addr.ToStr());
+	}
+
+	m_members.insert(member);
+
+	// Joined after the session is created
+	if (m_created) {
+		member->PostMsg(m_create_result);
+	}
+
+	return m_session_id;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionBundle::RemoveMemberRoutes(IThread* member)
+{
+	for (auto iter = m_channels.begin(); iter != m_channels.end();) {
+		if (iter->second == member) {
+			iter = m_channels.erase(iter);
+		}
+		else {
+			++iter;
+		}
+	}
+
+	for (auto iter = m_pending_reqs.begin(); iter != m_pending_reqs.end();) {
+		if (iter->second.member == member) {
+			iter = m_pending_reqs.erase(iter);
+		}
+		else {
+			++iter;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionBundle::RemoveMember(IThread* member)
+{
+	net::SessionId close_sid = INVALID_SESSION_ID;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_members.erase(member) == 0) {
+			return;
+		}
+
+		RemoveMemberRoutes(member);
+
+		if (m_members.empty() && m_session_id != INVALID_SESSION_ID) {
+			close_sid = m_session_id;
+			m_session_id = INVALID_SESSION_ID;
+			m_created = false;
+			m_channels.clear();
+			m_pending_reqs.clear();
+		}
+	}
+
+	// Closed message may be posted back synchronously
+	if (close_sid != INVALID_SESSION_ID) {
+		UTIL_INF("Close bundle session:{}", close_sid);
+		m_sess_mgr->CloseSession(close_sid);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint32_t SessionBundle::AllocSeq(IThread* member)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint64_t now = util::Now();
+
+	// Drop routes of requests which will never be answered
+	for (auto iter = m_pending_reqs.begin(); iter != m_pending_reqs.end();) {
+		if (now > iter->second.ts + SESSION_BUNDLE_REQ_TIMEOUT) {
+			iter = m_pending_reqs.erase(iter);
+		}
+		else {
+			++iter;
+		}
+	}
+
+	uint32_t seq = ++m_cur_seq;
+	m_pending_reqs[seq] = PendingReq{ member, now };
+
+	return seq;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint32_t SessionBundle::MemberCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return static_cast<uint32_t>(m_members.size());
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionBundle::OnSessionCreateResult(const com::CommonMsg& msg)
+{
+	PCAST_COMMON_MSG_DATA(SessionCreateResultMsg);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (data->lsid != m_session_id) {
+		UTIL_WRN("Ignore create result of stale session:{}", data->lsid);
+		return;
+	}
+
+	UTIL_INF("Bundle session:{} create result:{}, members:{}", data->lsid,
+		data->result, m_members.size());
+
+	for (auto member : m_members) {
+		member->PostMsg(msg);
+	}
+
+	if (data->result) {
+		m_create_result = msg;
+		m_created = true;
+	}
+	else {
+		// Next member will try again
+		m_session_id = INVALID_SESSION_ID;
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionBundle::OnSessionClosed(const com::CommonMsg& msg)
+{
+	PCAST_COMMON_MSG_DATA(SessionClosedMsg);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (data->lsid != m_session_id) {
+		return;
+	}
+
+	UTIL_INF("Bundle session:{} closed, members:{}", data->lsid,
+		m_members.size());
+
+	for (auto member : m_members) {
+		member->PostMsg(msg);
+	}
+
+	m_session_id = INVALID_SESSION_ID;
+	m_created = false;
+	m_channels.clear();
+	m_pending_reqs.clear();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SessionBundle::OnSessionData(const com::CommonMsg& msg)
+{
+	PCAST_COMMON_MSG_DATA(SessionDataMsg);
+
+	if (data->buf.data_len < sizeof(prot::SigMsgHdr)) {
+		UTIL_ERR("Invalid bundle session data, len:{}", data->buf.data_len);
+		return;
+	}
+
+	prot::SigMsgHdr* sig_hdr = (prot::SigMsgHdr*)DP(data->buf);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (sig_hdr->grp != 0) {
+		auto iter = m_channels.find(sig_hdr->grp);
+		if (iter != m_channels.end()) {
+			// Response of a request sent after the channel is known, sequence of
+			// message initiated by service may be the same as one of other member
+			auto req_iter = m_pending_reqs.find(sig_hdr->seq);
+			if (req_iter != m_pending_reqs.end()
+				&& req_iter->second.member == iter->second) {
+				m_pending_reqs.erase(req_iter);
+			}
+
+			iter->second->PostMsg(msg);
+			return;
+		}
+	}
+
+	// Response of request sent before the channel is known
+	auto iter = m_pending_reqs.find(sig_hdr->seq);
+	if (iter == m_pending_reqs.end()) {
+		UTIL_WRN("Cannot route bundle session data, channel:{}, seq:{}, msg:{}",
+			sig_hdr->grp, sig_hdr->seq, (uint32_t)sig_hdr->mt);
+		return;
+	}
+
+	IThread* member = iter->second.member;
+	m_pending_reqs.erase(iter);
+
+	if (sig_hdr->grp != 0) {
+		m_channels[sig_hdr->grp] = member;
+	}
+
+	member->PostMsg(msg);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool SessionBundle::PostMsg(const com::CommonMsg& msg)
+{
+	switch (msg.msg_type) {
+	case NET_MSG_SESSION_CREATE_RESULT:
+		OnSessionCreateResult(msg);
+		break;
+	case NET_MSG_SESSION_CLOSED:
+		OnSessionClosed(msg);
+		break;
+	case NET_MSG_SESSION_DATA:
+		OnSessionData(msg);
+		break;
+	default:
+		UTIL_WRN("Ignore bundle session message:{}", msg.msg_type);
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Not used by session manager
+//------------------------------------------------------------------------------
+void SessionBundle::Execute(Callable callable, CallParam param)
+{
+	UTIL_ERR("Not supported");
+}
+
+//------------------------------------------------------------------------------
+// Not used by session manager
+//------------------------------------------------------------------------------
+com::ErrCode SessionBundle::ExecuteSync(SyncCallableEC callable,
+	CallParam param)
+{
+	UTIL_ERR("Not supported");
+	return ERR_CODE_FAILED;
+}
+
+//------------------------------------------------------------------------------
+// Not used by session manager
+//------------------------------------------------------------------------------
+void* SessionBundle::ExecuteSync(SyncCallableVP callable, CallParam param)
+{
+	UTIL_ERR("Not supported");
+	return nullptr;
+}
+
+}
\ No newline at end of file
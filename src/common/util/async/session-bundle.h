@@ -0,0 +1,96 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+
+#include "if-session-mgr.h"
+#include "thread/if-thread.h"
+
+namespace jukey::util
+{
+
+//==============================================================================
+// Carries all streams between a client and one transport service over a single
+// session. Members are the stream elements, they receive the same session
+// messages as with a private session. Messages from service carry the channel
+// ID in SigMsgHdr::grp and are routed to the member owning the channel; the
+// response of a login request is routed by sequence, and the channel it
+// carries is bound to the requesting member.
+//==============================================================================
+class SessionBundle : public IThread
+{
+public:
+	SessionBundle(net::ISessionMgr* mgr,
+		const com::Address& addr,
+		net::SessionType type);
+	~SessionBundle();
+
+	//
+	// @brief Join the bundle, the shared session is created by the first member
+	//        and the create result is posted to every member
+	// @return shared session ID
+	//
+	net::SessionId AddMember(IThread* member);
+
+	//
+	// @brief Leave the bundle, the session is closed with the last member
+	//
+	void RemoveMember(IThread* member);
+
+	//
+	// @brief Allocate request sequence, which is unique in the bundle, the
+	//        response with the same sequence is routed to the member
+	//
+	uint32_t AllocSeq(IThread* member);
+
+	uint32_t MemberCount();
+
+	// IThread, called by session thread
+	virtual bool PostMsg(const com::CommonMsg& msg) override;
+	virtual void Execute(Callable callable, CallParam param) override;
+	virtual com::ErrCode ExecuteSync(SyncCallableEC callable,
+		CallParam param) override;
+	virtual void* ExecuteSync(SyncCallableVP callable, CallParam param) override;
+
+private:
+	void OnSessionCreateResult(const com::CommonMsg& msg);
+	void OnSessionClosed(const com::CommonMsg& msg);
+	void OnSessionData(const com::CommonMsg& msg);
+
+	void RemoveMemberRoutes(IThread* member);
+
+private:
+	net::ISessionMgr* m_sess_mgr = nullptr;
+	com::Address m_addr;
+	net::SessionType m_sess_type = net::SessionType::INVALID;
+
+	std::mutex m_mutex;
+
+	net::SessionId m_session_id = INVALID_SESSION_ID;
+
+	// Create result of current session
+	com::CommonMsg m_create_result;
+	bool m_created = false;
+
+	std::set<IThread*> m_members;
+
+	// channel ID -> member
+	std::unordered_map<uint32_t, IThread*> m_channels;
+
+	struct PendingReq
+	{
+		IThread* member = nullptr;
+		uint64_t ts = 0;
+	};
+
+	// request sequence -> member
+	std::unordered_map<uint32_t, PendingReq> m_pending_reqs;
+
+	uint32_t m_cur_seq = 0;
+};
+typedef std::shared_ptr<SessionBundle> SessionBundleSP;
+
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include <atomic>
+
+#include "buffer-pool.h"
+
+namespace jukey::util
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+BufferPool::BufferPool(uint32_t buf_len, uint32_t buf_count)
+	: m_buf_len(buf_len)
+{
+	m_bufs.reserve(buf_count);
+	for (uint32_t i = 0; i < buf_count; i++) {
+		m_bufs.push_back(com::Buffer(buf_len));
+	}
+}
+
+//------------------------------------------------------------------------------
+// The pool holds one reference of each buffer, use count 1 means nobody else
+// is using the buffer any more.
+//------------------------------------------------------------------------------
+com::Buffer BufferPool::Alloc()
+{
+	uint32_t count = (uint32_t)m_bufs.size();
+
+	for (uint32_t i = 0; i < kMaxProbeCount && i < count; i++) {
+		com::Buffer& buf = m_bufs[m_next_index];
+		m_next_index = (m_next_index + 1) % count;
+
+		if (buf.data.use_count() == 1) {
+			// Pair with the release operation of the last holder
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			buf.start_pos = 0;
+			buf.data_len = 0;
+			return buf;
+		}
+	}
+
+	++m_miss_count;
+
+	return com::Buffer(m_buf_len);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint32_t BufferPool::BufLen() const
+{
+	return m_buf_len;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint64_t BufferPool::MissCount() const
+{
+	return m_miss_count;
+}
+
+}
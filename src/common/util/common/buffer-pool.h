@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "common-struct.h"
+
+namespace jukey::util
+{
+
+//==============================================================================
+// Fixed size buffer pool. A pooled buffer can be handed out again only after
+// all the holders released it, so the receiver can keep a buffer as long as
+// needed. When all pooled buffers are in use, fall back to heap allocation.
+// Not thread-safe, buffers should be allocated from one thread.
+//==============================================================================
+class BufferPool
+{
+public:
+	BufferPool(uint32_t buf_len, uint32_t buf_count);
+
+	//
+	// @brief Allocate a buffer with total_len equal to buf_len, data_len and
+	//        start_pos are reset to 0, data content is not cleared
+	//
+	com::Buffer Alloc();
+
+	//
+	// @brief Length of each buffer
+	//
+	uint32_t BufLen() const;
+
+	//
+	// @brief How many times fell back to heap allocation
+	//
+	uint64_t MissCount() const;
+
+private:
+	std::vector<com::Buffer> m_bufs;
+	uint32_t m_buf_len = 0;
+	uint32_t m_next_index = 0;
+	uint64_t m_miss_count = 0;
+
+	static const uint32_t kMaxProbeCount = 8;
+};
+
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <inttypes.h>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <cassert>
+
+namespace jukey::util
+{
+
+//==============================================================================
+// Indexed d-ary min-heap ordered by a uint64_t key (usually a deadline). Each
+// item is identified by an ID, so that the key of any item can be updated
+// (decrease-key or increase-key) and any item can be removed in O(log n).
+// A wider node (Arity 4) makes the heap shallower and sift-down more cache
+// friendly than a binary heap. Not thread-safe.
+//==============================================================================
+template <typename Id, typename Value, uint32_t Arity = 4>
+class IndexedHeap
+{
+	static_assert(Arity >= 2, "Arity must be at least 2");
+
+public:
+	bool Empty() const { return m_nodes.empty(); }
+
+	size_t Size() const { return m_nodes.size(); }
+
+	bool Contains(const Id& id) const
+	{
+		return m_index.find(id) != m_index.end();
+	}
+
+	//
+	// @brief Add item
+	// @return false if the ID already exists
+	//
+	bool Push(const Id& id, uint64_t key, const Value& value)
+	{
+		if (!m_index.insert(std::make_pair(id, m_nodes.size())).second) {
+			return false;
+		}
+
+		m_nodes.push_back(Node{ key, id, value });
+		SiftUp(m_nodes.size() - 1);
+
+		return true;
+	}
+
+	//
+	// @brief Update key of existing item, moves up or down as needed
+	// @return false if the ID does not exist
+	//
+	bool Update(const Id& id, uint64_t key)
+	{
+		auto iter = m_index.find(id);
+		if (iter == m_index.end()) {
+			return false;
+		}
+
+		size_t pos = iter->second;
+		uint64_t old_key = m_nodes[pos].key;
+		m_nodes[pos].key = key;
+
+		if (key < old_key) {
+			SiftUp(pos);
+		}
+		else if (key > old_key) {
+			SiftDown(pos);
+		}
+
+		return true;
+	}
+
+	//
+	// @return false if the ID does not exist
+	//
+	bool Remove(const Id& id)
+	{
+		auto iter = m_index.find(id);
+		if (iter == m_index.end()) {
+			return false;
+		}
+
+		size_t pos = iter->second;
+		m_index.erase(iter);
+
+		size_t last = m_nodes.size() - 1;
+		if (pos != last) {
+			uint64_t old_key = m_nodes[pos].key;
+			m_nodes[pos] = std::move(m_nodes[last]);
+			m_index[m_nodes[pos].id] = pos;
+			m_nodes.pop_back();
+
+			if (m_nodes[pos].key < old_key) {
+				SiftUp(pos);
+			}
+			else {
+				SiftDown(pos);
+			}
+		}
+		else {
+			m_nodes.pop_back();
+		}
+
+		return true;
+	}
+
+	//
+	// @brief Key of existing item
+	// @return false if the ID does not exist
+	//
+	bool GetKey(const Id& id, uint64_t& key) const
+	{
+		auto iter = m_index.find(id);
+		if (iter == m_index.end()) {
+			return false;
+		}
+
+		key = m_nodes[iter->second].key;
+
+		return true;
+	}
+
+	// Heap must not be empty
+	uint64_t TopKey() const { assert(!Empty()); return m_nodes.front().key; }
+	const Id& TopId() const { assert(!Empty()); return m_nodes.front().id; }
+	const Value& Top() const { assert(!Empty()); return m_nodes.front().value; }
+
+	void Pop()
+	{
+		assert(!Empty());
+		Id id = m_nodes.front().id;
+		Remove(id);
+	}
+
+	void Clear()
+	{
+		m_nodes.clear();
+		m_index.clear();
+	}
+
+private:
+	struct Node
+	{
+		uint64_t key;
+		Id id;
+		Value value;
+	};
+
+	void SiftUp(size_t pos)
+	{
+		Node node = std::move(m_nodes[pos]);
+
+		while (pos > 0) {
+			size_t parent = (pos - 1) / Arity;
+			if (m_nodes[parent].key <= node.key) {
+				break;
+			}
+			m_nodes[pos] = std::move(m_nodes[parent]);
+			m_index[m_nodes[pos].id] = pos;
+			pos = parent;
+		}
+
+		m_index[node.id] = pos;
+		m_nodes[pos] = std::move(node);
+	}
+
+	void SiftDown(size_t pos)
+	{
+		size_t size = m_nodes.size();
+		Node node = std::move(m_nodes[pos]);
+
+		while (true) {
+			size_t first = pos * Arity + 1;
+			if (first >= size) {
+				break;
+			}
+
+			// Smallest child
+			size_t last = std::min(first + Arity, size);
+			size_t child = first;
+			for (size_t i = first + 1; i < last; i++) {
+				if (m_nodes[i].key < m_nodes[child].key) {
+					child = i;
+				}
+			}
+
+			if (node.key <= m_nodes[child].key) {
+				break;
+			}
+
+			m_nodes[pos] = std::move(m_nodes[child]);
+			m_index[m_nodes[pos].id] = pos;
+			pos = child;
+		}
+
+		m_index[node.id] = pos;
+		m_nodes[pos] = std::move(node);
+	}
+
+private:
+	std::vector<Node> m_nodes;
+
+	// ID -> position in m_nodes
+	std::unordered_map<Id, size_t> m_index;
+};
+
+}
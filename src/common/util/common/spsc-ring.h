@@ -0,0 +1,124 @@
+#pragma once
+
+#include <inttypes.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace jukey::util
+{
+
+//==============================================================================
+// Bounded lock-free ring of one producer and one consumer. Items are owned
+// through pointers, so the producer can drop the oldest item to make room
+// without waiting for the consumer. Producer and consumer both claim the
+// oldest item by advancing the head, the winner takes it out of the slot.
+//==============================================================================
+template <typename T>
+class SpscRing
+{
+public:
+	explicit SpscRing(uint32_t capacity)
+		: m_capacity(capacity ? capacity : 1)
+		, m_slots(new std::atomic<T*>[m_capacity])
+	{
+		for (uint32_t i = 0; i < m_capacity; i++) {
+			m_slots[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~SpscRing()
+	{
+		std::unique_ptr<T> item;
+		while (Pop(item));
+	}
+
+	uint32_t Capacity() const { return m_capacity; }
+
+	uint32_t Size() const
+	{
+		uint64_t head = m_head.load(std::memory_order_acquire);
+		return (uint32_t)(m_tail.load(std::memory_order_acquire) - head);
+	}
+
+	bool Full() const { return Size() >= m_capacity; }
+
+	//
+	// @brief Producer only, item is moved into ring on success
+	// @return false if the ring is full
+	//
+	bool Push(std::unique_ptr<T>& item)
+	{
+		uint64_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) >= m_capacity) {
+			return false;
+		}
+
+		// Slot is claimed but may not be taken out yet, which is a few
+		// instructions away
+		std::atomic<T*>& slot = m_slots[tail % m_capacity];
+		while (slot.load(std::memory_order_acquire) != nullptr) {
+			std::this_thread::yield();
+		}
+
+		slot.store(item.release(), std::memory_order_release);
+		m_tail.store(tail + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	//
+	// @brief Producer only, removes the oldest item
+	// @return the oldest item, or null if the consumer took it first
+	//
+	std::unique_ptr<T> DropOldest()
+	{
+		uint64_t head = m_head.load(std::memory_order_acquire);
+		if (head == m_tail.load(std::memory_order_relaxed)) {
+			return nullptr;
+		}
+
+		if (!m_head.compare_exchange_strong(head, head + 1,
+			std::memory_order_acq_rel)) {
+			return nullptr;
+		}
+
+		return Take(head);
+	}
+
+	//
+	// @brief Consumer only
+	// @return false if the ring is empty
+	//
+	bool Pop(std::unique_ptr<T>& item)
+	{
+		uint64_t head = m_head.load(std::memory_order_acquire);
+		while (head != m_tail.load(std::memory_order_acquire)) {
+			if (m_head.compare_exchange_weak(head, head + 1,
+				std::memory_order_acq_rel)) {
+				item = Take(head);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	// Item is published before the tail moves past it, never null here
+	std::unique_ptr<T> Take(uint64_t index)
+	{
+		return std::unique_ptr<T>(m_slots[index % m_capacity].exchange(nullptr,
+			std::memory_order_acq_rel));
+	}
+
+private:
+	const uint32_t m_capacity;
+	std::unique_ptr<std::atomic<T*>[]> m_slots;
+
+	// Monotonic indexes, on different cache lines
+	alignas(64) std::atomic<uint64_t> m_head { 0 };
+	alignas(64) std::atomic<uint64_t> m_tail { 0 };
+};
+
+}
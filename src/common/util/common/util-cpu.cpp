@@ -0,0 +1,64 @@
+#include "util-cpu.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+namespace
+{
+
+using namespace jukey::util;
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+CpuFeatures DetectCpuFeatures()
+{
+	CpuFeatures features;
+
+#ifdef CPU_X86
+#ifdef _MSC_VER
+	int info[4] = { 0 };
+	__cpuid(info, 1);
+	features.sse2 = (info[3] & (1 << 26)) != 0;
+	features.ssse3 = (info[2] & (1 << 9)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+
+	// OS saves YMM registers
+	bool ymm = osxsave && avx && ((_xgetbv(0) & 0x6) == 0x6);
+
+	features.avx2 = avx2 && ymm;
+#else
+	// OS support of YMM registers is checked by compiler runtime
+	features.sse2 = __builtin_cpu_supports("sse2");
+	features.ssse3 = __builtin_cpu_supports("ssse3");
+	features.avx2 = __builtin_cpu_supports("avx2");
+#endif
+#endif
+
+	return features;
+}
+
+}
+
+namespace jukey::util
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+const CpuFeatures& GetCpuFeatures()
+{
+	static const CpuFeatures features = DetectCpuFeatures();
+	return features;
+}
+
+}
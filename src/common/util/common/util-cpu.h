@@ -0,0 +1,20 @@
+#pragma once
+
+namespace jukey::util
+{
+
+//
+// Instruction sets supported by both CPU and OS, AVX2 requires OS to save YMM
+// registers
+//
+struct CpuFeatures
+{
+	bool sse2 = false;
+	bool ssse3 = false;
+	bool avx2 = false;
+};
+
+// Detected on first call, all false on non-x86 CPU
+const CpuFeatures& GetCpuFeatures();
+
+}
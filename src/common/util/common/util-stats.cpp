@@ -3,6 +3,8 @@
 #include "util-stats.h"
 #include "log/util-log.h"
 #include "common/util-time.h"
+#include "common-define.h"
+#include "if-metrics-registry.h"
 
 
 
@@ -49,7 +51,13 @@ DataStats::DataStats(base::IComFactory* factory, SpdlogWrapperSP logger,
 	, m_log_prefix(log_prefix)
   , m_log_repeat(log_repeat)
 {
-	
+	if (m_factory) {
+		m_registry = QUERY_METRICS_REGISTRY(m_factory);
+	}
+
+	if (!m_registry) {
+		LOG_WRN("{} No metrics registry, stats are disabled", m_log_prefix);
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -57,23 +65,19 @@ DataStats::DataStats(base::IComFactory* factory, SpdlogWrapperSP logger,
 //------------------------------------------------------------------------------
 DataStats::~DataStats()
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
+	Stop();
 
-	if (m_timer_id != INVALID_TIMER_ID) {
-		com::ITimerMgr* timer_mgr = QUERY_TIMER_MGR(m_factory);
-		assert(timer_mgr);
-		
-		timer_mgr->StopTimer(m_timer_id);
-		timer_mgr->FreeTimer(m_timer_id);
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-		m_timer_id = INVALID_TIMER_ID;
+	for (const auto& node : m_owned_nodes) {
+		m_registry->RemoveMetric(node->metric);
 	}
 }
 
 //------------------------------------------------------------------------------
-// 
+// Called in metrics collector thread
 //------------------------------------------------------------------------------
-void DataStats::OnTimeout()
+void DataStats::OnCollect()
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
 
@@ -81,12 +85,31 @@ void DataStats::OnTimeout()
 	uint64_t diff = 0;
 	std::string stats_str;
 
-	for (auto& [id, node] : m_stats_map) {
+	for (uint32_t i = 0; i < m_stats_alloc_index; i++) {
+		StatsNode* node = m_nodes[i].load(std::memory_order_relaxed);
+		if (!node) continue;
+
 		// The time has not arrived yet
-		if (node.last_stats_time + node.param.interval * 1000 > now) {
+		if (node->last_stats_time + node->param.interval * 1000 > now) {
 			continue;
 		}
 
+		// Total and count are monotonic, interval values are the differences
+		uint64_t total_data = 0;
+		uint64_t data_count = 0;
+		if (node->counter) {
+			total_data = node->counter->Value();
+		}
+		else if (node->gauge) {
+			total_data = (uint64_t)node->gauge->Value();
+		}
+		else if (node->histogram) {
+			total_data = node->histogram->Sum();
+			data_count = node->histogram->Count();
+		}
+
+		uint64_t interval_data = total_data - node->last_total_data;
+
 		if (stats_str.empty()) {
 			stats_str.append(m_log_prefix).append(" ");
 		}
@@ -94,50 +117,47 @@ void DataStats::OnTimeout()
 			stats_str.append(", ");
 		}
 
-		stats_str.append(node.param.name).append(":[");
+		stats_str.append(node->param.name).append(":[");
 
-		if (node.param.stats_type == IAVER) { // per second
-			diff = node.interval_total_data * 1000 / node.param.interval;
+		if (node->param.stats_type == IAVER) { // per second
+			diff = interval_data * 1000 / node->param.interval;
 		}
-		else if (node.param.stats_type == IACCU) {
-			diff = node.interval_total_data;
+		else if (node->param.stats_type == IACCU) {
+			diff = interval_data;
 		}
-		else if (node.param.stats_type == TACCU) {
-			diff = node.origin_total_data;
+		else if (node->param.stats_type == TACCU) {
+			diff = total_data;
 		}
-		else if (node.param.stats_type == ISNAP) {
-			diff = node.interval_total_data;
+		else if (node->param.stats_type == ISNAP) {
+			diff = total_data;
 		}
-		else if (node.param.stats_type == ICAVG) {
-			if (node.interval_data_count != 0) {
-				diff = node.interval_total_data / node.interval_data_count;
+		else if (node->param.stats_type == ICAVG) {
+			if (data_count != node->last_data_count) {
+				diff = interval_data / (data_count - node->last_data_count);
 			}
 			else {
 				diff = 0;
 			}
 		}
-		else {
-			continue;
-		}
 
-		if (node.param.mul_factor != 0)
-			diff *= node.param.mul_factor;
+		if (node->param.mul_factor != 0)
+			diff *= node->param.mul_factor;
 
-		if (node.param.div_factor != 0)
-			diff /= node.param.div_factor;
+		if (node->param.div_factor != 0)
+			diff /= node->param.div_factor;
 
-		if (node.param.unit.empty()) {
+		if (node->param.unit.empty()) {
 			stats_str.append(std::to_string(diff));
 		}
 		else {
-			stats_str.append(std::to_string(diff)).append(node.param.unit);
+			stats_str.append(std::to_string(diff)).append(node->param.unit);
 		}
 
 		stats_str.append("]");
 			
-		node.interval_total_data = 0;
-		node.last_stats_time = now;
-		node.interval_data_count = 0;
+		node->last_total_data = total_data;
+		node->last_data_count = data_count;
+		node->last_stats_time = now;
 	}
 
 	if (!stats_str.empty()) {
@@ -156,22 +176,11 @@ void DataStats::OnTimeout()
 //------------------------------------------------------------------------------
 void DataStats::Start()
 {
-	if (!m_factory) {
+	if (!m_registry || m_hook_id != INVALID_METRICS_HOOK_ID) {
 		return;
 	}
 
-	com::ITimerMgr* timer_mgr = QUERY_TIMER_MGR(m_factory);
-	assert(timer_mgr);
-
-	com::TimerParam timer_param;
-	timer_param.timer_type  = com::TimerType::TIMER_TYPE_LOOP;
-	timer_param.timeout     = 1000;
-	timer_param.timer_name = "data stats";
-	timer_param.run_atonce = false;
-	timer_param.timer_func = [this](int64_t) { OnTimeout(); };
-	
-	m_timer_id = timer_mgr->AllocTimer(timer_param);
-	timer_mgr->StartTimer(m_timer_id);
+	m_hook_id = m_registry->AddCollectHook([this]() { OnCollect(); });
 }
 
 //------------------------------------------------------------------------------
@@ -179,11 +188,58 @@ void DataStats::Start()
 //------------------------------------------------------------------------------
 void DataStats::Stop()
 {
-	com::ITimerMgr* timer_mgr = QUERY_TIMER_MGR(m_factory);
-	if (timer_mgr && m_timer_id != INVALID_TIMER_ID) {
-		timer_mgr->StopTimer(m_timer_id);
-		timer_mgr->FreeTimer(m_timer_id);
+	if (m_registry && m_hook_id != INVALID_METRICS_HOOK_ID) {
+		m_registry->RemoveCollectHook(m_hook_id);
+		m_hook_id = INVALID_METRICS_HOOK_ID;
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void DataStats::SetMetricsScope(const std::string& prefix,
+	const StatsLabels& labels)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_metrics_prefix = prefix;
+	m_metrics_labels = labels;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool DataStats::CreateMetric(StatsNode* node)
+{
+	std::string name = "jukey_";
+	if (!m_metrics_prefix.empty()) {
+		name.append(m_metrics_prefix).append("_");
+	}
+	name.append(node->param.name);
+
+	com::MetricsLabels labels = m_metrics_labels;
+	if (labels.empty() && !m_log_prefix.empty()) {
+		labels["instance"] = m_log_prefix;
+	}
+
+	if (node->param.stats_type == ISNAP) {
+		com::GaugeSP gauge = m_registry->AddGauge(name, "", labels);
+		node->gauge = gauge.get();
+		node->metric = gauge;
+	}
+	else if (node->param.stats_type == ICAVG) {
+		// Sum and count only
+		com::HistogramSP histogram = m_registry->AddHistogram(name, "", labels, {});
+		node->histogram = histogram.get();
+		node->metric = histogram;
 	}
+	else if (node->param.stats_type != INVALID) {
+		com::CounterSP counter = m_registry->AddCounter(name, "", labels);
+		node->counter = counter.get();
+		node->metric = counter;
+	}
+
+	return node->metric != nullptr;
 }
 
 //------------------------------------------------------------------------------
@@ -191,10 +247,14 @@ void DataStats::Stop()
 //------------------------------------------------------------------------------
 StatsId DataStats::AddStats(const StatsParam& param)
 {
+	if (!m_registry) {
+		return INVALID_STATS_ID;
+	}
+
 	std::lock_guard<std::mutex> lock(m_mutex);
 
-	for (auto item : m_stats_map) {
-		if (item.second.param.name == param.name) {
+	for (const auto& node : m_owned_nodes) {
+		if (node->param.name == param.name) {
 			LOG_WRN("Stats:{} already exists!", param.name);
 			return INVALID_STATS_ID;
 		}
@@ -205,15 +265,25 @@ StatsId DataStats::AddStats(const StatsParam& param)
 		return INVALID_STATS_ID;
 	}
 
-	StatsNode node;
-	node.param = param;
-	node.start_time = util::Now();
-	node.last_stats_time = node.start_time;
+	if (m_stats_alloc_index >= kMaxStatsCount) {
+		LOG_ERR("Too many stats, max:{}", kMaxStatsCount);
+		return INVALID_STATS_ID;
+	}
 
-  // TODO: revert
-	m_stats_map.insert(std::make_pair(++m_stats_alloc_index, node));
+	StatsNodeUP node(new StatsNode());
+	node->param = param;
+	node->last_stats_time = util::Now();
 
-	return m_stats_alloc_index;
+	if (!CreateMetric(node.get())) {
+		LOG_ERR("Create metric for stats:{} failed!", param.name);
+		return INVALID_STATS_ID;
+	}
+
+	// Publish after initialized
+	m_nodes[m_stats_alloc_index].store(node.get(), std::memory_order_release);
+	m_owned_nodes.push_back(std::move(node));
+
+	return ++m_stats_alloc_index;
 }
 
 //------------------------------------------------------------------------------
@@ -223,35 +293,43 @@ void DataStats::RemoveStats(StatsId stats_id)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
 
-	if (m_stats_map.end() == m_stats_map.find(stats_id)) {
+	StatsNode* node = nullptr;
+	if (stats_id != INVALID_STATS_ID && stats_id <= m_stats_alloc_index) {
+		node = m_nodes[stats_id - 1].exchange(nullptr);
+	}
+
+	if (!node) {
 		LOG_WRN("Stats:{} does not exist!", stats_id);
 	}
 	else {
-		m_stats_map.erase(stats_id);
+		m_registry->RemoveMetric(node->metric);
 	}
 }
 
 //------------------------------------------------------------------------------
-// 
+// Lock-free, relaxed atomic update on the shard of current thread
 //------------------------------------------------------------------------------
 void DataStats::OnData(StatsId stats_id, uint32_t stats_data)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
+	if (stats_id == INVALID_STATS_ID || stats_id > kMaxStatsCount) {
+		return;
+	}
 
-	auto iter = m_stats_map.find(stats_id);
-	if (iter == m_stats_map.end()) {
+	StatsNode* node = m_nodes[stats_id - 1].load(std::memory_order_acquire);
+	if (!node) {
 		LOG_ERR("Cannot find stats:{}", stats_id);
+		return;
 	}
-	else {
-	if (iter->second.param.stats_type == ISNAP) {
-	  iter->second.interval_total_data = stats_data;
+
+	if (node->counter) {
+		node->counter->Add(stats_data);
 	}
-	else {
-	  iter->second.interval_total_data += stats_data;
-	  iter->second.origin_total_data += stats_data;
+	else if (node->gauge) {
+		node->gauge->Set(stats_data);
 	}
-	iter->second.interval_data_count++;
+	else {
+		node->histogram->Observe(stats_data);
 	}
 }
 
-}
+}
\ No newline at end of file
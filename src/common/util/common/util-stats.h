@@ -1,13 +1,25 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <map>
+#include <vector>
+#include <atomic>
 #include <mutex>
 
 #include "com-factory.h"
 #include "if-timer-mgr.h"
 #include "log/spdlog-wrapper.h"
 
+namespace jukey::com
+{
+class Metric;
+class Counter;
+class Gauge;
+class Histogram;
+class IMetricsRegistry;
+typedef uint32_t MetricsHookId;
+}
+
 namespace jukey::util
 {
 
@@ -47,7 +59,14 @@ struct StatsParam
 };
 
 //==============================================================================
-// 
+// Label name -> label value
+//==============================================================================
+typedef std::map<std::string, std::string> StatsLabels;
+
+//==============================================================================
+// Stats are registered as metrics in the process wide metrics registry and
+// updated lock-free. Stats log is written by the metrics collector thread,
+// there is no timer of each instance.
 //==============================================================================
 class DataStats : public std::enable_shared_from_this<DataStats>
 {
@@ -62,34 +81,61 @@ public:
 	void Start();
 	void Stop();
 
+	//
+	// @brief Metric name prefix and labels of stats added later, stats are
+	//        exported as "jukey_<prefix>_<name>". Log prefix is used as the
+	//        "instance" label if not set.
+	//
+	void SetMetricsScope(const std::string& prefix, const StatsLabels& labels);
+
 	StatsId AddStats(const StatsParam& param);
 
 	void RemoveStats(StatsId stats_id);
 	
 	void OnData(StatsId stats_id, uint32_t stats_data);
 
-	void OnTimeout();
-
 private:
 	struct StatsNode
 	{
 		StatsParam param;
 
-		uint64_t start_time = 0;
+		// Registered metric and its typed pointer
+		std::shared_ptr<com::Metric> metric;
+		com::Counter* counter = nullptr;
+		com::Gauge* gauge = nullptr;
+		com::Histogram* histogram = nullptr;
+
+		// Used by collector thread only
 		uint64_t last_stats_time = 0;
-		uint64_t interval_total_data = 0;
-		uint64_t origin_total_data = 0;
-		uint64_t interval_data_count = 0;
+		uint64_t last_total_data = 0;
+		uint64_t last_data_count = 0;
 	};
+	typedef std::unique_ptr<StatsNode> StatsNodeUP;
+
+	static const uint32_t kMaxStatsCount = 32;
+
+private:
+	void OnCollect();
+	bool CreateMetric(StatsNode* node);
 
 private:
-	std::unordered_map<StatsId, StatsNode> m_stats_map;
-	com::TimerId m_timer_id = INVALID_TIMER_ID;
-	std::mutex m_mutex;
 	base::IComFactory* m_factory = nullptr;
+	com::IMetricsRegistry* m_registry = nullptr;
+	com::MetricsHookId m_hook_id = 0;
+
+	// Index is stats ID - 1, lock-free lookup in OnData
+	std::atomic<StatsNode*> m_nodes[kMaxStatsCount] = {};
+
+	// Removed nodes are kept until destruction, OnData may still be using them
+	std::vector<StatsNodeUP> m_owned_nodes;
+
+	std::mutex m_mutex;
 
 	std::string m_log_prefix;
 
+	std::string m_metrics_prefix;
+	StatsLabels m_metrics_labels;
+
 	bool m_log_repeat = true;
 
 	// Check repeat log
@@ -0,0 +1,101 @@
+#include <mutex>
+#include <unordered_map>
+
+#include "fec-codec-cache.h"
+#include "luigi-fec-encoder.h"
+#include "gf-math.h"
+
+namespace
+{
+
+using namespace jukey::util;
+
+//==============================================================================
+// Entries are never removed, k and r are limited by the field size
+//==============================================================================
+struct FecCodecCache
+{
+	std::unordered_map<uint32_t, FecMatrixSP> matrices;
+	std::unordered_map<uint32_t, IFecEncoderSP> encoders;
+	std::mutex mutex;
+};
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+FecCodecCache& Cache()
+{
+	static FecCodecCache cache;
+	return cache;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint32_t CacheKey(uint32_t k, uint32_t r)
+{
+	return (k << 16) | r;
+}
+
+}
+
+namespace jukey::util
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+FecMatrixSP GetFecEncodeMatrix(uint32_t k, uint32_t r)
+{
+	FecCodecCache& cache = Cache();
+
+	std::lock_guard<std::mutex> lock(cache.mutex);
+
+	auto iter = cache.matrices.find(CacheKey(k, r));
+	if (iter != cache.matrices.end()) {
+		return iter->second;
+	}
+
+	std::shared_ptr<std::vector<uint8_t>> matrix(
+		new std::vector<uint8_t>((k + r) * k));
+	if (!GfBuildEncodeMatrix(k, k + r, matrix->data())) {
+		return nullptr;
+	}
+
+	cache.matrices.insert(std::make_pair(CacheKey(k, r), matrix));
+
+	return matrix;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+IFecEncoderSP GetFecEncoder(uint32_t k, uint32_t r)
+{
+	FecCodecCache& cache = Cache();
+
+	{
+		std::lock_guard<std::mutex> lock(cache.mutex);
+
+		auto iter = cache.encoders.find(CacheKey(k, r));
+		if (iter != cache.encoders.end()) {
+			return iter->second;
+		}
+	}
+
+	if (!GetFecEncodeMatrix(k, r)) {
+		return nullptr;
+	}
+
+	// Matrix is got from cache, so create outside the lock
+	IFecEncoderSP encoder(new LuigiFecEncoder(k, r));
+
+	std::lock_guard<std::mutex> lock(cache.mutex);
+
+	// Another thread may have created it
+	auto result = cache.encoders.insert(std::make_pair(CacheKey(k, r), encoder));
+
+	return result.first->second;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "if-fec-encoder.h"
+
+namespace jukey::util
+{
+
+typedef std::shared_ptr<const std::vector<uint8_t>> FecMatrixSP;
+
+//
+// @brief Get (k + r) * k encoding matrix, which is built once for each (k, r)
+//        and shared by all codecs in the process
+// @return nullptr if the parameters are invalid
+//
+FecMatrixSP GetFecEncodeMatrix(uint32_t k, uint32_t r);
+
+//
+// @brief Get the encoder instance of (k, r) shared in the process, encoder
+//        keeps no state between encoding and can be used by multiple threads
+//
+IFecEncoderSP GetFecEncoder(uint32_t k, uint32_t r);
+
+}
\ No newline at end of file
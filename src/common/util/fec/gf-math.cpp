@@ -0,0 +1,520 @@
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <utility>
+
+#include "gf-math.h"
+#include "common/util-cpu.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define GF_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define GF_TARGET(t)
+#else
+#define GF_TARGET(t) __attribute__((target(t)))
+#endif
+#endif
+
+namespace
+{
+
+using namespace jukey::util;
+
+// Field size limits the count of packets in one group
+const uint32_t kMaxSrcCount = 256;
+
+typedef void (*CombineFunc)(uint8_t* dst, const uint8_t* const* srcs,
+	const uint8_t* coeffs, uint32_t count, uint32_t size);
+
+//==============================================================================
+// Lookup tables, built once
+//==============================================================================
+struct GfTables
+{
+	GfTables();
+
+	uint8_t exp[2 * 255];
+	uint32_t log[256];
+	uint8_t inv[256];
+	uint8_t mul[256][256];
+
+	// Products of low and high nibbles, used by pshufb
+	alignas(16) uint8_t nib_lo[256][16];
+	alignas(16) uint8_t nib_hi[256][16];
+};
+
+//------------------------------------------------------------------------------
+// Same generation as generate_gf() of Rizzo's code
+//------------------------------------------------------------------------------
+GfTables::GfTables()
+{
+	// 1+x^2+x^3+x^4+x^8
+	const uint8_t poly = 0x1d;
+
+	uint32_t value = 1;
+	for (uint32_t i = 0; i < 255; i++) {
+		exp[i] = static_cast<uint8_t>(value);
+		log[value] = i;
+		value <<= 1;
+		if (value & 0x100) {
+			value = (value & 0xff) ^ poly;
+		}
+	}
+	log[0] = 255;
+
+	for (uint32_t i = 0; i < 255; i++) {
+		exp[i + 255] = exp[i];
+	}
+
+	inv[0] = 0;
+	inv[1] = 1;
+	for (uint32_t i = 2; i < 256; i++) {
+		inv[i] = exp[255 - log[i]];
+	}
+
+	for (uint32_t i = 0; i < 256; i++) {
+		for (uint32_t j = 0; j < 256; j++) {
+			mul[i][j] = (i == 0 || j == 0) ? 0 : exp[log[i] + log[j]];
+		}
+	}
+
+	for (uint32_t c = 0; c < 256; c++) {
+		for (uint32_t x = 0; x < 16; x++) {
+			nib_lo[c][x] = mul[c][x];
+			nib_hi[c][x] = mul[c][x << 4];
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+const GfTables& Tables()
+{
+	static const GfTables tables;
+	return tables;
+}
+
+//------------------------------------------------------------------------------
+// Scalar tail shared by all kernels
+//------------------------------------------------------------------------------
+void CombineTail(uint8_t* dst, const uint8_t* const* srcs,
+	const uint8_t* coeffs, uint32_t count, uint32_t start, uint32_t size)
+{
+	const GfTables& t = Tables();
+
+	for (uint32_t pos = start; pos < size; pos++) {
+		uint8_t acc = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			acc ^= t.mul[coeffs[i]][srcs[i][pos]];
+		}
+		dst[pos] = acc;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Multiply-accumulate one source a time through the product table, unrolled
+// like addmul1() of Rizzo's code
+//------------------------------------------------------------------------------
+void CombineScalar(uint8_t* dst, const uint8_t* const* srcs,
+	const uint8_t* coeffs, uint32_t count, uint32_t size)
+{
+	const GfTables& t = Tables();
+
+	memset(dst, 0, size);
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (coeffs[i] == 0) continue;
+
+		const uint8_t* row = t.mul[coeffs[i]];
+		const uint8_t* src = srcs[i];
+
+		uint32_t pos = 0;
+		for (; pos + 8 <= size; pos += 8) {
+			dst[pos + 0] ^= row[src[pos + 0]];
+			dst[pos + 1] ^= row[src[pos + 1]];
+			dst[pos + 2] ^= row[src[pos + 2]];
+			dst[pos + 3] ^= row[src[pos + 3]];
+			dst[pos + 4] ^= row[src[pos + 4]];
+			dst[pos + 5] ^= row[src[pos + 5]];
+			dst[pos + 6] ^= row[src[pos + 6]];
+			dst[pos + 7] ^= row[src[pos + 7]];
+		}
+		for (; pos < size; pos++) {
+			dst[pos] ^= row[src[pos]];
+		}
+	}
+}
+
+#ifdef GF_X86
+
+//------------------------------------------------------------------------------
+// Split-nibble multiply: c*x = c*(x & 0xf) ^ c*(x >> 4 << 4), each product
+// is looked up from a 16 bytes table by pshufb. Accumulate all sources in
+// registers and store once.
+//------------------------------------------------------------------------------
+GF_TARGET("ssse3")
+void CombineSsse3(uint8_t* dst, const uint8_t* const* srcs,
+	const uint8_t* coeffs, uint32_t count, uint32_t size)
+{
+	const GfTables& t = Tables();
+	const __m128i mask = _mm_set1_epi8(0x0f);
+
+	uint32_t pos = 0;
+	for (; pos + 32 <= size; pos += 32) {
+		__m128i acc0 = _mm_setzero_si128();
+		__m128i acc1 = _mm_setzero_si128();
+
+		for (uint32_t i = 0; i < count; i++) {
+			uint8_t c = coeffs[i];
+			if (c == 0) continue;
+
+			__m128i tlo = _mm_load_si128((const __m128i*)t.nib_lo[c]);
+			__m128i thi = _mm_load_si128((const __m128i*)t.nib_hi[c]);
+
+			__m128i s0 = _mm_loadu_si128((const __m128i*)(srcs[i] + pos));
+			__m128i s1 = _mm_loadu_si128((const __m128i*)(srcs[i] + pos + 16));
+
+			acc0 = _mm_xor_si128(acc0, _mm_xor_si128(
+				_mm_shuffle_epi8(tlo, _mm_and_si128(s0, mask)),
+				_mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s0, 4), mask))));
+			acc1 = _mm_xor_si128(acc1, _mm_xor_si128(
+				_mm_shuffle_epi8(tlo, _mm_and_si128(s1, mask)),
+				_mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s1, 4), mask))));
+		}
+
+		_mm_storeu_si128((__m128i*)(dst + pos), acc0);
+		_mm_storeu_si128((__m128i*)(dst + pos + 16), acc1);
+	}
+
+	CombineTail(dst, srcs, coeffs, count, pos, size);
+}
+
+//------------------------------------------------------------------------------
+// The same as SSSE3 kernel with 256 bits registers
+//------------------------------------------------------------------------------
+GF_TARGET("avx2")
+void CombineAvx2(uint8_t* dst, const uint8_t* const* srcs,
+	const uint8_t* coeffs, uint32_t count, uint32_t size)
+{
+	const GfTables& t = Tables();
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+
+	uint32_t pos = 0;
+	for (; pos + 64 <= size; pos += 64) {
+		__m256i acc0 = _mm256_setzero_si256();
+		__m256i acc1 = _mm256_setzero_si256();
+
+		for (uint32_t i = 0; i < count; i++) {
+			uint8_t c = coeffs[i];
+			if (c == 0) continue;
+
+			__m256i tlo = _mm256_broadcastsi128_si256(
+				_mm_load_si128((const __m128i*)t.nib_lo[c]));
+			__m256i thi = _mm256_broadcastsi128_si256(
+				_mm_load_si128((const __m128i*)t.nib_hi[c]));
+
+			__m256i s0 = _mm256_loadu_si256((const __m256i*)(srcs[i] + pos));
+			__m256i s1 = _mm256_loadu_si256((const __m256i*)(srcs[i] + pos + 32));
+
+			acc0 = _mm256_xor_si256(acc0, _mm256_xor_si256(
+				_mm256_shuffle_epi8(tlo, _mm256_and_si256(s0, mask)),
+				_mm256_shuffle_epi8(thi,
+					_mm256_and_si256(_mm256_srli_epi64(s0, 4), mask))));
+			acc1 = _mm256_xor_si256(acc1, _mm256_xor_si256(
+				_mm256_shuffle_epi8(tlo, _mm256_and_si256(s1, mask)),
+				_mm256_shuffle_epi8(thi,
+					_mm256_and_si256(_mm256_srli_epi64(s1, 4), mask))));
+		}
+
+		_mm256_storeu_si256((__m256i*)(dst + pos), acc0);
+		_mm256_storeu_si256((__m256i*)(dst + pos + 32), acc1);
+	}
+
+	// Less than 64 bytes left
+	if (pos < size) {
+		const uint8_t* left_srcs[kMaxSrcCount];
+		for (uint32_t i = 0; i < count; i++) {
+			left_srcs[i] = srcs[i] + pos;
+		}
+		CombineSsse3(dst + pos, left_srcs, coeffs, count, size - pos);
+	}
+
+	_mm256_zeroupper();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool CpuSupports(GfKernel kernel)
+{
+	const CpuFeatures& cpu = GetCpuFeatures();
+
+	switch (kernel) {
+	case GfKernel::GF_KERNEL_SCALAR:
+		return true;
+	case GfKernel::GF_KERNEL_SSSE3:
+		return cpu.ssse3;
+	case GfKernel::GF_KERNEL_AVX2:
+		return cpu.ssse3 && cpu.avx2;
+	default:
+		return false;
+	}
+}
+
+#else
+
+bool CpuSupports(GfKernel kernel)
+{
+	return kernel == GfKernel::GF_KERNEL_SCALAR;
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+CombineFunc KernelFunc(GfKernel kernel)
+{
+	switch (kernel) {
+#ifdef GF_X86
+	case GfKernel::GF_KERNEL_SSSE3:
+		return CombineSsse3;
+	case GfKernel::GF_KERNEL_AVX2:
+		return CombineAvx2;
+#endif
+	default:
+		return CombineScalar;
+	}
+}
+
+//==============================================================================
+// Kernel selected at runtime
+//==============================================================================
+struct GfDispatcher
+{
+	GfDispatcher()
+	{
+		if (CpuSupports(GfKernel::GF_KERNEL_AVX2)) {
+			best = GfKernel::GF_KERNEL_AVX2;
+		}
+		else if (CpuSupports(GfKernel::GF_KERNEL_SSSE3)) {
+			best = GfKernel::GF_KERNEL_SSSE3;
+		}
+		else {
+			best = GfKernel::GF_KERNEL_SCALAR;
+		}
+
+		kernel = best;
+		func = KernelFunc(best);
+	}
+
+	GfKernel best = GfKernel::GF_KERNEL_SCALAR;
+	std::atomic<GfKernel> kernel;
+	std::atomic<CombineFunc> func;
+};
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+GfDispatcher& Dispatcher()
+{
+	static GfDispatcher dispatcher;
+	return dispatcher;
+}
+
+}
+
+namespace jukey::util
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint8_t GfMul(uint8_t a, uint8_t b)
+{
+	return Tables().mul[a][b];
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint8_t GfInv(uint8_t a)
+{
+	return Tables().inv[a];
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint8_t GfExp(uint32_t power)
+{
+	return Tables().exp[power % 255];
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void GfLinearCombine(uint8_t* dst, const uint8_t* const* srcs,
+	const uint8_t* coeffs, uint32_t count, uint32_t size)
+{
+	if (count > kMaxSrcCount) {
+		return;
+	}
+
+	Dispatcher().func.load(std::memory_order_relaxed)(dst, srcs, coeffs,
+		count, size);
+}
+
+//------------------------------------------------------------------------------
+// Gauss-Jordan elimination, the inverse is unique, so the result is the same
+// as invert_mat() of Rizzo's code
+//------------------------------------------------------------------------------
+bool GfInvertMatrix(uint8_t* matrix, uint32_t k)
+{
+	const GfTables& t = Tables();
+
+	std::vector<uint8_t> inverse(k * k, 0);
+	for (uint32_t i = 0; i < k; i++) {
+		inverse[i * k + i] = 1;
+	}
+
+	for (uint32_t col = 0; col < k; col++) {
+		// Find pivot
+		uint32_t pivot = col;
+		while (pivot < k && matrix[pivot * k + col] == 0) {
+			++pivot;
+		}
+		if (pivot == k) {
+			return false; // singular
+		}
+
+		if (pivot != col) {
+			for (uint32_t i = 0; i < k; i++) {
+				std::swap(matrix[pivot * k + i], matrix[col * k + i]);
+				std::swap(inverse[pivot * k + i], inverse[col * k + i]);
+			}
+		}
+
+		// Normalize pivot row
+		uint8_t* prow = matrix + col * k;
+		uint8_t* irow = inverse.data() + col * k;
+		uint8_t c = t.inv[prow[col]];
+		if (c != 1) {
+			for (uint32_t i = 0; i < k; i++) {
+				prow[i] = t.mul[c][prow[i]];
+				irow[i] = t.mul[c][irow[i]];
+			}
+		}
+
+		// Eliminate the column of other rows
+		for (uint32_t row = 0; row < k; row++) {
+			if (row == col) continue;
+
+			uint8_t f = matrix[row * k + col];
+			if (f == 0) continue;
+
+			for (uint32_t i = 0; i < k; i++) {
+				matrix[row * k + i] ^= t.mul[f][prow[i]];
+				inverse[row * k + i] ^= t.mul[f][irow[i]];
+			}
+		}
+	}
+
+	memcpy(matrix, inverse.data(), k * k);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Rows of Vandermonde matrix are powers of 0, 1, alpha, alpha^2..., invert
+// the top k*k square and multiply the bottom n-k rows by the inverse
+//------------------------------------------------------------------------------
+bool GfBuildEncodeMatrix(uint32_t k, uint32_t n, uint8_t* matrix)
+{
+	if (k == 0 || k > n || n > 256) {
+		return false;
+	}
+
+	const GfTables& t = Tables();
+
+	std::vector<uint8_t> vdm(n * k, 0);
+	vdm[0] = 1;
+	for (uint32_t row = 0; row + 1 < n; row++) {
+		for (uint32_t col = 0; col < k; col++) {
+			vdm[(row + 1) * k + col] = t.exp[(row * col) % 255];
+		}
+	}
+
+	if (!GfInvertMatrix(vdm.data(), k)) {
+		return false;
+	}
+
+	memset(matrix, 0, k * k);
+	for (uint32_t i = 0; i < k; i++) {
+		matrix[i * k + i] = 1;
+	}
+
+	for (uint32_t row = k; row < n; row++) {
+		for (uint32_t col = 0; col < k; col++) {
+			uint8_t acc = 0;
+			for (uint32_t i = 0; i < k; i++) {
+				acc ^= t.mul[vdm[row * k + i]][vdm[i * k + col]];
+			}
+			matrix[row * k + col] = acc;
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+GfKernel GfBestKernel()
+{
+	return Dispatcher().best;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+GfKernel GfCurrentKernel()
+{
+	return Dispatcher().kernel.load();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool GfSetKernel(GfKernel kernel)
+{
+	if (!CpuSupports(kernel)) {
+		return false;
+	}
+
+	Dispatcher().kernel = kernel;
+	Dispatcher().func = KernelFunc(kernel);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+const char* GfKernelName(GfKernel kernel)
+{
+	switch (kernel) {
+	case GfKernel::GF_KERNEL_SCALAR:
+		return "scalar";
+	case GfKernel::GF_KERNEL_SSSE3:
+		return "ssse3";
+	case GfKernel::GF_KERNEL_AVX2:
+		return "avx2";
+	default:
+		return "unknown";
+	}
+}
+
+}
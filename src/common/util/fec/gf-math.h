@@ -0,0 +1,71 @@
+#pragma once
+
+#include <inttypes.h>
+
+namespace jukey::util
+{
+
+//==============================================================================
+// GF(2^8) arithmetic over polynomial 1+x^2+x^3+x^4+x^8, the same field as
+// Luigi Rizzo's FEC code, so the coding result is byte-identical
+//==============================================================================
+enum class GfKernel
+{
+	GF_KERNEL_SCALAR = 0,
+	GF_KERNEL_SSSE3  = 1,
+	GF_KERNEL_AVX2   = 2,
+};
+
+//
+// @brief Multiply two field elements
+//
+uint8_t GfMul(uint8_t a, uint8_t b);
+
+//
+// @brief Multiplicative inverse, inverse of 0 is 0
+//
+uint8_t GfInv(uint8_t a);
+
+//
+// @brief Power of the primitive element alpha
+//
+uint8_t GfExp(uint32_t power);
+
+//
+// @brief dst = coeffs[0] * srcs[0] + ... + coeffs[count - 1] * srcs[count - 1]
+//        dst must not overlap with any source
+//
+void GfLinearCombine(uint8_t* dst, const uint8_t* const* srcs,
+	const uint8_t* coeffs, uint32_t count, uint32_t size);
+
+//
+// @brief Invert a k*k row-major matrix in place
+// @return false if the matrix is singular
+//
+bool GfInvertMatrix(uint8_t* matrix, uint32_t k);
+
+//
+// @brief Build the n*k row-major systematic encoding matrix of Rizzo's
+//        Vandermonde code, top k rows are identity
+//
+bool GfBuildEncodeMatrix(uint32_t k, uint32_t n, uint8_t* matrix);
+
+//
+// @brief Best kernel supported by current CPU, selected at startup
+//
+GfKernel GfBestKernel();
+
+//
+// @brief Kernel in use
+//
+GfKernel GfCurrentKernel();
+
+//
+// @brief Force a kernel, for test only
+// @return false if the kernel is not supported by current CPU
+//
+bool GfSetKernel(GfKernel kernel);
+
+const char* GfKernelName(GfKernel kernel);
+
+}
@@ -15,5 +15,6 @@ public:
 	virtual void Encode(void* src[], void* dst[], int size) = 0;
 };
 typedef std::unique_ptr<IFecEncoder> IFecEncoderUP;
+typedef std::shared_ptr<IFecEncoder> IFecEncoderSP;
 
 }
\ No newline at end of file
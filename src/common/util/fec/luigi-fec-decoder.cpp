@@ -1,9 +1,8 @@
-#include "luigi-fec-decoder.h"
+#include <cstring>
+#include <utility>
 
-extern "C"
-{
-#include "fec.h"
-}
+#include "luigi-fec-decoder.h"
+#include "gf-math.h"
 
 
 namespace jukey::util
@@ -14,9 +13,10 @@ namespace jukey::util
 //------------------------------------------------------------------------------
 LuigiFecDecoder::LuigiFecDecoder(uint32_t k, uint32_t r)
 {
-	m_decoder = fec_new(k, k + r);
 	m_k = k;
 	m_r = r;
+
+	m_matrix = GetFecEncodeMatrix(k, r);
 }
 
 //------------------------------------------------------------------------------
@@ -24,10 +24,47 @@ LuigiFecDecoder::LuigiFecDecoder(uint32_t k, uint32_t r)
 //------------------------------------------------------------------------------
 LuigiFecDecoder::~LuigiFecDecoder()
 {
-	if (m_decoder) {
-		fec_free(m_decoder);
-		m_decoder = nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Move source packets to their position, the same as shuffle() of Rizzo's
+// code, callers depend on the reordered index
+//------------------------------------------------------------------------------
+bool LuigiFecDecoder::Shuffle(uint8_t* pkts[], int index[])
+{
+	for (uint32_t i = 0; i < m_k; ) {
+		if (index[i] >= (int)m_k || index[i] == (int)i) {
+			i++;
+		}
+		else {
+			int c = index[i];
+			if (index[c] == c) {
+				return false; // duplicated index
+			}
+			std::swap(index[i], index[c]);
+			std::swap(pkts[i], pkts[c]);
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool LuigiFecDecoder::BuildDecodeMatrix(int index[])
+{
+	m_decode_matrix.resize(m_k * m_k);
+
+	uint8_t* row = m_decode_matrix.data();
+	for (uint32_t i = 0; i < m_k; i++, row += m_k) {
+		if (index[i] < 0 || index[i] >= (int)(m_k + m_r)) {
+			return false;
+		}
+		memcpy(row, m_matrix->data() + index[i] * m_k, m_k);
 	}
+
+	return GfInvertMatrix(m_decode_matrix.data(), m_k);
 }
 
 //------------------------------------------------------------------------------
@@ -35,7 +72,47 @@ LuigiFecDecoder::~LuigiFecDecoder()
 //------------------------------------------------------------------------------
 bool LuigiFecDecoder::Decode(void* data[], int index[], int size)
 {
-	return (0 == fec_decode(m_decoder, data, index, size));
+	if (!m_matrix || size <= 0) {
+		return false;
+	}
+
+	uint8_t** pkts = (uint8_t**)data;
+
+	if (!Shuffle(pkts, index)) {
+		return false;
+	}
+
+	if (!BuildDecodeMatrix(index)) {
+		return false;
+	}
+
+	uint32_t lost_count = 0;
+	for (uint32_t i = 0; i < m_k; i++) {
+		if (index[i] >= (int)m_k) {
+			++lost_count;
+		}
+	}
+
+	// Packets are decoded in place, so decode to temporary buffer first
+	m_decode_buf.resize(lost_count * size);
+
+	uint8_t* buf = m_decode_buf.data();
+	for (uint32_t i = 0; i < m_k; i++) {
+		if (index[i] >= (int)m_k) {
+			GfLinearCombine(buf, pkts, &m_decode_matrix[i * m_k], m_k, size);
+			buf += size;
+		}
+	}
+
+	buf = m_decode_buf.data();
+	for (uint32_t i = 0; i < m_k; i++) {
+		if (index[i] >= (int)m_k) {
+			memcpy(pkts[i], buf, size);
+			buf += size;
+		}
+	}
+
+	return true;
 }
 
 }
\ No newline at end of file
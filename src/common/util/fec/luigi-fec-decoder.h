@@ -1,12 +1,16 @@
 #pragma once
 
+#include <vector>
+
+#include "fec-codec-cache.h"
 #include "if-fec-decoder.h"
 
 namespace jukey::util
 {
 
 //==============================================================================
-// 
+// Decoder of Rizzo's Vandermonde code, computed by the GF(2^8) kernel
+// selected at runtime
 //==============================================================================
 class LuigiFecDecoder : public IFecDecoder
 {
@@ -16,11 +20,20 @@ public:
 
 	// IFecDecoder
 	virtual bool Decode(void* data[], int index[], int size) override;
+
+private:
+	bool Shuffle(uint8_t* pkts[], int index[]);
+	bool BuildDecodeMatrix(int index[]);
 	
 private:
-	void* m_decoder = nullptr;
+	// (k + r) * k encoding matrix, shared by codecs with the same param
+	FecMatrixSP m_matrix;
 	uint32_t m_k = 0;
 	uint32_t m_r = 0;
+
+	// Reused between decoding
+	std::vector<uint8_t> m_decode_matrix;
+	std::vector<uint8_t> m_decode_buf;
 };
 
 }
\ No newline at end of file
@@ -1,9 +1,5 @@
 #include "luigi-fec-encoder.h"
-
-extern "C"
-{
-#include "fec.h"
-}
+#include "gf-math.h"
 
 
 namespace jukey::util
@@ -14,9 +10,10 @@ namespace jukey::util
 //------------------------------------------------------------------------------
 LuigiFecEncoder::LuigiFecEncoder(uint32_t k, uint32_t r)
 {
-	m_encoder = fec_new(k, k + r);
 	m_k = k;
 	m_r = r;
+
+	m_matrix = GetFecEncodeMatrix(k, r);
 }
 
 //------------------------------------------------------------------------------
@@ -24,10 +21,6 @@ LuigiFecEncoder::LuigiFecEncoder(uint32_t k, uint32_t r)
 //------------------------------------------------------------------------------
 LuigiFecEncoder::~LuigiFecEncoder()
 {
-	if (m_encoder) {
-		fec_free(m_encoder);
-		m_encoder = nullptr;
-	}
 }
 
 //------------------------------------------------------------------------------
@@ -35,8 +28,13 @@ LuigiFecEncoder::~LuigiFecEncoder()
 //------------------------------------------------------------------------------
 void LuigiFecEncoder::Encode(void* src[], void* dst[], int size)
 {
+	if (!m_matrix || size <= 0) {
+		return;
+	}
+
 	for (uint32_t i = m_k; i < m_k + m_r; i++) {
-		fec_encode(m_encoder, src, dst[i - m_k], i, size);
+		GfLinearCombine((uint8_t*)dst[i - m_k], (const uint8_t* const*)src,
+			m_matrix->data() + i * m_k, m_k, static_cast<uint32_t>(size));
 	}
 }
 
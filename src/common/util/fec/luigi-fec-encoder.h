@@ -1,12 +1,16 @@
 #pragma once
 
+#include <vector>
+
+#include "fec-codec-cache.h"
 #include "if-fec-encoder.h"
 
 namespace jukey::util
 {
 
 //==============================================================================
-// 
+// Rizzo's Vandermonde code, computed by the GF(2^8) kernel selected at
+// runtime. Encoding keeps no state, so one instance can be shared.
 //==============================================================================
 class LuigiFecEncoder : public IFecEncoder
 {
@@ -18,7 +22,8 @@ public:
 	virtual void Encode(void* src[], void* dst[], int size) override;
 
 private:
-	void* m_encoder = nullptr;
+	// (k + r) * k encoding matrix, shared by codecs with the same param
+	FecMatrixSP m_matrix;
 	uint32_t m_k = 0;
 	uint32_t m_r = 0;
 };
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <inttypes.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+
+#include "component.h"
+
+
+namespace jukey::com
+{
+
+#define CID_METRICS_REGISTRY "cid-metrics-registry"
+#define IID_METRICS_REGISTRY "iid-metrics-registry"
+
+// Updating threads are spread over shards to avoid cache line contention
+#define METRICS_SHARD_COUNT 16
+
+#define METRICS_CACHE_LINE_SIZE 64
+
+#define INVALID_METRICS_HOOK_ID 0
+
+//==============================================================================
+// Label name -> label value
+//==============================================================================
+typedef std::map<std::string, std::string> MetricsLabels;
+
+//==============================================================================
+//
+//==============================================================================
+enum class MetricType
+{
+	METRIC_TYPE_COUNTER   = 0,
+	METRIC_TYPE_GAUGE     = 1,
+	METRIC_TYPE_HISTOGRAM = 2,
+};
+
+//==============================================================================
+//
+//==============================================================================
+enum class MetricsFormat
+{
+	METRICS_FORMAT_PROMETHEUS = 0, // Prometheus text exposition format
+	METRICS_FORMAT_JSON       = 1,
+};
+
+//==============================================================================
+// Shard index of current thread, assigned round robin at the first use
+//==============================================================================
+inline uint32_t MetricsShardIndex()
+{
+	static std::atomic<uint32_t> next_index{ 0 };
+
+	thread_local uint32_t index =
+		next_index.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARD_COUNT;
+
+	return index;
+}
+
+//==============================================================================
+// One counter per cache line
+//==============================================================================
+struct alignas(METRICS_CACHE_LINE_SIZE) MetricsCell
+{
+	std::atomic<uint64_t> value{ 0 };
+};
+
+//==============================================================================
+// Base of all metrics, name and labels are immutable after registration
+//==============================================================================
+class Metric
+{
+public:
+	Metric(const std::string& name, const std::string& help,
+		const MetricsLabels& labels, MetricType type)
+		: m_name(name), m_help(help), m_labels(labels), m_type(type) {}
+
+	virtual ~Metric() {}
+
+	const std::string& Name() const { return m_name; }
+	const std::string& Help() const { return m_help; }
+	const MetricsLabels& Labels() const { return m_labels; }
+	MetricType Type() const { return m_type; }
+
+private:
+	const std::string m_name;
+	const std::string m_help;
+	const MetricsLabels m_labels;
+	const MetricType m_type;
+};
+typedef std::shared_ptr<Metric> MetricSP;
+
+//==============================================================================
+// Monotonic counter, updated with relaxed atomics on the shard of the caller
+//==============================================================================
+class Counter : public Metric
+{
+public:
+	Counter(const std::string& name, const std::string& help,
+		const MetricsLabels& labels)
+		: Metric(name, help, labels, MetricType::METRIC_TYPE_COUNTER) {}
+
+	void Add(uint64_t value = 1)
+	{
+		m_cells[MetricsShardIndex()].value.fetch_add(value,
+			std::memory_order_relaxed);
+	}
+
+	uint64_t Value() const
+	{
+		uint64_t value = 0;
+		for (const auto& cell : m_cells) {
+			value += cell.value.load(std::memory_order_relaxed);
+		}
+		return value;
+	}
+
+private:
+	MetricsCell m_cells[METRICS_SHARD_COUNT];
+};
+typedef std::shared_ptr<Counter> CounterSP;
+
+//==============================================================================
+// Snapshot value, the last writer wins
+//==============================================================================
+class Gauge : public Metric
+{
+public:
+	Gauge(const std::string& name, const std::string& help,
+		const MetricsLabels& labels)
+		: Metric(name, help, labels, MetricType::METRIC_TYPE_GAUGE) {}
+
+	void Set(int64_t value)
+	{
+		m_value.store(value, std::memory_order_relaxed);
+	}
+
+	void Add(int64_t value)
+	{
+		m_value.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	int64_t Value() const
+	{
+		return m_value.load(std::memory_order_relaxed);
+	}
+
+private:
+	alignas(METRICS_CACHE_LINE_SIZE) std::atomic<int64_t> m_value{ 0 };
+};
+typedef std::shared_ptr<Gauge> GaugeSP;
+
+//==============================================================================
+// Histogram with fixed upper bounds, a value falls in the first bucket whose
+// bound is not less than it, or the implicit +Inf bucket. Empty bounds make a
+// plain sum/count pair.
+//==============================================================================
+class Histogram : public Metric
+{
+public:
+	Histogram(const std::string& name, const std::string& help,
+		const MetricsLabels& labels, const std::vector<uint64_t>& bounds)
+		: Metric(name, help, labels, MetricType::METRIC_TYPE_HISTOGRAM)
+		, m_bounds(bounds)
+	{
+		std::sort(m_bounds.begin(), m_bounds.end());
+
+		// count, sum and buckets of one shard are laid out in whole cache lines
+		m_lines_per_shard = (kFirstBucketSlot + BucketCount() + kSlotsPerLine - 1)
+			/ kSlotsPerLine;
+		m_lines.reset(new CacheLine[METRICS_SHARD_COUNT * m_lines_per_shard]);
+	}
+
+	void Observe(uint64_t value)
+	{
+		uint32_t bucket = static_cast<uint32_t>(std::lower_bound(m_bounds.begin(),
+			m_bounds.end(), value) - m_bounds.begin());
+
+		uint32_t shard = MetricsShardIndex();
+		Slot(shard, kCountSlot).fetch_add(1, std::memory_order_relaxed);
+		Slot(shard, kSumSlot).fetch_add(value, std::memory_order_relaxed);
+		Slot(shard, kFirstBucketSlot + bucket).fetch_add(1,
+			std::memory_order_relaxed);
+	}
+
+	const std::vector<uint64_t>& Bounds() const { return m_bounds; }
+
+	// Including the +Inf bucket
+	uint32_t BucketCount() const
+	{
+		return static_cast<uint32_t>(m_bounds.size()) + 1;
+	}
+
+	uint64_t Count() const { return Aggregate(kCountSlot); }
+
+	uint64_t Sum() const { return Aggregate(kSumSlot); }
+
+	// Not cumulative
+	uint64_t BucketValue(uint32_t bucket) const
+	{
+		return Aggregate(kFirstBucketSlot + bucket);
+	}
+
+private:
+	static const uint32_t kSlotsPerLine = METRICS_CACHE_LINE_SIZE / 8;
+	static const uint32_t kCountSlot = 0;
+	static const uint32_t kSumSlot = 1;
+	static const uint32_t kFirstBucketSlot = 2;
+
+	struct alignas(METRICS_CACHE_LINE_SIZE) CacheLine
+	{
+		std::atomic<uint64_t> slots[kSlotsPerLine] = {};
+	};
+
+	std::atomic<uint64_t>& Slot(uint32_t shard, uint32_t slot) const
+	{
+		return m_lines[shard * m_lines_per_shard + slot / kSlotsPerLine]
+			.slots[slot % kSlotsPerLine];
+	}
+
+	uint64_t Aggregate(uint32_t slot) const
+	{
+		uint64_t value = 0;
+		for (uint32_t i = 0; i < METRICS_SHARD_COUNT; i++) {
+			value += Slot(i, slot).load(std::memory_order_relaxed);
+		}
+		return value;
+	}
+
+private:
+	std::vector<uint64_t> m_bounds;
+	uint32_t m_lines_per_shard = 0;
+	std::unique_ptr<CacheLine[]> m_lines;
+};
+typedef std::shared_ptr<Histogram> HistogramSP;
+
+//==============================================================================
+// Hook called by the collector thread before each collection
+//==============================================================================
+typedef uint32_t MetricsHookId;
+typedef std::function<void()> MetricsHook;
+
+//==============================================================================
+// Process wide metrics registry. Metrics are registered once and updated
+// lock-free, a single collector thread aggregates all shards periodically and
+// scrape requests are served from the latest aggregation.
+//==============================================================================
+class IMetricsRegistry : public base::IUnknown
+{
+public:
+	//
+	// @brief Start collector thread
+	//
+	virtual void Start() = 0;
+
+	//
+	// @brief Stop collector thread
+	//
+	virtual void Stop() = 0;
+
+	//
+	// @brief Register metrics, characters not allowed by Prometheus in name and
+	//        label names are replaced by '_'. Series with the same name and
+	//        labels are merged on collection.
+	//
+	virtual CounterSP AddCounter(const std::string& name, const std::string& help,
+		const MetricsLabels& labels) = 0;
+
+	virtual GaugeSP AddGauge(const std::string& name, const std::string& help,
+		const MetricsLabels& labels) = 0;
+
+	virtual HistogramSP AddHistogram(const std::string& name,
+		const std::string& help,
+		const MetricsLabels& labels,
+		const std::vector<uint64_t>& bounds) = 0;
+
+	//
+	// @brief Unregister metric, the object can still be updated safely
+	//
+	virtual void RemoveMetric(const MetricSP& metric) = 0;
+
+	//
+	// @brief Add hook called in collector thread every collect interval
+	//
+	virtual MetricsHookId AddCollectHook(const MetricsHook& hook) = 0;
+
+	//
+	// @brief Remove hook, hook will not be called after return
+	//
+	virtual void RemoveCollectHook(MetricsHookId hook_id) = 0;
+
+	//
+	// @brief Format the latest aggregation
+	//
+	virtual std::string Scrape(MetricsFormat format) = 0;
+};
+
+}
@@ -0,0 +1,11 @@
+#include "log.h"
+
+namespace jukey
+{
+namespace com
+{
+
+util::SpdlogWrapperSP g_logger = std::make_shared<util::SpdlogWrapper>("metrics");
+
+}
+}
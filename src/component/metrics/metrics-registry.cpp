@@ -0,0 +1,546 @@
+#include <sstream>
+#include <algorithm>
+
+#include "metrics-registry.h"
+#include "log.h"
+#include "common-config.h"
+#include "nlohmann/json.hpp"
+
+
+namespace
+{
+
+using namespace jukey::com;
+
+//------------------------------------------------------------------------------
+// Prometheus metric name: [a-zA-Z_:][a-zA-Z0-9_:]*
+// Prometheus label name: [a-zA-Z_][a-zA-Z0-9_]*
+//------------------------------------------------------------------------------
+std::string SanitizeName(const std::string& name, bool allow_colon)
+{
+	std::string result = name;
+
+	for (auto& c : result) {
+		if (!isalnum((unsigned char)c) && c != '_' && !(allow_colon && c == ':')) {
+			c = '_';
+		}
+	}
+
+	if (result.empty() || isdigit((unsigned char)result[0])) {
+		result.insert(0, "_");
+	}
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+MetricsLabels SanitizeLabels(const MetricsLabels& labels)
+{
+	MetricsLabels result;
+
+	for (const auto& [name, value] : labels) {
+		result[SanitizeName(name, false)] = value;
+	}
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+std::string EscapeText(const std::string& text, bool escape_quote)
+{
+	std::string result;
+	result.reserve(text.size());
+
+	for (auto c : text) {
+		if (c == '\\') {
+			result.append("\\\\");
+		}
+		else if (c == '\n') {
+			result.append("\\n");
+		}
+		else if (c == '"' && escape_quote) {
+			result.append("\\\"");
+		}
+		else {
+			result.push_back(c);
+		}
+	}
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// {name="value",...}, extra label is appended if not empty
+//------------------------------------------------------------------------------
+std::string FormatLabels(const MetricsLabels& labels,
+	const std::string& extra_name = "", const std::string& extra_value = "")
+{
+	if (labels.empty() && extra_name.empty()) {
+		return "";
+	}
+
+	std::string result = "{";
+
+	for (const auto& [name, value] : labels) {
+		if (result.size() > 1) {
+			result.append(",");
+		}
+		result.append(name).append("=\"").append(EscapeText(value, true))
+			.append("\"");
+	}
+
+	if (!extra_name.empty()) {
+		if (result.size() > 1) {
+			result.append(",");
+		}
+		result.append(extra_name).append("=\"").append(extra_value).append("\"");
+	}
+
+	result.append("}");
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+const char* MetricTypeName(MetricType type)
+{
+	switch (type) {
+	case MetricType::METRIC_TYPE_COUNTER:
+		return "counter";
+	case MetricType::METRIC_TYPE_GAUGE:
+		return "gauge";
+	case MetricType::METRIC_TYPE_HISTOGRAM:
+		return "histogram";
+	default:
+		return "untyped";
+	}
+}
+
+}
+
+namespace jukey::com
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+MetricsRegistry::MetricsRegistry(base::IComFactory* factory, const char* owner)
+	: base::ProxyUnknown(nullptr)
+	, base::ComObjTracer(factory, CID_METRICS_REGISTRY, owner)
+	, util::CommonThread("metrics collector", true)
+{
+}
+
+//------------------------------------------------------------------------------
+// Base class can not stop the thread by the overwritten DoStopThread
+//------------------------------------------------------------------------------
+MetricsRegistry::~MetricsRegistry()
+{
+	Stop();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+base::IUnknown* MetricsRegistry::CreateInstance(base::IComFactory* factory,
+	const char* cid, const char* owner)
+{
+	if (strcmp(cid, CID_METRICS_REGISTRY) == 0) {
+		return new MetricsRegistry(factory, owner);
+	}
+	else {
+		return nullptr;
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void* MetricsRegistry::NDQueryInterface(const char* riid)
+{
+	if (0 == strcmp(riid, IID_METRICS_REGISTRY)) {
+		return static_cast<IMetricsRegistry*>(this);
+	}
+	else {
+		return ProxyUnknown::NDQueryInterface(riid);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void MetricsRegistry::Start()
+{
+	std::lock_guard<std::mutex> lock(m_stop_mutex);
+
+	if (m_started) return;
+
+	m_started = true;
+
+	StartThread();
+
+	LOG_INF("Start metrics registry");
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void MetricsRegistry::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_stop_mutex);
+
+		if (!m_started) return;
+
+		m_started = false;
+	}
+
+	StopThread();
+
+	LOG_INF("Stop metrics registry");
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void MetricsRegistry::DoStopThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_stop_mutex);
+		m_stop = true;
+	}
+	m_stop_cv.notify_all();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void MetricsRegistry::ThreadProc()
+{
+	LOG_INF("Start metrics collector thread");
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_stop_mutex);
+			m_stop_cv.wait_for(lock,
+				std::chrono::milliseconds(METRICS_COLLECT_INTERVAL),
+				[this]() { return m_stop; });
+
+			if (m_stop) break;
+		}
+
+		RunCollectHooks();
+		Collect();
+	}
+
+	LOG_INF("Exit metrics collector thread");
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void MetricsRegistry::RegisterMetric(const MetricSP& metric)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_metrics.insert(std::make_pair(metric.get(), metric));
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+CounterSP MetricsRegistry::AddCounter(const std::string& name,
+	const std::string& help, const MetricsLabels& labels)
+{
+	CounterSP counter = std::make_shared<Counter>(SanitizeName(name, true), help,
+		SanitizeLabels(labels));
+
+	RegisterMetric(counter);
+
+	return counter;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+GaugeSP MetricsRegistry::AddGauge(const std::string& name,
+	const std::string& help, const MetricsLabels& labels)
+{
+	GaugeSP gauge = std::make_shared<Gauge>(SanitizeName(name, true), help,
+		SanitizeLabels(labels));
+
+	RegisterMetric(gauge);
+
+	return gauge;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+HistogramSP MetricsRegistry::AddHistogram(const std::string& name,
+	const std::string& help, const MetricsLabels& labels,
+	const std::vector<uint64_t>& bounds)
+{
+	HistogramSP histogram = std::make_shared<Histogram>(SanitizeName(name, true),
+		help, SanitizeLabels(labels), bounds);
+
+	RegisterMetric(histogram);
+
+	return histogram;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void MetricsRegistry::RemoveMetric(const MetricSP& metric)
+{
+	if (!metric) return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_metrics.erase(metric.get());
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+MetricsHookId MetricsRegistry::AddCollectHook(const MetricsHook& hook)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_hook_mutex);
+
+	if (++m_next_hook_id == INVALID_METRICS_HOOK_ID) {
+		++m_next_hook_id;
+	}
+
+	m_hooks.insert(std::make_pair(m_next_hook_id, hook));
+
+	return m_next_hook_id;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void MetricsRegistry::RemoveCollectHook(MetricsHookId hook_id)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_hook_mutex);
+
+	m_hooks.erase(hook_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void MetricsRegistry::RunCollectHooks()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_hook_mutex);
+
+	for (const auto& item : m_hooks) {
+		item.second();
+	}
+}
+
+//------------------------------------------------------------------------------
+// Registry lock is only held to copy metric pointers, shards are read without
+// any lock
+//------------------------------------------------------------------------------
+void MetricsRegistry::Collect()
+{
+	std::vector<MetricSP> metrics;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		metrics.reserve(m_metrics.size());
+		for (const auto& item : m_metrics) {
+			metrics.push_back(item.second);
+		}
+	}
+
+	MetricSampleVec samples;
+	samples.reserve(metrics.size());
+
+	for (const auto& metric : metrics) {
+		MetricSample sample;
+		sample.name = metric->Name();
+		sample.help = metric->Help();
+		sample.type = metric->Type();
+		sample.labels = metric->Labels();
+
+		if (metric->Type() == MetricType::METRIC_TYPE_COUNTER) {
+			sample.value = (int64_t)static_cast<Counter*>(metric.get())->Value();
+		}
+		else if (metric->Type() == MetricType::METRIC_TYPE_GAUGE) {
+			sample.value = static_cast<Gauge*>(metric.get())->Value();
+		}
+		else {
+			Histogram* histogram = static_cast<Histogram*>(metric.get());
+			sample.count = histogram->Count();
+			sample.sum = histogram->Sum();
+			sample.bounds = histogram->Bounds();
+
+			uint64_t cumulative = 0;
+			for (uint32_t i = 0; i < histogram->BucketCount(); i++) {
+				cumulative += histogram->BucketValue(i);
+				sample.buckets.push_back(cumulative);
+			}
+		}
+
+		samples.push_back(std::move(sample));
+	}
+
+	std::sort(samples.begin(), samples.end(),
+		[](const MetricSample& a, const MetricSample& b) {
+			return a.name != b.name ? a.name < b.name : a.labels < b.labels;
+		});
+
+	// Merge series registered more than once
+	size_t index = 0;
+	for (size_t i = 1; i < samples.size(); i++) {
+		MetricSample& last = samples[index];
+		MetricSample& curr = samples[i];
+
+		if (curr.name == last.name && curr.labels == last.labels
+			&& curr.type == last.type && curr.bounds == last.bounds) {
+			last.value += curr.value;
+			last.count += curr.count;
+			last.sum += curr.sum;
+			for (size_t j = 0; j < last.buckets.size(); j++) {
+				last.buckets[j] += curr.buckets[j];
+			}
+		}
+		else if (++index != i) {
+			samples[index] = std::move(curr);
+		}
+	}
+	if (!samples.empty()) {
+		samples.resize(index + 1);
+	}
+
+	std::lock_guard<std::mutex> lock(m_sample_mutex);
+	m_samples.swap(samples);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+std::string MetricsRegistry::FormatPrometheus(const MetricSampleVec& samples)
+{
+	std::ostringstream oss;
+
+	const MetricSample* family = nullptr;
+
+	for (const auto& sample : samples) {
+		if (!family || family->name != sample.name) {
+			family = &sample;
+
+			if (!sample.help.empty()) {
+				oss << "# HELP " << sample.name << " "
+					<< EscapeText(sample.help, false) << "\n";
+			}
+			oss << "# TYPE " << sample.name << " " << MetricTypeName(sample.type)
+				<< "\n";
+		}
+
+		// Series of one family must have the same type
+		if (family->type != sample.type) {
+			continue;
+		}
+
+		if (sample.type != MetricType::METRIC_TYPE_HISTOGRAM) {
+			oss << sample.name << FormatLabels(sample.labels) << " " << sample.value
+				<< "\n";
+			continue;
+		}
+
+		for (size_t i = 0; i < sample.buckets.size(); i++) {
+			std::string le = (i < sample.bounds.size()) 
+				? std::to_string(sample.bounds[i]) : "+Inf";
+			oss << sample.name << "_bucket" << FormatLabels(sample.labels, "le", le)
+				<< " " << sample.buckets[i] << "\n";
+		}
+		oss << sample.name << "_sum" << FormatLabels(sample.labels) << " "
+			<< sample.sum << "\n";
+		oss << sample.name << "_count" << FormatLabels(sample.labels) << " "
+			<< sample.count << "\n";
+	}
+
+	return oss.str();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+std::string MetricsRegistry::FormatJson(const MetricSampleVec& samples)
+{
+	nlohmann::json metrics = nlohmann::json::array();
+
+	for (const auto& sample : samples) {
+		nlohmann::json item;
+		item["name"] = sample.name;
+		item["type"] = MetricTypeName(sample.type);
+		item["labels"] = sample.labels;
+
+		if (sample.type != MetricType::METRIC_TYPE_HISTOGRAM) {
+			item["value"] = sample.value;
+		}
+		else {
+			item["count"] = sample.count;
+			item["sum"] = sample.sum;
+
+			nlohmann::json buckets = nlohmann::json::array();
+			for (size_t i = 0; i < sample.buckets.size(); i++) {
+				nlohmann::json bucket;
+				if (i < sample.bounds.size()) {
+					bucket["le"] = sample.bounds[i];
+				}
+				else {
+					bucket["le"] = "+Inf";
+				}
+				bucket["count"] = sample.buckets[i];
+				buckets.push_back(bucket);
+			}
+			item["buckets"] = buckets;
+		}
+
+		metrics.push_back(item);
+	}
+
+	return metrics.dump();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+std::string MetricsRegistry::Scrape(MetricsFormat format)
+{
+	bool started = false;
+	{
+		std::lock_guard<std::mutex> lock(m_stop_mutex);
+		started = m_started;
+	}
+
+	// No collector thread, collect by self
+	if (!started) {
+		Collect();
+	}
+
+	MetricSampleVec samples;
+	{
+		std::lock_guard<std::mutex> lock(m_sample_mutex);
+		samples = m_samples;
+	}
+
+	if (format == MetricsFormat::METRICS_FORMAT_JSON) {
+		return FormatJson(samples);
+	}
+	else {
+		return FormatPrometheus(samples);
+	}
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <vector>
+
+#include "proxy-unknown.h"
+#include "com-obj-tracer.h"
+#include "thread/common-thread.h"
+#include "include/if-metrics-registry.h"
+
+namespace jukey::com
+{
+
+//==============================================================================
+// Metrics registry, the collector thread runs hooks and aggregates shards of
+// all metrics every collect interval. Scrape only formats the aggregation, so
+// it never touches the counters being updated.
+//==============================================================================
+class MetricsRegistry 
+	: public IMetricsRegistry
+	, public base::ProxyUnknown
+	, public base::ComObjTracer
+	, public util::CommonThread
+{
+public:
+	MetricsRegistry(base::IComFactory* factory, const char* owner);
+	~MetricsRegistry();
+
+	COMPONENT_FUNCTION_DECL
+	COMPONENT_IUNKNOWN_IMPL
+
+	// IMetricsRegistry
+	virtual void Start() override;
+	virtual void Stop() override;
+	virtual CounterSP AddCounter(const std::string& name, const std::string& help,
+		const MetricsLabels& labels) override;
+	virtual GaugeSP AddGauge(const std::string& name, const std::string& help,
+		const MetricsLabels& labels) override;
+	virtual HistogramSP AddHistogram(const std::string& name,
+		const std::string& help,
+		const MetricsLabels& labels,
+		const std::vector<uint64_t>& bounds) override;
+	virtual void RemoveMetric(const MetricSP& metric) override;
+	virtual MetricsHookId AddCollectHook(const MetricsHook& hook) override;
+	virtual void RemoveCollectHook(MetricsHookId hook_id) override;
+	virtual std::string Scrape(MetricsFormat format) override;
+
+private:
+	// CommonThread
+	virtual void ThreadProc() override;
+	virtual void DoStopThread() override;
+
+	// Aggregated value of one series
+	struct MetricSample
+	{
+		std::string name;
+		std::string help;
+		MetricType type = MetricType::METRIC_TYPE_COUNTER;
+		MetricsLabels labels;
+		int64_t value = 0; // counter or gauge
+		uint64_t count = 0; // histogram
+		uint64_t sum = 0;   // histogram
+		std::vector<uint64_t> bounds;  // histogram
+		std::vector<uint64_t> buckets; // histogram, cumulative
+	};
+	typedef std::vector<MetricSample> MetricSampleVec;
+
+private:
+	void RegisterMetric(const MetricSP& metric);
+	void RunCollectHooks();
+	void Collect();
+
+	static std::string FormatPrometheus(const MetricSampleVec& samples);
+	static std::string FormatJson(const MetricSampleVec& samples);
+
+private:
+	std::unordered_map<Metric*, MetricSP> m_metrics;
+	std::mutex m_mutex;
+
+	std::unordered_map<MetricsHookId, MetricsHook> m_hooks;
+	MetricsHookId m_next_hook_id = INVALID_METRICS_HOOK_ID;
+
+	// Held while running hooks, RemoveCollectHook waits on it
+	std::recursive_mutex m_hook_mutex;
+
+	// Latest aggregation, sorted by name and labels
+	MetricSampleVec m_samples;
+	std::mutex m_sample_mutex;
+
+	std::condition_variable m_stop_cv;
+	std::mutex m_stop_mutex;
+	bool m_started = false;
+};
+
+} // namespace
@@ -61,7 +61,7 @@ public:
 	virtual void Stop() = 0;
 
 	//
-	// Allocate a timer
+	// Allocate a timer, the count of timers is not limited
 	// 
 	virtual TimerId AllocTimer(const TimerParam& param) = 0;
 
@@ -76,7 +76,10 @@ public:
 	virtual void StartTimer(TimerId timer_id) = 0;
 
 	//
-	// Stop a timer
+	// Stop a timer, it waits until the running callback of the timer returns.
+	// Called in a callback running on the same wheel thread as the timer, such
+	// as its own callback, it returns without waiting. Two callbacks must not
+	// stop each other's timer, they may wait for each other.
 	//
 	virtual void StopTimer(TimerId timer_id) = 0;
 
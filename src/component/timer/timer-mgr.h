@@ -1,28 +1,26 @@
 ﻿#pragma once
 
-#include <list>
+#include <atomic>
 #include <memory>
 #include <mutex>
-#include <set>
-#include <map>
+#include <vector>
 
-#include "thread/common-thread.h"
 #include "proxy-unknown.h"
 #include "com-obj-tracer.h"
 #include "include/if-timer-mgr.h"
+#include "timer-wheel.h"
 
 namespace jukey::com
 {
 
 //==============================================================================
-// TODO: This a simple timer implementation, has performance problem when
-// allocating a large mount of timer
+// Timers are distributed to several timing wheels by timer ID, each wheel runs
+// callbacks in its own thread
 //==============================================================================
 class TimerMgr 
 	: public ITimerMgr
 	, public base::ProxyUnknown
 	, public base::ComObjTracer
-	, public util::CommonThread
 {
 public:
 	TimerMgr(base::IComFactory* factory, const char* owner);
@@ -40,52 +38,17 @@ public:
 	virtual void FreeTimer(TimerId timer_id) override;
 	virtual bool UpdateTimeout(TimerId timer_id, uint32_t timeout_ms) override;
 
-	// CommonThread
-	virtual void ThreadProc() override;
-
 private:
-	struct TimerEntry
-	{
-		TimerParam param;
-		TimerId timer_id = INVALID_TIMER_ID;
-	};
-	typedef std::shared_ptr<TimerEntry> TimerEntrySP;
-
-	struct TimerNode
-	{
-		uint64_t timeout_stamp = 0;
-		std::list<TimerEntrySP> entry_list;
-	};
-
-private:
-	typedef std::shared_ptr<TimerNode> TimerNodeSP;
-	typedef std::list<TimerNodeSP> TimerNodeList;
-	typedef TimerNodeList::iterator TimerNodeListIter;
-
-	static const uint32_t TIMER_BASE_TIME_MS    = 1;
-	static const uint32_t TIMER_NODE_MAX_COUNT  = 32768; // 1024 * 32
-	static const uint32_t TIMER_ENTRY_MAX_COUNT = 1024;
+	TimerWheel* GetTimerWheel(TimerId timer_id);
 
 private:
-	void TimerProc();
-	void AddEntryWithTimeout(uint32_t timeout, TimerEntrySP entry);
-	void AddEntryAsNewNode(TimerNodeListIter iter, uint64_t ts, TimerEntrySP entry);
-	void DoStopTimer(TimerId timer_id);
-	uint32_t GetWorkingTimerSize();
-
-private:
-	TimerNodeList m_node_list;
-
-	std::map<TimerId, TimerParam> m_idle_timers;
+	std::vector<TimerWheelUP> m_wheels;
 
 	// Max allocated timer ID
-	TimerId m_alloc_timer_id = 0;
-
-	// timers that did not start, or timeout timers
-	//std::set<TimerId> m_idle_timers;
+	std::atomic<TimerId> m_alloc_timer_id = 0;
 
-	// 定时器回调函数中再调用 TimerMgr 方法，比如定时器超时后立马启动下一个定时器
-	std::recursive_mutex m_mutex;
+	// Wheel thread is started when the first timer is allocated
+	std::atomic<bool> m_started = false;
 };
 
 } // namespace
\ No newline at end of file
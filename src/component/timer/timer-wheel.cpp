@@ -0,0 +1,477 @@
+#include "timer-wheel.h"
+#include "log.h"
+#include "common/util-time.h"
+
+namespace jukey::com
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+TimerWheel::TimerWheel(const std::string& name)
+	: util::CommonThread(name, true)
+	, m_base_us(util::Now())
+{
+}
+
+//------------------------------------------------------------------------------
+// Base class can not stop the thread by the overwritten DoStopThread
+//------------------------------------------------------------------------------
+TimerWheel::~TimerWheel()
+{
+	Stop();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TimerWheel::Start()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_started) return;
+
+	m_started = true;
+	m_cur_tick = NowTick();
+
+	StartThread();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TimerWheel::Stop()
+{
+	StopThread();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_timers.clear();
+	m_active_count = 0;
+	m_started = false;
+
+	for (auto& node : m_wheel0) {
+		node.prev = node.next = &node;
+	}
+
+	for (auto& wheel : m_wheels) {
+		for (auto& node : wheel) {
+			node.prev = node.next = &node;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TimerWheel::DoStopThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_tick_cv.notify_all();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint64_t TimerWheel::NowTick()
+{
+	return (util::Now() - m_base_us) / 1000;
+}
+
+//------------------------------------------------------------------------------
+// Round up, so timer never expires earlier than timeout
+//------------------------------------------------------------------------------
+uint64_t TimerWheel::ExpireTick(uint32_t timeout_ms)
+{
+	return (util::Now() - m_base_us + (uint64_t)timeout_ms * 1000 + 999) / 1000;
+}
+
+//------------------------------------------------------------------------------
+// Lock outside
+//------------------------------------------------------------------------------
+void TimerWheel::LinkEntry(TimerEntry* entry)
+{
+	uint64_t expire = entry->expire_tick;
+	if (expire < m_cur_tick) {
+		expire = m_cur_tick; // expire in next tick
+	}
+
+	uint64_t delta = expire - m_cur_tick;
+	ListNode* head = nullptr;
+
+	if (delta < kWheel0Size) {
+		head = &m_wheel0[expire & (kWheel0Size - 1)];
+	}
+	else {
+		// Longer than the whole wheel, cascade again when reaching the slot
+		if (delta >= kMaxTicks) {
+			expire = m_cur_tick + kMaxTicks - 1;
+			delta = kMaxTicks - 1;
+		}
+
+		uint32_t level = 0;
+		while (delta >= (1ULL << (kWheel0Bits + kWheelNBits * (level + 1)))) {
+			++level;
+		}
+
+		uint32_t shift = kWheel0Bits + kWheelNBits * level;
+		head = &m_wheels[level][(expire >> shift) & (kWheelNSize - 1)];
+	}
+
+	entry->prev = head->prev;
+	entry->next = head;
+	head->prev->next = entry;
+	head->prev = entry;
+}
+
+//------------------------------------------------------------------------------
+// Lock outside
+//------------------------------------------------------------------------------
+void TimerWheel::UnlinkEntry(TimerEntry* entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	entry->prev = entry->next = entry;
+}
+
+//------------------------------------------------------------------------------
+// Move all entries of a higher level slot to lower levels
+//------------------------------------------------------------------------------
+void TimerWheel::Cascade(ListNode& head)
+{
+	ListNode* node = head.next;
+	head.prev = head.next = &head;
+
+	while (node != &head) {
+		ListNode* next = node->next;
+		LinkEntry(static_cast<TimerEntry*>(node));
+		node = next;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Lock outside. Level 0 slots in the current round hold timers of exactly one
+// tick, timers of higher levels come down only when level 0 turns around, so
+// no timer is due before the first non-empty slot or the next turn-around.
+//------------------------------------------------------------------------------
+uint64_t TimerWheel::NextDueTick()
+{
+	if ((m_cur_tick & (kWheel0Size - 1)) == 0) {
+		return m_cur_tick; // cascade
+	}
+
+	uint64_t round_end = (m_cur_tick | (kWheel0Size - 1)) + 1;
+	for (uint64_t tick = m_cur_tick; tick < round_end; tick++) {
+		ListNode& head = m_wheel0[tick & (kWheel0Size - 1)];
+		if (head.next != &head) {
+			return tick;
+		}
+	}
+
+	return round_end;
+}
+
+//------------------------------------------------------------------------------
+// Lock outside
+//------------------------------------------------------------------------------
+void TimerWheel::Tick()
+{
+	uint32_t index = static_cast<uint32_t>(m_cur_tick & (kWheel0Size - 1));
+
+	// Level 0 turns around, cascade higher levels
+	if (index == 0) {
+		for (uint32_t level = 0; level < kWheelNCount; level++) {
+			uint32_t shift = kWheel0Bits + kWheelNBits * level;
+			uint32_t slot = (m_cur_tick >> shift) & (kWheelNSize - 1);
+			Cascade(m_wheels[level][slot]);
+			if (slot != 0) break;
+		}
+	}
+
+	ListNode& head = m_wheel0[index];
+	while (head.next != &head) {
+		TimerEntry* entry = static_cast<TimerEntry*>(head.next);
+		UnlinkEntry(entry);
+		entry->state = TimerState::PENDING;
+		--m_active_count;
+		m_expired.push_back(entry->timer_id);
+	}
+
+	++m_cur_tick;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TimerWheel::RunTimer(TimerId timer_id)
+{
+	TimerEntry* entry = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto iter = m_timers.find(timer_id);
+		if (iter == m_timers.end()) return;
+
+		// Stopped or restarted after expired
+		if (iter->second.state != TimerState::PENDING) return;
+
+		entry = &iter->second;
+		entry->state = TimerState::RUNNING;
+		m_running_id = timer_id;
+	}
+
+	// Entry can not be erased when running
+	entry->param.timer_func(entry->param.user_data);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_running_id = INVALID_TIMER_ID;
+
+		if (entry->freed) {
+			m_timers.erase(timer_id);
+		}
+		else if (entry->state == TimerState::RUNNING) {
+			if (entry->param.timer_type == TimerType::TIMER_TYPE_LOOP) {
+				entry->expire_tick = ExpireTick(entry->param.timeout);
+				entry->state = TimerState::ACTIVE;
+				LinkEntry(entry);
+				++m_active_count;
+			}
+			else {
+				LOG_DBG("Move once timer:{} to idle list.", timer_id);
+				entry->state = TimerState::IDLE;
+			}
+		}
+	}
+
+	m_idle_cv.notify_all();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TimerWheel::ThreadProc()
+{
+	LOG_INF("Start timer wheel thread.");
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_thread_id = std::this_thread::get_id();
+	}
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			// Sleep until the next due tick, or forever if there is no active
+			// timer. Starting a timer due earlier wakes the thread up.
+			if (m_active_count == 0) {
+				m_wake_tick = UINT64_MAX;
+				m_tick_cv.wait(lock, [this]() {
+					return m_stop || m_active_count > 0;
+				});
+			}
+			else {
+				m_wake_tick = NextDueTick();
+				int64_t wait_us = (int64_t)(m_base_us + m_wake_tick * 1000)
+					- (int64_t)util::Now();
+				if (wait_us > 0) {
+					m_tick_cv.wait_for(lock, std::chrono::microseconds(wait_us));
+				}
+			}
+
+			if (m_stop) break;
+
+			uint64_t now_tick = NowTick();
+			while (m_cur_tick <= now_tick) {
+				Tick();
+			}
+		}
+
+		for (auto timer_id : m_expired) {
+			RunTimer(timer_id);
+		}
+		m_expired.clear();
+	}
+
+	LOG_INF("Exit timer wheel thread.");
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TimerWheel::AddTimer(TimerId timer_id, const TimerParam& param)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	TimerEntry& entry = m_timers[timer_id];
+	entry.param = param;
+	entry.timer_id = timer_id;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool TimerWheel::FreeTimer(TimerId timer_id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto iter = m_timers.find(timer_id);
+	if (iter == m_timers.end() || iter->second.state != TimerState::IDLE) {
+		LOG_WRN("Cannot find timer:{} to free in idle list!", timer_id);
+		return false;
+	}
+
+	// Free in its own callback, erase after callback returns
+	if (m_running_id == timer_id) {
+		iter->second.freed = true;
+	}
+	else {
+		m_timers.erase(iter);
+	}
+
+	LOG_DBG("Free timer:{} success", timer_id);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TimerWheel::StartTimer(TimerId timer_id)
+{
+	bool notify = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto iter = m_timers.find(timer_id);
+		if (iter == m_timers.end()) {
+			LOG_ERR("Cannot find timer:{} to start!", timer_id);
+			return;
+		}
+
+		TimerEntry& entry = iter->second;
+
+		// Restart in callback is allowed
+		if (entry.state != TimerState::IDLE
+			&& entry.state != TimerState::RUNNING) {
+			LOG_ERR("Cannot find timer:{} in idle list!", timer_id);
+			return;
+		}
+
+		LOG_DBG("Start timer, id:{}, name:{}, timout:{}", timer_id,
+			entry.param.timer_name, entry.param.timeout);
+
+		// Wheel thread stops ticking when idle, skip the idle ticks
+		if (m_active_count == 0) {
+			m_cur_tick = NowTick();
+			notify = true;
+		}
+
+		entry.expire_tick = ExpireTick(entry.param.run_atonce ? 0
+			: entry.param.timeout);
+		entry.state = TimerState::ACTIVE;
+		LinkEntry(&entry);
+		++m_active_count;
+
+		// Wheel thread sleeps longer than the timeout
+		if (entry.expire_tick < m_wake_tick) {
+			m_wake_tick = entry.expire_tick;
+			notify = true;
+		}
+	}
+
+	if (notify) {
+		m_tick_cv.notify_one();
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TimerWheel::StopTimer(TimerId timer_id)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto iter = m_timers.find(timer_id);
+	if (iter == m_timers.end()) {
+		LOG_ERR("Cannot find timer:{} to stop!", timer_id);
+		return;
+	}
+
+	TimerEntry& entry = iter->second;
+
+	switch (entry.state) {
+	case TimerState::ACTIVE:
+		UnlinkEntry(&entry);
+		--m_active_count;
+		entry.state = TimerState::IDLE;
+		break;
+	case TimerState::PENDING:
+		entry.state = TimerState::IDLE;
+		break;
+	case TimerState::RUNNING:
+		entry.state = TimerState::IDLE;
+		// Callback may access resources released after stopping timer, wait
+		// unless called in a callback of this wheel, which would deadlock
+		if (std::this_thread::get_id() != m_thread_id) {
+			m_idle_cv.wait(lock, [this, timer_id]() {
+				return m_running_id != timer_id;
+			});
+
+			// Callback may restart the timer
+			auto iter = m_timers.find(timer_id);
+			if (iter != m_timers.end()) {
+				if (iter->second.state == TimerState::ACTIVE) {
+					UnlinkEntry(&iter->second);
+					--m_active_count;
+				}
+				iter->second.state = TimerState::IDLE;
+			}
+		}
+		break;
+	default:
+		LOG_DBG("Timer:{} is in idle list!", timer_id);
+		return;
+	}
+
+	LOG_DBG("Stop timer:{} success", timer_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool TimerWheel::UpdateTimeout(TimerId timer_id, uint32_t timeout_ms)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto iter = m_timers.find(timer_id);
+	if (iter == m_timers.end()
+		|| (iter->second.state != TimerState::IDLE
+			&& iter->second.state != TimerState::RUNNING)) {
+		LOG_DBG("Cannot find timer to update timeout, id:{}", timer_id);
+		return false;
+	}
+
+	iter->second.param.timeout = timeout_ms;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint32_t TimerWheel::TimerCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return static_cast<uint32_t>(m_timers.size());
+}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "thread/common-thread.h"
+#include "include/if-timer-mgr.h"
+
+namespace jukey::com
+{
+
+//==============================================================================
+// Hierarchical timing wheel with 1ms tick, driven by its own thread which
+// sleeps until the next due slot. Start, stop and expire are all O(1). Timer
+// callbacks are invoked without holding the wheel lock, so callbacks can
+// operate any timer.
+//==============================================================================
+class TimerWheel : public util::CommonThread
+{
+public:
+	TimerWheel(const std::string& name);
+	~TimerWheel();
+
+	// Start wheel thread, can be called repeatedly
+	void Start();
+	void Stop();
+
+	void AddTimer(TimerId timer_id, const TimerParam& param);
+	bool FreeTimer(TimerId timer_id);
+	void StartTimer(TimerId timer_id);
+
+	//
+	// @brief Stop timer, wait until the running callback finished unless
+	//        called in a timer callback of this wheel
+	//
+	void StopTimer(TimerId timer_id);
+
+	bool UpdateTimeout(TimerId timer_id, uint32_t timeout_ms);
+
+	uint32_t TimerCount();
+
+private:
+	// CommonThread
+	virtual void ThreadProc() override;
+	virtual void DoStopThread() override;
+
+	enum class TimerState
+	{
+		IDLE,    // Not started or stopped
+		ACTIVE,  // Linked in wheel
+		PENDING, // Expired, waiting for callback
+		RUNNING  // Callback is running
+	};
+
+	struct ListNode
+	{
+		ListNode* prev = this;
+		ListNode* next = this;
+	};
+
+	struct TimerEntry : public ListNode
+	{
+		TimerParam param;
+		TimerId timer_id = INVALID_TIMER_ID;
+		TimerState state = TimerState::IDLE;
+		uint64_t expire_tick = 0;
+		bool freed = false; // freed in its own callback
+	};
+
+private:
+	uint64_t NowTick();
+	uint64_t ExpireTick(uint32_t timeout_ms);
+	void LinkEntry(TimerEntry* entry);
+	void UnlinkEntry(TimerEntry* entry);
+	void Cascade(ListNode& head);
+	uint64_t NextDueTick();
+	void Tick();
+	void RunTimer(TimerId timer_id);
+
+private:
+	static const uint32_t kWheel0Bits = 8;
+	static const uint32_t kWheelNBits = 6;
+	static const uint32_t kWheel0Size = 1 << kWheel0Bits;
+	static const uint32_t kWheelNSize = 1 << kWheelNBits;
+	static const uint32_t kWheelNCount = 3;
+	static const uint64_t kMaxTicks =
+		1ULL << (kWheel0Bits + kWheelNBits * kWheelNCount);
+
+	// Level 0: 256ms, level 1: 16s, level 2: 17m, level 3: 18h
+	ListNode m_wheel0[kWheel0Size];
+	ListNode m_wheels[kWheelNCount][kWheelNSize];
+
+	// Next tick to process
+	uint64_t m_cur_tick = 0;
+
+	// Tick the wheel thread sleeps until
+	uint64_t m_wake_tick = UINT64_MAX;
+	uint64_t m_base_us = 0;
+
+	std::unordered_map<TimerId, TimerEntry> m_timers;
+	uint32_t m_active_count = 0;
+
+	// Expired timers of current round, only used in wheel thread
+	std::vector<TimerId> m_expired;
+
+	TimerId m_running_id = INVALID_TIMER_ID;
+	std::thread::id m_thread_id;
+	bool m_started = false;
+
+	std::mutex m_mutex;
+	std::condition_variable m_tick_cv;
+	std::condition_variable m_idle_cv;
+};
+typedef std::unique_ptr<TimerWheel> TimerWheelUP;
+
+}
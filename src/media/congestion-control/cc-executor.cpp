@@ -0,0 +1,277 @@
+#include "cc-executor.h"
+#include "log-sink.h"
+#include "log.h"
+#include "common-config.h"
+#include "common/util-time.h"
+
+#include <algorithm>
+
+
+namespace jukey::cc
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+CcExecutor::CcExecutor(uint32_t thread_count)
+{
+	// One log sink instead of one per controller
+	m_log_sink = std::make_unique<JukeyLogSink>();
+	rtc::LogMessage::AddLogToStream(m_log_sink.get(), rtc::LS_INFO);
+	rtc::LogMessage::LogToDebug(rtc::LS_INFO);
+
+	for (uint32_t i = 0; i < thread_count; i++) {
+		m_workers.push_back(std::make_shared<Worker>());
+	}
+
+	for (auto& worker : m_workers) {
+		worker->thread = std::thread(&CcExecutor::WorkerProc, worker);
+	}
+
+	LOG_INF("Create congestion control executor, thread count:{}", thread_count);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+CcExecutor::~CcExecutor()
+{
+	for (auto& worker : m_workers) {
+		{
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			worker->stop = true;
+		}
+		worker->cv.notify_all();
+	}
+
+	for (auto& worker : m_workers) {
+		// The last reference may be released in a worker, which will exit after
+		// the callback returns and release the worker state by itself
+		if (worker->thread.get_id() == std::this_thread::get_id()) {
+			worker->thread.detach();
+		}
+		else if (worker->thread.joinable()) {
+			worker->thread.join();
+		}
+	}
+
+	rtc::LogMessage::RemoveLogToStream(m_log_sink.get());
+
+	LOG_INF("Destroy congestion control executor");
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+CcExecutorSP CcExecutor::Instance()
+{
+	static std::mutex s_mutex;
+	static std::weak_ptr<CcExecutor> s_executor;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	CcExecutorSP executor = s_executor.lock();
+	if (!executor) {
+		uint32_t thread_count = std::thread::hardware_concurrency();
+		thread_count = std::max(1u, std::min(thread_count,
+			(uint32_t)CC_EXECUTOR_MAX_THREAD_COUNT));
+
+		executor = std::make_shared<CcExecutor>(thread_count);
+		s_executor = executor;
+	}
+
+	return executor;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint32_t CcExecutor::ThreadCount()
+{
+	return (uint32_t)m_workers.size();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+CcExecutor::Worker* CcExecutor::GetWorker(CcClientId client_id)
+{
+	return m_workers[client_id % m_workers.size()].get();
+}
+
+//------------------------------------------------------------------------------
+// Clients are spread over workers round robin
+//------------------------------------------------------------------------------
+CcClientId CcExecutor::AddClient(const CcProcess& process, uint32_t delay_ms)
+{
+	CcClientId client_id = INVALID_CC_CLIENT_ID;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (++m_next_client_id == INVALID_CC_CLIENT_ID) {
+			++m_next_client_id;
+		}
+		client_id = m_next_client_id;
+	}
+
+	Worker* worker = GetWorker(client_id);
+	{
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		worker->clients.Push(client_id, util::Now() + delay_ms * 1000ULL,
+			std::make_shared<CcProcess>(process));
+	}
+	worker->cv.notify_one();
+
+	LOG_DBG("Add client:{}", client_id);
+
+	return client_id;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void CcExecutor::RemoveClient(CcClientId client_id)
+{
+	if (client_id == INVALID_CC_CLIENT_ID) return;
+
+	Worker* worker = GetWorker(client_id);
+
+	std::unique_lock<std::mutex> lock(worker->mutex);
+
+	worker->clients.Remove(client_id);
+
+	worker->tasks.erase(std::remove_if(worker->tasks.begin(), worker->tasks.end(),
+		[client_id](const TaskEntry& entry) { 
+			return entry.client_id == client_id; 
+		}), worker->tasks.end());
+
+	// Removed by itself in callback
+	if (worker->thread.get_id() == std::this_thread::get_id()) {
+		return;
+	}
+
+	// Wait for running callback to finish
+	worker->idle_cv.wait(lock, [worker, client_id]() {
+		return worker->running_id != client_id;
+	});
+
+	LOG_DBG("Remove client:{}", client_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void CcExecutor::Post(CcClientId client_id, const CcTask& task)
+{
+	if (client_id == INVALID_CC_CLIENT_ID) {
+		LOG_ERR("Post task to invalid client!");
+		return;
+	}
+
+	Worker* worker = GetWorker(client_id);
+
+	bool notify = false;
+	{
+		std::lock_guard<std::mutex> lock(worker->mutex);
+
+		if (!worker->clients.Contains(client_id)) {
+			LOG_DBG("Post task to removed client:{}", client_id);
+			return;
+		}
+
+		// Worker has been notified by the first task of this batch
+		notify = worker->tasks.empty();
+		worker->tasks.push_back(TaskEntry(client_id, task));
+	}
+
+	if (notify) {
+		worker->cv.notify_one();
+	}
+}
+
+//------------------------------------------------------------------------------
+// Called with lock held, run callbacks without lock
+//------------------------------------------------------------------------------
+void CcExecutor::RunTasks(Worker* worker, std::vector<TaskEntry>& batch,
+	std::unique_lock<std::mutex>& lock)
+{
+	batch.swap(worker->tasks);
+
+	for (auto& entry : batch) {
+		// Client may be removed while running previous tasks
+		if (!worker->clients.Contains(entry.client_id)) {
+			continue;
+		}
+
+		worker->running_id = entry.client_id;
+		lock.unlock();
+
+		entry.task();
+
+		lock.lock();
+		worker->running_id = INVALID_CC_CLIENT_ID;
+		worker->idle_cv.notify_all();
+	}
+
+	batch.clear();
+}
+
+//------------------------------------------------------------------------------
+// Called with lock held, run callbacks without lock
+//------------------------------------------------------------------------------
+void CcExecutor::RunProcesses(Worker* worker, std::unique_lock<std::mutex>& lock)
+{
+	uint64_t now = util::Now();
+
+	while (!worker->clients.Empty() && worker->clients.TopKey() <= now) {
+		CcClientId client_id = worker->clients.TopId();
+		CcProcessSP process = worker->clients.Top();
+
+		worker->running_id = client_id;
+		lock.unlock();
+
+		uint32_t interval_ms = std::max((uint32_t)CC_MIN_PROCESS_INTERVAL,
+			(*process)());
+
+		lock.lock();
+		worker->running_id = INVALID_CC_CLIENT_ID;
+		worker->idle_cv.notify_all();
+
+		// Fails if client has been removed
+		worker->clients.Update(client_id, util::Now() + interval_ms * 1000ULL);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void CcExecutor::WorkerProc(WorkerSP worker_sp)
+{
+	Worker* worker = worker_sp.get();
+
+	std::vector<TaskEntry> batch;
+
+	std::unique_lock<std::mutex> lock(worker->mutex);
+
+	while (!worker->stop) {
+		if (worker->tasks.empty()) {
+			if (worker->clients.Empty()) {
+				worker->cv.wait(lock);
+				continue;
+			}
+
+			uint64_t now = util::Now();
+			uint64_t next_time = worker->clients.TopKey();
+			if (next_time > now) {
+				worker->cv.wait_for(lock, std::chrono::microseconds(next_time - now));
+				continue;
+			}
+		}
+
+		// Apply all feedbacks received in this tick before process
+		RunTasks(worker, batch, lock);
+
+		RunProcesses(worker, lock);
+	}
+}
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "common/indexed-heap.h"
+
+namespace jukey::cc
+{
+
+class JukeyLogSink;
+
+typedef uint32_t CcClientId;
+
+#define INVALID_CC_CLIENT_ID 0
+
+// Posted task
+typedef std::function<void()> CcTask;
+
+// Periodic process, returns interval to the next process in milliseconds
+typedef std::function<uint32_t()> CcProcess;
+typedef std::shared_ptr<CcProcess> CcProcessSP;
+
+//==============================================================================
+// Executor shared by all congestion controllers in process. Each client is
+// bound to one of a fixed number of worker threads, so tasks and process of
+// one client are serialized, and thread count is independent of client count.
+// Tasks posted between two wakeups are executed as a batch before the due
+// processes, so that feedbacks received in one tick are applied together.
+//==============================================================================
+class CcExecutor
+{
+public:
+	CcExecutor(uint32_t thread_count);
+	~CcExecutor();
+
+	//
+	// @brief Shared instance, created on first use and destroyed with the last
+	//        reference
+	//
+	static std::shared_ptr<CcExecutor> Instance();
+
+	//
+	// @brief Add client, process is called after delay_ms
+	//
+	CcClientId AddClient(const CcProcess& process, uint32_t delay_ms);
+
+	//
+	// @brief Remove client, process and tasks will not be called after return
+	//
+	void RemoveClient(CcClientId client_id);
+
+	void Post(CcClientId client_id, const CcTask& task);
+
+	uint32_t ThreadCount();
+
+private:
+	struct TaskEntry
+	{
+		TaskEntry(CcClientId id, const CcTask& t) : client_id(id), task(t) {}
+
+		CcClientId client_id;
+		CcTask task;
+	};
+
+	struct Worker
+	{
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable cv;
+
+		// Signaled after running client changed
+		std::condition_variable idle_cv;
+
+		std::vector<TaskEntry> tasks;
+
+		// All clients of this worker, key is next process time
+		util::IndexedHeap<CcClientId, CcProcessSP> clients;
+
+		CcClientId running_id = INVALID_CC_CLIENT_ID;
+
+		bool stop = false;
+	};
+	// Shared by executor and worker thread, the executor may be destroyed in
+	// its own worker, which keeps running on the worker state until it exits
+	typedef std::shared_ptr<Worker> WorkerSP;
+
+private:
+	Worker* GetWorker(CcClientId client_id);
+	static void WorkerProc(WorkerSP worker);
+	static void RunTasks(Worker* worker, std::vector<TaskEntry>& batch,
+		std::unique_lock<std::mutex>& lock);
+	static void RunProcesses(Worker* worker, std::unique_lock<std::mutex>& lock);
+
+private:
+	std::vector<WorkerSP> m_workers;
+
+	std::mutex m_mutex;
+	CcClientId m_next_client_id = INVALID_CC_CLIENT_ID;
+
+	// One log sink for all controllers
+	std::unique_ptr<JukeyLogSink> m_log_sink;
+};
+typedef std::shared_ptr<CcExecutor> CcExecutorSP;
+
+}
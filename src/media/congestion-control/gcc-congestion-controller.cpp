@@ -51,7 +51,6 @@ GccCongestionController::GccCongestionController(base::IComFactory* factory,
 	const char* owner)
 	: ProxyUnknown(nullptr)
 	, ComObjTracer(factory, CID_GCC_CONGESTION_CONTROLLER, owner)
-	, CommonThread("GCC congestion controller", 256, true)
 	, m_factory(factory)
 {
 
@@ -64,20 +63,11 @@ GccCongestionController::~GccCongestionController()
 {
 	LOG_INF("{}", __FUNCTION__);
 
-	if (m_timer_mgr) {
-		if (m_timer_id != INVALID_TIMER_ID) {
-			m_timer_mgr->StopTimer(m_timer_id);
-			m_timer_mgr->FreeTimer(m_timer_id);
-			m_timer_id = INVALID_TIMER_ID;
-		}
-		m_timer_mgr->Stop();
-		m_timer_mgr->Release();
-		m_timer_mgr = nullptr;
+	// No more callback after removed
+	if (m_executor) {
+		m_executor->RemoveClient(m_client_id);
+		m_client_id = INVALID_CC_CLIENT_ID;
 	}
-
-	rtc::LogMessage::RemoveLogToStream(m_log_sink.get());
-
-	StopThread();
 }
 
 //------------------------------------------------------------------------------
@@ -140,73 +130,6 @@ void GccCongestionController::InitTransportSend()
 	m_transport_send->SetPacingFactor(kDefaultPacingFactor);
 }
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-void GccCongestionController::StartTimer(uint32_t timeout_ms)
-{
-	assert(m_timer_mgr);
-
-	com::TimerParam timer_param;
-	timer_param.timeout = timeout_ms;
-	timer_param.timer_type = com::TimerType::TIMER_TYPE_ONCE;
-	timer_param.timer_name = "congestion controller";
-	timer_param.timer_func = [this](int64_t) { OnTimer(); };
-
-	m_timer_id = m_timer_mgr->AllocTimer(timer_param);
-	m_timer_mgr->StartTimer(m_timer_id);
-}
-
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-void GccCongestionController::RestartTimer(uint32_t timeout_ms)
-{
-	assert(m_timer_mgr);
-	assert(m_timer_id != INVALID_TIMER_ID);
-
-	m_timer_mgr->UpdateTimeout(m_timer_id, timeout_ms);
-	m_timer_mgr->StartTimer(m_timer_id);
-
-	LOG_DBG("Restart timer:{}", timeout_ms);
-}
-
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-void GccCongestionController::InitWebrtcLog()
-{
-	// 创建并添加自定义日志接收器
-	m_log_sink = std::make_unique<JukeyLogSink>();
-	rtc::LogMessage::AddLogToStream(m_log_sink.get(), rtc::LS_INFO);
-
-	// 设置日志级别
-	rtc::LogMessage::LogToDebug(rtc::LS_INFO);
-}
-
-//------------------------------------------------------------------------------
-// 使用独立的 TimerMgr
-//------------------------------------------------------------------------------
-void GccCongestionController::InitTimerMgr()
-{
-	base::IUnknown* p = m_factory->CreateComponent(CID_TIMER_MGR, 
-		"congestion controller");
-	if (!p) {
-		LOG_ERR("Create timer manager failed!");
-		return;
-	}
-
-	m_timer_mgr = (com::ITimerMgr*)p->QueryInterface(IID_TIMER_MGR);
-	if (!m_timer_mgr) {
-		LOG_ERR("QueryInterface iid-timer-mgr failed!");
-		return;
-	}
-
-	m_timer_mgr->Start();
-
-	LOG_INF("Start timer manager");
-}
-
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -218,16 +141,13 @@ void GccCongestionController::Init(IBandwidthObserver* observer,
 
 	m_observer = observer;
 	m_sender = sender;
-	
-	StartThread();
 
-	InitTimerMgr();
+	m_executor = CcExecutor::Instance();
 	
 	InitTransportSend();
 
-	StartTimer(5); // TODO: 延迟 5ms 启动定时器
-
-	InitWebrtcLog();
+	// First process is scheduled one tick later
+	m_client_id = m_executor->AddClient([this]() { return OnProcess(); }, 5);
 }
 
 //------------------------------------------------------------------------------
@@ -235,20 +155,20 @@ void GccCongestionController::Init(IBandwidthObserver* observer,
 //------------------------------------------------------------------------------
 void GccCongestionController::SetBitrateConfig(const BitrateConfig& config)
 {
-	this->Execute([this, config](util::CallParam) -> void {
+	m_executor->Post(m_client_id, [this, config]() {
 		BitrateSettings settings;
 		settings.max_bitrate_bps = config.max_bitrate_kbps * 1000;
 		settings.min_bitrate_bps = config.min_bitrate_kbps * 1000;
 		settings.start_bitrate_bps = config.start_bitrate_kbps * 1000;
 
 		m_transport_send->SetClientBitratePreferences(settings);
-	}, nullptr);
+	});
 }
 
 //------------------------------------------------------------------------------
-// 
+// Called by executor, returns interval to the next process
 //------------------------------------------------------------------------------
-void GccCongestionController::OnTimer()
+uint32_t GccCongestionController::OnProcess()
 {
 	assert(m_transport_send);
 
@@ -257,16 +177,15 @@ void GccCongestionController::OnTimer()
 		m_last_notify_time_us = util::Now();
 	}
 
-	this->Execute([this](util::CallParam) -> void {
-		uint64_t before = util::Now();
-		m_transport_send->Process();
-		uint64_t after = util::Now();
-		// 打印处理时间较长的情况，理论上不会需要这么长的处理时间
-		if (after > before + 2000) {
-			LOG_INF("process time:{}", after - before);
-		}
-		RestartTimer(m_transport_send->NextProcessInterval());
-	}, nullptr);
+	uint64_t before = util::Now();
+	m_transport_send->Process();
+	uint64_t after = util::Now();
+	// 打印处理时间较长的情况，理论上不会需要这么长的处理时间
+	if (after > before + 2000) {
+		LOG_INF("process time:{}", after - before);
+	}
+
+	return m_transport_send->NextProcessInterval();
 }
 
 //------------------------------------------------------------------------------
@@ -274,9 +193,9 @@ void GccCongestionController::OnTimer()
 //------------------------------------------------------------------------------
 void GccCongestionController::OnTransportConnected()
 {
-	this->Execute([this](util::CallParam)-> void {
+	m_executor->Post(m_client_id, [this]() {
 		m_transport_send->OnNetworkAvailability(true);
-	}, nullptr);
+	});
 }
 
 //------------------------------------------------------------------------------
@@ -284,9 +203,9 @@ void GccCongestionController::OnTransportConnected()
 //------------------------------------------------------------------------------
 void GccCongestionController::OnTransportDisconnected()
 {
-	this->Execute([this](util::CallParam)-> void {
+	m_executor->Post(m_client_id, [this]() {
 		m_transport_send->OnNetworkAvailability(false);
-	}, nullptr);
+	});
 }
 
 //------------------------------------------------------------------------------
@@ -294,10 +213,10 @@ void GccCongestionController::OnTransportDisconnected()
 //------------------------------------------------------------------------------
 void GccCongestionController::OnRttUpdate(uint32_t rtt_ms)
 {
-	this->Execute([this, rtt_ms](util::CallParam)-> void {
+	m_executor->Post(m_client_id, [this, rtt_ms]() {
 		m_transport_send->OnRttUpdate(webrtc::Timestamp::Micros(util::Now()), 
 			webrtc::TimeDelta::Millis(rtt_ms));
-	}, nullptr);
+	});
 }
 
 //------------------------------------------------------------------------------
@@ -305,7 +224,7 @@ void GccCongestionController::OnRttUpdate(uint32_t rtt_ms)
 //------------------------------------------------------------------------------
 void GccCongestionController::OnLossReport(const LossReport& report)
 {
-	this->Execute([this, report](util::CallParam)-> void {
+	m_executor->Post(m_client_id, [this, report]() {
 		TransportLossReport tl_report;
 		tl_report.packets_received_delta = report.recv_count;
 		tl_report.packets_lost_delta = report.loss_count;
@@ -313,7 +232,7 @@ void GccCongestionController::OnLossReport(const LossReport& report)
 		tl_report.end_time = webrtc::Timestamp::Millis(report.end_time);
 		tl_report.receive_time = webrtc::Timestamp::Millis(report.recv_time);
 		m_transport_send->OnLossReport(tl_report);
-	}, nullptr);
+	});
 }
 
 //------------------------------------------------------------------------------
@@ -327,9 +246,9 @@ void GccCongestionController::OnTransportFeedback(const com::Buffer& buf)
 		feedback->GetFeedbackSequenceNumber(), feedback->GetBaseSequence(), 
 		feedback->GetPacketStatusCount());
 
-	this->Execute([this, fb=std::move(*feedback)](util::CallParam)-> void {
+	m_executor->Post(m_client_id, [this, fb=std::move(*feedback)]() {
 		m_transport_send->OnTransportFeedback(Timestamp::Micros(util::Now()), fb);
-	}, nullptr);
+	});
 }
 
 //------------------------------------------------------------------------------
@@ -409,7 +328,7 @@ void GccCongestionController::OnAddPacket(const PktSendInfo& info)
 {
 	assert(m_transport_send);
 
-	this->Execute([this, info](util::CallParam)->void {
+	m_executor->Post(m_client_id, [this, info]() {
 		RtpPacketSendInfo rtp_info;
 		rtp_info.transport_sequence_number = info.seq;
 		rtp_info.rtp_timestamp = info.ts; // TODO: 这里并不是用 RTP 时间戳赋值
@@ -427,7 +346,7 @@ void GccCongestionController::OnAddPacket(const PktSendInfo& info)
 			info.pacing_info.probe_cluster_min_probes;
 
 		m_transport_send->OnAddPacket(rtp_info);
-	}, nullptr);
+	});
 }
 
 //------------------------------------------------------------------------------
@@ -437,7 +356,7 @@ void GccCongestionController::OnSentPacket(const SentPktInfo& info)
 {
 	assert(m_transport_send);
 
-	this->Execute([this, info](util::CallParam)->void {
+	m_executor->Post(m_client_id, [this, info]() {
 		rtc::SentPacket pkt;
 		pkt.packet_id = info.seq;
 		pkt.send_time_ms = info.send_time_ms;
@@ -450,7 +369,7 @@ void GccCongestionController::OnSentPacket(const SentPktInfo& info)
 		pkt.info.protocol = rtc::PacketInfoProtocolType::kUdp;
 
 		m_transport_send->OnSentPacket(pkt);
-	}, nullptr);
+	});
 }
 
 }
\ No newline at end of file
@@ -3,31 +3,25 @@
 #include "proxy-unknown.h"
 #include "com-obj-tracer.h"
 #include "if-congestion-controller.h"
-#include "thread/common-thread.h"
-#include "if-timer-mgr.h"
-#include "log-sink.h"
+#include "cc-executor.h"
 
 #include "call/rtp_transport_controller_send.h"
-#include "api/task_queue/default_task_queue_factory.h"
 #include "api/transport/network_control.h"
 #include "modules/pacing/pacing_controller.h"
 #include "modules/rtp_rtcp/source/rtcp_packet/transport_feedback.h"
 
 using namespace webrtc;
 
-class JukeyLogSink;
-
 namespace jukey::cc
 {
 
 //==============================================================================
-// 
+// Runs on the shared congestion control executor, no thread of its own
 //==============================================================================
 class GccCongestionController 
 	: public ICongetionController
 	, public base::ProxyUnknown
 	, public base::ComObjTracer
-	, public util::CommonThread
 	, public webrtc::TargetTransferRateObserver
 	, public webrtc::PacingController::PacketSender
 {
@@ -59,25 +53,18 @@ public:
 	virtual std::vector<com::Buffer> GeneratePadding(uint32_t size) override;
 
 private:
-	void OnTimer();
+	uint32_t OnProcess();
 	void InitTransportSend();
-	void StartTimer(uint32_t timeout_ms);
-	void RestartTimer(uint32_t timeout_ms);
-	void InitWebrtcLog();
-	void InitTimerMgr();
 
 private:
 	base::IComFactory* m_factory = nullptr;
 	IBandwidthObserver* m_observer = nullptr;
 	IPacketSender* m_sender = nullptr;
-	com::ITimerMgr* m_timer_mgr = nullptr;
-
-	std::unique_ptr<TaskQueueBase, TaskQueueDeleter> m_task_queue = nullptr;
-	std::unique_ptr<RtpTransportControllerSend> m_transport_send;
 
-	com::TimerId m_timer_id = INVALID_TIMER_ID;
+	CcExecutorSP m_executor;
+	CcClientId m_client_id = INVALID_CC_CLIENT_ID;
 
-	std::unique_ptr<JukeyLogSink> m_log_sink;
+	std::unique_ptr<RtpTransportControllerSend> m_transport_send;
 
 	uint32_t kNotifyIntervalMs = 1000;
 	uint64_t m_last_notify_time_us = 0;
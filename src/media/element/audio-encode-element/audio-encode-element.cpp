@@ -21,7 +21,7 @@ AudioEncodeElement::AudioEncodeElement(base::IComFactory* factory,
 	const char* owner)
 	: base::ProxyUnknown(nullptr)
   , base::ComObjTracer(factory, CID_AUDIO_ENCODE, owner)
-	, util::CommonThread("audio encode element", false)
+	, media::util::StrandThread("audio encode element")
   , media::util::ElementBase(factory)
 {
 	m_ele_name   = CONSTRUCT_ELEMENT_NAME("a-encode-");
@@ -195,7 +195,7 @@ ErrCode AudioEncodeElement::DoInit(com::IProperty* props)
 
 	ParseElementConfig();
 
-	StartThread();
+	StartThread(m_pipeline->GetScheduler());
 
 	return ERR_CODE_OK;
 }
@@ -269,7 +269,12 @@ ErrCode AudioEncodeElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
 	}
 
 	m_data_que.push_back(media::util::ClonePinData(data));
-	m_con_var.notify_all();
+
+	// Encoded in element strand, not in the thread of upstream element
+	if (!m_encode_posted && GetQueueDataTotalLen() >= m_input_len) {
+		m_encode_posted = true;
+		Execute([this](util::CallParam) { EncodeData(); }, nullptr);
+	}
 
 	return ERR_CODE_OK;
 }
@@ -419,43 +424,43 @@ void AudioEncodeElement::FillAudioData(uint8_t* data, uint32_t data_len,
 }
 
 //------------------------------------------------------------------------------
-// 
+// Encode all queued packs
 //------------------------------------------------------------------------------
-void AudioEncodeElement::ThreadProc()
+void AudioEncodeElement::EncodeData()
 {
-	while (!m_stop) {
-		std::unique_lock<std::mutex> lock(m_mutex);
-		while (m_data_que.empty() || GetQueueDataTotalLen() < m_input_len) {
-			m_con_var.wait_for(lock, std::chrono::milliseconds(10)); // release mutex
-			if (m_stop) break;
-		}
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-		while (GetQueueDataTotalLen() >= m_input_len) {
-			uint8_t* raw_audio_data = new uint8_t[m_input_len];
-			PinData encoded_data(media::MediaType::AUDIO, m_input_len);
-
-			FillAudioData(raw_audio_data, m_input_len, encoded_data);
-
-			opus_int32 result = opus_encode(m_opus_encoder,
-				(opus_int16*)raw_audio_data,
-				media::util::GetSRateNum(m_sink_pin_cap.srate) * OPUS_PACK_DURATION / 1000,
-				encoded_data.media_data->data.get(),
-				encoded_data.media_data->total_len);
-			if (result <= 0) {
-				LOG_ERR("Opus encode failed, error:{}", result);
-				delete[] raw_audio_data;
-				continue;
-			}
-			encoded_data.media_data->data_len = result;
-			SRC_PIN->OnPinData(encoded_data);
+	m_encode_posted = false;
 
-			if (m_ae_dumper) {
-				m_ae_dumper->WriteData(DP(encoded_data.media_data[0]),
-					encoded_data.media_data[0].data_len);
-			}
+	if (!m_opus_encoder) {
+		return;
+	}
+
+	while (GetQueueDataTotalLen() >= m_input_len) {
+		uint8_t* raw_audio_data = new uint8_t[m_input_len];
+		PinData encoded_data(media::MediaType::AUDIO, m_input_len);
+
+		FillAudioData(raw_audio_data, m_input_len, encoded_data);
 
+		opus_int32 result = opus_encode(m_opus_encoder,
+			(opus_int16*)raw_audio_data,
+			media::util::GetSRateNum(m_sink_pin_cap.srate) * OPUS_PACK_DURATION / 1000,
+			encoded_data.media_data->data.get(),
+			encoded_data.media_data->total_len);
+		if (result <= 0) {
+			LOG_ERR("Opus encode failed, error:{}", result);
 			delete[] raw_audio_data;
+			continue;
 		}
+		encoded_data.media_data->data_len = result;
+		SRC_PIN->OnPinData(encoded_data);
+
+		if (m_ae_dumper) {
+			m_ae_dumper->WriteData(DP(encoded_data.media_data[0]),
+				encoded_data.media_data[0].data_len);
+		}
+
+		delete[] raw_audio_data;
 	}
 }
 
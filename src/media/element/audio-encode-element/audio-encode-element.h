@@ -11,7 +11,7 @@
 #include "if-pipeline.h"
 #include "util-streamer.h"
 #include "opus.h"
-#include "thread/common-thread.h"
+#include "strand-thread.h"
 #include "common/util-dump.h"
 #include "common-config.h"
 
@@ -29,7 +29,7 @@ class AudioEncodeElement
 	: public media::util::ElementBase
 	, public base::ProxyUnknown
 	, public base::ComObjTracer
-	, public util::CommonThread
+	, public media::util::StrandThread
 {
 public:
 	AudioEncodeElement(base::IComFactory* factory, const char* owner);
@@ -52,9 +52,6 @@ public:
 	virtual com::ErrCode OnSrcPinNegotiated(ISrcPin* pin,
 		const std::string& cap) override;
 
-	// CommonThread
-	virtual void ThreadProc() override;
-
 private:
 	com::ErrCode CreateSrcPin();
 	com::ErrCode CreateSinkPin();
@@ -63,6 +60,7 @@ private:
 	uint32_t GetQueueDataTotalLen();
 	void FillAudioData(uint8_t* data, uint32_t len, PinData& pin_data);
 	void ParseElementConfig();
+	void EncodeData();
 
 private:
 	uint32_t m_src_pin_index = 0;
@@ -76,7 +74,9 @@ private:
 	OpusEncoder* m_opus_encoder = nullptr;
 
 	std::list<PinDataSP> m_data_que;
-	std::condition_variable_any m_con_var;
+
+	// Encode task is posted and not run yet
+	bool m_encode_posted = false;
 
 	util::IDataDumperSP m_be_dumper; // before encode
 	util::IDataDumperSP m_ae_dumper; // after encode
@@ -2,11 +2,15 @@
 #include "util-streamer.h"
 #include "pipeline-msg.h"
 #include "common/util-time.h"
+#include "common/media-common-define.h"
+#include "yaml-cpp/yaml.h"
 
 #include <functional>
+#include <algorithm>
 
 
 using namespace jukey::com;
+using namespace jukey::media::util;
 
 namespace jukey::stmr
 {
@@ -18,7 +22,7 @@ AudioMixElement::AudioMixElement(base::IComFactory* factory, const char* owner)
 	: ProxyUnknown(nullptr)
   , ComObjTracer(factory, CID_AUDIO_MIX, owner)
 	, ElementBase(factory)
-	, util::CommonThread("audio-mix-element", true)
+	, media::util::StrandThread("audio-mix-element")
 {
 	m_ele_name   = CONSTRUCT_ELEMENT_NAME("a-mix-");
 	m_main_type  = EleMainType::FILTER;
@@ -37,7 +41,7 @@ AudioMixElement::~AudioMixElement()
 {
 	LOG_INF("Destruct {}", m_ele_name);
 
-	// TODO: release
+	StopThread();
 }
 
 //------------------------------------------------------------------------------
@@ -67,14 +71,25 @@ void* AudioMixElement::NDQueryInterface(const char* riid)
 	}
 }
 
+//------------------------------------------------------------------------------
+// Sink pins and src pin have the same capability, mixing does not convert
+//------------------------------------------------------------------------------
+std::string AudioMixElement::MixPinCaps()
+{
+	media::com::AudioCaps caps;
+	caps.AddCap(media::AudioCodec::PCM);
+	caps.AddCap(media::AudioSBits::S16);
+	caps.AddCap(ToAudioSRate(m_mix_param.srate));
+	caps.AddCap(ToAudioChnls(m_mix_param.chnls));
+
+	return ToAudioCapsStr(caps);
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
 ErrCode AudioMixElement::CreateSrcPin()
 {
-	media::com::AudioCaps src_pin_caps;
-	src_pin_caps.AddCap(media::AudioCodec::PCM);
-
 	ISrcPin* src_pin = (ISrcPin*)QI(CID_SRC_PIN, IID_SRC_PIN, m_ele_name);
 	if (!src_pin) {
 		LOG_ERR("Create src pin failed!");
@@ -84,15 +99,78 @@ ErrCode AudioMixElement::CreateSrcPin()
 	if (ERR_CODE_OK != src_pin->Init(media::MediaType::AUDIO,
 			this,
 			CONSTRUCT_PIN_NAME("a-src-pin-"),
-			media::util::ToAudioCapsStr(src_pin_caps),
+			MixPinCaps(),
 			this)) {
 		LOG_ERR("Init src pin failed!");
 		return ERR_CODE_FAILED;
 	}
 
+	m_src_pin_index = static_cast<uint32_t>(m_src_pins.size());
+	m_src_pins.push_back(src_pin);
+
 	return ERR_CODE_OK;
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void AudioMixElement::ParseElementConfig()
+{
+	try {
+		YAML::Node root = YAML::LoadFile(ELEMENT_CONFIG_FILE);
+
+		auto node = root["audio-mix-element"];
+		if (!node) {
+			return;
+		}
+
+		if (node["sample-rate"]) {
+			uint32_t srate = node["sample-rate"].as<uint32_t>();
+			if (ToAudioSRate(srate) != media::AudioSRate::INVALID) {
+				m_mix_param.srate = srate;
+			}
+			else {
+				LOG_WRN("Invalid sample rate:{}", srate);
+			}
+		}
+
+		if (node["channels"]) {
+			uint32_t chnls = node["channels"].as<uint32_t>();
+			if (chnls == 1 || chnls == 2) {
+				m_mix_param.chnls = chnls;
+			}
+			else {
+				LOG_WRN("Invalid channels:{}", chnls);
+			}
+		}
+
+		if (node["frame-ms"]) {
+			uint32_t frame_ms = node["frame-ms"].as<uint32_t>();
+			if (frame_ms == 10 || frame_ms == 20) {
+				m_mix_param.frame_ms = frame_ms;
+			}
+			else {
+				LOG_WRN("Invalid frame ms:{}", frame_ms);
+			}
+		}
+
+		if (node["max-speakers"]) {
+			m_mix_param.max_speakers = node["max-speakers"].as<uint32_t>();
+		}
+
+		if (node["max-delay"]) {
+			m_mix_param.max_delay_ms = node["max-delay"].as<uint32_t>();
+		}
+
+		if (node["float-mix"]) {
+			m_mix_param.float_mix = node["float-mix"].as<bool>();
+		}
+	}
+	catch (const std::exception& e) {
+		LOG_WRN("Error:{}", e.what());
+	}
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -100,18 +178,39 @@ ErrCode AudioMixElement::DoInit(com::IProperty* props)
 {
 	m_logger = g_logger;
 
+	ParseElementConfig();
+
+	// Src pin is created with default format before config is parsed
+	PinCaps caps;
+	if (ERR_CODE_OK != ParseAvaiAudioCaps(MixPinCaps(), caps)
+		|| ERR_CODE_OK != SRC_PIN->UpdateAvaiCaps(caps)) {
+		LOG_ERR("Update src pin available caps failed!");
+		return ERR_CODE_FAILED;
+	}
+
+	m_mixer.reset(new AudioMixer(m_mix_param));
+
+	LOG_INF("Mixer, srate:{}, chnls:{}, frame:{}ms, speakers:{}, float:{}, "
+		"kernel:{}", m_mix_param.srate, m_mix_param.chnls, m_mix_param.frame_ms,
+		m_mix_param.max_speakers, m_mix_param.float_mix,
+		MixKernelName(MixCurrentKernel()));
+
 	m_pipeline->SubscribeMsg((uint32_t)PlMsgType::ADD_SINK_PIN, this);
 	m_pipeline->SubscribeMsg((uint32_t)PlMsgType::REMOVE_SINK_PIN, this);
+	m_pipeline->SubscribeMsg((uint32_t)PlMsgType::MIX_INPUT_GAIN, this);
 
 	return ERR_CODE_OK;
 }
 
 //------------------------------------------------------------------------------
-// Nothing to do
+// Mixing is driven by process of element strand
 //------------------------------------------------------------------------------
 ErrCode AudioMixElement::DoStart()
 {
-	StartThread();
+	StartThread(m_pipeline->GetScheduler());
+
+	m_next_tick = util::Now();
+	m_scheduler->SetProcess(m_strand, [this]() { return MixProcess(); }, 0);
 
 	return ERR_CODE_OK;
 }
@@ -119,6 +218,16 @@ ErrCode AudioMixElement::DoStart()
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
+ErrCode AudioMixElement::DoStop()
+{
+	StopThread();
+
+	return ERR_CODE_OK;
+}
+
+//------------------------------------------------------------------------------
+// Samples are copied into mixer input, pin data is not cloned
+//------------------------------------------------------------------------------
 ErrCode AudioMixElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
 {
 	LOG_DBG("OnSinkPinData, len:{}", data.media_data[0].data_len);
@@ -128,27 +237,21 @@ ErrCode AudioMixElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
 		return ERR_CODE_FAILED;
 	}
 
-	if (data.mt != media::MediaType::VIDEO) {
+	if (data.mt != media::MediaType::AUDIO) {
 		LOG_DBG("Invalid media type:{}", data.mt);
 		return ERR_CODE_FAILED;
 	}
 
-	// TODO: 理论上这个值不会变化
-	if (m_av_sync_id != data.syn) {
-		m_av_sync_id = data.syn;
-		m_pipeline->GetSyncMgr().AddSyncHandler(m_av_sync_id, this);
-	}
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-	PinDataSP new_data = media:: util::ClonePinData(data);
-	{
-		std::unique_lock<std::mutex> lock(m_mutex);
-		m_data_que.push(new_data);
+	auto iter = m_pin_inputs.find(pin);
+	if (iter == m_pin_inputs.end()) {
+		LOG_ERR("Unknown sink pin:{}", pin->Name());
+		return ERR_CODE_FAILED;
 	}
-	m_con_var.notify_all();
 
-	if (m_data_que.size() > 64) {
-		//return ERR_CODE_SEND_PENDING;
-	}
+	m_mixer->InputData(iter->second, (const int16_t*)DP(data.media_data[0]),
+		data.media_data[0].data_len / sizeof(int16_t));
 
 	return ERR_CODE_OK;
 }
@@ -160,16 +263,6 @@ ErrCode AudioMixElement::OnSinkPinNegotiated(ISinkPin* pin, const std::string& c
 {
 	LOG_INF("Sink pin negotiated, cap:{}", media::util::Capper(cap));
 
-	auto vcap = media::util::ParseVideoCap(cap);
-	if (!vcap.has_value()) {
-		LOG_ERR("Parse video cap failed");
-		return ERR_CODE_FAILED;
-	}
-
-	m_sink_pin_cap = vcap.value();
-
-	// TODO:
-
 	return ERR_CODE_OK;
 }
 
@@ -186,31 +279,68 @@ ErrCode AudioMixElement::OnSrcPinNegotiated(ISrcPin* pin, const std::string& cap
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
+static ErrCode ReplyPinMsg(const com::CommonMsg& msg, ErrCode result)
+{
+	if (msg.result) {
+		msg.result->set_value(result);
+	}
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// Every sink pin is an input of mixer, named by SinkPinData so that it can be
+// removed by the same name
+//------------------------------------------------------------------------------
 ErrCode AudioMixElement::OnAddSinkPin(const com::CommonMsg& msg)
 {
-	LOG_INF("OnAddSinkPin");
+	PCAST_COMMON_MSG_DATA(stmr::SinkPinData);
+
+	if (!data || data->pin_name.empty()) {
+		LOG_ERR("Invalid sink pin name!");
+		return ReplyPinMsg(msg, ERR_CODE_INVALID_PARAM);
+	}
+
+	LOG_INF("OnAddSinkPin, pin:{}", data->pin_name);
 
-	media::com::AudioCaps sink_pin_caps;
-	sink_pin_caps.AddCap(media::AudioCodec::PCM);
+	auto iter = std::find_if(m_sink_pins.begin(), m_sink_pins.end(),
+		[&data](ISinkPin* pin) { return pin->Name() == data->pin_name; });
+	if (iter != m_sink_pins.end()) {
+		LOG_ERR("Sink pin:{} already exists!", data->pin_name);
+		return ReplyPinMsg(msg, ERR_CODE_FAILED);
+	}
 
 	stmr::ISinkPin* sink_pin = (ISinkPin*)QI(CID_SINK_PIN, IID_SINK_PIN, 
 		m_ele_name);
 	if (!sink_pin) {
 		LOG_ERR("Create sink pin failed!");
-		return ERR_CODE_FAILED;
+		return ReplyPinMsg(msg, ERR_CODE_FAILED);
 	}
 
 	if (com::ERR_CODE_OK != sink_pin->Init(
 		media::MediaType::AUDIO,
 		this,
-		CONSTRUCT_PIN_NAME("audio-sink-pin-"),
-		media::util::ToAudioCapsStr(sink_pin_caps),
+		data->pin_name,
+		MixPinCaps(),
 		this)) {
 		LOG_ERR("Init auido sink pin failed!");
-		return ERR_CODE_FAILED;
+		sink_pin->Release();
+		return ReplyPinMsg(msg, ERR_CODE_FAILED);
 	}
 
-	return ERR_CODE_OK;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		uint32_t input_id = m_next_input_id++;
+		m_mixer->AddInput(input_id);
+		m_pin_inputs.insert(std::make_pair(sink_pin, input_id));
+	}
+
+	m_sink_pins.push_back(sink_pin);
+
+	LOG_INF("Add mixer input, pin:{}, inputs:{}", data->pin_name,
+		m_sink_pins.size());
+
+	return ReplyPinMsg(msg, ERR_CODE_OK);
 }
 
 //------------------------------------------------------------------------------
@@ -218,40 +348,134 @@ ErrCode AudioMixElement::OnAddSinkPin(const com::CommonMsg& msg)
 //------------------------------------------------------------------------------
 ErrCode AudioMixElement::OnRemoveSinkPin(const com::CommonMsg& msg)
 {
-	return ERR_CODE_OK;
+	PCAST_COMMON_MSG_DATA(stmr::SinkPinData);
+
+	if (!data || data->pin_name.empty()) {
+		LOG_ERR("Invalid sink pin name!");
+		return ReplyPinMsg(msg, ERR_CODE_INVALID_PARAM);
+	}
+
+	LOG_INF("OnRemoveSinkPin, pin:{}", data->pin_name);
+
+	auto iter = std::find_if(m_sink_pins.begin(), m_sink_pins.end(),
+		[&data](ISinkPin* pin) { return pin->Name() == data->pin_name; });
+	if (iter == m_sink_pins.end()) {
+		LOG_ERR("Cannot find sink pin:{}", data->pin_name);
+		return ReplyPinMsg(msg, ERR_CODE_FAILED);
+	}
+
+	ISinkPin* sink_pin = *iter;
+
+	ISrcPin* src_pin = sink_pin->SrcPin();
+	if (src_pin) {
+		src_pin->RemoveSinkPin(sink_pin->Name());
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto input_iter = m_pin_inputs.find(sink_pin);
+		if (input_iter != m_pin_inputs.end()) {
+			m_mixer->RemoveInput(input_iter->second);
+			m_pin_inputs.erase(input_iter);
+		}
+	}
+
+	m_sink_pins.erase(iter);
+	sink_pin->Release();
+
+	LOG_INF("Remove mixer input, pin:{}, inputs:{}", data->pin_name,
+		m_sink_pins.size());
+
+	return ReplyPinMsg(msg, ERR_CODE_OK);
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void AudioMixElement::ThreadProc()
+ErrCode AudioMixElement::OnMixInputGain(const com::CommonMsg& msg)
 {
-	while (!m_stop) {
-		std::unique_lock<std::mutex> lock(m_mutex);
-		while (m_data_que.empty()) {
-			m_con_var.wait(lock); // release mutex
+	PCAST_COMMON_MSG_DATA(stmr::MixGainData);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (const auto& item : m_pin_inputs) {
+		if (item.first->Name() == data->pin_name) {
+			m_mixer->SetGain(item.second, data->gain);
+			LOG_INF("Set mixer input gain, pin:{}, gain:{}", data->pin_name,
+				data->gain);
+			return ERR_CODE_OK;
 		}
+	}
 
-		PinDataSP data = m_data_que.front();
+	LOG_ERR("Cannot find sink pin:{}", data->pin_name);
 
-		// 未开启同步或者视频时间戳落后于音频时间戳
-		if (m_audio_pts == 0 || data->pts <= m_audio_pts) {
+	return ERR_CODE_FAILED;
+}
 
-			m_data_que.pop();
-		}
-		else {
-			lock.unlock();
-			util::Sleep(10);
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void AudioMixElement::MixAndSend()
+{
+	PinData data(media::MediaType::AUDIO);
+
+	uint32_t frame_len = m_mixer->FrameSamples() * sizeof(int16_t);
+	if (!m_frame_pool.AllocFrame(data, &frame_len, 1)) {
+		LOG_ERR("Alloc frame failed!");
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_mixer->MixFrame((int16_t*)DP(data.media_data[0]))) {
+			return; // no input has data
 		}
 	}
+
+	uint32_t samples = m_mixer->FrameSamples() / m_mix_param.chnls;
+
+	auto para = SPC<media::AudioFramePara>(data.media_para);
+	para->codec = media::AudioCodec::PCM;
+	para->srate = ToAudioSRate(m_mix_param.srate);
+	para->chnls = ToAudioChnls(m_mix_param.chnls);
+	para->count = samples;
+	para->seq = ++m_frame_seq;
+
+	// Timestamp is in milliseconds(tbd), the same as capture elements
+	data.pts = m_mixed_samples * 1000 / m_mix_param.srate;
+	data.dts = data.pts;
+	data.drt = m_mix_param.frame_ms;
+	data.tbn = 1;
+	data.tbd = 1000;
+
+	para->ts = (uint32_t)data.pts;
+
+	m_mixed_samples += samples;
+
+	SRC_PIN->OnPinData(data);
 }
 
 //------------------------------------------------------------------------------
-// 
+// One frame is mixed on each tick, ticks are scheduled by absolute time so the
+// output does not drift
 //------------------------------------------------------------------------------
-void AudioMixElement::OnSyncUpdate(uint64_t timestamp)
+uint32_t AudioMixElement::MixProcess()
 {
-	m_audio_pts = timestamp;
+	if (m_ele_state == EleState::RUNNING) {
+		MixAndSend();
+	}
+
+	m_next_tick += m_mix_param.frame_ms * 1000;
+
+	// Fell behind too much, restart the timebase
+	uint64_t now = util::Now();
+	if (now > m_next_tick + m_mix_param.frame_ms * 1000 * 10) {
+		m_next_tick = now;
+	}
+
+	return m_next_tick > now ? (uint32_t)((m_next_tick - now) / 1000) : 0;
 }
 
 //------------------------------------------------------------------------------
@@ -264,6 +488,8 @@ ErrCode AudioMixElement::PreProcPipelineMsg(const CommonMsg& msg)
 		return OnAddSinkPin(msg);
 	case (uint32_t)stmr::PlMsgType::REMOVE_SINK_PIN:
 		return OnRemoveSinkPin(msg);
+	case (uint32_t)stmr::PlMsgType::MIX_INPUT_GAIN:
+		return OnMixInputGain(msg);
 	default:
 		return ERR_CODE_MSG_NO_PROC;
 	}
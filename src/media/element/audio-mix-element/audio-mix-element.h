@@ -1,6 +1,7 @@
 #pragma once
 
-#include <queue>
+#include <map>
+#include <vector>
 
 #include "proxy-unknown.h"
 #include "com-obj-tracer.h"
@@ -8,10 +9,11 @@
 #include "common/util-common.h"
 #include "util-streamer.h"
 #include "pipeline-msg.h"
-#include "thread/common-thread.h"
+#include "strand-thread.h"
 #include "if-pin.h"
 #include "if-pipeline.h"
-#include "if-sync-mgr.h"
+#include "audio-mixer.h"
+#include "frame-pool.h"
 #include "log.h"
 
 
@@ -25,8 +27,7 @@ class AudioMixElement
 	: public base::ProxyUnknown
 	, public base::ComObjTracer
 	, public media::util::ElementBase
-	, public util::CommonThread
-	, public ISyncHandler
+	, public media::util::StrandThread
 {
 public:
 	AudioMixElement(base::IComFactory* factory, const char* owner);
@@ -38,6 +39,7 @@ public:
 	// ElementBase
 	virtual com::ErrCode DoInit(com::IProperty* props) override;
 	virtual com::ErrCode DoStart() override;
+	virtual com::ErrCode DoStop() override;
 	virtual com::ErrCode PreProcPipelineMsg(
 		const com::CommonMsg& msg) override;
 
@@ -51,31 +53,37 @@ public:
 	virtual com::ErrCode OnSrcPinNegotiated(ISrcPin* pin,
 		const std::string& cap) override;
 
-	// CommonThread
-	virtual void ThreadProc() override;
-
-	// ISyncHandler
-	virtual void OnSyncUpdate(uint64_t timestamp) override;
-
 private:
 	com::ErrCode CreateSrcPin();
+	std::string MixPinCaps();
 	com::ErrCode OnAddSinkPin(const com::CommonMsg& msg);
 	com::ErrCode OnRemoveSinkPin(const com::CommonMsg& msg);
+	com::ErrCode OnMixInputGain(const com::CommonMsg& msg);
+	void ParseElementConfig();
+	void MixAndSend();
+	uint32_t MixProcess();
 
 private:
-	// FIXME: more than one sink pin, and has src pins
-	uint32_t m_sink_pin_index = 0;
-
-	media::com::VideoCap m_sink_pin_cap;
+	uint32_t m_src_pin_index = 0;
 
-	// Video data queue
-	std::queue<PinDataSP> m_data_que;
+	// Inputs and output have the same format, converted by upstream elements
+	media::util::AudioMixParam m_mix_param;
+	media::util::AudioMixerSP m_mixer;
 	std::mutex m_mutex;
-	std::condition_variable m_con_var;
 
-	// Synchronization
-	uint64_t m_av_sync_id = 0;
-	uint64_t m_audio_pts = 0;
+	// Sink pin:mixer input ID
+	std::map<ISinkPin*, uint32_t> m_pin_inputs;
+	uint32_t m_next_input_id = 1;
+
+	// Output frame is reused when downstream releases it
+	media::util::FramePool m_frame_pool { 16 };
+
+	// Mixed samples, timestamp of output
+	uint64_t m_mixed_samples = 0;
+	uint32_t m_frame_seq = 0;
+
+	// Due time of the next mixing
+	uint64_t m_next_tick = 0;
 };
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 ﻿#include "audio-recv-element.h"
 #include "util-streamer.h"
 #include "common/util-common.h"
+#include "common/util-time.h"
 #include "common/util-net.h"
 #include "common/util-pb.h"
 #include "net-message.h"
@@ -28,7 +29,7 @@ AudioRecvElement::AudioRecvElement(base::IComFactory* factory, const char* owner
 	: ProxyUnknown(nullptr)
 	, ComObjTracer(factory, CID_AUDIO_RECV, owner)
 	, ElementBase(factory)
-	, CommonThread("Audio recv element", false)
+	, StrandThread("Audio recv element")
 {
 	m_ele_name   = CONSTRUCT_ELEMENT_NAME("a-recv-");
 	m_main_type  = EleMainType::SRC;
@@ -47,7 +48,12 @@ AudioRecvElement::~AudioRecvElement()
 {
 	LOG_INF("Destruct {}", m_ele_name);
 
-	if (m_session_id != INVALID_SESSION_ID) {
+	StopJitterTimer();
+
+	if (m_sess_bundle) {
+		m_sess_bundle->RemoveMember(this);
+	}
+	else if (m_session_id != INVALID_SESSION_ID) {
 		m_sess_mgr->CloseSession(m_session_id);
 	}
 
@@ -137,6 +143,11 @@ ErrCode AudioRecvElement::ParseProperties(com::IProperty* props)
 		return ERR_CODE_FAILED;
 	}
 
+	m_sess_bundle = (util::SessionBundle*)props->GetPtrValue("session-bundle");
+	if (m_sess_bundle) {
+		LOG_INF("Read property session-bundle");
+	}
+
 	const void* info = props->GetPtrValue("media-stream");
 	if (!info) {
 		LOG_ERR("Invalid stream-id property!");
@@ -185,12 +196,32 @@ void AudioRecvElement::ParseElementConfig()
 				m_recv_dumper.reset(new util::DataDumper(m_ele_name + ".data"));
 			}
 		}
+
+		if (node["jitter-buffer"]) {
+			m_jitter_enabled = node["jitter-buffer"].as<bool>();
+		}
+
+		if (node["jitter-factor"]) {
+			m_jitter_param.jitter_factor = node["jitter-factor"].as<uint32_t>();
+		}
+
+		if (node["jitter-max-delay"]) {
+			m_jitter_param.max_delay_ms = node["jitter-max-delay"].as<uint32_t>();
+		}
 	}
 	catch (const std::exception& e) {
 		LOG_WRN("Error:{}", e.what());
 	}
 }
 
+//------------------------------------------------------------------------------
+// Request sequence must be unique in the bundled session
+//------------------------------------------------------------------------------
+uint32_t AudioRecvElement::AllocSeq()
+{
+	return m_sess_bundle ? m_sess_bundle->AllocSeq(this) : ++m_cur_seq;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -227,12 +258,36 @@ ErrCode AudioRecvElement::DoInit(com::IProperty* props)
 	StatsParam sn_stats("sn", StatsType::ISNAP, 5000);
 	m_sn_stats = m_data_stats->AddStats(sn_stats);
 
+	if (m_jitter_enabled) {
+		LOG_INF("Enable jitter buffer, factor:{}, max delay:{}",
+			m_jitter_param.jitter_factor, m_jitter_param.max_delay_ms);
+
+		m_jitter_buffer.reset(new media::util::JitterBuffer(
+			media::MediaType::AUDIO, m_jitter_param));
+
+		m_timer_mgr = QUERY_TIMER_MGR(m_factory);
+		assert(m_timer_mgr);
+
+		StatsParam jitter_stats("jitter", StatsType::IAVER, 5000);
+		m_jitter_stats = m_data_stats->AddStats(jitter_stats);
+
+		StatsParam jb_delay_stats("jb-delay", StatsType::IAVER, 5000);
+		m_jb_delay_stats = m_data_stats->AddStats(jb_delay_stats);
+
+		StatsParam jb_late_stats("jb-late", StatsType::IACCU, 5000);
+		m_jb_late_stats = m_data_stats->AddStats(jb_late_stats);
+
+		// Playout rate hint in permille, 1000 is normal speed
+		StatsParam jb_stretch_stats("jb-rate", StatsType::ISNAP, 5000);
+		m_jb_stretch_stats = m_data_stats->AddStats(jb_stretch_stats);
+	}
+
 	m_async_proxy.reset(new util::SessionAsyncProxy(m_factory, m_sess_mgr,
 		this, 10000));
 
 	m_pipeline->SubscribeMsg(PlMsgType::NEGOTIATE, this);
 
-	StartThread();
+	StartThread(m_pipeline->GetScheduler());
 
 	return ERR_CODE_OK;
 }
@@ -244,14 +299,22 @@ ErrCode AudioRecvElement::DoStart()
 {
 	LOG_INF("DoStart");
 
-	net::CreateParam param;
-	param.remote_addr  = m_service_addr;
-	param.ka_interval  = 5; // second
-	param.service_type = ServiceType::TRANSPORT;
-	param.session_type = net::SessionType::RELIABLE;
-	param.thread       = this;
+	StartJitterTimer();
+
+	if (m_sess_bundle) {
+		m_session_id = m_sess_bundle->AddMember(this);
+	}
+	else {
+		net::CreateParam param;
+		param.remote_addr  = m_service_addr;
+		param.ka_interval  = 5; // second
+		param.service_type = ServiceType::TRANSPORT;
+		param.session_type = net::SessionType::RELIABLE;
+		param.thread       = this;
+
+		m_session_id = m_sess_mgr->CreateSession(param);
+	}
 
-	m_session_id = m_sess_mgr->CreateSession(param);
 	if (m_session_id == INVALID_SESSION_ID) {
 		LOG_ERR("Create session failed!");
 		return ERR_CODE_FAILED;
@@ -436,13 +499,13 @@ void AudioRecvElement::OnSessionCreateResult(const CommonMsg& msg)
 	com::SigHdrParam hdr_param;
 	hdr_param.app_id  = m_stream_info.src.app_id;
 	hdr_param.user_id = m_stream_info.src.user_id;
-	hdr_param.seq     = ++m_cur_seq;
+	hdr_param.seq     = AllocSeq();
 
 
 	// Login receive channel
 	Buffer buf = prot::util::BuildLoginRecvChannelReq(req_param, hdr_param);
 
-	m_async_proxy->SendSessionMsg(data->lsid, buf, m_cur_seq,
+	m_async_proxy->SendSessionMsg(data->lsid, buf, hdr_param.seq,
 		prot::MSG_LOGIN_RECV_CHANNEL_RSP)
 		.OnResponse([this](net::SessionId sid, const com::Buffer& rsp) {
 			OnLoginRecvChannelRsp(rsp);
@@ -522,6 +585,24 @@ void AudioRecvElement::OnStreamFrame(uint32_t channel_id, uint32_t user_id,
 	m_data_stats->OnData(m_bc_stats, buf.data_len);
 	m_data_stats->OnData(m_sn_stats, hdr->fseq);
 
+	if (m_jitter_buffer) {
+		media::util::JitterFrame frame;
+		frame.ts = hdr->ts;
+		frame.buf = buf;
+		m_jitter_buffer->InputFrame(frame, util::Now() / 1000);
+	}
+	else {
+		DeliverFrame(buf);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void AudioRecvElement::DeliverFrame(const com::Buffer& buf)
+{
+	prot::AudioFrameHdr* hdr = (prot::AudioFrameHdr*)DP(buf);
+
 	PinData pin_data(media::MediaType::AUDIO);
 
 	pin_data.dts = hdr->ts;
@@ -564,6 +645,63 @@ void AudioRecvElement::OnStreamFrame(uint32_t channel_id, uint32_t user_id,
 	}
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void AudioRecvElement::StartJitterTimer()
+{
+	if (!m_jitter_buffer || m_jitter_timer_id != INVALID_TIMER_ID) {
+		return;
+	}
+
+	com::TimerParam timer_param;
+	timer_param.timeout = 10;
+	timer_param.timer_type = TimerType::TIMER_TYPE_LOOP;
+	timer_param.timer_name = "audio jitter buffer timer";
+	timer_param.timer_func = [this](int64_t) {
+		// Jitter buffer is only accessed in element thread
+		Execute([this](util::CallParam) { ReleaseJitterFrames(); }, nullptr);
+	};
+
+	m_jitter_timer_id = m_timer_mgr->AllocTimer(timer_param);
+	m_timer_mgr->StartTimer(m_jitter_timer_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void AudioRecvElement::StopJitterTimer()
+{
+	if (m_jitter_timer_id != INVALID_TIMER_ID) {
+		m_timer_mgr->StopTimer(m_jitter_timer_id);
+		m_timer_mgr->FreeTimer(m_jitter_timer_id);
+		m_jitter_timer_id = INVALID_TIMER_ID;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Stretch hint is reported for player, playout delay is lowered slowly anyway
+//------------------------------------------------------------------------------
+void AudioRecvElement::ReleaseJitterFrames()
+{
+	std::vector<media::util::JitterFrame> frames;
+	m_jitter_buffer->PopFrames(util::Now() / 1000, frames);
+
+	for (const auto& frame : frames) {
+		DeliverFrame(frame.buf);
+	}
+
+	if (!frames.empty()) {
+		media::util::JitterStats stats = m_jitter_buffer->Stats();
+		m_data_stats->OnData(m_jitter_stats, stats.jitter_ms);
+		m_data_stats->OnData(m_jb_delay_stats, stats.delay_ms);
+		m_data_stats->OnData(m_jb_late_stats, 
+			stats.late_frames - m_jb_late_frames);
+		m_data_stats->OnData(m_jb_stretch_stats, 1000 + stats.stretch_permille);
+		m_jb_late_frames = stats.late_frames;
+	}
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
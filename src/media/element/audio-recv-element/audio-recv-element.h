@@ -10,9 +10,12 @@
 #include "common/util-dump.h"
 #include "util-streamer.h"
 #include "if-session-mgr.h"
-#include "thread/common-thread.h"
+#include "strand-thread.h"
 #include "async/session-async-proxy.h"
+#include "async/session-bundle.h"
 #include "if-stream-receiver.h"
+#include "if-timer-mgr.h"
+#include "jitter-buffer.h"
 
 
 // yaml-cpp warning
@@ -29,7 +32,7 @@ class AudioRecvElement
 	: public media::util::ElementBase
 	, public base::ProxyUnknown
 	, public base::ComObjTracer
-	, public util::CommonThread
+	, public media::util::StrandThread
 	, public txp::IStreamReceiverHandler
 {
 public:
@@ -50,7 +53,7 @@ public:
 	virtual com::ErrCode OnSrcPinNegotiated(ISrcPin* pin,
 		const std::string& cap) override;
 
-	// CommonThread
+	// StrandThread
 	virtual void OnThreadMsg(const com::CommonMsg& msg) override;
 
 	// IReceiverHandler
@@ -66,6 +69,7 @@ public:
 private:
 	com::ErrCode CreateSrcPin();
 	com::ErrCode ParseProperties(com::IProperty* props);
+	uint32_t AllocSeq();
 	com::ErrCode OnPipelineNegotiateMsg(const com::CommonMsg& msg);
 
 	void OnSessionData(const com::CommonMsg& msg);
@@ -80,6 +84,10 @@ private:
 	void OnLoginRecvChannelError(com::ErrCode ec);
 	void UpdateCaps(media::AudioChnls chnls, media::AudioSRate srate);
 	void ParseElementConfig();
+	void StartJitterTimer();
+	void StopJitterTimer();
+	void ReleaseJitterFrames();
+	void DeliverFrame(const com::Buffer& buf);
 
 private:
 	uint32_t m_src_pin_index = 0;
@@ -97,9 +105,16 @@ private:
 	util::StatsId m_bc_stats = INVALID_STATS_ID;
 	util::StatsId m_fc_stats = INVALID_STATS_ID;
 	util::StatsId m_sn_stats = INVALID_STATS_ID;
+	util::StatsId m_jitter_stats = INVALID_STATS_ID;
+	util::StatsId m_jb_delay_stats = INVALID_STATS_ID;
+	util::StatsId m_jb_late_stats = INVALID_STATS_ID;
+	util::StatsId m_jb_stretch_stats = INVALID_STATS_ID;
 
 	util::SessionAsyncProxySP m_async_proxy;
 
+	// Session shared with other streams to the same service, optional
+	util::SessionBundle* m_sess_bundle = nullptr;
+
 	txp::IStreamReceiver* m_stream_receiver = nullptr;
 
 	uint32_t m_cur_seq = 0;
@@ -110,6 +125,14 @@ private:
 	util::IDataDumperSP m_recv_dumper;
 
 	bool m_receiving_data = false;
+
+	// Frames are released by jitter buffer in element thread, optional
+	bool m_jitter_enabled = false;
+	media::util::JitterParam m_jitter_param;
+	media::util::JitterBufferSP m_jitter_buffer;
+	com::ITimerMgr* m_timer_mgr = nullptr;
+	com::TimerId m_jitter_timer_id = INVALID_TIMER_ID;
+	uint32_t m_jb_late_frames = 0;
 };
 
 }
\ No newline at end of file
@@ -29,7 +29,7 @@ namespace jukey::stmr
 AudioSendElement::AudioSendElement(base::IComFactory* factory, const char* owner)
 	: base::ProxyUnknown(nullptr)
 	, base::ComObjTracer(factory, CID_AUDIO_SEND, owner)
-	, CommonThread("audio send element", false)
+	, StrandThread("audio send element")
 	, ElementBase(factory)
 {
 	m_ele_name   = CONSTRUCT_ELEMENT_NAME("a-send-");
@@ -49,11 +49,20 @@ AudioSendElement::~AudioSendElement()
 {
 	LOG_INF("Destruct {}", m_ele_name);
 
+	StopThread();
+
 	if (m_stream_sender) {
 		m_stream_sender->Release();
 		m_stream_sender = nullptr;
 	}
 
+	if (m_sess_bundle) {
+		m_sess_bundle->RemoveMember(this);
+	}
+	else if (m_session_id != INVALID_SESSION_ID) {
+		m_sess_mgr->CloseSession(m_session_id);
+	}
+
 	m_async_proxy->Stop();
 }
 
@@ -133,6 +142,11 @@ ErrCode AudioSendElement::ParseProperties(com::IProperty* props)
 		return ERR_CODE_FAILED;
 	}
 
+	m_sess_bundle = (util::SessionBundle*)props->GetPtrValue("session-bundle");
+	if (m_sess_bundle) {
+		LOG_INF("Read property session-bundle");
+	}
+
 	const void* vp = props->GetPtrValue("media-stream");
 	if (!vp) {
 		LOG_ERR("Invalid stream-id property!");
@@ -190,6 +204,14 @@ void AudioSendElement::ParseElementConfig()
 	}
 }
 
+//------------------------------------------------------------------------------
+// Request sequence must be unique in the bundled session
+//------------------------------------------------------------------------------
+uint32_t AudioSendElement::AllocSeq()
+{
+	return m_sess_bundle ? m_sess_bundle->AllocSeq(this) : ++m_cur_seq;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -226,7 +248,7 @@ ErrCode AudioSendElement::DoInit(com::IProperty* props)
 	StatsParam sn_stats("sn", StatsType::ISNAP, 5000);
 	m_sn_stats = m_data_stats->AddStats(sn_stats);
 
-	StartThread();
+	StartThread(m_pipeline->GetScheduler());
 
 	m_async_proxy.reset(new util::SessionAsyncProxy(m_factory, m_sess_mgr,
 		this, 10000));
@@ -241,14 +263,20 @@ ErrCode AudioSendElement::DoStart()
 {
 	LOG_INF("DoStart");
 
-	net::CreateParam param;
-	param.remote_addr  = m_service_addr;
-	param.ka_interval  = 5; // second
-	param.service_type = ServiceType::TRANSPORT;
-	param.session_type = net::SessionType::RELIABLE;
-	param.thread       = this;
+	if (m_sess_bundle) {
+		m_session_id = m_sess_bundle->AddMember(this);
+	}
+	else {
+		net::CreateParam param;
+		param.remote_addr  = m_service_addr;
+		param.ka_interval  = 5; // second
+		param.service_type = ServiceType::TRANSPORT;
+		param.session_type = net::SessionType::RELIABLE;
+		param.thread       = this;
+
+		m_session_id = m_sess_mgr->CreateSession(param);
+	}
 
-	m_session_id = m_sess_mgr->CreateSession(param);
 	if (m_session_id == INVALID_SESSION_ID) {
 		LOG_ERR("Create session failed!");
 		return ERR_CODE_FAILED;
@@ -500,12 +528,12 @@ void AudioSendElement::OnSessionCreateResult(const CommonMsg& msg)
 	com::SigHdrParam hdr_param;
 	hdr_param.app_id  = m_stream_info.src.app_id;
 	hdr_param.user_id = m_stream_info.src.user_id;
-	hdr_param.seq     = ++m_cur_seq;
+	hdr_param.seq     = AllocSeq();
 
 	// Login send channel
 	Buffer buf = prot::util::BuildLoginSendChannelReq(req_param, hdr_param);
 
-	m_async_proxy->SendSessionMsg(data->lsid, buf, m_cur_seq,
+	m_async_proxy->SendSessionMsg(data->lsid, buf, hdr_param.seq,
 		prot::MSG_LOGIN_SEND_CHANNEL_RSP)
 		.OnResponse([this](net::SessionId sid, const com::Buffer& rsp) {
 			OnLoginSendChannelRsp(rsp);
@@ -559,6 +587,8 @@ void AudioSendElement::OnStreamData(uint32_t channel_id, uint32_t user_id,
 	prot::SigMsgHdr* sig_hdr = (prot::SigMsgHdr*)DP(sig_buf);
 	m_data_stats->OnData(m_sn_stats, sig_hdr->seq);
 
+	sig_hdr->grp = channel_id; // route on bundled session
+
 	if (ERR_CODE_OK != m_sess_mgr->SendData(m_session_id, sig_buf)) {
 		LOG_ERR("Send session data failed!");
 	}
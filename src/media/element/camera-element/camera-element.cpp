@@ -603,8 +603,18 @@ void CameraElement::ProcSampleSync()
 		return;
 	}
 
-	// Copy frame data
-	PinData pin_data(media::MediaType::VIDEO, buf, cur_len);
+	// Copy frame data into pooled frame
+	PinData pin_data(media::MediaType::VIDEO);
+	uint32_t frame_len = static_cast<uint32_t>(cur_len);
+	if (!m_frame_pool.AllocFrame(pin_data, &frame_len, 1)) {
+		LOG_ERR("Alloc frame failed!");
+		media_buf->Unlock();
+		media_buf->Release();
+		sample->Release();
+		m_mutex.unlock();
+		return;
+	}
+	memcpy(DP(pin_data.media_data[0]), buf, frame_len);
 
 	media_buf->Unlock();
 	media_buf->Release();
@@ -612,7 +622,8 @@ void CameraElement::ProcSampleSync()
 
 	m_mutex.unlock();
 
-	pin_data.dts = util::Now() - time_start;
+	// Media timestamp is in milliseconds(tbd), as frame header expects
+	pin_data.dts = (util::Now() - time_start) / 1000;
 	pin_data.pts = pin_data.dts;
 	pin_data.drt = 0;
 	pin_data.pos = 0;
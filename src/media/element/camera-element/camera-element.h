@@ -11,6 +11,8 @@
 #include "util-streamer.h"
 #include "pipeline-msg.h"
 #include "stream-dumper.h"
+#include "frame-pool.h"
+#include "common-config.h"
 
 
 // yaml-cpp warning
@@ -96,6 +98,9 @@ private:
 	uint32_t m_frame_rate = 30;
 	uint32_t m_frame_seq = 0;
 
+	// Frames are shared by downstream elements without copy
+	media::util::FramePool m_frame_pool { VIDEO_FRAME_POOL_SIZE };
+
 	media::util::StreamDumperSP m_cam_dumper;
 
 	std::mutex m_mutex;
@@ -510,7 +510,8 @@ void MicrophoneElement::ProcSampleSync()
 				PinData pin_data(media::MediaType::AUDIO, buf, cur_len);
 
 				// Set data attributes
-				pin_data.dts = util::Now() - time_start;
+				// Media timestamp is in milliseconds(tbd), as frame header expects
+				pin_data.dts = (util::Now() - time_start) / 1000;
 				pin_data.pts = pin_data.dts;
 				pin_data.drt = 0;
 				pin_data.pos = 0;
@@ -526,7 +527,7 @@ void MicrophoneElement::ProcSampleSync()
 				para->chnls = m_src_pin_cap.chnls;
 				para->power = 0;
 				para->count = sample_count;
-				para->ts = (uint32_t)(util::Now() - time_start);
+				para->ts = (uint32_t)pin_data.dts;
 				para->srate = m_src_pin_cap.srate;
 				para->seq = m_frame_seq;
 
@@ -27,11 +27,6 @@ RecordElement::RecordElement(base::IComFactory* factory, const char* owner)
 	if (ERR_CODE_OK != CreateAudioSinkPin() || ERR_CODE_OK != CreateVideoSinkPin()) {
 		m_pins_created = false;
 	}
-
-	int result = av_bsf_alloc(av_bsf_get_by_name("h264_mp4toannexb"), &m_video_bsf_ctx);
-	if (result < 0) {
-		LOG_ERR("av_bsf_alloc video failed, error:{}", result);
-	}
 }
 
 //------------------------------------------------------------------------------
@@ -40,6 +35,8 @@ RecordElement::RecordElement(base::IComFactory* factory, const char* owner)
 RecordElement::~RecordElement()
 {
 	LOG_INF("Destruct {}", m_ele_name);
+
+	StopRecord();
 }
 
 //------------------------------------------------------------------------------
@@ -156,6 +153,32 @@ void RecordElement::InitStats()
 
   util::StatsParam a_br_stats("audio-bit-rate",  util::StatsType::IAVER, 1000);
 	m_audio_br_stats = m_data_stats->AddStats(a_br_stats);
+
+	util::StatsParam depth_stats("record-queue-depth", util::StatsType::ISNAP, 1000);
+	m_queue_depth_stats = m_data_stats->AddStats(depth_stats);
+
+	util::StatsParam write_stats("record-write-rate", util::StatsType::IAVER, 1000);
+	m_write_rate_stats = m_data_stats->AddStats(write_stats);
+
+	util::StatsParam drop_stats("record-drop-count", util::StatsType::IACCU, 1000);
+	m_drop_stats = m_data_stats->AddStats(drop_stats);
+}
+
+//------------------------------------------------------------------------------
+// Writer stats are sampled on the pipeline thread, counters are reported as
+// increments
+//------------------------------------------------------------------------------
+void RecordElement::UpdateWriterStats(RecordWriter& writer)
+{
+	RecordWriterStats stats = writer.Stats();
+
+	m_data_stats->OnData(m_queue_depth_stats, stats.depth);
+	m_data_stats->OnData(m_write_rate_stats,
+		(uint32_t)(stats.file_bytes - m_writer_stats.file_bytes));
+	m_data_stats->OnData(m_drop_stats,
+		(uint32_t)(stats.dropped - m_writer_stats.dropped));
+
+	m_writer_stats = stats;
 }
 
 //------------------------------------------------------------------------------
@@ -180,16 +203,6 @@ ErrCode RecordElement::DoInit(com::IProperty* props)
 
 	m_record_file.assign(record_file);
 
-	int result = avformat_alloc_output_context2(
-		&m_output_fmt_ctx,
-		NULL,
-		"mp4",
-		m_record_file.c_str());
-	if (result < 0 || !m_output_fmt_ctx) {
-		LOG_ERR("avformat_alloc_output_context2 failed, result:{}", result);
-		return ERR_CODE_FAILED;
-	}	
-
   InitStats();
 
 	//av_log_set_callback(LogCallback);
@@ -204,30 +217,7 @@ ErrCode RecordElement::DoStart()
 {
 	LOG_INF("{}", __FUNCTION__);
 
-	//if (m_audio_sink_pin->Cap().empty() || m_sink_pins[m_video_pin_index]->Cap().empty()) {
-	if (m_sink_pins[m_video_pin_index]->Cap().empty()) {
-		LOG_WRN("Not negotiated!");
-		return ERR_CODE_OK;
-	}
-
-	// 打开文件IO上下文
-	int result = avio_open(&m_output_fmt_ctx->pb, m_record_file.c_str(),
-		AVIO_FLAG_WRITE);
-	if (result < 0) {
-		LOG_ERR("avio_open failed, result:{}", result);
-		avformat_free_context(m_output_fmt_ctx);
-		return ERR_CODE_FAILED;
-	}
-
-	// 写入文件头信息
-	result = avformat_write_header(m_output_fmt_ctx, NULL);
-	if (result < 0) {
-		LOG_ERR("avformat_write_header failed, result:{}", result);
-		avformat_free_context(m_output_fmt_ctx);
-		return ERR_CODE_FAILED;
-	}
-
-	return ERR_CODE_OK;
+	return StartRecord();
 }
 
 //------------------------------------------------------------------------------
@@ -241,53 +231,148 @@ ErrCode RecordElement::DoPause()
 }
 
 //------------------------------------------------------------------------------
-// 
+// Pause keeps the writer, resume after stop records to a new segment
 //------------------------------------------------------------------------------
 ErrCode RecordElement::DoResume()
 {
 	LOG_INF("{}", __FUNCTION__);
 
+	return StartRecord();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ErrCode RecordElement::DoStop()
+{
+	LOG_INF("{}", __FUNCTION__);
+
+	StopRecord();
+
+	return ERR_CODE_OK;
+}
+
+//------------------------------------------------------------------------------
+// Fragmented MP4 cannot be appended after the trailer, so record restarted
+// after stop goes to "<name>-<n>.<ext>" instead of truncating the last file
+//------------------------------------------------------------------------------
+std::string RecordElement::SegmentFile()
+{
+	if (m_segment_count == 0) {
+		return m_record_file;
+	}
+
+	std::string segment = "-" + std::to_string(m_segment_count);
+
+	size_t dot = m_record_file.find_last_of('.');
+	size_t slash = m_record_file.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		return m_record_file + segment;
+	}
+
+	return std::string(m_record_file).insert(dot, segment);
+}
+
+//------------------------------------------------------------------------------
+// Streams are created here, file is opened and written by the writer
+//------------------------------------------------------------------------------
+ErrCode RecordElement::StartRecord()
+{
+	if (m_writer) {
+		return ERR_CODE_OK;
+	}
+
 	//if (m_audio_sink_pin->Cap().empty() || m_sink_pins[m_video_pin_index]->Cap().empty()) {
 	if (m_sink_pins[m_video_pin_index]->Cap().empty()) {
 		LOG_WRN("Not negotiated!");
 		return ERR_CODE_OK;
 	}
 
-	// 打开文件IO上下文
-	int result = avio_open(&m_output_fmt_ctx->pb, m_record_file.c_str(),
-		AVIO_FLAG_WRITE);
-	if (result < 0) {
-		LOG_ERR("avio_open failed, result:{}", result);
-		avformat_free_context(m_output_fmt_ctx);
+	std::string record_file = SegmentFile();
+
+	int result = avformat_alloc_output_context2(
+		&m_output_fmt_ctx,
+		NULL,
+		"mp4",
+		record_file.c_str());
+	if (result < 0 || !m_output_fmt_ctx) {
+		LOG_ERR("avformat_alloc_output_context2 failed, result:{}", result);
 		return ERR_CODE_FAILED;
 	}
 
-	// 写入文件头信息
-	result = avformat_write_header(m_output_fmt_ctx, NULL);
-	if (result < 0) {
-		LOG_ERR("avformat_write_header failed, result:{}", result);
-		avformat_free_context(m_output_fmt_ctx);
+	if (ERR_CODE_OK != OpenVideoStream()) {
+		LOG_ERR("Open video stream failed!");
+		StopRecord();
+		return ERR_CODE_FAILED;
+	}
+
+	if (!m_sink_pins[m_audio_pin_index]->Cap().empty()
+		&& ERR_CODE_OK != OpenAudioStream()) {
+		LOG_ERR("Open audio stream failed!");
+		StopRecord();
 		return ERR_CODE_FAILED;
 	}
 
+	int video_index = m_video_stream->index;
+	int audio_index = m_audio_stream ? m_audio_stream->index : -1;
+
+	// Writer takes the ownership of format context
+	RecordWriterSP writer(new RecordWriter(record_file));
+	ErrCode ec = writer->Start(m_output_fmt_ctx);
+	m_output_fmt_ctx = nullptr;
+
+	if (ec != ERR_CODE_OK) {
+		LOG_ERR("Start record writer failed!");
+		StopRecord();
+		return ERR_CODE_FAILED;
+	}
+
+	m_writer_stats = RecordWriterStats();
+	m_segment_count++;
+
+	{
+		std::lock_guard<std::mutex> lock(m_writer_mutex);
+		m_writer = writer;
+		m_video_index = video_index;
+		m_audio_index = audio_index;
+	}
+
 	return ERR_CODE_OK;
 }
 
 //------------------------------------------------------------------------------
-// 
+// Queued packets and trailer are written before return, pin threads holding
+// the writer are refused after that
 //------------------------------------------------------------------------------
-ErrCode RecordElement::DoStop()
+void RecordElement::StopRecord()
 {
-	LOG_INF("{}", __FUNCTION__);
+	RecordWriterSP writer;
+	{
+		std::lock_guard<std::mutex> lock(m_writer_mutex);
+		writer.swap(m_writer);
+		m_video_index = -1;
+		m_audio_index = -1;
+	}
+
+	if (writer) {
+		writer->Stop();
+	}
 
 	if (m_output_fmt_ctx) {
-		av_write_trailer(m_output_fmt_ctx);
-		avio_close(m_output_fmt_ctx->pb);
 		avformat_free_context(m_output_fmt_ctx);
 		m_output_fmt_ctx = nullptr;
 	}
 
-	return ERR_CODE_OK;
+	if (m_video_codec_ctx) {
+		avcodec_free_context(&m_video_codec_ctx);
+	}
+
+	if (m_audio_codec_ctx) {
+		avcodec_free_context(&m_audio_codec_ctx);
+	}
+
+	m_audio_stream = nullptr;
+	m_video_stream = nullptr;
 }
 
 //------------------------------------------------------------------------------
@@ -302,7 +387,7 @@ ErrCode RecordElement::OpenVideoStream()
 		return ERR_CODE_FAILED;
 	}
 
-	AVCodecContext* m_video_codec_ctx = avcodec_alloc_context3(codec);
+	m_video_codec_ctx = avcodec_alloc_context3(codec);
 	m_video_codec_ctx->codec_id = media::util::ToFfVideoCodec(m_video_sink_pin_cap.codec);
 	m_video_codec_ctx->codec_type = AVMEDIA_TYPE_VIDEO;
 	m_video_codec_ctx->pix_fmt = media::util::ToFfPixelFormat(m_video_sink_pin_cap.format);
@@ -340,19 +425,6 @@ ErrCode RecordElement::OpenVideoStream()
 		return ERR_CODE_FAILED;
 	}
 
-	AVCodecParameters* p = avcodec_parameters_alloc();
-	result = avcodec_parameters_copy(p, m_video_stream->codecpar);
-	if (result < 0) {
-		LOG_ERR("avcodec_parameters_copy failed, error:{}", result);
-		return ERR_CODE_FAILED;
-	}
-	m_video_bsf_ctx->par_in = p;
-	result = av_bsf_init(m_video_bsf_ctx);
-	if (result < 0) {
-		LOG_ERR("av_bsf_init failed, error:{}", result);
-		return ERR_CODE_FAILED;
-	}
-
 	return ERR_CODE_OK;
 }
 
@@ -367,7 +439,8 @@ ErrCode RecordElement::OpenAudioStream()
 		LOG_ERR("Fail to find audio encoder!");
 		return ERR_CODE_FAILED;
 	}
-	AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
+	m_audio_codec_ctx = avcodec_alloc_context3(codec);
+	AVCodecContext* codec_ctx = m_audio_codec_ctx;
 	codec_ctx->codec_id = media::util::ToFfAudioCodec(m_audio_sink_pin_cap.codec);
 	codec_ctx->codec_type = AVMEDIA_TYPE_AUDIO;
 	codec_ctx->sample_fmt = media::util::ToFfSampleFormat(m_audio_sink_pin_cap.sbits);
@@ -399,106 +472,39 @@ ErrCode RecordElement::OpenAudioStream()
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ErrCode RecordElement::OnAudioPinData(ISinkPin* pin, const PinData& data)
+ErrCode RecordElement::OnAudioPinData(RecordWriter& writer, int stream_index,
+	const PinData& data)
 {
-	AVRational src_tb;
-	src_tb.num = data.tbn;
-	src_tb.den = data.tbd;
-
-	int64_t pts = av_rescale_q_rnd(
-		data.pts,
-		src_tb,
-		m_audio_stream->time_base,
-		(AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
-	int64_t dts = av_rescale_q_rnd(
-		data.dts,
-		src_tb,
-		m_audio_stream->time_base,
-		(AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
-	int64_t duration = av_rescale_q(data.drt, src_tb, m_audio_stream->time_base);
-
-	LOG_INF("rescale dts:{}, pts:{}, drt:{}", dts, pts, duration);
-
-	AVPacket* packet = av_packet_alloc();
-	packet->dts = dts;
-	packet->pts = pts;
-	packet->duration = duration;
-	packet->data = data.media_data->data.get();
-	packet->size = data.media_data->data_len;
-	packet->pos = data.pos;
-	packet->stream_index = m_audio_stream->index;
-
-	int result = av_interleaved_write_frame(m_output_fmt_ctx, packet);
-	if (result != 0) {
-		LOG_ERR("av_interleaved_write_frame failed, error:{}", result);
-		av_packet_unref(packet);
+	if (stream_index < 0) {
+		return ERR_CODE_OK; // audio is not recorded
+	}
+
+	if (ERR_CODE_OK != writer.QueuePacket(stream_index, data)) {
+		LOG_ERR("Queue audio packet failed!");
 		return ERR_CODE_FAILED;
 	}
 
 	m_data_stats->OnData(m_audio_br_stats, data.media_data->data_len);
 
-	av_packet_unref(packet);
 	return ERR_CODE_OK;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ErrCode RecordElement::OnVideoPinData(ISinkPin* pin, const PinData& data)
+ErrCode RecordElement::OnVideoPinData(RecordWriter& writer, int stream_index,
+	const PinData& data)
 {
-	AVRational src_tb;
-	src_tb.num = data.tbn;
-	src_tb.den = data.tbd;
-
-	int64_t pts = av_rescale_q_rnd(
-		data.pts,
-		src_tb,
-		m_video_stream->time_base,
-		(AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
-	int64_t dts = av_rescale_q_rnd(
-		data.dts,
-		src_tb,
-		m_video_stream->time_base,
-		(AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
-	int64_t duration = av_rescale_q(data.drt, src_tb, m_video_stream->time_base);
-
-	LOG_INF("rescale dts:{}, pts:{}, drt:{}", dts, pts, duration);
-
-	AVPacket* packet = av_packet_alloc();
-	packet->dts = dts;
-	packet->pts = pts;
-	packet->duration = duration;
-	packet->data = data.media_data->data.get();
-	packet->size = data.media_data->data_len;
-	packet->pos = -1;
-	packet->stream_index = m_video_stream->index;
-
-	int result = av_bsf_send_packet(m_video_bsf_ctx, packet);
-	if (result == 0) {
-		result = av_bsf_receive_packet(m_video_bsf_ctx, packet);
-		if (result != 0) {
-			LOG_ERR("av_bsf_receive_packet failed, result:{}", result);
-			av_packet_unref(packet);
-			return ERR_CODE_FAILED;
-		}
-	}
-	else {
-		LOG_ERR("av_bsf_send_packet failed, result:{}", result);
-		av_packet_unref(packet);
-		return ERR_CODE_FAILED;
-	}
-
-	result = av_interleaved_write_frame(m_output_fmt_ctx, packet);
-	if (result != 0) {
-		LOG_ERR("av_interleaved_write_frame failed, error:{}", result);
-		av_packet_unref(packet);
+	if (ERR_CODE_OK != writer.QueuePacket(stream_index, data)) {
+		LOG_ERR("Queue video packet failed!");
 		return ERR_CODE_FAILED;
 	}
 
 	m_data_stats->OnData(m_video_fr_stats, 1);
 	m_data_stats->OnData(m_video_br_stats, data.media_data->data_len);
 
-	av_packet_unref(packet);
+	UpdateWriterStats(writer);
+
 	return ERR_CODE_OK;
 }
 
@@ -512,16 +518,26 @@ ErrCode RecordElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
 		return ERR_CODE_FAILED;
 	}
 
-	if (!m_output_fmt_ctx) {
-		LOG_ERR("Invalid avformat context!");
+	// Writer may be stopped by the control thread at the same time
+	RecordWriterSP writer;
+	int stream_index = -1;
+	{
+		std::lock_guard<std::mutex> lock(m_writer_mutex);
+		writer = m_writer;
+		stream_index = (data.mt == media::MediaType::AUDIO) ? m_audio_index
+			: m_video_index;
+	}
+
+	if (!writer) {
+		LOG_ERR("Invalid record writer!");
 		return ERR_CODE_FAILED;
 	}
 
 	if (data.mt == media::MediaType::AUDIO) {
-		return OnAudioPinData(pin, data);
+		return OnAudioPinData(*writer, stream_index, data);
 	}
 	else {
-		return OnVideoPinData(pin, data);
+		return OnVideoPinData(*writer, stream_index, data);
 	}
 }
 
@@ -535,7 +551,7 @@ ErrCode RecordElement::OnSinkPinNegotiated(ISinkPin* pin, const std::string& cap
 
 	if (pin->Name() == m_sink_pins[m_audio_pin_index]->Name()) {
 		auto audio_cap = media::util::ParseAudioCap(cap);
-		if (!audio_cap.has_value()) {
+		if (audio_cap.has_value()) {
 			m_audio_sink_pin_cap = audio_cap.value();
 		}
 		else {
@@ -546,7 +562,7 @@ ErrCode RecordElement::OnSinkPinNegotiated(ISinkPin* pin, const std::string& cap
 
 	if (pin->Name() == m_sink_pins[m_video_pin_index]->Name()) {
 		auto video_cap = media::util::ParseVideoCap(cap);
-		if (!video_cap.has_value()) {
+		if (video_cap.has_value()) {
 			m_video_sink_pin_cap = video_cap.value();
 		}
 		else {
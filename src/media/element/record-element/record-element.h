@@ -8,6 +8,7 @@
 #include "if-pipeline.h"
 #include "common/util-stats.h"
 #include "util-streamer.h"
+#include "record-writer.h"
 
 extern "C"
 {
@@ -57,10 +58,16 @@ private:
 	com::ErrCode CreateVideoSinkPin();
 	com::ErrCode OpenAudioStream();
 	com::ErrCode OpenVideoStream();
+	com::ErrCode StartRecord();
+	void StopRecord();
 	com::ErrCode OnPinEndOfStream(ISinkPin* pin, const PinMsg& msg);
-	com::ErrCode OnAudioPinData(ISinkPin* pin, const PinData& data);
-	com::ErrCode OnVideoPinData(ISinkPin* pin, const PinData& data);
+	com::ErrCode OnAudioPinData(RecordWriter& writer, int stream_index,
+		const PinData& data);
+	com::ErrCode OnVideoPinData(RecordWriter& writer, int stream_index,
+		const PinData& data);
+	std::string SegmentFile();
   void InitStats();
+	void UpdateWriterStats(RecordWriter& writer);
 
 private:
 	uint32_t m_audio_pin_index = 0;
@@ -71,6 +78,9 @@ private:
 
 	std::string m_record_file;
 
+	// Record restarted after stop goes to a new file, see SegmentFile
+	uint32_t m_segment_count = 0;
+
 	// FFMPEG
 	AVFormatContext* m_output_fmt_ctx = nullptr;
 	AVStream* m_audio_stream = nullptr;
@@ -82,8 +92,18 @@ private:
 	util::StatsId m_audio_br_stats = INVALID_STATS_ID;
 	util::StatsId m_video_br_stats = INVALID_STATS_ID;
 	util::StatsId m_video_fr_stats = INVALID_STATS_ID;
-
-	AVBSFContext* m_video_bsf_ctx = nullptr;
+	util::StatsId m_queue_depth_stats = INVALID_STATS_ID;
+	util::StatsId m_write_rate_stats = INVALID_STATS_ID;
+	util::StatsId m_drop_stats = INVALID_STATS_ID;
+
+	// Packets are written to file by the writer thread. Pin threads take a copy
+	// of the writer and stream indexes under the mutex, so stopping never
+	// releases the writer in use.
+	std::mutex m_writer_mutex;
+	RecordWriterSP m_writer;
+	int m_audio_index = -1;
+	int m_video_index = -1;
+	RecordWriterStats m_writer_stats;
 };
 
 }
\ No newline at end of file
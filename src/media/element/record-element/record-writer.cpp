@@ -0,0 +1,484 @@
+#include "record-writer.h"
+#include "common/util-time.h"
+#include "util-streamer.h"
+#include "log.h"
+
+#include "public/media-struct.h"
+
+using namespace jukey::com;
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// H264 annex-b frame, nal_ref_idc of the first slice is 0, so no other frame
+// references it and it can be dropped without breaking decoding. x264 with
+// zerolatency and no B-frame never outputs one, see RecordWriter.
+//------------------------------------------------------------------------------
+bool IsH264NonRefFrame(const uint8_t* data, uint32_t len)
+{
+	for (uint32_t i = 0; i + 3 < len; i++) {
+		if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) {
+			continue;
+		}
+
+		uint8_t nal_hdr = data[i + 3];
+		uint8_t nal_type = nal_hdr & 0x1F;
+		if (nal_type == 1 || nal_type == 5) { // slice
+			return (nal_hdr & 0x60) == 0;
+		}
+		i += 3;
+	}
+
+	return false;
+}
+
+}
+
+namespace jukey::stmr
+{
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+RecordWriter::RecordWriter(CSTREF file) : m_file(file)
+{
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+RecordWriter::~RecordWriter()
+{
+	Stop();
+}
+
+//------------------------------------------------------------------------------
+// Large file writes, the buffer of muxer output is written as a whole
+//------------------------------------------------------------------------------
+int RecordWriter::OnFileWrite(void* opaque, uint8_t* buf, int buf_size)
+{
+	RecordWriter* writer = static_cast<RecordWriter*>(opaque);
+
+	size_t result = fwrite(buf, 1, buf_size, writer->m_fp);
+	if (result != (size_t)buf_size) {
+		LOG_ERR("Write file:{} failed, size:{}, written:{}", writer->m_file,
+			buf_size, result);
+		return AVERROR(EIO);
+	}
+
+	writer->m_file_writes++;
+	writer->m_file_bytes += buf_size;
+
+	return buf_size;
+}
+
+//------------------------------------------------------------------------------
+// Muxer output is buffered by AVIO, the file itself is unbuffered so each
+// buffer goes to the file in one write
+//------------------------------------------------------------------------------
+bool RecordWriter::OpenFile()
+{
+	m_fp = fopen(m_file.c_str(), "wb");
+	if (!m_fp) {
+		LOG_ERR("Open file:{} failed!", m_file);
+		return false;
+	}
+	setvbuf(m_fp, nullptr, _IONBF, 0);
+
+	uint8_t* buf = (uint8_t*)av_malloc(RECORD_WRITE_BUFFER_SIZE);
+	if (!buf) {
+		LOG_ERR("Allocate write buffer failed!");
+		return false;
+	}
+
+	m_avio_ctx = avio_alloc_context(buf, RECORD_WRITE_BUFFER_SIZE, 1, this,
+		nullptr, &RecordWriter::OnFileWrite, nullptr);
+	if (!m_avio_ctx) {
+		LOG_ERR("avio_alloc_context failed!");
+		av_free(buf);
+		return false;
+	}
+	m_avio_ctx->seekable = 0; // fragmented MP4 is written sequentially
+
+	m_fmt_ctx->pb = m_avio_ctx;
+	m_fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void RecordWriter::CloseFile()
+{
+	if (m_avio_ctx) {
+		avio_flush(m_avio_ctx);
+		av_freep(&m_avio_ctx->buffer);
+		avio_context_free(&m_avio_ctx);
+	}
+
+	if (m_fmt_ctx) {
+		m_fmt_ctx->pb = nullptr;
+	}
+
+	if (m_fp) {
+		fclose(m_fp);
+		m_fp = nullptr;
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ErrCode RecordWriter::Start(AVFormatContext* fmt_ctx)
+{
+	if (!fmt_ctx || fmt_ctx->nb_streams == 0) {
+		LOG_ERR("Invalid format context!");
+		if (fmt_ctx) avformat_free_context(fmt_ctx);
+		return ERR_CODE_INVALID_PARAM;
+	}
+
+	m_fmt_ctx = fmt_ctx;
+
+	if (!OpenFile()) {
+		LOG_ERR("Open file failed!");
+		return ERR_CODE_FAILED;
+	}
+
+	for (uint32_t i = 0; i < m_fmt_ctx->nb_streams; i++) {
+		AVStream* stream = m_fmt_ctx->streams[i];
+		bool video = (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO);
+
+		m_queues.push_back(StreamQueueUP(new StreamQueue(video)));
+
+		if (!video || stream->codecpar->codec_id != AV_CODEC_ID_H264) {
+			continue;
+		}
+
+		int result = av_bsf_alloc(av_bsf_get_by_name("h264_mp4toannexb"),
+			&m_bsf_ctx);
+		if (result < 0) {
+			LOG_ERR("av_bsf_alloc failed, error:{}", result);
+			return ERR_CODE_FAILED;
+		}
+
+		avcodec_parameters_copy(m_bsf_ctx->par_in, stream->codecpar);
+		m_bsf_ctx->time_base_in = stream->time_base;
+
+		result = av_bsf_init(m_bsf_ctx);
+		if (result < 0) {
+			LOG_ERR("av_bsf_init failed, error:{}", result);
+			return ERR_CODE_FAILED;
+		}
+	}
+
+	m_start_time = util::Now();
+	m_running = true;
+	m_thread = std::thread(&RecordWriter::WriterThread, this);
+
+	LOG_INF("Start record writer, file:{}, streams:{}", m_file, m_queues.size());
+
+	return ERR_CODE_OK;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void RecordWriter::Stop()
+{
+	if (m_thread.joinable()) {
+		{
+			// Wait for the producers in QueuePacket
+			std::unique_lock<std::shared_mutex> lock(m_queue_mutex);
+			m_running = false;
+		}
+		m_cv.notify_one();
+		m_thread.join();
+
+		RecordWriterStats stats = Stats();
+		LOG_INF("Stop record writer, file:{}, pushed:{}, written:{}, dropped:{}, "
+			"file writes:{}, file bytes:{}, max depth:{}, max delay:{}us", m_file,
+			stats.pushed, stats.written, stats.dropped, stats.file_writes,
+			stats.file_bytes, stats.max_depth, stats.max_delay_us);
+	}
+
+	CloseFile();
+
+	if (m_bsf_ctx) {
+		av_bsf_free(&m_bsf_ctx);
+	}
+
+	if (m_fmt_ctx) {
+		avformat_free_context(m_fmt_ctx);
+		m_fmt_ctx = nullptr;
+	}
+
+	std::unique_lock<std::shared_mutex> lock(m_queue_mutex);
+	m_queues.clear();
+}
+
+//------------------------------------------------------------------------------
+// Return false if the packet should be dropped
+//------------------------------------------------------------------------------
+bool RecordWriter::MakeRoom(StreamQueue& queue, uint32_t size)
+{
+	auto full = [this, &queue, size]() {
+		return queue.ring.Full()
+			|| m_queued_bytes.load() + size > RECORD_QUEUE_MAX_BYTES;
+	};
+
+	// Key frame or audio, make room by dropping the oldest of the stream,
+	// decoding recovers at the key frame
+	while (full()) {
+		RecordPacketUP oldest = queue.ring.DropOldest();
+		if (oldest) {
+			DropPacket(*oldest);
+		}
+		else if (queue.ring.Size() == 0) {
+			break; // bytes are queued by other streams
+		}
+	}
+
+	return !queue.ring.Full();
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void RecordWriter::DropPacket(const RecordPacket& packet)
+{
+	m_queued_bytes -= packet.size;
+	m_dropped++;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ErrCode RecordWriter::QueuePacket(int stream_index, const PinData& data)
+{
+	std::shared_lock<std::shared_mutex> lock(m_queue_mutex);
+
+	if (!m_running) {
+		return ERR_CODE_FAILED;
+	}
+
+	if (stream_index < 0 || stream_index >= (int)m_queues.size()) {
+		LOG_ERR("Invalid stream index:{}", stream_index);
+		return ERR_CODE_INVALID_PARAM;
+	}
+
+	StreamQueue& queue = *m_queues[stream_index];
+	uint32_t size = data.media_data[0].data_len;
+
+	bool key = true;
+	if (queue.video) {
+		auto para = SPC<media::VideoFramePara>(data.media_para);
+		key = para && para->key;
+
+		// Frames after a dropped reference frame are undecodable
+		if (queue.wait_key && !key) {
+			m_dropped++;
+			return ERR_CODE_OK;
+		}
+		queue.wait_key = false;
+
+		bool full = queue.ring.Full()
+			|| m_queued_bytes.load() + size > RECORD_QUEUE_MAX_BYTES;
+		if (full && !key) {
+			if (!IsH264NonRefFrame(DP(data.media_data[0]), size)) {
+				queue.wait_key = true;
+			}
+			m_dropped++;
+			return ERR_CODE_OK;
+		}
+	}
+
+	if (!MakeRoom(queue, size)) {
+		m_dropped++;
+		return ERR_CODE_OK;
+	}
+
+	RecordPacketUP packet(new RecordPacket());
+	packet->data = media::util::ClonePinData(data);
+	packet->size = size;
+	packet->key = key;
+	packet->push_time = util::Now();
+
+	m_queued_bytes += size;
+	if (!queue.ring.Push(packet)) {
+		m_queued_bytes -= size;
+		m_dropped++;
+		return ERR_CODE_OK;
+	}
+	m_pushed++;
+
+	uint32_t depth = queue.ring.Size();
+	if (depth > m_max_depth) {
+		m_max_depth = depth;
+	}
+
+	if (m_sleeping) {
+		m_cv.notify_one();
+	}
+
+	return ERR_CODE_OK;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void RecordWriter::WritePacket(int stream_index, const RecordPacket& packet)
+{
+	AVStream* stream = m_fmt_ctx->streams[stream_index];
+	const PinData& data = *packet.data;
+
+	AVRational src_tb;
+	src_tb.num = data.tbn;
+	src_tb.den = data.tbd;
+
+	AVPacket* av_packet = av_packet_alloc();
+	av_packet->pts = av_rescale_q_rnd(data.pts, src_tb, stream->time_base,
+		(AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
+	av_packet->dts = av_rescale_q_rnd(data.dts, src_tb, stream->time_base,
+		(AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
+	av_packet->duration = av_rescale_q(data.drt, src_tb, stream->time_base);
+	av_packet->data = DP(data.media_data[0]);
+	av_packet->size = data.media_data[0].data_len;
+	av_packet->pos = -1;
+	av_packet->stream_index = stream_index;
+	if (packet.key) {
+		av_packet->flags |= AV_PKT_FLAG_KEY;
+	}
+
+	int result = 0;
+	if (m_queues[stream_index]->video && m_bsf_ctx) {
+		result = av_bsf_send_packet(m_bsf_ctx, av_packet);
+		if (result < 0) {
+			LOG_ERR("av_bsf_send_packet failed, result:{}", result);
+		}
+		while (result >= 0) {
+			result = av_bsf_receive_packet(m_bsf_ctx, av_packet);
+			if (result < 0) {
+				break;
+			}
+			result = av_interleaved_write_frame(m_fmt_ctx, av_packet);
+			if (result < 0) {
+				LOG_ERR("av_interleaved_write_frame failed, error:{}", result);
+			}
+		}
+	}
+	else {
+		result = av_interleaved_write_frame(m_fmt_ctx, av_packet);
+		if (result < 0) {
+			LOG_ERR("av_interleaved_write_frame failed, error:{}", result);
+		}
+	}
+
+	av_packet_free(&av_packet);
+
+	uint64_t delay = util::Now() - packet.push_time;
+	m_delay_sum += delay;
+	if (delay > m_max_delay) {
+		m_max_delay = delay;
+	}
+	m_queued_bytes -= packet.size;
+	m_written++;
+}
+
+//------------------------------------------------------------------------------
+// Return false if no packet is queued
+//------------------------------------------------------------------------------
+bool RecordWriter::WriteQueuedPackets()
+{
+	bool written = false;
+
+	for (uint32_t i = 0; i < m_queues.size(); i++) {
+		RecordPacketUP packet;
+		for (uint32_t j = 0; j < kMaxBatchPackets; j++) {
+			if (!m_queues[i]->ring.Pop(packet)) {
+				break;
+			}
+			WritePacket(i, *packet);
+			written = true;
+		}
+	}
+
+	return written;
+}
+
+//------------------------------------------------------------------------------
+// Fragment is cut at key frame or fragment duration, the file is playable up
+// to the last complete fragment
+//------------------------------------------------------------------------------
+void RecordWriter::WriterThread()
+{
+	AVDictionary* opts = nullptr;
+	av_dict_set(&opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+	av_dict_set_int(&opts, "frag_duration", RECORD_FRAGMENT_MS * 1000, 0);
+	av_dict_set_int(&opts, "flush_packets", 0, 0);
+
+	int result = avformat_write_header(m_fmt_ctx, &opts);
+	av_dict_free(&opts);
+	if (result < 0) {
+		LOG_ERR("avformat_write_header failed, file:{}, result:{}", m_file,
+			result);
+		m_running = false;
+		return;
+	}
+
+	while (m_running) {
+		if (WriteQueuedPackets()) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_sleeping = true;
+		m_cv.wait_for(lock, std::chrono::milliseconds(10));
+		m_sleeping = false;
+	}
+
+	// Producers have stopped
+	while (WriteQueuedPackets());
+
+	result = av_write_trailer(m_fmt_ctx);
+	if (result < 0) {
+		LOG_ERR("av_write_trailer failed, file:{}, result:{}", m_file, result);
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+RecordWriterStats RecordWriter::Stats()
+{
+	RecordWriterStats stats;
+
+	{
+		std::shared_lock<std::shared_mutex> lock(m_queue_mutex);
+		for (const auto& queue : m_queues) {
+			stats.depth += queue->ring.Size();
+		}
+	}
+	stats.max_depth = m_max_depth;
+	stats.queued_bytes = m_queued_bytes;
+	stats.pushed = m_pushed;
+	stats.written = m_written;
+	stats.dropped = m_dropped;
+	stats.file_writes = m_file_writes;
+	stats.file_bytes = m_file_bytes;
+	stats.max_delay_us = m_max_delay;
+
+	if (stats.written > 0) {
+		stats.avg_delay_us = m_delay_sum / stats.written;
+	}
+
+	uint64_t elapsed = util::Now() - m_start_time;
+	if (m_start_time != 0 && elapsed > 0) {
+		stats.throughput = stats.file_bytes * 1000000 / elapsed;
+	}
+
+	return stats;
+}
+
+}
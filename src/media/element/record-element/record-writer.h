@@ -0,0 +1,149 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+
+#include "common-define.h"
+#include "common-error.h"
+#include "common-config.h"
+#include "if-pin.h"
+#include "common/spsc-ring.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+namespace jukey::stmr
+{
+
+//==============================================================================
+//
+//==============================================================================
+struct RecordWriterStats
+{
+	uint32_t depth = 0;          // packets queued
+	uint32_t max_depth = 0;
+	uint64_t queued_bytes = 0;
+	uint64_t pushed = 0;         // packets queued
+	uint64_t written = 0;        // packets written to muxer
+	uint64_t dropped = 0;        // packets dropped for queue pressure
+	uint64_t file_writes = 0;    // writes to file
+	uint64_t file_bytes = 0;     // bytes written to file
+	uint64_t throughput = 0;     // bytes per second written to file
+	uint64_t avg_delay_us = 0;   // from queued to written
+	uint64_t max_delay_us = 0;
+};
+
+//==============================================================================
+// Write-behind MP4 writer. Packets are queued by the pipeline threads and
+// muxed by a dedicated writer thread, so disk stalls never block the pipeline.
+// Output is fragmented MP4, which is playable up to the last fragment if the
+// process crashes. Muxer output is buffered and written to file in large
+// blocks. Under queue pressure, non-reference video frames are dropped first,
+// then video frames until next key frame; audio drops the oldest packet. The
+// encoder of this repo has no B-frame and every P-frame is a reference, so its
+// video is dropped by the rest of GOP, non-reference drop is for other sources.
+//==============================================================================
+class RecordWriter
+{
+public:
+	RecordWriter(CSTREF file);
+	~RecordWriter();
+
+	//
+	// @brief Streams of fmt_ctx must be created, writer takes the ownership of
+	//        fmt_ctx, header is written in the writer thread
+	//
+	com::ErrCode Start(AVFormatContext* fmt_ctx);
+
+	//
+	// @brief Write queued packets and trailer, then close the file
+	//
+	void Stop();
+
+	//
+	// @brief Packets of a stream must be queued by one thread at a time, it is
+	//        safe to queue while stopping, packets are refused after Stop
+	//
+	com::ErrCode QueuePacket(int stream_index, const PinData& data);
+
+	RecordWriterStats Stats();
+
+private:
+	struct RecordPacket
+	{
+		PinDataSP data;
+		uint32_t size = 0;
+		bool key = false;
+		uint64_t push_time = 0; // us
+	};
+	typedef std::unique_ptr<RecordPacket> RecordPacketUP;
+
+	struct StreamQueue
+	{
+		StreamQueue(bool v) : video(v), ring(RECORD_QUEUE_SIZE) {}
+
+		bool video = false;
+		bool wait_key = false; // reference frame dropped
+		util::SpscRing<RecordPacket> ring;
+	};
+	typedef std::unique_ptr<StreamQueue> StreamQueueUP;
+
+	static int OnFileWrite(void* opaque, uint8_t* buf, int buf_size);
+
+	bool OpenFile();
+	void CloseFile();
+	void WriterThread();
+	bool WriteQueuedPackets();
+	void WritePacket(int stream_index, const RecordPacket& packet);
+	bool MakeRoom(StreamQueue& queue, uint32_t size);
+	void DropPacket(const RecordPacket& packet);
+
+private:
+	std::string m_file;
+
+	AVFormatContext* m_fmt_ctx = nullptr;
+	AVBSFContext* m_bsf_ctx = nullptr; // h264_mp4toannexb
+	AVIOContext* m_avio_ctx = nullptr;
+	FILE* m_fp = nullptr;
+
+	std::vector<StreamQueueUP> m_queues;
+
+	// Producers hold it shared while queueing, Stop holds it exclusive to stop
+	// them, so queues are never accessed after clear
+	std::shared_mutex m_queue_mutex;
+
+	std::thread m_thread;
+	std::atomic<bool> m_running { false };
+	std::atomic<bool> m_header_written { false };
+
+	// Wake up the writer thread
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::atomic<bool> m_sleeping { false };
+
+	uint64_t m_start_time = 0; // us
+
+	std::atomic<uint64_t> m_queued_bytes { 0 };
+	std::atomic<uint32_t> m_max_depth { 0 };
+	std::atomic<uint64_t> m_pushed { 0 };
+	std::atomic<uint64_t> m_written { 0 };
+	std::atomic<uint64_t> m_dropped { 0 };
+	std::atomic<uint64_t> m_file_writes { 0 };
+	std::atomic<uint64_t> m_file_bytes { 0 };
+	std::atomic<uint64_t> m_delay_sum { 0 }; // us
+	std::atomic<uint64_t> m_max_delay { 0 }; // us
+
+	// Packets written of each stream before checking other streams
+	static const uint32_t kMaxBatchPackets = 32;
+};
+typedef std::shared_ptr<RecordWriter> RecordWriterSP;
+
+}
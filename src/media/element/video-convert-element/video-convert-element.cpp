@@ -288,12 +288,34 @@ ErrCode VideoConvertElement::ConvertPinData(const PinData& data)
 	uint32_t width = media::util::GetWidth(m_src_pin_cap.res);
 	AVPixelFormat format = media::util::ToFfPixelFormat(m_src_pin_cap.format);
 
-	int buf_size = av_image_get_buffer_size(format, width, height, 1);
-	std::shared_ptr<uint8_t> buf(new uint8_t[buf_size]);
-
 	uint8_t* dst_data[8] = { 0 };
 	int dst_linesize[8] = { 0 };
-	av_image_fill_arrays(dst_data, dst_linesize, buf.get(), format, width, height, 1);
+	av_image_fill_linesizes(dst_linesize, format, width);
+
+	PinData new_data(media::MediaType::VIDEO);
+
+	// Convert into pooled frame directly
+	uint32_t plane_lens[3] = { 0 };
+	uint32_t plane_count = 0;
+	if (m_use_planar) { // planar
+		for (; plane_count < 3 && dst_linesize[plane_count] > 0; plane_count++) {
+			plane_lens[plane_count] = dst_linesize[plane_count] 
+				* (plane_count == 0 ? height : height / 2);
+		}
+	}
+	else { // packed
+		plane_lens[0] = av_image_get_buffer_size(format, width, height, 1);
+		plane_count = 1;
+	}
+
+	if (!m_frame_pool.AllocFrame(new_data, plane_lens, plane_count)) {
+		LOG_ERR("Alloc frame failed!");
+		return ERR_CODE_FAILED;
+	}
+
+	for (uint32_t i = 0; i < plane_count; i++) {
+		dst_data[i] = DP(new_data.media_data[i]);
+	}
 	
 	int result = sws_scale(m_sws_ctx, 
 		(uint8_t const* const*)src_data,
@@ -307,7 +329,6 @@ ErrCode VideoConvertElement::ConvertPinData(const PinData& data)
 		return ERR_CODE_FAILED;
 	}
 
-	PinData new_data(media::MediaType::VIDEO);
 	new_data.dts = data.dts;
 	new_data.pts = data.pts;
 	new_data.drt = 0;
@@ -316,34 +337,9 @@ ErrCode VideoConvertElement::ConvertPinData(const PinData& data)
 	new_data.tbn = data.tbn;
 	new_data.tbd = data.tbd;
 
-	// Copy data
-	if (m_use_planar) { // planar
-		if (dst_linesize[0] > 0) {
-			new_data.media_data[0].data_len = dst_linesize[0] * height;
-			new_data.media_data[0].data.reset(dst_data[0], util::NoDestruct);
-			new_data.data_count++;
-		}
-
-		if (dst_linesize[1] > 0) {
-			new_data.media_data[1].data_len = dst_linesize[1] * height / 2;
-			new_data.media_data[1].data.reset(dst_data[1], util::NoDestruct);
-			new_data.data_count++;
-		}
-
-		if (dst_linesize[2] > 0) {
-			new_data.media_data[2].data_len = dst_linesize[2] * height / 2;
-			new_data.media_data[2].data.reset(dst_data[2], util::NoDestruct);
-			new_data.data_count++;
-		}
-	}
-	else { // packed
-		new_data.media_data[0].data_len = buf_size;
-		new_data.media_data[0].data.reset(buf.get(), util::NoDestruct);
-		new_data.data_count = 1;
-	}
-
-	// Copy parameters and update capability
-	new_data.media_para = data.media_para;
+	// Parameters are shared with upstream, copy before update
+	new_data.media_para.reset(new media::VideoFramePara(
+		*SPC<media::VideoFramePara>(data.media_para)));
 	
 	auto para = SPC<media::VideoFramePara>(new_data.media_para);
 	para->height = media::util::GetHeight(m_src_pin_cap.res);
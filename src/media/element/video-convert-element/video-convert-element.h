@@ -5,6 +5,8 @@
 #include "util-streamer.h"
 #include "if-pin.h"
 #include "element-base.h"
+#include "frame-pool.h"
+#include "common-config.h"
 #include "log.h"
 
 extern "C"
@@ -79,6 +81,9 @@ private:
 	SwsContext* m_sws_ctx = nullptr;
 	bool m_need_convert = true;
 	bool m_use_planar = true;
+
+	// Converted frames are shared by downstream elements without copy
+	media::util::FramePool m_frame_pool { VIDEO_FRAME_POOL_SIZE };
 };
 
 }
\ No newline at end of file
@@ -294,27 +294,37 @@ ErrCode VideoDecodeElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
 			break;
 		}
 
+		// Planes reference the decoded frame instead of copy, the frame buffer
+		// goes back to decoder after all planes are released
+		std::shared_ptr<AVFrame> frame(av_frame_clone(m_frame),
+			[](AVFrame* f) { av_frame_free(&f); });
+		av_frame_unref(m_frame);
+		if (!frame) {
+			LOG_ERR("av_frame_clone failed!");
+			break;
+		}
+
 		PinData decoded_data(media::MediaType::VIDEO);
-		decoded_data.dts = m_frame->pkt_dts;
-		decoded_data.pts = m_frame->pts;
-		decoded_data.drt = m_frame->pkt_duration;
-		decoded_data.pos = m_frame->pkt_pos;
+		decoded_data.dts = frame->pkt_dts;
+		decoded_data.pts = frame->pts;
+		decoded_data.drt = frame->pkt_duration;
+		decoded_data.pos = frame->pkt_pos;
 		decoded_data.syn = data.syn;
 		decoded_data.tbn = data.tbn;
 		decoded_data.tbd = data.tbd;
 
-		decoded_data.media_data[0].data.reset(m_frame->data[0], 
-			util::NoDestruct);
+		decoded_data.media_data[0].data = std::shared_ptr<uint8_t>(frame, 
+			frame->data[0]);
 		decoded_data.media_data[0].data_len = 
-			m_frame->linesize[0] * m_frame->height;
-		decoded_data.media_data[1].data.reset(m_frame->data[1], 
-			util::NoDestruct);
+			frame->linesize[0] * frame->height;
+		decoded_data.media_data[1].data = std::shared_ptr<uint8_t>(frame, 
+			frame->data[1]);
 		decoded_data.media_data[1].data_len = 
-			m_frame->linesize[1] * m_frame->height / 2;
-		decoded_data.media_data[2].data.reset(m_frame->data[2], 
-			util::NoDestruct);
+			frame->linesize[1] * frame->height / 2;
+		decoded_data.media_data[2].data = std::shared_ptr<uint8_t>(frame, 
+			frame->data[2]);
 		decoded_data.media_data[2].data_len = 
-			m_frame->linesize[2] * m_frame->height / 2;
+			frame->linesize[2] * frame->height / 2;
 
 		decoded_data.data_count = 3;
 
@@ -325,8 +335,6 @@ ErrCode VideoDecodeElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
 		if (m_ad_dumper) {
 			m_ad_dumper->WriteStreamData(decoded_data);
 		}
-
-		av_frame_unref(m_frame);
 	}
 	av_packet_unref(&packet);
 
@@ -34,8 +34,6 @@ VideoEncodeElement::VideoEncodeElement(base::IComFactory* factory,
 	if (ERR_CODE_OK != CreateSrcPin() || ERR_CODE_OK != CreateSinkPin()) {
 		m_pins_created = false;
 	}
-
-	x264_picture_init(&m_out_pic);
 }
 
 //------------------------------------------------------------------------------
@@ -196,6 +194,16 @@ void VideoEncodeElement::ParseElementConfig()
 				m_stream_dumper.reset(new StreamDumper(m_ele_name + ".data"));
 			}
 		}
+
+		if (node["simulcast-layers"]) {
+			uint32_t layers = node["simulcast-layers"].as<uint32_t>();
+			if (layers >= 1 && layers <= kMaxSimulcastLayers) {
+				m_simulcast_layers = layers;
+			}
+			else {
+				LOG_WRN("Invalid simulcast layers:{}", layers);
+			}
+		}
 	}
 	catch (const std::exception& e) {
 		LOG_WRN("Error:{}", e.what());
@@ -287,10 +295,8 @@ ErrCode VideoEncodeElement::DoStop()
 
 	m_data_stats->Stop();
 
-	if (m_x264_encoder) {
-		x264_encoder_close(m_x264_encoder);
-		m_x264_encoder = nullptr;
-	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	DestroyEncoder();
 
 	return ERR_CODE_OK;
 }
@@ -298,17 +304,87 @@ ErrCode VideoEncodeElement::DoStop()
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ErrCode VideoEncodeElement::CreateEncoder()
+static void DownscalePlane(const uint8_t* src, int src_stride, uint8_t* dst,
+	int dst_stride, uint32_t width, uint32_t height, uint32_t pixel_bytes)
 {
-	LOG_INF("Create encoder, birate:{}", m_curr_bitrate_kbps);
+	uint32_t row_bytes = width * pixel_bytes;
+
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t* s0 = src + 2 * y * src_stride;
+		const uint8_t* s1 = s0 + src_stride;
+		uint8_t* d = dst + y * dst_stride;
+
+		// 2x2 box filter, interleaved components are averaged separately
+		for (uint32_t i = 0; i < row_bytes; i++) {
+			uint32_t x = (i / pixel_bytes) * 2 * pixel_bytes + i % pixel_bytes;
+			d[i] = (uint8_t)((s0[x] + s0[x + pixel_bytes] + s1[x]
+				+ s1[x + pixel_bytes] + 2) >> 2);
+		}
+	}
+}
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+//------------------------------------------------------------------------------
+// Each lower layer halves the resolution and the bitrate of the upper one, layers
+// are not created if the resolution can not be halved
+//------------------------------------------------------------------------------
+void VideoEncodeElement::InitLayers()
+{
+	SimulcastLayer top;
+	top.width = media::util::GetWidth(m_sink_pin_cap.res);
+	top.height = media::util::GetHeight(m_sink_pin_cap.res);
+
+	m_layers.assign(1, top);
+
+	while (m_layers.size() < m_simulcast_layers) {
+		const SimulcastLayer& upper = m_layers.front();
+		if (upper.width % 4 != 0 || upper.height % 4 != 0
+			|| upper.width / 2 < kMinLayerWidth
+			|| upper.height / 2 < kMinLayerHeight) {
+			LOG_WRN("Cannot downscale {}x{}, layers:{}", upper.width, upper.height,
+				m_layers.size());
+			break;
+		}
+
+		SimulcastLayer lower;
+		lower.width = upper.width / 2;
+		lower.height = upper.height / 2;
+		m_layers.insert(m_layers.begin(), lower);
+	}
+
+	// Weights are 1:2:4 from the lowest layer
+	uint32_t total_weight = (1 << m_layers.size()) - 1;
+	for (uint32_t i = 0; i < m_layers.size(); i++) {
+		m_layers[i].bitrate_kbps = m_curr_bitrate_kbps * (1 << i) / total_weight;
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void VideoEncodeElement::DestroyEncoder()
+{
+	for (auto& layer : m_layers) {
+		if (layer.encoder) {
+			x264_encoder_close(layer.encoder);
+			layer.encoder = nullptr;
+		}
 
-	if (m_x264_encoder) {
-		x264_encoder_close(m_x264_encoder);
-		m_x264_encoder = nullptr;
+		if (layer.pic_alloc) {
+			x264_picture_clean(&layer.in_pic);
+			layer.pic_alloc = false;
+		}
 	}
 
+	m_layers.clear();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ErrCode VideoEncodeElement::CreateLayerEncoder(uint32_t index, int csp)
+{
+	SimulcastLayer& layer = m_layers[index];
+
 	x264_param_t x264_param;
 
 	/* Get default params for preset/tuning */
@@ -325,9 +401,9 @@ ErrCode VideoEncodeElement::CreateEncoder()
 	/* Configure non-default params */
 	x264_param.i_bitdepth = 8;
 	x264_param.i_bframe = 0;
-	x264_param.i_csp = media::util::ToX264PixelFormat(m_sink_pin_cap.format);
-	x264_param.i_width = media::util::GetWidth(m_sink_pin_cap.res);
-	x264_param.i_height = media::util::GetHeight(m_sink_pin_cap.res);
+	x264_param.i_csp = csp;
+	x264_param.i_width = layer.width;
+	x264_param.i_height = layer.height;
 	x264_param.i_timebase_num = 1;
 	x264_param.i_timebase_den = 50;
 	x264_param.i_fps_den = 1;
@@ -340,13 +416,15 @@ ErrCode VideoEncodeElement::CreateEncoder()
 
 	// Bitrate
 	x264_param.rc.i_rc_method = X264_RC_ABR;
-	x264_param.rc.i_bitrate = m_curr_bitrate_kbps;
-	x264_param.rc.i_vbv_max_bitrate = m_curr_bitrate_kbps;
+	x264_param.rc.i_bitrate = layer.bitrate_kbps;
+	x264_param.rc.i_vbv_max_bitrate = layer.bitrate_kbps;
 	x264_param.rc.f_rate_tolerance = 1.0;
 
-	// GOP
+	// GOP, key frames of all layers are aligned for switching on server, scene
+	// cut would insert key frames by content of each layer
 	x264_param.i_keyint_max = 30;
 	x264_param.i_keyint_min = 30;
+	x264_param.i_scenecut_threshold = 0;
 
 	/* Apply profile restrictions. */
 	if (x264_param_apply_profile(&x264_param, "high") < 0) {
@@ -354,20 +432,53 @@ ErrCode VideoEncodeElement::CreateEncoder()
 		return ERR_CODE_FAILED;
 	}
 
-	m_x264_encoder = x264_encoder_open(&x264_param);
-	if (!m_x264_encoder) {
+	layer.encoder = x264_encoder_open(&x264_param);
+	if (!layer.encoder) {
 		LOG_ERR("Create x264 encoder failed!");
 		return ERR_CODE_FAILED;
 	}
 
-	LOG_INF("Create x264 encoder success, format:{}, resolution:{}",
-		media::util::VIDEO_FMT_STR(m_sink_pin_cap.format),
-		media::util::VIDEO_RES_STR(m_sink_pin_cap.res));
+	LOG_INF("Create x264 encoder success, layer:{}, format:{}, resolution:{}x{}, "
+		"bitrate:{}", index, media::util::VIDEO_FMT_STR(m_sink_pin_cap.format),
+		layer.width, layer.height, layer.bitrate_kbps);
 
-	if (x264_picture_alloc(&m_in_pic, x264_param.i_csp, x264_param.i_width,
-		x264_param.i_height) < 0) {
-		LOG_ERR("x264_picture_alloc failed!");
-		return ERR_CODE_FAILED;
+	x264_picture_init(&layer.out_pic);
+
+	// Planes of the top layer point to input data
+	if (index + 1 == m_layers.size()) {
+		x264_picture_init(&layer.in_pic);
+		layer.in_pic.img.i_csp = csp;
+	}
+	else {
+		if (x264_picture_alloc(&layer.in_pic, csp, layer.width, layer.height) < 0) {
+			LOG_ERR("x264_picture_alloc failed!");
+			return ERR_CODE_FAILED;
+		}
+		layer.pic_alloc = true;
+	}
+
+	return ERR_CODE_OK;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ErrCode VideoEncodeElement::CreateEncoder()
+{
+	LOG_INF("Create encoder, birate:{}, layers:{}", m_curr_bitrate_kbps,
+		m_simulcast_layers);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	DestroyEncoder();
+	InitLayers();
+
+	int csp = media::util::ToX264PixelFormat(m_sink_pin_cap.format);
+	for (uint32_t i = 0; i < m_layers.size(); i++) {
+		if (ERR_CODE_OK != CreateLayerEncoder(i, csp)) {
+			DestroyEncoder();
+			return ERR_CODE_FAILED;
+		}
 	}
 	
 	return ERR_CODE_OK;
@@ -378,31 +489,33 @@ ErrCode VideoEncodeElement::CreateEncoder()
 //------------------------------------------------------------------------------
 ErrCode VideoEncodeElement::FillX264InPicture(const PinData& data)
 {
+	x264_picture_t& in_pic = m_layers.back().in_pic;
+
 	if (data.data_count == 1) { // packed
 		if (m_sink_pin_cap.format == media::PixelFormat::I420) {
-			m_in_pic.img.plane[0] = data.media_data[0].data.get();
-			m_in_pic.img.plane[1] = data.media_data[0].data.get() 
+			in_pic.img.plane[0] = data.media_data[0].data.get();
+			in_pic.img.plane[1] = data.media_data[0].data.get() 
 				+ data.media_data[0].data_len * 2 / 3;
-			m_in_pic.img.plane[2] = data.media_data[0].data.get() 
+			in_pic.img.plane[2] = data.media_data[0].data.get() 
 				+ data.media_data[0].data_len * 3 / 4;
 
-			m_in_pic.img.i_stride[0] = media::util::GetWidth(m_sink_pin_cap.res);
-			m_in_pic.img.i_stride[1] = media::util::GetWidth(m_sink_pin_cap.res) / 2;
-			m_in_pic.img.i_stride[2] = media::util::GetWidth(m_sink_pin_cap.res) / 2;
+			in_pic.img.i_stride[0] = media::util::GetWidth(m_sink_pin_cap.res);
+			in_pic.img.i_stride[1] = media::util::GetWidth(m_sink_pin_cap.res) / 2;
+			in_pic.img.i_stride[2] = media::util::GetWidth(m_sink_pin_cap.res) / 2;
 
-			m_in_pic.img.i_plane = 3;
+			in_pic.img.i_plane = 3;
 		}
 		else if (m_sink_pin_cap.format == media::PixelFormat::NV12) {
-			m_in_pic.img.plane[0] = data.media_data[0].data.get();
-			m_in_pic.img.plane[1] = data.media_data[0].data.get() 
+			in_pic.img.plane[0] = data.media_data[0].data.get();
+			in_pic.img.plane[1] = data.media_data[0].data.get() 
 				+ data.media_data[0].data_len / 2;
-			m_in_pic.img.plane[2] = 0;
+			in_pic.img.plane[2] = 0;
 
-			m_in_pic.img.i_stride[0] = media::util::GetWidth(m_sink_pin_cap.res);
-			m_in_pic.img.i_stride[1] = media::util::GetWidth(m_sink_pin_cap.res);
-			m_in_pic.img.i_stride[2] = 0;
+			in_pic.img.i_stride[0] = media::util::GetWidth(m_sink_pin_cap.res);
+			in_pic.img.i_stride[1] = media::util::GetWidth(m_sink_pin_cap.res);
+			in_pic.img.i_stride[2] = 0;
 
-			m_in_pic.img.i_plane = 2;
+			in_pic.img.i_plane = 2;
 		}
 		else {
 			LOG_ERR("Unsupported pixel format:{}", m_sink_pin_cap.format);
@@ -411,26 +524,26 @@ ErrCode VideoEncodeElement::FillX264InPicture(const PinData& data)
 	}
 	else { // planar
 		if (m_sink_pin_cap.format == media::PixelFormat::I420) {
-			m_in_pic.img.plane[0] = data.media_data[0].data.get();
-			m_in_pic.img.plane[1] = data.media_data[1].data.get();
-			m_in_pic.img.plane[2] = data.media_data[2].data.get();
+			in_pic.img.plane[0] = data.media_data[0].data.get();
+			in_pic.img.plane[1] = data.media_data[1].data.get();
+			in_pic.img.plane[2] = data.media_data[2].data.get();
 
-			m_in_pic.img.i_stride[0] = media::util::GetWidth(m_sink_pin_cap.res);
-			m_in_pic.img.i_stride[1] = media::util::GetWidth(m_sink_pin_cap.res) / 2;
-			m_in_pic.img.i_stride[2] = media::util::GetWidth(m_sink_pin_cap.res) / 2;
+			in_pic.img.i_stride[0] = media::util::GetWidth(m_sink_pin_cap.res);
+			in_pic.img.i_stride[1] = media::util::GetWidth(m_sink_pin_cap.res) / 2;
+			in_pic.img.i_stride[2] = media::util::GetWidth(m_sink_pin_cap.res) / 2;
 
-			m_in_pic.img.i_plane = 3;
+			in_pic.img.i_plane = 3;
 		}
 		else if (m_sink_pin_cap.format == media::PixelFormat::NV12) {
-			m_in_pic.img.plane[0] = data.media_data[0].data.get();
-			m_in_pic.img.plane[1] = data.media_data[1].data.get();
-			m_in_pic.img.plane[2] = 0;
+			in_pic.img.plane[0] = data.media_data[0].data.get();
+			in_pic.img.plane[1] = data.media_data[1].data.get();
+			in_pic.img.plane[2] = 0;
 
-			m_in_pic.img.i_stride[0] = media::util::GetWidth(m_sink_pin_cap.res);
-			m_in_pic.img.i_stride[1] = media::util::GetWidth(m_sink_pin_cap.res);
-			m_in_pic.img.i_stride[2] = 0;
+			in_pic.img.i_stride[0] = media::util::GetWidth(m_sink_pin_cap.res);
+			in_pic.img.i_stride[1] = media::util::GetWidth(m_sink_pin_cap.res);
+			in_pic.img.i_stride[2] = 0;
 
-			m_in_pic.img.i_plane = 2;
+			in_pic.img.i_plane = 2;
 		}
 		else {
 			LOG_ERR("Unsupported pixel format:{}", m_sink_pin_cap.format);
@@ -438,51 +551,77 @@ ErrCode VideoEncodeElement::FillX264InPicture(const PinData& data)
 		}
 	}
 
-	m_in_pic.i_pts = data.pts;
-	m_in_pic.i_dts = data.dts;
+	in_pic.i_pts = data.pts;
+	in_pic.i_dts = data.dts;
 
 	return ERR_CODE_OK;
 }
 
-
 //------------------------------------------------------------------------------
-// 
+// Downscale from the upper layer, so every layer reads a quarter of the pixels
+// read by the upper one
 //------------------------------------------------------------------------------
-ErrCode VideoEncodeElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
+void VideoEncodeElement::DownscaleInPicture(uint32_t index)
 {
-	LOG_DBG("OnSinkPinData, count:{}, len1:{}, len2:{}, len3:{}", 
-		data.data_count, 
-		data.media_data[0].data_len,
-		data.media_data[1].data_len,
-		data.media_data[2].data_len);
+	const x264_picture_t& src = m_layers[index + 1].in_pic;
+	x264_picture_t& dst = m_layers[index].in_pic;
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	uint32_t width = m_layers[index].width;
+	uint32_t height = m_layers[index].height;
 
-	if (m_ele_state != EleState::RUNNING) {
-		LOG_ERR("Element is not running!");
-		return ERR_CODE_FAILED;
-	}
+	DownscalePlane(src.img.plane[0], src.img.i_stride[0], dst.img.plane[0],
+		dst.img.i_stride[0], width, height, 1);
 
-	if (com::ERR_CODE_OK != FillX264InPicture(data)) {
-		LOG_ERR("FillX264InPicture failed!");
-		return ERR_CODE_FAILED;
+	if (m_sink_pin_cap.format == media::PixelFormat::I420) {
+		for (int i = 1; i < 3; i++) {
+			DownscalePlane(src.img.plane[i], src.img.i_stride[i], dst.img.plane[i],
+				dst.img.i_stride[i], width / 2, height / 2, 1);
+		}
 	}
+	else { // NV12
+		DownscalePlane(src.img.plane[1], src.img.i_stride[1], dst.img.plane[1],
+			dst.img.i_stride[1], width / 2, height / 2, 2);
+	}
+
+	dst.i_pts = src.i_pts;
+	dst.i_dts = src.i_dts;
+}
+
+//------------------------------------------------------------------------------
+// Frames of all layers share one sequence space and are interleaved, frame
+// sequence divided by layer count is the same for the same input frame
+//------------------------------------------------------------------------------
+ErrCode VideoEncodeElement::EncodeLayer(uint32_t index, const PinData& data)
+{
+	SimulcastLayer& layer = m_layers[index];
 
 	x264_nal_t* nal_data = nullptr;
 	int nal_count = 0;
-	int frame_size = x264_encoder_encode(m_x264_encoder, 
+	int frame_size = x264_encoder_encode(layer.encoder, 
 		&nal_data, 
 		&nal_count,
-		&m_in_pic, 
-		&m_out_pic);
+		&layer.in_pic, 
+		&layer.out_pic);
 	if (frame_size < 0) {
-		LOG_ERR("Encode failed, frame_size:{}", frame_size);
+		LOG_ERR("Encode failed, layer:{}, frame_size:{}", index, frame_size);
 		return ERR_CODE_FAILED;
 	}
 	else if (frame_size == 0) {
-		LOG_WRN("No nalu returned!");
+		LOG_WRN("No nalu returned, layer:{}", index);
 		return ERR_CODE_OK;
 	}
+
+	// Input parameters are shared by layers
+	auto para = std::make_shared<media::VideoFramePara>();
+	if (data.media_para) {
+		*para = *SPC<media::VideoFramePara>(data.media_para);
+	}
+	para->codec = m_src_pin_cap.codec;
+	para->key = layer.out_pic.b_keyframe;
+	para->layer = (uint8_t)index;
+
+	// Frame rate of input
+	bool top_layer = (index + 1 == m_layers.size());
 	
 	ErrCode result = ERR_CODE_OK;
 	if (m_send_single_nalu) { // nalu by nalu
@@ -490,20 +629,19 @@ ErrCode VideoEncodeElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
 			PinData encoded_data(media::MediaType::VIDEO, nal->p_payload,
 				nal->i_payload);
 
-			encoded_data.pts = m_out_pic.i_pts;
-			encoded_data.dts = m_out_pic.i_dts;
+			encoded_data.pts = layer.out_pic.i_pts;
+			encoded_data.dts = layer.out_pic.i_dts;
 			encoded_data.drt = data.drt;
 			encoded_data.pos = 0;
 			encoded_data.tbn = 1; // data.tbn;
 			encoded_data.tbd = 50;// data.tbd;
 			encoded_data.data_count = 1;
-
-			encoded_data.media_para = data.media_para;
-			auto para = SPC<media::VideoFramePara>(encoded_data.media_para);
-			para->codec = m_src_pin_cap.codec;
+			encoded_data.media_para = para;
 
 			m_data_stats->OnData(m_br_stats_id, nal->i_payload);
-			m_data_stats->OnData(m_fr_stats_id, 1);
+			if (top_layer) {
+				m_data_stats->OnData(m_fr_stats_id, 1);
+			}
 
 			result = SRC_PIN->OnPinData(encoded_data);
 			if (com::ERR_CODE_OK != result) {
@@ -519,27 +657,28 @@ ErrCode VideoEncodeElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
 		PinData encoded_data(media::MediaType::VIDEO, 
 			nal_data->p_payload, frame_size);
 
-		encoded_data.pts = m_out_pic.i_pts;
-		encoded_data.dts = m_out_pic.i_dts;
+		encoded_data.pts = layer.out_pic.i_pts;
+		encoded_data.dts = layer.out_pic.i_dts;
 		encoded_data.drt = data.drt;
 		encoded_data.pos = 0;
 		encoded_data.tbn = data.tbn;
 		encoded_data.tbd = data.tbd;
 		encoded_data.data_count = 1;
+		encoded_data.media_para = para;
 
-		encoded_data.media_para = data.media_para;
-		auto para = SPC<media::VideoFramePara>(encoded_data.media_para);
-		para->codec = m_src_pin_cap.codec;
-		para->width = media::util::GetWidth(m_src_pin_cap.res);
-		para->height = media::util::GetHeight(m_src_pin_cap.res);
-		para->seq = ++m_frame_seq;
+		para->width = layer.width;
+		para->height = layer.height;
+		para->seq = (m_frame_seq - 1) * (uint32_t)m_layers.size() + index + 1;
 
 		m_data_stats->OnData(m_br_stats_id, frame_size);
-		m_data_stats->OnData(m_fr_stats_id, 1);
+		if (top_layer) {
+			m_data_stats->OnData(m_fr_stats_id, 1);
+		}
 
 		result = SRC_PIN->OnPinData(encoded_data);
 
-		if (m_stream_dumper) {
+		// Only the top layer is dumped as a playable stream
+		if (m_stream_dumper && top_layer) {
 			m_stream_dumper->WriteStreamData(encoded_data);
 		}
 	}
@@ -547,6 +686,52 @@ ErrCode VideoEncodeElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
 	return result;
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ErrCode VideoEncodeElement::OnSinkPinData(ISinkPin* pin, const PinData& data)
+{
+	LOG_DBG("OnSinkPinData, count:{}, len1:{}, len2:{}, len3:{}", 
+		data.data_count, 
+		data.media_data[0].data_len,
+		data.media_data[1].data_len,
+		data.media_data[2].data_len);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_ele_state != EleState::RUNNING) {
+		LOG_ERR("Element is not running!");
+		return ERR_CODE_FAILED;
+	}
+
+	if (m_layers.empty()) {
+		LOG_ERR("Encoder is not created!");
+		return ERR_CODE_FAILED;
+	}
+
+	if (com::ERR_CODE_OK != FillX264InPicture(data)) {
+		LOG_ERR("FillX264InPicture failed!");
+		return ERR_CODE_FAILED;
+	}
+
+	++m_frame_seq;
+
+	// From top to bottom, each layer is downscaled from the upper one
+	for (uint32_t i = (uint32_t)m_layers.size() - 1; i > 0; i--) {
+		DownscaleInPicture(i - 1);
+	}
+
+	ErrCode result = ERR_CODE_OK;
+	for (uint32_t i = 0; i < m_layers.size(); i++) {
+		result = EncodeLayer(i, data);
+		if (ERR_CODE_OK != result) {
+			break;
+		}
+	}
+
+	return result;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "component.h"
 #include "proxy-unknown.h"
 #include "com-obj-tracer.h"
@@ -63,7 +65,12 @@ private:
 	com::ErrCode CreateSrcPin();
 	com::ErrCode CreateSinkPin();
 	com::ErrCode CreateEncoder();
+	com::ErrCode CreateLayerEncoder(uint32_t index, int csp);
+	void DestroyEncoder();
+	void InitLayers();
 	com::ErrCode FillX264InPicture(const PinData& data);
+	void DownscaleInPicture(uint32_t index);
+	com::ErrCode EncodeLayer(uint32_t index, const PinData& data);
 	void UpdatePinCap(const std::string& src_cap, const std::string& sink_cap);
 	void ParseElementConfig();
 	com::ErrCode ParseProperties(com::IProperty* props);
@@ -71,18 +78,32 @@ private:
 	std::optional<uint32_t> TryIncreaseBitrate();
 	std::optional<uint32_t> TryDecreaseBitrate();
 
+private:
+	// Simulcast layer, layer 0 has the lowest resolution
+	struct SimulcastLayer
+	{
+		x264_t* encoder = nullptr;
+		x264_picture_t in_pic;
+		x264_picture_t out_pic;
+		bool pic_alloc = false; // in_pic owns downscaled planes
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t bitrate_kbps = 0;
+	};
+
 private:
 	uint32_t m_src_pin_index = 0;
 	uint32_t m_sink_pin_index = 0;
+
+	// Counts input frames, see EncodeLayer for the frame sequence of layers
 	uint32_t m_frame_seq = 0;
 
 	media::com::VideoCap m_src_pin_cap;
 	media::com::VideoCap m_sink_pin_cap;
 
-	// x264
-	x264_t* m_x264_encoder = nullptr;
-	x264_picture_t m_in_pic;
-	x264_picture_t m_out_pic;
+	// x264, the last layer encodes the input resolution
+	std::vector<SimulcastLayer> m_layers;
+	uint32_t m_simulcast_layers = 1;
 	bool m_send_single_nalu = false;
 
 	util::DataStatsSP m_data_stats;
@@ -103,6 +124,11 @@ private:
 
 	static const uint32_t kIncreaseIntervalMs = 10000;
 	static const uint32_t kDecreaseIntervalMs = 2000;
+
+	// Lowest layer has a quarter of input width at most
+	static const uint32_t kMaxSimulcastLayers = 3;
+	static const uint32_t kMinLayerWidth = 160;
+	static const uint32_t kMinLayerHeight = 90;
 };
 
 }
\ No newline at end of file
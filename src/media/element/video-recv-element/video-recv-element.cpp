@@ -1,6 +1,7 @@
 #include "video-recv-element.h"
 #include "util-streamer.h"
 #include "common/util-common.h"
+#include "common/util-time.h"
 #include "common/util-net.h"
 #include "common/util-pb.h"
 #include "net-message.h"
@@ -27,7 +28,7 @@ VideoRecvElement::VideoRecvElement(base::IComFactory* factory, const char* owner
 	: ProxyUnknown(nullptr)
 	, ComObjTracer(factory, CID_VIDEO_RECV, owner)
 	, ElementBase(factory)
-	, CommonThread("video recv element", false)
+	, StrandThread("video recv element")
 {
 	m_ele_name   = CONSTRUCT_ELEMENT_NAME("v-recv-");
 	m_main_type  = EleMainType::SRC;
@@ -52,7 +53,12 @@ VideoRecvElement::~VideoRecvElement()
 		m_timer_id = INVALID_TIMER_ID;
 	}
 
-	if (m_session_id != INVALID_SESSION_ID) {
+	StopJitterTimer();
+
+	if (m_sess_bundle) {
+		m_sess_bundle->RemoveMember(this);
+	}
+	else if (m_session_id != INVALID_SESSION_ID) {
 		m_sess_mgr->CloseSession(m_session_id);
 	}
 
@@ -140,6 +146,11 @@ ErrCode VideoRecvElement::ParseProperties(com::IProperty* props)
 		return ERR_CODE_FAILED;
 	}
 
+	m_sess_bundle = (util::SessionBundle*)props->GetPtrValue("session-bundle");
+	if (m_sess_bundle) {
+		LOG_INF("Read property session-bundle");
+	}
+
 	const void* stream = props->GetPtrValue("media-stream");
 	if (!stream) {
 		LOG_ERR("Invalid net-stream property!");
@@ -194,12 +205,36 @@ void VideoRecvElement::ParseElementConfig()
 				m_stream_dumper.reset(new media::util::StreamDumper(m_ele_name + ".data"));
 			}
 		}
+
+		if (node["jitter-buffer"]) {
+			m_jitter_enabled = node["jitter-buffer"].as<bool>();
+		}
+
+		if (node["jitter-factor"]) {
+			m_jitter_param.jitter_factor = node["jitter-factor"].as<uint32_t>();
+		}
+
+		if (node["jitter-max-delay"]) {
+			m_jitter_param.max_delay_ms = node["jitter-max-delay"].as<uint32_t>();
+		}
+
+		if (node["jitter-catch-up"]) {
+			m_jitter_param.catch_up_ms = node["jitter-catch-up"].as<uint32_t>();
+		}
 	}
 	catch (const std::exception& e) {
 		LOG_WRN("Error:{}", e.what());
 	}
 }
 
+//------------------------------------------------------------------------------
+// Request sequence must be unique in the bundled session
+//------------------------------------------------------------------------------
+uint32_t VideoRecvElement::AllocSeq()
+{
+	return m_sess_bundle ? m_sess_bundle->AllocSeq(this) : ++m_cur_seq;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -219,6 +254,8 @@ ErrCode VideoRecvElement::DoInit(com::IProperty* props)
 		return ERR_CODE_FAILED;
 	}
 
+	ParseElementConfig();
+
 	m_timer_mgr = QUERY_TIMER_MGR(m_factory);
 	assert(m_timer_mgr);
 
@@ -242,7 +279,25 @@ ErrCode VideoRecvElement::DoInit(com::IProperty* props)
 	StatsParam br_stats("bitrate", StatsType::IAVER, 5000);
 	m_br_stats = m_data_stats->AddStats(br_stats);
 
-	StartThread();
+	if (m_jitter_enabled) {
+		LOG_INF("Enable jitter buffer, factor:{}, max delay:{}, catch up:{}",
+			m_jitter_param.jitter_factor, m_jitter_param.max_delay_ms,
+			m_jitter_param.catch_up_ms);
+
+		m_jitter_buffer.reset(new media::util::JitterBuffer(
+			media::MediaType::VIDEO, m_jitter_param));
+
+		StatsParam jitter_stats("jitter", StatsType::IAVER, 5000);
+		m_jitter_stats = m_data_stats->AddStats(jitter_stats);
+
+		StatsParam jb_delay_stats("jb-delay", StatsType::IAVER, 5000);
+		m_jb_delay_stats = m_data_stats->AddStats(jb_delay_stats);
+
+		StatsParam jb_drop_stats("jb-drop", StatsType::IACCU, 5000);
+		m_jb_drop_stats = m_data_stats->AddStats(jb_drop_stats);
+	}
+
+	StartThread(m_pipeline->GetScheduler());
 
 	m_async_proxy.reset(new util::SessionAsyncProxy(m_factory, m_sess_mgr,
 		this, 10000));
@@ -259,14 +314,22 @@ ErrCode VideoRecvElement::DoStart()
 {
 	LOG_INF("DoStart");
 
-	net::CreateParam param;
-	param.remote_addr  = m_service_addr;
-	param.ka_interval  = 5; // second
-	param.service_type = ServiceType::TRANSPORT;
-	param.session_type = net::SessionType::UNRELIABLE;
-	param.thread       = this;
+	StartJitterTimer();
+
+	if (m_sess_bundle) {
+		m_session_id = m_sess_bundle->AddMember(this);
+	}
+	else {
+		net::CreateParam param;
+		param.remote_addr  = m_service_addr;
+		param.ka_interval  = 5; // second
+		param.service_type = ServiceType::TRANSPORT;
+		param.session_type = net::SessionType::UNRELIABLE;
+		param.thread       = this;
+
+		m_session_id = m_sess_mgr->CreateSession(param);
+	}
 
-	m_session_id = m_sess_mgr->CreateSession(param);
 	if (m_session_id == INVALID_SESSION_ID) {
 		LOG_ERR("Create session failed!");
 		return ERR_CODE_FAILED;
@@ -318,6 +381,9 @@ ErrCode VideoRecvElement::DoStop()
 
 	m_timer_mgr->StopTimer(m_timer_id);
 	m_timer_mgr->FreeTimer(m_timer_id);
+	m_timer_id = INVALID_TIMER_ID;
+
+	StopJitterTimer();
 
 	if (m_recv_chnl_id == 0) {
 		LOG_INF("Not logined recv channel, do nothing");
@@ -334,13 +400,14 @@ ErrCode VideoRecvElement::DoStop()
 
 	com::SigHdrParam hdr_param;
 	hdr_param.app_id  = m_stream_info.src.app_id;
-	hdr_param.user_id = m_stream_info.src.user_id;
-	hdr_param.seq     = ++m_cur_seq;
+	hdr_param.user_id  = m_stream_info.src.user_id;
+	hdr_param.group_id = m_recv_chnl_id; // route on bundled session
+	hdr_param.seq      = AllocSeq();
 
 	// Login send channel
 	Buffer buf = prot::util::BuildLogoutRecvChannelReq(req_param, hdr_param);
 
-	m_async_proxy->SendSessionMsg(m_session_id, buf, m_cur_seq,
+	m_async_proxy->SendSessionMsg(m_session_id, buf, hdr_param.seq,
 		prot::MSG_LOGOUT_RECV_CHANNEL_RSP)
 		.OnResponse([this](net::SessionId sid, const com::Buffer& rsp) {
 			OnLogoutRecvChannelRsp(rsp);
@@ -354,7 +421,7 @@ ErrCode VideoRecvElement::DoStop()
 
 	LOG_INF("Send logout recv channel request, seq:{}, app:{}, user:{}, "
 		"media:{}|{}, stream:{}|{}",
-		m_cur_seq, 
+		hdr_param.seq, 
 		m_stream_info.src.app_id,
 		m_stream_info.src.user_id,
 		m_stream_info.src.src_type,
@@ -545,11 +612,12 @@ void VideoRecvElement::TryNegotiateWithServer()
 	com::SigHdrParam hdr_param;
 	hdr_param.app_id = m_stream_info.src.app_id;
 	hdr_param.user_id = m_stream_info.src.user_id;
-	hdr_param.seq = ++m_cur_seq;
+	hdr_param.group_id = m_recv_chnl_id; // route on bundled session
+	hdr_param.seq = AllocSeq();
 
 	Buffer buf = prot::util::BuildNegotiateReq(req_param, hdr_param);
 
-	m_async_proxy->SendSessionMsg(m_session_id, buf, m_cur_seq,
+	m_async_proxy->SendSessionMsg(m_session_id, buf, hdr_param.seq,
 		prot::MSG_NEGOTIATE_RSP)
 		.OnResponse([this](net::SessionId sid, const com::Buffer& rsp) {
 			OnVideoNegotiateRsp(rsp);
@@ -562,7 +630,7 @@ void VideoRecvElement::TryNegotiateWithServer()
 		});
 
 	LOG_INF("Send negotiate request, seq:{}, app:{}, user:{}, stream:{}|{}",
-		m_cur_seq,
+		hdr_param.seq,
 		m_stream_info.src.app_id,
 		m_stream_info.src.user_id,
 		m_stream_info.stream.stream_type,
@@ -648,12 +716,12 @@ void VideoRecvElement::OnSessionCreateResult(const CommonMsg& msg)
 	com::SigHdrParam hdr_param;
 	hdr_param.app_id = m_stream_info.src.app_id;
 	hdr_param.user_id = m_stream_info.src.user_id;
-	hdr_param.seq = ++m_cur_seq;
+	hdr_param.seq = AllocSeq();
 
 	// Login send channel
 	Buffer buf = prot::util::BuildLoginRecvChannelReq(req_param, hdr_param);
 
-	m_async_proxy->SendSessionMsg(data->lsid, buf, m_cur_seq,
+	m_async_proxy->SendSessionMsg(data->lsid, buf, hdr_param.seq,
 		prot::MSG_LOGIN_RECV_CHANNEL_RSP)
 		.OnResponse([this](net::SessionId sid, const com::Buffer& rsp) {
 			OnLoginRecvChannelRsp(rsp);
@@ -667,7 +735,7 @@ void VideoRecvElement::OnSessionCreateResult(const CommonMsg& msg)
 
 	LOG_INF("Send login recv channel request, seq:{}, app:{}, user:{}, "
 		"media:{}|{}, stream:{}|{}",
-		m_cur_seq, 
+		hdr_param.seq, 
 		m_stream_info.src.app_id,
 		m_stream_info.src.user_id,
 		m_stream_info.src.src_type,
@@ -710,6 +778,25 @@ void VideoRecvElement::OnStreamFrame(uint32_t channel_id, uint32_t user_id,
 
 	m_data_stats->OnData(m_fr_stats, 1);
 
+	if (m_jitter_buffer) {
+		media::util::JitterFrame frame;
+		frame.ts = hdr->ts;
+		frame.key = (hdr->ft == 1);
+		frame.buf = buf;
+		m_jitter_buffer->InputFrame(frame, util::Now() / 1000);
+	}
+	else {
+		DeliverFrame(buf);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void VideoRecvElement::DeliverFrame(const com::Buffer& buf)
+{
+	prot::VideoFrameHdr* hdr = (prot::VideoFrameHdr*)DP(buf);
+
 	PinData pin_data(media::MediaType::VIDEO);
 
 	pin_data.dts = hdr->ts;
@@ -759,6 +846,7 @@ void VideoRecvElement::OnReceiverFeedback(uint32_t channel_id,
 	prot_hdr->len = (uint16_t)(buf.data_len);
 	prot_hdr->mt = prot::MSG_STREAM_FEEDBACK;
 	prot_hdr->seq = ++m_cur_seq;
+	prot_hdr->grp = m_recv_chnl_id; // route on bundled session
 
 	memcpy(DP(sig_buf) + hdr_len, DP(buf), buf.data_len);
 
@@ -813,6 +901,62 @@ ErrCode VideoRecvElement::OnSrcPinNegotiated(ISrcPin* pin, const std::string& ca
 	return ERR_CODE_OK;
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void VideoRecvElement::StartJitterTimer()
+{
+	if (!m_jitter_buffer || m_jitter_timer_id != INVALID_TIMER_ID) {
+		return;
+	}
+
+	com::TimerParam timer_param;
+	timer_param.timeout = 10;
+	timer_param.timer_type = TimerType::TIMER_TYPE_LOOP;
+	timer_param.timer_name = "video jitter buffer timer";
+	timer_param.timer_func = [this](int64_t) {
+		// Jitter buffer is only accessed in element thread
+		Execute([this](util::CallParam) { ReleaseJitterFrames(); }, nullptr);
+	};
+
+	m_jitter_timer_id = m_timer_mgr->AllocTimer(timer_param);
+	m_timer_mgr->StartTimer(m_jitter_timer_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void VideoRecvElement::StopJitterTimer()
+{
+	if (m_jitter_timer_id != INVALID_TIMER_ID) {
+		m_timer_mgr->StopTimer(m_jitter_timer_id);
+		m_timer_mgr->FreeTimer(m_jitter_timer_id);
+		m_jitter_timer_id = INVALID_TIMER_ID;
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void VideoRecvElement::ReleaseJitterFrames()
+{
+	std::vector<media::util::JitterFrame> frames;
+	m_jitter_buffer->PopFrames(util::Now() / 1000, frames);
+
+	for (const auto& frame : frames) {
+		DeliverFrame(frame.buf);
+	}
+
+	if (!frames.empty()) {
+		media::util::JitterStats stats = m_jitter_buffer->Stats();
+		m_data_stats->OnData(m_jitter_stats, stats.jitter_ms);
+		m_data_stats->OnData(m_jb_delay_stats, stats.delay_ms);
+		m_data_stats->OnData(m_jb_drop_stats, 
+			stats.dropped_frames - m_jb_dropped_frames);
+		m_jb_dropped_frames = stats.dropped_frames;
+	}
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
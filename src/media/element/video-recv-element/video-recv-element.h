@@ -9,10 +9,12 @@
 #include "common/util-stats.h"
 #include "util-streamer.h"
 #include "if-session-mgr.h"
-#include "thread/common-thread.h"
+#include "strand-thread.h"
 #include "async/session-async-proxy.h"
+#include "async/session-bundle.h"
 #include "if-stream-receiver.h"
 #include "stream-dumper.h"
+#include "jitter-buffer.h"
 #include "if-timer-mgr.h"
 
 // yaml-cpp warning
@@ -29,7 +31,7 @@ class VideoRecvElement
 	: public media::util::ElementBase
 	, public base::ProxyUnknown
 	, public base::ComObjTracer
-	, public util::CommonThread
+	, public media::util::StrandThread
 	, public txp::IStreamReceiverHandler
 {
 public:
@@ -51,7 +53,7 @@ public:
 	virtual com::ErrCode OnSrcPinNegotiated(ISrcPin* pin,
 		const std::string& cap) override;
 
-	// CommonThread
+	// StrandThread
 	virtual void OnThreadMsg(const com::CommonMsg& msg) override;
 
 	// IReceiverHandler
@@ -66,10 +68,12 @@ public:
 
 	// Timer callback
 	void NotifyStreamStats();
+	void ReleaseJitterFrames();
 
 private:
 	com::ErrCode CreateSrcPin();
 	com::ErrCode ParseProperties(com::IProperty* props);
+	uint32_t AllocSeq();
 	com::ErrCode OnPipelineNegotiateMsg(const com::CommonMsg& msg);
 
 	void OnSessionData(const com::CommonMsg& msg);
@@ -95,6 +99,9 @@ private:
 	void OnVideoNegotiateError(com::ErrCode ec);
 
 	void ParseElementConfig();
+	void StartJitterTimer();
+	void StopJitterTimer();
+	void DeliverFrame(const com::Buffer& buf);
 
 private:
 	uint32_t m_src_pin_index = 0;
@@ -110,9 +117,15 @@ private:
 	util::DataStatsSP m_data_stats;
 	util::StatsId m_fr_stats = INVALID_STATS_ID;
 	util::StatsId m_br_stats = INVALID_STATS_ID;
+	util::StatsId m_jitter_stats = INVALID_STATS_ID;
+	util::StatsId m_jb_delay_stats = INVALID_STATS_ID;
+	util::StatsId m_jb_drop_stats = INVALID_STATS_ID;
 
 	util::SessionAsyncProxySP m_async_proxy;
 
+	// Session shared with other streams to the same service, optional
+	util::SessionBundle* m_sess_bundle = nullptr;
+
 	txp::IStreamReceiver* m_stream_receiver = nullptr;
 
 	uint32_t m_cur_seq = 0;
@@ -131,6 +144,13 @@ private:
 
 	com::ITimerMgr* m_timer_mgr = nullptr;
 	com::TimerId m_timer_id = 0;
+
+	// Frames are released by jitter buffer in element thread, optional
+	bool m_jitter_enabled = false;
+	media::util::JitterParam m_jitter_param;
+	media::util::JitterBufferSP m_jitter_buffer;
+	com::TimerId m_jitter_timer_id = INVALID_TIMER_ID;
+	uint32_t m_jb_dropped_frames = 0;
 };
 
 }
\ No newline at end of file
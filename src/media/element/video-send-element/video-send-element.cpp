@@ -21,7 +21,7 @@ namespace jukey::stmr {
 VideoSendElement::VideoSendElement(base::IComFactory* factory, const char* owner)
 	: base::ProxyUnknown(nullptr)
 	, base::ComObjTracer(factory, CID_VIDEO_SEND, owner)
-	, CommonThread("video send element", false)
+	, StrandThread("video send element")
 	, ElementBase(factory)
 {
 	m_ele_name   = CONSTRUCT_ELEMENT_NAME("v-send-");
@@ -48,7 +48,10 @@ VideoSendElement::~VideoSendElement()
 		m_stream_sender = nullptr;
 	}
 
-	if (m_session_id != INVALID_SESSION_ID) {
+	if (m_sess_bundle) {
+		m_sess_bundle->RemoveMember(this);
+	}
+	else if (m_session_id != INVALID_SESSION_ID) {
 		m_sess_mgr->CloseSession(m_session_id);
 	}
 
@@ -132,6 +135,11 @@ ErrCode VideoSendElement::ParseProperties(com::IProperty* props)
 		return ERR_CODE_FAILED;
 	}
 
+	m_sess_bundle = (util::SessionBundle*)props->GetPtrValue("session-bundle");
+	if (m_sess_bundle) {
+		LOG_INF("Read property session-bundle");
+	}
+
 	const void* vp = props->GetPtrValue("media-stream");
 	if (!vp) {
 		LOG_ERR("Invalid stream-id property!");
@@ -171,6 +179,14 @@ ErrCode VideoSendElement::ParseProperties(com::IProperty* props)
 	return ERR_CODE_OK;
 }
 
+//------------------------------------------------------------------------------
+// Request sequence must be unique in the bundled session
+//------------------------------------------------------------------------------
+uint32_t VideoSendElement::AllocSeq()
+{
+	return m_sess_bundle ? m_sess_bundle->AllocSeq(this) : ++m_cur_seq;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -198,7 +214,7 @@ ErrCode VideoSendElement::DoInit(com::IProperty* props)
 	util::StatsParam br_stats("bitrate", util::StatsType::IAVER, 5000);
 	m_br_stats_id = m_data_stats->AddStats(br_stats);
 
-	StartThread();
+	StartThread(m_pipeline->GetScheduler());
 
 	m_async_proxy = std::make_shared<util::SessionAsyncProxy>(m_factory,
 		m_sess_mgr, this, 10000);
@@ -213,14 +229,20 @@ ErrCode VideoSendElement::DoStart()
 {
 	LOG_INF("DoStart");
 
-	net::CreateParam param;
-	param.remote_addr  = m_service_addr;
-	param.ka_interval  = 5; // second
-	param.service_type = ServiceType::TRANSPORT;
-	param.session_type = net::SessionType::UNRELIABLE;
-	param.thread       = this;
+	if (m_sess_bundle) {
+		m_session_id = m_sess_bundle->AddMember(this);
+	}
+	else {
+		net::CreateParam param;
+		param.remote_addr  = m_service_addr;
+		param.ka_interval  = 5; // second
+		param.service_type = ServiceType::TRANSPORT;
+		param.session_type = net::SessionType::UNRELIABLE;
+		param.thread       = this;
+
+		m_session_id = m_sess_mgr->CreateSession(param);
+	}
 
-	m_session_id = m_sess_mgr->CreateSession(param);
 	if (m_session_id == INVALID_SESSION_ID) {
 		LOG_ERR("Create session failed!");
 		return ERR_CODE_FAILED;
@@ -285,12 +307,13 @@ ErrCode VideoSendElement::DoStop()
 
 	com::SigHdrParam hdr_param;
 	hdr_param.app_id  = m_stream_info.src.app_id;
-	hdr_param.user_id = m_stream_info.src.user_id;
-	hdr_param.seq     = ++m_cur_seq;
+	hdr_param.user_id  = m_stream_info.src.user_id;
+	hdr_param.group_id = m_send_chnl_id; // route on bundled session
+	hdr_param.seq      = AllocSeq();
 
 	Buffer buf = prot::util::BuildLogoutSendChannelReq(req_param, hdr_param);
 
-	m_async_proxy->SendSessionMsg(m_session_id, buf, m_cur_seq,
+	m_async_proxy->SendSessionMsg(m_session_id, buf, hdr_param.seq,
 		prot::MSG_LOGOUT_SEND_CHANNEL_RSP)
 		.OnResponse([this](net::SessionId sid, const com::Buffer& rsp) {
 			OnLogoutSendChannelRsp(rsp);
@@ -304,7 +327,7 @@ ErrCode VideoSendElement::DoStop()
 
 	LOG_INF("Send logout send channel request, seq:{}, app:{}, user:{}, "
 		"media:{}|{}, stream:{}|{}",
-		m_cur_seq, 
+		hdr_param.seq, 
 		m_stream_info.src.app_id,
 		m_stream_info.src.user_id,
 		m_stream_info.src.src_type,
@@ -331,7 +354,7 @@ com::Buffer VideoSendElement::BuildVideoFrameData(media::VideoFrameParaSP para,
 	frame_hdr->ver   = 0;
 	frame_hdr->ext   = 0;
 	frame_hdr->ft    = para->key ? 1 : 0;
-	frame_hdr->sl    = 0;
+	frame_hdr->sl    = para->layer;
 	frame_hdr->tl    = 0;
 	frame_hdr->codec = (uint16_t)para->codec;
 	frame_hdr->w     = para->width / 8;
@@ -359,6 +382,7 @@ com::Buffer VideoSendElement::BuildStreamDataMsg(const com::Buffer& buf)
 	prot_hdr->len = (uint16_t)(buf.data_len);
 	prot_hdr->mt  = prot::MSG_STREAM_DATA;
 	prot_hdr->seq = ++m_cur_seq;
+	prot_hdr->grp = m_send_chnl_id; // route on bundled session
 
 	memcpy(DP(new_buf) + hdr_len, DP(buf), buf.data_len);
 
@@ -380,6 +404,7 @@ com::Buffer VideoSendElement::BuildFeedbackMsg(const com::Buffer& buf)
 	prot_hdr->len = (uint16_t)(buf.data_len);
 	prot_hdr->mt = prot::MSG_STREAM_FEEDBACK;
 	prot_hdr->seq = ++m_cur_seq;
+	prot_hdr->grp = m_send_chnl_id; // route on bundled session
 
 	memcpy(DP(new_buf) + hdr_len, DP(buf), buf.data_len);
 
@@ -469,11 +494,12 @@ void VideoSendElement::TryNegotiateWithServer()
 	com::SigHdrParam hdr_param;
 	hdr_param.app_id = m_stream_info.src.app_id;
 	hdr_param.user_id = m_stream_info.src.user_id;
-	hdr_param.seq = ++m_cur_seq;
+	hdr_param.group_id = m_send_chnl_id; // route on bundled session
+	hdr_param.seq = AllocSeq();
 
 	Buffer buf = prot::util::BuildNegotiateReq(req_param, hdr_param);
 
-	m_async_proxy->SendSessionMsg(m_session_id, buf, m_cur_seq,
+	m_async_proxy->SendSessionMsg(m_session_id, buf, hdr_param.seq,
 		prot::MSG_NEGOTIATE_RSP)
 		.OnResponse([this](net::SessionId sid, const com::Buffer& rsp) {
 			OnVideoNegotiateRsp(rsp);
@@ -487,7 +513,7 @@ void VideoSendElement::TryNegotiateWithServer()
 
 	LOG_INF("Send video negotiate request, seq:{}, app:{}, user:{}, media:{}|{}, "
 		"stream:{}|{}",
-		m_cur_seq, 
+		hdr_param.seq, 
 		m_stream_info.src.app_id,
 		m_stream_info.src.user_id,
 		m_stream_info.src.src_type,
@@ -668,12 +694,12 @@ void VideoSendElement::OnSessionCreateResult(const CommonMsg& msg)
 	com::SigHdrParam hdr_param;
 	hdr_param.app_id = m_stream_info.src.app_id;
 	hdr_param.user_id = m_stream_info.src.user_id;
-	hdr_param.seq = ++m_cur_seq;
+	hdr_param.seq = AllocSeq();
 
 	// Login send channel
 	Buffer buf = prot::util::BuildLoginSendChannelReq(req_param, hdr_param);
 
-	m_async_proxy->SendSessionMsg(data->lsid, buf, m_cur_seq,
+	m_async_proxy->SendSessionMsg(data->lsid, buf, hdr_param.seq,
 		prot::MSG_LOGIN_SEND_CHANNEL_RSP)
 		.OnResponse([this](net::SessionId sid, const com::Buffer& rsp) {
 			OnLoginSendChannelRsp(rsp);
@@ -687,7 +713,7 @@ void VideoSendElement::OnSessionCreateResult(const CommonMsg& msg)
 
 	LOG_INF("Send login send channel request, seq:{}, app:{}, user:{}, "
 		"media:{}|{}, stream:{}|{}",
-		m_cur_seq, 
+		hdr_param.seq, 
 		m_stream_info.src.app_id,
 		m_stream_info.src.user_id,
 		m_stream_info.src.src_type,
@@ -9,8 +9,9 @@
 #include "common/util-stats.h"
 #include "util-streamer.h"
 #include "if-session-mgr.h"
-#include "thread/common-thread.h"
+#include "strand-thread.h"
 #include "async/session-async-proxy.h"
+#include "async/session-bundle.h"
 #include "common-struct.h"
 #include "if-stream-sender.h"
 #include "if-bitrate-allocate-mgr.h"
@@ -30,7 +31,7 @@ class VideoSendElement
 	: public media::util::ElementBase
 	, public base::ProxyUnknown
 	, public base::ComObjTracer
-	, public util::CommonThread
+	, public media::util::StrandThread
 	, public txp::IStreamSenderHandler
 {
 public:
@@ -51,7 +52,7 @@ public:
 	virtual com::ErrCode OnSinkPinNegotiated(ISinkPin* pin,
 		const std::string& cap) override;
 
-	// CommonThread
+	// StrandThread
 	virtual void OnThreadMsg(const com::CommonMsg& msg) override;
 
 	// IStreamSenderHandler
@@ -71,6 +72,7 @@ public:
 private:
 	com::ErrCode CreateSinkPin();
 	com::ErrCode ParseProperties(com::IProperty* props);
+	uint32_t AllocSeq();
 
 	void OnSessionData(const com::CommonMsg& msg);
 	void OnSessionClosed(const com::CommonMsg& msg);
@@ -118,6 +120,9 @@ private:
 
 	util::SessionAsyncProxySP m_async_proxy;
 
+	// Session shared with other streams to the same service, optional
+	util::SessionBundle* m_sess_bundle = nullptr;
+
 	uint32_t m_cur_seq = 0;
 
 	uint32_t m_send_chnl_id = 0;
@@ -0,0 +1,426 @@
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+
+#include "audio-mix-kernel.h"
+#include "common/util-cpu.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MIX_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define MIX_TARGET(t)
+#else
+#define MIX_TARGET(t) __attribute__((target(t)))
+#endif
+#endif
+
+namespace
+{
+
+using namespace jukey::media::util;
+
+typedef void (*AddS16Func)(int16_t* dst, const int16_t* src, int16_t gain,
+	uint32_t count);
+typedef void (*AddF32Func)(float* dst, const int16_t* src, float gain,
+	uint32_t count);
+typedef void (*StoreS16Func)(int16_t* dst, const float* src, uint32_t count);
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+inline int16_t Saturate(int32_t value)
+{
+	return (int16_t)std::min(std::max(value, -32768), 32767);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void AddS16Scalar(int16_t* dst, const int16_t* src, int16_t gain,
+	uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		int16_t value = (gain == kMixGainOne) ? src[i]
+			: Saturate(((int32_t)src[i] * gain) >> 14);
+		dst[i] = Saturate((int32_t)dst[i] + value);
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void AddF32Scalar(float* dst, const int16_t* src, float gain, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		dst[i] += (float)src[i] * gain;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Clamp before converting, as cvtps2dq does not saturate
+//------------------------------------------------------------------------------
+void StoreS16Scalar(int16_t* dst, const float* src, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		float value = std::min(std::max(src[i], -32768.0f), 32767.0f);
+		dst[i] = (int16_t)std::lrintf(value);
+	}
+}
+
+#ifdef MIX_X86
+
+//------------------------------------------------------------------------------
+// 32 bits products are shifted and packed with saturation
+//------------------------------------------------------------------------------
+MIX_TARGET("sse2")
+inline __m128i ScaleSse2(__m128i s, __m128i g)
+{
+	__m128i lo = _mm_mullo_epi16(s, g);
+	__m128i hi = _mm_mulhi_epi16(s, g);
+
+	return _mm_packs_epi32(
+		_mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 14),
+		_mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 14));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+MIX_TARGET("sse2")
+void AddS16Sse2(int16_t* dst, const int16_t* src, int16_t gain,
+	uint32_t count)
+{
+	const __m128i g = _mm_set1_epi16(gain);
+
+	uint32_t pos = 0;
+	for (; pos + 8 <= count; pos += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + pos));
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + pos));
+
+		if (gain != kMixGainOne) {
+			s = ScaleSse2(s, g);
+		}
+
+		_mm_storeu_si128((__m128i*)(dst + pos), _mm_adds_epi16(d, s));
+	}
+
+	AddS16Scalar(dst + pos, src + pos, gain, count - pos);
+}
+
+//------------------------------------------------------------------------------
+// Sign extended by shifting the sample into the high half
+//------------------------------------------------------------------------------
+MIX_TARGET("sse2")
+void AddF32Sse2(float* dst, const int16_t* src, float gain, uint32_t count)
+{
+	const __m128 g = _mm_set1_ps(gain);
+
+	uint32_t pos = 0;
+	for (; pos + 8 <= count; pos += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + pos));
+
+		__m128 f0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		__m128 f1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+
+		_mm_storeu_ps(dst + pos, _mm_add_ps(_mm_loadu_ps(dst + pos),
+			_mm_mul_ps(f0, g)));
+		_mm_storeu_ps(dst + pos + 4, _mm_add_ps(_mm_loadu_ps(dst + pos + 4),
+			_mm_mul_ps(f1, g)));
+	}
+
+	AddF32Scalar(dst + pos, src + pos, gain, count - pos);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+MIX_TARGET("sse2")
+void StoreS16Sse2(int16_t* dst, const float* src, uint32_t count)
+{
+	const __m128 min = _mm_set1_ps(-32768.0f);
+	const __m128 max = _mm_set1_ps(32767.0f);
+
+	uint32_t pos = 0;
+	for (; pos + 8 <= count; pos += 8) {
+		__m128 f0 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + pos), min), max);
+		__m128 f1 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + pos + 4), min), max);
+
+		_mm_storeu_si128((__m128i*)(dst + pos),
+			_mm_packs_epi32(_mm_cvtps_epi32(f0), _mm_cvtps_epi32(f1)));
+	}
+
+	StoreS16Scalar(dst + pos, src + pos, count - pos);
+}
+
+//------------------------------------------------------------------------------
+// Unpack and pack work in 128 bits lanes, so the sample order is kept
+//------------------------------------------------------------------------------
+MIX_TARGET("avx2")
+void AddS16Avx2(int16_t* dst, const int16_t* src, int16_t gain,
+	uint32_t count)
+{
+	const __m256i g = _mm256_set1_epi16(gain);
+
+	uint32_t pos = 0;
+	for (; pos + 16 <= count; pos += 16) {
+		__m256i s = _mm256_loadu_si256((const __m256i*)(src + pos));
+		__m256i d = _mm256_loadu_si256((const __m256i*)(dst + pos));
+
+		if (gain != kMixGainOne) {
+			__m256i lo = _mm256_mullo_epi16(s, g);
+			__m256i hi = _mm256_mulhi_epi16(s, g);
+			s = _mm256_packs_epi32(
+				_mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 14),
+				_mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 14));
+		}
+
+		_mm256_storeu_si256((__m256i*)(dst + pos), _mm256_adds_epi16(d, s));
+	}
+
+	_mm256_zeroupper();
+
+	AddS16Sse2(dst + pos, src + pos, gain, count - pos);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+MIX_TARGET("avx2")
+void AddF32Avx2(float* dst, const int16_t* src, float gain, uint32_t count)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+
+	uint32_t pos = 0;
+	for (; pos + 16 <= count; pos += 16) {
+		__m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+			_mm_loadu_si128((const __m128i*)(src + pos))));
+		__m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+			_mm_loadu_si128((const __m128i*)(src + pos + 8))));
+
+		_mm256_storeu_ps(dst + pos, _mm256_add_ps(_mm256_loadu_ps(dst + pos),
+			_mm256_mul_ps(f0, g)));
+		_mm256_storeu_ps(dst + pos + 8, _mm256_add_ps(
+			_mm256_loadu_ps(dst + pos + 8), _mm256_mul_ps(f1, g)));
+	}
+
+	_mm256_zeroupper();
+
+	AddF32Sse2(dst + pos, src + pos, gain, count - pos);
+}
+
+//------------------------------------------------------------------------------
+// Lanes are interleaved by pack, restored by permuting 64 bits blocks
+//------------------------------------------------------------------------------
+MIX_TARGET("avx2")
+void StoreS16Avx2(int16_t* dst, const float* src, uint32_t count)
+{
+	const __m256 min = _mm256_set1_ps(-32768.0f);
+	const __m256 max = _mm256_set1_ps(32767.0f);
+
+	uint32_t pos = 0;
+	for (; pos + 16 <= count; pos += 16) {
+		__m256 f0 = _mm256_min_ps(_mm256_max_ps(
+			_mm256_loadu_ps(src + pos), min), max);
+		__m256 f1 = _mm256_min_ps(_mm256_max_ps(
+			_mm256_loadu_ps(src + pos + 8), min), max);
+
+		__m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(f0),
+			_mm256_cvtps_epi32(f1));
+
+		_mm256_storeu_si256((__m256i*)(dst + pos),
+			_mm256_permute4x64_epi64(packed, 0xd8));
+	}
+
+	_mm256_zeroupper();
+
+	StoreS16Sse2(dst + pos, src + pos, count - pos);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool CpuSupports(MixKernel kernel)
+{
+	const jukey::util::CpuFeatures& cpu = jukey::util::GetCpuFeatures();
+
+	switch (kernel) {
+	case MixKernel::MIX_KERNEL_SCALAR:
+		return true;
+	case MixKernel::MIX_KERNEL_SSE2:
+		return cpu.sse2;
+	case MixKernel::MIX_KERNEL_AVX2:
+		return cpu.sse2 && cpu.avx2;
+	default:
+		return false;
+	}
+}
+
+#else
+
+bool CpuSupports(MixKernel kernel)
+{
+	return kernel == MixKernel::MIX_KERNEL_SCALAR;
+}
+
+#endif
+
+//==============================================================================
+//
+//==============================================================================
+struct MixFuncs
+{
+	AddS16Func add_s16 = AddS16Scalar;
+	AddF32Func add_f32 = AddF32Scalar;
+	StoreS16Func store_s16 = StoreS16Scalar;
+};
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+MixFuncs KernelFuncs(MixKernel kernel)
+{
+	MixFuncs funcs;
+
+	switch (kernel) {
+#ifdef MIX_X86
+	case MixKernel::MIX_KERNEL_SSE2:
+		funcs.add_s16 = AddS16Sse2;
+		funcs.add_f32 = AddF32Sse2;
+		funcs.store_s16 = StoreS16Sse2;
+		break;
+	case MixKernel::MIX_KERNEL_AVX2:
+		funcs.add_s16 = AddS16Avx2;
+		funcs.add_f32 = AddF32Avx2;
+		funcs.store_s16 = StoreS16Avx2;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	return funcs;
+}
+
+//==============================================================================
+// Kernel selected at runtime
+//==============================================================================
+struct MixDispatcher
+{
+	MixDispatcher()
+	{
+		if (CpuSupports(MixKernel::MIX_KERNEL_AVX2)) {
+			best = MixKernel::MIX_KERNEL_AVX2;
+		}
+		else if (CpuSupports(MixKernel::MIX_KERNEL_SSE2)) {
+			best = MixKernel::MIX_KERNEL_SSE2;
+		}
+		else {
+			best = MixKernel::MIX_KERNEL_SCALAR;
+		}
+
+		Set(best);
+	}
+
+	void Set(MixKernel k)
+	{
+		MixFuncs funcs = KernelFuncs(k);
+		add_s16 = funcs.add_s16;
+		add_f32 = funcs.add_f32;
+		store_s16 = funcs.store_s16;
+		kernel = k;
+	}
+
+	MixKernel best = MixKernel::MIX_KERNEL_SCALAR;
+	std::atomic<MixKernel> kernel;
+	std::atomic<AddS16Func> add_s16;
+	std::atomic<AddF32Func> add_f32;
+	std::atomic<StoreS16Func> store_s16;
+};
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+MixDispatcher& Dispatcher()
+{
+	static MixDispatcher dispatcher;
+	return dispatcher;
+}
+
+}
+
+namespace jukey::media::util
+{
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void MixAddS16(int16_t* dst, const int16_t* src, int16_t gain, uint32_t count)
+{
+	Dispatcher().add_s16.load(std::memory_order_relaxed)(dst, src, gain, count);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void MixAddF32(float* dst, const int16_t* src, float gain, uint32_t count)
+{
+	Dispatcher().add_f32.load(std::memory_order_relaxed)(dst, src, gain, count);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void MixStoreS16(int16_t* dst, const float* src, uint32_t count)
+{
+	Dispatcher().store_s16.load(std::memory_order_relaxed)(dst, src, count);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+MixKernel MixBestKernel()
+{
+	return Dispatcher().best;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+MixKernel MixCurrentKernel()
+{
+	return Dispatcher().kernel.load();
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool MixSetKernel(MixKernel kernel)
+{
+	if (!CpuSupports(kernel)) {
+		return false;
+	}
+
+	Dispatcher().Set(kernel);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+const char* MixKernelName(MixKernel kernel)
+{
+	switch (kernel) {
+	case MixKernel::MIX_KERNEL_SCALAR:
+		return "scalar";
+	case MixKernel::MIX_KERNEL_SSE2:
+		return "sse2";
+	case MixKernel::MIX_KERNEL_AVX2:
+		return "avx2";
+	default:
+		return "unknown";
+	}
+}
+
+}
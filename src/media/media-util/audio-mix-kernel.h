@@ -0,0 +1,54 @@
+#pragma once
+
+#include <inttypes.h>
+
+namespace jukey::media::util
+{
+
+//==============================================================================
+// Sample kernels of audio mixer, selected by CPU at startup
+//==============================================================================
+enum class MixKernel
+{
+	MIX_KERNEL_SCALAR = 0,
+	MIX_KERNEL_SSE2   = 1,
+	MIX_KERNEL_AVX2   = 2,
+};
+
+// Gain in Q14, maximum is about 2.0
+const int16_t kMixGainOne = 16384;
+
+//
+// @brief dst = sat16(dst + sat16(src * gain >> 14))
+//
+void MixAddS16(int16_t* dst, const int16_t* src, int16_t gain, uint32_t count);
+
+//
+// @brief dst = dst + src * gain
+//
+void MixAddF32(float* dst, const int16_t* src, float gain, uint32_t count);
+
+//
+// @brief dst = sat16(round(src)), rounded to nearest even
+//
+void MixStoreS16(int16_t* dst, const float* src, uint32_t count);
+
+//
+// @brief Best kernel supported by current CPU, selected at startup
+//
+MixKernel MixBestKernel();
+
+//
+// @brief Kernel in use
+//
+MixKernel MixCurrentKernel();
+
+//
+// @brief Force a kernel, for test only
+// @return false if the kernel is not supported by current CPU
+//
+bool MixSetKernel(MixKernel kernel);
+
+const char* MixKernelName(MixKernel kernel);
+
+}
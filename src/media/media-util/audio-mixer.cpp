@@ -0,0 +1,238 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "audio-mixer.h"
+
+namespace jukey::media::util
+{
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+AudioMixer::AudioMixer(const AudioMixParam& param) : m_param(param)
+{
+	m_frame_samples = param.srate * param.frame_ms / 1000 * param.chnls;
+
+	m_ring_samples = std::max(param.srate * param.max_delay_ms / 1000
+		* param.chnls, m_frame_samples * 2);
+
+	m_acc.resize(m_frame_samples);
+	m_wrap_frame.resize(m_frame_samples);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+AudioMixer::MixInput* AudioMixer::FindInput(uint32_t id)
+{
+	for (auto& input : m_inputs) {
+		if (input.id == id) {
+			return &input;
+		}
+	}
+	return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Ring of the input is allocated here, not on mixing
+//------------------------------------------------------------------------------
+bool AudioMixer::AddInput(uint32_t id)
+{
+	if (FindInput(id)) {
+		return false;
+	}
+
+	MixInput input;
+	input.id = id;
+	input.ring.assign(m_ring_samples, 0);
+	m_inputs.push_back(std::move(input));
+
+	m_ready.reserve(m_inputs.size());
+	m_active.reserve(m_inputs.size());
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void AudioMixer::RemoveInput(uint32_t id)
+{
+	m_inputs.erase(std::remove_if(m_inputs.begin(), m_inputs.end(),
+		[id](const MixInput& input) { return input.id == id; }), m_inputs.end());
+
+	m_active.erase(std::remove(m_active.begin(), m_active.end(), id),
+		m_active.end());
+}
+
+//------------------------------------------------------------------------------
+// Both paths use the same quantized gain
+//------------------------------------------------------------------------------
+bool AudioMixer::SetGain(uint32_t id, float gain)
+{
+	MixInput* input = FindInput(id);
+	if (!input) {
+		return false;
+	}
+
+	float q14 = std::min(std::max(gain, 0.0f) * kMixGainOne, 32767.0f);
+
+	input->gain = (int16_t)std::lrintf(q14);
+	input->gain_f = (float)input->gain / kMixGainOne;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Oldest samples are overwritten if the input is ahead of mixing
+//------------------------------------------------------------------------------
+bool AudioMixer::InputData(uint32_t id, const int16_t* data, uint32_t samples)
+{
+	MixInput* input = FindInput(id);
+	if (!input) {
+		return false;
+	}
+
+	if (samples > m_ring_samples) {
+		m_stats.dropped_samples += samples - m_ring_samples;
+		data += samples - m_ring_samples;
+		samples = m_ring_samples;
+	}
+
+	if (input->size + samples > m_ring_samples) {
+		uint32_t drop = input->size + samples - m_ring_samples;
+		input->read_pos = (input->read_pos + drop) % m_ring_samples;
+		input->size -= drop;
+		m_stats.dropped_samples += drop;
+	}
+
+	uint32_t write_pos = (input->read_pos + input->size) % m_ring_samples;
+	uint32_t first = std::min(samples, m_ring_samples - write_pos);
+
+	memcpy(&input->ring[write_pos], data, first * sizeof(int16_t));
+	if (first < samples) {
+		memcpy(&input->ring[0], data + first, (samples - first) * sizeof(int16_t));
+	}
+
+	input->size += samples;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Frame crossing the end of ring is copied to be contiguous
+//------------------------------------------------------------------------------
+const int16_t* AudioMixer::PeekFrame(MixInput& input)
+{
+	if (input.read_pos + m_frame_samples <= m_ring_samples) {
+		return &input.ring[input.read_pos];
+	}
+
+	uint32_t first = m_ring_samples - input.read_pos;
+	memcpy(&m_wrap_frame[0], &input.ring[input.read_pos],
+		first * sizeof(int16_t));
+	memcpy(&m_wrap_frame[first], &input.ring[0],
+		(m_frame_samples - first) * sizeof(int16_t));
+
+	return &m_wrap_frame[0];
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void AudioMixer::ConsumeFrame(MixInput& input)
+{
+	input.read_pos = (input.read_pos + m_frame_samples) % m_ring_samples;
+	input.size -= m_frame_samples;
+}
+
+//------------------------------------------------------------------------------
+// Top N inputs by smoothed level
+//------------------------------------------------------------------------------
+void AudioMixer::SelectSpeakers()
+{
+	size_t count = m_ready.size();
+	if (m_param.max_speakers != 0 && m_param.max_speakers < count) {
+		count = m_param.max_speakers;
+		std::partial_sort(m_ready.begin(), m_ready.begin() + count, m_ready.end(),
+			[](const MixInput* a, const MixInput* b) { return a->level > b->level; });
+	}
+
+	m_active.clear();
+	for (size_t i = 0; i < count; i++) {
+		m_active.push_back(m_ready[i]->id);
+	}
+	m_ready.resize(count);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool AudioMixer::MixFrame(int16_t* out)
+{
+	m_ready.clear();
+
+	for (auto& input : m_inputs) {
+		input.ready = input.size >= m_frame_samples;
+		if (!input.ready) {
+			input.level = input.level * 3 / 4;
+			m_stats.underruns++;
+			continue;
+		}
+
+		const int16_t* frame = PeekFrame(input);
+
+		uint64_t sum = 0;
+		for (uint32_t i = 0; i < m_frame_samples; i++) {
+			sum += (int32_t)frame[i] * frame[i];
+		}
+		input.level = (input.level * 3 + sum / m_frame_samples) / 4;
+
+		m_ready.push_back(&input);
+	}
+
+	if (m_ready.empty()) {
+		m_active.clear();
+		return false;
+	}
+
+	SelectSpeakers();
+
+	if (m_param.float_mix) {
+		std::fill(m_acc.begin(), m_acc.end(), 0.0f);
+		for (MixInput* input : m_ready) {
+			MixAddF32(&m_acc[0], PeekFrame(*input), input->gain_f, m_frame_samples);
+		}
+		MixStoreS16(out, &m_acc[0], m_frame_samples);
+	}
+	else {
+		memset(out, 0, m_frame_samples * sizeof(int16_t));
+		for (MixInput* input : m_ready) {
+			MixAddS16(out, PeekFrame(*input), input->gain, m_frame_samples);
+		}
+	}
+
+	// Inputs not selected are consumed too, to stay aligned
+	for (auto& input : m_inputs) {
+		if (input.ready) {
+			ConsumeFrame(input);
+		}
+	}
+
+	m_stats.mixed_frames++;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+AudioMixStats AudioMixer::Stats() const
+{
+	AudioMixStats stats = m_stats;
+	stats.inputs = (uint32_t)m_inputs.size();
+	return stats;
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "audio-mix-kernel.h"
+
+namespace jukey::media::util
+{
+
+//==============================================================================
+//
+//==============================================================================
+struct AudioMixParam
+{
+	uint32_t srate = 48000;
+	uint32_t chnls = 1;
+
+	// Inputs are mixed frame by frame, 10ms or 20ms
+	uint32_t frame_ms = 10;
+
+	// Only the loudest inputs are mixed, 0 means all
+	uint32_t max_speakers = 3;
+
+	// Older samples of an input are dropped
+	uint32_t max_delay_ms = 200;
+
+	// Sum in float and saturate once, or sum in int16 with saturation
+	bool float_mix = true;
+};
+
+//==============================================================================
+//
+//==============================================================================
+struct AudioMixStats
+{
+	uint32_t inputs = 0;
+	uint32_t mixed_frames = 0;
+	uint32_t underruns = 0; // input without a full frame on mixing
+	uint32_t dropped_samples = 0;
+};
+
+//==============================================================================
+// Mixes interleaved S16 inputs on a fixed frame timebase. Every input buffers
+// samples in a ring allocated when it is added, so mixing does not allocate.
+// Inputs are aligned by consuming one frame from each of them per mix, an input
+// without a full frame is skipped until it has. Not thread safe.
+//==============================================================================
+class AudioMixer
+{
+public:
+	AudioMixer(const AudioMixParam& param);
+
+	bool AddInput(uint32_t id);
+	void RemoveInput(uint32_t id);
+
+	// 1.0 keeps the level, limited to [0, 2.0)
+	bool SetGain(uint32_t id, float gain);
+
+	bool InputData(uint32_t id, const int16_t* data, uint32_t samples);
+
+	// @param out: FrameSamples() interleaved samples
+	// @return false if no input has a full frame
+	bool MixFrame(int16_t* out);
+
+	uint32_t FrameSamples() const { return m_frame_samples; }
+
+	// Inputs mixed into the last frame
+	const std::vector<uint32_t>& ActiveInputs() const { return m_active; }
+
+	AudioMixStats Stats() const;
+
+private:
+	struct MixInput
+	{
+		uint32_t id = 0;
+		std::vector<int16_t> ring;
+		uint32_t read_pos = 0;
+		uint32_t size = 0;
+		int16_t gain = kMixGainOne;
+		float gain_f = 1.0f;
+		uint64_t level = 0; // smoothed mean square
+		bool ready = false; // has a full frame
+	};
+
+	MixInput* FindInput(uint32_t id);
+	const int16_t* PeekFrame(MixInput& input);
+	void ConsumeFrame(MixInput& input);
+	void SelectSpeakers();
+
+private:
+	AudioMixParam m_param;
+	uint32_t m_frame_samples = 0;
+	uint32_t m_ring_samples = 0;
+
+	std::vector<MixInput> m_inputs;
+
+	// Preallocated for mixing
+	std::vector<float> m_acc;
+	std::vector<int16_t> m_wrap_frame;
+	std::vector<MixInput*> m_ready;
+	std::vector<uint32_t> m_active;
+
+	AudioMixStats m_stats;
+};
+typedef std::shared_ptr<AudioMixer> AudioMixerSP;
+
+}
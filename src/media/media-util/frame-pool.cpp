@@ -0,0 +1,69 @@
+#include "frame-pool.h"
+#include "log.h"
+
+namespace jukey::media::util
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+FramePool::FramePool(uint32_t frame_count) : m_frame_count(frame_count)
+{
+}
+
+//------------------------------------------------------------------------------
+// Planes hold aliases of the pooled buffer, so the buffer is in use until the
+// last plane is released
+//------------------------------------------------------------------------------
+bool FramePool::AllocFrame(stmr::PinData& data, const uint32_t* plane_lens,
+	uint32_t plane_count)
+{
+	if (plane_count == 0 || plane_count > 8) {
+		LOG_ERR("Invalid plane count:{}", plane_count);
+		return false;
+	}
+
+	uint32_t offsets[8] = { 0 };
+	uint32_t frame_len = 0;
+	for (uint32_t i = 0; i < plane_count; i++) {
+		offsets[i] = frame_len;
+		frame_len += (plane_lens[i] + kPlaneAlign - 1) / kPlaneAlign * kPlaneAlign;
+	}
+
+	if (!m_pool || m_pool->BufLen() != frame_len) {
+		if (m_pool) {
+			m_miss_base += m_pool->MissCount();
+			++m_stats.resize_count;
+		}
+		m_pool.reset(new jukey::util::BufferPool(frame_len, m_frame_count));
+		LOG_INF("Create frame pool, frame len:{}, frame count:{}", frame_len,
+			m_frame_count);
+	}
+
+	com::Buffer buf = m_pool->Alloc();
+
+	for (uint32_t i = 0; i < plane_count; i++) {
+		com::Buffer& plane = data.media_data[i];
+		plane.data = std::shared_ptr<uint8_t>(buf.data, buf.data.get() + offsets[i]);
+		plane.total_len = plane_lens[i];
+		plane.data_len = plane_lens[i];
+		plane.start_pos = 0;
+	}
+	data.data_count = plane_count;
+
+	++m_stats.alloc_count;
+	m_stats.alloc_bytes += frame_len;
+	m_stats.miss_count = m_miss_base + m_pool->MissCount();
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+const FramePoolStats& FramePool::Stats() const
+{
+	return m_stats;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+
+#include "common/buffer-pool.h"
+#include "if-pin.h"
+
+namespace jukey::media::util
+{
+
+//==============================================================================
+// 
+//==============================================================================
+struct FramePoolStats
+{
+	uint64_t alloc_count = 0;  // frames handed out
+	uint64_t alloc_bytes = 0;  // bytes of frames handed out
+	uint64_t miss_count = 0;   // frames allocated from heap, pool exhausted
+	uint64_t resize_count = 0; // pool recreated for new frame size
+};
+
+//==============================================================================
+// Frame buffer pool of a producer element. All planes of a frame are carved
+// from one pooled buffer and share its reference count, so the frame can be
+// passed to any number of sink pins and queued by them without copying. The
+// buffer goes back to the pool after the last plane is released. A sent frame
+// must not be modified any more, an element that modifies a received frame
+// writes the result to a frame of its own. Not thread-safe, frames should be
+// allocated from one thread.
+//==============================================================================
+class FramePool
+{
+public:
+	FramePool(uint32_t frame_count);
+
+	//
+	// @brief Set the planes of data to a pooled buffer, data_len of each plane
+	//        is set to its length, data content is not cleared
+	// @param plane_lens: length of each plane, at most 8 planes
+	//
+	bool AllocFrame(stmr::PinData& data, const uint32_t* plane_lens, 
+		uint32_t plane_count);
+
+	const FramePoolStats& Stats() const;
+
+private:
+	std::unique_ptr<jukey::util::BufferPool> m_pool;
+	uint32_t m_frame_count = 0;
+	uint64_t m_miss_base = 0;
+	FramePoolStats m_stats;
+
+	// Plane start is aligned for SIMD
+	static const uint32_t kPlaneAlign = 64;
+};
+typedef std::shared_ptr<FramePool> FramePoolSP;
+
+}
@@ -0,0 +1,228 @@
+#include "jitter-buffer.h"
+#include "log.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+namespace jukey::media::util
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+JitterBuffer::JitterBuffer(media::MediaType media_type, 
+	const JitterParam& param)
+	: m_media_type(media_type)
+	, m_param(param)
+{
+	m_target_delay = m_param.min_delay_ms;
+	m_delay = m_target_delay;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int64_t JitterBuffer::ExtendTimestamp(uint32_t ts)
+{
+	if (m_first_frame) {
+		m_ext_ts = ts;
+	}
+	else {
+		m_ext_ts += (int32_t)(ts - m_last_ts);
+	}
+	m_last_ts = ts;
+
+	return m_ext_ts;
+}
+
+//------------------------------------------------------------------------------
+// Minimum of two windows, so that clock drift is followed in one window
+//------------------------------------------------------------------------------
+void JitterBuffer::UpdateBaseDelay(int64_t transfer_delay, uint64_t now_ms)
+{
+	if (m_first_frame) {
+		m_prev_min_delay = transfer_delay;
+		m_cur_min_delay = transfer_delay;
+		m_window_start_ms = now_ms;
+	}
+	else if (now_ms >= m_window_start_ms + kBaseDelayWindowMs) {
+		m_prev_min_delay = m_cur_min_delay;
+		m_cur_min_delay = transfer_delay;
+		m_window_start_ms = now_ms;
+	}
+	else {
+		m_cur_min_delay = std::min(m_cur_min_delay, transfer_delay);
+	}
+
+	m_base_delay = std::min(m_prev_min_delay, m_cur_min_delay);
+}
+
+//------------------------------------------------------------------------------
+// J = J + (|D| - J) / 16
+//------------------------------------------------------------------------------
+void JitterBuffer::UpdateJitter(int64_t ext_ts, uint64_t now_ms)
+{
+	// Frames of the same timestamp are not counted
+	if (!m_first_frame && ext_ts > m_last_jitter_ts) {
+		int64_t d = (int64_t)(now_ms - m_last_arrival_ms) 
+			- (ext_ts - m_last_jitter_ts);
+		m_jitter += (std::abs((double)d) - m_jitter) / 16;
+	}
+
+	if (m_first_frame || ext_ts > m_last_jitter_ts) {
+		m_last_jitter_ts = ext_ts;
+		m_last_arrival_ms = now_ms;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Raise quickly to avoid underrun, lower slowly to avoid bursts
+//------------------------------------------------------------------------------
+void JitterBuffer::UpdatePlayoutDelay()
+{
+	m_target_delay = m_param.min_delay_ms + m_param.jitter_factor * m_jitter;
+	m_target_delay = std::min(m_target_delay, (double)m_param.max_delay_ms);
+
+	if (m_target_delay > m_delay) {
+		m_delay += (m_target_delay - m_delay) / 2;
+	}
+	else {
+		m_delay -= (m_delay - m_target_delay) / 32;
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint64_t JitterBuffer::PlayTime(int64_t ext_ts) const
+{
+	return (uint64_t)(ext_ts + m_base_delay + (int64_t)m_delay);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void JitterBuffer::InputFrame(const JitterFrame& frame, uint64_t now_ms)
+{
+	int64_t ext_ts = ExtendTimestamp(frame.ts);
+
+	UpdateBaseDelay((int64_t)now_ms - ext_ts, now_ms);
+	UpdateJitter(ext_ts, now_ms);
+	UpdatePlayoutDelay();
+
+	m_first_frame = false;
+
+	// Frames after it have been released, it cannot be played in order
+	if (m_released && ext_ts < m_last_release_ts) {
+		LOG_DBG("Drop out of order frame, ts:{}", frame.ts);
+		m_stats.late_frames++;
+		m_stats.dropped_frames++;
+		return;
+	}
+
+	if (now_ms > PlayTime(ext_ts)) {
+		m_stats.late_frames++;
+	}
+
+	JitterFrame jf = frame;
+	jf.ext_ts = ext_ts;
+	jf.arrival_ms = now_ms;
+
+	auto iter = m_frames.end();
+	while (iter != m_frames.begin() && (iter - 1)->ext_ts > ext_ts) {
+		--iter;
+	}
+	m_frames.insert(iter, jf);
+}
+
+//------------------------------------------------------------------------------
+// Decoding can only restart from key frame, so frames before the latest due key
+// frame are dropped and playout delay jumps to the target
+//------------------------------------------------------------------------------
+void JitterBuffer::CatchUp(uint64_t now_ms)
+{
+	if (m_delay < m_target_delay + m_param.catch_up_ms) {
+		return;
+	}
+
+	int64_t target_play = m_base_delay + (int64_t)m_target_delay;
+
+	auto key_iter = m_frames.end();
+	for (auto iter = m_frames.begin() + 1; iter < m_frames.end(); ++iter) {
+		if (iter->key && (uint64_t)(iter->ext_ts + target_play) <= now_ms) {
+			key_iter = iter;
+		}
+	}
+
+	if (key_iter == m_frames.end()) {
+		return;
+	}
+
+	uint32_t count = (uint32_t)(key_iter - m_frames.begin());
+
+	LOG_INF("Catch up, drop frames:{}, delay:{}, target:{}", count, 
+		(uint32_t)m_delay, (uint32_t)m_target_delay);
+
+	m_frames.erase(m_frames.begin(), key_iter);
+	m_stats.dropped_frames += count;
+	m_delay = m_target_delay;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void JitterBuffer::PopFrames(uint64_t now_ms, std::vector<JitterFrame>& frames)
+{
+	if (m_media_type == media::MediaType::VIDEO && m_frames.size() > 1) {
+		CatchUp(now_ms);
+	}
+
+	while (!m_frames.empty()) {
+		uint64_t play_ms = PlayTime(m_frames.front().ext_ts);
+		if (play_ms > now_ms) {
+			break;
+		}
+
+		JitterFrame& frame = m_frames.front();
+		frame.play_ms = std::max(play_ms, frame.arrival_ms);
+
+		m_released = true;
+		m_last_release_ts = frame.ext_ts;
+		m_stats.released_frames++;
+
+		frames.push_back(std::move(frame));
+		m_frames.pop_front();
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+JitterStats JitterBuffer::Stats() const
+{
+	JitterStats stats = m_stats;
+
+	stats.jitter_ms = (uint32_t)m_jitter;
+	stats.target_delay_ms = (uint32_t)m_target_delay;
+	stats.delay_ms = (uint32_t)m_delay;
+	stats.buffered_frames = (uint32_t)m_frames.size();
+
+	if (!m_frames.empty()) {
+		stats.buffered_ms = (uint32_t)(m_frames.back().ext_ts 
+			- m_frames.front().ext_ts);
+	}
+
+	// Audio delay is lowered slowly, player could shorten the frames instead
+	if (m_media_type == media::MediaType::AUDIO) {
+		int32_t diff = (int32_t)(m_delay - m_target_delay);
+		if (std::abs(diff) > (int32_t)kStretchThresholdMs) {
+			stats.stretch_permille = std::clamp(diff, -kMaxStretchPermille, 
+				kMaxStretchPermille);
+		}
+	}
+
+	return stats;
+}
+
+}
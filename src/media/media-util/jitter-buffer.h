@@ -0,0 +1,121 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <memory>
+
+#include "common-struct.h"
+#include "public/media-enum.h"
+
+namespace jukey::media::util
+{
+
+//==============================================================================
+// 
+//==============================================================================
+struct JitterParam
+{
+	// Target delay = min_delay_ms + jitter_factor * jitter
+	uint32_t min_delay_ms = 0;
+	uint32_t max_delay_ms = 1000;
+	uint32_t jitter_factor = 4;
+
+	// Video only, skip to key frame when playout delay is higher than target 
+	// delay by this
+	uint32_t catch_up_ms = 300;
+};
+
+//==============================================================================
+// 
+//==============================================================================
+struct JitterFrame
+{
+	uint32_t ts = 0; // media timestamp(ms)
+	bool key = false; // video key frame
+	jukey::com::Buffer buf;
+
+	// Set by jitter buffer
+	int64_t ext_ts = 0; // unwrapped timestamp
+	uint64_t arrival_ms = 0;
+	uint64_t play_ms = 0;
+};
+
+//==============================================================================
+// 
+//==============================================================================
+struct JitterStats
+{
+	uint32_t jitter_ms = 0;
+	uint32_t target_delay_ms = 0;
+	uint32_t delay_ms = 0; // current playout delay
+	uint32_t buffered_frames = 0;
+	uint32_t buffered_ms = 0;
+	uint32_t released_frames = 0;
+	uint32_t late_frames = 0; // arrived after playout time, as underrun
+	uint32_t dropped_frames = 0;
+
+	// Audio time-stretch hint, >0 play faster, <0 play slower(permille)
+	int32_t stretch_permille = 0;
+};
+
+//==============================================================================
+// Estimates inter-arrival jitter(RFC3550) and releases frames on a playout 
+// clock: timestamp + base delay + playout delay. Base delay is the minimum 
+// transfer delay seen recently, playout delay follows the target computed from
+// jitter, up quickly and down slowly. Not thread safe.
+//==============================================================================
+class JitterBuffer
+{
+public:
+	JitterBuffer(media::MediaType media_type, const JitterParam& param);
+
+	void InputFrame(const JitterFrame& frame, uint64_t now_ms);
+
+	void PopFrames(uint64_t now_ms, std::vector<JitterFrame>& frames);
+
+	JitterStats Stats() const;
+
+private:
+	int64_t ExtendTimestamp(uint32_t ts);
+	void UpdateBaseDelay(int64_t transfer_delay, uint64_t now_ms);
+	void UpdateJitter(int64_t ext_ts, uint64_t now_ms);
+	void UpdatePlayoutDelay();
+	void CatchUp(uint64_t now_ms);
+	uint64_t PlayTime(int64_t ext_ts) const;
+
+private:
+	media::MediaType m_media_type = media::MediaType::INVALID;
+	JitterParam m_param;
+
+	std::deque<JitterFrame> m_frames;
+
+	// Timestamp unwrapping
+	bool m_first_frame = true;
+	uint32_t m_last_ts = 0;
+	int64_t m_ext_ts = 0;
+
+	// Minimum transfer delay of current and previous window
+	int64_t m_base_delay = 0;
+	int64_t m_prev_min_delay = 0;
+	int64_t m_cur_min_delay = 0;
+	uint64_t m_window_start_ms = 0;
+
+	int64_t m_last_jitter_ts = 0;
+	uint64_t m_last_arrival_ms = 0;
+	double m_jitter = 0;
+
+	double m_target_delay = 0;
+	double m_delay = 0;
+
+	bool m_released = false;
+	int64_t m_last_release_ts = 0;
+
+	JitterStats m_stats;
+
+	static const uint32_t kBaseDelayWindowMs = 5000;
+	static const uint32_t kStretchThresholdMs = 20;
+	static const int32_t kMaxStretchPermille = 100;
+};
+typedef std::shared_ptr<JitterBuffer> JitterBufferSP;
+
+}
@@ -0,0 +1,469 @@
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+
+#include "pin-cap.h"
+#include "nlohmann/json.hpp"
+#include "log.h"
+
+using json = nlohmann::json;
+
+namespace jukey::media::util
+{
+
+namespace
+{
+
+// Each field of packed capability takes 6 bits, each dimension of bitsets
+// takes 32 bits, so enumerator must be less than 32
+const uint32_t kFieldBits = 6;
+const uint32_t kMaxFieldValue = 32;
+
+// Distinct capability strings are limited, cache is cleared if exceeded
+const size_t kMaxCachedCaps = 4096;
+
+std::mutex g_cache_mutex;
+std::unordered_map<std::string, stmr::PackedCap> g_packed_caps;
+std::unordered_map<std::string, CapMask> g_cap_masks;
+std::unordered_map<std::string, CapOrder> g_cap_orders;
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+template<class Param>
+uint32_t ToField(Param param)
+{
+	uint32_t value = static_cast<uint32_t>(param);
+	return (value < kMaxFieldValue) ? value : 0;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+uint32_t GetField(stmr::PackedCap cap, uint32_t index)
+{
+	return (cap >> (kFieldBits * (3 - index))) & ((1u << kFieldBits) - 1);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+stmr::PackedCap MakePackedCap(media::MediaType mt, uint32_t f0, uint32_t f1,
+	uint32_t f2, uint32_t f3)
+{
+	return (static_cast<uint32_t>(mt) << 24)
+		| (f0 << (kFieldBits * 3))
+		| (f1 << (kFieldBits * 2))
+		| (f2 << kFieldBits)
+		| f3;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+template<class Param>
+uint32_t ToDimMask(const std::vector<Param>& params)
+{
+	uint32_t mask = 0;
+	for (auto param : params) {
+		uint32_t value = static_cast<uint32_t>(param);
+		if (value < kMaxFieldValue) {
+			mask |= (1u << value);
+		}
+		else {
+			LOG_ERR("Invalid capability value:{}", value);
+		}
+	}
+	return mask;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+template<class Param>
+std::vector<uint8_t> ToDimOrder(const std::vector<Param>& params)
+{
+	std::vector<uint8_t> order;
+	for (auto param : params) {
+		uint32_t value = static_cast<uint32_t>(param);
+		if (value < kMaxFieldValue) {
+			order.push_back(static_cast<uint8_t>(value));
+		}
+		else {
+			LOG_ERR("Invalid capability value:{}", value);
+		}
+	}
+	return order;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+uint32_t OrderToDimMask(const std::vector<uint8_t>& order)
+{
+	uint32_t mask = 0;
+	for (auto value : order) {
+		mask |= (1u << value);
+	}
+	return mask;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+stmr::PackedCap ParsePackedCap(CSTREF cap_str)
+{
+	try {
+		auto result = json::parse(cap_str);
+
+		media::MediaType mt = result["media_type"].get<media::MediaType>();
+		if (mt == media::MediaType::AUDIO) {
+			media::com::AudioCap cap;
+			cap.codec = result["codec"].get<media::AudioCodec>();
+			cap.chnls = result["channels"].get<media::AudioChnls>();
+			cap.sbits = result["sample_bits"].get<media::AudioSBits>();
+			cap.srate = result["sample_rate"].get<media::AudioSRate>();
+			return PackAudioCap(cap);
+		}
+		else if (mt == media::MediaType::VIDEO) {
+			media::com::VideoCap cap;
+			cap.codec = result["codec"].get<media::VideoCodec>();
+			cap.res = result["resolution"].get<media::VideoRes>();
+			cap.format = result["pixel_format"].get<media::PixelFormat>();
+			return PackVideoCap(cap);
+		}
+		else {
+			LOG_ERR("Invalid media type:{}, cap:{}", mt, cap_str);
+			return INVALID_PACKED_CAP;
+		}
+	}
+	catch (const std::exception& e) {
+		LOG_ERR("Parse cap failed, cap:{}, error:{}", cap_str, e.what());
+		return INVALID_PACKED_CAP;
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+std::optional<CapOrder> ParseCapOrderImpl(CSTREF caps_str)
+{
+	try {
+		auto result = json::parse(caps_str);
+
+		CapOrder order;
+		order.media_type = result["media_type"].get<media::MediaType>();
+
+		if (order.media_type == media::MediaType::AUDIO) {
+			order.codecs = ToDimOrder(
+				result["codec"].get<std::vector<media::AudioCodec>>());
+			order.dim1 = ToDimOrder(
+				result["channels"].get<std::vector<media::AudioChnls>>());
+			order.dim2 = ToDimOrder(
+				result["sample_bits"].get<std::vector<media::AudioSBits>>());
+			order.dim3 = ToDimOrder(
+				result["sample_rate"].get<std::vector<media::AudioSRate>>());
+		}
+		else if (order.media_type == media::MediaType::VIDEO) {
+			order.codecs = ToDimOrder(
+				result["codec"].get<std::vector<media::VideoCodec>>());
+			order.dim1 = ToDimOrder(
+				result["resolution"].get<std::vector<media::VideoRes>>());
+			order.dim2 = ToDimOrder(
+				result["pixel_format"].get<std::vector<media::PixelFormat>>());
+		}
+		else {
+			LOG_ERR("Invalid media type:{}, caps:{}", order.media_type, caps_str);
+			return std::nullopt;
+		}
+
+		return order;
+	}
+	catch (const std::exception& e) {
+		LOG_ERR("Parse caps failed, caps:{}, error:{}", caps_str, e.what());
+		return std::nullopt;
+	}
+}
+
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+stmr::PackedCap PackAudioCap(const media::com::AudioCap& cap)
+{
+	return MakePackedCap(media::MediaType::AUDIO, ToField(cap.codec),
+		ToField(cap.chnls), ToField(cap.sbits), ToField(cap.srate));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+stmr::PackedCap PackVideoCap(const media::com::VideoCap& cap)
+{
+	return MakePackedCap(media::MediaType::VIDEO, ToField(cap.codec),
+		ToField(cap.res), ToField(cap.format), 0);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+media::com::AudioCap UnpackAudioCap(stmr::PackedCap cap)
+{
+	media::com::AudioCap audio_cap;
+	audio_cap.codec = static_cast<media::AudioCodec>(GetField(cap, 0));
+	audio_cap.chnls = static_cast<media::AudioChnls>(GetField(cap, 1));
+	audio_cap.sbits = static_cast<media::AudioSBits>(GetField(cap, 2));
+	audio_cap.srate = static_cast<media::AudioSRate>(GetField(cap, 3));
+
+	return audio_cap;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+media::com::VideoCap UnpackVideoCap(stmr::PackedCap cap)
+{
+	media::com::VideoCap video_cap;
+	video_cap.codec = static_cast<media::VideoCodec>(GetField(cap, 0));
+	video_cap.res = static_cast<media::VideoRes>(GetField(cap, 1));
+	video_cap.format = static_cast<media::PixelFormat>(GetField(cap, 2));
+
+	return video_cap;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+media::MediaType PackedCapType(stmr::PackedCap cap)
+{
+	return static_cast<media::MediaType>(cap >> 24);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+stmr::PackedCap PackedCapWithoutCodec(stmr::PackedCap cap)
+{
+	return cap & ~(((1u << kFieldBits) - 1) << (kFieldBits * 3));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+stmr::PackedCap PackCap(CSTREF cap_str)
+{
+	{
+		std::lock_guard<std::mutex> lock(g_cache_mutex);
+		auto iter = g_packed_caps.find(cap_str);
+		if (iter != g_packed_caps.end()) {
+			return iter->second;
+		}
+	}
+
+	stmr::PackedCap cap = ParsePackedCap(cap_str);
+	if (cap == INVALID_PACKED_CAP) {
+		return cap;
+	}
+
+	std::lock_guard<std::mutex> lock(g_cache_mutex);
+	if (g_packed_caps.size() >= kMaxCachedCaps) {
+		g_packed_caps.clear();
+	}
+	g_packed_caps.insert(std::make_pair(cap_str, cap));
+
+	return cap;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+stmr::PackedCaps PackCaps(const stmr::PinCaps& caps)
+{
+	stmr::PackedCaps packed_caps;
+	packed_caps.reserve(caps.size());
+
+	for (const auto& cap : caps) {
+		packed_caps.push_back(PackCap(cap));
+	}
+
+	return packed_caps;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+std::vector<uint32_t> IntersectPackedCaps(const stmr::PackedCaps& caps,
+	const stmr::PackedCaps& other_caps)
+{
+	stmr::PackedCaps sorted_caps(other_caps);
+	std::sort(sorted_caps.begin(), sorted_caps.end());
+
+	std::vector<uint32_t> indexes;
+	for (uint32_t i = 0; i < caps.size(); i++) {
+		if (caps[i] != INVALID_PACKED_CAP && std::binary_search(
+			sorted_caps.begin(), sorted_caps.end(), caps[i])) {
+			indexes.push_back(i);
+		}
+	}
+
+	return indexes;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+CapMask ToCapMask(const media::com::AudioCaps& caps)
+{
+	CapMask mask;
+	mask.media_type = media::MediaType::AUDIO;
+	mask.codecs = ToDimMask(caps.codecs);
+	mask.dim1 = ToDimMask(caps.chnlss);
+	mask.dim2 = ToDimMask(caps.sbitss);
+	mask.dim3 = ToDimMask(caps.srates);
+
+	return mask;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+CapMask ToCapMask(const media::com::VideoCaps& caps)
+{
+	CapMask mask;
+	mask.media_type = media::MediaType::VIDEO;
+	mask.codecs = ToDimMask(caps.codecs);
+	mask.dim1 = ToDimMask(caps.ress);
+	mask.dim2 = ToDimMask(caps.formats);
+
+	return mask;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+std::optional<CapMask> ParseCapMask(CSTREF caps_str)
+{
+	{
+		std::lock_guard<std::mutex> lock(g_cache_mutex);
+		auto iter = g_cap_masks.find(caps_str);
+		if (iter != g_cap_masks.end()) {
+			return iter->second;
+		}
+	}
+
+	std::optional<CapOrder> order = ParseCapOrder(caps_str);
+	if (!order.has_value()) {
+		return std::nullopt;
+	}
+
+	CapMask mask = ToCapMask(order.value());
+
+	std::lock_guard<std::mutex> lock(g_cache_mutex);
+	if (g_cap_masks.size() >= kMaxCachedCaps) {
+		g_cap_masks.clear();
+	}
+	g_cap_masks.insert(std::make_pair(caps_str, mask));
+
+	return mask;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+std::optional<CapOrder> ParseCapOrder(CSTREF caps_str)
+{
+	{
+		std::lock_guard<std::mutex> lock(g_cache_mutex);
+		auto iter = g_cap_orders.find(caps_str);
+		if (iter != g_cap_orders.end()) {
+			return iter->second;
+		}
+	}
+
+	std::optional<CapOrder> order = ParseCapOrderImpl(caps_str);
+	if (!order.has_value()) {
+		return std::nullopt;
+	}
+
+	std::lock_guard<std::mutex> lock(g_cache_mutex);
+	if (g_cap_orders.size() >= kMaxCachedCaps) {
+		g_cap_orders.clear();
+	}
+	g_cap_orders.insert(std::make_pair(caps_str, order.value()));
+
+	return order;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+CapMask ToCapMask(const CapOrder& order)
+{
+	CapMask mask;
+	mask.media_type = order.media_type;
+	mask.codecs = OrderToDimMask(order.codecs);
+	mask.dim1 = OrderToDimMask(order.dim1);
+	mask.dim2 = OrderToDimMask(order.dim2);
+	mask.dim3 = OrderToDimMask(order.dim3);
+
+	return mask;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool MatchCapMask(stmr::PackedCap cap, const CapMask& mask)
+{
+	if (PackedCapType(cap) != mask.media_type) {
+		return false;
+	}
+
+	if (!TestCapBit(mask.codecs, GetField(cap, 0))
+		|| !TestCapBit(mask.dim1, GetField(cap, 1))
+		|| !TestCapBit(mask.dim2, GetField(cap, 2))) {
+		return false;
+	}
+
+	// Video capability has no dimension 3
+	return mask.media_type != media::MediaType::AUDIO
+		|| TestCapBit(mask.dim3, GetField(cap, 3));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+CapMask IntersectCapMask(const CapMask& mask, const CapMask& other_mask)
+{
+	CapMask result;
+
+	if (mask.media_type != other_mask.media_type) {
+		return result;
+	}
+
+	result.media_type = mask.media_type;
+	result.codecs = mask.codecs & other_mask.codecs;
+	result.dim1 = mask.dim1 & other_mask.dim1;
+	result.dim2 = mask.dim2 & other_mask.dim2;
+	result.dim3 = mask.dim3 & other_mask.dim3;
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool IsEmptyCapMask(const CapMask& mask)
+{
+	if (mask.media_type == media::MediaType::AUDIO) {
+		return !mask.codecs || !mask.dim1 || !mask.dim2 || !mask.dim3;
+	}
+	else if (mask.media_type == media::MediaType::VIDEO) {
+		return !mask.codecs || !mask.dim1 || !mask.dim2;
+	}
+	else {
+		return true;
+	}
+}
+
+}
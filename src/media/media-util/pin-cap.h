@@ -0,0 +1,115 @@
+#pragma once
+
+#include <optional>
+
+#include "common-define.h"
+#include "if-pin.h"
+#include "public/media-enum.h"
+#include "common/media-common-struct.h"
+
+namespace jukey::media::util
+{
+
+//==============================================================================
+// Packed capability, one capability packed into an integer:
+// bits[24~31]: media type
+// bits[18~23]: codec
+// bits[12~17]: audio channels | video resolution
+// bits[6~11] : audio sample bits | video pixel format
+// bits[0~5]  : audio sample rate
+// Two packed capabilities are equal if and only if the capabilities are equal,
+// so matching capabilities is integer comparison.
+//==============================================================================
+static const stmr::PackedCap INVALID_PACKED_CAP = 0;
+
+// Pack audio capability
+stmr::PackedCap PackAudioCap(const media::com::AudioCap& cap);
+
+// Pack video capability
+stmr::PackedCap PackVideoCap(const media::com::VideoCap& cap);
+
+// Unpack audio capability
+media::com::AudioCap UnpackAudioCap(stmr::PackedCap cap);
+
+// Unpack video capability
+media::com::VideoCap UnpackVideoCap(stmr::PackedCap cap);
+
+// Media type of packed capability
+media::MediaType PackedCapType(stmr::PackedCap cap);
+
+// Packed capability without codec
+stmr::PackedCap PackedCapWithoutCodec(stmr::PackedCap cap);
+
+// Pack capability json string, json string is parsed only once and the result
+// is cached, return INVALID_PACKED_CAP if parse failed
+stmr::PackedCap PackCap(CSTREF cap_str);
+
+// Pack capability json strings, invalid one is packed to INVALID_PACKED_CAP
+stmr::PackedCaps PackCaps(const stmr::PinCaps& caps);
+
+// Index of each capability of caps that is also in other caps, order of caps
+// is kept
+std::vector<uint32_t> IntersectPackedCaps(const stmr::PackedCaps& caps,
+	const stmr::PackedCaps& other_caps);
+
+//==============================================================================
+// Capabilities as bitsets, bit N of a dimension is set if enumerator N of the
+// dimension is supported. Dimensions of audio: codec, channels, sample bits,
+// sample rate; dimensions of video: codec, resolution, pixel format.
+//==============================================================================
+struct CapMask
+{
+	media::MediaType media_type = media::MediaType::INVALID;
+	uint32_t codecs = 0;
+	uint32_t dim1 = 0; // audio channels | video resolution
+	uint32_t dim2 = 0; // audio sample bits | video pixel format
+	uint32_t dim3 = 0; // audio sample rate
+};
+
+// Audio capabilities to bitsets
+CapMask ToCapMask(const media::com::AudioCaps& caps);
+
+// Video capabilities to bitsets
+CapMask ToCapMask(const media::com::VideoCaps& caps);
+
+// Parse capabilities json string to bitsets, json string is parsed only once
+// and the result is cached
+std::optional<CapMask> ParseCapMask(CSTREF caps_str);
+
+//==============================================================================
+// Capabilities in declared order, the first one is preferred by the pin.
+// Dimensions are the same as CapMask.
+//==============================================================================
+struct CapOrder
+{
+	media::MediaType media_type = media::MediaType::INVALID;
+	std::vector<uint8_t> codecs;
+	std::vector<uint8_t> dim1;
+	std::vector<uint8_t> dim2;
+	std::vector<uint8_t> dim3;
+};
+
+// Parse capabilities json string keeping declared order, json string is
+// parsed only once and the result is cached
+std::optional<CapOrder> ParseCapOrder(CSTREF caps_str);
+
+// Ordered capabilities to bitsets
+CapMask ToCapMask(const CapOrder& order);
+
+// Check if packed capability included in capabilities
+bool MatchCapMask(stmr::PackedCap cap, const CapMask& mask);
+
+// Capabilities supported by both
+CapMask IntersectCapMask(const CapMask& mask, const CapMask& other_mask);
+
+// Check if any capability is left in each dimension
+bool IsEmptyCapMask(const CapMask& mask);
+
+// Check if enumerator is set in dimension bitset
+template<class Param>
+bool TestCapBit(uint32_t dim, Param param)
+{
+	return (dim & (1u << static_cast<uint32_t>(param))) != 0;
+}
+
+}
@@ -0,0 +1,114 @@
+#include "strand-thread.h"
+#include "log.h"
+
+namespace jukey::media::util
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+StrandThread::StrandThread(const std::string& owner) : m_owner(owner)
+{
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+StrandThread::~StrandThread()
+{
+	StopThread();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void StrandThread::StartThread(stmr::IStreamScheduler& scheduler)
+{
+	if (m_strand != INVALID_STRAND_ID) {
+		LOG_WRN("Strand thread:{} is already started!", m_owner);
+		return;
+	}
+
+	m_scheduler = &scheduler;
+	m_strand = m_scheduler->CreateStrand(m_owner);
+
+	LOG_INF("Start strand thread:{}, strand:{}", m_owner, m_strand);
+}
+
+//------------------------------------------------------------------------------
+// Messages not handled yet are dropped
+//------------------------------------------------------------------------------
+void StrandThread::StopThread()
+{
+	if (m_strand == INVALID_STRAND_ID) {
+		return;
+	}
+
+	m_scheduler->DestroyStrand(m_strand);
+	m_strand = INVALID_STRAND_ID;
+
+	LOG_INF("Stop strand thread:{}", m_owner);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool StrandThread::PostMsg(const jukey::com::CommonMsg& msg)
+{
+	if (m_strand == INVALID_STRAND_ID) {
+		return false;
+	}
+
+	return m_scheduler->Post(m_strand, [this, msg]() { OnThreadMsg(msg); });
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void StrandThread::Execute(jukey::util::Callable callable,
+	jukey::util::CallParam param)
+{
+	if (m_strand == INVALID_STRAND_ID) {
+		return;
+	}
+
+	m_scheduler->Post(m_strand, [callable, param]() { callable(param); });
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+jukey::com::ErrCode StrandThread::ExecuteSync(jukey::util::SyncCallableEC callable,
+	jukey::util::CallParam param)
+{
+	if (m_strand == INVALID_STRAND_ID) {
+		return jukey::com::ERR_CODE_FAILED;
+	}
+
+	return stmr::ExecuteInStrand<jukey::com::ErrCode>(*m_scheduler, m_strand,
+		[callable, param]() { return callable(param); }, jukey::com::ERR_CODE_FAILED);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void* StrandThread::ExecuteSync(jukey::util::SyncCallableVP callable,
+	jukey::util::CallParam param)
+{
+	if (m_strand == INVALID_STRAND_ID) {
+		return nullptr;
+	}
+
+	return stmr::ExecuteInStrand<void*>(*m_scheduler, m_strand,
+		[callable, param]() { return callable(param); }, nullptr);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void StrandThread::OnThreadMsg(const jukey::com::CommonMsg& msg)
+{
+	LOG_WRN("Unhandled message:{} in strand thread:{}", msg.msg_type, m_owner);
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+#include "thread/if-thread.h"
+#include "if-scheduler.h"
+
+namespace jukey::media::util
+{
+
+//==============================================================================
+// IThread running in a strand of the pipeline scheduler. Element driven by
+// messages uses it instead of a dedicated CommonThread, messages and calls are
+// handled in order, but not always in the same thread.
+//==============================================================================
+class StrandThread : public jukey::util::IThread
+{
+public:
+	explicit StrandThread(const std::string& owner);
+	virtual ~StrandThread();
+
+	void StartThread(stmr::IStreamScheduler& scheduler);
+	void StopThread();
+
+	// IThread
+	virtual bool PostMsg(const jukey::com::CommonMsg& msg) override;
+	virtual void Execute(jukey::util::Callable callable,
+		jukey::util::CallParam param) override;
+	virtual jukey::com::ErrCode ExecuteSync(jukey::util::SyncCallableEC callable,
+		jukey::util::CallParam param) override;
+	virtual void* ExecuteSync(jukey::util::SyncCallableVP callable,
+		jukey::util::CallParam param) override;
+
+protected:
+	stmr::IStreamScheduler* m_scheduler = nullptr;
+	stmr::StrandId m_strand = INVALID_STRAND_ID;
+
+private:
+	// Overwrite this method to process message
+	virtual void OnThreadMsg(const jukey::com::CommonMsg& msg);
+
+private:
+	std::string m_owner;
+};
+
+}
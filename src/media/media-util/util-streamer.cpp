@@ -1,5 +1,6 @@
 #include "util-streamer.h"
 #include "util-enum.h"
+#include "pin-cap.h"
 #include "nlohmann/json.hpp"
 #include "common/util-common.h"
 #include "log.h"
@@ -96,39 +97,45 @@ uint32_t GetLineBytes(media::VideoRes res, media::PixelFormat format)
 	}
 }
 
+//------------------------------------------------------------------------------
+// Producer borrows memory by util::NoDestruct deleter
+//------------------------------------------------------------------------------
+bool IsBorrowedBuffer(const jukey::com::Buffer& buf)
+{
+	auto deleter = std::get_deleter<void(*)(uint8_t*)>(buf.data);
+
+	return deleter && *deleter == &jukey::util::NoDestruct;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
+static void CopyPlane(jukey::com::Buffer& buf)
+{
+	jukey::com::Buffer new_buf;
+	new_buf.data.reset(new uint8_t[buf.data_len]);
+	new_buf.data_len = buf.data_len;
+	new_buf.total_len = buf.data_len;
+	memcpy(DP(new_buf), DP(buf), buf.data_len);
+
+	buf = new_buf;
+}
+
+//------------------------------------------------------------------------------
+// Frame data is immutable after sent, so owned planes and parameters are shared
+// by reference count, only borrowed planes need copy
+//------------------------------------------------------------------------------
 stmr::PinDataSP ClonePinData(const stmr::PinData& data)
 {
-	stmr::PinDataSP new_data(new stmr::PinData());
-
-	// Copy properties
-	new_data->mt  = data.mt;
-	new_data->pts = data.pts;
-	new_data->dts = data.dts;
-	new_data->pos = data.pos;
-	new_data->drt = data.drt;
-	new_data->syn = data.syn;
-	new_data->tbd = data.tbd;
-	new_data->tbn = data.tbn;
-
-	// TODO: parameters without copy
-	new_data->media_para = data.media_para;
-
-	// Copy data
+	stmr::PinDataSP new_data(new stmr::PinData(data));
+
 	for (auto i = 0; i < 8; i++) {
-		uint32_t i_len = data.media_data[i].data_len;
-		if (i_len > 0) {
-			new_data->media_data[i].data.reset(new uint8_t[i_len]);
-			new_data->media_data[i].data_len = i_len;
-			new_data->media_data[i].total_len = i_len;
-			memcpy(DP(new_data->media_data[i]), DP(data.media_data[i]), i_len);
+		if (new_data->media_data[i].data_len > 0
+			&& IsBorrowedBuffer(new_data->media_data[i])) {
+			CopyPlane(new_data->media_data[i]);
 		}
 	}
 
-	new_data->data_count = data.data_count;
-
 	return new_data;
 }
 
@@ -465,18 +472,15 @@ std::string ToVideoCapsStr(const media::com::VideoCaps& caps)
 //------------------------------------------------------------------------------
 bool ParseVideoCap(CSTREF from, media::com::VideoCap& to)
 {
-  try {
-		auto result = json::parse(from);
-		to.codec = result["codec"].get<media::VideoCodec>();
-		to.res = result["resolution"].get<media::VideoRes>();
-		to.format = result["pixel_format"].get<media::PixelFormat>();
-
-		return true;
-  }
-  catch (const std::exception& e) {
-		LOG_ERR("Call ParseVideoCap failed, from:{}, error:{}", from, e.what());
+	stmr::PackedCap cap = PackCap(from);
+	if (PackedCapType(cap) != media::MediaType::VIDEO) {
+		LOG_ERR("Call ParseVideoCap failed, from:{}", from);
 		return false;
-  }
+	}
+
+	to = UnpackVideoCap(cap);
+
+	return true;
 }
 
 //------------------------------------------------------------------------------
@@ -484,19 +488,13 @@ bool ParseVideoCap(CSTREF from, media::com::VideoCap& to)
 //------------------------------------------------------------------------------
 std::optional<media::com::VideoCap> ParseVideoCap(CSTREF cap_str)
 {
-  media::com::VideoCap vcap;
-  try {
-		auto result = json::parse(cap_str);
-		vcap.codec = result["codec"].get<media::VideoCodec>();
-		vcap.res = result["resolution"].get<media::VideoRes>();
-		vcap.format = result["pixel_format"].get<media::PixelFormat>();
-
-		return vcap;
-  }
-  catch (const std::exception& e) {
-		LOG_ERR("ParseVideoCap failed, str:{}, error:{}", cap_str, e.what());
+	stmr::PackedCap cap = PackCap(cap_str);
+	if (PackedCapType(cap) != media::MediaType::VIDEO) {
+		LOG_ERR("ParseVideoCap failed, str:{}", cap_str);
 		return std::nullopt;
-  }
+	}
+
+	return UnpackVideoCap(cap);
 }
 
 //------------------------------------------------------------------------------
@@ -663,20 +661,13 @@ std::string ToAudioCapsStr(const media::com::AudioCap& cap)
 //------------------------------------------------------------------------------
 std::optional<media::com::AudioCap> media::util::ParseAudioCap(CSTREF cap_str)
 {
-  media::com::AudioCap cap;
-  try {
-		auto result = json::parse(cap_str);
-		cap.codec = result["codec"].get<media::AudioCodec>();
-		cap.chnls = result["channels"].get<media::AudioChnls>();
-		cap.sbits = result["sample_bits"].get<media::AudioSBits>();
-		cap.srate = result["sample_rate"].get<media::AudioSRate>();
-
-		return cap;
-  }
-  catch (const std::exception& e) {
-		LOG_ERR("ParseAudioCap failed, from:{}, error:{}", cap_str, e.what());
+	stmr::PackedCap cap = PackCap(cap_str);
+	if (PackedCapType(cap) != media::MediaType::AUDIO) {
+		LOG_ERR("ParseAudioCap failed, from:{}", cap_str);
 		return std::nullopt;
-  }
+	}
+
+	return UnpackAudioCap(cap);
 }
 
 //------------------------------------------------------------------------------
@@ -866,59 +857,19 @@ jukey::com::ErrCode ParseAvaiVideoCaps(const std::string& caps_str,
 //------------------------------------------------------------------------------
 bool MatchAudioCaps(const std::string& cap, const std::string& caps)
 {
-  std::optional<media::com::AudioCap> ocap = util::ParseAudioCap(cap);
-  if (!ocap.has_value()) {
+	stmr::PackedCap packed_cap = PackCap(cap);
+	if (PackedCapType(packed_cap) != media::MediaType::AUDIO) {
 		LOG_ERR("Parse audio cap:{} failed!", cap);
 		return false;
-  }
+	}
 
-  std::optional<media::com::AudioCaps> ocaps = util::ParseAudioCaps(caps);
-  if (!ocaps.has_value()) {
+	std::optional<CapMask> mask = ParseCapMask(caps);
+	if (!mask.has_value()) {
 		LOG_ERR("Parse audio caps:{} failed!", caps);
 		return false;
-  }
-
-  // codec
-  bool found = false;
-  for (auto& item : ocaps->codecs) {
-		if (item == ocap->codec) {
-			found = true;
-			break;
-		}
-  }
-  if (!found) return false;
-
-  // channels
-  found = false;
-  for (auto& item : ocaps->chnlss) {
-		if (item == ocap->chnls) {
-			found = true;
-			break;
-		}
-  }
-  if (!found) return false;
-
-  // sample bits
-  found = false;
-  for (auto& item : ocaps->sbitss) {
-		if (item == ocap->sbits) {
-			found = true;
-			break;
-		}
-  }
-  if (!found) return false;
-
-  // sample rate
-  found = false;
-  for (auto& item : ocaps->srates) {
-		if (item == ocap->srate) {
-			found = true;
-			break;
-		}
-  }
-  if (!found) return false;
+	}
 
-  return true;
+	return MatchCapMask(packed_cap, mask.value());
 }
 
 //------------------------------------------------------------------------------
@@ -926,49 +877,19 @@ bool MatchAudioCaps(const std::string& cap, const std::string& caps)
 //------------------------------------------------------------------------------
 bool MatchVideoCaps(const std::string& cap, const std::string& caps)
 {
-  std::optional<media::com::VideoCap> ocap = media::util::ParseVideoCap(cap);
-  if (!ocap.has_value()) {
+	stmr::PackedCap packed_cap = PackCap(cap);
+	if (PackedCapType(packed_cap) != media::MediaType::VIDEO) {
 		LOG_ERR("Parse video cap:{} failed!", cap);
 		return false;
-  }
+	}
 
-  std::optional<media::com::VideoCaps> ocaps = util::ParseVideoCaps(caps);
-  if (!ocaps.has_value()) {
+	std::optional<CapMask> mask = ParseCapMask(caps);
+	if (!mask.has_value()) {
 		LOG_ERR("Parse video caps:{} failed!", caps);
 		return false;
-  }
-
-  // codec
-  bool found = false;
-  for (auto& item : ocaps->codecs) {
-		if (item == ocap->codec) {
-			found = true;
-			break;
-		}
-  }
-  if (!found) return false;
-
-  // resolution
-  found = false;
-  for (auto& item : ocaps->ress) {
-		if (item == ocap->res) {
-			found = true;
-			break;
-		}
-  }
-  if (!found) return false;
-
-  // pixel format
-  found = false;
-  for (auto& item : ocaps->formats) {
-		if (item == ocap->format) {
-			found = true;
-			break;
-		}
-  }
-  if (!found) return false;
+	}
 
-  return true;
+	return MatchCapMask(packed_cap, mask.value());
 }
 
 //------------------------------------------------------------------------------
@@ -1075,35 +996,48 @@ std::string PinCapsToStr(const std::vector<media::com::VideoCap>& caps)
 }
 
 //------------------------------------------------------------------------------
-// 
+// Src caps whose packed value equals any match cap with codec cleared
 //------------------------------------------------------------------------------
-stmr::PinCaps MatchAudioPinCapsWithoutCodec(const stmr::PinCaps& src_caps, 
-	const stmr::PinCaps& match_caps)
+static stmr::PinCaps MatchPinCapsWithoutCodec(const stmr::PinCaps& src_caps,
+	const stmr::PinCaps& match_caps, media::MediaType media_type)
 {
-	stmr::PinCaps match_result;
-
-	auto match_audio_caps = ToAudioCaps(match_caps);
+	stmr::PackedCaps match_packed;
+	for (auto cap : PackCaps(match_caps)) {
+		if (PackedCapType(cap) == media_type) {
+			match_packed.push_back(PackedCapWithoutCodec(cap));
+		}
+	}
 
+	stmr::PackedCaps src_packed;
 	for (const auto& src_cap : src_caps) {
-		auto audio_cap = ParseAudioCap(src_cap);
-		if (!audio_cap.has_value()) {
-			LOG_ERR("Parse audio cap failed, cap:{}", src_cap);
-			continue;
+		stmr::PackedCap cap = PackCap(src_cap);
+		if (PackedCapType(cap) != media_type) {
+			LOG_ERR("Parse cap failed, cap:{}", src_cap);
+			src_packed.push_back(INVALID_PACKED_CAP);
 		}
-		
-		for (const auto& match_audio_cap : match_audio_caps) {
-			if (audio_cap->chnls == match_audio_cap.chnls
-				&& audio_cap->sbits == match_audio_cap.sbits
-				&& audio_cap->srate == match_audio_cap.srate) {
-				match_result.push_back(src_cap);
-				break;
-			}
+		else {
+			src_packed.push_back(PackedCapWithoutCodec(cap));
 		}
 	}
 
+	stmr::PinCaps match_result;
+	for (auto index : IntersectPackedCaps(src_packed, match_packed)) {
+		match_result.push_back(src_caps[index]);
+	}
+
 	return match_result;
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+stmr::PinCaps MatchAudioPinCapsWithoutCodec(const stmr::PinCaps& src_caps, 
+	const stmr::PinCaps& match_caps)
+{
+	return MatchPinCapsWithoutCodec(src_caps, match_caps,
+		media::MediaType::AUDIO);
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -1122,27 +1056,8 @@ stmr::PinCaps MatchAudioPinCapsWithoutCodec(const stmr::PinCaps& src_caps,
 stmr::PinCaps MatchVideoPinCapsWithoutCodec(const stmr::PinCaps& src_caps,
 	const stmr::PinCaps& match_caps)
 {
-	stmr::PinCaps match_result;
-
-	auto match_video_caps = ToVideoCaps(match_caps);
-
-	for (const auto& src_cap : src_caps) {
-		auto video_cap = ParseVideoCap(src_cap);
-		if (!video_cap.has_value()) {
-			LOG_ERR("Parse video cap failed, cap:{}", src_cap);
-			continue;
-		}
-
-		for (const auto& match_video_cap : match_video_caps) {
-			if (video_cap->format == match_video_cap.format
-				&& video_cap->res == match_video_cap.res) {
-				match_result.push_back(src_cap);
-				break;
-			}
-		}
-	}
-
-	return match_result;
+	return MatchPinCapsWithoutCodec(src_caps, match_caps,
+		media::MediaType::VIDEO);
 }
 
 //------------------------------------------------------------------------------
@@ -26,9 +26,12 @@ media::VideoRes ToVideoRes(uint32_t width, uint32_t height);
 // Image line bytes
 uint32_t GetLineBytes(media::VideoRes res, media::PixelFormat format);
 
-// Clone pin data
+// Clone pin data, planes owned by data are shared, borrowed planes are copied
 stmr::PinDataSP ClonePinData(const stmr::PinData& data);
 
+// Plane memory is not owned, valid only within OnPinData
+bool IsBorrowedBuffer(const jukey::com::Buffer& buf);
+
 
 // Enumerate sample rate to number
 uint32_t GetSRateNum(media::AudioSRate srate);
@@ -19,6 +19,7 @@ struct VideoFramePara
 	uint32_t   ts     = 0;
 	uint32_t   seq    = 0;
 	bool       key    = false; // key frame
+	uint8_t    layer  = 0;     // simulcast spatial layer
 };
 typedef std::shared_ptr<VideoFramePara> VideoFrameParaSP;
 
@@ -1,62 +1,27 @@
+#include <stdexcept>
+
 #include "cap-negotiate.h"
-#include "nlohmann/json.hpp"
 #include "util-streamer.h"
+#include "pin-cap.h"
 #include "log.h"
 
 #include "public/media-enum.h"
 
-using json = nlohmann::json;
+using namespace jukey::media::util;
 
 namespace jukey::stmr
 {
 
 //------------------------------------------------------------------------------
-// 
+// The first source item supported by all sinks
 //------------------------------------------------------------------------------
 template<class Param, const Param PARAM_INVALID>
-Param NegotiateTemplate(CSTREF key, const json& src_json,
-	const std::vector<json>& sinks_json)
+Param NegotiateParam(const std::vector<uint8_t>& src_items, uint32_t sinks_mask)
 {
-	LOG_INF("Negotiate template, key:{}", key);
-	LOG_INF("\tsrc_json:{}", src_json.dump());
-
-	for (auto sink_json : sinks_json) {
-		LOG_INF("\tsink_json:{}", sink_json.dump());
-	}
-
-	try {
-		std::vector<Param> src_items = src_json[key];
-		if (src_items.empty()) {
-			throw(std::string("Empty source ").append(key).c_str());
-		}
-
-		std::vector<std::vector<Param>> sinks_items;
-		for (auto sink_json : sinks_json) {
-			sinks_items.push_back(sink_json[key]);
+	for (auto src_item : src_items) {
+		if (TestCapBit(sinks_mask, src_item)) {
+			return static_cast<Param>(src_item);
 		}
-
-		if (sinks_items.empty()) {
-			throw(std::string("Empty sinks ").append(key).c_str());
-		}
-
-		for (auto src_item : src_items) {
-			uint32_t match_count = 0;
-			for (auto sink_items : sinks_items) {
-				for (auto sink_item : sink_items) {
-					if (src_item == sink_item) {
-						match_count++;
-						break;
-					}
-				}
-			}
-			if (match_count == sinks_items.size()) {
-				return src_item;
-			}
-		}
-	}
-	catch (const std::exception& e) {
-		LOG_ERR("{}", e.what());
-		return PARAM_INVALID;
 	}
 
 	return PARAM_INVALID;
@@ -65,154 +30,72 @@ Param NegotiateTemplate(CSTREF key, const json& src_json,
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-uint32_t NegotiateVideoMaxFrameRate(const json& src_json,
-	const std::vector<json>& sinks_json)
+std::string NegotiateAudioCap(const CapOrder& src_caps,
+	const CapMask& sinks_mask)
 {
-	try {
-		uint32_t src_mfr = src_json["max_frame_rate"];
-
-		std::vector<uint32_t> sinks_mfr;
-		for (auto sink_json : sinks_json) {
-			sinks_mfr.push_back(sink_json["max_frame_rate"]);
-		}
-
-		for (auto sink_mfr : sinks_mfr) {
-			if (sink_mfr < src_mfr) {
-				src_mfr = sink_mfr;
-			}
-		}
-
-		return src_mfr;
-	}
-	catch (const std::exception& e) {
-		LOG_ERR("{}", e.what());
-		return 0;
-	}
-
-	return 0;
-}
+	media::com::AudioCap cap;
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-media::MediaType 
-NegotiateMediaType(const json& src_json, const std::vector<json>& sinks_json)
-{
-	try {
-		media::MediaType src_mt = src_json["media_type"];
-
-		std::vector<media::MediaType> sink_mts;
-		for (auto sink_json : sinks_json) {
-			sink_mts.push_back(sink_json["media_type"]);
-		}
-
-		for (auto sink_mt : sink_mts) {
-			if (sink_mt != src_mt) {
-				return media::MediaType::INVALID;
-			}
-		}
-
-		return src_mt;
-	}
-	catch (const std::exception& e) {
-		LOG_ERR("{}", e.what());
-		return media::MediaType::INVALID;
-	}
-
-	return media::MediaType::INVALID;
-}
-
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-void NegotiateAudioCap(const json& src_json,
-	const std::vector<json>& sinks_json, json& result)
-{
 	// codec
-	media::AudioCodec codec = NegotiateTemplate<media::AudioCodec, 
-		media::AudioCodec::INVALID>("codec", src_json, sinks_json);
-	if (codec == media::AudioCodec::INVALID) {
-		throw("Negotiate audio codec failed!");
-	}
-	else {
-		result["codec"] = codec;
+	cap.codec = NegotiateParam<media::AudioCodec, media::AudioCodec::INVALID>(
+		src_caps.codecs, sinks_mask.codecs);
+	if (cap.codec == media::AudioCodec::INVALID) {
+		throw std::runtime_error("Negotiate audio codec failed!");
 	}
 
 	// channels
-	media::AudioChnls chs = NegotiateTemplate<media::AudioChnls,
-		media::AudioChnls::INVALID>("channels", src_json, sinks_json);
-	if (chs == media::AudioChnls::INVALID) {
-		throw("Negotiate audio channels failed!");
-	}
-	else {
-		result["channels"] = chs;
+	cap.chnls = NegotiateParam<media::AudioChnls, media::AudioChnls::INVALID>(
+		src_caps.dim1, sinks_mask.dim1);
+	if (cap.chnls == media::AudioChnls::INVALID) {
+		throw std::runtime_error("Negotiate audio channels failed!");
 	}
 
 	// Sample bits
-	media::AudioSBits sb = NegotiateTemplate<media::AudioSBits,
-		media::AudioSBits::INVALID>("sample_bits", src_json, sinks_json);
-	if (sb == media::AudioSBits::INVALID) {
-		throw("Negotiate audio sample bits failed!");
-	}
-	else {
-		result["sample_bits"] = sb;
+	cap.sbits = NegotiateParam<media::AudioSBits, media::AudioSBits::INVALID>(
+		src_caps.dim2, sinks_mask.dim2);
+	if (cap.sbits == media::AudioSBits::INVALID) {
+		throw std::runtime_error("Negotiate audio sample bits failed!");
 	}
 
 	// Sample rate
-	media::AudioSRate sr = NegotiateTemplate<media::AudioSRate,
-		media::AudioSRate::INVALID>("sample_rate", src_json, sinks_json);
-	if (sr == media::AudioSRate::INVALID) {
-		throw("Negotiate audio sample rate failed!");
-	}
-	else {
-		result["sample_rate"] = sr;
+	cap.srate = NegotiateParam<media::AudioSRate, media::AudioSRate::INVALID>(
+		src_caps.dim3, sinks_mask.dim3);
+	if (cap.srate == media::AudioSRate::INVALID) {
+		throw std::runtime_error("Negotiate audio sample rate failed!");
 	}
+
+	return ToAudioCapStr(cap);
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void NegotiateVideoCap(const json& src_json,
-	const std::vector<json>& sinks_json, json& result)
+std::string NegotiateVideoCap(const CapOrder& src_caps,
+	const CapMask& sinks_mask)
 {
+	media::com::VideoCap cap;
+
 	// codec
-	media::VideoCodec codec = NegotiateTemplate<media::VideoCodec,
-		media::VideoCodec::INVALID>("codec", src_json, sinks_json);
-	if (codec == media::VideoCodec::INVALID) {
-		throw("Negotiate video codec failed!");
-	}
-	else {
-		result["codec"] = codec;
+	cap.codec = NegotiateParam<media::VideoCodec, media::VideoCodec::INVALID>(
+		src_caps.codecs, sinks_mask.codecs);
+	if (cap.codec == media::VideoCodec::INVALID) {
+		throw std::runtime_error("Negotiate video codec failed!");
 	}
 
 	// resolution
-	media::VideoRes res = NegotiateTemplate<media::VideoRes,
-		media::VideoRes::INVALID>("resolution", src_json, sinks_json);
-	if (res == media::VideoRes::INVALID) {
-		throw("Negotiate video resolution failed!");
+	cap.res = NegotiateParam<media::VideoRes, media::VideoRes::INVALID>(
+		src_caps.dim1, sinks_mask.dim1);
+	if (cap.res == media::VideoRes::INVALID) {
+		throw std::runtime_error("Negotiate video resolution failed!");
 	}
-	else {
-		result["resolution"] = res;
-	}
-
-	// max frame rate
-	//uint32_t mfr = NegotiateVideoMaxFrameRate(src_json, sinks_json);
-	//if (mfr == 0) {
-	//	throw("Negotiate video max frame rate failed!");
-	//}
-	//else {
-	//	result["max_frame_rate"] = mfr;
-	//}
 
 	// pixel format
-	media::PixelFormat format = NegotiateTemplate<media::PixelFormat,
-		media::PixelFormat::INVALID>("pixel_format", src_json, sinks_json);
-	if (format == media::PixelFormat::INVALID) {
-		throw("Negotiate video color space failed!");
-	}
-	else {
-		result["pixel_format"] = format;
+	cap.format = NegotiateParam<media::PixelFormat, media::PixelFormat::INVALID>(
+		src_caps.dim2, sinks_mask.dim2);
+	if (cap.format == media::PixelFormat::INVALID) {
+		throw std::runtime_error("Negotiate video color space failed!");
 	}
+
+	return ToVideoCapStr(cap);
 }
 
 //------------------------------------------------------------------------------
@@ -246,28 +129,36 @@ std::string NegotiateCap(CSTREF src, const std::vector<std::string>& sinks)
 		return std::string();
 	}
 
-	json result;
+	std::string result;
 
 	try {
-		json src_json = json::parse(src);
-		std::vector<json> sinks_json;
+		// Capabilities supported by all sinks
+		std::optional<CapMask> sinks_mask;
 		for (auto sink : sinks) {
-			sinks_json.push_back(json::parse(sink));
+			std::optional<CapMask> sink_mask = ParseCapMask(sink);
+			if (!sink_mask.has_value()) {
+				throw std::runtime_error("Parse sink caps failed!");
+			}
+			sinks_mask = sinks_mask.has_value() 
+				? IntersectCapMask(sinks_mask.value(), sink_mask.value())
+				: sink_mask;
 		}
 
-		media::MediaType mt = NegotiateMediaType(src_json, sinks_json);
-		if (mt == media::MediaType::INVALID) {
-			throw("Negotiate media type failed!");
+		// Source order is kept, the first one supported by sinks is chosen
+		std::optional<CapOrder> src_order = ParseCapOrder(src);
+		if (!src_order.has_value()) {
+			throw std::runtime_error("Parse src caps failed!");
 		}
-		else {
-			result["media_type"] = mt;
+
+		if (src_order->media_type != sinks_mask->media_type) {
+			throw std::runtime_error("Negotiate media type failed!");
 		}
 		
-		if (mt == media::MediaType::AUDIO) {
-			NegotiateAudioCap(src_json, sinks_json, result);
+		if (src_order->media_type == media::MediaType::AUDIO) {
+			result = NegotiateAudioCap(src_order.value(), sinks_mask.value());
 		}
 		else {
-			NegotiateVideoCap(src_json, sinks_json, result);
+			result = NegotiateVideoCap(src_order.value(), sinks_mask.value());
 		}
 	}
 	catch (const std::exception& e) {
@@ -275,9 +166,9 @@ std::string NegotiateCap(CSTREF src, const std::vector<std::string>& sinks)
 		return std::string();
 	}
 
-	LOG_INF("Negotiate capability result:{}", media::util::Capper(result.dump()));
+	LOG_INF("Negotiate capability result:{}", media::util::Capper(result));
 
-	return result.dump();
+	return result;
 }
 
 //------------------------------------------------------------------------------
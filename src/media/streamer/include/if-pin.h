@@ -146,6 +146,60 @@ typedef std::shared_ptr<PinData> PinDataSP;
 //==============================================================================
 typedef std::vector<std::string> PinCaps;
 
+//==============================================================================
+// Capability packed into an integer, see pin-cap.h of media-util
+//==============================================================================
+typedef uint32_t PackedCap;
+typedef std::vector<PackedCap> PackedCaps;
+
+//==============================================================================
+// How pin data is passed from src pin to sink pin
+//==============================================================================
+enum class LinkMode
+{
+	DIRECT = 0, // sink pin is called in the thread of src element
+	QUEUED = 1, // queued, sink pin is called in a strand of the link
+};
+
+//==============================================================================
+// What producer does when queue of the link is full
+//==============================================================================
+enum class LinkDropPolicy
+{
+	DEFAULT     = 0, // DROP_OLDEST for video, BLOCK for audio
+	DROP_OLDEST = 1, // drop the oldest queued data
+	BLOCK       = 2, // wait for space, at most PIN_LINK_MAX_BLOCK_MS
+};
+
+//==============================================================================
+// Link parameter
+//==============================================================================
+struct LinkParam
+{
+	LinkParam() {}
+	LinkParam(LinkMode m) : mode(m) {}
+
+	LinkMode mode = LinkMode::DIRECT;
+	LinkDropPolicy drop_policy = LinkDropPolicy::DEFAULT;
+	uint32_t queue_size = 0; // 0: PIN_LINK_DEFAULT_QUEUE_SIZE
+};
+
+//==============================================================================
+// Link statistics, only queued link has queue statistics
+//==============================================================================
+struct LinkStats
+{
+	LinkMode mode = LinkMode::DIRECT;
+	uint32_t depth = 0;          // queued data count
+	uint32_t max_depth = 0;
+	uint64_t pushed = 0;         // data count pushed by src pin
+	uint64_t delivered = 0;      // data count delivered to sink pin
+	uint64_t dropped = 0;        // data count dropped for full queue
+	uint64_t blocked = 0;        // times producer waited for space
+	uint64_t avg_latency_us = 0; // from pushed to delivered
+	uint64_t max_latency_us = 0;
+};
+
 class IElement;
 //==============================================================================
 // Elements should be linked with pins
@@ -209,6 +263,11 @@ public:
 	//
 	virtual PinCaps AvaiCaps() = 0;
 
+	//
+	// Get available capabilities packed, in the same order as AvaiCaps
+	//
+	virtual PackedCaps PackedAvaiCaps() = 0;
+
 	//
 	// Input pin data
 	//
@@ -265,6 +324,11 @@ public:
 	//
 	virtual com::ErrCode AddSinkPin(ISinkPin* pin) = 0;
 
+	//
+	// Add sink pin with link parameter
+	//
+	virtual com::ErrCode AddSinkPin(ISinkPin* pin, const LinkParam& param) = 0;
+
 	//
 	// Remove sink pin link
 	//
@@ -289,6 +353,11 @@ public:
 	// Update available capabilities
 	//
 	virtual com::ErrCode UpdateAvaiCaps(const PinCaps& caps) = 0;
+
+	//
+	// Get statistics of link to sink pin
+	//
+	virtual com::ErrCode GetLinkStats(CSTREF pin_name, LinkStats& stats) = 0;
 };
 
 //==============================================================================
@@ -6,6 +6,7 @@
 #include "common-struct.h"
 #include "if-property.h"
 #include "if-sync-mgr.h"
+#include "if-scheduler.h"
 
 #include "public/media-enum.h"
 
@@ -56,6 +57,7 @@ class ISyncMgr;
 class IElement;
 class ISrcPin;
 class ISinkPin;
+struct LinkParam;
 struct EleStreamData;
 //==============================================================================
 // Interface of pipeline, which is a component
@@ -141,10 +143,22 @@ public:
 	 */
 	virtual com::ErrCode LinkElement(ISrcPin* src_pin, ISinkPin* sink_pin) = 0;
 
+	/**
+	 * @brief Link element src pin and sink pin, queued link runs sink element
+	 *        in another strand
+	 */
+	virtual com::ErrCode LinkElement(ISrcPin* src_pin, ISinkPin* sink_pin,
+		const LinkParam& param) = 0;
+
 	/**
 	 * @brief Get element by name
 	 */
 	virtual IElement* GetElementByName(const std::string& ele_name) = 0;
+
+	/**
+	 * @brief Scheduler running pipeline and elements
+	 */
+	virtual IStreamScheduler& GetScheduler() = 0;
 };
 
 }
\ No newline at end of file
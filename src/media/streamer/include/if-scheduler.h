@@ -0,0 +1,155 @@
+#pragma once
+
+#include <future>
+#include <chrono>
+#include <string>
+#include <functional>
+
+#include "common-enum.h"
+#include "common-error.h"
+
+namespace jukey::stmr
+{
+
+typedef uint32_t StrandId;
+
+#define INVALID_STRAND_ID 0
+
+// Task posted to strand
+typedef std::function<void()> SchedTask;
+
+// Periodic process, returns interval to the next process in milliseconds
+typedef std::function<uint32_t()> SchedProcess;
+
+//==============================================================================
+// Scheduler shared by all pipelines and elements in process. Work is posted
+// to a strand: tasks and process of one strand run in order and never at the
+// same time, but may run on any worker thread. Thread count is fixed and
+// independent of element count.
+//==============================================================================
+class IStreamScheduler
+{
+public:
+	/**
+	 * @brief Virtual destruction
+	 */
+	virtual ~IStreamScheduler() {}
+
+	/**
+	 * @brief Create strand
+	 */
+	virtual StrandId CreateStrand(const std::string& name) = 0;
+
+	/**
+	 * @brief Destroy strand, tasks and process are not called after return,
+	 *        unless called by the strand itself
+	 */
+	virtual void DestroyStrand(StrandId strand) = 0;
+
+	/**
+	 * @brief Post task to strand
+	 */
+	virtual bool Post(StrandId strand, const SchedTask& task) = 0;
+
+	/**
+	 * @brief Post task to a strand owned by the scheduler, so objects used by
+	 *        the running task can be released after it returns
+	 */
+	virtual bool PostRelease(const SchedTask& task) = 0;
+
+	/**
+	 * @brief Set periodic process of strand, called after delay_ms first
+	 */
+	virtual bool SetProcess(StrandId strand, const SchedProcess& process,
+		uint32_t delay_ms) = 0;
+
+	/**
+	 * @brief Stop periodic process of strand
+	 */
+	virtual void ClearProcess(StrandId strand) = 0;
+
+	/**
+	 * @brief Whether current thread is running task of the strand
+	 */
+	virtual bool InStrand(StrandId strand) = 0;
+
+	/**
+	 * @brief Whether current thread is a worker thread
+	 */
+	virtual bool InWorker() = 0;
+
+	/**
+	 * @brief Block until done returns true, must be called in worker thread.
+	 *        A spare thread runs tasks of other strands while waiting, so
+	 *        blocking in a task does not starve the workers. Spare threads are
+	 *        limited, done should not depend on unbounded nested waits.
+	 *        done is checked after each strand run and each NotifyWaiters.
+	 */
+	virtual void WaitUntil(const std::function<bool()>& done) = 0;
+
+	/**
+	 * @brief Same as above, but gives up after timeout_ms
+	 * @return Whether done returned true
+	 */
+	virtual bool WaitUntil(const std::function<bool()>& done,
+		uint32_t timeout_ms) = 0;
+
+	/**
+	 * @brief Wake threads in WaitUntil to check done again, needed if done is
+	 *        changed out of strands, or by a task which then blocks
+	 */
+	virtual void NotifyWaiters() = 0;
+
+	/**
+	 * @brief Worker thread count
+	 */
+	virtual uint32_t ThreadCount() = 0;
+};
+
+//------------------------------------------------------------------------------
+// Wait for result of a task, may be called in worker thread
+//------------------------------------------------------------------------------
+template<class T>
+T WaitSchedResult(IStreamScheduler& scheduler, std::future<T>& result)
+{
+	if (scheduler.InWorker()) {
+		scheduler.WaitUntil([&result]() {
+			return result.wait_for(std::chrono::seconds(0))
+				== std::future_status::ready;
+		});
+	}
+
+	return result.get();
+}
+
+//------------------------------------------------------------------------------
+// Run func in strand and wait for the result, run directly in the strand.
+// Returns failed if the strand is destroyed before func is run.
+//------------------------------------------------------------------------------
+template<class T>
+T ExecuteInStrand(IStreamScheduler& scheduler, StrandId strand,
+	const std::function<T()>& func, const T& failed)
+{
+	if (scheduler.InStrand(strand)) {
+		return func();
+	}
+
+	auto promise = std::make_shared<std::promise<T>>();
+	std::future<T> result = promise->get_future();
+
+	if (!scheduler.Post(strand, [promise, func]() {
+			promise->set_value(func());
+		})) {
+		return failed;
+	}
+	promise.reset(); // broken if the task is dropped
+
+	try {
+		return WaitSchedResult(scheduler, result);
+	}
+	catch (const std::future_error&) {
+		return failed;
+	}
+}
+
+}
@@ -35,6 +35,7 @@ enum PlMsgType
 	RUN_STATE             = 8019,
 	AUIDO_STREAM_STATS    = 8020,
 	VIDEO_STREAM_STATS    = 8021,
+	MIX_INPUT_GAIN        = 8022,
 
 	BUTT
 };
@@ -119,6 +120,29 @@ struct AudioEnergyData
 };
 typedef std::shared_ptr<AudioEnergyData> AudioEnergyDataSP;
 
+//==============================================================================
+// 
+//==============================================================================
+struct SinkPinData
+{
+	SinkPinData(const std::string& name) : pin_name(name) {}
+
+	std::string pin_name;
+};
+typedef std::shared_ptr<SinkPinData> SinkPinDataSP;
+
+//==============================================================================
+// Gain of mixer input, 1.0 keeps the level
+//==============================================================================
+struct MixGainData
+{
+	MixGainData(const std::string& name, float g) : pin_name(name), gain(g) {}
+
+	std::string pin_name;
+	float gain = 1.0f;
+};
+typedef std::shared_ptr<MixGainData> MixGainDataSP;
+
 //==============================================================================
 // 
 //==============================================================================
@@ -0,0 +1,242 @@
+#include "pin-link.h"
+#include "common-config.h"
+#include "common/util-time.h"
+#include "util-streamer.h"
+#include "log.h"
+
+using namespace jukey::com;
+
+namespace jukey::stmr
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+PinLink::PinLink(ISinkPin* sink_pin, const LinkParam& param)
+	: m_sink_pin(sink_pin)
+	, m_drop_policy(param.drop_policy)
+	, m_name(std::string("link-").append(sink_pin->ToStr()))
+	, m_scheduler(StreamScheduler::Instance())
+	, m_ring(param.queue_size ? param.queue_size : PIN_LINK_DEFAULT_QUEUE_SIZE)
+{
+	// Late video is useless, but audio gap is audible
+	if (m_drop_policy == LinkDropPolicy::DEFAULT) {
+		m_drop_policy = (sink_pin->MType() == media::MediaType::AUDIO)
+			? LinkDropPolicy::BLOCK : LinkDropPolicy::DROP_OLDEST;
+	}
+
+	m_strand = m_scheduler->CreateStrand(m_name);
+
+	LOG_INF("Create pin link:{}, queue size:{}, drop policy:{}", m_name,
+		m_ring.Capacity(), m_drop_policy);
+}
+
+//------------------------------------------------------------------------------
+// Queued data is released with the ring
+//------------------------------------------------------------------------------
+PinLink::~PinLink()
+{
+	// Waits for the running delivery
+	m_scheduler->DestroyStrand(m_strand);
+
+	LOG_INF("Destroy pin link:{}, pushed:{}, delivered:{}, dropped:{}, "
+		"blocked:{}", m_name, m_pushed.load(), m_delivered.load(),
+		m_dropped.load(), m_blocked.load());
+}
+
+//------------------------------------------------------------------------------
+// Sink element may remove the link in delivery, the delivery still runs after
+// the last reference is released. Destructor in the release strand waits for
+// the delivery to return.
+//------------------------------------------------------------------------------
+PinLinkSP PinLink::Create(ISinkPin* sink_pin, const LinkParam& param)
+{
+	return PinLinkSP(new PinLink(sink_pin, param), [](PinLink* link) {
+		if (!link->m_scheduler->InStrand(link->m_strand)) {
+			delete link;
+		}
+		else if (!link->m_scheduler->PostRelease([link]() { delete link; })) {
+			LOG_ERR("Post release of pin link:{} failed", link->m_name);
+		}
+	});
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PinLink::Close()
+{
+	m_closed = true;
+
+	// Wakes producer waiting for space
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cv.notify_all();
+	}
+	m_scheduler->NotifyWaiters();
+
+	// Strand is destroyed with the link, see Create
+	if (!m_scheduler->InStrand(m_strand)) {
+		m_scheduler->DestroyStrand(m_strand);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ISinkPin* PinLink::SinkPin()
+{
+	return m_sink_pin;
+}
+
+//------------------------------------------------------------------------------
+// Link strand is run by other threads while the worker waits. Spare threads are
+// limited, the link strand may not run in time, so waiting is always bounded.
+//------------------------------------------------------------------------------
+bool PinLink::WaitForSpace()
+{
+	m_waiting = true;
+
+	if (m_scheduler->InWorker()) {
+		m_scheduler->WaitUntil([this]() {
+			return !m_ring.Full() || m_closed;
+		}, PIN_LINK_MAX_BLOCK_MS);
+	}
+	else {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait_for(lock, std::chrono::milliseconds(PIN_LINK_MAX_BLOCK_MS),
+			[this]() { return !m_ring.Full() || m_closed; });
+	}
+
+	m_waiting = false;
+
+	return !m_ring.Full();
+}
+
+//------------------------------------------------------------------------------
+// Oldest data is dropped if blocking timed out
+//------------------------------------------------------------------------------
+void PinLink::PushEntry(LinkEntryUP& entry)
+{
+	if (m_ring.Push(entry)) {
+		return;
+	}
+
+	if (m_drop_policy == LinkDropPolicy::BLOCK) {
+		m_blocked++;
+		if (WaitForSpace() && m_ring.Push(entry)) {
+			return;
+		}
+		LOG_WRN("[{}] Blocked too long, drop the oldest data", m_name);
+	}
+
+	// Consumer may take the oldest first, then there is space
+	while (!m_ring.Push(entry)) {
+		if (m_ring.DropOldest()) {
+			m_dropped++;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// Src pin may reuse borrowed buffers after return, they are copied
+//------------------------------------------------------------------------------
+ErrCode PinLink::OnPinData(const PinData& data)
+{
+	if (m_closed) {
+		return ERR_CODE_FAILED;
+	}
+
+	LinkEntryUP entry(new LinkEntry());
+	entry->data = media::util::ClonePinData(data);
+	entry->push_time = util::Now();
+
+	PushEntry(entry);
+	m_pushed++;
+
+	uint32_t depth = m_ring.Size();
+	if (depth > m_max_depth) {
+		m_max_depth = depth;
+	}
+
+	if (!m_delivering.exchange(true)) {
+		m_scheduler->Post(m_strand, [this]() { DeliverData(); });
+	}
+
+	return ERR_CODE_OK;
+}
+
+//------------------------------------------------------------------------------
+// Only consumer of the ring
+//------------------------------------------------------------------------------
+void PinLink::DeliverData()
+{
+	while (true) {
+		uint32_t count = 0;
+		LinkEntryUP entry;
+
+		while (count < kMaxBatchData && !m_closed && m_ring.Pop(entry)) {
+			// Producer may wait in worker or not
+			if (m_waiting) {
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_cv.notify_one();
+				}
+				m_scheduler->NotifyWaiters();
+			}
+
+			uint64_t latency = util::Now() - entry->push_time;
+			m_latency_sum += latency;
+			if (latency > m_max_latency) {
+				m_max_latency = latency;
+			}
+
+			m_sink_pin->OnPinData(*entry->data);
+			m_delivered++;
+			count++;
+		}
+
+		// Delivering flag is kept, so nothing is posted any more
+		if (m_closed) {
+			return;
+		}
+
+		// Give other strands a chance, delivering flag is kept
+		if (count == kMaxBatchData) {
+			m_scheduler->Post(m_strand, [this]() { DeliverData(); });
+			return;
+		}
+
+		m_delivering = false;
+
+		// Pushed after the last pop but saw the delivering flag set
+		if (m_ring.Size() == 0 || m_delivering.exchange(true)) {
+			return;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+LinkStats PinLink::Stats()
+{
+	LinkStats stats;
+
+	stats.mode = LinkMode::QUEUED;
+	stats.depth = m_ring.Size();
+	stats.max_depth = m_max_depth;
+	stats.pushed = m_pushed;
+	stats.delivered = m_delivered;
+	stats.dropped = m_dropped;
+	stats.blocked = m_blocked;
+	stats.max_latency_us = m_max_latency;
+
+	if (stats.delivered > 0) {
+		stats.avg_latency_us = m_latency_sum / stats.delivered;
+	}
+
+	return stats;
+}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <condition_variable>
+
+#include "if-pin.h"
+#include "stream-scheduler.h"
+#include "common/spsc-ring.h"
+
+namespace jukey::stmr
+{
+
+//==============================================================================
+// Queued link from src pin to sink pin. Data is pushed to a bounded ring in
+// the thread of src element, and delivered to sink pin in the strand of the
+// link, so the sink element runs on another worker and a slow sink does not
+// stall the src element or its other sinks. Shared by src pin and its pushing
+// threads, so a link removed while being pushed stays valid.
+//==============================================================================
+class PinLink
+{
+public:
+	~PinLink();
+
+	//
+	// @brief The link released in its own strand is destroyed in the release
+	//        strand of scheduler, after the running delivery returns
+	//
+	static std::shared_ptr<PinLink> Create(ISinkPin* sink_pin,
+		const LinkParam& param);
+
+	ISinkPin* SinkPin();
+
+	com::ErrCode OnPinData(const PinData& data);
+
+	//
+	// @brief Stop delivery, sink pin is not called after return. Called in the
+	//        link strand, delivery stops after the running data.
+	//
+	void Close();
+
+	LinkStats Stats();
+
+private:
+	PinLink(ISinkPin* sink_pin, const LinkParam& param);
+
+	struct LinkEntry
+	{
+		PinDataSP data;
+		uint64_t push_time = 0; // us
+	};
+	typedef std::unique_ptr<LinkEntry> LinkEntryUP;
+
+	void PushEntry(LinkEntryUP& entry);
+	bool WaitForSpace();
+	void DeliverData();
+
+private:
+	ISinkPin* m_sink_pin = nullptr;
+	LinkDropPolicy m_drop_policy = LinkDropPolicy::DROP_OLDEST;
+	std::string m_name;
+
+	StreamSchedulerSP m_scheduler;
+	StrandId m_strand = INVALID_STRAND_ID;
+
+	util::SpscRing<LinkEntry> m_ring;
+
+	// Delivery task is posted or running
+	std::atomic<bool> m_delivering { false };
+	std::atomic<bool> m_closed { false };
+
+	// Producer waiting for space
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::atomic<bool> m_waiting { false };
+
+	std::atomic<uint32_t> m_max_depth { 0 };
+	std::atomic<uint64_t> m_pushed { 0 };
+	std::atomic<uint64_t> m_delivered { 0 };
+	std::atomic<uint64_t> m_dropped { 0 };
+	std::atomic<uint64_t> m_blocked { 0 };
+	std::atomic<uint64_t> m_latency_sum { 0 }; // us
+	std::atomic<uint64_t> m_max_latency { 0 }; // us
+
+	// Data delivered before the strand yields the worker
+	static const uint32_t kMaxBatchData = 16;
+};
+typedef std::shared_ptr<PinLink> PinLinkSP;
+
+}
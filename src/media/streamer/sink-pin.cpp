@@ -1,5 +1,6 @@
 #include "sink-pin.h"
 #include "util-streamer.h"
+#include "pin-cap.h"
 #include "log.h"
 #include "streamer-common.h"
 #include "util-enum.h"
@@ -8,32 +9,6 @@
 using namespace jukey::com;
 using namespace jukey::media::util;
 
-namespace
-{
-
-using namespace jukey::stmr;
-
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-PinCaps MakePreparedCaps(const PinCaps& avai_caps, std::list<ISrcPin*> src_pins)
-{
-	PinCaps prep_caps;
-
-	for (auto& cap : avai_caps) {
-		for (auto src_pin : src_pins) {
-			PinCaps caps = src_pin->AvaiCaps();
-			if (avai_caps.end() != std::find(caps.begin(), caps.end(), cap)) {
-				prep_caps.push_back(cap);
-			}
-		}
-	}
-
-	return prep_caps;
-}
-
-}
-
 namespace jukey::stmr
 {
 
@@ -81,6 +56,7 @@ ErrCode SinkPin::InitAvaiCaps()
 		return ERR_CODE_INVALID_PARAM;
 	}
 
+	m_avai_packed = PackCaps(m_avai_caps);
 	m_prep_caps = m_avai_caps;
 
 	LOG_DBG("{} init avaliable caps:{}", ToStr(), PinCapsToStr(m_avai_caps));
@@ -284,6 +260,14 @@ std::vector<std::string> SinkPin::AvaiCaps()
 	return m_avai_caps;
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+PackedCaps SinkPin::PackedAvaiCaps()
+{
+	return m_avai_packed;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -41,6 +41,7 @@ public:
 	virtual IElement* Element() override;
 	virtual PinCaps PrepCaps() override;
 	virtual PinCaps AvaiCaps() override;
+	virtual PackedCaps PackedAvaiCaps() override;
 	virtual com::ErrCode OnPinData(const PinData& data) override;
 	virtual com::ErrCode OnPinMsg(IPin* pin, const PinMsg& msg) override;
 	
@@ -71,6 +72,7 @@ private:
 	std::string m_nego_cap;  // negotiated capability
 
 	PinCaps m_avai_caps; // available capabilities
+	PackedCaps m_avai_packed; // packed available capabilities
 	PinCaps m_prep_caps; // prepared capabilities
 
 	std::string m_stream_id;
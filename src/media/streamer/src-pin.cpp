@@ -1,6 +1,7 @@
 ﻿#include "src-pin.h"
 #include "cap-negotiate.h"
 #include "util-streamer.h"
+#include "pin-cap.h"
 #include "common/util-common.h"
 #include "if-pipeline.h"
 #include "pipeline-msg.h"
@@ -19,23 +20,25 @@ namespace
 using namespace jukey::stmr;
 
 //------------------------------------------------------------------------------
-// 
+// Available caps supported by all sink pins, order of available caps is kept.
+// Caps are matched by packed value, strings are only copied to the result.
 //------------------------------------------------------------------------------
-PinCaps MakePreparedCaps(const PinCaps& avai_caps, std::list<ISinkPin*> sink_pins)
+PinCaps MakePreparedCaps(const PinCaps& avai_caps, 
+	const PackedCaps& avai_packed, const std::list<ISinkPin*>& sink_pins)
 {
-	PinCaps prep_caps;
+	std::vector<uint32_t> match_count(avai_packed.size(), 0);
 
-	for (auto& cap : avai_caps) {
-		bool all_sink_pin_found = true;
-		for (auto sink_pin : sink_pins) {
-			PinCaps caps = sink_pin->AvaiCaps();
-			if (std::find(caps.begin(), caps.end(), cap) == caps.end()) {
-				all_sink_pin_found = false;
-				break;
-			}
+	for (auto sink_pin : sink_pins) {
+		for (auto index : IntersectPackedCaps(avai_packed,
+			sink_pin->PackedAvaiCaps())) {
+			match_count[index]++;
 		}
-		if (all_sink_pin_found) {
-			prep_caps.push_back(cap);
+	}
+
+	PinCaps prep_caps;
+	for (uint32_t i = 0; i < match_count.size(); i++) {
+		if (match_count[i] == sink_pins.size()) {
+			prep_caps.push_back(avai_caps[i]);
 		}
 	}
 
@@ -118,6 +121,7 @@ ErrCode SrcPin::InitAvaiCaps()
 		return ERR_CODE_INVALID_PARAM;
 	}
 
+	m_avai_packed = PackCaps(m_avai_caps);
 	m_prep_caps = m_avai_caps;
 
 	LOG_DBG("{} init avaliable caps:{}", this->ToStr(), PinCapsToStr(m_avai_caps));
@@ -254,6 +258,7 @@ ErrCode SrcPin::Negotiate()
 			
 		if (result) {
 			m_nego_cap = prep_cap;
+			m_nego_packed = PackCap(prep_cap);
 			m_negotiated = true;
 			break;
 		}
@@ -289,6 +294,14 @@ std::vector<std::string> SrcPin::AvaiCaps()
 	return m_avai_caps;
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+PackedCaps SrcPin::PackedAvaiCaps()
+{
+	return m_avai_packed;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -302,6 +315,7 @@ ErrCode SrcPin::UpdateAvaiCaps(const PinCaps& caps)
 	}
 
 	m_avai_caps = caps;
+	m_avai_packed = PackCaps(caps);
 
 	std::lock_guard<std::mutex> lock(m_mutex);
 
@@ -311,7 +325,8 @@ ErrCode SrcPin::UpdateAvaiCaps(const PinCaps& caps)
 	}
 
 	// Use prepared caps
-	PinCaps prep_caps = MakePreparedCaps(caps, m_sink_pins);
+	PinCaps prep_caps = MakePreparedCaps(m_avai_caps, m_avai_packed, 
+		m_sink_pins);
 	if (prep_caps.empty()) {
 		LOG_ERR("[{}] Empty prepared caps", this->ToStr());
 		return ERR_CODE_FAILED;
@@ -349,12 +364,23 @@ ErrCode SrcPin::OnPinData(const PinData& data)
 	}
 
 	bool has_error = false;
+	LinkListSP links;
 
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
 		for (auto item : m_sink_pins) {
-			ErrCode result = item->OnPinData(data);
-			if (result != ERR_CODE_OK) {
+			if (m_links.find(item) == m_links.end()
+				&& item->OnPinData(data) != ERR_CODE_OK) {
+				has_error = true;
+			}
+		}
+		links = m_link_list;
+	}
+
+	// Pushing may block, a link removed meanwhile is closed and refuses data
+	if (links) {
+		for (const auto& link : *links) {
+			if (link->OnPinData(data) != ERR_CODE_OK) {
 				has_error = true;
 			}
 		}
@@ -428,6 +454,14 @@ bool SrcPin::Negotiated()
 // 
 //------------------------------------------------------------------------------
 ErrCode SrcPin::AddSinkPin(ISinkPin* sink_pin)
+{
+	return AddSinkPin(sink_pin, LinkParam());
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ErrCode SrcPin::AddSinkPin(ISinkPin* sink_pin, const LinkParam& param)
 {
 	if (!sink_pin) {
 		LOG_INF("[{}] Invalid sink pin!", this->ToStr());
@@ -459,10 +493,10 @@ ErrCode SrcPin::AddSinkPin(ISinkPin* sink_pin)
 
 		// SrcPin 已经协商过，不再重复协商，SrcPin 直接设置 SinkPin 的能力
 		if (m_negotiated) {
-			std::vector<std::string> caps{ m_nego_cap };
 			std::list<ISinkPin*> sink_pins{ sink_pin };
 
-			PinCaps prep_caps = MakePreparedCaps(caps, sink_pins);
+			PinCaps prep_caps = MakePreparedCaps(PinCaps{ m_nego_cap },
+				PackedCaps{ m_nego_packed }, sink_pins);
 			if (prep_caps.empty()) {
 				LOG_ERR("Make prepared caps failed!");
 				return ERR_CODE_FAILED;
@@ -485,7 +519,8 @@ ErrCode SrcPin::AddSinkPin(ISinkPin* sink_pin)
 			sink_pins.push_back(sink_pin);
 
 			// 看是否可以找到公共能力集
-			PinCaps prep_caps = MakePreparedCaps(m_avai_caps, sink_pins);
+			PinCaps prep_caps = MakePreparedCaps(m_avai_caps, m_avai_packed,
+				sink_pins);
 
 			// 如果找不到公共能力集，则打印相关信息并返回失败
 			if (prep_caps.empty()) {
@@ -521,6 +556,11 @@ ErrCode SrcPin::AddSinkPin(ISinkPin* sink_pin)
 		// 加入新的 SinkPin
 		m_sink_pins.push_back(sink_pin);
 
+		if (param.mode == LinkMode::QUEUED) {
+			m_links[sink_pin] = PinLink::Create(sink_pin, param);
+			UpdateLinkList();
+		}
+
 		// 设置 SrcPin
 		sink_pin->SetSrcPin(this);
 	}
@@ -542,10 +582,24 @@ ErrCode SrcPin::AddSinkPin(ISinkPin* sink_pin)
 //------------------------------------------------------------------------------
 ErrCode SrcPin::RemoveSinkPin(CSTREF pin_name)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
+	PinLinkSP link;
+	bool found = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (auto iter = m_sink_pins.begin(); iter != m_sink_pins.end(); ++iter) {
+			if ((*iter)->Name() != pin_name) {
+				continue;
+			}
+
+			auto link_iter = m_links.find(*iter);
+			if (link_iter != m_links.end()) {
+				link = link_iter->second;
+				m_links.erase(link_iter);
+				UpdateLinkList();
+			}
 
-	for (auto iter = m_sink_pins.begin(); iter != m_sink_pins.end(); ++iter) {
-		if ((*iter)->Name() == pin_name) {
 			m_sink_pins.erase(iter);
 			if (m_handler) {
 				m_handler->OnSrcPinConnectState(this, false);
@@ -554,14 +608,35 @@ ErrCode SrcPin::RemoveSinkPin(CSTREF pin_name)
 			if (m_sink_pins.empty()) {
 				m_negotiated = false;
 				m_nego_cap = "";
+				m_nego_packed = INVALID_PACKED_CAP;
 				m_handler->OnSrcPinNegotiated(this, "");
 			}
 
-			return ERR_CODE_OK;
+			found = true;
+			break;
 		}
 	}
 
-	return ERR_CODE_FAILED;
+	// Waits for the running delivery, which may call into this pin. Pushing
+	// threads may still hold the link, it refuses data once closed.
+	if (link) {
+		link->Close();
+	}
+
+	return found ? ERR_CODE_OK : ERR_CODE_FAILED;
+}
+
+//------------------------------------------------------------------------------
+// Called with lock held
+//------------------------------------------------------------------------------
+void SrcPin::UpdateLinkList()
+{
+	auto links = std::make_shared<std::vector<PinLinkSP>>();
+	for (const auto& item : m_links) {
+		links->push_back(item.second);
+	}
+
+	m_link_list = links;
 }
 
 //------------------------------------------------------------------------------
@@ -580,6 +655,24 @@ ISinkPin* SrcPin::SinkPin(CSTREF pin_name)
 	return nullptr;
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ErrCode SrcPin::GetLinkStats(CSTREF pin_name, LinkStats& stats)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto item : m_sink_pins) {
+		if (item->Name() == pin_name) {
+			auto iter = m_links.find(item);
+			stats = (iter == m_links.end()) ? LinkStats() : iter->second->Stats();
+			return ERR_CODE_OK;
+		}
+	}
+
+	return ERR_CODE_FAILED;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -1,13 +1,16 @@
 ﻿#pragma once
 
 #include <list>
+#include <map>
 #include <mutex>
+#include <vector>
 
 #include "proxy-unknown.h"
 #include "com-obj-tracer.h"
 #include "common-struct.h"
 #include "if-pin.h"
 #include "if-element.h"
+#include "pin-link.h"
 
 #include "public/media-enum.h"
 
@@ -42,6 +45,7 @@ public:
 	virtual IElement* Element() override;
 	virtual PinCaps PrepCaps() override;
 	virtual PinCaps AvaiCaps() override;
+	virtual PackedCaps PackedAvaiCaps() override;
 	virtual com::ErrCode OnPinData(const PinData& data) override;
 	virtual com::ErrCode OnPinMsg(IPin* pin, const PinMsg& msg) override;
 
@@ -49,14 +53,19 @@ public:
 	virtual com::ErrCode Init(media::MediaType media_type, IElement* element,
 		CSTREF pin_name, CSTREF caps, ISrcPinHandler* handler) override;
 	virtual com::ErrCode AddSinkPin(ISinkPin* sink_pin) override;
+	virtual com::ErrCode AddSinkPin(ISinkPin* sink_pin,
+		const LinkParam& param) override;
 	virtual com::ErrCode RemoveSinkPin(CSTREF pin_name) override;
 	virtual ISinkPin* SinkPin(CSTREF pin_name) override;
 	virtual std::list<ISinkPin*> SinkPins() override;
 	virtual com::ErrCode Negotiate() override;
 	virtual com::ErrCode UpdateAvaiCaps(const PinCaps& caps) override;
+	virtual com::ErrCode GetLinkStats(CSTREF pin_name,
+		LinkStats& stats) override;
 
 private:
 	com::ErrCode SendMsgToSinkPins(const PinMsg& msg);
+	void UpdateLinkList();
 	com::ErrCode InitAvaiCaps();
 
 private:
@@ -69,6 +78,13 @@ private:
 	std::mutex m_mutex;
 	std::list<ISinkPin*> m_sink_pins;
 
+	// Sink pins linked in queued mode
+	std::map<ISinkPin*, PinLinkSP> m_links;
+
+	// Copy of links, rebuilt on change, so data is pushed out of lock
+	typedef std::shared_ptr<const std::vector<PinLinkSP>> LinkListSP;
+	LinkListSP m_link_list;
+
 	IElement* m_element = nullptr;
 
 	// 初始能力集（initialized capabilities）
@@ -78,10 +94,12 @@ private:
 
 	// 最终协商的能力（negotiated capability）
 	std::string m_nego_cap;
+	PackedCap m_nego_packed = 0;
 
 	// 可用能力集（available capabilities）
 	// 当 sink pin 协商完成时，element 会更新 src pin 的可用能力集
 	PinCaps m_avai_caps;
+	PackedCaps m_avai_packed; // packed m_avai_caps, used for negotiation
 
 	// 备用能力集（prepared capabilities）
 	// 可被选为最终协商结果的能力集
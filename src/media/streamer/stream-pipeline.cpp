@@ -12,7 +12,6 @@
 #include "common/util-common.h"
 #include "log.h"
 
-using namespace std::placeholders;
 using namespace jukey::com;
 
 namespace jukey::stmr
@@ -24,9 +23,9 @@ namespace jukey::stmr
 StreamPipeline::StreamPipeline(base::IComFactory* factory, const char* owner)
 	: ProxyUnknown(nullptr)
   , ComObjTracer(factory, CID_PIPELINE, owner)
-	, CommonThread(std::string("pipeline-").append(owner), true)
 	, m_factory(factory)
 	, m_sync_mgr(SyncManager::Instance())
+	, m_scheduler(StreamScheduler::Instance())
 {
 }
 
@@ -39,12 +38,8 @@ StreamPipeline::~StreamPipeline()
 
 	Stop();
 
-	m_msg_bus.UnsubscribeMsg(PlMsgType::ADD_ELEMENT_STREAM, this);
-	m_msg_bus.UnsubscribeMsg(PlMsgType::DEL_ELEMENT_STREAM, this);
-
-	m_msg_bus.Stop();
-
-	StopThread();
+	m_scheduler->DestroyStrand(m_msg_strand);
+	m_scheduler->DestroyStrand(m_strand);
 
 	for (auto item : m_elements) {
 		item.second->Release();
@@ -80,11 +75,28 @@ void* StreamPipeline::NDQueryInterface(const char* riid)
 }
 
 //------------------------------------------------------------------------------
-// Pipeline aware message handle in pipeline thread
+// Pipeline aware message is handled in pipeline strand
 //------------------------------------------------------------------------------
-void StreamPipeline::HandleMsgBusMsg(const CommonMsg& msg)
+void StreamPipeline::DispatchPlMsg(const CommonMsg& msg)
 {
-	PostMsg(msg);
+	if (msg.msg_type == PlMsgType::ADD_ELEMENT_STREAM
+		|| msg.msg_type == PlMsgType::DEL_ELEMENT_STREAM) {
+		m_scheduler->Post(m_strand, [this, msg]() { OnPipelineMsg(msg); });
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(m_handler_mutex);
+
+	auto iter = m_msg_handlers.find(msg.msg_type);
+	if (iter == m_msg_handlers.end()) {
+		return;
+	}
+
+	// Handler may subscribe or unsubscribe in dispatching
+	std::vector<IPlMsgHandler*> handlers(iter->second.begin(),
+		iter->second.end());
+	for (auto handler : handlers) {
+		handler->OnPipelineMsg(msg);
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -231,7 +243,7 @@ void StreamPipeline::OnRemoveElementStream(const com::CommonMsg& msg)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void StreamPipeline::OnThreadMsg(const com::CommonMsg& msg)
+void StreamPipeline::OnPipelineMsg(const com::CommonMsg& msg)
 {
 	switch (msg.msg_type) {
 	case ADD_ELEMENT_STREAM:
@@ -289,14 +301,8 @@ ErrCode StreamPipeline::Init(CSTREF pipeline_name)
 {
 	m_pipeline_name = pipeline_name + std::to_string((uint64_t)this);
 
-	StartThread();
-
-	m_msg_bus.Start();
-
-	m_msg_bus.SubscribeMsg(PlMsgType::ADD_ELEMENT_STREAM,
-		std::bind(&StreamPipeline::HandleMsgBusMsg, this, _1), this);
-	m_msg_bus.SubscribeMsg(PlMsgType::DEL_ELEMENT_STREAM,
-		std::bind(&StreamPipeline::HandleMsgBusMsg, this, _1), this);
+	m_strand = m_scheduler->CreateStrand(m_pipeline_name);
+	m_msg_strand = m_scheduler->CreateStrand(m_pipeline_name + "-msg");
 
 	m_state = PipelineState::PIPELINE_STATE_INITED;
 
@@ -321,6 +327,14 @@ std::string StreamPipeline::Name()
 	return m_pipeline_name;
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+IStreamScheduler& StreamPipeline::GetScheduler()
+{
+	return *m_scheduler;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -328,7 +342,8 @@ ErrCode StreamPipeline::Start()
 {
 	LOG_INF("[{}] Start", m_pipeline_name);
 
-	return this->ExecuteSync([this](util::CallParam) -> com::ErrCode {
+	return ExecuteInStrand<ErrCode>(*m_scheduler, m_strand,
+		[this]() -> ErrCode {
 		if (m_state == PipelineState::PIPELINE_STATE_RUNNING) {
 			LOG_ERR("Pipeline is already running!");
 			return ERR_CODE_OK;
@@ -347,7 +362,7 @@ ErrCode StreamPipeline::Start()
 		DumpPipeline();
 
 		return ERR_CODE_OK;
-	}, nullptr);	
+	}, ERR_CODE_FAILED);
 }
 
 //------------------------------------------------------------------------------
@@ -357,7 +372,8 @@ ErrCode StreamPipeline::Pause()
 {
 	LOG_INF("[{}] Pause", m_pipeline_name);
 
-	return this->ExecuteSync([this](util::CallParam) -> com::ErrCode {
+	return ExecuteInStrand<ErrCode>(*m_scheduler, m_strand,
+		[this]() -> ErrCode {
 		if (m_state == PipelineState::PIPELINE_STATE_PAUSED) {
 			LOG_ERR("Pipeline is already paused!");
 			return ERR_CODE_OK;
@@ -374,7 +390,7 @@ ErrCode StreamPipeline::Pause()
 		}
 
 		return ERR_CODE_OK;
-	}, nullptr);
+	}, ERR_CODE_FAILED);
 }
 
 //------------------------------------------------------------------------------
@@ -384,7 +400,8 @@ ErrCode StreamPipeline::Resume()
 {
 	LOG_INF("[{}] Resume", m_pipeline_name);
 
-	return this->ExecuteSync([this](util::CallParam) -> com::ErrCode {
+	return ExecuteInStrand<ErrCode>(*m_scheduler, m_strand,
+		[this]() -> ErrCode {
 		if (m_state == PipelineState::PIPELINE_STATE_RUNNING) {
 			LOG_ERR("Pipeline is already running!");
 			return ERR_CODE_OK;
@@ -403,7 +420,7 @@ ErrCode StreamPipeline::Resume()
 		DumpPipeline();
 
 		return ERR_CODE_OK;
-	}, nullptr);
+	}, ERR_CODE_FAILED);
 }
 
 //------------------------------------------------------------------------------
@@ -413,7 +430,8 @@ ErrCode StreamPipeline::Stop()
 {
 	LOG_INF("[{}] Stop", m_pipeline_name);
 
-	return this->ExecuteSync([this](util::CallParam) -> com::ErrCode {
+	return ExecuteInStrand<ErrCode>(*m_scheduler, m_strand,
+		[this]() -> ErrCode {
 		if (m_state == PipelineState::PIPELINE_STATE_STOPED)
 			return ERR_CODE_OK;
 
@@ -423,7 +441,7 @@ ErrCode StreamPipeline::Stop()
 		}
 
 		return ERR_CODE_OK;
-	}, nullptr);
+	}, ERR_CODE_FAILED);
 }
 
 //------------------------------------------------------------------------------
@@ -441,7 +459,8 @@ IElement* StreamPipeline::AddElement(CSTREF cid, com::IProperty* props)
 {
 	LOG_INF("[{}] Add element, cid:{}", m_pipeline_name, cid);
 
-	void* ele = this->ExecuteSync([this, cid, props](util::CallParam) -> void* {
+	return ExecuteInStrand<IElement*>(*m_scheduler, m_strand,
+		[this, cid, props]() -> IElement* {
 		// Only can add element on INITED and PAUSED states
 		if (m_state != PipelineState::PIPELINE_STATE_INITED &&
 			m_state != PipelineState::PIPELINE_STATE_PAUSED) {
@@ -473,8 +492,6 @@ IElement* StreamPipeline::AddElement(CSTREF cid, com::IProperty* props)
 
 		return ele;
 	}, nullptr);
-
-	return (IElement*)ele;
 }
 
 //------------------------------------------------------------------------------
@@ -482,7 +499,8 @@ IElement* StreamPipeline::AddElement(CSTREF cid, com::IProperty* props)
 //------------------------------------------------------------------------------
 IElement* StreamPipeline::GetElementByName(CSTREF name)
 {
-	void* ele = this->ExecuteSync([this, name](util::CallParam) -> void* {
+	return ExecuteInStrand<IElement*>(*m_scheduler, m_strand,
+		[this, name]() -> IElement* {
 		auto iter = m_elements.find(name);
 		if (iter == m_elements.end()) {
 			LOG_ERR("Cannot find element:{} in pipeline:{}", name, m_pipeline_name);
@@ -492,8 +510,6 @@ IElement* StreamPipeline::GetElementByName(CSTREF name)
 			return iter->second;
 		}
 	}, nullptr);
-
-	return (IElement*)ele;
 }
 
 //------------------------------------------------------------------------------
@@ -501,7 +517,8 @@ IElement* StreamPipeline::GetElementByName(CSTREF name)
 //------------------------------------------------------------------------------
 ErrCode StreamPipeline::RemoveElement(CSTREF name)
 {
-	return this->ExecuteSync([this, name](util::CallParam) -> com::ErrCode {
+	return ExecuteInStrand<ErrCode>(*m_scheduler, m_strand,
+		[this, name]() -> ErrCode {
 		size_t count = m_elements.erase(name);
 		if (count == 0) {
 			LOG_ERR("Element does not exist!");
@@ -510,7 +527,7 @@ ErrCode StreamPipeline::RemoveElement(CSTREF name)
 		else {
 			return ERR_CODE_OK;
 		}
-	}, nullptr);
+	}, ERR_CODE_FAILED);
 }
 
 //------------------------------------------------------------------------------
@@ -518,21 +535,37 @@ ErrCode StreamPipeline::RemoveElement(CSTREF name)
 //------------------------------------------------------------------------------
 void StreamPipeline::PostPlMsg(const com::CommonMsg& msg)
 {
-	m_msg_bus.PublishMsg(msg);
+	m_scheduler->Post(m_msg_strand, [this, msg]() { DispatchPlMsg(msg); });
 }
 
 //------------------------------------------------------------------------------
-// TODO: be care of dead lock!!!
+// Dispatched directly if sent by a handler, or it would wait for itself
 //------------------------------------------------------------------------------
 com::ErrCode StreamPipeline::SendPlMsg(const com::CommonMsg& msg)
 {
 	com::CommonMsg& ref = const_cast<com::CommonMsg&>(msg);
 
 	ref.result.reset(new std::promise<com::ErrCode>());
-	
-	m_msg_bus.PublishMsg(ref);
+	std::future<com::ErrCode> result = ref.result->get_future();
 
-	return ref.result->get_future().get();
+	if (m_scheduler->InStrand(m_msg_strand)) {
+		DispatchPlMsg(ref);
+	}
+	else if (!m_scheduler->Post(m_msg_strand,
+		[this, ref]() { DispatchPlMsg(ref); })) {
+		LOG_ERR("Post pipeline message:{} failed!", msg.msg_type);
+		ref.result.reset();
+		return ERR_CODE_FAILED;
+	}
+	ref.result.reset(); // broken if dropped or no handler answers
+
+	try {
+		return WaitSchedResult(*m_scheduler, result);
+	}
+	catch (const std::future_error&) {
+		LOG_WRN("Pipeline message:{} is not answered", msg.msg_type);
+		return ERR_CODE_FAILED;
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -545,8 +578,8 @@ ErrCode StreamPipeline::SubscribeMsg(uint32_t msg_type, IPlMsgHandler* handler)
 		return ERR_CODE_INVALID_PARAM;
 	}
 	
-	m_msg_bus.SubscribeMsg(msg_type, 
-		std::bind(&IPlMsgHandler::OnPipelineMsg, handler, _1), handler);
+	std::lock_guard<std::recursive_mutex> lock(m_handler_mutex);
+	m_msg_handlers[msg_type].insert(handler);
 
 	return com::ERR_CODE_OK;
 }
@@ -561,7 +594,12 @@ ErrCode StreamPipeline::UnsubscribeMsg(uint32_t msg_type, IPlMsgHandler* handler
 		return ERR_CODE_INVALID_PARAM;
 	}
 
-	m_msg_bus.UnsubscribeMsg(msg_type, handler);
+	std::lock_guard<std::recursive_mutex> lock(m_handler_mutex);
+
+	auto iter = m_msg_handlers.find(msg_type);
+	if (iter != m_msg_handlers.end()) {
+		iter->second.erase(handler);
+	}
 
 	return com::ERR_CODE_OK;
 }
@@ -570,6 +608,15 @@ ErrCode StreamPipeline::UnsubscribeMsg(uint32_t msg_type, IPlMsgHandler* handler
 // 
 //------------------------------------------------------------------------------
 ErrCode StreamPipeline::LinkElement(ISrcPin* src_pin, ISinkPin* sink_pin)
+{
+	return LinkElement(src_pin, sink_pin, LinkParam());
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ErrCode StreamPipeline::LinkElement(ISrcPin* src_pin, ISinkPin* sink_pin,
+	const LinkParam& param)
 {
 	if (!src_pin) {
 		LOG_ERR("Invalid src pin!");
@@ -581,10 +628,11 @@ ErrCode StreamPipeline::LinkElement(ISrcPin* src_pin, ISinkPin* sink_pin)
 		return ERR_CODE_INVALID_PARAM;
 	}
 
-	LOG_INF("Link element, src pin:{}, sink pin:{}", src_pin->ToStr(),
-		sink_pin->ToStr());
+	LOG_INF("Link element, src pin:{}, sink pin:{}, mode:{}", src_pin->ToStr(),
+		sink_pin->ToStr(), param.mode);
 
-	return this->ExecuteSync([this, src_pin, sink_pin](util::CallParam) -> com::ErrCode {
+	return ExecuteInStrand<ErrCode>(*m_scheduler, m_strand,
+		[this, src_pin, sink_pin, param]() -> ErrCode {
 		// Only can link element on INITED and PAUSED states
 		if (m_state != PipelineState::PIPELINE_STATE_INITED
 			&& m_state != PipelineState::PIPELINE_STATE_PAUSED) {
@@ -592,13 +640,13 @@ ErrCode StreamPipeline::LinkElement(ISrcPin* src_pin, ISinkPin* sink_pin)
 			return ERR_CODE_FAILED;
 		}
 
-		if (ERR_CODE_OK != src_pin->AddSinkPin(sink_pin)) {
+		if (ERR_CODE_OK != src_pin->AddSinkPin(sink_pin, param)) {
 			LOG_ERR("Add sink pin failed, sink pin:{}", sink_pin->ToStr());
 			return ERR_CODE_FAILED;
 		}
 
 		return ERR_CODE_OK;
-	}, nullptr);
+	}, ERR_CODE_FAILED);
 }
 
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <vector>
 #include <mutex>
 #include <map>
+#include <set>
 
 #include "proxy-unknown.h"
 #include "com-obj-tracer.h"
@@ -10,9 +11,7 @@
 #include "if-sync-mgr.h"
 #include "if-element.h"
 #include "if-pin.h"
-#include "msg-bus/thread-msg-bus.h"
-#include "msg-bus/common-msg-bus.h"
-#include "thread/common-thread.h"
+#include "stream-scheduler.h"
 #include "element-assembler.h"
 #include "pipeline-msg.h"
 
@@ -25,7 +24,6 @@ namespace jukey::stmr
 class StreamPipeline 
 	: public base::ProxyUnknown
 	, public base::ComObjTracer
-	, public util::CommonThread
 	, public IPipeline
 {
 public:
@@ -54,17 +52,18 @@ public:
 		IPlMsgHandler* handler) override;
 	virtual com::ErrCode LinkElement(ISrcPin* src_pin,
 		ISinkPin* sink_pin) override;
+	virtual com::ErrCode LinkElement(ISrcPin* src_pin, ISinkPin* sink_pin,
+		const LinkParam& param) override;
 	virtual IElement* GetElementByName(CSTREF name) override;
-
-	// CommonThread
-	virtual void OnThreadMsg(const com::CommonMsg& msg) override;
+	virtual IStreamScheduler& GetScheduler() override;
 
 	void DumpPipeline();
 
 private:
 	void OnAddElementStream(const com::CommonMsg& msg);
 	void OnRemoveElementStream(const com::CommonMsg& msg);
-	void HandleMsgBusMsg(const com::CommonMsg& msg);
+	void OnPipelineMsg(const com::CommonMsg& msg);
+	void DispatchPlMsg(const com::CommonMsg& msg);
 
 	bool HasSrcElement();
 	bool DoStartElements();
@@ -80,9 +79,16 @@ private:
 	// Audio and video synchrolization
 	ISyncMgr& m_sync_mgr;
 
-	//util::ThreadMsgBus m_msg_bus;
-	util::CommonMsgBus m_msg_bus;
-	
+	StreamSchedulerSP m_scheduler;
+
+	// Pipeline control runs in m_strand, messages are dispatched in m_msg_strand
+	StrandId m_strand = INVALID_STRAND_ID;
+	StrandId m_msg_strand = INVALID_STRAND_ID;
+
+	// Held while dispatching, handler may send message in dispatching
+	std::map<uint32_t, std::set<IPlMsgHandler*>> m_msg_handlers;
+	std::recursive_mutex m_handler_mutex;
+
 	PipelineState m_state = PipelineState::PIPELINE_STATE_INVALID;
 
 	// key: element name
@@ -0,0 +1,722 @@
+#include "stream-scheduler.h"
+#include "common-config.h"
+#include "common/util-time.h"
+#include "log.h"
+
+#include <algorithm>
+
+
+namespace jukey::stmr
+{
+
+// Worker and strand running in current thread
+static thread_local StreamScheduler* t_scheduler = nullptr;
+static thread_local uint32_t t_worker_index = 0;
+static thread_local StrandId t_strand = INVALID_STRAND_ID;
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+StreamScheduler::StreamScheduler(uint32_t thread_count)
+{
+	for (uint32_t i = 0; i < thread_count; i++) {
+		m_workers.push_back(std::make_unique<Worker>());
+		m_workers.back()->index = i;
+	}
+
+	for (auto& worker : m_workers) {
+		worker->thread = std::thread(&StreamScheduler::WorkerProc, this,
+			worker.get());
+	}
+
+	m_release_strand = CreateStrand("release");
+
+	LOG_INF("Create stream scheduler, thread count:{}", thread_count);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+StreamScheduler::~StreamScheduler()
+{
+	// Released objects hold the scheduler, so no release task is pending
+	DestroyStrand(m_release_strand);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	m_spare_cv.notify_all();
+	m_wait_cv.notify_all();
+
+	// Never destructed in worker, see Instance()
+	for (auto& worker : m_workers) {
+		if (worker->thread.joinable()) {
+			worker->thread.join();
+		}
+	}
+
+	// No spare thread is created after stop
+	std::vector<std::thread> spare_threads;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		spare_threads.swap(m_spare_threads);
+	}
+	for (auto& thread : spare_threads) {
+		thread.join();
+	}
+
+	LOG_INF("Destroy stream scheduler, remain strands:{}", m_strands.size());
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+StreamSchedulerSP StreamScheduler::Instance()
+{
+	static std::mutex s_mutex;
+	static std::weak_ptr<StreamScheduler> s_scheduler;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	StreamSchedulerSP scheduler = s_scheduler.lock();
+	if (!scheduler) {
+		uint32_t thread_count = std::thread::hardware_concurrency();
+		thread_count = std::max(2u, std::min(thread_count,
+			(uint32_t)STREAM_SCHEDULER_MAX_THREAD_COUNT));
+
+		// The last reference may be released in a task, the worker still runs
+		// after the task returns, so destruct in another thread
+		scheduler.reset(new StreamScheduler(thread_count),
+			[](StreamScheduler* p) {
+				if (p->InWorker()) {
+					std::thread([p]() { delete p; }).detach();
+				}
+				else {
+					delete p;
+				}
+			});
+		s_scheduler = scheduler;
+	}
+
+	return scheduler;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+uint32_t StreamScheduler::ThreadCount()
+{
+	return (uint32_t)m_workers.size();
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+StrandId StreamScheduler::CreateStrand(const std::string& name)
+{
+	StrandSP strand = std::make_shared<Strand>();
+	strand->name = name;
+
+	std::unique_lock<std::shared_mutex> lock(m_strand_mutex);
+
+	do {
+		if (++m_next_strand_id == INVALID_STRAND_ID) {
+			++m_next_strand_id;
+		}
+	} while (m_strands.find(m_next_strand_id) != m_strands.end());
+
+	strand->id = m_next_strand_id;
+	m_strands.insert(std::make_pair(strand->id, strand));
+
+	LOG_DBG("Create strand:{}, name:{}", strand->id, name);
+
+	return strand->id;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void StreamScheduler::DestroyStrand(StrandId strand_id)
+{
+	StrandSP strand;
+	{
+		std::unique_lock<std::shared_mutex> lock(m_strand_mutex);
+		auto iter = m_strands.find(strand_id);
+		if (iter == m_strands.end()) {
+			return;
+		}
+		strand = iter->second;
+		m_strands.erase(iter);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_processes.Remove(strand_id);
+		UpdateNextDue();
+	}
+
+	// The blocked task may wait for what the caller has done, wake it before
+	// waiting for the strand
+	if (m_waiting_count.load() > 0) {
+		NotifyWaiters();
+	}
+
+	// Tasks are released out of lock, they may own anything
+	std::deque<SchedTask> tasks;
+	SchedProcess process;
+
+	std::unique_lock<std::mutex> lock(strand->mutex);
+
+	strand->destroyed = true;
+	strand->tasks.swap(tasks);
+	strand->process.swap(process);
+	strand->process_due = false;
+
+	// Destroyed by its own task, RunStrand stops after the task returns. Tasks
+	// never run nested, so a running strand in another stack frame of this
+	// thread is impossible.
+	if (t_strand != strand_id) {
+		strand->idle_cv.wait(lock, [&strand]() { return !strand->running; });
+	}
+
+	LOG_DBG("Destroy strand:{}, name:{}", strand_id, strand->name);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+StreamScheduler::StrandSP StreamScheduler::FindStrand(StrandId strand_id)
+{
+	std::shared_lock<std::shared_mutex> lock(m_strand_mutex);
+
+	auto iter = m_strands.find(strand_id);
+	return iter == m_strands.end() ? nullptr : iter->second;
+}
+
+//------------------------------------------------------------------------------
+// Queue on current worker for cache locality, idle workers will steal it
+//------------------------------------------------------------------------------
+void StreamScheduler::Schedule(const StrandSP& strand)
+{
+	Worker* worker = nullptr;
+	if (t_scheduler == this) {
+		worker = m_workers[t_worker_index].get();
+	}
+	else {
+		worker = m_workers[m_next_worker++ % m_workers.size()].get();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		worker->strands.push_back(strand);
+	}
+
+	// Pair with the idle check of workers
+	m_queued_count.fetch_add(1);
+	if (m_idle_count.load() > 0) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cv.notify_one();
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool StreamScheduler::Post(StrandId strand_id, const SchedTask& task)
+{
+	StrandSP strand = FindStrand(strand_id);
+	if (!strand) {
+		LOG_DBG("Post task to invalid strand:{}", strand_id);
+		return false;
+	}
+
+	bool schedule = false;
+	{
+		std::lock_guard<std::mutex> lock(strand->mutex);
+		if (strand->destroyed) {
+			return false;
+		}
+
+		strand->tasks.push_back(task);
+
+		// Running strand is queued again after the running batch
+		if (!strand->queued && !strand->running) {
+			strand->queued = true;
+			schedule = true;
+		}
+	}
+
+	if (schedule) {
+		Schedule(strand);
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Not the strand of caller, so the task may wait for it
+//------------------------------------------------------------------------------
+bool StreamScheduler::PostRelease(const SchedTask& task)
+{
+	return Post(m_release_strand, task);
+}
+
+//------------------------------------------------------------------------------
+// Called with lock held
+//------------------------------------------------------------------------------
+void StreamScheduler::UpdateNextDue()
+{
+	m_next_due = m_processes.Empty() ? UINT64_MAX : m_processes.TopKey();
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool StreamScheduler::SetProcess(StrandId strand_id,
+	const SchedProcess& process, uint32_t delay_ms)
+{
+	StrandSP strand = FindStrand(strand_id);
+	if (!strand) {
+		LOG_ERR("Set process of invalid strand:{}", strand_id);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	{
+		std::lock_guard<std::mutex> strand_lock(strand->mutex);
+		if (strand->destroyed) {
+			return false;
+		}
+
+		strand->process = process;
+		strand->process_due = false;
+		++strand->process_gen;
+	}
+
+	m_processes.Remove(strand_id);
+	m_processes.Push(strand_id, util::Now() + delay_ms * 1000ULL, strand);
+	UpdateNextDue();
+
+	// Due time of waiting worker may be later
+	m_cv.notify_one();
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void StreamScheduler::ClearProcess(StrandId strand_id)
+{
+	StrandSP strand = FindStrand(strand_id);
+	if (!strand) {
+		return;
+	}
+
+	SchedProcess process;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	{
+		std::lock_guard<std::mutex> strand_lock(strand->mutex);
+		strand->process.swap(process);
+		strand->process_due = false;
+		++strand->process_gen;
+	}
+
+	m_processes.Remove(strand_id);
+	UpdateNextDue();
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool StreamScheduler::InStrand(StrandId strand_id)
+{
+	return strand_id != INVALID_STRAND_ID && t_strand == strand_id;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool StreamScheduler::InWorker()
+{
+	return t_scheduler == this;
+}
+
+//------------------------------------------------------------------------------
+// Own queue first, then steal from the others
+//------------------------------------------------------------------------------
+StreamScheduler::StrandSP StreamScheduler::TakeStrand(Worker* worker)
+{
+	StrandSP strand;
+
+	for (uint32_t i = 0; i < m_workers.size() && !strand; i++) {
+		Worker* w = m_workers[(worker->index + i) % m_workers.size()].get();
+
+		std::lock_guard<std::mutex> lock(w->mutex);
+		if (w->strands.empty()) {
+			continue;
+		}
+
+		if (w == worker) {
+			strand = std::move(w->strands.front());
+			w->strands.pop_front();
+		}
+		else {
+			strand = std::move(w->strands.back());
+			w->strands.pop_back();
+		}
+	}
+
+	if (strand) {
+		m_queued_count.fetch_sub(1);
+	}
+
+	return strand;
+}
+
+//------------------------------------------------------------------------------
+// Strand is queued again if it has more work after this batch
+//------------------------------------------------------------------------------
+void StreamScheduler::RunStrand(const StrandSP& strand)
+{
+	SchedTask batch[kMaxBatchTasks];
+	uint32_t batch_size = 0;
+	SchedProcess process;
+	uint32_t process_gen = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(strand->mutex);
+
+		strand->queued = false;
+		if (strand->destroyed) {
+			return;
+		}
+
+		strand->running = true;
+
+		while (!strand->tasks.empty() && batch_size < kMaxBatchTasks) {
+			batch[batch_size++] = std::move(strand->tasks.front());
+			strand->tasks.pop_front();
+		}
+
+		if (strand->process_due) {
+			strand->process_due = false;
+			process = strand->process;
+			process_gen = strand->process_gen;
+		}
+	}
+
+	t_strand = strand->id;
+
+	for (uint32_t i = 0; i < batch_size && !strand->destroyed; i++) {
+		batch[i]();
+	}
+
+	if (process && !strand->destroyed) {
+		uint32_t interval_ms = process();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::lock_guard<std::mutex> strand_lock(strand->mutex);
+
+		// Not changed while running
+		if (!strand->destroyed && strand->process_gen == process_gen) {
+			m_processes.Push(strand->id, util::Now() + interval_ms * 1000ULL,
+				strand);
+			UpdateNextDue();
+		}
+	}
+
+	t_strand = INVALID_STRAND_ID;
+
+	bool schedule = false;
+	{
+		std::lock_guard<std::mutex> lock(strand->mutex);
+
+		strand->running = false;
+
+		if (!strand->destroyed && (!strand->tasks.empty() || strand->process_due)) {
+			strand->queued = true;
+			schedule = true;
+		}
+	}
+	strand->idle_cv.notify_all();
+
+	if (schedule) {
+		Schedule(strand);
+	}
+
+	// Waited task may be done
+	if (m_waiting_count.load() > 0) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_run_gen;
+		m_wait_cv.notify_all();
+	}
+}
+
+//------------------------------------------------------------------------------
+// Move due processes to worker queues
+//------------------------------------------------------------------------------
+void StreamScheduler::PollProcesses()
+{
+	std::vector<StrandSP> due_strands;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		uint64_t now = util::Now();
+		while (!m_processes.Empty() && m_processes.TopKey() <= now) {
+			StrandSP strand = m_processes.Top();
+			m_processes.Pop();
+
+			std::lock_guard<std::mutex> strand_lock(strand->mutex);
+			if (strand->destroyed) {
+				continue;
+			}
+
+			strand->process_due = true;
+			if (!strand->queued && !strand->running) {
+				strand->queued = true;
+				due_strands.push_back(strand);
+			}
+		}
+
+		UpdateNextDue();
+	}
+
+	for (const auto& strand : due_strands) {
+		Schedule(strand);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Sleep until work is queued, the next process is due or max_wait_us elapsed,
+// UINT64_MAX means no limit
+//------------------------------------------------------------------------------
+void StreamScheduler::WaitForWork(uint64_t max_wait_us)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	// Pair with the notify check of Schedule
+	m_idle_count.fetch_add(1);
+
+	if (!m_stop && m_queued_count.load() == 0) {
+		uint64_t now = util::Now();
+		uint64_t wake = m_next_due;
+		if (max_wait_us != UINT64_MAX) {
+			wake = std::min(wake, now + max_wait_us);
+		}
+
+		if (wake == UINT64_MAX) {
+			m_cv.wait(lock);
+		}
+		else if (wake > now) {
+			m_cv.wait_for(lock, std::chrono::microseconds(wake - now));
+		}
+	}
+
+	m_idle_count.fetch_sub(1);
+}
+
+//------------------------------------------------------------------------------
+// Called with lock held, the request of a worker returned before a spare
+// thread takes it is ignored
+//------------------------------------------------------------------------------
+void StreamScheduler::RequestSpare(Worker* worker)
+{
+	m_spare_requests.push_back(worker);
+
+	if (m_idle_spare_count > 0) {
+		m_spare_cv.notify_one();
+	}
+	else if (m_spare_threads.size() < STREAM_SCHEDULER_MAX_SPARE_COUNT) {
+		m_spare_threads.emplace_back(&StreamScheduler::SpareProc, this);
+	}
+	else {
+		LOG_WRN("No spare thread for worker:{}, spare threads:{}", worker->index,
+			m_spare_threads.size());
+	}
+}
+
+//------------------------------------------------------------------------------
+// Running other strands here would bury the blocked task under them, and a
+// nested strand waiting for the blocked one would never return. So the thread
+// only blocks, and a spare thread serves its queue if no other thread does.
+//------------------------------------------------------------------------------
+void StreamScheduler::WaitUntil(const std::function<bool()>& done)
+{
+	WaitUntil(done, 0);
+}
+
+//------------------------------------------------------------------------------
+// Woken by strand runs and NotifyWaiters, timeout 0 means no limit
+//------------------------------------------------------------------------------
+bool StreamScheduler::WaitUntil(const std::function<bool()>& done,
+	uint32_t timeout_ms)
+{
+	if (done()) {
+		return true;
+	}
+
+	uint64_t deadline = (timeout_ms == 0) ? UINT64_MAX
+		: util::Now() + timeout_ms * 1000ULL;
+
+	Worker* worker = nullptr;
+	if (t_scheduler == this) {
+		worker = m_workers[t_worker_index].get();
+	}
+	else {
+		LOG_ERR("WaitUntil called out of worker thread!");
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (worker && ++worker->blocked_count == worker->thread_count && !m_stop) {
+		RequestSpare(worker);
+	}
+
+	m_waiting_count.fetch_add(1);
+
+	bool finished = false;
+	while (true) {
+		uint64_t run_gen = m_run_gen;
+
+		lock.unlock();
+		finished = done();
+		lock.lock();
+
+		uint64_t now = util::Now();
+		if (finished || now >= deadline) {
+			break;
+		}
+
+		if (run_gen != m_run_gen) {
+			continue;
+		}
+
+		if (deadline == UINT64_MAX) {
+			m_wait_cv.wait(lock);
+		}
+		else {
+			m_wait_cv.wait_for(lock, std::chrono::microseconds(deadline - now));
+		}
+	}
+
+	m_waiting_count.fetch_sub(1);
+
+	if (worker) {
+		--worker->blocked_count;
+
+		// Spare thread serving the worker is not needed any more
+		m_cv.notify_all();
+	}
+
+	return finished;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void StreamScheduler::NotifyWaiters()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_run_gen;
+	m_wait_cv.notify_all();
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void StreamScheduler::WorkerProc(Worker* worker)
+{
+	t_scheduler = this;
+	t_worker_index = worker->index;
+
+	while (!m_stop) {
+		if (util::Now() >= m_next_due) {
+			PollProcesses();
+		}
+
+		StrandSP strand = TakeStrand(worker);
+		if (strand) {
+			RunStrand(strand);
+		}
+		else {
+			WaitForWork(UINT64_MAX);
+		}
+	}
+
+	t_scheduler = nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Serves the queue of a blocked worker until another thread serves it
+//------------------------------------------------------------------------------
+void StreamScheduler::ServeWorker(Worker* worker)
+{
+	t_worker_index = worker->index;
+
+	LOG_DBG("Spare thread serves worker:{}", worker->index);
+
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_stop || worker->thread_count - worker->blocked_count > 1) {
+				--worker->thread_count;
+				break;
+			}
+		}
+
+		if (util::Now() >= m_next_due) {
+			PollProcesses();
+		}
+
+		StrandSP strand = TakeStrand(worker);
+		if (strand) {
+			RunStrand(strand);
+		}
+		else {
+			WaitForWork(UINT64_MAX);
+		}
+	}
+
+	LOG_DBG("Spare thread leaves worker:{}", worker->index);
+}
+
+//------------------------------------------------------------------------------
+// Takes requests of blocked workers until the scheduler stops
+//------------------------------------------------------------------------------
+void StreamScheduler::SpareProc()
+{
+	t_scheduler = this;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (!m_stop) {
+		if (m_spare_requests.empty()) {
+			++m_idle_spare_count;
+			m_spare_cv.wait(lock);
+			--m_idle_spare_count;
+			continue;
+		}
+
+		Worker* worker = m_spare_requests.front();
+		m_spare_requests.pop_front();
+
+		// Returned from WaitUntil already
+		if (worker->blocked_count < worker->thread_count) {
+			continue;
+		}
+
+		++worker->thread_count;
+
+		lock.unlock();
+		ServeWorker(worker);
+		lock.lock();
+	}
+
+	t_scheduler = nullptr;
+}
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <mutex>
+#include <shared_mutex>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "if-scheduler.h"
+#include "common/indexed-heap.h"
+
+namespace jukey::stmr
+{
+
+//==============================================================================
+// Work-stealing implementation of IStreamScheduler. A strand with pending work
+// is queued on one worker, normally the worker that posted to it. An idle
+// worker takes strands from the back of other workers' queues. A strand runs a
+// batch of tasks each time, then goes back to the end of the queue if it still
+// has tasks, so a busy element cannot hold a worker. Periodic processes are
+// ordered by due time in one heap. A worker blocked in WaitUntil is replaced by
+// a spare thread serving its queue until it returns, strands are never run
+// nested in a blocked task. Spare threads are pooled and limited, a blocked
+// worker waits for a free one if all are busy, meanwhile its queue is stolen by
+// the other workers.
+//==============================================================================
+class StreamScheduler : public IStreamScheduler
+{
+public:
+	StreamScheduler(uint32_t thread_count);
+	~StreamScheduler();
+
+	//
+	// @brief Shared instance, created on first use and destroyed with the last
+	//        reference
+	//
+	static std::shared_ptr<StreamScheduler> Instance();
+
+	// IStreamScheduler
+	virtual StrandId CreateStrand(const std::string& name) override;
+	virtual void DestroyStrand(StrandId strand) override;
+	virtual bool Post(StrandId strand, const SchedTask& task) override;
+	virtual bool PostRelease(const SchedTask& task) override;
+	virtual bool SetProcess(StrandId strand, const SchedProcess& process,
+		uint32_t delay_ms) override;
+	virtual void ClearProcess(StrandId strand) override;
+	virtual bool InStrand(StrandId strand) override;
+	virtual bool InWorker() override;
+	virtual void WaitUntil(const std::function<bool()>& done) override;
+	virtual bool WaitUntil(const std::function<bool()>& done,
+		uint32_t timeout_ms) override;
+	virtual void NotifyWaiters() override;
+	virtual uint32_t ThreadCount() override;
+
+private:
+	struct Strand
+	{
+		StrandId id = INVALID_STRAND_ID;
+		std::string name;
+
+		std::mutex mutex;
+		std::condition_variable idle_cv;
+
+		std::deque<SchedTask> tasks;
+		SchedProcess process;
+		uint32_t process_gen = 0; // changed by set and clear
+		bool process_due = false;
+
+		bool queued = false;   // in a worker queue
+		bool running = false;
+		std::atomic<bool> destroyed { false };
+	};
+	typedef std::shared_ptr<Strand> StrandSP;
+
+	struct Worker
+	{
+		uint32_t index = 0;
+		std::thread thread;
+
+		std::mutex mutex;
+		std::deque<StrandSP> strands;
+
+		// Threads serving the queue and those blocked in WaitUntil, guarded by
+		// m_mutex of scheduler
+		uint32_t thread_count = 1;
+		uint32_t blocked_count = 0;
+	};
+	typedef std::unique_ptr<Worker> WorkerUP;
+
+private:
+	StrandSP FindStrand(StrandId strand);
+	void Schedule(const StrandSP& strand);
+	StrandSP TakeStrand(Worker* worker);
+	void RunStrand(const StrandSP& strand);
+	void PollProcesses();
+	void UpdateNextDue();
+	void WaitForWork(uint64_t max_wait_us);
+	void RequestSpare(Worker* worker);
+	void ServeWorker(Worker* worker);
+	void WorkerProc(Worker* worker);
+	void SpareProc();
+
+private:
+	std::vector<WorkerUP> m_workers;
+
+	std::shared_mutex m_strand_mutex;
+	std::unordered_map<StrandId, StrandSP> m_strands;
+	StrandId m_next_strand_id = INVALID_STRAND_ID;
+
+	// Runs tasks of PostRelease
+	StrandId m_release_strand = INVALID_STRAND_ID;
+
+	// Guards process heap and idle waiting
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+
+	// Threads blocked in WaitUntil are woken after each strand run
+	std::condition_variable m_wait_cv;
+	std::atomic<uint32_t> m_waiting_count { 0 };
+	uint64_t m_run_gen = 0;
+
+	// Spare threads are reused, joined by destructor. Workers waiting for a
+	// spare thread are queued, idle ones wait for the queue.
+	std::vector<std::thread> m_spare_threads;
+	std::deque<Worker*> m_spare_requests;
+	std::condition_variable m_spare_cv;
+	uint32_t m_idle_spare_count = 0;
+
+	// Strands with process, key is due time
+	util::IndexedHeap<StrandId, StrandSP> m_processes;
+	std::atomic<uint64_t> m_next_due { UINT64_MAX };
+
+	// Strands queued on workers, and workers waiting for them
+	std::atomic<uint32_t> m_queued_count { 0 };
+	std::atomic<uint32_t> m_idle_count { 0 };
+
+	// Round robin for posts from non-worker threads
+	std::atomic<uint32_t> m_next_worker { 0 };
+
+	std::atomic<bool> m_stop { false };
+
+	// Tasks of one strand run before it yields the worker
+	static const uint32_t kMaxBatchTasks = 32;
+};
+typedef std::shared_ptr<StreamScheduler> StreamSchedulerSP;
+
+}
@@ -0,0 +1,72 @@
+#include "channel-send-batch.h"
+
+namespace
+{
+
+using namespace jukey::txp;
+
+struct BatchState
+{
+	uint32_t depth = 0;
+	std::vector<std::pair<IChannelBatchSink*, ChannelData>> items;
+};
+
+thread_local BatchState t_batch_state;
+
+}
+
+namespace jukey::txp
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ChannelSendBatch::ChannelSendBatch()
+{
+	++t_batch_state.depth;
+}
+
+//------------------------------------------------------------------------------
+// Data of each sink keeps the sending order
+//------------------------------------------------------------------------------
+ChannelSendBatch::~ChannelSendBatch()
+{
+	if (--t_batch_state.depth != 0 || t_batch_state.items.empty()) {
+		return;
+	}
+
+	std::vector<std::pair<IChannelBatchSink*, ChannelData>> items;
+	items.swap(t_batch_state.items);
+
+	std::vector<ChannelData> datas;
+	for (size_t i = 0; i < items.size(); i++) {
+		IChannelBatchSink* sink = items[i].first;
+		if (!sink) continue; // flushed with a previous sink
+
+		for (size_t j = i; j < items.size(); j++) {
+			if (items[j].first == sink) {
+				datas.push_back(std::move(items[j].second));
+				items[j].first = nullptr;
+			}
+		}
+
+		sink->OnSendChannelBatch(datas);
+		datas.clear();
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool ChannelSendBatch::Add(IChannelBatchSink* sink, const ChannelData& data)
+{
+	if (t_batch_state.depth == 0) {
+		return false;
+	}
+
+	t_batch_state.items.emplace_back(sink, data);
+
+	return true;
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "include/if-stream-exchange.h"
+
+namespace jukey::txp
+{
+
+//==============================================================================
+// Receiver of the channel data collected by a send batch
+//==============================================================================
+class IChannelBatchSink
+{
+public:
+	virtual void OnSendChannelBatch(const std::vector<ChannelData>& datas) = 0;
+};
+
+//==============================================================================
+// Send scope of the calling thread, such as the fan-out of a relayed packet or
+// a pacing burst. Channel data sent inside the scope is collected and handed to
+// its sink in one call when the outermost scope ends, so the session layer can
+// queue the whole burst at once. Scopes can be nested.
+//==============================================================================
+class ChannelSendBatch
+{
+public:
+	ChannelSendBatch();
+	~ChannelSendBatch();
+
+	//
+	// @brief Collect data into the scope of the calling thread
+	// @return false if no scope is open, the data should be sent directly
+	//
+	static bool Add(IChannelBatchSink* sink, const ChannelData& data);
+};
+
+}
@@ -1,5 +1,5 @@
 ﻿#include "fec-encoder.h"
-#include "fec/luigi-fec-encoder.h"
+#include "fec/fec-codec-cache.h"
 #include "log.h"
 #include "protocol.h"
 
@@ -29,7 +29,7 @@ void FecEncoder::SetParam(uint8_t k, uint8_t r)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
 
-	if (k > 16 || r > k) {
+	if (k > kMaxFecK || r > k) {
 		LOG_ERR("Set invalid fec param, k:{}, r:{}", k, r);
 		return;
 	}
@@ -45,7 +45,6 @@ void FecEncoder::SetParam(uint8_t k, uint8_t r)
 	auto segments = m_segments;
 
 	m_segments.clear();
-	m_redundants.clear();
 
 	m_group_seq = 0;
 	m_data_len = 0;
@@ -54,7 +53,8 @@ void FecEncoder::SetParam(uint8_t k, uint8_t r)
 		m_encoder.reset();
 	}
 	else {
-		m_encoder.reset(new util::LuigiFecEncoder(m_k, m_r));
+		// Codec is cached by (k, r), no matrix building here
+		m_encoder = util::GetFecEncoder(m_k, m_r);
 	}
 
 	LOG_INF("Set fec encoder param success, k:{}, r:{}", m_k, m_r);
@@ -73,15 +73,46 @@ void FecEncoder::SetParam(uint8_t k, uint8_t r)
 void FecEncoder::UpdateDataLen(uint32_t len)
 {
 	m_segments.clear();
-	m_redundants.clear();
 
 	m_data_len = len;
 
-	for (auto i = 0; i < m_r; i++) {
-		m_redundants.push_back(com::Buffer(m_data_len, m_data_len));
+	// Pool only grows, shorter packets can use longer buffers
+	if (!m_redundant_pool || m_redundant_pool->BufLen() < len + FEC_HDR_LEN) {
+		m_redundant_pool.reset(new util::BufferPool(len + FEC_HDR_LEN,
+			kRedundantPoolSize));
 	}
 }
 
+//------------------------------------------------------------------------------
+// Use the headroom reserved by frame packer, or copy if there is none
+//------------------------------------------------------------------------------
+com::Buffer FecEncoder::PrependFecHdr(const com::Buffer& buf)
+{
+	if (buf.start_pos >= FEC_HDR_LEN) {
+		com::Buffer fec_buf = buf;
+		fec_buf.start_pos -= FEC_HDR_LEN;
+		fec_buf.data_len += FEC_HDR_LEN;
+		return fec_buf;
+	}
+
+	uint32_t buf_len = buf.data_len + FEC_HDR_LEN;
+	com::Buffer fec_buf(buf_len, buf_len);
+	memcpy(DP(fec_buf) + FEC_HDR_LEN, DP(buf), buf.data_len);
+
+	return fec_buf;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+com::Buffer FecEncoder::AllocRedundantBuf()
+{
+	com::Buffer buf = m_redundant_pool->Alloc();
+	buf.data_len = m_data_len + FEC_HDR_LEN;
+
+	return buf;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -102,8 +133,7 @@ void FecEncoder::ProcessSegmentData(const com::Buffer& buf)
 		TryFecEncode();
 	}
 	else {
-		uint32_t buf_len = buf.data_len + sizeof(prot::FecHdr);
-		com::Buffer fec_buf(buf_len, buf_len);
+		com::Buffer fec_buf = PrependFecHdr(buf);
 
 		prot::FecHdr* hdr = (prot::FecHdr*)DP(fec_buf);
 		hdr->ver = 0;
@@ -114,8 +144,6 @@ void FecEncoder::ProcessSegmentData(const com::Buffer& buf)
 		hdr->group = 0;
 		hdr->seq = m_seq_allocator->AllocSeq();
 
-		memcpy(DP(fec_buf) + sizeof(prot::FecHdr), DP(buf), buf.data_len);
-
 		return m_handler->OnFecFrameData(fec_buf);
 	}
 }
@@ -139,26 +167,27 @@ void FecEncoder::TryFecEncode()
 {
 	if (m_segments.size() < m_k) return;
 
-	uint8_t** src_data = new uint8_t * [m_k];
-	uint8_t** red_data = new uint8_t * [m_r];
+	std::vector<com::Buffer> fec_bufs;
+	fec_bufs.reserve(m_k + m_r);
+
+	uint8_t* src_data[kMaxFecK];
+	uint8_t* red_data[kMaxFecK];
 
 	for (auto i = 0; i < m_k; i++) {
-		src_data[i] = DP(m_segments[i]);
+		fec_bufs.push_back(PrependFecHdr(m_segments[i]));
+		src_data[i] = DP(fec_bufs[i]) + FEC_HDR_LEN;
 	}
 
+	// Encode into redundant buffers directly
 	for (auto i = 0; i < m_r; i++) {
-		red_data[i] = DP(m_redundants[i]);
+		fec_bufs.push_back(AllocRedundantBuf());
+		red_data[i] = DP(fec_bufs[m_k + i]) + FEC_HDR_LEN;
 	}
 
 	m_encoder->Encode((void**)src_data, (void**)red_data, m_data_len);
 
-	uint32_t hdr_len = sizeof(prot::FecHdr);
-	uint32_t buf_len = m_data_len + hdr_len;
-
 	for (auto i = 0; i < m_k + m_r; i++) {
-		com::Buffer buf(buf_len, buf_len);
-		
-		prot::FecHdr* hdr = (prot::FecHdr*)DP(buf);
+		prot::FecHdr* hdr = (prot::FecHdr*)DP(fec_bufs[i]);
 		hdr->ver = 0;
 		hdr->K = GET_K(m_k);
 		hdr->R = GET_R(m_r);
@@ -166,22 +195,12 @@ void FecEncoder::TryFecEncode()
 		hdr->rtx = 0;
 		hdr->group = m_group_seq;
 		hdr->seq = m_seq_allocator->AllocSeq();
-		
-		if (i < m_k) {
-			memcpy(DP(buf) + hdr_len, src_data[i], m_data_len);
-		}
-		else {
-			memcpy(DP(buf) + hdr_len, red_data[i - m_k], m_data_len);
-		}
 
-		m_handler->OnFecFrameData(buf);
+		m_handler->OnFecFrameData(fec_bufs[i]);
 	}
 
 	m_group_seq++;
 	m_segments.clear();
-
-	delete[] src_data;
-	delete[] red_data;
 }
 
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "common-struct.h"
 #include "fec/if-fec-encoder.h"
+#include "common/buffer-pool.h"
 #include "seq-allocator.h"
 
 namespace jukey::txp
@@ -17,7 +18,8 @@ public:
 };
 
 //==============================================================================
-// 
+// Segments should be allocated with FEC_HDR_LEN headroom, so that source
+// packets are sent without copying
 //==============================================================================
 class FecEncoder
 {
@@ -33,11 +35,13 @@ private:
 	void TryFecEncode();
 	void UpdateDataLen(uint32_t len);
 	void ProcessSegmentData(const com::Buffer& buf);
+	com::Buffer PrependFecHdr(const com::Buffer& buf);
+	com::Buffer AllocRedundantBuf();
 
 private:
 	IFecEncodeHandler* m_handler = nullptr;
 	ISeqAllocator* m_seq_allocator = nullptr;
-	util::IFecEncoderUP m_encoder;
+	util::IFecEncoderSP m_encoder;
 
 	uint32_t m_data_len = 0;
 
@@ -48,7 +52,12 @@ private:
 	uint8_t m_r = 0;
 
 	std::vector<com::Buffer> m_segments;
-	std::vector<com::Buffer> m_redundants;
+
+	// Redundant packets with FEC header
+	std::unique_ptr<util::BufferPool> m_redundant_pool;
+
+	static const uint32_t kMaxFecK = 16;
+	static const uint32_t kRedundantPoolSize = 64;
 
 	std::mutex m_mutex;
 };
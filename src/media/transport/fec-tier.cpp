@@ -0,0 +1,153 @@
+#include "fec-tier.h"
+#include "log.h"
+
+
+namespace jukey::txp
+{
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ReceiverFecParam::ReceiverFecParam() : m_controller(this, 0, 0)
+{
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ReceiverFecParam::OnStateFeedback(const StateFeedback& feedback)
+{
+	StateFB fb;
+	fb.start_time = feedback.start_time;
+	fb.end_time   = feedback.end_time;
+	fb.recv_count = feedback.recv_count;
+	fb.lost_count = feedback.lost_count;
+	fb.rtt = feedback.rtt;
+	fb.olr = feedback.olr;
+	fb.flr = feedback.flr;
+	fb.nlr = feedback.nlr;
+	fb.clc = feedback.clc;
+	fb.flc = feedback.flc;
+	fb.fc  = feedback.fc;
+
+	m_controller.OnStateFeedback(fb);
+}
+
+//------------------------------------------------------------------------------
+// IFecParamHandler
+//------------------------------------------------------------------------------
+void ReceiverFecParam::OnFecParamUpdate(uint8_t k, uint8_t r)
+{
+	m_k = k;
+	m_r = r;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+FecTier::FecTier(uint8_t layer, uint8_t k, uint8_t r)
+	: m_layer(layer)
+	, m_k(k)
+	, m_r(r)
+	, m_fec_encoder(this, &m_seq_allocator)
+{
+	m_fec_encoder.SetParam(k, r);
+
+	LOG_INF("Create fec tier, layer:{}, k:{}, r:{}", layer, k, r);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void FecTier::AddSender(uint32_t channel_id, IServerStreamSender* sender)
+{
+	m_senders[channel_id] = sender;
+
+	// Group numbers of this encoder are new to the sender
+	sender->ResetFecGroup();
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void FecTier::RemoveSender(uint32_t channel_id)
+{
+	m_senders.erase(channel_id);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void FecTier::WriteSegmentData(const com::Buffer& buf)
+{
+	m_fec_encoder.WriteSegmentData(buf);
+}
+
+//------------------------------------------------------------------------------
+// IFecEncodeHandler
+//------------------------------------------------------------------------------
+void FecTier::OnFecFrameData(const com::Buffer& buf)
+{
+	for (const auto& item : m_senders) {
+		item.second->InputFecFrameData(buf);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Senders with the same layer and FEC parameters share one tier
+//------------------------------------------------------------------------------
+uint32_t FecTierTable::Join(uint8_t layer, uint8_t k, uint8_t r,
+	uint32_t channel_id, IServerStreamSender* sender)
+{
+	uint32_t key = FecTier::Key(layer, k, r);
+
+	auto iter = m_tiers.find(key);
+	if (iter == m_tiers.end()) {
+		iter = m_tiers.insert(std::make_pair(key,
+			FecTierSP(new FecTier(layer, k, r)))).first;
+	}
+	iter->second->AddSender(channel_id, sender);
+
+	return key;
+}
+
+//------------------------------------------------------------------------------
+// Tier is removed with its last sender
+//------------------------------------------------------------------------------
+bool FecTierTable::Leave(uint32_t key, uint32_t channel_id)
+{
+	auto iter = m_tiers.find(key);
+	if (iter == m_tiers.end()) {
+		return false;
+	}
+
+	iter->second->RemoveSender(channel_id);
+	if (iter->second->Empty()) {
+		m_tiers.erase(iter);
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+FecTierSP FecTierTable::Find(uint32_t key) const
+{
+	auto iter = m_tiers.find(key);
+	return iter == m_tiers.end() ? nullptr : iter->second;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void FecTierTable::WriteSegmentData(uint8_t layer, const com::Buffer& buf)
+{
+	for (const auto& item : m_tiers) {
+		if (item.second->Layer() == layer) {
+			item.second->WriteSegmentData(buf);
+		}
+	}
+}
+
+}
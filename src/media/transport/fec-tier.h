@@ -0,0 +1,107 @@
+#pragma once
+
+#include <memory>
+#include <map>
+#include <unordered_map>
+
+#include "common-struct.h"
+#include "include/if-stream-sender.h"
+#include "fec-encoder.h"
+#include "fec-param-controller.h"
+#include "seq-allocator.h"
+
+namespace jukey::txp
+{
+
+//==============================================================================
+// FEC parameters of one receiver, computed from its own feedback only, so that
+// a lossy receiver does not raise the redundancy of the others
+//==============================================================================
+class ReceiverFecParam : public IFecParamHandler
+{
+public:
+	ReceiverFecParam();
+
+	void OnStateFeedback(const StateFeedback& feedback);
+
+	uint8_t K() const { return m_k; }
+	uint8_t R() const { return m_r; }
+
+	// IFecParamHandler
+	virtual void OnFecParamUpdate(uint8_t k, uint8_t r) override;
+
+private:
+	SimpleFecParamController m_controller;
+	uint8_t m_k = 0;
+	uint8_t m_r = 0;
+};
+typedef std::shared_ptr<ReceiverFecParam> ReceiverFecParamSP;
+
+//==============================================================================
+// Senders with the same simulcast layer and FEC parameters share one encoder.
+// Segments are shared by all tiers of the layer, FEC header is written into the
+// segment headroom right before the fan-out and every sender copies the frame,
+// so tiers do not interfere.
+//==============================================================================
+class FecTier : public IFecEncodeHandler
+{
+public:
+	FecTier(uint8_t layer, uint8_t k, uint8_t r);
+
+	static uint32_t Key(uint8_t layer, uint8_t k, uint8_t r)
+	{
+		return (layer << 16) | (k << 8) | r;
+	}
+
+	uint8_t Layer() const { return m_layer; }
+	uint8_t K() const { return m_k; }
+	uint8_t R() const { return m_r; }
+
+	void AddSender(uint32_t channel_id, IServerStreamSender* sender);
+	void RemoveSender(uint32_t channel_id);
+	bool Empty() const { return m_senders.empty(); }
+
+	void WriteSegmentData(const com::Buffer& buf);
+
+	// IFecEncodeHandler
+	virtual void OnFecFrameData(const com::Buffer& buf) override;
+
+private:
+	uint8_t m_layer = 0;
+	uint8_t m_k = 0;
+	uint8_t m_r = 0;
+
+	SeqAllocator m_seq_allocator;
+	FecEncoder m_fec_encoder;
+
+	// channel:sender
+	std::unordered_map<uint32_t, IServerStreamSender*> m_senders;
+};
+typedef std::shared_ptr<FecTier> FecTierSP;
+
+//==============================================================================
+// Tiers of one stream, a tier is created by its first sender and released with
+// its last sender
+//==============================================================================
+class FecTierTable
+{
+public:
+	// Return key of the tier joined
+	uint32_t Join(uint8_t layer, uint8_t k, uint8_t r, uint32_t channel_id,
+		IServerStreamSender* sender);
+	bool Leave(uint32_t key, uint32_t channel_id);
+
+	FecTierSP Find(uint32_t key) const;
+	size_t Size() const { return m_tiers.size(); }
+	bool Empty() const { return m_tiers.empty(); }
+	void Clear() { m_tiers.clear(); }
+
+	// Segments of a layer are encoded by all tiers of the layer
+	void WriteSegmentData(uint8_t layer, const com::Buffer& buf);
+
+private:
+	// key:tier
+	std::map<uint32_t, FecTierSP> m_tiers;
+};
+
+}
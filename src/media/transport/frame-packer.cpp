@@ -83,8 +83,9 @@ void FramePacker::WriteFrameData(const com::Buffer& buf)
 	uint32_t total_seg_len = seg_len + seg_hdr_len;
 
 	for (uint32_t i = 0; i < seg_count; i++) {
-		// 申请内存
-		com::Buffer seg_buf(total_seg_len, total_seg_len);
+		// 申请内存，预留 FEC 头部空间，FEC 编码时无需再拷贝
+		com::Buffer seg_buf(FEC_HDR_LEN + total_seg_len, total_seg_len);
+		seg_buf.start_pos = FEC_HDR_LEN;
 
 		// 计算 segment 内容长度，最后一个 segment 需要单独计算
 		uint32_t data_len = 
@@ -105,7 +106,7 @@ void FramePacker::WriteFrameData(const com::Buffer& buf)
 		seg_hdr->fseq = fseq;
 
 		// Copy segment data
-		memcpy(seg_buf.data.get() + seg_hdr_len, buf.data.get() + copy_pos, 
+		memcpy(DP(seg_buf) + seg_hdr_len, buf.data.get() + copy_pos, 
 			data_len);
 
 		// Update copy position
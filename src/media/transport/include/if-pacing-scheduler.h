@@ -0,0 +1,54 @@
+#pragma once
+
+#include "common-struct.h"
+
+namespace jukey::txp
+{
+
+typedef uint32_t PacingFlowId;
+
+#define INVALID_PACING_FLOW_ID 0
+
+//==============================================================================
+// 
+//==============================================================================
+class IPacingSenderHandler
+{
+public:
+	virtual void OnPacingData(const com::Buffer& buf) = 0;
+};
+
+//==============================================================================
+// 
+//==============================================================================
+enum DataPriroity
+{
+	DP_LOW,
+	DP_HIGH
+};
+
+//==============================================================================
+// Paced sending shared by several senders, each sender is a flow, packets of
+// a flow are handed back to its handler at the pacing rate of the flow
+//==============================================================================
+class IPacingScheduler
+{
+public:
+	virtual ~IPacingScheduler() {}
+
+	virtual PacingFlowId AddFlow(IPacingSenderHandler* handler) = 0;
+
+	//
+	// @brief Remove flow, handler will not be called after return
+	//
+	virtual void RemoveFlow(PacingFlowId flow_id) = 0;
+
+	virtual void EnqueueData(PacingFlowId flow_id, const com::Buffer& buf,
+		DataPriroity priority) = 0;
+
+	virtual void SetPacingRate(PacingFlowId flow_id, uint32_t rate_kbps) = 0;
+
+	virtual void SetPacingFactor(PacingFlowId flow_id, double factor) = 0;
+};
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "if-unknown.h"
 #include "thread/if-thread.h"
@@ -13,6 +14,21 @@ namespace jukey::txp
 #define CID_STREAM_EXCHAGE "cid-stream-exchange"
 #define IID_STREAM_EXCHAGE "iid-stream-exchange"
 
+//==============================================================================
+// Channel data of a batch send
+//==============================================================================
+struct ChannelData
+{
+	ChannelData() {}
+	ChannelData(uint32_t cid, uint32_t uid, uint32_t t, const com::Buffer& b)
+		: channel_id(cid), user_id(uid), mt(t), buf(b) {}
+
+	uint32_t channel_id = 0;
+	uint32_t user_id = 0;
+	uint32_t mt = 0;
+	com::Buffer buf;
+};
+
 //==============================================================================
 // Stream handler
 //==============================================================================
@@ -27,6 +43,12 @@ public:
 
 	virtual void OnSendChannelData(uint32_t channel_id, uint32_t user_id,
 		uint32_t mt, const com::Buffer& buf) = 0;
+
+	//
+	// @brief Channel data collected by a relay fan-out or a pacing burst, to be
+	//        sent together
+	//
+	virtual void OnSendChannelData(const std::vector<ChannelData>& datas) = 0;
 };
 
 //==============================================================================
@@ -4,6 +4,7 @@
 #include "if-unknown.h"
 #include "protocol.h"
 #include "../../public/media-struct.h"
+#include "if-pacing-scheduler.h"
 
 namespace jukey::txp
 {
@@ -121,11 +122,6 @@ public:
 class IFeedbackHandler
 {
 public:
-	virtual void OnNackRequest(uint32_t channel_id,
-		uint32_t user_id,
-		const std::vector<uint32_t> nacks,
-		std::vector<com::Buffer>& pkts) = 0;
-
 	virtual void OnStateFeedback(uint32_t channel_id,
 		uint32_t user_id,
 		const StateFeedback& feedback) = 0;
@@ -139,9 +135,11 @@ class IServerStreamSender : public base::IUnknown
 public:
 	//
 	// @brief Initialize stream sender
+	// @param pacing_scheduler shared by all senders of the same thread
 	//
 	virtual com::ErrCode Init(IStreamSenderHandler* sender_handler, 
 		IFeedbackHandler* feedback_handler,
+		IPacingScheduler* pacing_scheduler,
 		uint32_t channel_id,
 		uint32_t user_id, 
 		const com::MediaStream& stream) = 0;
@@ -167,10 +165,21 @@ public:
 	virtual uint32_t UserId() = 0;
 
 	//
-	// Input FEC frame data
+	// Input FEC frame data re-encoded by server
 	//
 	virtual void InputFecFrameData(const com::Buffer& buf) = 0;
 
+	//
+	// FEC frames input later come from another FEC encoder
+	//
+	virtual void ResetFecGroup() = 0;
+
+	//
+	// Input original FEC frame data received from publisher, which is relayed
+	// with sequence and group rewritten
+	//
+	virtual void InputRelayData(const com::Buffer& buf) = 0;
+
 	//
 	// Input feedback data
 	//
@@ -11,57 +11,104 @@ namespace jukey::txp
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void NackHistory::SaveFecFrameData(const com::Buffer& buf)
+NackHistory::NackHistory() : m_history_data(kNackMaxCacheSize)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
+	static_assert((kNackMaxCacheSize & (kNackMaxCacheSize - 1)) == 0,
+		"Cache size must be power of two");
+}
 
-	uint64_t now = util::Now();
+//------------------------------------------------------------------------------
+// Release packets older than cache duration, each sequence is visited once
+//------------------------------------------------------------------------------
+void NackHistory::ExpireHistory(uint64_t now)
+{
+	while (!m_empty) {
+		HistoryEntry& entry = m_history_data[m_oldest_seq & (kNackMaxCacheSize - 1)];
+		if (entry.buf.data && entry.seq == m_oldest_seq) {
+			if (now <= entry.create_us + kNackMaxCacheDurationMs * 1000) {
+				break;
+			}
+			LOG_DBG("Delete nack history item, seq:{}", entry.seq);
+			entry.buf = com::Buffer();
+		}
 
-	for (auto iter = m_history_data.begin(); iter != m_history_data.end();) {
-		if (m_history_data.size() > kNackMaxCacheSize
-			|| now > iter->second.create_us + kNackMaxCacheDurationMs * 1000) {
-			LOG_DBG("Delete nack history item, seq:{}, size:{}", iter->first,
-				m_history_data.size());
-			iter = m_history_data.erase(iter);
+		if (m_oldest_seq == m_newest_seq) {
+			m_empty = true;
 		}
 		else {
-			break;
+			m_oldest_seq++;
 		}
 	}
+}
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void NackHistory::SaveFecFrameData(const com::Buffer& buf)
+{
 	LOG_FEC_FRAME_DBG("Save fec frame", buf);
 
 	prot::FecHdr* hdr = (prot::FecHdr*)DP(buf);
 
 	// 不缓存 FEC 冗余报文
-	if (FEC_K(hdr) == 0 || hdr->gseq < FEC_K(hdr)) {
-		hdr->rtx = 1; // 标识为重传报文
-		m_history_data.insert(
-			std::make_pair(hdr->seq, HistoryEntry(now, buf)));
-
-		LOG_DBG("Insert nack packet, "
-			"seq:{}, k:{}, r:{}, rtx:{}, group:{}, gseq:{}, history size:{}",  
-			hdr->seq, (uint32_t)hdr->K, (uint32_t)hdr->R, (uint32_t)hdr->rtx, 
-			hdr->group, (uint32_t)hdr->gseq, m_history_data.size());
+	if (FEC_K(hdr) != 0 && hdr->gseq >= FEC_K(hdr)) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint64_t now = util::Now();
+
+	ExpireHistory(now);
+
+	if (m_empty) {
+		m_oldest_seq = hdr->seq;
+		m_newest_seq = hdr->seq;
+		m_empty = false;
 	}
+	else if ((int32_t)(hdr->seq - m_newest_seq) > 0) {
+		m_newest_seq = hdr->seq;
+
+		// Slots of sequences out of the ring are overwritten
+		if (m_newest_seq - m_oldest_seq >= kNackMaxCacheSize) {
+			m_oldest_seq = m_newest_seq - kNackMaxCacheSize + 1;
+		}
+	}
+	else if ((int32_t)(hdr->seq - m_oldest_seq) < 0) {
+		LOG_WRN("Ignore outdated nack packet, seq:{}", hdr->seq);
+		return;
+	}
+
+	HistoryEntry& entry = m_history_data[hdr->seq & (kNackMaxCacheSize - 1)];
+	entry.seq = hdr->seq;
+	entry.create_us = now;
+	entry.buf = buf; // reference only
+
+	LOG_DBG("Insert nack packet, seq:{}, k:{}, r:{}, group:{}, gseq:{}", 
+		hdr->seq, (uint32_t)hdr->K, (uint32_t)hdr->R, hdr->group, 
+		(uint32_t)hdr->gseq);
 }
 
 //------------------------------------------------------------------------------
-// 
+// Saved packet may still be referenced by the sending path, so rtx is marked
+// on a copy
 //------------------------------------------------------------------------------
 bool NackHistory::FindFecFrameData(uint32_t seq, com::Buffer& buf)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
 
-	auto iter = m_history_data.find(seq);
-	if (iter == m_history_data.end()) {
+	const HistoryEntry& entry = m_history_data[seq & (kNackMaxCacheSize - 1)];
+	if (m_empty || !entry.buf.data || entry.seq != seq
+		|| util::Now() > entry.create_us + kNackMaxCacheDurationMs * 1000) {
 		LOG_WRN("Cannot find nack history data, seq:{}", seq);
 		return false;
 	}
 
-	buf = iter->second.buf;
+	buf = com::Buffer(DP(entry.buf), entry.buf.data_len);
 
 	prot::FecHdr* hdr = (prot::FecHdr*)DP(buf);
+	hdr->rtx = 1; // 标识为重传报文
+
 	LOG_DBG("Find nack item, seq:{}, group:{}, gseq:{}", hdr->seq, hdr->group, 
 		(uint32_t)hdr->gseq);
 
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <map>
+#include <vector>
+#include <mutex>
 
 #include "common-struct.h"
 
@@ -8,27 +9,37 @@ namespace jukey::txp
 {
 
 //==============================================================================
-// 
+// Packets are saved in a power-of-two ring indexed by sequence, the buffer is
+// referenced not copied, and a copy is made only when retransmitting
 //==============================================================================
 class NackHistory
 {
 public:
+	NackHistory();
+
 	void SaveFecFrameData(const com::Buffer& buf);
 	bool FindFecFrameData(uint32_t seq, com::Buffer& buf);
 
+private:
+	void ExpireHistory(uint64_t now);
+
 private:
 	struct HistoryEntry
 	{
-		HistoryEntry(uint64_t t, const com::Buffer& b) : create_us(t), buf(b) {}
-
-		uint64_t create_us;
+		uint32_t seq = 0;
+		uint64_t create_us = 0;
 		com::Buffer buf;
 	};
 
-	std::map<uint32_t, HistoryEntry> m_history_data;
+	std::vector<HistoryEntry> m_history_data;
 	std::mutex m_mutex;
 
-	static const uint32_t kNackMaxCacheSize = 40960;
+	// Sequence range of saved packets, [m_oldest_seq, m_newest_seq]
+	uint32_t m_oldest_seq = 0;
+	uint32_t m_newest_seq = 0;
+	bool m_empty = true;
+
+	static const uint32_t kNackMaxCacheSize = 16384; // must be power of two
 	static const uint32_t kNackMaxCacheDurationMs = 1000;
 };
 
@@ -15,8 +15,9 @@ namespace jukey::txp
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-NackRequester::NackRequester(IComFactory* factory, INackRequestHandler* handler)
-	: m_factory(factory), m_handler(handler)
+NackRequester::NackRequester(IComFactory* factory, INackRequestHandler* handler,
+	const RecvTracker* recv_tracker)
+	: m_factory(factory), m_handler(handler), m_recv_tracker(recv_tracker)
 {
 	m_timer_mgr = QUERY_TIMER_MGR(m_factory);
 	assert(m_timer_mgr);
@@ -46,7 +47,7 @@ NackRequester::~NackRequester()
 }
 
 //------------------------------------------------------------------------------
-// TODO: 没有处理序列号回环
+// Sequence is compared by signed difference for wrap-around
 //------------------------------------------------------------------------------
 void NackRequester::OnRecvPacket(const com::Buffer& buf)
 {
@@ -54,7 +55,8 @@ void NackRequester::OnRecvPacket(const com::Buffer& buf)
 
 	LOG_FEC_FRAME_DBG("Received packet", buf);
 
-	if (m_max_recv_seq == -1) {
+	if (m_first_packet) {
+		m_first_packet = false;
 		m_max_recv_seq = hdr->seq;
 		m_max_recv_gseq = hdr->gseq;
 		return;
@@ -72,16 +74,18 @@ void NackRequester::OnRecvPacket(const com::Buffer& buf)
 	}
 
 	// 不连续的序列号，先不用考虑乱序，把丢失报文都当做需要重传的报文
-	if (hdr->seq > m_max_recv_seq + 1) {
-		for (uint32_t i = (uint32_t)m_max_recv_seq + 1, j = m_max_recv_gseq + 1; 
-			i < hdr->seq; i++, j++) {
+	int32_t diff = (int32_t)(hdr->seq - m_max_recv_seq);
+
+	if (diff > 1) {
+		for (uint32_t i = m_max_recv_seq + 1, j = m_max_recv_gseq + 1; 
+			i != hdr->seq; i++, j++) {
 			// 冗余包不生成 NACK 项
 			if (FEC_K(hdr) > 0 && j % (FEC_K(hdr) + FEC_R(hdr)) >= FEC_K(hdr)) {
 				continue;
 			}
 
 			// 已经收到，但可能在 FEC 解码缓存中
-			if (m_pre_recv_pkts.find(i) != m_pre_recv_pkts.end()) {
+			if (m_recv_tracker->IsReceived(i)) {
 				LOG_DBG("Found received packet, seq:{}", i);
 				continue;
 			}
@@ -99,7 +103,7 @@ void NackRequester::OnRecvPacket(const com::Buffer& buf)
 		m_max_recv_seq = hdr->seq;
 		m_max_recv_gseq = hdr->gseq;
 	}
-	else if (hdr->seq == m_max_recv_seq + 1) {
+	else if (diff == 1) {
 		m_max_recv_seq = hdr->seq;
 		m_max_recv_gseq = hdr->gseq;
 	}
@@ -117,18 +121,6 @@ void NackRequester::OnRecvPacket(const com::Buffer& buf)
 			m_nack_map.erase(iter);
 		}
 	}
-
-	// 移除过时元素
-	auto it = m_pre_recv_pkts.upper_bound((uint32_t)m_max_recv_seq);
-	if (it != m_pre_recv_pkts.end()) {
-		// 删除从集合开始到找到的迭代器位置的所有元素
-		m_pre_recv_pkts.erase(m_pre_recv_pkts.begin(), it);
-		LOG_DBG("Remove pre-received packets, size:{}", m_pre_recv_pkts.size());
-	}
-	else { // 没有找到大于或等于的元素，则集合已经为空或所有元素都小于
-		m_pre_recv_pkts.clear();
-		LOG_DBG("Clear pre-received packets");
-	}
 }
 
 //------------------------------------------------------------------------------
@@ -139,15 +131,6 @@ void NackRequester::UpdateRTT(uint32_t rtt_ms)
 	m_rtt_ms = rtt_ms;
 }
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-void NackRequester::OnPreRecvPacket(uint32_t seq)
-{
-	std::lock_guard<std::mutex> lock(m_mutex);
-	m_pre_recv_pkts.insert(seq);
-}
-
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
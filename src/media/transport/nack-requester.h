@@ -1,13 +1,13 @@
 #pragma once
 
 #include <map>
-#include <set>
 #include <memory>
 
 #include "common-struct.h"
 #include "if-stream-receiver.h"
 #include "com-factory.h"
 #include "if-timer-mgr.h"
+#include "recv-tracker.h"
 
 namespace jukey::txp
 {
@@ -27,12 +27,12 @@ public:
 class NackRequester
 {
 public:
-	NackRequester(base::IComFactory* factory, INackRequestHandler* handler);
+	NackRequester(base::IComFactory* factory, INackRequestHandler* handler,
+		const RecvTracker* recv_tracker);
 	~NackRequester();
 
 	void OnRecvPacket(const com::Buffer& buf);
 	void UpdateRTT(uint32_t rtt_ms);
-	void OnPreRecvPacket(uint32_t seq);
 
 	void OnTimer();
 
@@ -55,7 +55,7 @@ private:
 	};
 
 	// key:seq
-	std::map<uint32_t, NackItem> m_nack_map;
+	std::map<uint32_t, NackItem, SeqLess> m_nack_map;
 
 	static const uint32_t kNackTimeoutMs = 1000;
 	static const uint32_t kNackMaxRetries = 16;
@@ -64,12 +64,15 @@ private:
 
 	uint32_t m_rtt_ms = 20; // 默认 20ms
 
-	int64_t m_max_recv_seq = -1;
+	bool m_first_packet = true;
+	uint32_t m_max_recv_seq = 0;
 	uint32_t m_max_recv_gseq = 0;
 
 	std::mutex m_mutex;
 
-	std::set<uint32_t> m_pre_recv_pkts;
+	// Packets received but may be still in FEC decoding buffer, owned by 
+	// stream receiver and only accessed in receiving thread
+	const RecvTracker* m_recv_tracker = nullptr;
 };
 typedef std::unique_ptr<NackRequester> NackRequesterUP;
 
@@ -0,0 +1,237 @@
+#include <cassert>
+#include <algorithm>
+
+#include "pacing-scheduler.h"
+#include "channel-send-batch.h"
+#include "log.h"
+
+
+using namespace jukey::base;
+
+namespace jukey::txp
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+PacingScheduler::PacingScheduler(IComFactory* factory) : m_factory(factory)
+{
+	m_timer_mgr = QUERY_TIMER_MGR(m_factory);
+	assert(m_timer_mgr);
+
+	com::TimerParam timer_param;
+	timer_param.timeout = PacingFlow::kSendIntervalMs;
+	timer_param.timer_type = com::TimerType::TIMER_TYPE_LOOP;
+	timer_param.timer_name = "pacing scheduler";
+	timer_param.timer_func = [this](int64_t) { OnTimer(); };
+
+	m_timer_id = m_timer_mgr->AllocTimer(timer_param);
+	m_timer_mgr->StartTimer(m_timer_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+PacingScheduler::~PacingScheduler()
+{
+	m_timer_mgr->StopTimer(m_timer_id);
+	m_timer_mgr->FreeTimer(m_timer_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+PacingFlowId PacingScheduler::AddFlow(IPacingSenderHandler* handler)
+{
+	assert(handler);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (++m_next_flow_id == INVALID_PACING_FLOW_ID) {
+		++m_next_flow_id;
+	}
+
+	m_flows.insert(std::make_pair(m_next_flow_id,
+		FlowEntrySP(new FlowEntry(handler))));
+
+	LOG_INF("Add pacing flow:{}, flow count:{}", m_next_flow_id, m_flows.size());
+
+	return m_next_flow_id;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingScheduler::RemoveFlow(PacingFlowId flow_id)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto iter = m_flows.find(flow_id);
+		if (iter == m_flows.end()) {
+			LOG_ERR("Cannot find pacing flow:{}", flow_id);
+			return;
+		}
+
+		// Packets of this flow in sending burst will be dropped
+		iter->second->removed = true;
+		m_flows.erase(iter);
+
+		LOG_INF("Remove pacing flow:{}, flow count:{}", flow_id, m_flows.size());
+	}
+
+	// Wait until the sending burst finished
+	std::lock_guard<std::recursive_mutex> lock(m_send_mutex);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingScheduler::EnqueueData(PacingFlowId flow_id, const com::Buffer& buf,
+	DataPriroity priority)
+{
+	FlowEntrySP entry;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto iter = m_flows.find(flow_id);
+		if (iter == m_flows.end()) {
+			LOG_ERR("Cannot find pacing flow:{}", flow_id);
+			return;
+		}
+
+		if (iter->second->flow.EnqueueData(buf, priority)) {
+			return;
+		}
+
+		entry = iter->second;
+	}
+
+	// No budget calculated yet, send directly
+	std::lock_guard<std::recursive_mutex> lock(m_send_mutex);
+	if (!entry->removed) {
+		entry->flow.Handler()->OnPacingData(buf);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingScheduler::SetPacingRate(PacingFlowId flow_id, uint32_t rate_kbps)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto iter = m_flows.find(flow_id);
+	if (iter != m_flows.end()) {
+		iter->second->flow.SetPacingRate(rate_kbps);
+	}
+	else {
+		LOG_ERR("Cannot find pacing flow:{}", flow_id);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingScheduler::SetPacingFactor(PacingFlowId flow_id, double factor)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto iter = m_flows.find(flow_id);
+	if (iter != m_flows.end()) {
+		iter->second->flow.SetPacingFactor(factor);
+	}
+	else {
+		LOG_ERR("Cannot find pacing flow:{}", flow_id);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint32_t PacingScheduler::FlowCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return static_cast<uint32_t>(m_flows.size());
+}
+
+//------------------------------------------------------------------------------
+// The burst is handed to the session layer in one batch after the send lock is
+// released
+//------------------------------------------------------------------------------
+void PacingScheduler::SendBurst(const std::vector<SendEntry>& burst)
+{
+	ChannelSendBatch send_batch;
+	std::lock_guard<std::recursive_mutex> lock(m_send_mutex);
+
+	for (const auto& item : burst) {
+		if (!item.entry->removed) {
+			item.entry->flow.Handler()->OnPacingData(item.buf);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// Each flow gets its period budget as deficit, overshoot is carried to next
+// period and unused budget is dropped. Flows with positive deficit send one
+// packet per round, so packets of different flows interleave in the burst.
+//------------------------------------------------------------------------------
+void PacingScheduler::OnTimer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_round.clear();
+
+		for (auto& item : m_flows) {
+			const FlowEntrySP& entry = item.second;
+
+			uint64_t interval_send_bytes = entry->flow.UpdateIntervalSendBytes();
+			if (interval_send_bytes == 0) {
+				entry->deficit = 0;
+				continue;
+			}
+
+			entry->deficit = std::min<int64_t>(entry->deficit, 0)
+				+ static_cast<int64_t>(interval_send_bytes);
+
+			if (entry->deficit > 0 && entry->flow.HasData()) {
+				m_round.push_back(entry);
+			}
+		}
+
+		com::Buffer buf;
+		while (!m_round.empty()) {
+			size_t index = 0;
+			for (size_t i = 0; i < m_round.size(); i++) {
+				FlowEntrySP& entry = m_round[i];
+				if (!entry->flow.DequeueData(buf)) {
+					continue;
+				}
+
+				m_burst.push_back(SendEntry(entry, buf));
+				entry->deficit -= buf.data_len;
+
+				// Keep in next round
+				if (entry->deficit > 0 && entry->flow.HasData()) {
+					if (index != i) {
+						m_round[index] = std::move(entry);
+					}
+					++index;
+				}
+			}
+			m_round.resize(index);
+		}
+
+		for (auto& item : m_flows) {
+			item.second->flow.OnIntervalSent();
+		}
+	}
+
+	SendBurst(m_burst);
+	m_burst.clear();
+}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "common-struct.h"
+#include "com-factory.h"
+#include "if-timer-mgr.h"
+#include "pacing-sender.h"
+
+namespace jukey::txp
+{
+
+//==============================================================================
+// Pacing scheduler shared by all server stream senders of one transport
+// thread. A single loop timer serves all flows in deficit round robin order,
+// and packets of all flows in one period are sent in one burst.
+//==============================================================================
+class PacingScheduler : public IPacingScheduler
+{
+public:
+	PacingScheduler(base::IComFactory* factory);
+	~PacingScheduler();
+
+	// IPacingScheduler
+	virtual PacingFlowId AddFlow(IPacingSenderHandler* handler) override;
+	virtual void RemoveFlow(PacingFlowId flow_id) override;
+	virtual void EnqueueData(PacingFlowId flow_id, const com::Buffer& buf,
+		DataPriroity priority) override;
+	virtual void SetPacingRate(PacingFlowId flow_id, uint32_t rate_kbps) override;
+	virtual void SetPacingFactor(PacingFlowId flow_id, double factor) override;
+
+	uint32_t FlowCount();
+
+private:
+	struct FlowEntry
+	{
+		FlowEntry(IPacingSenderHandler* handler) : flow(handler) {}
+
+		PacingFlow flow;
+
+		// Negative means overshoot of last period
+		int64_t deficit = 0;
+
+		std::atomic<bool> removed{ false };
+	};
+	typedef std::shared_ptr<FlowEntry> FlowEntrySP;
+
+	struct SendEntry
+	{
+		SendEntry(const FlowEntrySP& e, const com::Buffer& b) : entry(e), buf(b) {}
+
+		FlowEntrySP entry;
+		com::Buffer buf;
+	};
+
+private:
+	void OnTimer();
+	void SendBurst(const std::vector<SendEntry>& burst);
+
+private:
+	base::IComFactory* m_factory = nullptr;
+
+	com::ITimerMgr* m_timer_mgr = nullptr;
+	com::TimerId m_timer_id = INVALID_TIMER_ID;
+
+	std::unordered_map<PacingFlowId, FlowEntrySP> m_flows;
+	PacingFlowId m_next_flow_id = INVALID_PACING_FLOW_ID;
+
+	// Flows to serve in current period, reused by timer callback only
+	std::vector<FlowEntrySP> m_round;
+
+	std::mutex m_mutex;
+
+	// Held while sending, RemoveFlow waits on it
+	std::recursive_mutex m_send_mutex;
+
+	// Packets to send in current period, reused by timer callback only
+	std::vector<SendEntry> m_burst;
+};
+
+}
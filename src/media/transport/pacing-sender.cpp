@@ -10,40 +10,19 @@ using namespace jukey::base;
 namespace jukey::txp
 {
 
-const double PacingSender::kInnerPacingFactorMultiply = 1.2;
+const double PacingFlow::kInnerPacingFactorMultiply = 1.2;
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-PacingSender::PacingSender(IComFactory* factory, IPacingSenderHandler* handler) 
-	: m_factory(factory), m_handler(handler)
-{
-	m_timer_mgr = QUERY_TIMER_MGR(m_factory);
-	assert(m_timer_mgr);
-
-	com::TimerParam timer_param;
-	timer_param.timeout = kSendIntervalMs;
-	timer_param.timer_type = com::TimerType::TIMER_TYPE_LOOP;
-	timer_param.timer_name = "pacing sender";
-	timer_param.timer_func = [this](int64_t) { OnTimer(); };
-
-	m_timer_id = m_timer_mgr->AllocTimer(timer_param);
-	m_timer_mgr->StartTimer(m_timer_id);
-}
-
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-PacingSender::~PacingSender()
+PacingFlow::PacingFlow(IPacingSenderHandler* handler) : m_handler(handler)
 {
-	m_timer_mgr->StopTimer(m_timer_id);
-	m_timer_mgr->FreeTimer(m_timer_id);
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void PacingSender::RefreshBitrateStats(const com::Buffer& buf)
+void PacingFlow::RefreshBitrateStats(const com::Buffer& buf)
 {
 	uint64_t now = util::Now();
 
@@ -73,30 +52,60 @@ void PacingSender::RefreshBitrateStats(const com::Buffer& buf)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void PacingSender::EnqueueData(const com::Buffer& buf, DataPriroity priority)
+bool PacingFlow::EnqueueData(const com::Buffer& buf, DataPriroity priority)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
+	RefreshBitrateStats(buf);
 
 	// 初始状态，还未计算出每个时间间隔发送的数据大小，直接发送
 	if (m_interval_send_bytes == 0) {
-		m_handler->OnPacingData(buf);
+		return false;
 	}
-	else { // 根据优先级入发送队列
-		if (priority == DP_LOW) {
-			m_low_pri_list.push_back(buf);
-		}
-		else if (priority == DP_HIGH) {
-			m_high_pri_list.push_back(buf);
-		}
+
+	// 根据优先级入发送队列
+	if (priority == DP_LOW) {
+		m_low_pri_list.push_back(buf);
+	}
+	else if (priority == DP_HIGH) {
+		m_high_pri_list.push_back(buf);
 	}
 
-	RefreshBitrateStats(buf);
+	return true;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void PacingSender::SetPacingRate(uint32_t rate_kbps)
+bool PacingFlow::DequeueData(com::Buffer& buf)
+{
+	// 先发送高优先级报文
+	if (!m_high_pri_list.empty()) {
+		buf = m_high_pri_list.front();
+		m_high_pri_list.pop_front();
+		return true;
+	}
+
+	// 再发送低优先级报文
+	if (!m_low_pri_list.empty()) {
+		buf = m_low_pri_list.front();
+		m_low_pri_list.pop_front();
+		return true;
+	}
+
+	return false;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool PacingFlow::HasData()
+{
+	return !m_high_pri_list.empty() || !m_low_pri_list.empty();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingFlow::SetPacingRate(uint32_t rate_kbps)
 {
 	LOG_INF("Set pacing rate from {} to {}", m_pacing_rate_kbps, rate_kbps);
 
@@ -106,7 +115,7 @@ void PacingSender::SetPacingRate(uint32_t rate_kbps)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void PacingSender::SetPacingFactor(double factor)
+void PacingFlow::SetPacingFactor(double factor)
 {
 	if (factor < 0.1) {
 		LOG_ERR("Invalid pacing fator:{}", factor);
@@ -121,25 +130,21 @@ void PacingSender::SetPacingFactor(double factor)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void PacingSender::OnProbeSent(uint32_t size)
-{
-	m_probe_sent_size += size;
-}
-
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-void PacingSender::UpdateIntervalSendBytes()
+uint64_t PacingFlow::UpdateIntervalSendBytes()
 {
 	// 没有发送报文
 	if (m_stats_list.empty()) {
 		m_stats_bytes = 0;
 		m_interval_send_bytes = 0;
-		return;
+		return 0;
 	}
 
 	if (m_pacing_rate_kbps == 0) {
 		uint64_t diff_us = (util::Now() - m_stats_list.front().ts);
+		if (diff_us == 0) {
+			return m_interval_send_bytes;
+		}
+
 		uint64_t bitrate = ((uint64_t)m_stats_bytes * 1000 * 1000 * 8) / diff_us;
 
 		LOG_DBG("bitrate:{}, size:{}, bytes:{}, duration:{}", bitrate,
@@ -157,54 +162,15 @@ void PacingSender::UpdateIntervalSendBytes()
 		m_interval_send_bytes = static_cast<uint32_t>(m_pacing_factor *
 			m_inner_pacing_factor * m_pacing_rate_kbps * kSendIntervalMs / 8);
 	}
+
+	return m_interval_send_bytes;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void PacingSender::OnTimer()
+void PacingFlow::OnIntervalSent()
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-
-	UpdateIntervalSendBytes();
-	
-	if (m_interval_send_bytes == 0 
-		|| m_interval_send_bytes <= m_probe_sent_size) {
-		m_probe_sent_size = 0;
-		return;
-	}
-		
-	uint64_t need_send_bytes = m_interval_send_bytes - m_probe_sent_size;
-
-	while (!m_high_pri_list.empty() || !m_low_pri_list.empty()) {
-		if (need_send_bytes == 0)
-			break;
-
-		// 先发送高优先级报文
-		if (!m_high_pri_list.empty()) {
-			m_handler->OnPacingData(m_high_pri_list.front());
-			if (m_high_pri_list.front().data_len >= need_send_bytes) {
-				need_send_bytes = 0;
-			}
-			else {
-				need_send_bytes -= m_high_pri_list.front().data_len;
-			}
-			m_high_pri_list.pop_front();
-		}
-		// 再发送低优先级报文
-		else if (!m_low_pri_list.empty()) {
-			m_handler->OnPacingData(m_low_pri_list.front());
-			if (m_low_pri_list.front().data_len >= need_send_bytes) {
-				need_send_bytes = 0;
-			}
-			else {
-				need_send_bytes -= m_low_pri_list.front().data_len;
-			}
-			m_low_pri_list.pop_front();
-		}
-	}
-
-	// Update 
 	size_t left_size = m_low_pri_list.size() + m_high_pri_list.size();
 	if (left_size == 0) {
 		if (m_inner_pacing_factor > 1.0) {
@@ -238,4 +204,106 @@ void PacingSender::OnTimer()
 	}
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+PacingSender::PacingSender(IComFactory* factory, IPacingSenderHandler* handler) 
+	: m_factory(factory), m_flow(handler)
+{
+	m_timer_mgr = QUERY_TIMER_MGR(m_factory);
+	assert(m_timer_mgr);
+
+	com::TimerParam timer_param;
+	timer_param.timeout = PacingFlow::kSendIntervalMs;
+	timer_param.timer_type = com::TimerType::TIMER_TYPE_LOOP;
+	timer_param.timer_name = "pacing sender";
+	timer_param.timer_func = [this](int64_t) { OnTimer(); };
+
+	m_timer_id = m_timer_mgr->AllocTimer(timer_param);
+	m_timer_mgr->StartTimer(m_timer_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+PacingSender::~PacingSender()
+{
+	m_timer_mgr->StopTimer(m_timer_id);
+	m_timer_mgr->FreeTimer(m_timer_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingSender::EnqueueData(const com::Buffer& buf, DataPriroity priority)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_flow.EnqueueData(buf, priority)) {
+		m_flow.Handler()->OnPacingData(buf);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingSender::SetPacingRate(uint32_t rate_kbps)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_flow.SetPacingRate(rate_kbps);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingSender::SetPacingFactor(double factor)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_flow.SetPacingFactor(factor);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingSender::OnProbeSent(uint32_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_probe_sent_size += size;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PacingSender::OnTimer()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint64_t interval_send_bytes = m_flow.UpdateIntervalSendBytes();
+	
+	if (interval_send_bytes == 0 || interval_send_bytes <= m_probe_sent_size) {
+		m_probe_sent_size = 0;
+		return;
+	}
+		
+	// Probe bytes only take the budget of the period they were sent in
+	uint64_t need_send_bytes = interval_send_bytes - m_probe_sent_size;
+	m_probe_sent_size = 0;
+
+	com::Buffer buf;
+	while (need_send_bytes > 0 && m_flow.DequeueData(buf)) {
+		m_flow.Handler()->OnPacingData(buf);
+		if (buf.data_len >= need_send_bytes) {
+			need_send_bytes = 0;
+		}
+		else {
+			need_send_bytes -= buf.data_len;
+		}
+	}
+
+	m_flow.OnIntervalSent();
+}
+
 }
\ No newline at end of file
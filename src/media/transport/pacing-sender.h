@@ -5,46 +5,51 @@
 #include "common-struct.h"
 #include "com-factory.h"
 #include "if-timer-mgr.h"
+#include "include/if-pacing-scheduler.h"
 
 namespace jukey::txp
 {
 
 //==============================================================================
-// 
+// Packet queues and send budget of one paced flow, not thread safe
 //==============================================================================
-class IPacingSenderHandler
+class PacingFlow
 {
 public:
-	virtual void OnPacingData(const com::Buffer& buf) = 0;
-};
+	PacingFlow(IPacingSenderHandler* handler);
 
-//==============================================================================
-// 
-//==============================================================================
-enum DataPriroity
-{
-	DP_LOW,
-	DP_HIGH
-};
+	IPacingSenderHandler* Handler() { return m_handler; }
 
-//==============================================================================
-// 
-//==============================================================================
-class PacingSender
-{
-public:
-	PacingSender(base::IComFactory* factory, IPacingSenderHandler* handler);
-	~PacingSender();
+	//
+	// @brief Queue data by priority
+	// @return false if no budget calculated yet, data should be sent directly
+	//
+	bool EnqueueData(const com::Buffer& buf, DataPriroity priority);
+
+	//
+	// @brief Pop data with high priority first
+	//
+	bool DequeueData(com::Buffer& buf);
+
+	bool HasData();
 
-	void EnqueueData(const com::Buffer& buf, DataPriroity priority);
 	void SetPacingRate(uint32_t rate_kbps);
 	void SetPacingFactor(double factor);
-	void OnProbeSent(uint32_t size);
+
+	//
+	// @brief Calculate bytes to send for next period
+	//
+	uint64_t UpdateIntervalSendBytes();
+
+	//
+	// @brief Adjust inner pacing factor by packets left after sending
+	//
+	void OnIntervalSent();
+
+	static const uint32_t kSendIntervalMs = 5;
 
 private:
-	void OnTimer();
 	void RefreshBitrateStats(const com::Buffer& buf);
-	void UpdateIntervalSendBytes();
 
 private:
 	struct StatsEntry
@@ -56,12 +61,8 @@ private:
 	};
 
 private:
-	base::IComFactory* m_factory = nullptr;
 	IPacingSenderHandler* m_handler = nullptr;
 
-	com::ITimerMgr* m_timer_mgr = nullptr;
-	com::TimerId m_timer_id = INVALID_TIMER_ID;
-
 	// Priority packet list
 	std::list<com::Buffer> m_low_pri_list;
 	std::list<com::Buffer> m_high_pri_list;
@@ -71,7 +72,6 @@ private:
 	uint64_t m_stats_bytes = 0;
 
 	static const uint32_t kMaxStatsDurationMs = 400;
-	static const uint32_t kSendIntervalMs = 5;
 	static const uint32_t kUpdateInnerPacingRateThreshold = 16;
 	static const double kInnerPacingFactorMultiply;
 	static const uint32_t kMaxContOverflowTimes = 3;
@@ -79,8 +79,6 @@ private:
 	// Bytes to send for next period
 	uint64_t m_interval_send_bytes = 0;
 
-	std::mutex m_mutex;
-
 	uint32_t m_pacing_rate_kbps = 0;
 	double m_pacing_factor = 2.0;
 	double m_inner_pacing_factor = 1.0;
@@ -89,10 +87,38 @@ private:
 
 	uint32_t m_empty_times = 0;
 
-	uint32_t m_probe_sent_size = 0;
-
 	// 连续发送后还剩余报文的次数
 	uint32_t m_consecutive_overflows = 0;
 };
 
+//==============================================================================
+// 
+//==============================================================================
+class PacingSender
+{
+public:
+	PacingSender(base::IComFactory* factory, IPacingSenderHandler* handler);
+	~PacingSender();
+
+	void EnqueueData(const com::Buffer& buf, DataPriroity priority);
+	void SetPacingRate(uint32_t rate_kbps);
+	void SetPacingFactor(double factor);
+	void OnProbeSent(uint32_t size);
+
+private:
+	void OnTimer();
+
+private:
+	base::IComFactory* m_factory = nullptr;
+
+	com::ITimerMgr* m_timer_mgr = nullptr;
+	com::TimerId m_timer_id = INVALID_TIMER_ID;
+
+	PacingFlow m_flow;
+
+	std::mutex m_mutex;
+
+	uint32_t m_probe_sent_size = 0;
+};
+
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "recv-tracker.h"
+#include "log.h"
+
+#include <bitset>
+
+#ifdef _WINDOWS
+#include <intrin.h>
+#endif
+
+
+namespace jukey::txp
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+RecvTracker::RecvTracker()
+	: m_bits(kWindowSize / 64, 0)
+	, m_reported(kWindowSize / 64, 0)
+	, m_recv_ms(kWindowSize, 0)
+{
+	static_assert((kWindowSize & kWindowMask) == 0 && kWindowSize % 64 == 0,
+		"Window size must be power of two");
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint32_t RecvTracker::CountTrailingZeros(uint64_t word)
+{
+#ifdef _WINDOWS
+	unsigned long index = 0;
+	_BitScanForward64(&index, word);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctzll(word);
+#endif
+}
+
+//------------------------------------------------------------------------------
+// POPCNT instruction is not available on every CPU, compiler picks the best
+// implementation for target
+//------------------------------------------------------------------------------
+uint32_t RecvTracker::PopCount(uint64_t word)
+{
+	return (uint32_t)std::bitset<64>(word).count();
+}
+
+//------------------------------------------------------------------------------
+// Sequences slid into the window are cleared, word by word if possible
+//------------------------------------------------------------------------------
+void RecvTracker::ClearRange(uint32_t begin_seq, uint32_t end_seq)
+{
+	if (end_seq - begin_seq + 1 >= kWindowSize) {
+		std::fill(m_bits.begin(), m_bits.end(), 0);
+		std::fill(m_reported.begin(), m_reported.end(), 0);
+		return;
+	}
+
+	uint32_t seq = begin_seq;
+	uint32_t remaining = end_seq - begin_seq + 1;
+
+	while (remaining > 0) {
+		uint32_t bit = seq & 63;
+		uint32_t n = std::min(64 - bit, remaining);
+		uint64_t mask = (n == 64) ? ~0ull : (((1ull << n) - 1) << bit);
+
+		m_bits[(seq & kWindowMask) >> 6] &= ~mask;
+		m_reported[(seq & kWindowMask) >> 6] &= ~mask;
+
+		seq += n;
+		remaining -= n;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Bits of [seq, seq + n) where n stops at word boundary or remaining
+//------------------------------------------------------------------------------
+uint64_t RecvTracker::LoadWord(uint32_t seq, uint32_t remaining,
+	uint32_t& n) const
+{
+	uint32_t bit = seq & 63;
+	n = std::min(64 - bit, remaining);
+
+	uint64_t word = m_bits[(seq & kWindowMask) >> 6] >> bit;
+	if (n < 64) {
+		word &= (1ull << n) - 1;
+	}
+
+	return word;
+}
+
+//------------------------------------------------------------------------------
+// Begin sequence is limited to the window, false if no sequence left
+//------------------------------------------------------------------------------
+bool RecvTracker::ClampBegin(uint32_t& begin_seq) const
+{
+	if (SeqLess()(m_max_seq, begin_seq)) {
+		return false;
+	}
+
+	if (m_max_seq - begin_seq >= kWindowSize) {
+		begin_seq = m_max_seq - kWindowSize + 1;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void RecvTracker::OnRecvPacket(uint32_t seq, uint64_t now_us)
+{
+	if (m_empty) {
+		m_max_seq = seq;
+		m_empty = false;
+	}
+	else if (SeqLess()(m_max_seq, seq)) {
+		ClearRange(m_max_seq + 1, seq);
+		m_max_seq = seq;
+	}
+	else if (m_max_seq - seq >= kWindowSize) {
+		LOG_DBG("Ignore packet out of window, seq:{}, max:{}", seq, m_max_seq);
+		return;
+	}
+
+	uint64_t& word = m_bits[(seq & kWindowMask) >> 6];
+	uint64_t bit = 1ull << (seq & 63);
+
+	// Duplicated packet
+	if (word & bit) {
+		return;
+	}
+
+	word |= bit;
+	m_recv_ms[seq & kWindowMask] = (uint32_t)(now_us / 1000);
+	m_recv_count++;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool RecvTracker::IsReceived(uint32_t seq) const
+{
+	if (m_empty || SeqLess()(m_max_seq, seq) || m_max_seq - seq >= kWindowSize) {
+		return false;
+	}
+
+	return (m_bits[(seq & kWindowMask) >> 6] >> (seq & 63)) & 1;
+}
+
+//------------------------------------------------------------------------------
+// Received count by popcount, loss runs by scanning zero bits a word at a time
+//------------------------------------------------------------------------------
+RecvLossStats RecvTracker::CalcLossStats(uint32_t begin_seq) const
+{
+	RecvLossStats stats;
+
+	if (m_empty || !ClampBegin(begin_seq)) {
+		return stats;
+	}
+
+	// Skip loss before the first received packet
+	uint32_t seq = begin_seq;
+	uint32_t remaining = m_max_seq - begin_seq + 1;
+	while (remaining > 0) {
+		uint32_t n = 0;
+		uint64_t word = LoadWord(seq, remaining, n);
+		if (word) {
+			uint32_t bit = CountTrailingZeros(word);
+			seq += bit;
+			remaining -= bit;
+			break;
+		}
+		seq += n;
+		remaining -= n;
+	}
+
+	stats.total_count = remaining;
+
+	uint32_t loss_run = 0;
+
+	while (remaining > 0) {
+		uint32_t n = 0;
+		uint64_t word = LoadWord(seq, remaining, n);
+
+		stats.recv_count += PopCount(word);
+
+		if (word == 0) {
+			loss_run += n;
+		}
+		else {
+			uint32_t i = 0;
+			while (i < n) {
+				uint64_t rest = word >> i;
+				if (rest == 0) {
+					loss_run += n - i;
+					break;
+				}
+
+				// Zero bits before next received packet
+				uint32_t zeros = CountTrailingZeros(rest);
+				loss_run += zeros;
+				if (loss_run > stats.max_consecutive_loss) {
+					stats.max_consecutive_loss = loss_run;
+				}
+				loss_run = 0;
+				i += zeros;
+
+				// Received packets, bits over n are zero in word
+				uint64_t ones = ~(word >> i);
+				i += (ones == 0) ? (64 - i) : CountTrailingZeros(ones);
+			}
+		}
+
+		seq += n;
+		remaining -= n;
+	}
+
+	stats.lost_count = stats.total_count - stats.recv_count;
+
+	return stats;
+}
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+
+#include "common-struct.h"
+
+namespace jukey::txp
+{
+
+//==============================================================================
+// Wrap-around safe ordering of 32 bits sequence
+//==============================================================================
+struct SeqLess
+{
+	bool operator()(uint32_t a, uint32_t b) const
+	{
+		return (int32_t)(a - b) < 0;
+	}
+};
+
+//==============================================================================
+// 
+//==============================================================================
+struct RecvLossStats
+{
+	uint32_t recv_count = 0;
+	uint32_t lost_count = 0;
+	uint32_t total_count = 0;
+	uint32_t max_consecutive_loss = 0;
+};
+
+//==============================================================================
+// Original(not retransmitted) packets received in a sliding window of sequence,
+// one bit and one arrival time per sequence. Loss statistics, NACK generation
+// and transport feedback share one tracker. Another bit per sequence records
+// whether the packet has been reported by transport feedback, so packets
+// arriving late or out of order are reported by the next feedback.
+//==============================================================================
+class RecvTracker
+{
+public:
+	RecvTracker();
+
+	void OnRecvPacket(uint32_t seq, uint64_t now_us);
+
+	bool IsReceived(uint32_t seq) const;
+
+	bool Empty() const { return m_empty; }
+	uint32_t MaxSeq() const { return m_max_seq; }
+
+	// Count of distinct packets received, late arrivals included
+	uint64_t RecvCount() const { return m_recv_count; }
+
+	// Loss between the first received packet from begin_seq and max sequence
+	RecvLossStats CalcLossStats(uint32_t begin_seq) const;
+
+	// Visit received packets not reported yet from begin_seq in order of
+	// sequence and mark them reported, return count of visited packets
+	template<class F> uint32_t ForEachUnreported(uint32_t begin_seq, F func)
+	{
+		if (m_empty || !ClampBegin(begin_seq)) return 0;
+
+		uint32_t count = 0;
+		uint32_t seq = begin_seq;
+		uint32_t remaining = m_max_seq - begin_seq + 1;
+
+		while (remaining > 0) {
+			uint32_t n = 0;
+			uint64_t word = LoadWord(seq, remaining, n);
+
+			uint32_t index = (seq & kWindowMask) >> 6;
+			uint32_t shift = seq & 63;
+
+			word &= ~(m_reported[index] >> shift);
+			m_reported[index] |= word << shift;
+
+			while (word) {
+				uint32_t bit = CountTrailingZeros(word);
+				uint32_t s = seq + bit;
+				func(s, m_recv_ms[s & kWindowMask]);
+				word &= word - 1;
+				count++;
+			}
+
+			seq += n;
+			remaining -= n;
+		}
+
+		return count;
+	}
+
+private:
+	bool ClampBegin(uint32_t& begin_seq) const;
+	void ClearRange(uint32_t begin_seq, uint32_t end_seq);
+	uint64_t LoadWord(uint32_t seq, uint32_t remaining, uint32_t& n) const;
+
+	static uint32_t CountTrailingZeros(uint64_t word);
+	static uint32_t PopCount(uint64_t word);
+
+private:
+	static const uint32_t kWindowSize = 16384; // must be power of two
+	static const uint32_t kWindowMask = kWindowSize - 1;
+
+	std::vector<uint64_t> m_bits;
+	std::vector<uint64_t> m_reported;
+	std::vector<uint32_t> m_recv_ms;
+
+	uint32_t m_max_seq = 0;
+	uint64_t m_recv_count = 0;
+	bool m_empty = true;
+};
+
+}
@@ -0,0 +1,59 @@
+#include "relay-seq-filter.h"
+
+namespace jukey::txp
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool RelaySeqFilter::Check(uint32_t seq)
+{
+	if (!m_started) {
+		m_started = true;
+		m_max_seq = seq;
+		m_relayed.set(seq % kWindowSize);
+		return true;
+	}
+
+	int32_t diff = (int32_t)(seq - m_max_seq);
+
+	if (diff > 0) {
+		// Slots of the skipped sequences are reused
+		if ((uint32_t)diff >= kWindowSize) {
+			m_relayed.reset();
+		}
+		else {
+			for (uint32_t s = m_max_seq + 1; s != seq; s++) {
+				m_relayed.reset(s % kWindowSize);
+			}
+		}
+
+		m_max_seq = seq;
+		m_relayed.set(seq % kWindowSize);
+		return true;
+	}
+
+	// Too old to tell, receiver has given up on it anyway
+	if ((uint32_t)(-(int64_t)diff) >= kWindowSize) {
+		return false;
+	}
+
+	if (m_relayed.test(seq % kWindowSize)) {
+		return false;
+	}
+
+	m_relayed.set(seq % kWindowSize);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void RelaySeqFilter::Reset()
+{
+	m_relayed.reset();
+	m_max_seq = 0;
+	m_started = false;
+}
+
+}
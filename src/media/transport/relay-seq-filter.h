@@ -0,0 +1,34 @@
+#pragma once
+
+#include <inttypes.h>
+#include <bitset>
+
+namespace jukey::txp
+{
+
+//==============================================================================
+// Remembers the publisher sequences relayed recently. The publisher may
+// retransmit a packet which has been received already (NACK sent before the
+// packet arrived, or lost NACK response retried), such a packet must not be
+// relayed again. Sequences older than the window are treated as relayed.
+//==============================================================================
+class RelaySeqFilter
+{
+public:
+	//
+	// @brief Check and mark the sequence
+	// @return true if the sequence is relayed for the first time
+	//
+	bool Check(uint32_t seq);
+
+	void Reset();
+
+private:
+	static const uint32_t kWindowSize = 4096;
+
+	std::bitset<kWindowSize> m_relayed;
+	uint32_t m_max_seq = 0;
+	bool m_started = false;
+};
+
+}
@@ -22,7 +22,6 @@ ServerStreamSender::ServerStreamSender(base::IComFactory* factory,
 	: ProxyUnknown(nullptr)
 	, ComObjTracer(factory, CID_SERVER_STREAM_SENDER, owner)
 	, m_factory(factory)
-	, m_pacing_sender(factory, this)
 {
 
 }
@@ -32,6 +31,11 @@ ServerStreamSender::ServerStreamSender(base::IComFactory* factory,
 //------------------------------------------------------------------------------
 ServerStreamSender::~ServerStreamSender()
 {
+	if (m_pacing_scheduler && m_pacing_flow != INVALID_PACING_FLOW_ID) {
+		m_pacing_scheduler->RemoveFlow(m_pacing_flow);
+		m_pacing_flow = INVALID_PACING_FLOW_ID;
+	}
+
 	if (m_congestion_controller) {
 		m_congestion_controller->Release();
 		m_congestion_controller = nullptr;
@@ -69,15 +73,23 @@ void* ServerStreamSender::NDQueryInterface(const char* riid)
 // 
 //------------------------------------------------------------------------------
 ErrCode ServerStreamSender::Init(IStreamSenderHandler* sender_handler, 
-	IFeedbackHandler* feedback_handler, uint32_t channel_id, uint32_t user_id, 
-	const com::MediaStream& stream)
+	IFeedbackHandler* feedback_handler, IPacingScheduler* pacing_scheduler,
+	uint32_t channel_id, uint32_t user_id, const com::MediaStream& stream)
 {
+	if (!pacing_scheduler) {
+		LOG_ERR("Invalid pacing scheduler!");
+		return ERR_CODE_INVALID_PARAM;
+	}
+
 	m_sender_handler = sender_handler;
 	m_feedback_handler = feedback_handler;
 	m_channel_id = channel_id;
 	m_user_id = user_id;
 	m_stream = stream;
 
+	m_pacing_scheduler = pacing_scheduler;
+	m_pacing_flow = m_pacing_scheduler->AddFlow(this);
+
 	m_congestion_controller = (cc::ICongetionController*)QI(
 		CID_GCC_CONGESTION_CONTROLLER, IID_GCC_CONGESTION_CONTROLLER,
 		"server stream sender");
@@ -187,20 +199,84 @@ void ServerStreamSender::OnAddPacket(const com::Buffer& buf)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void ServerStreamSender::InputFecFrameData(const com::Buffer& buf)
+void ServerStreamSender::RewriteGroup(prot::FecHdr* hdr, FecFramePath path)
 {
-	// 切流
+	GroupMapping& mapping = (path == FecFramePath::FFP_RELAY) 
+		? m_relay_group : m_encode_group;
+
+	if (path != m_last_path) {
+		LOG_INF("Switch fec frame path from {} to {}, channel:{}",
+			(uint32_t)m_last_path, (uint32_t)path, m_channel_id);
+		m_last_path = path;
+		mapping.pending = true;
+	}
 
+	// Group is not used without FEC
+	if (FEC_K(hdr) == 0) {
+		return;
+	}
+
+	if (mapping.pending) {
+		mapping.offset = (uint16_t)(m_next_group - hdr->group);
+		mapping.pending = false;
+	}
+
+	hdr->group = (uint16_t)(hdr->group + mapping.offset);
+
+	if ((int16_t)(hdr->group + 1 - m_next_group) > 0) {
+		m_next_group = hdr->group + 1;
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void ServerStreamSender::SendFecFrame(const com::Buffer& buf, 
+	FecFramePath path)
+{
 	// 根据 R 值过滤 FEC 报文
 
 	// 更新序列号
 	prot::FecHdr* hdr = (prot::FecHdr*)DP(buf);
 	hdr->seq = m_seq_allocator.AllocSeq();
 
+	RewriteGroup(hdr, path);
+
 	// GCC
 	OnAddPacket(buf);
 
-	m_pacing_sender.EnqueueData(buf, DP_LOW);
+	m_pacing_scheduler->EnqueueData(m_pacing_flow, buf, DP_LOW);
+}
+
+//------------------------------------------------------------------------------
+// Frame is shared by all senders, header is rewritten on a copy
+//------------------------------------------------------------------------------
+void ServerStreamSender::InputFecFrameData(const com::Buffer& buf)
+{
+	SendFecFrame(com::Buffer(DP(buf), buf.data_len), FecFramePath::FFP_ENCODE);
+}
+
+//------------------------------------------------------------------------------
+// Called when moving to another FEC tier, group numbers of the new encoder are
+// not related to the old ones
+//------------------------------------------------------------------------------
+void ServerStreamSender::ResetFecGroup()
+{
+	m_encode_group.pending = true;
+}
+
+//------------------------------------------------------------------------------
+// Frame is shared by all senders, header is rewritten on a copy
+//------------------------------------------------------------------------------
+void ServerStreamSender::InputRelayData(const com::Buffer& buf)
+{
+	com::Buffer frame(DP(buf), buf.data_len);
+
+	// Retransmission from publisher is new data for receiver
+	prot::FecHdr* hdr = (prot::FecHdr*)DP(frame);
+	hdr->rtx = 0;
+
+	SendFecFrame(frame, FecFramePath::FFP_RELAY);
 }
 
 //------------------------------------------------------------------------------
@@ -263,11 +339,16 @@ void ServerStreamSender::OnNackFeedback(const com::Buffer& buf)
 		nack_list.push_back(seq);
 	}
 
-	std::vector<com::Buffer> pkts;
-	m_feedback_handler->OnNackRequest(m_channel_id, m_user_id, nack_list, pkts);
+	// Sequence is allocated by this sender, so is the history
+	com::Buffer pkt;
 	
 	// NACK 响应不经过 pacer，直接发送
-	for (const auto& pkt : pkts) {
+	for (auto seq : nack_list) {
+		if (!m_nack_history.FindFecFrameData(seq, pkt)) {
+			LOG_WRN("Cannot find nack packet, seq:{}", seq);
+			continue;
+		}
+
 		prot::FecHdr* hdr = (prot::FecHdr*)DP(pkt);
 		LOG_INF("Send nack response, seq:{}, k:{}, r:{}, group:{}, gseq:{}", 
 			hdr->seq, FEC_K(hdr), FEC_R(hdr), hdr->group, (uint32_t)hdr->gseq);
@@ -375,6 +456,9 @@ void ServerStreamSender::OnPacingData(const com::Buffer& buf)
 	LOG_DBG("<<< Send pacing packet, seq:{}", hdr->seq);
 
 	m_sender_handler->OnStreamData(m_channel_id, m_user_id, m_stream, buf);
+
+	// Save for nack request, buffer is referenced not copied
+	m_nack_history.SaveFecFrameData(buf);
 }
 
 //------------------------------------------------------------------------------
@@ -384,9 +468,11 @@ void ServerStreamSender::OnBandwidthUpdate(uint32_t bw_kbps)
 {
 	LOG_INF("Update bandwidth: {} kbps", bw_kbps);
 
-	m_pacing_sender.SetPacingRate(bw_kbps);
+	m_pacing_scheduler->SetPacingRate(m_pacing_flow, bw_kbps);
 
-	// TODO: 基于带宽进行分层切换和FEC过滤
+	// Simulcast layer is selected by server
+	m_sender_handler->OnEncoderTargetBitrate(m_channel_id, m_user_id, m_stream,
+		bw_kbps);
 }
 
 //------------------------------------------------------------------------------
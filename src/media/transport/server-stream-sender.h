@@ -8,15 +8,23 @@
 #include "com-obj-tracer.h"
 #include "thread/common-thread.h"
 #include "frame-packer.h"
-#include "pacing-sender.h"
 #include "if-stream-server.h"
-#include "pacing-sender.h"
 #include "if-congestion-controller.h"
 #include "seq-allocator.h"
+#include "nack-history.h"
 
 namespace jukey::txp
 {
 
+//==============================================================================
+// Where the FEC frame sent to receiver comes from
+//==============================================================================
+enum class FecFramePath
+{
+	FFP_ENCODE = 0, // re-encoded by server
+	FFP_RELAY  = 1, // relayed from publisher
+};
+
 //==============================================================================
 // TODO: thread
 //==============================================================================
@@ -39,6 +47,7 @@ public:
 	// IStreamSender
 	virtual com::ErrCode Init(IStreamSenderHandler* sender_handler,
 		IFeedbackHandler* feedback_handler, 
+		IPacingScheduler* pacing_scheduler,
 		uint32_t channel_id,
 		uint32_t user_id,
 		const com::MediaStream& stream) override;
@@ -47,6 +56,8 @@ public:
 	virtual uint32_t ChannelId() override;
 	virtual uint32_t UserId() override;
 	virtual void InputFecFrameData(const com::Buffer& buf) override;
+	virtual void ResetFecGroup() override;
+	virtual void InputRelayData(const com::Buffer& buf) override;
 	virtual void InputFeedbackData(const com::Buffer& buf) override;
 
 	// IPacingSenderHandler
@@ -67,6 +78,8 @@ private:
 	void OnAddPacket(const com::Buffer& buf);
 	void OnSentPacket(const com::Buffer& buf);
 	void OnTransportFeedback(const com::Buffer& buf);
+	void SendFecFrame(const com::Buffer& buf, FecFramePath path);
+	void RewriteGroup(prot::FecHdr* hdr, FecFramePath path);
 
 private:
 	base::IComFactory* m_factory = nullptr;
@@ -77,9 +90,23 @@ private:
 	IFeedbackHandler* m_feedback_handler = nullptr;
 	std::mutex m_mutex;
 	uint32_t m_seq = 0; // TODO: wrap around
-	PacingSender m_pacing_sender;
+	IPacingScheduler* m_pacing_scheduler = nullptr;
+	PacingFlowId m_pacing_flow = INVALID_PACING_FLOW_ID;
 	cc::ICongetionController* m_congestion_controller = nullptr;
 	SeqAllocator m_seq_allocator;
+	NackHistory m_nack_history;
+
+	// Groups of both paths are mapped into one increasing group space, or the
+	// receiver drops the groups after switching path as already pushed
+	struct GroupMapping
+	{
+		uint16_t offset = 0;
+		bool pending = true; // offset is set by the next FEC group
+	};
+	GroupMapping m_encode_group;
+	GroupMapping m_relay_group;
+	FecFramePath m_last_path = FecFramePath::FFP_ENCODE;
+	uint16_t m_next_group = 0;
 };
 
 }
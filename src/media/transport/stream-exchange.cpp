@@ -16,6 +16,7 @@ StreamExchange::StreamExchange(base::IComFactory* factory, const char* owner)
 	: ProxyUnknown(nullptr)
 	, ComObjTracer(factory, CID_STREAM_EXCHAGE, owner)
 	, m_factory(factory)
+	, m_pacing_scheduler(factory)
 {
 
 }
@@ -115,7 +116,8 @@ IStreamServerSP StreamExchange::FindOrCreateStreamServer(
 	if (!server) {
 		LOG_INF("Cannot find stream server, then create");
 
-		server.reset(new StreamServer(m_factory, this, m_thread, stream));
+		server.reset(new StreamServer(m_factory, this, m_thread,
+			&m_pacing_scheduler, stream));
 
 		m_stream_servers.insert(std::make_pair(channel_id, server));
 
@@ -278,12 +280,24 @@ void StreamExchange::OnSendChannelMsg(uint32_t channel_id, uint32_t user_id,
 }
 
 //------------------------------------------------------------------------------
-// 
+// Collected if a relay fan-out or pacing burst is in progress
 //------------------------------------------------------------------------------
 void StreamExchange::OnSendChannelData(uint32_t channel_id, uint32_t user_id,
 	uint32_t mt, const com::Buffer& buf)
 {
+	if (ChannelSendBatch::Add(this, ChannelData(channel_id, user_id, mt, buf))) {
+		return;
+	}
+
 	m_handler->OnSendChannelData(channel_id, user_id, mt, buf);
 }
 
+//------------------------------------------------------------------------------
+// IChannelBatchSink
+//------------------------------------------------------------------------------
+void StreamExchange::OnSendChannelBatch(const std::vector<ChannelData>& datas)
+{
+	m_handler->OnSendChannelData(datas);
+}
+
 }
\ No newline at end of file
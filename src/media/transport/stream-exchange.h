@@ -10,6 +10,8 @@
 #include "proxy-unknown.h"
 #include "com-obj-tracer.h"
 #include "thread/common-thread.h"
+#include "pacing-scheduler.h"
+#include "channel-send-batch.h"
 
 namespace jukey::txp
 {
@@ -22,6 +24,7 @@ class StreamExchange
 	, public base::ProxyUnknown
 	, public base::ComObjTracer
 	, public IServerHandler
+	, public IChannelBatchSink
 {
 public:
 	StreamExchange(base::IComFactory* factory, const char* owner);
@@ -53,6 +56,10 @@ public:
 	virtual void OnSendChannelData(uint32_t channel_id, uint32_t user_id,
 		uint32_t mt, const com::Buffer& buf) override;
 
+	// IChannelBatchSink
+	virtual void OnSendChannelBatch(const std::vector<ChannelData>& datas)
+		override;
+
 private:
 	IStreamServerSP FindOrCreateStreamServer(const com::MediaStream& stream,
 		uint32_t channel_id);
@@ -62,6 +69,9 @@ private:
 	util::IThread* m_thread = nullptr;
 	IExchangeHandler* m_handler = nullptr;
 
+	// Shared by all stream servers, must be destroyed after them
+	PacingScheduler m_pacing_scheduler;
+
 	// channel(src channel and dst channel):IStreamServer
 	std::unordered_map<uint32_t, IStreamServerSP> m_stream_servers;
 	std::mutex m_mutex;
@@ -4,8 +4,11 @@
 #include "util-streamer.h"
 #include "common/util-time.h"
 #include "transport-common.h"
+#include "common-config.h"
 #include "if-congestion-controller.h"
 
+#include <algorithm>
+
 
 using namespace jukey::com;
 using namespace jukey::util;
@@ -89,6 +92,8 @@ void StreamReceiver::InitStats()
 {
 	m_data_stats.reset(new util::DataStats(m_factory, g_txp_logger,
 		m_stream.stream.stream_id, false));
+	m_data_stats->SetMetricsScope("stream_receiver",
+		{ { "stream", m_stream.stream.stream_id } });
 	m_data_stats->Start();
 
 	StatsParam i_rtx_send("rtx_send", StatsType::IACCU, 2000);
@@ -120,7 +125,7 @@ ErrCode StreamReceiver::Init(IStreamReceiverHandler* handler,
 		m_frame_unpacker.reset(new VideoFrameUnpacker(this));
 	}
 
-	m_nack_requester.reset(new NackRequester(m_factory, this));
+	m_nack_requester.reset(new NackRequester(m_factory, this, &m_recv_tracker));
 
 	InitTimer();
 	InitStats();
@@ -142,36 +147,29 @@ StreamReceiver::LossStats StreamReceiver::CalcOriginLossStats()
 	// 更新起始统计时间
 	m_start_time_us = util::Now();
 
-	if (m_b_rcvr_pkt.empty()) {
+	if (m_recv_tracker.Empty()
+		|| SeqLess()(m_recv_tracker.MaxSeq(), m_loss_begin_seq)) {
 		return stats;
 	}
 
-	uint32_t loss_count = 0;
-	uint32_t prev_seq = *(m_b_rcvr_pkt.begin());
+	// Expected packets are the new sequences of this period, received packets
+	// include the late ones of previous periods, which were counted as lost
+	uint32_t expected = m_recv_tracker.MaxSeq() - m_loss_begin_seq + 1;
+	uint64_t received = m_recv_tracker.RecvCount() - m_loss_recv_count;
 
-	for (auto iter = m_b_rcvr_pkt.begin(); iter != m_b_rcvr_pkt.end(); iter++) {
-		if ((*iter) > prev_seq + 1) {
-			uint32_t count = (*iter) - prev_seq - 1;
-			loss_count += count;
-			if (count > stats.max_consecutive_loss) {
-				stats.max_consecutive_loss = count;
-			}
-		}
-		prev_seq = (*iter);
-	}
-
-	// 统计总报文数量
-	uint32_t total_pkt = (*m_b_rcvr_pkt.rbegin()) - (*m_b_rcvr_pkt.begin()) + 1;
+	stats.recv_count = (uint32_t)std::min<uint64_t>(received, expected);
+	stats.lost_count = expected - stats.recv_count;
 
 	// 计算丢包率，转换成百分比
 	stats.loss_rate = static_cast<uint32_t>(std::ceil(
-		static_cast<double>(loss_count) * 100 / total_pkt));
+		static_cast<double>(stats.lost_count) * 100 / expected));
 
-	stats.recv_count = m_b_rcvr_pkt.size();
-	stats.lost_count = loss_count;
+	RecvLossStats loss = m_recv_tracker.CalcLossStats(m_loss_begin_seq);
+	stats.max_consecutive_loss = loss.max_consecutive_loss;
 
-	// 计算完后清空，进入下一个统计周期
-	m_b_rcvr_pkt.clear();
+	// 进入下一个统计周期
+	m_loss_begin_seq = m_recv_tracker.MaxSeq() + 1;
+	m_loss_recv_count = m_recv_tracker.RecvCount();
 
 	return stats;
 }
@@ -279,12 +277,23 @@ com::Buffer StreamReceiver::BuildTransportFeedback()
 	auto adapter = (cc::IWebrtcTfbAdapter*)m_factory->QueryInterface(
 		CID_WEBRTC_TFB_ADAPTER, IID_WEBRTC_TFB_ADAPTER, "stream receiver");
 
-	adapter->Init((uint16_t)m_received_pkts.begin()->first, 
-		(uint32_t)(m_received_pkts.begin()->second / 1000), m_feedback_sn++);
-	for (auto [seq, ts] : m_received_pkts) {
-		adapter->AddReceivedPacket((uint16_t)seq, (uint32_t)(ts / 1000));
-		LOG_DBG(">>> seq:{}, ts:{}", (uint16_t)seq, (uint32_t)(ts / 1000));
+	bool init = false;
+	m_recv_tracker.ForEachUnreported(m_tfb_begin_seq,
+		[&](uint32_t seq, uint32_t ts) {
+			if (!init) {
+				adapter->Init((uint16_t)seq, ts, m_feedback_sn++);
+				init = true;
+			}
+			adapter->AddReceivedPacket((uint16_t)seq, ts);
+			LOG_DBG(">>> seq:{}, ts:{}", (uint16_t)seq, ts);
+		});
+
+	// No packet received since last feedback
+	if (!init) {
+		adapter->Release();
+		return com::Buffer();
 	}
+
 	com::Buffer fb_buf = adapter->Serialize();
 
 	uint32_t buf_len = sizeof(TLV) + fb_buf.data_len;
@@ -308,11 +317,20 @@ void StreamReceiver::SendTransportFeedback()
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
 
-	if (m_received_pkts.empty()) return;
+	if (m_recv_tracker.Empty()) {
+		return;
+	}
 
 	com::Buffer buf = BuildTransportFeedback();
+	if (buf.data_len == 0) {
+		return;
+	}
 
-	m_received_pkts.clear(); // 清理数据，进入下一个统计周期
+	// Packets arriving late are reported by next feedback, if not too late
+	uint32_t late_begin_seq = m_recv_tracker.MaxSeq() + 1 - TFB_LATE_SEQ_COUNT;
+	if (SeqLess()(m_tfb_begin_seq, late_begin_seq)) {
+		m_tfb_begin_seq = late_begin_seq;
+	}
 
 	m_handler->OnReceiverFeedback(m_channel_id, m_user_id, m_stream, buf);
 
@@ -370,10 +388,13 @@ void StreamReceiver::InputStreamData(const com::Buffer& buf)
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
 		if (fec_hdr->rtx == 0) {
-			// 原始丢包统计
-			m_b_rcvr_pkt.insert(fec_hdr->seq);
-			// Transport Feedback
-			m_received_pkts.insert(std::make_pair(fec_hdr->seq, util::Now()));
+			if (m_recv_tracker.Empty()) {
+				m_loss_begin_seq = fec_hdr->seq;
+				m_loss_recv_count = 0;
+				m_tfb_begin_seq = fec_hdr->seq;
+			}
+			// 原始丢包统计，NACK 和 Transport Feedback
+			m_recv_tracker.OnRecvPacket(fec_hdr->seq, util::Now());
 		}
 	}
 
@@ -385,8 +406,6 @@ void StreamReceiver::InputStreamData(const com::Buffer& buf)
 	if (seg_hdr->mt != (uint8_t)SegPktType::SPT_PADDING) {
 		m_fec_decoder.WriteFecFrame(buf);
 	}
-
-	m_nack_requester->OnPreRecvPacket(fec_hdr->seq);
 }
 
 //------------------------------------------------------------------------------
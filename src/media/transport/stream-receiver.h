@@ -13,6 +13,7 @@
 #include "frame-unpacker.h"
 #include "if-timer-mgr.h"
 #include "nack-requester.h"
+#include "recv-tracker.h"
 #include "common/util-stats.h"
 
 namespace jukey::txp
@@ -103,8 +104,12 @@ private:
 	FecDecoder m_fec_decoder;
 	IFrameUnpackerUP m_frame_unpacker;
 
-	// 补偿前丢包统计(seq) - before recover
-	std::set<uint32_t> m_b_rcvr_pkt;
+	// 补偿前丢包统计(seq) - before recover, also used by NACK and transport 
+	// feedback
+	RecvTracker m_recv_tracker;
+	uint32_t m_loss_begin_seq = 0;
+	uint64_t m_loss_recv_count = 0; // received count when period begins
+	uint32_t m_tfb_begin_seq = 0;
 	uint64_t m_start_time_us = 0;
 
 	// 补偿后丢帧统计(fseq)
@@ -125,8 +130,6 @@ private:
 	uint32_t m_last_send_rtt_seq = 0;
 	uint32_t m_last_recv_rtt_seq = 0;
 
-	std::map<uint32_t, uint64_t> m_received_pkts;
-
 	uint8_t m_feedback_sn = 0;
 };
 
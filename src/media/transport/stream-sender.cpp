@@ -410,8 +410,7 @@ void StreamSender::OnPacingData(const com::Buffer& buf)
 	// Callback to send
 	m_handler->OnStreamData(m_channel_id, m_user_id, m_stream, buf);
 
-	// Save for nack request
-	// Must call after sending for it will change the rtx bit
+	// Save for nack request, buffer is referenced not copied
 	m_nack_history.SaveFecFrameData(buf);
 }
 
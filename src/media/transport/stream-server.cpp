@@ -1,7 +1,10 @@
 ﻿#include "stream-server.h"
+#include "channel-send-batch.h"
 #include "log.h"
 #include "protocol.h"
+#include "common-config.h"
 #include "common/util-pb.h"
+#include "common/util-time.h"
 #include "util-streamer.h"
 
 using namespace jukey::com;
@@ -11,22 +14,31 @@ using namespace jukey::util;
 namespace jukey::txp
 {
 
+//------------------------------------------------------------------------------
+// Percentage of redundant packets
+//------------------------------------------------------------------------------
+static uint32_t ProtectionRate(uint8_t k, uint8_t r)
+{
+	return (k == 0) ? 0 : (r * 100 / (k + r));
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
 StreamServer::StreamServer(base::IComFactory* factory, IServerHandler* handler, 
-	IThread* thread, const com::MediaStream& stream)
+	IThread* thread, IPacingScheduler* pacing_scheduler,
+	const com::MediaStream& stream)
 	: m_factory(factory)
-	, m_fec_encoder(this, &m_seq_allocator)
 	, m_frame_packer(stream.stream.stream_type, this)
-	, m_fec_param_controller(this, 0, 0)
 {
 	assert(factory);
 	assert(handler);
 	assert(thread);
+	assert(pacing_scheduler);
 
 	m_handler = handler;
 	m_thread = thread;
+	m_pacing_scheduler = pacing_scheduler;
 	m_stream = stream;
 	m_timer_mgr = QUERY_TIMER_MGR(m_factory);
 
@@ -48,6 +60,8 @@ StreamServer::~StreamServer()
 		m_receiver.stream_receiver = nullptr;
 	}
 
+	m_fec_tiers.Clear();
+
 	for (auto& item : m_senders) {
 		item.second->stream_sender->Release();
 	}
@@ -157,6 +171,9 @@ void StreamServer::RemoveStreamSender()
 		m_receiver.stream_receiver->Release();
 		m_receiver.stream_receiver = nullptr;
 	}
+
+	// Sequence of next publisher starts over
+	m_relay_filter.Reset();
 }
 
 //------------------------------------------------------------------------------
@@ -183,7 +200,8 @@ ErrCode StreamServer::AddStreamReceiver(uint32_t channel_id, uint32_t user_id)
 		return ERR_CODE_FAILED;
 	}
 
-	ErrCode result = sender->Init(this, this, channel_id, user_id, m_stream);
+	ErrCode result = sender->Init(this, this, m_pacing_scheduler, channel_id,
+		user_id, m_stream);
 	if (ERR_CODE_OK != result) {
 		LOG_ERR("Initialize stream receiver failed!");
 		return result;
@@ -191,6 +209,12 @@ ErrCode StreamServer::AddStreamReceiver(uint32_t channel_id, uint32_t user_id)
 
 	SenderInfoSP sender_info(new SenderInfo());
 	sender_info->stream_sender = sender;
+	sender_info->relay = SFU_RELAY_ENABLED && m_layer_count == 1;
+	sender_info->fec_param.reset(new ReceiverFecParam());
+
+	if (!sender_info->relay) {
+		JoinFecTier(channel_id, *sender_info);
+	}
 
 	m_senders.insert(std::make_pair(channel_id, sender_info));
 
@@ -204,24 +228,73 @@ ErrCode StreamServer::RemoveStreamReceiver(uint32_t channel_id)
 {
 	LOG_INF("Remove stream receiver, channel:{}", channel_id);
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	IServerStreamSender* sender = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
 
-	auto iter = m_senders.find(channel_id);
-	if (iter == m_senders.end()) {
-		LOG_ERR("Cannot find channel!");
-		return ERR_CODE_FAILED;
-	}
+		auto iter = m_senders.find(channel_id);
+		if (iter == m_senders.end()) {
+			LOG_ERR("Cannot find channel!");
+			return ERR_CODE_FAILED;
+		}
 
-	if (iter->second->stream_sender) {
-		iter->second->stream_sender->Release();
-		iter->second->stream_sender = nullptr;
+		if (!iter->second->relay) {
+			LeaveFecTier(channel_id, *iter->second);
+		}
+
+		sender = iter->second->stream_sender;
+		m_senders.erase(iter);
 	}
 
-	m_senders.erase(iter);
+	// Releasing sender waits for its congestion control callback, which may be
+	// waiting for the lock in OnEncoderTargetBitrate
+	if (sender) {
+		sender->Release();
+	}
 
 	return ERR_CODE_OK;
 }
 
+//------------------------------------------------------------------------------
+// Original FEC frames are forwarded before decoding, only the sequence and the
+// group are rewritten by each sender
+//------------------------------------------------------------------------------
+void StreamServer::RelayStreamData(const com::Buffer& buf)
+{
+	if (buf.data_len < FEC_HDR_LEN + sizeof(prot::SegHdr)) {
+		LOG_ERR("Invalid stream data len:{}", buf.data_len);
+		return;
+	}
+
+	prot::FecHdr* fec_hdr = (prot::FecHdr*)DP(buf);
+	prot::SegHdr* seg_hdr = (prot::SegHdr*)(DP(buf) + FEC_HDR_LEN);
+
+	// Padding is probing the link of publisher
+	if (seg_hdr->mt == (uint8_t)SegPktType::SPT_PADDING) {
+		return;
+	}
+
+	if (fec_hdr->rtx == 0) {
+		m_src_k = FEC_K(fec_hdr);
+		m_src_r = FEC_R(fec_hdr);
+	}
+
+	// Retransmission of a packet relayed already
+	if (!m_relay_filter.Check(fec_hdr->seq)) {
+		LOG_DBG("Drop relayed packet, seq:{}, rtx:{}", fec_hdr->seq,
+			(uint32_t)fec_hdr->rtx);
+		return;
+	}
+
+	// All relayed copies are sent in one batch
+	ChannelSendBatch send_batch;
+	for (const auto& item : m_senders) {
+		if (item.second->relay) {
+			item.second->stream_sender->InputRelayData(buf);
+		}
+	}
+}
+
 //------------------------------------------------------------------------------
 // TODO: 内存优化
 //------------------------------------------------------------------------------
@@ -229,6 +302,9 @@ void StreamServer::OnRecvStreamData(uint32_t channel_id, const com::Buffer& buf)
 {
 	if (m_receiver.stream_receiver
 		&& channel_id == m_receiver.stream_receiver->ChannelId()) {
+		RelayStreamData(buf);
+
+		// Still needed for loss statistics and NACK of publisher
 		m_receiver.stream_receiver->InputStreamData(buf);
 	}
 	else {
@@ -303,6 +379,32 @@ void StreamServer::OnRecvChannelMsg(uint32_t channel_id, const com::Buffer& buf)
 void StreamServer::OnStreamFrame(uint32_t channel_id, uint32_t user_id,
 	const com::MediaStream& stream, const com::Buffer& buf)
 {
+	uint8_t layer = 0;
+
+	if (m_stream.stream.stream_type == StreamType::VIDEO) {
+		prot::VideoFrameHdr* hdr = (prot::VideoFrameHdr*)DP(buf);
+		layer = hdr->sl;
+
+		UpdateLayerCount(layer);
+		UpdateLayerRate(layer, buf.data_len);
+
+		if (m_layer_count > 1) {
+			if (hdr->ft == 1) {
+				SwitchSenderLayer(layer);
+			}
+
+			// Layers of one input frame are numbered in turn by publisher, every
+			// receiver gets continuous frame sequence whatever layer it receives
+			hdr->fseq = (hdr->fseq - 1) / m_layer_count + 1;
+		}
+	}
+
+	// All senders are relaying, no need to pack and encode
+	if (m_fec_tiers.Empty()) {
+		return;
+	}
+
+	m_pack_layer = layer;
 	m_frame_packer.WriteFrameData(buf);
 }
 
@@ -340,23 +442,31 @@ void StreamServer::OnSenderFeedback(uint32_t channel_id, uint32_t user_id,
 void StreamServer::OnEncoderTargetBitrate(uint32_t channel_id, uint32_t user_id,
 	const com::MediaStream& stream, uint32_t bw_kbps)
 {
-	// TODO: 根据带宽调整 FEC 编码参数？？？
-}
+	// Called by congestion controller of sender in another thread, no lock is
+	// needed without simulcast
+	if (m_layer_count <= 1) {
+		return;
+	}
 
-//------------------------------------------------------------------------------
-// IFecEncodeHandler
-//------------------------------------------------------------------------------
-void StreamServer::OnFecFrameData(const com::Buffer& buf)
-{
-	LOG_DBG("OnFecFrameData");
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-	// FEC 编码出来的帧，全部扔给 Sender 取处理
-	for (auto iter : m_senders) {
-		iter.second->stream_sender->InputFecFrameData(buf);
+	auto iter = m_senders.find(channel_id);
+	if (iter == m_senders.end()) {
+		LOG_ERR("Cannot find sender, channel:{}", channel_id);
+		return;
 	}
 
-	// Save for nack request, it will change the rtx bit, so need clone.
-	m_nack_history.SaveFecFrameData(buf.Clone()); 
+	SenderInfo& sender = *iter->second;
+
+	uint8_t layer = SelectSenderLayer(sender, bw_kbps);
+	if (layer == sender.layer) {
+		sender.pending_layer = -1;
+	}
+	else if (layer != sender.pending_layer) {
+		LOG_INF("Pending layer switch, channel:{}, bw:{}, layer:{}->{}",
+			channel_id, bw_kbps, sender.layer, layer);
+		sender.pending_layer = layer;
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -366,26 +476,67 @@ void StreamServer::OnSegmentData(const com::Buffer& buf)
 {
 	LOG_DBG("OnSegmentData");
 
-	// 打包完成后进行 FEC 编码
-	m_fec_encoder.WriteSegmentData(buf);
+	// 打包完成后按各档位的参数进行 FEC 编码
+	m_fec_tiers.WriteSegmentData(m_pack_layer, buf);
 }
 
 //------------------------------------------------------------------------------
-// IFeedbackHandler
+// 
 //------------------------------------------------------------------------------
-void StreamServer::OnNackRequest(uint32_t channel_id, uint32_t user_id, 
-	const std::vector<uint32_t> nacks, std::vector<com::Buffer>& pkts)
+void StreamServer::JoinFecTier(uint32_t channel_id, SenderInfo& sender)
 {
-	com::Buffer buf;
+	uint8_t k = sender.fec_param->K();
+	uint8_t r = sender.fec_param->R();
 
-	for (auto seq : nacks) {
-		if (m_nack_history.FindFecFrameData(seq, buf)) {
-			pkts.push_back(buf);
-		}
-		else {
-			LOG_WRN("Cannot find nack packet, seq:{}", seq);
-		}
+	sender.fec_tier = m_fec_tiers.Join(sender.layer, k, r, channel_id,
+		sender.stream_sender);
+
+	LOG_INF("Join fec tier, channel:{}, layer:{}, k:{}, r:{}, tiers:{}",
+		channel_id, sender.layer, k, r, m_fec_tiers.Size());
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void StreamServer::LeaveFecTier(uint32_t channel_id, SenderInfo& sender)
+{
+	if (!m_fec_tiers.Leave(sender.fec_tier, channel_id)) {
+		LOG_ERR("Cannot find fec tier:{}", sender.fec_tier);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Sender is relayed while the protection of publisher covers its loss, the
+// re-encoding path is used only if it gives more protection
+//------------------------------------------------------------------------------
+void StreamServer::UpdateSenderPath(uint32_t channel_id, SenderInfo& sender,
+	const StateFeedback& feedback)
+{
+	uint32_t src_rate = ProtectionRate(m_src_k, m_src_r);
+	uint32_t enc_rate = ProtectionRate(sender.fec_param->K(),
+		sender.fec_param->R());
+
+	// Original FEC frames carry all simulcast layers
+	bool relay = m_layer_count == 1
+		&& (feedback.olr <= src_rate || enc_rate <= src_rate);
+	if (relay == sender.relay) {
+		sender.switch_votes = 0;
+		return;
 	}
+
+	// Avoid switching back and forth
+	if (++sender.switch_votes < SFU_RELAY_SWITCH_FEEDBACKS) {
+		return;
+	}
+
+	LOG_INF("Switch sender path, channel:{}, relay:{}, olr:{}, src:{}|{}, "
+		"enc:{}|{}", channel_id, relay, (uint32_t)feedback.olr, m_src_k, m_src_r,
+		sender.fec_param->K(), sender.fec_param->R());
+
+	sender.relay = relay;
+	sender.switch_votes = 0;
+
+	relay ? LeaveFecTier(channel_id, sender) : JoinFecTier(channel_id, sender);
 }
 
 //------------------------------------------------------------------------------
@@ -394,30 +545,118 @@ void StreamServer::OnNackRequest(uint32_t channel_id, uint32_t user_id,
 void StreamServer::OnStateFeedback(uint32_t channel_id, uint32_t user_id, 
 	const StateFeedback& feedback)
 {
-	// FIXME: 这里应该传入所有接收端的统计数据
-
-	StateFB fb;
-	fb.start_time = feedback.start_time;
-	fb.end_time   = feedback.end_time;
-	fb.recv_count = feedback.recv_count;
-	fb.lost_count = feedback.lost_count;
-	fb.rtt = feedback.rtt;
-	fb.olr = feedback.olr;
-	fb.flr = feedback.flr;
-	fb.nlr = feedback.nlr;
-	fb.clc = feedback.clc;
-	fb.flc = feedback.flc;
-	fb.fc  = feedback.fc;	
-
-	m_fec_param_controller.OnStateFeedback(fb);
+	auto iter = m_senders.find(channel_id);
+	if (iter == m_senders.end()) {
+		LOG_ERR("Cannot find sender, channel:{}", channel_id);
+		return;
+	}
+
+	SenderInfo& sender = *iter->second;
+
+	// Each receiver is protected according to its own loss
+	sender.fec_param->OnStateFeedback(feedback);
+
+	if (SFU_RELAY_ENABLED) {
+		UpdateSenderPath(channel_id, sender, feedback);
+	}
+
+	// Move to the tier matching new parameters
+	if (!sender.relay && sender.fec_tier != FecTier::Key(sender.layer,
+		sender.fec_param->K(), sender.fec_param->R())) {
+		LeaveFecTier(channel_id, sender);
+		JoinFecTier(channel_id, sender);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Relaying senders would receive all layers, they are moved to the encoding
+// path once the publisher is found sending more than one layer
+//------------------------------------------------------------------------------
+void StreamServer::UpdateLayerCount(uint8_t layer)
+{
+	if (layer < m_layer_count) {
+		return;
+	}
+
+	LOG_INF("Update simulcast layer count:{}->{}", m_layer_count.load(),
+		layer + 1);
+
+	m_layer_count = layer + 1;
+
+	for (auto& item : m_senders) {
+		SenderInfo& sender = *item.second;
+		if (sender.relay) {
+			sender.relay = false;
+			sender.switch_votes = 0;
+			JoinFecTier(item.first, sender);
+		}
+	}
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void StreamServer::OnFecParamUpdate(uint8_t k, uint8_t r)
+void StreamServer::UpdateLayerRate(uint8_t layer, uint32_t len)
+{
+	m_layer_bytes[layer] += len;
+
+	uint64_t now = util::Now();
+	if (m_layer_rate_us == 0) {
+		m_layer_rate_us = now;
+		return;
+	}
+
+	if (now < m_layer_rate_us + kLayerRateWindowMs * 1000) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < m_layer_count; i++) {
+		m_layer_kbps[i] = (uint32_t)(m_layer_bytes[i] * 8 * 1000ull
+			/ (now - m_layer_rate_us));
+		m_layer_bytes[i] = 0;
+	}
+	m_layer_rate_us = now;
+}
+
+//------------------------------------------------------------------------------
+// Layers of publisher have aligned key frames, so receiver always switches on
+// a key frame of the new layer
+//------------------------------------------------------------------------------
+void StreamServer::SwitchSenderLayer(uint8_t layer)
+{
+	for (auto& item : m_senders) {
+		SenderInfo& sender = *item.second;
+		if (sender.pending_layer != layer) {
+			continue;
+		}
+
+		LOG_INF("Switch layer, channel:{}, layer:{}->{}", item.first, sender.layer,
+			layer);
+
+		if (!sender.relay) {
+			LeaveFecTier(item.first, sender);
+		}
+
+		sender.layer = layer;
+		sender.pending_layer = -1;
+
+		if (!sender.relay) {
+			JoinFecTier(item.first, sender);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// Bandwidth left by FEC is used for media
+//------------------------------------------------------------------------------
+uint8_t StreamServer::SelectSenderLayer(const SenderInfo& sender,
+	uint32_t bw_kbps)
 {
-	m_fec_encoder.SetParam(k, r);
+	uint32_t media_kbps = bw_kbps * (100 - ProtectionRate(sender.fec_param->K(),
+		sender.fec_param->R())) / 100;
+
+	return SelectSimulcastLayer(m_layer_kbps, m_layer_count, sender.layer,
+		media_kbps);
 }
 
 }
\ No newline at end of file
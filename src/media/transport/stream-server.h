@@ -1,7 +1,9 @@
 #pragma once
 
 #include <unordered_map>
+#include <map>
 #include <mutex>
+#include <atomic>
 
 #include "com-factory.h"
 
@@ -9,11 +11,10 @@
 #include "if-stream-server.h"
 #include "server-negotiator.h"
 #include "transport-common.h"
-#include "fec-encoder.h"
 #include "frame-packer.h"
-#include "nack-history.h"
-#include "fec-param-controller.h"
-#include "seq-allocator.h"
+#include "fec-tier.h"
+#include "relay-seq-filter.h"
+#include "include/if-pacing-scheduler.h"
 
 namespace jukey::txp
 {
@@ -25,15 +26,14 @@ class StreamServer
 	: public IStreamServer
 	, public IStreamReceiverHandler
 	, public IStreamSenderHandler
-	, public IFecEncodeHandler
 	, public IFramePackHandler
 	, public IFeedbackHandler
-	, public IFecParamHandler
 {
 public:
 	StreamServer(base::IComFactory* factory, 
 		IServerHandler* handler, 
 		util::IThread* thread,
+		IPacingScheduler* pacing_scheduler,
 		const com::MediaStream& stream);
 	~StreamServer();
 
@@ -78,27 +78,26 @@ public:
 		const com::MediaStream& stream, 
 		uint32_t bw_kbps) override;
 
-	// IFecEncodeHandler
-	virtual void OnFecFrameData(const com::Buffer& buf) override;
-
 	// IFramePackHandler
 	virtual void OnSegmentData(const com::Buffer& buf) override;
 
 	// IFeedbackHandler
-	virtual void OnNackRequest(uint32_t channel_id, 
-		uint32_t user_id, 
-		const std::vector<uint32_t> nacks,
-		std::vector<com::Buffer>& pkts) override;
 	virtual void OnStateFeedback(uint32_t channel_id, 
 		uint32_t user_id, 
 		const StateFeedback& feedback) override;
 
-	// IFecParamHandler
-	virtual void OnFecParamUpdate(uint8_t k, uint8_t r) override;
-
 private:
 	void OnRecvStreamData(uint32_t channel_id, const com::Buffer& buf);
 	void OnRecvFeedback(uint32_t channel_id, const com::Buffer& buf);
+	void RelayStreamData(const com::Buffer& buf);
+	void UpdateSenderPath(uint32_t channel_id, SenderInfo& sender,
+		const StateFeedback& feedback);
+	void JoinFecTier(uint32_t channel_id, SenderInfo& sender);
+	void LeaveFecTier(uint32_t channel_id, SenderInfo& sender);
+	void UpdateLayerCount(uint8_t layer);
+	void UpdateLayerRate(uint8_t layer, uint32_t len);
+	void SwitchSenderLayer(uint8_t layer);
+	uint8_t SelectSenderLayer(const SenderInfo& sender, uint32_t bw_kbps);
 
 private:
 	friend class ServerNegotiator;
@@ -106,6 +105,7 @@ private:
 private:
 	base::IComFactory* m_factory = nullptr;
 	util::IThread* m_thread = nullptr;
+	IPacingScheduler* m_pacing_scheduler = nullptr;
 	com::ITimerMgr* m_timer_mgr = nullptr;
 	IServerHandler* m_handler = nullptr;
 	
@@ -121,11 +121,32 @@ private:
 
 	ServerNegotiatorSP m_negotiator;
 
-	FecEncoder m_fec_encoder;
+	// FEC parameters of publisher
+	uint8_t m_src_k = 0;
+	uint8_t m_src_r = 0;
+
+	// Publisher sequences relayed, each packet is relayed once
+	RelaySeqFilter m_relay_filter;
+
+	// Senders not relaying are grouped by simulcast layer and FEC parameters,
+	// frames are packed and FEC encoded only if there is any tier
+	FecTierTable m_fec_tiers;
+
 	FramePacker m_frame_packer;
-	NackHistory m_nack_history;
-	SeqAllocator m_seq_allocator;
-	SimpleFecParamController m_fec_param_controller;
+
+	// Simulcast layers of publisher, learned from video frame header, read by
+	// congestion controller threads without lock
+	static const uint32_t kMaxLayers = 4;
+	std::atomic<uint8_t> m_layer_count { 1 };
+
+	// Layer of the frame being packed
+	uint8_t m_pack_layer = 0;
+
+	// Incoming bitrate of each layer
+	static const uint32_t kLayerRateWindowMs = 2000;
+	uint32_t m_layer_bytes[kMaxLayers] = { 0 };
+	uint32_t m_layer_kbps[kMaxLayers] = { 0 };
+	uint64_t m_layer_rate_us = 0;
 };
 
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "transport-common.h"
+#include "common-config.h"
 
 namespace jukey::txp
 {
@@ -25,4 +26,25 @@ StateFeedback ToStateFeedback(const StateFB& fb)
 		return feedback;
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+uint8_t SelectSimulcastLayer(const uint32_t* layer_kbps, uint8_t layer_count,
+	uint8_t cur_layer, uint32_t media_kbps)
+{
+	if (layer_count == 0 || layer_kbps[layer_count - 1] == 0) {
+		return cur_layer;
+	}
+
+	uint8_t layer = 0;
+	for (uint8_t i = 1; i < layer_count; i++) {
+		uint32_t percent = (i > cur_layer) ? SFU_LAYER_UP_PERCENT : 100;
+		if ((uint64_t)layer_kbps[i] * 100 <= (uint64_t)media_kbps * percent) {
+			layer = i;
+		}
+	}
+
+	return layer;
+}
+
 }
\ No newline at end of file
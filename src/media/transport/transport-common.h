@@ -45,6 +45,8 @@ struct ReceiverInfo
 	IStreamReceiver* stream_receiver = nullptr;
 };
 
+class ReceiverFecParam;
+
 //==============================================================================
 //
 //==============================================================================
@@ -54,6 +56,23 @@ struct SenderInfo
 	stmr::PinCaps avai_caps;
 	std::string nego_cap;
 	IServerStreamSender* stream_sender = nullptr;
+
+	// Relay original FEC frames of publisher, or send re-encoded frames
+	bool relay = false;
+
+	// Consecutive state feedbacks asking for the other path
+	uint32_t switch_votes = 0;
+
+	// FEC parameters computed from feedback of this receiver
+	std::shared_ptr<ReceiverFecParam> fec_param;
+
+	// FEC tier sending to this receiver if not relaying
+	uint32_t fec_tier = 0;
+
+	// Simulcast layer sent to this receiver, switched to the pending layer on
+	// its next key frame, -1 means no switching
+	uint8_t layer = 0;
+	int32_t pending_layer = -1;
 };
 
 typedef std::shared_ptr<SenderInfo> SenderInfoSP;
@@ -162,4 +181,13 @@ struct VideoInfoFB
 
 StateFeedback ToStateFeedback(const StateFB& fb);
 
+//
+// @brief Highest simulcast layer fitting in media bandwidth, switching up needs
+//        some headroom and the current layer is kept until it does not fit
+// @param layer_kbps incoming bitrate of each layer
+// @return current layer if incoming bitrate is not measured yet
+//
+uint8_t SelectSimulcastLayer(const uint32_t* layer_kbps, uint8_t layer_count,
+	uint8_t cur_layer, uint32_t media_kbps);
+
 }
\ No newline at end of file
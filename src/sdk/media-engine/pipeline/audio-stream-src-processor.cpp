@@ -37,6 +37,8 @@ com::ErrCode AudioStreamSrcProcessor::Init(const com::MediaStream& stream,
 
 	util::IPropertyUP prop = util::MakeProperty(m_factory, "processor");
 	prop->SetPtrValue("session-mgr", m_pl_proc_mgr->m_sess_mgr);
+	prop->SetPtrValue("session-bundle", m_pl_proc_mgr->GetSessionBundle(addr,
+		net::SessionType::RELIABLE));
 	prop->SetStrValue("service-addr", addr.c_str());
 	prop->SetPtrValue("media-stream", &stream);
 
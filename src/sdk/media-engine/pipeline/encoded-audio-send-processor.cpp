@@ -61,6 +61,8 @@ ErrCode EncodedAudioSendProcessor::Init(const com::MediaStream& stream,
 	// Sender
 	util::IPropertyUP prop = util::MakeProperty(m_factory, "processor");
 	prop->SetPtrValue("session-mgr", m_pl_proc_mgr->m_sess_mgr);
+	prop->SetPtrValue("session-bundle", m_pl_proc_mgr->GetSessionBundle(addr,
+		net::SessionType::RELIABLE));
 	prop->SetStrValue("service-addr", addr.c_str());
 	prop->SetPtrValue("media-stream", &stream);
 	auto send_element = m_pipeline->AddElement(CID_AUDIO_SEND, prop.get());
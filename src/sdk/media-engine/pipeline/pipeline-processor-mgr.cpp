@@ -16,6 +16,8 @@
 #include "encoded-video-send-processor.h"
 #include "media-engine-impl.h"
 #include "pipeline-msg.h"
+#include "common-config.h"
+#include "common/util-net.h"
 
 using namespace jukey::sdk;
 using namespace jukey::com;
@@ -635,6 +637,41 @@ ISinkPin* PipelineProcessorMgr::GetProcessorSinkPin(const com::ElementPin& pin)
 	return nullptr;
 }
 
+//------------------------------------------------------------------------------
+// One bundle for each service address and session type, audio and video do
+// not share session because of different reliability
+//------------------------------------------------------------------------------
+jukey::util::SessionBundle* PipelineProcessorMgr::GetSessionBundle(
+	const std::string& addr, net::SessionType type)
+{
+	if (!SESSION_BUNDLE_ENABLED) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(m_bundle_mutex);
+
+	std::string key = addr + "|" + std::to_string((uint32_t)type);
+
+	auto iter = m_sess_bundles.find(key);
+	if (iter != m_sess_bundles.end()) {
+		return iter->second.get();
+	}
+
+	std::optional<com::Address> result = util::ParseAddress(addr);
+	if (!result.has_value()) {
+		LOG_ERR("Parse service address:{} failed!", addr);
+		return nullptr;
+	}
+
+	util::SessionBundleSP bundle = std::make_shared<util::SessionBundle>(
+		m_sess_mgr, result.value(), type);
+	m_sess_bundles.insert(std::make_pair(key, bundle));
+
+	LOG_INF("Create session bundle, addr:{}, type:{}", addr, (uint32_t)type);
+
+	return bundle.get();
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
@@ -10,6 +10,7 @@
 #include "if-session-mgr.h"
 #include "pipeline-processor-base.h"
 #include "if-bitrate-allocate-mgr.h"
+#include "async/session-bundle.h"
 
 
 namespace jukey::sdk
@@ -101,6 +102,9 @@ private:
 		const com::ElementPin& pin);
 	stmr::ISinkPin* GetProcessorSinkPin(const com::ElementPin& pin);
 
+	util::SessionBundle* GetSessionBundle(const std::string& addr,
+		net::SessionType type);
+
 	com::ErrCode LinkProcessor(IPipelineProcessorSP src_processor, 
 		const com::ElementStream& stream,
 		IPipelineProcessorSP sink_processor);
@@ -152,6 +156,11 @@ private:
 	com::MainThreadExecutor* m_executor = nullptr;
 	MediaEngineImpl* m_engine = nullptr;
 
+	// Streams to the same service share sessions, destructed after processors
+	// key: service address and session type
+	std::map<std::string, util::SessionBundleSP> m_sess_bundles;
+	std::mutex m_bundle_mutex;
+
 	std::vector<IPipelineProcessorSP> m_processors;
 
 	std::mutex m_mutex;
@@ -56,6 +56,8 @@ com::ErrCode RawVideoSendProcessor::Init(const com::MediaStream& stream,
 	// Sender
 	util::IPropertyUP p2 = util::MakeProperty(m_factory, "processor");
 	p2->SetPtrValue("session-mgr", m_pl_proc_mgr->m_sess_mgr);
+	p2->SetPtrValue("session-bundle", m_pl_proc_mgr->GetSessionBundle(addr,
+		net::SessionType::UNRELIABLE));
 	p2->SetStrValue("service-addr", addr.c_str());
 	p2->SetPtrValue("media-stream", &stream);
 	p2->SetPtrValue("bitrate-allocate-mgr", m_pl_proc_mgr->m_br_alloc_mgr);
@@ -72,10 +74,11 @@ com::ErrCode RawVideoSendProcessor::Init(const com::MediaStream& stream,
 		return ERR_CODE_FAILED;
 	}
 
-	// Converter -> Encoder
+	// Converter -> Encoder, encoding overlaps with capture and convert
 	if (ERR_CODE_OK != m_pipeline->LinkElement(
 		m_convert_element->SrcPins().front(),
-		encode_element->SinkPins().front())) {
+		encode_element->SinkPins().front(),
+		stmr::LinkParam(stmr::LinkMode::QUEUED))) {
 		LOG_ERR("Link converter and encoder failed!");
 		return ERR_CODE_FAILED;
 	}
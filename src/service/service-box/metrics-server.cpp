@@ -0,0 +1,82 @@
+#include "metrics-server.h"
+#include "httplib.h"
+#include "log.h"
+
+
+namespace jukey::srv
+{
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+MetricsServer::MetricsServer(com::IMetricsRegistry* registry)
+	: m_registry(registry)
+{
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+MetricsServer::~MetricsServer()
+{
+	Stop();
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool MetricsServer::Start(const std::string& addr, uint16_t port,
+	const std::string& path)
+{
+	if (m_server) {
+		LOG_WRN("Metrics server already started");
+		return true;
+	}
+
+	m_server.reset(new httplib::Server());
+
+	m_server->Get(path, [this](const httplib::Request& req, 
+		httplib::Response& res) {
+		if (req.get_param_value("format") == "json") {
+			res.set_content(m_registry->Scrape(
+				com::MetricsFormat::METRICS_FORMAT_JSON), "application/json");
+		}
+		else {
+			res.set_content(m_registry->Scrape(
+				com::MetricsFormat::METRICS_FORMAT_PROMETHEUS),
+				"text/plain; version=0.0.4");
+		}
+	});
+
+	if (!m_server->bind_to_port(addr.c_str(), port)) {
+		LOG_ERR("Bind metrics server to {}:{} failed!", addr, port);
+		m_server.reset();
+		return false;
+	}
+
+	m_thread = std::thread([this]() { m_server->listen_after_bind(); });
+
+	LOG_INF("Start metrics server, addr:{}, port:{}, path:{}", addr, port, path);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void MetricsServer::Stop()
+{
+	if (!m_server) return;
+
+	m_server->stop();
+
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+
+	m_server.reset();
+
+	LOG_INF("Stop metrics server");
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <memory>
+
+#include "if-metrics-registry.h"
+
+namespace httplib
+{
+class Server;
+}
+
+namespace jukey::srv
+{
+
+//==============================================================================
+// HTTP scrape endpoint of the metrics registry
+// GET <path>              : Prometheus text format
+// GET <path>?format=json  : JSON format
+//==============================================================================
+class MetricsServer
+{
+public:
+	MetricsServer(com::IMetricsRegistry* registry);
+	~MetricsServer();
+
+	bool Start(const std::string& addr, uint16_t port, const std::string& path);
+	void Stop();
+
+private:
+	com::IMetricsRegistry* m_registry = nullptr;
+
+	std::unique_ptr<httplib::Server> m_server;
+	std::thread m_thread;
+};
+
+}
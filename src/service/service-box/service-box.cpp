@@ -120,6 +120,39 @@ bool ServiceBox::ParseConfig(const std::string& config_file, SrvBoxConfig& confi
 
 			config.services.push_back(entry);
 		}
+
+		// Optional
+		if (root["metrics"]) {
+			YAML::Node metrics = root["metrics"];
+			if (metrics["enable"]) {
+				config.metrics.enable = metrics["enable"].as<bool>();
+			}
+			if (metrics["addr"]) {
+				config.metrics.addr = metrics["addr"].as<std::string>();
+			}
+			if (metrics["port"]) {
+				config.metrics.port = metrics["port"].as<uint16_t>();
+			}
+			if (metrics["path"]) {
+				config.metrics.path = metrics["path"].as<std::string>();
+			}
+		}
+
+		// Optional
+		if (root["session"]) {
+			YAML::Node session = root["session"];
+			if (session["thread-count"]) {
+				config.session.thread_count = session["thread-count"].as<uint32_t>();
+			}
+			if (session["udp-shard-count"]) {
+				config.session.udp_shard_count = 
+					session["udp-shard-count"].as<uint32_t>();
+			}
+			if (session["udp-recv-pool-size"]) {
+				config.session.udp_recv_pool_size =
+					session["udp-recv-pool-size"].as<uint32_t>();
+			}
+		}
 	}
 	catch (const std::exception& e) {
 		LOG_ERR("Error:{}", e.what());
@@ -174,6 +207,8 @@ bool ServiceBox::Init(const std::string& config_file)
 		return false;
 	}
 
+	StartMetricsServer();
+
 	//
 	// Initialize session manager
 	//
@@ -186,7 +221,9 @@ bool ServiceBox::Init(const std::string& config_file)
 
 	SessionMgrParam param;
 	param.ka_interval = 5;
-	param.thread_count = 4;
+	param.thread_count = m_config.session.thread_count;
+	param.udp_shard_count = m_config.session.udp_shard_count;
+	param.udp_recv_pool_size = m_config.session.udp_recv_pool_size;
 	if (com::ErrCode::ERR_CODE_OK != m_sess_mgr->Init(param)) {
 		LOG_ERR("Initialize session manager failed!");
 		return false;
@@ -223,6 +260,30 @@ bool ServiceBox::Init(const std::string& config_file)
 	return true;
 }
 
+//------------------------------------------------------------------------------
+// Failure of metrics server does not affect services
+//------------------------------------------------------------------------------
+void ServiceBox::StartMetricsServer()
+{
+	if (!m_config.metrics.enable) {
+		LOG_INF("Metrics server is disabled");
+		return;
+	}
+
+	com::IMetricsRegistry* registry = QUERY_METRICS_REGISTRY(m_factory);
+	if (!registry) {
+		LOG_ERR("Query metrics registry failed!");
+		return;
+	}
+
+	m_metrics_server.reset(new MetricsServer(registry));
+	if (!m_metrics_server->Start(m_config.metrics.addr, m_config.metrics.port,
+		m_config.metrics.path)) {
+		LOG_ERR("Start metrics server failed!");
+		m_metrics_server.reset();
+	}
+}
+
 //------------------------------------------------------------------------------
 //	 
 //------------------------------------------------------------------------------
@@ -1,12 +1,14 @@
 ﻿#pragma once
 
 #include <vector>
+#include <memory>
 #include <filesystem>
 
 #include "if-service.h"
 #include "if-service-box.h"
 #include "if-session-mgr.h"
 #include "com-factory.h"
+#include "metrics-server.h"
 
 // yaml-cpp warning
 #pragma warning( disable: 4251 )
@@ -34,11 +36,28 @@ private:
 	};
 	typedef std::vector<ServiceConfigEntry> ServiceConfigEntryVec;
 
+	struct MetricsConfig
+	{
+		bool enable = false;
+		std::string addr = "127.0.0.1";
+		uint16_t port = 9580;
+		std::string path = "/metrics";
+	};
+
+	struct SessionConfig
+	{
+		uint32_t thread_count = 4;
+		uint32_t udp_shard_count = 0;
+		uint32_t udp_recv_pool_size = 0;
+	};
+
 	struct SrvBoxConfig
 	{
 		std::string com_path;
 	uint32_t load_config_interval = 1;
 		ServiceConfigEntryVec services;
+		MetricsConfig metrics;
+		SessionConfig session;
 	};
 
 	struct ServiceItem
@@ -52,6 +71,7 @@ private:
 	bool ParseConfig(const std::string& config_file, SrvBoxConfig& config);
 	bool LoadConfig(const std::string& config_file);
 	void MonitorConfigFiles();
+	void StartMetricsServer();
 
 private:
 	jukey::base::IComFactory* m_factory = nullptr;
@@ -59,6 +79,8 @@ private:
 
 	SrvBoxConfig m_config;
 	std::vector<ServiceItem> m_services;
+
+	std::unique_ptr<MetricsServer> m_metrics_server;
 };
 
 }
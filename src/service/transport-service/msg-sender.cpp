@@ -44,6 +44,7 @@ void MsgSender::SendLoginRecvChnlRsp(net::SessionId sid,
 	com::SigHdrParam hdr_param;
 	hdr_param.app_id = sig_hdr->app;
 	hdr_param.user_id = sig_hdr->usr;
+	hdr_param.group_id = channel_id; // route on bundled session
 	hdr_param.seq = sig_hdr->seq;
 
 	Buffer rsp = prot::util::BuildLoginRecvChannelRsp(rsp_param, hdr_param);
@@ -82,6 +83,7 @@ void MsgSender::SendLoginSendChnlRsp(net::SessionId sid,
 	hdr_param.app_id = req.app_id();
 	hdr_param.user_id = req.user_id();
 	hdr_param.client_id = sig_hdr->clt;
+	hdr_param.group_id = channel_id; // route on bundled session
 	hdr_param.seq = sig_hdr->seq;
 
 	Buffer rsp = prot::util::BuildLoginSendChannelRsp(rsp_param, hdr_param);
@@ -118,6 +120,7 @@ void MsgSender::SendLogoutSendChnlRsp(net::SessionId sid,
 	hdr_param.app_id = req.app_id();
 	hdr_param.user_id = req.user_id();
 	hdr_param.client_id = sig_hdr->clt;
+	hdr_param.group_id = channel_id; // route on bundled session
 	hdr_param.seq = sig_hdr->seq;
 
 	Buffer rsp = prot::util::BuildLogoutSendChannelRsp(rsp_param, hdr_param);
@@ -145,6 +148,7 @@ void MsgSender::SendStartSendStreamNotify(uint32_t seq, net::SessionId sid,
 	hdr_param.app_id = req.app_id();
 	hdr_param.user_id = req.user_id();
 	hdr_param.client_id = sig_hdr->clt;
+	hdr_param.group_id = channel_id; // route on bundled session
 	hdr_param.seq = seq;
 
 	Buffer notify = prot::util::BuildStartSendStreamNotify(notify_param,
@@ -186,6 +186,7 @@ bool TransportService::DoInitReport()
 void TransportService::DoInitStats()
 {
 	m_data_stats.reset(new util::DataStats(m_factory, g_logger, ""));
+	m_data_stats->SetMetricsScope("transport_service", {});
 	m_data_stats->Start();
 
 	util::StatsParam recv_stats("recv-br", util::StatsType::IAVER, 5000);
@@ -301,8 +302,7 @@ void TransportService::OnLoginSendChnlReq(net::SessionId sid, const Buffer& buf)
 			ERR_CODE_FAILED, "failed");
 	}
 	else {
-		m_sess_chnl.insert(std::make_pair(sid, ChannelEntry(m_chnl_id, true, 
-			stream.stream.stream_id)));
+		AddChannel(sid, m_chnl_id, true, stream.stream.stream_id);
 		LOG_INF("Add send channel to exchange success, session:{}, channel:{}", 
 			sid, m_chnl_id);
 
@@ -336,8 +336,9 @@ void TransportService::OnLogoutSendChnlReq(net::SessionId sid,
 			ERR_CODE_FAILED, "failed");
 	}
 	else {
-		LOG_INF("Remove session channel, sid:{}, channel:{}", sid, m_chnl_id);
-		m_sess_chnl.erase(sid);
+		LOG_INF("Remove session channel, sid:{}, channel:{}", sid,
+			req.channel_id());
+		RemoveChannel(req.channel_id());
 		m_msg_sender->SendLogoutSendChnlRsp(sid, req.channel_id(), buf, req,
 			ERR_CODE_OK, "success");
 	}
@@ -405,8 +406,7 @@ void TransportService::OnLoginRecvChnlReq(net::SessionId sid, const Buffer& buf)
 			ERR_CODE_FAILED, "failed");
 	}
 	else {
-		m_sess_chnl.insert(std::make_pair(sid, ChannelEntry(m_chnl_id, false,
-			stream.stream.stream_id)));
+		AddChannel(sid, m_chnl_id, false, stream.stream.stream_id);
 		LOG_INF("Add recv channel to exchange success, session:{}, channel:{}",
 			sid, m_chnl_id);
 
@@ -435,13 +435,65 @@ void TransportService::OnStartSendStreamAck(net::SessionId sid, const Buffer& bu
 
 }
 
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TransportService::AddChannel(net::SessionId sid, uint32_t channel_id,
+	bool send, const std::string& stream_id)
+{
+	m_chnls.insert(std::make_pair(channel_id, ChannelEntry(sid, channel_id, send,
+		stream_id)));
+	m_sess_chnls[sid].insert(channel_id);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TransportService::RemoveChannel(uint32_t channel_id)
+{
+	auto iter = m_chnls.find(channel_id);
+	if (iter == m_chnls.end()) {
+		return;
+	}
+
+	auto siter = m_sess_chnls.find(iter->second.session_id);
+	if (siter != m_sess_chnls.end()) {
+		siter->second.erase(channel_id);
+		if (siter->second.empty()) {
+			m_sess_chnls.erase(siter);
+		}
+	}
+
+	m_chnls.erase(iter);
+}
+
+//------------------------------------------------------------------------------
+// Bundled session stamps channel ID in SigMsgHdr::grp, the session with only
+// one channel may leave it empty
+//------------------------------------------------------------------------------
+uint32_t TransportService::GetSessionChannel(net::SessionId sid,
+	const Buffer& buf)
+{
+	auto iter = m_sess_chnls.find(sid);
+	if (iter == m_sess_chnls.end()) {
+		return 0;
+	}
+
+	prot::SigMsgHdr* sig_hdr = (prot::SigMsgHdr*)DP(buf);
+	if (sig_hdr->grp != 0) {
+		return iter->second.count(sig_hdr->grp) ? sig_hdr->grp : 0;
+	}
+
+	return iter->second.size() == 1 ? *(iter->second.begin()) : 0;
+}
+
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
 void TransportService::OnChannelData(net::SessionId sid, const Buffer& buf)
 {
-	auto iter = m_sess_chnl.find(sid);
-	if (iter == m_sess_chnl.end()) {
+	uint32_t channel_id = GetSessionChannel(sid, buf);
+	if (channel_id == 0) {
 		LOG_ERR("Cannot find channel by session:{}", sid);
 		return;
 	}
@@ -452,7 +504,7 @@ void TransportService::OnChannelData(net::SessionId sid, const Buffer& buf)
 	memcpy(DP(msg_buf), DP(buf) + sizeof(prot::SigMsgHdr), buf_len);
 
 	prot::SigMsgHdr* sig_hdr = (prot::SigMsgHdr*)DP(buf);
-	m_stream_exch->OnRecvChannelData(iter->second.channel_id, sig_hdr->mt, msg_buf);
+	m_stream_exch->OnRecvChannelData(channel_id, sig_hdr->mt, msg_buf);
 
 	m_data_stats->OnData(m_recv_br_id, buf.data_len);
 }
@@ -462,13 +514,13 @@ void TransportService::OnChannelData(net::SessionId sid, const Buffer& buf)
 //------------------------------------------------------------------------------
 void TransportService::OnChannelMsg(net::SessionId sid, const Buffer& buf)
 {
-	auto iter = m_sess_chnl.find(sid);
-	if (iter == m_sess_chnl.end()) {
+	uint32_t channel_id = GetSessionChannel(sid, buf);
+	if (channel_id == 0) {
 		LOG_ERR("Cannot find channel by session:{}", sid);
 		return;
 	}
 
-	m_stream_exch->OnRecvChannelMsg(iter->second.channel_id, buf);
+	m_stream_exch->OnRecvChannelMsg(channel_id, buf);
 
 	m_data_stats->OnData(m_recv_br_id, buf.data_len);
 }
@@ -502,27 +554,37 @@ void TransportService::OnSessionClosed(const CommonMsg& msg)
 {
 	PCAST_COMMON_MSG_DATA(net::SessionClosedMsg);
 
-	auto iter = m_sess_chnl.find(data->lsid);
-	if (iter == m_sess_chnl.end()) {
+	auto siter = m_sess_chnls.find(data->lsid);
+	if (siter == m_sess_chnls.end()) {
 		LOG_ERR("Cannot find closed session:{}", data->lsid);
 		return;
 	}
 
-	if (iter->second.send) {
-		m_stream_exch->RemoveSrcChannel(iter->second.channel_id);
-	}
-	else {
-		m_stream_exch->RemoveDstChannel(iter->second.channel_id, 
-			iter->second.stream_id);
-	}
+	// All channels of bundled session
+	std::set<uint32_t> channels = siter->second;
+
+	for (auto channel_id : channels) {
+		auto iter = m_chnls.find(channel_id);
+		if (iter == m_chnls.end()) {
+			continue;
+		}
 
-	LOG_INF("Session:{} closed, remove it, channel:{}, send:{}, stream:{}",
-		data->lsid, 
-		iter->second.channel_id, 
-		iter->second.send, 
-		iter->second.stream_id);
+		if (iter->second.send) {
+			m_stream_exch->RemoveSrcChannel(iter->second.channel_id);
+		}
+		else {
+			m_stream_exch->RemoveDstChannel(iter->second.channel_id, 
+				iter->second.stream_id);
+		}
 
-	m_sess_chnl.erase(iter);
+		LOG_INF("Session:{} closed, remove it, channel:{}, send:{}, stream:{}",
+			data->lsid, 
+			iter->second.channel_id, 
+			iter->second.send, 
+			iter->second.stream_id);
+
+		RemoveChannel(channel_id);
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -642,19 +704,16 @@ void TransportService::OnRecvMqMsg(const std::string& queue,
 void TransportService::OnSendChannelMsg(uint32_t channel_id, uint32_t user_id,
 	const Buffer& buf)
 {
-	// TODO: performance
-	net::SessionId session_id = INVALID_SESSION_ID;
-	for (auto item : m_sess_chnl) {
-		if (item.second.channel_id == channel_id) {
-			session_id = item.first;
-			break;
-		}
-	}
-
-	if (session_id == INVALID_SESSION_ID) {
+	auto iter = m_chnls.find(channel_id);
+	if (iter == m_chnls.end()) {
 		LOG_ERR("Cannot find session by channel:{}", channel_id);
 		return;
 	}
+	net::SessionId session_id = iter->second.session_id;
+
+	// Route on bundled session
+	prot::SigMsgHdr* sig_hdr = (prot::SigMsgHdr*)DP(buf);
+	sig_hdr->grp = channel_id;
 	
 	if (ERR_CODE_OK != m_sess_mgr->SendData(session_id, buf)) {
 		LOG_ERR("Send msg to channel:{} failed!", channel_id);
@@ -664,43 +723,81 @@ void TransportService::OnSendChannelMsg(uint32_t channel_id, uint32_t user_id,
 }
 
 //------------------------------------------------------------------------------
-// 
+// Find the session of channel and prepend SigMsgHdr
 //------------------------------------------------------------------------------
-void TransportService::OnSendChannelData(uint32_t channel_id, uint32_t user_id,
-	uint32_t mt, const Buffer& buf)
+bool TransportService::MakeSessionData(const txp::ChannelData& data,
+	net::SessionData& sd)
 {
-	// TODO: performance
-	net::SessionId session_id = INVALID_SESSION_ID;
-	for (auto item : m_sess_chnl) {
-		if (item.second.channel_id == channel_id) {
-			session_id = item.first;
-			break;
-		}
-	}
-
-	if (session_id == INVALID_SESSION_ID) {
-		LOG_ERR("Cannot find session by channel:{}", channel_id);
-		return;
+	auto iter = m_chnls.find(data.channel_id);
+	if (iter == m_chnls.end()) {
+		LOG_ERR("Cannot find session by channel:{}", data.channel_id);
+		return false;
 	}
+	sd.sid = iter->second.session_id;
 
 	// 添加 SigMsgHdr
-	uint32_t buf_len = buf.data_len + sizeof(prot::SigMsgHdr);
-	Buffer sig_buf(buf_len, buf_len);
+	uint32_t buf_len = data.buf.data_len + sizeof(prot::SigMsgHdr);
+	sd.buf = Buffer(buf_len, buf_len);
 
 	// Transport service 的 signal 消息不经过 router 和 proxy 转发，
 	// 因此 SigMsgHdr 只需要设置必要的几个字段即可
-	prot::SigMsgHdr* sig_hdr = (prot::SigMsgHdr*)DP(sig_buf);
-	sig_hdr->len = buf.data_len;
-	sig_hdr->mt = mt;
+	prot::SigMsgHdr* sig_hdr = (prot::SigMsgHdr*)DP(sd.buf);
+	sig_hdr->len = data.buf.data_len;
+	sig_hdr->mt = data.mt;
 	sig_hdr->seq = ++m_cur_seq; // TODO: 每个 channel 的序列号独立？
-	sig_hdr->usr = user_id;
-	memcpy(DP(sig_buf) + sizeof(prot::SigMsgHdr), DP(buf), buf.data_len);
+	sig_hdr->usr = data.user_id;
+	sig_hdr->grp = data.channel_id; // route on bundled session
+	memcpy(DP(sd.buf) + sizeof(prot::SigMsgHdr), DP(data.buf),
+		data.buf.data_len);
+
+	return true;
+}
 
-	if (ERR_CODE_OK != m_sess_mgr->SendData(session_id, sig_buf)) {
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void TransportService::OnSendChannelData(uint32_t channel_id, uint32_t user_id,
+	uint32_t mt, const Buffer& buf)
+{
+	net::SessionData sd;
+	if (!MakeSessionData(txp::ChannelData(channel_id, user_id, mt, buf), sd)) {
+		return;
+	}
+
+	if (ERR_CODE_OK != m_sess_mgr->SendData(sd.sid, sd.buf)) {
 		LOG_ERR("Send data to channel:{} failed!", channel_id);
 	}
 
 	m_data_stats->OnData(m_send_br_id, buf.data_len);
 }
 
+//------------------------------------------------------------------------------
+// One batch send, sessions of a session thread are queued together
+//------------------------------------------------------------------------------
+void TransportService::OnSendChannelData(
+	const std::vector<txp::ChannelData>& datas)
+{
+	std::vector<net::SessionData> sds;
+	sds.reserve(datas.size());
+
+	uint32_t data_len = 0;
+	for (const auto& data : datas) {
+		net::SessionData sd;
+		if (MakeSessionData(data, sd)) {
+			sds.push_back(std::move(sd));
+			data_len += data.buf.data_len;
+		}
+	}
+
+	if (sds.empty()) {
+		return;
+	}
+
+	if (ERR_CODE_OK != m_sess_mgr->SendData(sds)) {
+		LOG_ERR("Send batch data failed, count:{}", sds.size());
+	}
+
+	m_data_stats->OnData(m_send_br_id, data_len);
+}
+
 }
\ No newline at end of file
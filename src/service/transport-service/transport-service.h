@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <set>
 #include <mutex>
 
 #include "if-service.h"
@@ -58,6 +59,8 @@ public:
 		const com::Buffer& buf) override;
 	virtual void OnSendChannelData(uint32_t channel_id, uint32_t user_id,
 		uint32_t mt, const com::Buffer& buf) override;
+	virtual void OnSendChannelData(const std::vector<txp::ChannelData>& datas)
+		override;
 
 private:
 	void OnMqMsg(const com::CommonMsg& msg);
@@ -70,6 +73,11 @@ private:
 
 	void OnChannelData(net::SessionId sid, const com::Buffer& buf);
 	void OnChannelMsg(net::SessionId sid, const com::Buffer& buf);
+
+	void AddChannel(net::SessionId sid, uint32_t channel_id, bool send,
+		const std::string& stream_id);
+	void RemoveChannel(uint32_t channel_id);
+	uint32_t GetSessionChannel(net::SessionId sid, const com::Buffer& buf);
 	
 	void OnSessionClosed(const com::CommonMsg& msg);
 	void OnSessionCreateResult(const com::CommonMsg& msg);
@@ -82,6 +90,8 @@ private:
 	bool DoInitReport();
 	void DoInitStats();
 
+	bool MakeSessionData(const txp::ChannelData& data, net::SessionData& sd);
+
 	void GetParentStreamNode(net::SessionId sid,
 		uint32_t channel_id,
 		const com::Buffer& buf,
@@ -111,14 +121,21 @@ private:
 
 	struct ChannelEntry
 	{
-		ChannelEntry(uint32_t cid, bool s, const std::string& sid) 
-			: channel_id(cid), send(s), stream_id(sid) {}
+		ChannelEntry(net::SessionId ssid, uint32_t cid, bool s,
+			const std::string& sid)
+			: session_id(ssid), channel_id(cid), send(s), stream_id(sid) {}
 
+		net::SessionId session_id = INVALID_SESSION_ID;
 		uint32_t channel_id = 0;
 		bool send = false;
 		std::string stream_id;
 	};
-	std::map<net::SessionId, ChannelEntry> m_sess_chnl;
+
+	// key:channel ID
+	std::map<uint32_t, ChannelEntry> m_chnls;
+
+	// A bundled session carries many channels, identified by SigMsgHdr::grp
+	std::map<net::SessionId, std::set<uint32_t>> m_sess_chnls;
 
 	// Service configure
 	TransportServiceConfig m_config;
@@ -0,0 +1,291 @@
+// test-cc-executor.cpp : Measure threads, context switches and CPU usage of
+// GCC congestion controllers with an increasing number of sender legs
+// 
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <utility>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#ifdef _WINDOWS
+#include <windows.h>
+#include <tlhelp32.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "com-factory.h"
+#include "if-congestion-controller.h"
+#include "common/util-time.h"
+#include "clipp.h"
+
+using namespace jukey::base;
+using namespace jukey::com;
+using namespace jukey::cc;
+using namespace jukey::util;
+
+using namespace clipp;
+
+//==============================================================================
+// Process wide resource usage
+//==============================================================================
+struct ProcStats
+{
+	uint64_t cpu_us = 0;
+	uint64_t ctx_switches = 0; // not available on Windows
+	uint32_t threads = 0;
+};
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+ProcStats GetProcStats()
+{
+	ProcStats stats;
+
+#ifdef _WINDOWS
+	FILETIME create_time, exit_time, kernel_time, user_time;
+	if (GetProcessTimes(GetCurrentProcess(), &create_time, &exit_time,
+		&kernel_time, &user_time)) {
+		ULARGE_INTEGER kernel, user;
+		kernel.LowPart = kernel_time.dwLowDateTime;
+		kernel.HighPart = kernel_time.dwHighDateTime;
+		user.LowPart = user_time.dwLowDateTime;
+		user.HighPart = user_time.dwHighDateTime;
+		stats.cpu_us = (kernel.QuadPart + user.QuadPart) / 10;
+	}
+
+	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (snapshot != INVALID_HANDLE_VALUE) {
+		THREADENTRY32 entry;
+		entry.dwSize = sizeof(entry);
+		if (Thread32First(snapshot, &entry)) {
+			do {
+				if (entry.th32OwnerProcessID == GetCurrentProcessId()) {
+					stats.threads++;
+				}
+			} while (Thread32Next(snapshot, &entry));
+		}
+		CloseHandle(snapshot);
+	}
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		stats.cpu_us = usage.ru_utime.tv_sec * 1000000ULL + usage.ru_utime.tv_usec
+			+ usage.ru_stime.tv_sec * 1000000ULL + usage.ru_stime.tv_usec;
+		stats.ctx_switches = usage.ru_nvcsw + usage.ru_nivcsw;
+	}
+
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 8, "Threads:") == 0) {
+			stats.threads = std::stoul(line.substr(8));
+			break;
+		}
+	}
+#endif
+
+	return stats;
+}
+
+//==============================================================================
+// One sender leg, packets are acknowledged by a loopback transport feedback
+//==============================================================================
+class Leg : public IBandwidthObserver, public IPacketSender
+{
+public:
+	Leg(IComFactory* factory) : m_factory(factory) {}
+
+	~Leg()
+	{
+		if (m_controller) {
+			m_controller->Release();
+		}
+	}
+
+	bool Init()
+	{
+		m_controller = (ICongetionController*)m_factory->QueryInterface(
+			CID_GCC_CONGESTION_CONTROLLER, IID_GCC_CONGESTION_CONTROLLER, "test");
+		if (!m_controller) {
+			return false;
+		}
+
+		m_controller->Init(this, this);
+		m_controller->OnTransportConnected();
+
+		return true;
+	}
+
+	void SendPackets(uint32_t count, uint32_t size)
+	{
+		uint32_t now_ms = (uint32_t)(Now() / 1000);
+
+		for (uint32_t i = 0; i < count; i++) {
+			PktSendInfo send_info;
+			send_info.seq = m_next_seq;
+			send_info.ts = now_ms;
+			send_info.len = size;
+			send_info.pmt = PktMediaType::PMT_VIDEO;
+			m_controller->OnAddPacket(send_info);
+
+			SentPktInfo sent_info;
+			sent_info.seq = m_next_seq;
+			sent_info.send_time_ms = now_ms;
+			sent_info.size_bytes = size;
+			m_controller->OnSentPacket(sent_info);
+
+			m_unacked.push_back(std::make_pair(m_next_seq++, now_ms));
+		}
+	}
+
+	// Packets arrive after a fixed one way delay
+	void SendFeedback(uint32_t delay_ms)
+	{
+		if (m_unacked.empty()) return;
+
+		jukey::base::IUnknown* com = m_factory->CreateComponent(CID_WEBRTC_TFB_ADAPTER, "test");
+		if (!com) return;
+
+		auto adapter = (IWebrtcTfbAdapter*)com->QueryInterface(IID_WEBRTC_TFB_ADAPTER);
+		if (adapter) {
+			adapter->Init(m_unacked.front().first, m_unacked.front().second + delay_ms,
+				m_feedback_sn++);
+			for (auto& [seq, ts] : m_unacked) {
+				adapter->AddReceivedPacket(seq, ts + delay_ms);
+			}
+			m_controller->OnTransportFeedback(adapter->Serialize());
+		}
+		com->Release();
+
+		m_unacked.clear();
+	}
+
+	// IBandwidthObserver
+	virtual void OnBandwidthUpdate(uint32_t bw_kbps) override
+	{
+		m_bw_kbps = bw_kbps;
+	}
+
+	// IPacketSender
+	virtual void SendPacket(const Buffer& buf, const PacingInfo& info) override {}
+
+	virtual std::vector<Buffer> GeneratePadding(uint32_t data_size) override
+	{
+		return std::vector<Buffer>();
+	}
+
+private:
+	IComFactory* m_factory = nullptr;
+	ICongetionController* m_controller = nullptr;
+	uint16_t m_next_seq = 1;
+	uint8_t m_feedback_sn = 0;
+	std::vector<std::pair<uint16_t, uint32_t>> m_unacked;
+	std::atomic<uint32_t> m_bw_kbps{ 0 };
+};
+typedef std::unique_ptr<Leg> LegUP;
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	uint32_t max_legs = 2000;
+	uint32_t duration = 5;
+	uint32_t pkts = 2;
+	uint32_t fb_interval = 50;
+
+	auto cli = (
+		option("-m", "--max-legs") & value("max leg count", max_legs),
+		option("-d", "--duration") & value("duration of each case(s)", duration),
+		option("-p", "--pkts") & value("packets per leg every 10ms", pkts),
+		option("-f", "--feedback") & value("feedback interval(ms)", fb_interval)
+	);
+
+	if (!parse(argc, argv, cli) || duration == 0 || fb_interval < 10) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	IComFactory* factory = GetComFactory();
+	if (!factory->Init("./")) {
+		std::cout << "Init faild!" << std::endl;
+		return -1;
+	}
+
+	std::cout << std::setw(6) << "legs"
+		<< std::setw(10) << "threads"
+		<< std::setw(14) << "ctx-switch/s"
+		<< std::setw(8) << "cpu%"
+		<< std::setw(14) << "cpu-us/leg/s"
+		<< std::endl;
+
+	ProcStats base = GetProcStats();
+
+	for (uint32_t legs : { 10, 50, 100, 200, 500, 1000, 2000 }) {
+		if (legs > max_legs) break;
+
+		std::vector<LegUP> leg_list;
+		for (uint32_t i = 0; i < legs; i++) {
+			LegUP leg(new Leg(factory));
+			if (!leg->Init()) {
+				std::cout << "Create congestion controller failed!" << std::endl;
+				return -1;
+			}
+			leg_list.push_back(std::move(leg));
+		}
+
+		// Let all controllers start to process
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+		ProcStats begin = GetProcStats();
+		uint64_t start_us = Now();
+		uint64_t next_tick_us = start_us;
+		uint64_t next_fb_us = start_us + fb_interval * 1000ULL;
+		uint64_t end_us = start_us + duration * 1000000ULL;
+
+		while (Now() < end_us) {
+			for (auto& leg : leg_list) {
+				leg->SendPackets(pkts, 1200);
+			}
+
+			if (Now() >= next_fb_us) {
+				for (auto& leg : leg_list) {
+					leg->SendFeedback(20);
+				}
+				next_fb_us += fb_interval * 1000ULL;
+			}
+
+			next_tick_us += 10000;
+			uint64_t now = Now();
+			if (next_tick_us > now) {
+				std::this_thread::sleep_for(std::chrono::microseconds(next_tick_us - now));
+			}
+		}
+
+		ProcStats end = GetProcStats();
+		uint64_t wall_us = Now() - start_us;
+
+		double cpu = (double)(end.cpu_us - begin.cpu_us) * 100 / wall_us;
+		double cpu_per_leg = (double)(end.cpu_us - begin.cpu_us) * 1000000 / wall_us
+			/ legs;
+
+		std::cout << std::setw(6) << legs
+			<< std::setw(10) << (end.threads - base.threads)
+			<< std::setw(14) << (end.ctx_switches - begin.ctx_switches) * 1000000
+				/ wall_us
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(8) << cpu
+			<< std::setw(14) << cpu_per_leg
+			<< std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,260 @@
+// test-fec.cpp : Verify FEC kernels against Rizzo's FEC code and measure the
+// encoding and decoding throughput
+// 
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <cstring>
+
+#include "fec/luigi-fec-encoder.h"
+#include "fec/luigi-fec-decoder.h"
+#include "fec/gf-math.h"
+#include "common/util-time.h"
+#include "clipp.h"
+
+extern "C"
+{
+#include "fec.h"
+}
+
+using namespace jukey::util;
+
+using namespace clipp;
+
+//==============================================================================
+// One FEC group
+//==============================================================================
+struct FecGroup
+{
+	FecGroup(uint32_t k, uint32_t r, uint32_t size)
+	{
+		std::mt19937 rng(k * 100 + r);
+
+		for (uint32_t i = 0; i < k + r; i++) {
+			bufs.push_back(std::vector<uint8_t>(size));
+		}
+
+		for (uint32_t i = 0; i < k; i++) {
+			for (auto& byte : bufs[i]) {
+				byte = static_cast<uint8_t>(rng());
+			}
+			src.push_back(bufs[i].data());
+		}
+
+		for (uint32_t i = k; i < k + r; i++) {
+			dst.push_back(bufs[i].data());
+		}
+	}
+
+	std::vector<std::vector<uint8_t>> bufs;
+	std::vector<void*> src;
+	std::vector<void*> dst;
+};
+
+//------------------------------------------------------------------------------
+// Encode with Rizzo's code as reference
+//------------------------------------------------------------------------------
+std::vector<std::vector<uint8_t>> RizzoEncode(FecGroup& group, uint32_t k,
+	uint32_t r, uint32_t size)
+{
+	std::vector<std::vector<uint8_t>> result(r, std::vector<uint8_t>(size));
+
+	void* code = fec_new(k, k + r);
+	for (uint32_t i = 0; i < r; i++) {
+		fec_encode(code, group.src.data(), result[i].data(), k + i, size);
+	}
+	fec_free(code);
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// Drop the first r source packets, then recover them with redundant packets
+//------------------------------------------------------------------------------
+bool Decode(IFecDecoder* decoder, FecGroup& group, uint32_t k, uint32_t r,
+	uint32_t size, std::vector<std::vector<uint8_t>>& work)
+{
+	std::vector<void*> data(k);
+	std::vector<int> index(k);
+
+	for (uint32_t i = 0; i < k; i++) {
+		uint32_t pkt = i < r ? k + i : i;
+		memcpy(work[i].data(), group.bufs[pkt].data(), size);
+		data[i] = work[i].data();
+		index[i] = pkt;
+	}
+
+	return decoder->Decode(data.data(), index.data(), size);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool VerifyDecode(IFecDecoder* decoder, FecGroup& group, uint32_t k, uint32_t r,
+	uint32_t size)
+{
+	std::vector<std::vector<uint8_t>> work(k, std::vector<uint8_t>(size));
+
+	if (!Decode(decoder, group, k, r, size, work)) {
+		return false;
+	}
+
+	// Decoded packets are kept in the position of redundant packets
+	for (uint32_t i = 0; i < k; i++) {
+		if (work[i] != group.bufs[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Source bytes processed per second
+//------------------------------------------------------------------------------
+template<typename F>
+double MeasureMBps(F func, uint32_t k, uint32_t size, uint32_t duration_ms)
+{
+	uint64_t count = 0;
+	uint64_t start = Now();
+	uint64_t end = start + duration_ms * 1000ULL;
+	uint64_t now = start;
+
+	while (now < end) {
+		for (uint32_t i = 0; i < 16; i++) {
+			func();
+		}
+		count += 16;
+		now = Now();
+	}
+
+	return (double)count * k * size / (now - start);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	uint32_t size = 1200;
+	uint32_t min_k = 4;
+	uint32_t max_k = 16;
+	uint32_t duration = 100;
+
+	auto cli = (
+		option("-s", "--size") & value("packet size", size),
+		option("-n", "--min-k") & value("min k", min_k),
+		option("-x", "--max-k") & value("max k", max_k),
+		option("-d", "--duration") & value("duration of each case(ms)", duration)
+	);
+
+	if (!parse(argc, argv, cli) || size == 0 || min_k == 0 || max_k < min_k
+		|| max_k > 128) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	std::vector<GfKernel> kernels;
+	for (auto kernel : { GfKernel::GF_KERNEL_SCALAR, GfKernel::GF_KERNEL_SSSE3,
+		GfKernel::GF_KERNEL_AVX2 }) {
+		if (GfSetKernel(kernel)) {
+			kernels.push_back(kernel);
+		}
+	}
+
+	std::cout << "best kernel:" << GfKernelName(GfBestKernel())
+		<< ", packet size:" << size << ", unit: MB/s" << std::endl;
+
+	std::cout << std::setw(4) << "k" << std::setw(4) << "r"
+		<< std::setw(11) << "enc-rizzo";
+	for (auto kernel : kernels) {
+		std::cout << std::setw(11) << (std::string("enc-") + GfKernelName(kernel));
+	}
+	std::cout << std::setw(11) << "dec-rizzo";
+	for (auto kernel : kernels) {
+		std::cout << std::setw(11) << (std::string("dec-") + GfKernelName(kernel));
+	}
+	std::cout << std::endl;
+
+	bool all_passed = true;
+
+	for (uint32_t k = min_k; k <= max_k; k++) {
+		for (uint32_t r = 1; r <= k; r++) {
+			FecGroup group(k, r, size);
+			auto expected = RizzoEncode(group, k, r, size);
+
+			std::cout << std::setw(4) << k << std::setw(4) << r << std::fixed
+				<< std::setprecision(0);
+
+			void* code = fec_new(k, k + r);
+			std::cout << std::setw(11) << MeasureMBps([&]() {
+				for (uint32_t i = 0; i < r; i++) {
+					fec_encode(code, group.src.data(), group.dst[i], k + i, size);
+				}
+			}, k, size, duration);
+
+			for (auto kernel : kernels) {
+				GfSetKernel(kernel);
+
+				for (auto dst : group.dst) {
+					memset(dst, 0, size);
+				}
+
+				LuigiFecEncoder encoder(k, r);
+				encoder.Encode(group.src.data(), group.dst.data(), size);
+				for (uint32_t i = 0; i < r; i++) {
+					if (memcmp(group.dst[i], expected[i].data(), size) != 0) {
+						all_passed = false;
+						std::cout << "\nencode mismatch, kernel:"
+							<< GfKernelName(kernel) << std::endl;
+					}
+				}
+
+				std::cout << std::setw(11) << MeasureMBps([&]() {
+					encoder.Encode(group.src.data(), group.dst.data(), size);
+				}, k, size, duration);
+			}
+
+			std::vector<std::vector<uint8_t>> work(k, std::vector<uint8_t>(size));
+
+			std::cout << std::setw(11) << MeasureMBps([&]() {
+				std::vector<void*> data(k);
+				std::vector<int> index(k);
+				for (uint32_t i = 0; i < k; i++) {
+					uint32_t pkt = i < r ? k + i : i;
+					memcpy(work[i].data(), group.bufs[pkt].data(), size);
+					data[i] = work[i].data();
+					index[i] = pkt;
+				}
+				fec_decode(code, data.data(), index.data(), size);
+			}, k, size, duration);
+
+			fec_free(code);
+
+			for (auto kernel : kernels) {
+				GfSetKernel(kernel);
+
+				LuigiFecDecoder decoder(k, r);
+				if (!VerifyDecode(&decoder, group, k, r, size)) {
+					all_passed = false;
+					std::cout << "\ndecode mismatch, kernel:"
+						<< GfKernelName(kernel) << std::endl;
+				}
+
+				std::cout << std::setw(11) << MeasureMBps([&]() {
+					Decode(&decoder, group, k, r, size, work);
+				}, k, size, duration);
+			}
+
+			std::cout << std::endl;
+		}
+	}
+
+	GfSetKernel(GfBestKernel());
+
+	std::cout << (all_passed ? "all passed" : "FAILED") << std::endl;
+
+	return all_passed ? 0 : -1;
+}
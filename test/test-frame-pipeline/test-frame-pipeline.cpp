@@ -0,0 +1,429 @@
+// test-frame-pipeline.cpp : Compare allocation rate and memory traffic of the
+// camera->convert->encode->send plus local render pipeline, with frames deep
+// copied by each consumer (legacy) and with pooled frames shared by reference
+// count. Capture, convert and encode run like the elements do, encode and
+// render consume frames from their own queues on their own threads.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <new>
+#include <cstdlib>
+
+#include "if-pin.h"
+#include "frame-pool.h"
+#include "util-streamer.h"
+#include "common-config.h"
+#include "common/util-common.h"
+#include "common/util-time.h"
+#include "clipp.h"
+
+using namespace jukey;
+using namespace jukey::stmr;
+using namespace jukey::media::util;
+
+using namespace clipp;
+
+//==============================================================================
+// Count every heap allocation of the process
+//==============================================================================
+static std::atomic<uint64_t> g_alloc_count(0);
+static std::atomic<uint64_t> g_alloc_bytes(0);
+
+void* operator new(size_t size)
+{
+	g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+	g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+
+	void* p = std::malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// Bytes read and written by the stages
+static std::atomic<uint64_t> g_moved_bytes(0);
+
+//==============================================================================
+// ClonePinData before frames were shared, every plane is copied
+//==============================================================================
+PinDataSP LegacyClonePinData(const PinData& data)
+{
+	PinDataSP new_data(new PinData(data));
+
+	for (auto i = 0; i < 8; i++) {
+		uint32_t i_len = data.media_data[i].data_len;
+		if (i_len > 0) {
+			new_data->media_data[i].data.reset(new uint8_t[i_len]);
+			new_data->media_data[i].data_len = i_len;
+			new_data->media_data[i].total_len = i_len;
+			new_data->media_data[i].start_pos = 0;
+			memcpy(DP(new_data->media_data[i]), DP(data.media_data[i]), i_len);
+			g_moved_bytes.fetch_add(i_len * 2, std::memory_order_relaxed);
+		}
+	}
+
+	return new_data;
+}
+
+//==============================================================================
+// Queue of a consumer element, oldest frame is dropped when full
+//==============================================================================
+class FrameQueue
+{
+public:
+	FrameQueue(uint32_t max_size) : m_max_size(max_size) {}
+
+	void Push(const PinDataSP& data)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_que.size() >= m_max_size) {
+			m_que.pop_front();
+			++m_drop_count;
+		}
+		m_que.push_back(data);
+		m_con_var.notify_one();
+	}
+
+	PinDataSP Pop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_con_var.wait(lock, [this] { return !m_que.empty() || m_stop; });
+		if (m_que.empty()) return nullptr;
+
+		PinDataSP data = m_que.front();
+		m_que.pop_front();
+		return data;
+	}
+
+	void Stop()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_con_var.notify_all();
+	}
+
+	uint64_t DropCount() const { return m_drop_count; }
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_con_var;
+	std::deque<PinDataSP> m_que;
+	uint32_t m_max_size = 0;
+	uint64_t m_drop_count = 0;
+	bool m_stop = false;
+};
+
+//------------------------------------------------------------------------------
+// Touch every byte of the frame, like encoder input or texture upload
+//------------------------------------------------------------------------------
+uint64_t ReadFrame(const PinData& data)
+{
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < data.data_count; i++) {
+		const uint64_t* p = (const uint64_t*)DP(data.media_data[i]);
+		uint32_t count = data.media_data[i].data_len / 8;
+		for (uint32_t j = 0; j < count; j++) {
+			sum += p[j];
+		}
+		g_moved_bytes.fetch_add(data.media_data[i].data_len,
+			std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+//------------------------------------------------------------------------------
+// YUY2 to I420, stands for sws_scale of convert element
+//------------------------------------------------------------------------------
+void ConvertFrame(const uint8_t* src, uint32_t width, uint32_t height,
+	uint8_t* y, uint8_t* u, uint8_t* v)
+{
+	for (uint32_t row = 0; row < height; row++) {
+		const uint8_t* s = src + row * width * 2;
+		uint8_t* dy = y + row * width;
+		for (uint32_t col = 0; col < width; col++) {
+			dy[col] = s[col * 2];
+		}
+
+		if (row % 2 == 0) {
+			uint8_t* du = u + row / 2 * width / 2;
+			uint8_t* dv = v + row / 2 * width / 2;
+			for (uint32_t col = 0; col < width / 2; col++) {
+				du[col] = s[col * 4 + 1];
+				dv[col] = s[col * 4 + 3];
+			}
+		}
+	}
+
+	g_moved_bytes.fetch_add(width * height * 2 + width * height * 3 / 2,
+		std::memory_order_relaxed);
+}
+
+//==============================================================================
+//
+//==============================================================================
+struct TestParam
+{
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t frames = 600;
+	uint32_t encode_que = 3;
+	uint32_t render_que = 2;
+	uint32_t packet_len = 30000; // encoded frame
+};
+
+//==============================================================================
+//
+//==============================================================================
+class ITest
+{
+public:
+	virtual ~ITest() {}
+
+	// Camera frame copied from device buffer
+	virtual void Capture(const uint8_t* buf, uint32_t len, PinData& data) = 0;
+
+	// Converted frame
+	virtual void Convert(const PinData& src, PinData& dst) = 0;
+
+	// Frame queued by a consumer element
+	virtual PinDataSP Queue(const PinData& data) = 0;
+
+	virtual const char* Name() = 0;
+
+	virtual void Report() {}
+};
+
+//==============================================================================
+// Original elements: heap frame per capture and convert, converted planes are
+// borrowed, consumers deep copy
+//==============================================================================
+class TestLegacyFlow : public ITest
+{
+public:
+	TestLegacyFlow(const TestParam& param) : m_param(param) {}
+
+	virtual void Capture(const uint8_t* buf, uint32_t len, PinData& data)
+		override
+	{
+		data = PinData(media::MediaType::VIDEO, (uint8_t*)buf, len);
+		g_moved_bytes.fetch_add(len * 2, std::memory_order_relaxed);
+	}
+
+	virtual void Convert(const PinData& src, PinData& dst) override
+	{
+		uint32_t y_len = m_param.width * m_param.height;
+		m_conv_buf.reset(new uint8_t[y_len * 3 / 2]);
+
+		uint8_t* y = m_conv_buf.get();
+		uint8_t* u = y + y_len;
+		uint8_t* v = u + y_len / 4;
+		ConvertFrame(DP(src.media_data[0]), m_param.width, m_param.height, y, u, v);
+
+		dst = PinData(media::MediaType::VIDEO);
+		dst.media_data[0].data.reset(y, util::NoDestruct);
+		dst.media_data[0].data_len = y_len;
+		dst.media_data[1].data.reset(u, util::NoDestruct);
+		dst.media_data[1].data_len = y_len / 4;
+		dst.media_data[2].data.reset(v, util::NoDestruct);
+		dst.media_data[2].data_len = y_len / 4;
+		dst.data_count = 3;
+		dst.media_para = src.media_para;
+	}
+
+	virtual PinDataSP Queue(const PinData& data) override
+	{
+		return LegacyClonePinData(data);
+	}
+
+	virtual const char* Name() override { return "legacy"; }
+
+private:
+	TestParam m_param;
+	std::shared_ptr<uint8_t> m_conv_buf;
+};
+
+//==============================================================================
+// Capture and convert allocate from frame pools, consumers share frames
+//==============================================================================
+class TestPooledFlow : public ITest
+{
+public:
+	TestPooledFlow(const TestParam& param) : m_param(param) {}
+
+	virtual void Capture(const uint8_t* buf, uint32_t len, PinData& data)
+		override
+	{
+		data = PinData(media::MediaType::VIDEO);
+		m_cam_pool.AllocFrame(data, &len, 1);
+		memcpy(DP(data.media_data[0]), buf, len);
+		g_moved_bytes.fetch_add(len * 2, std::memory_order_relaxed);
+	}
+
+	virtual void Convert(const PinData& src, PinData& dst) override
+	{
+		uint32_t y_len = m_param.width * m_param.height;
+		uint32_t plane_lens[3] = { y_len, y_len / 4, y_len / 4 };
+
+		dst = PinData(media::MediaType::VIDEO);
+		m_conv_pool.AllocFrame(dst, plane_lens, 3);
+
+		ConvertFrame(DP(src.media_data[0]), m_param.width, m_param.height,
+			DP(dst.media_data[0]), DP(dst.media_data[1]), DP(dst.media_data[2]));
+		dst.media_para = src.media_para;
+	}
+
+	virtual PinDataSP Queue(const PinData& data) override
+	{
+		return ClonePinData(data);
+	}
+
+	virtual const char* Name() override { return "pooled"; }
+
+	virtual void Report() override
+	{
+		std::cout << "  camera pool miss:" << m_cam_pool.Stats().miss_count
+			<< ", convert pool miss:" << m_conv_pool.Stats().miss_count
+			<< std::endl;
+	}
+
+private:
+	TestParam m_param;
+	FramePool m_cam_pool { VIDEO_FRAME_POOL_SIZE };
+	FramePool m_conv_pool { VIDEO_FRAME_POOL_SIZE };
+};
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void RunTest(ITest* test, const TestParam& param)
+{
+	uint32_t cam_len = param.width * param.height * 2;
+	std::unique_ptr<uint8_t[]> device_buf(new uint8_t[cam_len]);
+	for (uint32_t i = 0; i < cam_len; i++) {
+		device_buf[i] = (uint8_t)i;
+	}
+	std::unique_ptr<uint8_t[]> packet(new uint8_t[param.packet_len]);
+	memset(packet.get(), 0, param.packet_len);
+
+	FrameQueue encode_que(param.encode_que);
+	FrameQueue render_que(param.render_que);
+
+	std::atomic<uint64_t> sent_bytes(0);
+	std::atomic<uint64_t> checksum(0);
+
+	// Encode element thread, output is sent as one packet per frame
+	std::thread encode_thread([&]() {
+		while (PinDataSP data = encode_que.Pop()) {
+			checksum += ReadFrame(*data);
+
+			PinData encoded(media::MediaType::VIDEO, packet.get(), param.packet_len);
+			sent_bytes += encoded.media_data[0].data_len;
+		}
+	});
+
+	// Render thread
+	std::thread render_thread([&]() {
+		while (PinDataSP data = render_que.Pop()) {
+			checksum += ReadFrame(*data);
+		}
+	});
+
+	g_moved_bytes = 0;
+	uint64_t alloc_count = g_alloc_count;
+	uint64_t alloc_bytes = g_alloc_bytes;
+	uint64_t start = util::Now();
+
+	for (uint32_t i = 0; i < param.frames; i++) {
+		PinData cam_data;
+		test->Capture(device_buf.get(), cam_len, cam_data);
+
+		PinData conv_data;
+		test->Convert(cam_data, conv_data);
+
+		// Fan-out of src pin
+		encode_que.Push(test->Queue(conv_data));
+		render_que.Push(test->Queue(conv_data));
+	}
+
+	encode_que.Stop();
+	render_que.Stop();
+	encode_thread.join();
+	render_thread.join();
+
+	uint64_t duration = std::max<uint64_t>(util::Now() - start, 1);
+	alloc_count = g_alloc_count - alloc_count;
+	alloc_bytes = g_alloc_bytes - alloc_bytes;
+	uint64_t moved_bytes = g_moved_bytes;
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< test->Name()
+		<< ", frames:" << param.frames
+		<< ", fps:" << param.frames * 1000000.0 / duration
+		<< ", allocs/frame:" << (double)alloc_count / param.frames
+		<< ", alloc MB/frame:" << alloc_bytes / 1048576.0 / param.frames
+		<< ", alloc MB/s:" << alloc_bytes / 1.048576 / duration
+		<< ", moved MB/frame:" << moved_bytes / 1048576.0 / param.frames
+		<< ", bandwidth MB/s:" << moved_bytes / 1.048576 / duration
+		<< std::endl;
+	std::cout << "  encode drop:" << encode_que.DropCount()
+		<< ", render drop:" << render_que.DropCount()
+		<< ", sent bytes:" << sent_bytes
+		<< ", checksum:" << (checksum & 0xFFFF) << std::endl;
+
+	test->Report();
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	TestParam param;
+	uint32_t type = 0;
+
+	auto cli = (
+		option("-w", "--width") & value("frame width", param.width),
+		option("-h", "--height") & value("frame height", param.height),
+		option("-f", "--frames") & value("frame count", param.frames),
+		option("-e", "--encode-queue") & value("encode queue size",
+			param.encode_que),
+		option("-r", "--render-queue") & value("render queue size",
+			param.render_que),
+		option("-t", "--type") & value("0: both, 1: legacy, 2: pooled", type)
+	);
+
+	if (!parse(argc, argv, cli) || param.width % 2 || param.height % 2) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	std::cout << param.width << "x" << param.height
+		<< ", frames:" << param.frames << std::endl;
+
+	if (type == 0 || type == 1) {
+		TestLegacyFlow test(param);
+		RunTest(&test, param);
+	}
+
+	if (type == 0 || type == 2) {
+		TestPooledFlow test(param);
+		RunTest(&test, param);
+	}
+
+	return 0;
+}
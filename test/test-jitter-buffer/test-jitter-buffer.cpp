@@ -0,0 +1,270 @@
+// test-jitter-buffer.cpp : Replay frame arrival traces through JitterBuffer and
+// report the latency and underrun trade-off of jitter factors. A trace is a
+// text file of "arrival_ms ts_ms [key]" lines, or it is generated with the
+// given jitter and burst delay, and can be saved for later replay.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "jitter-buffer.h"
+#include "log.h"
+#include "clipp.h"
+
+using namespace jukey;
+using namespace jukey::media::util;
+
+using namespace clipp;
+
+#define TICK_MS 10
+
+//==============================================================================
+// Options
+//==============================================================================
+struct TraceParam
+{
+	std::string trace_file;
+	std::string save_file;
+	std::string media = "video";
+	uint32_t duration_s = 120;
+	uint32_t jitter_ms = 20;  // mean of exponential extra delay
+	uint32_t burst = 1;       // percentage of frames delayed by burst
+	uint32_t burst_ms = 200;
+	uint32_t catch_up_ms = 300;
+};
+
+//==============================================================================
+// 
+//==============================================================================
+struct TraceItem
+{
+	uint64_t arrival_ms = 0;
+	uint32_t ts = 0;
+	bool key = false;
+};
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool LoadTrace(const std::string& file, std::vector<TraceItem>& trace)
+{
+	std::ifstream ifs(file);
+	if (!ifs) {
+		std::cout << "Open trace file " << file << " failed" << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(ifs, line)) {
+		if (line.empty() || line[0] == '#') continue;
+
+		std::istringstream iss(line);
+		TraceItem item;
+		uint32_t key = 0;
+		if (!(iss >> item.arrival_ms >> item.ts)) continue;
+		if (iss >> key) item.key = (key != 0);
+		trace.push_back(item);
+	}
+
+	std::stable_sort(trace.begin(), trace.end(), 
+		[](const TraceItem& a, const TraceItem& b) {
+			return a.arrival_ms < b.arrival_ms;
+		});
+
+	return !trace.empty();
+}
+
+//------------------------------------------------------------------------------
+// Audio 20ms frames, video 30fps with key frame every 2 seconds. Bursts delay
+// a run of frames, as a stall of the network does.
+//------------------------------------------------------------------------------
+void GenerateTrace(const TraceParam& param, std::vector<TraceItem>& trace)
+{
+	bool audio = (param.media == "audio");
+	double interval = audio ? 20.0 : 1000.0 / 30;
+	uint32_t count = (uint32_t)(param.duration_s * 1000 / interval);
+
+	std::mt19937 rng(1234);
+	std::exponential_distribution<double> jitter(1.0 / std::max(1u, 
+		param.jitter_ms));
+	std::uniform_int_distribution<uint32_t> percent(0, 99);
+
+	uint64_t base_ms = 1000;
+	uint32_t burst_left = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		TraceItem item;
+		item.ts = (uint32_t)(i * interval);
+		item.key = !audio && (i % 60 == 0);
+
+		if (burst_left == 0 && percent(rng) < param.burst) {
+			burst_left = (uint32_t)(param.burst_ms / interval) + 1;
+		}
+
+		// Frames in burst arrive together at the end of the stall
+		double extra = param.jitter_ms ? jitter(rng) : 0;
+		if (burst_left > 0) {
+			extra += burst_left * interval;
+			burst_left--;
+		}
+
+		item.arrival_ms = base_ms + item.ts + (uint64_t)extra;
+		trace.push_back(item);
+	}
+
+	std::stable_sort(trace.begin(), trace.end(),
+		[](const TraceItem& a, const TraceItem& b) {
+			return a.arrival_ms < b.arrival_ms;
+		});
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SaveTrace(const std::string& file, const std::vector<TraceItem>& trace)
+{
+	std::ofstream ofs(file);
+	ofs << "# arrival_ms ts_ms key" << std::endl;
+	for (const auto& item : trace) {
+		ofs << item.arrival_ms << " " << item.ts << " " << item.key << std::endl;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Latency is playout time over the minimum transfer delay of the trace
+//------------------------------------------------------------------------------
+void Replay(const TraceParam& param, const std::vector<TraceItem>& trace,
+	uint32_t factor, uint32_t min_delay_ms)
+{
+	media::MediaType mt = (param.media == "audio") 
+		? media::MediaType::AUDIO : media::MediaType::VIDEO;
+
+	JitterParam jp;
+	jp.jitter_factor = factor;
+	jp.min_delay_ms = min_delay_ms;
+	jp.catch_up_ms = param.catch_up_ms;
+
+	JitterBuffer jb(mt, jp);
+
+	int64_t min_transfer = INT64_MAX;
+	for (const auto& item : trace) {
+		min_transfer = std::min(min_transfer, (int64_t)item.arrival_ms - item.ts);
+	}
+
+	std::vector<JitterFrame> frames;
+	std::vector<int64_t> latency;
+	uint64_t now = trace.front().arrival_ms;
+	uint64_t end = trace.back().arrival_ms + 2000;
+	size_t next = 0;
+
+	for (; now <= end; now += TICK_MS) {
+		while (next < trace.size() && trace[next].arrival_ms <= now) {
+			JitterFrame frame;
+			frame.ts = trace[next].ts;
+			frame.key = trace[next].key;
+			jb.InputFrame(frame, trace[next].arrival_ms);
+			next++;
+		}
+
+		frames.clear();
+		jb.PopFrames(now, frames);
+
+		// Released at this tick
+		for (const auto& frame : frames) {
+			latency.push_back((int64_t)now - frame.ts - min_transfer);
+		}
+	}
+
+	JitterStats stats = jb.Stats();
+
+	double avg = 0;
+	int64_t p95 = 0;
+	if (!latency.empty()) {
+		for (auto l : latency) avg += l;
+		avg /= latency.size();
+		std::sort(latency.begin(), latency.end());
+		p95 = latency[latency.size() * 95 / 100];
+	}
+
+	std::cout << std::setw(8) << factor
+		<< std::setw(8) << min_delay_ms
+		<< std::fixed << std::setprecision(1)
+		<< std::setw(12) << avg
+		<< std::setw(10) << p95
+		<< std::setw(10) << stats.late_frames
+		<< std::setw(10) << (double)stats.late_frames * 100 / trace.size()
+		<< std::setw(10) << stats.dropped_frames
+		<< std::setw(10) << stats.jitter_ms
+		<< std::endl;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	TraceParam param;
+
+	auto cli = (
+		option("-f", "--file") & value("trace file", param.trace_file),
+		option("-s", "--save") & value("save trace file", param.save_file),
+		option("-m", "--media") & value("audio|video", param.media),
+		option("-d", "--duration") & value("seconds", param.duration_s),
+		option("-j", "--jitter") & value("mean jitter(ms)", param.jitter_ms),
+		option("-b", "--burst") & value("burst(%)", param.burst),
+		option("-B", "--burst-ms") & value("burst delay(ms)", param.burst_ms),
+		option("-c", "--catch-up") & value("catch up(ms)", param.catch_up_ms)
+	);
+
+	if (!parse(argc, argv, cli) || param.burst >= 100
+		|| (param.media != "audio" && param.media != "video")) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	// Errors only, catch up logs are not needed
+	g_logger->SetLogLevel(4);
+
+	std::vector<TraceItem> trace;
+	if (!param.trace_file.empty()) {
+		if (!LoadTrace(param.trace_file, trace)) {
+			return -1;
+		}
+	}
+	else {
+		GenerateTrace(param, trace);
+	}
+
+	if (!param.save_file.empty()) {
+		SaveTrace(param.save_file, trace);
+	}
+
+	std::cout << "media:" << param.media << ", frames:" << trace.size() 
+		<< std::endl;
+
+	std::cout << std::setw(8) << "factor"
+		<< std::setw(8) << "min"
+		<< std::setw(12) << "avg(ms)"
+		<< std::setw(10) << "p95(ms)"
+		<< std::setw(10) << "late"
+		<< std::setw(10) << "late(%)"
+		<< std::setw(10) << "dropped"
+		<< std::setw(10) << "jitter"
+		<< std::endl;
+
+	// Fixed delay without adaption as reference
+	for (uint32_t min_delay : { 40, 100, 200 }) {
+		Replay(param, trace, 0, min_delay);
+	}
+
+	for (uint32_t factor : { 1, 2, 3, 4, 6, 8 }) {
+		Replay(param, trace, factor, 0);
+	}
+
+	return 0;
+}
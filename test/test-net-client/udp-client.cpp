@@ -53,8 +53,8 @@ void SendUdpDataFunc(IUdpMgr* udp_mgr, Socket cs, Endpoint ep, uint32_t size,
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void UdpClient::OnRecvUdpData(const Endpoint& lep, const Endpoint& rep,
-	SocketId sock, Buffer buf)
+void UdpClient::OnRecvUdpData(const Endpoint& lep, const BinEndpoint& rep,
+	SocketId sock, uint32_t shard, Buffer buf)
 {
 
 }
@@ -102,12 +102,12 @@ bool UdpClient::Init(const ClientParam& param)
 		return false;
 	}
 
-	if (ErrCode::ERR_CODE_OK != m_udp_mgr->Init(this)) {
+	if (ErrCode::ERR_CODE_OK != m_udp_mgr->Init(this, 1, 0)) {
 		std::cout << "Init udp manager failed!" << std::endl;
 		return false;
 	}
 
-	m_client_socket = m_udp_mgr->CreateClientSocket();
+	m_client_socket = m_udp_mgr->CreateClientSocket(0);
 	if (m_client_socket <= 0) {
 		std::cout << "Create udp client socket failed!" << std::endl;
 		return false;
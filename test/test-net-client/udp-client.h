@@ -16,8 +16,9 @@ class UdpClient : public IUdpHandler, public IClient
 public:
   // IUdpHandler
   virtual void OnRecvUdpData(const Endpoint& lep, 
-    const Endpoint& rep,
+    const BinEndpoint& rep,
     SocketId sock, 
+    uint32_t shard,
     Buffer buf) override;
   virtual void OnSocketClosed(const Endpoint& lep, 
     const Endpoint& rep,
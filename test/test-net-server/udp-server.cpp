@@ -17,8 +17,8 @@ using namespace std::placeholders;
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void UdpServer::OnRecvUdpData(const Endpoint& lep, const Endpoint& rep, 
-  SocketId sock, Buffer buf)
+void UdpServer::OnRecvUdpData(const Endpoint& lep, const BinEndpoint& rep, 
+  SocketId sock, uint32_t shard, Buffer buf)
 {
 	m_pkt_count++;
 	m_recv_size += buf.data_len;
@@ -65,7 +65,7 @@ bool UdpServer::Init(const std::string& addr, uint32_t log_level)
 		return false;
 	}
 
-	if (ErrCode::ERR_CODE_OK != m_udp_mgr->Init(this)) {
+	if (ErrCode::ERR_CODE_OK != m_udp_mgr->Init(this, 1, 0)) {
 		std::cout << "Init udp manager failed!" << std::endl;
 		return false;
 	}
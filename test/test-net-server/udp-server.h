@@ -21,8 +21,9 @@ class UdpServer
 public:
   // IUdpHandler
   virtual void OnRecvUdpData(const Endpoint& lep, 
-    const Endpoint& rep,
+    const BinEndpoint& rep,
     SocketId sock, 
+    uint32_t shard,
     Buffer buf) override;
   virtual void OnSocketClosed(const Endpoint& lep, 
     const Endpoint& rep,
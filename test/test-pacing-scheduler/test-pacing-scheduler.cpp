@@ -0,0 +1,347 @@
+// test-pacing-scheduler.cpp : Measure timer wakeups, CPU and per-packet pacing
+// delay of many paced video flows, with one PacingSender timer per flow and
+// with all flows served by one shared PacingScheduler. Each flow queues a
+// frame every frame interval, the delay of a packet is from queueing to
+// leaving the pacer.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+
+#include "com-factory.h"
+#include "if-timer-mgr.h"
+#include "pacing-sender.h"
+#include "pacing-scheduler.h"
+#include "log.h"
+#include "common/util-time.h"
+#include "clipp.h"
+
+using namespace jukey::base;
+using namespace jukey::com;
+using namespace jukey::txp;
+using namespace jukey::util;
+
+using namespace clipp;
+
+#define PACKET_SIZE 1200
+
+//==============================================================================
+// Options
+//==============================================================================
+struct BenchParam
+{
+	uint32_t type = 1; // 0:pacing sender per flow, 1:shared pacing scheduler
+	uint32_t flows = 1000;
+	uint32_t bitrate_kbps = 1000;
+	uint32_t fps = 30;
+	uint32_t duration_s = 10;
+};
+
+//==============================================================================
+// Timer manager counting callback invocations of wrapped timers
+//==============================================================================
+class CountingTimerMgr : public ITimerMgr
+{
+public:
+	CountingTimerMgr(ITimerMgr* timer_mgr) : m_timer_mgr(timer_mgr) {}
+
+	// IUnknown
+	virtual void* QueryInterface(const char* riid) override { return this; }
+	virtual uint32_t AddRef() override { return 1; }
+	virtual uint32_t Release() override { return 1; }
+
+	// ITimerMgr
+	virtual void Start() override { m_timer_mgr->Start(); }
+	virtual void Stop() override { m_timer_mgr->Stop(); }
+	virtual TimerId AllocTimer(const TimerParam& param) override
+	{
+		TimerParam counting = param;
+		counting.timer_func = [this, func = param.timer_func](int64_t data) {
+			m_fires++;
+			func(data);
+		};
+		return m_timer_mgr->AllocTimer(counting);
+	}
+	virtual void FreeTimer(TimerId timer_id) override
+	{
+		m_timer_mgr->FreeTimer(timer_id);
+	}
+	virtual void StartTimer(TimerId timer_id) override
+	{
+		m_timer_mgr->StartTimer(timer_id);
+	}
+	virtual void StopTimer(TimerId timer_id) override
+	{
+		m_timer_mgr->StopTimer(timer_id);
+	}
+	virtual bool UpdateTimeout(TimerId timer_id, uint32_t timeout_ms) override
+	{
+		return m_timer_mgr->UpdateTimeout(timer_id, timeout_ms);
+	}
+
+	std::atomic<uint64_t> m_fires { 0 };
+
+private:
+	ITimerMgr* m_timer_mgr = nullptr;
+};
+
+//==============================================================================
+// Hands the counting timer manager to pacers, others go to the real factory
+//==============================================================================
+class BenchFactory : public IComFactory
+{
+public:
+	BenchFactory(IComFactory* factory, ITimerMgr* timer_mgr)
+		: m_factory(factory), m_timer_mgr(timer_mgr) {}
+
+	virtual bool Init(const std::string& com_dir) override { return true; }
+	virtual IUnknown* CreateComponent(const std::string& cid,
+		const std::string& owner) override
+	{
+		return m_factory->CreateComponent(cid, owner);
+	}
+	virtual void* QueryInterface(const std::string& cid, const std::string& iid,
+		const std::string& owner) override
+	{
+		if (cid == CID_TIMER_MGR) {
+			return &m_timer_mgr;
+		}
+		return m_factory->QueryInterface(cid, iid, owner);
+	}
+	virtual void GetComponents(const std::string& iid,
+		std::vector<std::string>& cids) override
+	{
+		m_factory->GetComponents(iid, cids);
+	}
+	virtual void AddComObj(const ComObj& co) override
+	{
+		m_factory->AddComObj(co);
+	}
+	virtual void RemoveComObj(const std::string& oid) override
+	{
+		m_factory->RemoveComObj(oid);
+	}
+	virtual std::vector<ComObj> GetComObjList(const std::string& cid) override
+	{
+		return m_factory->GetComObjList(cid);
+	}
+
+	CountingTimerMgr m_timer_mgr;
+
+private:
+	IComFactory* m_factory = nullptr;
+};
+
+//==============================================================================
+// Queueing time is carried in the packet
+//==============================================================================
+class FlowSink : public IPacingSenderHandler
+{
+public:
+	virtual void OnPacingData(const Buffer& buf) override
+	{
+		uint64_t queued_us = *(uint64_t*)DP(buf);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_delays.push_back(static_cast<uint32_t>(Now() - queued_us));
+	}
+
+	std::vector<uint32_t> Delays()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_delays;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<uint32_t> m_delays;
+};
+
+//==============================================================================
+// A flow of either pacer type
+//==============================================================================
+class BenchFlow
+{
+public:
+	BenchFlow(IComFactory* factory, PacingScheduler* scheduler,
+		uint32_t rate_kbps)
+		: m_scheduler(scheduler)
+	{
+		if (m_scheduler) {
+			m_flow_id = m_scheduler->AddFlow(&m_sink);
+			m_scheduler->SetPacingRate(m_flow_id, rate_kbps);
+		}
+		else {
+			m_sender.reset(new PacingSender(factory, &m_sink));
+			m_sender->SetPacingRate(rate_kbps);
+		}
+	}
+
+	~BenchFlow()
+	{
+		if (m_scheduler) {
+			m_scheduler->RemoveFlow(m_flow_id);
+		}
+	}
+
+	void SendFrame(uint32_t frame_bytes)
+	{
+		uint64_t now = Now();
+		while (frame_bytes > 0) {
+			uint32_t len = std::min<uint32_t>(frame_bytes, PACKET_SIZE);
+			len = std::max<uint32_t>(len, sizeof(uint64_t));
+			frame_bytes -= std::min(frame_bytes, len);
+
+			Buffer buf(len, len);
+			*(uint64_t*)DP(buf) = now;
+
+			if (m_scheduler) {
+				m_scheduler->EnqueueData(m_flow_id, buf, DP_LOW);
+			}
+			else {
+				m_sender->EnqueueData(buf, DP_LOW);
+			}
+		}
+	}
+
+	FlowSink& Sink() { return m_sink; }
+
+private:
+	FlowSink m_sink;
+	PacingScheduler* m_scheduler = nullptr;
+	PacingFlowId m_flow_id = INVALID_PACING_FLOW_ID;
+	std::unique_ptr<PacingSender> m_sender;
+};
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+uint32_t Percentile(const std::vector<uint32_t>& sorted, uint32_t per_mille)
+{
+	if (sorted.empty()) return 0;
+	return sorted[std::min(sorted.size() - 1, sorted.size() * per_mille / 1000)];
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	BenchParam param;
+
+	auto cli = (
+		option("-t", "--type") & value("0:pacing sender, 1:pacing scheduler",
+			param.type),
+		option("-n", "--flows") & value("flow count", param.flows),
+		option("-b", "--bitrate") & value("kbps of each flow", param.bitrate_kbps),
+		option("-f", "--fps") & value("frames per second", param.fps),
+		option("-d", "--duration") & value("test duration(s)", param.duration_s)
+	);
+
+	if (!parse(argc, argv, cli) || param.type > 1 || param.flows == 0
+		|| param.fps == 0 || param.duration_s == 0) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	IComFactory* factory = GetComFactory();
+	if (!factory->Init("./")) {
+		std::cout << "Init faild!" << std::endl;
+		return -1;
+	}
+
+	// Use a dedicated timer manager to exclude timers of other components
+	jukey::base::IUnknown* com = factory->CreateComponent(CID_TIMER_MGR, "test");
+	if (!com) {
+		std::cout << "Create timer manager failed!" << std::endl;
+		return -1;
+	}
+
+	ITimerMgr* timer_mgr = (ITimerMgr*)com->QueryInterface(IID_TIMER_MGR);
+	if (!timer_mgr) {
+		std::cout << "Query timer manager failed!" << std::endl;
+		return -1;
+	}
+	timer_mgr->Start();
+
+	// Errors only, logging is not measured
+	g_txp_logger->SetLogLevel(4);
+
+	BenchFactory bench_factory(factory, timer_mgr);
+
+	std::unique_ptr<PacingScheduler> scheduler;
+	if (param.type == 1) {
+		scheduler.reset(new PacingScheduler(&bench_factory));
+	}
+
+	std::vector<std::unique_ptr<BenchFlow>> flows;
+	for (uint32_t i = 0; i < param.flows; i++) {
+		flows.emplace_back(new BenchFlow(&bench_factory, scheduler.get(),
+			param.bitrate_kbps));
+	}
+
+	uint32_t frame_bytes = param.bitrate_kbps * 1000 / 8 / param.fps;
+	uint64_t frame_us = 1000000 / param.fps;
+	uint64_t frames = (uint64_t)param.duration_s * param.fps;
+
+	uint64_t start_fires = bench_factory.m_timer_mgr.m_fires;
+	uint64_t start_us = Now();
+	std::clock_t start_cpu = std::clock();
+
+	// Frames of flows are spread over the frame interval
+	for (uint64_t frame = 0; frame < frames; frame++) {
+		for (uint32_t i = 0; i < param.flows; i++) {
+			uint64_t due_us = start_us + frame * frame_us
+				+ frame_us * i / param.flows;
+			uint64_t now = Now();
+			if (due_us > now) {
+				std::this_thread::sleep_for(std::chrono::microseconds(due_us - now));
+			}
+			flows[i]->SendFrame(frame_bytes);
+		}
+	}
+
+	// Drain queues
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	uint64_t wall_us = Now() - start_us;
+	double cpu_us = (double)(std::clock() - start_cpu) * 1000000 / CLOCKS_PER_SEC;
+	uint64_t fires = bench_factory.m_timer_mgr.m_fires - start_fires;
+
+	std::vector<uint32_t> delays;
+	for (auto& flow : flows) {
+		std::vector<uint32_t> flow_delays = flow->Sink().Delays();
+		delays.insert(delays.end(), flow_delays.begin(), flow_delays.end());
+	}
+	std::sort(delays.begin(), delays.end());
+
+	flows.clear();
+	scheduler.reset();
+	timer_mgr->Stop();
+
+	std::cout << "type:" << (param.type == 0 ? "pacing sender" : "pacing scheduler")
+		<< ", flows:" << param.flows
+		<< ", bitrate:" << param.bitrate_kbps << "kbps"
+		<< ", fps:" << param.fps
+		<< std::endl;
+	std::cout << "packets:" << delays.size()
+		<< ", wakeups/s:" << fires * 1000000 / wall_us
+		<< ", cpu:" << std::fixed << std::setprecision(1)
+		<< cpu_us * 100 / wall_us << "%"
+		<< std::endl;
+	std::cout << "delay p50:" << Percentile(delays, 500) << "us"
+		<< ", p99:" << Percentile(delays, 990) << "us"
+		<< ", p999:" << Percentile(delays, 999) << "us"
+		<< ", max:" << (delays.empty() ? 0 : delays.back()) << "us"
+		<< std::endl;
+
+	return 0;
+}
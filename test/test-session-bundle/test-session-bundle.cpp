@@ -0,0 +1,655 @@
+// test-session-bundle.cpp : Measure server CPU and memory of a conference room
+// with one session per stream and with streams bundled in one session per
+// client and session type. Run the server and the client in two processes:
+//   test-session-bundle -s -a UDP:0.0.0.0:3333
+//   test-session-bundle -c -a UDP:127.0.0.1:3333 -m bundle -p 50
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <fstream>
+
+#ifdef _WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "com-factory.h"
+#include "if-session-mgr.h"
+#include "net-message.h"
+#include "protocol.h"
+#include "thread/common-thread.h"
+#include "async/session-bundle.h"
+#include "common/util-net.h"
+#include "common/util-time.h"
+#include "clipp.h"
+
+using namespace jukey;
+using namespace jukey::base;
+using namespace jukey::com;
+using namespace jukey::net;
+using namespace jukey::util;
+
+using namespace clipp;
+
+// Audio and video of one participant, the same as stream elements
+#define STREAM_KIND_COUNT 2
+static const SessionType kKindSessionType[STREAM_KIND_COUNT] = {
+	SessionType::RELIABLE,  // audio
+	SessionType::UNRELIABLE // video
+};
+
+//==============================================================================
+// Body of login request, channel ID is carried in SigMsgHdr::grp. Channel ID
+// is allocated by client to keep the benchmark self-contained.
+//==============================================================================
+#pragma pack(push, 1)
+struct BenchLogin
+{
+	uint32_t stream = 0; // publisher * STREAM_KIND_COUNT + kind
+	uint8_t send = 0;
+};
+#pragma pack(pop)
+
+//==============================================================================
+// Process wide resource usage
+//==============================================================================
+struct ProcStats
+{
+	uint64_t cpu_us = 0;
+	uint64_t rss_kb = 0;
+};
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ProcStats GetProcStats()
+{
+	ProcStats stats;
+
+#ifdef _WINDOWS
+	FILETIME create_time, exit_time, kernel_time, user_time;
+	if (GetProcessTimes(GetCurrentProcess(), &create_time, &exit_time,
+		&kernel_time, &user_time)) {
+		ULARGE_INTEGER kernel, user;
+		kernel.LowPart = kernel_time.dwLowDateTime;
+		kernel.HighPart = kernel_time.dwHighDateTime;
+		user.LowPart = user_time.dwLowDateTime;
+		user.HighPart = user_time.dwHighDateTime;
+		stats.cpu_us = (kernel.QuadPart + user.QuadPart) / 10;
+	}
+
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		stats.rss_kb = counters.WorkingSetSize / 1024;
+	}
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		stats.cpu_us = usage.ru_utime.tv_sec * 1000000ULL + usage.ru_utime.tv_usec
+			+ usage.ru_stime.tv_sec * 1000000ULL + usage.ru_stime.tv_usec;
+	}
+
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 6, "VmRSS:") == 0) {
+			stats.rss_kb = std::stoull(line.substr(6));
+			break;
+		}
+	}
+#endif
+
+	return stats;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+Buffer BuildMsg(uint32_t mt, uint32_t channel, uint32_t seq, const void* body,
+	uint32_t body_len)
+{
+	uint32_t len = sizeof(prot::SigMsgHdr) + body_len;
+	Buffer buf(len, len);
+
+	prot::SigMsgHdr* hdr = (prot::SigMsgHdr*)DP(buf);
+	hdr->mt = mt;
+	hdr->len = (uint16_t)body_len;
+	hdr->grp = channel;
+	hdr->seq = seq;
+
+	if (body) {
+		memcpy(DP(buf) + sizeof(prot::SigMsgHdr), body, body_len);
+	}
+
+	return buf;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ISessionMgr* CreateSessionMgr()
+{
+	IComFactory* factory = GetComFactory();
+	if (!factory->Init("./")) {
+		std::cout << "Init component factory failed!" << std::endl;
+		return nullptr;
+	}
+
+	ISessionMgr* mgr = (ISessionMgr*)factory->QueryInterface(CID_SESSION_MGR,
+		IID_SESSION_MGR, "test");
+	if (!mgr) {
+		std::cout << "Create session manager failed!" << std::endl;
+		return nullptr;
+	}
+
+	SessionMgrParam param;
+	param.thread_count = 4;
+	param.ka_interval = 5;
+
+	if (ERR_CODE_OK != mgr->Init(param)) {
+		std::cout << "Init session manager failed!" << std::endl;
+		return nullptr;
+	}
+
+	mgr->SetLogLevel(4);
+
+	return mgr;
+}
+
+//==============================================================================
+// Forwards every stream to its subscribers, channels are looked up the same way
+// as transport service
+//==============================================================================
+class BenchServer : public CommonThread
+{
+public:
+	BenchServer(ISessionMgr* mgr) : CommonThread("bench server", true)
+		, m_sess_mgr(mgr) {}
+
+	bool Start(const Address& addr)
+	{
+		ListenParam param;
+		param.listen_addr = addr;
+		param.listen_srv = ServiceType::TRANSPORT;
+		param.thread = this;
+
+		if (m_sess_mgr->AddListen(param) == INVALID_LISTEN_ID) {
+			std::cout << "Add listen failed!" << std::endl;
+			return false;
+		}
+
+		StartThread();
+
+		return true;
+	}
+
+	std::atomic<uint64_t> m_recv_pkts{ 0 };
+	std::atomic<uint64_t> m_send_pkts{ 0 };
+	std::atomic<uint32_t> m_sess_count{ 0 };
+	std::atomic<uint32_t> m_chnl_count{ 0 };
+
+private:
+	struct Channel
+	{
+		SessionId sid = INVALID_SESSION_ID;
+		uint32_t stream = 0;
+		bool send = false;
+	};
+
+	virtual void OnThreadMsg(const CommonMsg& msg) override
+	{
+		switch (msg.msg_type) {
+		case NET_MSG_SESSION_DATA:
+			OnSessionData(msg);
+			break;
+		case NET_MSG_SESSION_CLOSED:
+			OnSessionClosed(msg);
+			break;
+		default:
+			break;
+		}
+	}
+
+	uint32_t GetSessionChannel(SessionId sid, prot::SigMsgHdr* hdr)
+	{
+		auto iter = m_sess_chnls.find(sid);
+		if (iter == m_sess_chnls.end()) {
+			return 0;
+		}
+
+		if (hdr->grp != 0 && iter->second.size() > 1) {
+			return iter->second.count(hdr->grp) ? hdr->grp : 0;
+		}
+
+		return *(iter->second.begin());
+	}
+
+	void OnLogin(SessionId sid, prot::SigMsgHdr* hdr, const Buffer& buf)
+	{
+		BenchLogin* login = (BenchLogin*)(DP(buf) + sizeof(prot::SigMsgHdr));
+
+		Channel channel;
+		channel.sid = sid;
+		channel.stream = login->stream;
+		channel.send = login->send != 0;
+		m_chnls[hdr->grp] = channel;
+
+		auto& sess_chnls = m_sess_chnls[sid];
+		sess_chnls.insert(hdr->grp);
+
+		if (!channel.send) {
+			m_subscribers[channel.stream].insert(hdr->grp);
+		}
+
+		m_sess_count = (uint32_t)m_sess_chnls.size();
+		m_chnl_count = (uint32_t)m_chnls.size();
+
+		uint32_t rsp_mt = channel.send ? prot::MSG_LOGIN_SEND_CHANNEL_RSP
+			: prot::MSG_LOGIN_RECV_CHANNEL_RSP;
+		m_sess_mgr->SendData(sid, BuildMsg(rsp_mt, hdr->grp, hdr->seq, nullptr, 0));
+	}
+
+	void OnStreamData(SessionId sid, prot::SigMsgHdr* hdr, const Buffer& buf)
+	{
+		m_recv_pkts++;
+
+		auto iter = m_chnls.find(GetSessionChannel(sid, hdr));
+		if (iter == m_chnls.end()) {
+			return;
+		}
+
+		auto siter = m_subscribers.find(iter->second.stream);
+		if (siter == m_subscribers.end()) {
+			return;
+		}
+
+		for (auto channel_id : siter->second) {
+			auto citer = m_chnls.find(channel_id);
+			if (citer == m_chnls.end()) {
+				continue;
+			}
+
+			Buffer out(buf.data_len, buf.data_len);
+			memcpy(DP(out), DP(buf), buf.data_len);
+			((prot::SigMsgHdr*)DP(out))->grp = channel_id;
+
+			m_sess_mgr->SendData(citer->second.sid, out);
+			m_send_pkts++;
+		}
+	}
+
+	void OnSessionData(const CommonMsg& msg)
+	{
+		PCAST_COMMON_MSG_DATA(SessionDataMsg);
+
+		if (data->buf.data_len < sizeof(prot::SigMsgHdr)) {
+			return;
+		}
+
+		prot::SigMsgHdr* hdr = (prot::SigMsgHdr*)DP(data->buf);
+
+		switch (hdr->mt) {
+		case prot::MSG_LOGIN_SEND_CHANNEL_REQ:
+		case prot::MSG_LOGIN_RECV_CHANNEL_REQ:
+			OnLogin(data->lsid, hdr, data->buf);
+			break;
+		case prot::MSG_STREAM_DATA:
+			OnStreamData(data->lsid, hdr, data->buf);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void OnSessionClosed(const CommonMsg& msg)
+	{
+		PCAST_COMMON_MSG_DATA(SessionClosedMsg);
+
+		auto iter = m_sess_chnls.find(data->lsid);
+		if (iter == m_sess_chnls.end()) {
+			return;
+		}
+
+		for (auto channel_id : iter->second) {
+			auto citer = m_chnls.find(channel_id);
+			if (citer != m_chnls.end() && !citer->second.send) {
+				m_subscribers[citer->second.stream].erase(channel_id);
+			}
+			m_chnls.erase(channel_id);
+		}
+		m_sess_chnls.erase(iter);
+
+		m_sess_count = (uint32_t)m_sess_chnls.size();
+		m_chnl_count = (uint32_t)m_chnls.size();
+	}
+
+private:
+	ISessionMgr* m_sess_mgr = nullptr;
+
+	std::map<uint32_t, Channel> m_chnls;
+	std::map<SessionId, std::set<uint32_t>> m_sess_chnls;
+
+	// stream -> subscriber channels
+	std::map<uint32_t, std::set<uint32_t>> m_subscribers;
+};
+
+//==============================================================================
+// One send or receive stream of a participant, a member of the bundle or the
+// owner of a private session
+//==============================================================================
+class BenchStream : public IThread
+{
+public:
+	BenchStream(ISessionMgr* mgr, SessionBundle* bundle, uint32_t channel,
+		uint32_t stream, bool send)
+		: m_sess_mgr(mgr), m_bundle(bundle), m_channel(channel)
+	{
+		m_login.stream = stream;
+		m_login.send = send ? 1 : 0;
+	}
+
+	bool Start(const Address& addr, SessionType type)
+	{
+		if (m_bundle) {
+			m_sid = m_bundle->AddMember(this);
+		}
+		else {
+			CreateParam param;
+			param.remote_addr  = addr;
+			param.ka_interval  = 5;
+			param.service_type = ServiceType::TRANSPORT;
+			param.session_type = type;
+			param.thread       = this;
+
+			m_sid = m_sess_mgr->CreateSession(param);
+		}
+
+		return m_sid != INVALID_SESSION_ID;
+	}
+
+	void Stop()
+	{
+		if (m_bundle) {
+			m_bundle->RemoveMember(this);
+		}
+		else {
+			m_sess_mgr->CloseSession(m_sid);
+		}
+	}
+
+	void SendData(const Buffer& payload)
+	{
+		if (!m_logined) return;
+
+		m_sess_mgr->SendData(m_sid, BuildMsg(prot::MSG_STREAM_DATA, m_channel,
+			++m_data_seq, DP(payload), payload.data_len));
+	}
+
+	// Called in session thread
+	virtual bool PostMsg(const CommonMsg& msg) override
+	{
+		if (msg.msg_type == NET_MSG_SESSION_CREATE_RESULT) {
+			PCAST_COMMON_MSG_DATA(SessionCreateResultMsg);
+			if (data->result) {
+				uint32_t seq = m_bundle ? m_bundle->AllocSeq(this) : 1;
+				uint32_t mt = m_login.send ? prot::MSG_LOGIN_SEND_CHANNEL_REQ
+					: prot::MSG_LOGIN_RECV_CHANNEL_REQ;
+				m_sess_mgr->SendData(m_sid, BuildMsg(mt, m_channel, seq, &m_login,
+					sizeof(m_login)));
+			}
+		}
+		else if (msg.msg_type == NET_MSG_SESSION_DATA) {
+			PCAST_COMMON_MSG_DATA(SessionDataMsg);
+			prot::SigMsgHdr* hdr = (prot::SigMsgHdr*)DP(data->buf);
+			if (hdr->mt == prot::MSG_STREAM_DATA) {
+				m_recv_pkts++;
+			}
+			else {
+				m_logined = true;
+			}
+		}
+
+		return true;
+	}
+
+	virtual void Execute(Callable callable, CallParam param) override {}
+
+	virtual ErrCode ExecuteSync(SyncCallableEC callable,
+		CallParam param) override
+	{
+		return ERR_CODE_FAILED;
+	}
+
+	virtual void* ExecuteSync(SyncCallableVP callable, CallParam param) override
+	{
+		return nullptr;
+	}
+
+	bool Logined() const { return m_logined; }
+
+	uint64_t RecvPkts() const { return m_recv_pkts; }
+
+private:
+	ISessionMgr* m_sess_mgr = nullptr;
+	SessionBundle* m_bundle = nullptr;
+	SessionId m_sid = INVALID_SESSION_ID;
+	uint32_t m_channel = 0;
+	BenchLogin m_login;
+	uint32_t m_data_seq = 0;
+	std::atomic<bool> m_logined{ false };
+	std::atomic<uint64_t> m_recv_pkts{ 0 };
+};
+typedef std::unique_ptr<BenchStream> BenchStreamUP;
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int RunServer(const Address& addr, uint32_t interval)
+{
+	ISessionMgr* mgr = CreateSessionMgr();
+	if (!mgr) return -1;
+
+	BenchServer server(mgr);
+	if (!server.Start(addr)) return -1;
+
+	std::cout << std::setw(10) << "sessions"
+		<< std::setw(10) << "channels"
+		<< std::setw(12) << "recv-pps"
+		<< std::setw(12) << "send-pps"
+		<< std::setw(8) << "cpu%"
+		<< std::setw(10) << "rss(MB)"
+		<< std::endl;
+
+	ProcStats last = GetProcStats();
+	uint64_t last_us = Now();
+	uint64_t last_recv = 0;
+	uint64_t last_send = 0;
+
+	while (true) {
+		Sleep(interval * 1000000ULL);
+
+		ProcStats stats = GetProcStats();
+		uint64_t now = Now();
+		uint64_t recv = server.m_recv_pkts;
+		uint64_t send = server.m_send_pkts;
+
+		std::cout << std::setw(10) << server.m_sess_count
+			<< std::setw(10) << server.m_chnl_count
+			<< std::setw(12) << (recv - last_recv) * 1000000 / (now - last_us)
+			<< std::setw(12) << (send - last_send) * 1000000 / (now - last_us)
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(8) << (double)(stats.cpu_us - last.cpu_us) * 100
+				/ (now - last_us)
+			<< std::setw(10) << (double)stats.rss_kb / 1024
+			<< std::endl;
+
+		last = stats;
+		last_us = now;
+		last_recv = recv;
+		last_send = send;
+	}
+
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int RunClient(const Address& addr, bool bundle, uint32_t participants,
+	uint32_t duration, uint32_t video_pkts)
+{
+	ISessionMgr* mgr = CreateSessionMgr();
+	if (!mgr) return -1;
+
+	std::vector<SessionBundleSP> bundles;
+	std::vector<BenchStreamUP> senders;
+	std::vector<BenchStreamUP> receivers;
+	uint32_t channel = 0;
+
+	for (uint32_t p = 0; p < participants; p++) {
+		for (uint32_t kind = 0; kind < STREAM_KIND_COUNT; kind++) {
+			SessionBundle* sb = nullptr;
+			if (bundle) {
+				bundles.push_back(std::make_shared<SessionBundle>(mgr, addr,
+					kKindSessionType[kind]));
+				sb = bundles.back().get();
+			}
+
+			BenchStreamUP sender(new BenchStream(mgr, sb, ++channel,
+				p * STREAM_KIND_COUNT + kind, true));
+			if (!sender->Start(addr, kKindSessionType[kind])) {
+				std::cout << "Start sender failed!" << std::endl;
+				return -1;
+			}
+			senders.push_back(std::move(sender));
+
+			for (uint32_t publisher = 0; publisher < participants; publisher++) {
+				if (publisher == p) continue;
+
+				BenchStreamUP receiver(new BenchStream(mgr, sb, ++channel,
+					publisher * STREAM_KIND_COUNT + kind, false));
+				if (!receiver->Start(addr, kKindSessionType[kind])) {
+					std::cout << "Start receiver failed!" << std::endl;
+					return -1;
+				}
+				receivers.push_back(std::move(receiver));
+			}
+		}
+	}
+
+	std::cout << "mode:" << (bundle ? "bundle" : "stream")
+		<< ", participants:" << participants
+		<< ", streams:" << senders.size() + receivers.size()
+		<< ", sessions:" << (bundle ? bundles.size()
+			: senders.size() + receivers.size()) << std::endl;
+
+	// Wait for login
+	uint64_t deadline = Now() + 10000000;
+	while (Now() < deadline) {
+		uint32_t logined = 0;
+		for (auto& stream : senders) logined += stream->Logined() ? 1 : 0;
+		for (auto& stream : receivers) logined += stream->Logined() ? 1 : 0;
+		if (logined == senders.size() + receivers.size()) break;
+		Sleep(100000);
+	}
+
+	// Audio: 50 packets per second, video: 30 frames per second
+	Buffer audio(160, 160);
+	Buffer video(1000, 1000);
+
+	uint64_t start_us = Now();
+	uint64_t end_us = start_us + duration * 1000000ULL;
+	uint64_t next_tick_us = start_us;
+	uint32_t tick = 0;
+
+	while (Now() < end_us) {
+		for (uint32_t i = 0; i < senders.size(); i++) {
+			if (i % STREAM_KIND_COUNT == 0) {
+				if (tick % 2 == 0) {
+					senders[i]->SendData(audio);
+				}
+			}
+			else if (tick % 10 == 0 || tick % 10 == 3 || tick % 10 == 7) {
+				for (uint32_t j = 0; j < video_pkts; j++) {
+					senders[i]->SendData(video);
+				}
+			}
+		}
+
+		tick++;
+		next_tick_us += 10000;
+		uint64_t now = Now();
+		if (next_tick_us > now) {
+			Sleep(next_tick_us - now);
+		}
+	}
+
+	uint64_t recv_pkts = 0;
+	for (auto& stream : receivers) {
+		recv_pkts += stream->RecvPkts();
+	}
+
+	std::cout << "received packets:" << recv_pkts
+		<< ", per second:" << recv_pkts / duration << std::endl;
+
+	for (auto& stream : senders) stream->Stop();
+	for (auto& stream : receivers) stream->Stop();
+
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	bool server = false;
+	bool client = false;
+	std::string addr_str = "UDP:127.0.0.1:3333";
+	std::string mode = "bundle";
+	uint32_t participants = 50;
+	uint32_t duration = 30;
+	uint32_t interval = 5;
+	uint32_t video_pkts = 2;
+
+	auto cli = (
+		option("-s", "--server").set(server).doc("run as server"),
+		option("-c", "--client").set(client).doc("run as client"),
+		option("-a", "--addr") & value("{UDP|TCP}:IP:Port", addr_str),
+		option("-m", "--mode") & value("stream|bundle", mode),
+		option("-p", "--participants") & value("participant count", participants),
+		option("-d", "--duration") & value("client duration(s)", duration),
+		option("-i", "--interval") & value("server report interval(s)", interval),
+		option("-v", "--video-pkts") & value("packets per video frame", video_pkts)
+	);
+
+	if (!parse(argc, argv, cli) || server == client || participants < 2
+		|| duration == 0 || interval == 0
+		|| (mode != "stream" && mode != "bundle")) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	std::optional<Address> addr = ParseAddress(addr_str);
+	if (!addr.has_value()) {
+		std::cout << "Invalid address:" << addr_str << std::endl;
+		return -1;
+	}
+
+	if (server) {
+		return RunServer(addr.value(), interval);
+	}
+	else {
+		return RunClient(addr.value(), mode == "bundle", participants, duration,
+			video_pkts);
+	}
+}
@@ -0,0 +1,204 @@
+// test-session-lookup.cpp : Compare UDP session lookup with string keyed hash
+// map and binary keyed open-addressing table
+// 
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <unordered_map>
+
+#include "common-struct.h"
+#include "common/util-time.h"
+#include "udp-conn-table.h"
+#include "clipp.h"
+
+using namespace jukey::util;
+using namespace jukey::com;
+using namespace jukey::net;
+
+using namespace clipp;
+
+//==============================================================================
+// 
+//==============================================================================
+class ITest
+{
+public:
+	virtual ~ITest() {}
+
+	virtual void Add(SocketId sock, const Endpoint& ep, SessionId sid) = 0;
+
+	// Lookup from endpoint just like received from udp manager, the original
+	// way received string endpoint, now binary endpoint is received
+	virtual SessionId Find(SocketId sock, const Endpoint& ep,
+		const BinEndpoint& bep) = 0;
+
+	virtual const char* Name() = 0;
+};
+
+//==============================================================================
+// The original way: key is built by endpoint and socket string
+//==============================================================================
+class TestStringMap : public ITest
+{
+public:
+	virtual void Add(SocketId sock, const Endpoint& ep, SessionId sid) override
+	{
+		m_map.insert(std::make_pair(UdpConn(sock, ep), sid));
+	}
+
+	virtual SessionId Find(SocketId sock, const Endpoint& ep,
+		const BinEndpoint& bep) override
+	{
+		auto iter = m_map.find(UdpConn(sock, ep));
+		return iter == m_map.end() ? INVALID_SESSION_ID : iter->second;
+	}
+
+	virtual const char* Name() override { return "string map"; }
+
+private:
+	struct UdpConn
+	{
+		UdpConn(SocketId c, const Endpoint& ep) : sock(c), rep(ep) {}
+
+		SocketId sock;
+		Endpoint rep;
+
+		bool operator==(const UdpConn& conn) const
+		{
+			return sock == conn.sock && rep == conn.rep;
+		}
+	};
+
+	struct UdpConnHash
+	{
+		size_t operator()(const UdpConn& conn) const
+		{
+			return std::hash<std::string>()(
+				conn.rep.ToStr().append(std::to_string(conn.sock)));
+		}
+	};
+
+	std::unordered_map<UdpConn, SessionId, UdpConnHash> m_map;
+};
+
+//==============================================================================
+// Binary endpoint key and open-addressing table
+//==============================================================================
+class TestConnTable : public ITest
+{
+public:
+	virtual void Add(SocketId sock, const Endpoint& ep, SessionId sid) override
+	{
+		UdpConnKey key;
+		ParseBinEndpoint(ep, key.rep);
+		key.sock = sock;
+
+		m_table.Insert(key, sid);
+	}
+
+	virtual SessionId Find(SocketId sock, const Endpoint& ep,
+		const BinEndpoint& bep) override
+	{
+		return m_table.Find(UdpConnKey(sock, bep));
+	}
+
+	virtual const char* Name() override { return "conn table"; }
+
+private:
+	UdpConnTable m_table;
+};
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void RunTest(ITest* test, const std::vector<Endpoint>& eps,
+	const std::vector<BinEndpoint>& beps, uint32_t lookups)
+{
+	const SocketId sock = 10;
+
+	for (size_t i = 0; i < eps.size(); i++) {
+		test->Add(sock, eps[i], static_cast<SessionId>(i + 1));
+	}
+
+	// Random access order, the same for all tests
+	std::mt19937 rng(12345);
+	std::vector<uint32_t> order(lookups);
+	for (auto& index : order) {
+		index = rng() % eps.size();
+	}
+
+	uint64_t found = 0;
+	uint64_t start = Now();
+
+	for (auto index : order) {
+		if (test->Find(sock, eps[index], beps[index]) == index + 1) {
+			found++;
+		}
+	}
+
+	uint64_t duration = Now() - start;
+
+	std::cout << test->Name()
+		<< ", sessions:" << eps.size()
+		<< ", lookups:" << lookups
+		<< ", found:" << found
+		<< ", duration:" << duration / 1000 << "ms"
+		<< ", ns/lookup:" << (duration * 1000 / lookups)
+		<< std::endl;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	uint32_t sessions = 50000;
+	uint32_t lookups = 10000000;
+	uint32_t type = 0;
+
+	auto cli = (
+		option("-s", "--sessions") & value("session count", sessions),
+		option("-l", "--lookups") & value("lookup count", lookups),
+		option("-t", "--type") & value("0: both, 1: string map, 2: conn table", type)
+	);
+
+	if (!parse(argc, argv, cli)) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	if (sessions == 0 || sessions >= 65535 || lookups == 0) {
+		std::cout << "invalid parameters" << std::endl;
+		return -1;
+	}
+
+	// Distinct remote endpoints, a few ports per host like NAT mapping
+	std::vector<Endpoint> eps;
+	std::vector<BinEndpoint> beps;
+	for (uint32_t i = 0; i < sessions; i++) {
+		uint32_t host = 0x0a000000 + i / 4;
+		std::string ip = std::to_string((host >> 24) & 0xff) + "."
+			+ std::to_string((host >> 16) & 0xff) + "."
+			+ std::to_string((host >> 8) & 0xff) + "."
+			+ std::to_string(host & 0xff);
+		eps.push_back(Endpoint(ip, static_cast<uint16_t>(40000 + i % 4)));
+
+		BinEndpoint bep;
+		ParseBinEndpoint(eps.back(), bep);
+		beps.push_back(bep);
+	}
+
+	if (type == 0 || type == 1) {
+		TestStringMap test;
+		RunTest(&test, eps, beps, lookups);
+	}
+
+	if (type == 0 || type == 2) {
+		TestConnTable test;
+		RunTest(&test, eps, beps, lookups);
+	}
+
+	return 0;
+}
@@ -0,0 +1,384 @@
+// test-sfu-relay.cpp : Measure server CPU per forwarded Mbps of one published
+// video stream, with FEC frames re-encoded for subscribers and with original
+// FEC frames relayed. Built with the transport sources, the server side is
+// modeled by the same classes StreamServer uses. Pacing and congestion control
+// cost the same on both paths and are not included. Publisher retransmits lost
+// packets and some received ones, each packet must be relayed once.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <cstring>
+
+#include "fec-encoder.h"
+#include "fec-decoder.h"
+#include "frame-packer.h"
+#include "frame-unpacker.h"
+#include "seq-allocator.h"
+#include "relay-seq-filter.h"
+#include "transport-common.h"
+#include "log.h"
+#include "protocol.h"
+#include "common/util-time.h"
+#include "clipp.h"
+
+using namespace jukey;
+using namespace jukey::com;
+using namespace jukey::txp;
+using namespace jukey::util;
+
+using namespace clipp;
+
+#define BENCH_FPS 30
+
+//==============================================================================
+// Options
+//==============================================================================
+struct BenchParam
+{
+	uint32_t bitrate_kbps = 2000;
+	uint32_t duration_s = 60;
+	uint32_t subscribers = 8;
+	uint32_t loss = 5; // percentage of upstream loss
+	uint32_t dup = 2;  // percentage of received packets retransmitted again
+	uint32_t src_k = 8;
+	uint32_t src_r = 2;
+	uint32_t enc_k = 8;
+	uint32_t enc_r = 4;
+};
+
+//==============================================================================
+// Publisher, generates the FEC frames received by server
+//==============================================================================
+class Publisher : public IFramePackHandler, public IFecEncodeHandler
+{
+public:
+	Publisher(const BenchParam& param)
+		: m_param(param)
+		, m_packer(StreamType::VIDEO, this)
+		, m_encoder(this, &m_seq_allocator)
+		, m_rng(1234)
+	{
+		m_encoder.SetParam((uint8_t)param.src_k, (uint8_t)param.src_r);
+	}
+
+	std::vector<Buffer> Generate()
+	{
+		uint32_t frame_len = m_param.bitrate_kbps * 1000 / 8 / BENCH_FPS;
+		uint32_t frame_count = m_param.duration_s * BENCH_FPS;
+
+		for (uint32_t i = 0; i < frame_count; i++) {
+			Buffer frame(frame_len, frame_len);
+
+			prot::VideoFrameHdr* hdr = (prot::VideoFrameHdr*)DP(frame);
+			hdr->ft = (i % (BENCH_FPS * 2) == 0) ? 1 : 0;
+			hdr->w = 1280 / 8;
+			hdr->h = 720 / 8;
+			hdr->fseq = i;
+			hdr->ts = i * 1000 / BENCH_FPS;
+
+			m_packer.WriteFrameData(frame);
+		}
+
+		FlushRtx();
+
+		return std::move(m_pkts);
+	}
+
+	// Packets received by server at least once
+	uint32_t UniquePackets() const { return m_unique; }
+
+	// IFramePackHandler
+	virtual void OnSegmentData(const Buffer& buf) override
+	{
+		m_encoder.WriteSegmentData(buf);
+	}
+
+	// IFecEncodeHandler
+	virtual void OnFecFrameData(const Buffer& buf) override
+	{
+		prot::FecHdr* hdr = (prot::FecHdr*)DP(buf);
+
+		// Lost source packets are retransmitted, so are some received ones
+		// whose NACK is sent before they arrive
+		bool lost = m_rng() % 100 < m_param.loss;
+		bool source = FEC_K(hdr) == 0 || hdr->gseq < FEC_K(hdr);
+		if (source && (lost || m_rng() % 100 < m_param.dup)) {
+			Buffer rtx(DP(buf), buf.data_len);
+			((prot::FecHdr*)DP(rtx))->rtx = 1;
+			m_rtx.push_back(rtx);
+			m_unique++;
+		}
+		else if (!lost) {
+			m_unique++;
+		}
+
+		// Redundant buffers are pooled by encoder
+		if (!lost) {
+			m_pkts.push_back(Buffer(DP(buf), buf.data_len));
+		}
+
+		// Retransmissions arrive about one frame later
+		if (++m_count % kRtxDelayPkts == 0) {
+			FlushRtx();
+		}
+	}
+
+private:
+	void FlushRtx()
+	{
+		m_pkts.insert(m_pkts.end(), m_rtx.begin(), m_rtx.end());
+		m_rtx.clear();
+	}
+
+private:
+	BenchParam m_param;
+	FramePacker m_packer;
+	SeqAllocator m_seq_allocator;
+	FecEncoder m_encoder;
+	std::mt19937 m_rng;
+	std::vector<Buffer> m_pkts;
+	std::vector<Buffer> m_rtx;
+	uint32_t m_unique = 0;
+	uint32_t m_count = 0;
+
+	static const uint32_t kRtxDelayPkts = 8;
+};
+
+//==============================================================================
+// Per subscriber work of ServerStreamSender before pacing
+//==============================================================================
+class SubscriberLeg
+{
+public:
+	void Send(const Buffer& buf, bool relay)
+	{
+		Buffer frame(DP(buf), buf.data_len);
+
+		prot::FecHdr* hdr = (prot::FecHdr*)DP(frame);
+		hdr->seq = m_seq_allocator.AllocSeq();
+		hdr->group = (uint16_t)(hdr->group + m_group_offset);
+		if (relay) {
+			hdr->rtx = 0;
+		}
+
+		m_bytes += frame.data_len;
+	}
+
+	uint64_t Bytes() const { return m_bytes; }
+
+private:
+	SeqAllocator m_seq_allocator;
+	uint16_t m_group_offset = 0;
+	uint64_t m_bytes = 0;
+};
+
+//==============================================================================
+// Packs and encodes frames again, only used by the re-encoding path
+//==============================================================================
+class Reencoder : public IFramePackHandler, public IFecEncodeHandler
+{
+public:
+	Reencoder(const BenchParam& param, std::vector<SubscriberLeg>& legs)
+		: m_packer(StreamType::VIDEO, this)
+		, m_encoder(this, &m_seq_allocator)
+		, m_legs(legs)
+	{
+		m_encoder.SetParam((uint8_t)param.enc_k, (uint8_t)param.enc_r);
+	}
+
+	void WriteFrameData(const Buffer& buf)
+	{
+		m_packer.WriteFrameData(buf);
+	}
+
+	// IFramePackHandler
+	virtual void OnSegmentData(const Buffer& buf) override
+	{
+		m_encoder.WriteSegmentData(buf);
+	}
+
+	// IFecEncodeHandler
+	virtual void OnFecFrameData(const Buffer& buf) override
+	{
+		for (auto& leg : m_legs) {
+			leg.Send(buf, false);
+		}
+	}
+
+private:
+	FramePacker m_packer;
+	SeqAllocator m_seq_allocator;
+	FecEncoder m_encoder;
+	std::vector<SubscriberLeg>& m_legs;
+};
+
+//==============================================================================
+// StreamServer of one stream, publisher leg is decoded and unpacked on both
+// paths for loss statistics and NACK
+//==============================================================================
+class BenchServer : public IFecDecodeHandler, public IFrameUnpackHandler
+{
+public:
+	BenchServer(const BenchParam& param, bool relay)
+		: m_relay(relay)
+		, m_legs(param.subscribers)
+		, m_decoder(this)
+		, m_unpacker(this)
+		, m_reencoder(param, m_legs)
+	{
+	}
+
+	void InputStreamData(const Buffer& buf)
+	{
+		prot::FecHdr* hdr = (prot::FecHdr*)DP(buf);
+
+		if (m_relay && m_filter.Check(hdr->seq)) {
+			m_relayed++;
+			for (auto& leg : m_legs) {
+				leg.Send(buf, true);
+			}
+		}
+
+		m_decoder.WriteFecFrame(buf);
+	}
+
+	uint64_t ForwardedBytes() const
+	{
+		uint64_t bytes = 0;
+		for (const auto& leg : m_legs) {
+			bytes += leg.Bytes();
+		}
+		return bytes;
+	}
+
+	uint32_t Frames() const { return m_frames; }
+
+	uint32_t Relayed() const { return m_relayed; }
+
+	// IFecDecodeHandler
+	virtual void OnSegmentData(const Buffer& buf) override
+	{
+		Buffer& seg_buf = const_cast<Buffer&>(buf);
+		seg_buf.start_pos += FEC_HDR_LEN;
+		seg_buf.data_len -= FEC_HDR_LEN;
+		m_unpacker.WriteSegmentData(seg_buf);
+	}
+
+	// IFrameUnpackHandler
+	virtual void OnFrameData(const Buffer& buf) override
+	{
+		m_frames++;
+
+		if (!m_relay) {
+			m_reencoder.WriteFrameData(buf);
+		}
+	}
+
+private:
+	bool m_relay = false;
+	std::vector<SubscriberLeg> m_legs;
+	FecDecoder m_decoder;
+	VideoFrameUnpacker m_unpacker;
+	Reencoder m_reencoder;
+	RelaySeqFilter m_filter;
+	uint32_t m_frames = 0;
+	uint32_t m_relayed = 0;
+};
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool RunBench(const BenchParam& param, const std::vector<Buffer>& pkts,
+	uint32_t unique, bool relay)
+{
+	BenchServer server(param, relay);
+
+	uint64_t begin = Now();
+
+	for (const auto& pkt : pkts) {
+		server.InputStreamData(Buffer(DP(pkt), pkt.data_len));
+	}
+
+	uint64_t cost_us = Now() - begin;
+
+	double fwd_mbit = (double)server.ForwardedBytes() * 8 / 1000000;
+	double us_per_mbit = fwd_mbit > 0 ? cost_us / fwd_mbit : 0;
+
+	// 1 Mbps forwarded for 1 second costs us_per_mbit of CPU
+	std::cout << std::setw(8) << (relay ? "relay" : "encode")
+		<< std::setw(10) << server.Frames()
+		<< std::fixed << std::setprecision(1)
+		<< std::setw(14) << fwd_mbit
+		<< std::setw(12) << (double)cost_us / 1000
+		<< std::setw(14) << us_per_mbit
+		<< std::setprecision(3)
+		<< std::setw(16) << us_per_mbit / 10000
+		<< std::endl;
+
+	// Every packet is relayed exactly once, retransmissions included
+	if (relay && server.Relayed() != unique) {
+		std::cout << "Relayed " << server.Relayed() << " packets, expected "
+			<< unique << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	BenchParam param;
+
+	auto cli = (
+		option("-b", "--bitrate") & value("kbps", param.bitrate_kbps),
+		option("-d", "--duration") & value("media duration(s)", param.duration_s),
+		option("-s", "--subscribers") & value("count", param.subscribers),
+		option("-l", "--loss") & value("upstream loss(%)", param.loss),
+		option("-x", "--dup") & value("duplicate retransmission(%)", param.dup),
+		option("-k") & value("publisher fec k", param.src_k),
+		option("-r") & value("publisher fec r", param.src_r),
+		option("-K") & value("server fec k", param.enc_k),
+		option("-R") & value("server fec r", param.enc_r)
+	);
+
+	if (!parse(argc, argv, cli) || param.subscribers == 0
+		|| param.duration_s == 0 || param.loss >= 100 || param.dup > 100
+		|| param.src_k > 16 || param.enc_k > 16) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	// Errors only, logging is not measured
+	g_txp_logger->SetLogLevel(4);
+
+	Publisher publisher(param);
+	std::vector<Buffer> pkts = publisher.Generate();
+
+	std::cout << "bitrate:" << param.bitrate_kbps << "kbps"
+		<< ", duration:" << param.duration_s << "s"
+		<< ", subscribers:" << param.subscribers
+		<< ", loss:" << param.loss << "%"
+		<< ", dup:" << param.dup << "%"
+		<< ", publisher fec:" << param.src_k << "|" << param.src_r
+		<< ", server fec:" << param.enc_k << "|" << param.enc_r
+		<< ", packets:" << pkts.size() << std::endl;
+
+	std::cout << std::setw(8) << "path"
+		<< std::setw(10) << "frames"
+		<< std::setw(14) << "fwd(Mbit)"
+		<< std::setw(12) << "cpu(ms)"
+		<< std::setw(14) << "us/Mbit"
+		<< std::setw(16) << "core%/Mbps"
+		<< std::endl;
+
+	bool result = RunBench(param, pkts, publisher.UniquePackets(), false);
+	result = RunBench(param, pkts, publisher.UniquePackets(), true) && result;
+
+	return result ? 0 : -1;
+}
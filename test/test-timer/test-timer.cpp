@@ -0,0 +1,173 @@
+// test-timer.cpp : Measure firing jitter and CPU usage of timer manager with a
+// large number of active loop timers
+// 
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+
+#include "com-factory.h"
+#include "if-timer-mgr.h"
+#include "common/util-time.h"
+#include "clipp.h"
+
+using namespace jukey::base;
+using namespace jukey::com;
+using namespace jukey::util;
+
+using namespace clipp;
+
+//==============================================================================
+// Record the lateness of each firing. Updated in the wheel thread and read in
+// the main thread.
+//==============================================================================
+class TimerStats
+{
+public:
+	void Start(uint32_t timeout_ms, uint64_t now)
+	{
+		m_timeout_us = timeout_ms * 1000ULL;
+		m_last_us = now;
+	}
+
+	void OnTimer()
+	{
+		uint64_t now = Now();
+		uint64_t last = m_last_us.exchange(now);
+		uint64_t timeout = m_timeout_us.load();
+
+		if (last != 0 && now >= last + timeout) {
+			uint64_t late = now - last - timeout;
+			if (late > m_max_late_us) {
+				m_max_late_us = late;
+			}
+			m_total_late_us += late;
+			m_fire_count++;
+		}
+		else if (last != 0) {
+			m_early_count++;
+		}
+	}
+
+	std::atomic<uint64_t> m_timeout_us { 0 };
+	std::atomic<uint64_t> m_last_us { 0 };
+	std::atomic<uint64_t> m_max_late_us { 0 };
+	std::atomic<uint64_t> m_total_late_us { 0 };
+	std::atomic<uint64_t> m_fire_count { 0 };
+	std::atomic<uint64_t> m_early_count { 0 };
+};
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	uint32_t count = 100000;
+	uint32_t min_timeout = 5;
+	uint32_t max_timeout = 100;
+	uint32_t duration = 10;
+
+	auto cli = (
+		option("-c", "--count") & value("timer count", count),
+		option("-n", "--min") & value("min timeout(ms)", min_timeout),
+		option("-x", "--max") & value("max timeout(ms)", max_timeout),
+		option("-d", "--duration") & value("test duration(s)", duration)
+	);
+
+	if (!parse(argc, argv, cli) || min_timeout == 0 || max_timeout < min_timeout) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	IComFactory* factory = GetComFactory();
+	if (!factory->Init("./")) {
+		std::cout << "Init faild!" << std::endl;
+		return -1;
+	}
+
+	// Use a dedicated timer manager to exclude timers of other components
+	jukey::base::IUnknown* com = factory->CreateComponent(CID_TIMER_MGR, "test");
+	if (!com) {
+		std::cout << "Create timer manager failed!" << std::endl;
+		return -1;
+	}
+
+	ITimerMgr* timer_mgr = (ITimerMgr*)com->QueryInterface(IID_TIMER_MGR);
+	if (!timer_mgr) {
+		std::cout << "Query timer manager failed!" << std::endl;
+		return -1;
+	}
+	timer_mgr->Start();
+
+	std::vector<TimerStats> stats(count);
+	std::vector<uint32_t> timeouts;
+
+	std::vector<TimerId> timers;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t timeout = min_timeout + i % (max_timeout - min_timeout + 1);
+		timeouts.push_back(timeout);
+
+		TimerParam param;
+		param.timer_type = TimerType::TIMER_TYPE_LOOP;
+		param.timer_name = "test-timer";
+		param.timeout = timeout;
+		param.user_data = i;
+		param.timer_func = [&stats](int64_t i) { stats[i].OnTimer(); };
+
+		TimerId timer_id = timer_mgr->AllocTimer(param);
+		if (timer_id == INVALID_TIMER_ID) {
+			std::cout << "Alloc timer failed, allocated:" << i << std::endl;
+			return -1;
+		}
+		timers.push_back(timer_id);
+	}
+
+	uint64_t start_us = Now();
+	std::clock_t start_cpu = std::clock();
+
+	for (uint32_t i = 0; i < count; i++) {
+		stats[i].Start(timeouts[i], Now());
+		timer_mgr->StartTimer(timers[i]);
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(duration));
+
+	for (auto timer_id : timers) {
+		timer_mgr->StopTimer(timer_id);
+		timer_mgr->FreeTimer(timer_id);
+	}
+
+	uint64_t wall_us = Now() - start_us;
+	double cpu_us = (double)(std::clock() - start_cpu) * 1000000 / CLOCKS_PER_SEC;
+
+	uint64_t fire_count = 0;
+	uint64_t early_count = 0;
+	uint64_t total_late_us = 0;
+	std::vector<uint64_t> max_lates;
+	for (const auto& item : stats) {
+		fire_count += item.m_fire_count;
+		early_count += item.m_early_count;
+		total_late_us += item.m_total_late_us;
+		max_lates.push_back(item.m_max_late_us);
+	}
+	std::sort(max_lates.begin(), max_lates.end());
+
+	std::cout << "timers:" << count
+		<< ", fires:" << fire_count
+		<< ", fires/s:" << fire_count * 1000000 / wall_us
+		<< ", early:" << early_count
+		<< std::endl;
+	std::cout << "avg late:" << (fire_count ? total_late_us / fire_count : 0) << "us"
+		<< ", p99 max late:" << max_lates[max_lates.size() * 99 / 100] << "us"
+		<< ", max late:" << max_lates.back() << "us"
+		<< std::endl;
+	std::cout << "cpu:" << cpu_us * 100 / wall_us << "%" << std::endl;
+
+	timer_mgr->Stop();
+
+	return 0;
+}
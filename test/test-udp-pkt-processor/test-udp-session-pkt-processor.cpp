@@ -29,21 +29,33 @@ public:
 	COMPONENT_FUNCTION_DECL
 	COMPONENT_IUNKNOWN_IMPL
 
-	virtual ErrCode Init(IUdpHandler* handler) override
+	virtual ErrCode Init(IUdpHandler* handler, uint32_t shard_count,
+		uint32_t recv_pool_size) override
 	{
 		return ErrCode::ERR_CODE_OK;
 	}
 
+	virtual uint32_t ShardCount() override
+	{
+		return 1;
+	}
+
 	virtual Socket CreateServerSocket(const Endpoint& ep) override
 	{
 		return 0;
 	}
 
-	virtual Socket CreateClientSocket() override
+	virtual Socket CreateClientSocket(uint32_t shard) override
 	{
 		return 0;
 	}
 
+	virtual void PostShardTask(uint32_t shard, const UdpShardTask& task,
+		uint64_t delay_us) override
+	{
+
+	}
+
 	virtual void CloseSocket(Socket sock) override
 	{
 
@@ -53,6 +65,19 @@ public:
 	{
 		return ErrCode::ERR_CODE_OK;
 	}
+
+	virtual ErrCode SendBatch(Socket sock,
+		const std::vector<UdpPacket>& pkts, uint32_t& sent_count) override
+	{
+		sent_count = 0;
+		for (const auto& pkt : pkts) {
+			if (ErrCode::ERR_CODE_OK != SendData(sock, pkt.ep, pkt.buf)) {
+				return ErrCode::ERR_CODE_FAILED;
+			}
+			sent_count++;
+		}
+		return ErrCode::ERR_CODE_OK;
+	}
 };
 
 //------------------------------------------------------------------------------
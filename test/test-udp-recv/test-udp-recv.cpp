@@ -0,0 +1,306 @@
+// test-udp-recv.cpp : Compare per-datagram receive with UdpManager receive
+//
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "common-struct.h"
+#include "common-config.h"
+#include "common/util-time.h"
+#include "com-factory.h"
+#include "if-udp-mgr.h"
+#include "clipp.h"
+
+using namespace jukey::util;
+using namespace jukey::com;
+using namespace jukey::net;
+using namespace jukey::base;
+
+using namespace clipp;
+
+//==============================================================================
+// 
+//==============================================================================
+class ITest
+{
+public:
+	virtual ~ITest() {}
+
+	// Return received datagram count, 0 means timeout
+	virtual uint32_t Recv(int sock) = 0;
+
+	virtual const char* Name() = 0;
+};
+
+//==============================================================================
+// The original way: 64KB buffer and one recvfrom for each datagram
+//==============================================================================
+class TestLegacyRecv : public ITest
+{
+public:
+	virtual uint32_t Recv(int sock) override
+	{
+		Buffer recv_buf(UDP_RECV_BUF_LEN);
+		struct sockaddr_in addr;
+		socklen_t size = sizeof(addr);
+
+		int res = recvfrom(sock, (char*)recv_buf.data.get(), UDP_RECV_BUF_LEN, 0,
+			(sockaddr*)&addr, &size);
+		if (res <= 0) {
+			return 0;
+		}
+		recv_buf.data_len = res;
+
+		Endpoint ep(inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+		m_bytes += ep.port > 0 ? recv_buf.data_len : 0;
+
+		return 1;
+	}
+
+	virtual const char* Name() override { return "legacy"; }
+
+private:
+	uint64_t m_bytes = 0;
+};
+
+//==============================================================================
+// UdpManager receive path: recvmmsg into pooled buffers, remote endpoint is
+// handed to the handler as BinEndpoint without formatting
+//==============================================================================
+class TestMgrRecv : public IUdpHandler
+{
+public:
+	bool Init(uint32_t shard_count, uint32_t pool_size)
+	{
+		IComFactory* factory = GetComFactory();
+		if (!factory || !factory->Init("./")) {
+			std::cout << "Init component factory failed!" << std::endl;
+			return false;
+		}
+
+		m_udp_mgr = (IUdpMgr*)factory->QueryInterface(CID_UDP_MGR, IID_UDP_MGR,
+			"test-udp-recv");
+		if (!m_udp_mgr) {
+			std::cout << "Create udp manager failed!" << std::endl;
+			return false;
+		}
+
+		if (ERR_CODE_OK != m_udp_mgr->Init(this, shard_count, pool_size)) {
+			std::cout << "Init udp manager failed!" << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	// IUdpHandler, called in the event thread of shard
+	virtual void OnRecvUdpData(const Endpoint& lep, const BinEndpoint& rep,
+		SocketId sock, uint32_t shard, Buffer buf) override
+	{
+		uint64_t now = Now();
+		uint64_t first = 0;
+		m_first_time.compare_exchange_strong(first, now);
+		m_last_time = now;
+
+		m_bytes += rep.port > 0 ? buf.data_len : 0;
+		m_recv_count++;
+	}
+
+	virtual void OnSocketClosed(const Endpoint& lep, const Endpoint& rep,
+		SocketId sock) override {}
+
+	const char* Name() { return "udp-mgr"; }
+
+	IUdpMgr* UdpMgr() { return m_udp_mgr; }
+
+	uint64_t RecvCount() { return m_recv_count; }
+	uint64_t FirstTime() { return m_first_time; }
+	uint64_t LastTime() { return m_last_time; }
+
+private:
+	IUdpMgr* m_udp_mgr = nullptr;
+
+	std::atomic<uint64_t> m_recv_count { 0 };
+	std::atomic<uint64_t> m_bytes { 0 };
+	std::atomic<uint64_t> m_first_time { 0 };
+	std::atomic<uint64_t> m_last_time { 0 };
+};
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int CreateRecvSocket(uint16_t port)
+{
+	int sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+	int buf_size = SOCKET_RECV_BUF_LEN;
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+
+	// Treat 200ms silence as the end of test
+	struct timeval tv = { 0, 200 * 1000 };
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = inet_addr("127.0.0.1");
+	sin.sin_port = htons(port);
+	if (::bind(sock, (sockaddr*)&sin, sizeof(sin)) < 0) {
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void SendProc(uint16_t port, uint32_t size, uint32_t count)
+{
+	int sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = inet_addr("127.0.0.1");
+	sin.sin_port = htons(port);
+
+	std::unique_ptr<char[]> data(new char[size]);
+	memset(data.get(), 0, size);
+
+	for (uint32_t i = 0; i < count; i++) {
+		sendto(sock, data.get(), size, 0, (sockaddr*)&sin, sizeof(sin));
+	}
+
+	close(sock);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void PrintResult(const char* name, uint64_t recv_count, uint32_t count,
+	uint64_t first_time, uint64_t last_time)
+{
+	uint64_t duration = last_time > first_time ? last_time - first_time : 1;
+
+	std::cout << name
+		<< ", received:" << recv_count 
+		<< ", lost:" << (count - recv_count)
+		<< ", duration(us):" << duration 
+		<< ", packets/sec:" << recv_count * 1000000 / duration 
+		<< std::endl;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void RunTest(ITest* test, uint16_t port, uint32_t size, uint32_t count)
+{
+	int sock = CreateRecvSocket(port);
+	if (sock < 0) {
+		std::cout << "Create socket failed!" << std::endl;
+		return;
+	}
+
+	std::thread sender(SendProc, port, size, count);
+
+	uint64_t recv_count = 0, first_time = 0, last_time = 0;
+	while (true) {
+		uint32_t n = test->Recv(sock);
+		if (n == 0) break;
+
+		last_time = Now();
+		if (first_time == 0) first_time = last_time;
+		recv_count += n;
+	}
+
+	sender.join();
+	close(sock);
+
+	PrintResult(test->Name(), recv_count, count, first_time, last_time);
+}
+
+//------------------------------------------------------------------------------
+// Datagrams are received in the event threads of UdpManager
+//------------------------------------------------------------------------------
+void RunMgrTest(TestMgrRecv* test, uint16_t port, uint32_t size,
+	uint32_t count)
+{
+	Socket sock = test->UdpMgr()->CreateServerSocket(Endpoint("127.0.0.1",
+		port));
+	if (sock <= 0) {
+		std::cout << "Create server socket failed!" << std::endl;
+		return;
+	}
+
+	std::thread sender(SendProc, port, size, count);
+
+	// Treat 200ms silence as the end of test
+	uint64_t last_count = 0;
+	while (true) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		uint64_t recv_count = test->RecvCount();
+		if (recv_count >= count || (recv_count == last_count && recv_count > 0)) {
+			break;
+		}
+		last_count = recv_count;
+	}
+
+	sender.join();
+	test->UdpMgr()->CloseSocket(sock);
+
+	PrintResult(test->Name(), test->RecvCount(), count, test->FirstTime(),
+		test->LastTime());
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	uint32_t size = 1200;
+	uint32_t count = 1000000;
+	uint32_t port = 23456;
+	uint32_t type = 0;
+	uint32_t pool = 0;
+
+	auto cli = (
+		option("-s", "--size") & value("packet size", size),
+		option("-c", "--count") & value("total count", count),
+		option("-p", "--port") & value("receive port", port),
+		option("-t", "--type") & value("0: both, 1: legacy, 2: udp-mgr", type),
+		option("-b", "--pool") & value("receive pool size", pool)
+	);
+
+	if (!parse(argc, argv, cli)) {
+		std::cout << make_man_page(cli, argv[0]);
+		return -1;
+	}
+
+	std::cout << "size:" << size << ", count:" << count << std::endl;
+
+	if (type == 0 || type == 1) {
+		TestLegacyRecv test;
+		RunTest(&test, (uint16_t)port, size, count);
+	}
+
+	if (type == 0 || type == 2) {
+		// One shard, so one receive thread as the legacy test
+		TestMgrRecv test;
+		if (!test.Init(1, pool)) {
+			return -1;
+		}
+		RunMgrTest(&test, (uint16_t)port, size, count);
+	}
+
+	return 0;
+}
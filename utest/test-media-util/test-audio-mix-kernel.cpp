@@ -0,0 +1,170 @@
+#include <vector>
+#include <random>
+
+#include "gtest/gtest.h"
+#include "audio-mix-kernel.h"
+
+using namespace jukey::media::util;
+
+namespace
+{
+
+const MixKernel kKernels[] = {
+	MixKernel::MIX_KERNEL_SCALAR,
+	MixKernel::MIX_KERNEL_SSE2,
+	MixKernel::MIX_KERNEL_AVX2
+};
+
+// Sizes not multiple of the vector width exercise the tail loop
+const uint32_t kSizes[] = { 1, 7, 8, 15, 16, 17, 160, 961 };
+
+std::vector<int16_t> RandomSamples(uint32_t size, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::vector<int16_t> samples(size);
+	for (auto& sample : samples) {
+		sample = static_cast<int16_t>(rng());
+	}
+	return samples;
+}
+
+// Full scale samples of both signs to hit saturation
+std::vector<int16_t> ExtremeSamples(uint32_t size, uint32_t seed)
+{
+	std::vector<int16_t> samples = RandomSamples(size, seed);
+	for (uint32_t i = 0; i < size; i++) {
+		if (i % 3 == 0) samples[i] = 32767;
+		if (i % 3 == 1) samples[i] = -32768;
+	}
+	return samples;
+}
+
+// Restore the best kernel after each test
+class MixKernelTest : public testing::Test
+{
+protected:
+	virtual void TearDown() override
+	{
+		MixSetKernel(MixBestKernel());
+	}
+};
+
+}
+
+TEST_F(MixKernelTest, AddS16MatchScalar)
+{
+	const int16_t gains[] = { 0, 1, kMixGainOne / 2, kMixGainOne,
+		kMixGainOne + 1, 32767, -kMixGainOne, -32768 };
+
+	for (uint32_t size : kSizes) {
+		for (int16_t gain : gains) {
+			for (uint32_t extreme = 0; extreme < 2; extreme++) {
+				std::vector<int16_t> src = extreme ? ExtremeSamples(size, size)
+					: RandomSamples(size, size);
+				std::vector<int16_t> init = extreme ? ExtremeSamples(size, gain)
+					: RandomSamples(size, size + 1);
+
+				ASSERT_TRUE(MixSetKernel(MixKernel::MIX_KERNEL_SCALAR));
+				std::vector<int16_t> expect = init;
+				MixAddS16(expect.data(), src.data(), gain, size);
+
+				for (MixKernel kernel : kKernels) {
+					if (!MixSetKernel(kernel)) continue; // not supported by CPU
+
+					std::vector<int16_t> result = init;
+					MixAddS16(result.data(), src.data(), gain, size);
+					EXPECT_EQ(result, expect) << MixKernelName(kernel)
+						<< " size:" << size << " gain:" << gain;
+				}
+			}
+		}
+	}
+}
+
+TEST_F(MixKernelTest, AddS16Saturate)
+{
+	for (MixKernel kernel : kKernels) {
+		if (!MixSetKernel(kernel)) continue;
+
+		std::vector<int16_t> dst(17, 30000);
+		std::vector<int16_t> src(17, 30000);
+		MixAddS16(dst.data(), src.data(), kMixGainOne, 17);
+		EXPECT_EQ(dst, std::vector<int16_t>(17, 32767)) << MixKernelName(kernel);
+
+		dst.assign(17, -30000);
+		src.assign(17, -30000);
+		MixAddS16(dst.data(), src.data(), kMixGainOne, 17);
+		EXPECT_EQ(dst, std::vector<int16_t>(17, -32768)) << MixKernelName(kernel);
+
+		// Scaled sample saturates before adding
+		dst.assign(17, 0);
+		src.assign(17, -32768);
+		MixAddS16(dst.data(), src.data(), -32768, 17);
+		EXPECT_EQ(dst, std::vector<int16_t>(17, 32767)) << MixKernelName(kernel);
+	}
+}
+
+TEST_F(MixKernelTest, AddF32MatchScalar)
+{
+	const float gains[] = { 0.0f, 0.5f, 1.0f, 1.7f, -1.0f };
+
+	for (uint32_t size : kSizes) {
+		for (float gain : gains) {
+			std::vector<int16_t> src = ExtremeSamples(size, size);
+			std::vector<float> init(size);
+			for (uint32_t i = 0; i < size; i++) {
+				init[i] = (float)((int32_t)i * 37 - 5000);
+			}
+
+			ASSERT_TRUE(MixSetKernel(MixKernel::MIX_KERNEL_SCALAR));
+			std::vector<float> expect = init;
+			MixAddF32(expect.data(), src.data(), gain, size);
+
+			for (MixKernel kernel : kKernels) {
+				if (!MixSetKernel(kernel)) continue;
+
+				std::vector<float> result = init;
+				MixAddF32(result.data(), src.data(), gain, size);
+				EXPECT_EQ(result, expect) << MixKernelName(kernel)
+					<< " size:" << size << " gain:" << gain;
+			}
+		}
+	}
+}
+
+TEST_F(MixKernelTest, StoreS16MatchScalar)
+{
+	for (uint32_t size : kSizes) {
+		std::vector<float> src(size);
+		for (uint32_t i = 0; i < size; i++) {
+			switch (i % 6) {
+			case 0: src[i] = 1e9f; break;     // saturate high
+			case 1: src[i] = -1e9f; break;    // saturate low
+			case 2: src[i] = 32767.5f; break;
+			case 3: src[i] = -32768.5f; break;
+			case 4: src[i] = 2.5f; break;     // round to even
+			default: src[i] = (float)i * -3.25f; break;
+			}
+		}
+
+		ASSERT_TRUE(MixSetKernel(MixKernel::MIX_KERNEL_SCALAR));
+		std::vector<int16_t> expect(size);
+		MixStoreS16(expect.data(), src.data(), size);
+
+		for (MixKernel kernel : kKernels) {
+			if (!MixSetKernel(kernel)) continue;
+
+			std::vector<int16_t> result(size);
+			MixStoreS16(result.data(), src.data(), size);
+			EXPECT_EQ(result, expect) << MixKernelName(kernel) << " size:" << size;
+		}
+	}
+
+	float extreme[] = { 1e9f, -1e9f, 2.5f, 3.5f };
+	int16_t result[4];
+	MixStoreS16(result, extreme, 4);
+	EXPECT_EQ(result[0], 32767);
+	EXPECT_EQ(result[1], -32768);
+	EXPECT_EQ(result[2], 2);
+	EXPECT_EQ(result[3], 4);
+}
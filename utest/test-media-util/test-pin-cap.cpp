@@ -0,0 +1,207 @@
+#include "gtest/gtest.h"
+#include "pin-cap.h"
+
+using namespace jukey::media;
+using namespace jukey::media::util;
+using namespace jukey::stmr;
+
+namespace
+{
+
+// Audio: codec, channels, sample bits, sample rate
+const char* kAudioCaps = "{\"media_type\":1,\"codec\":[3,2],"
+	"\"channels\":[2,1],\"sample_bits\":[2],\"sample_rate\":[4,3]}";
+
+// Video: codec, resolution, pixel format
+const char* kVideoCaps = "{\"media_type\":2,\"codec\":[2],"
+	"\"resolution\":[7,6,4],\"pixel_format\":[4,2]}";
+
+com::AudioCap MakeAudioCap(AudioCodec codec, AudioChnls chnls,
+	AudioSBits sbits, AudioSRate srate)
+{
+	com::AudioCap cap;
+	cap.codec = codec;
+	cap.chnls = chnls;
+	cap.sbits = sbits;
+	cap.srate = srate;
+	return cap;
+}
+
+com::VideoCap MakeVideoCap(VideoCodec codec, VideoRes res, PixelFormat format)
+{
+	com::VideoCap cap;
+	cap.codec = codec;
+	cap.res = res;
+	cap.format = format;
+	return cap;
+}
+
+}
+
+TEST(PinCap, PackUnpackAudio)
+{
+	com::AudioCap cap = MakeAudioCap(AudioCodec::OPUS, AudioChnls::STEREO,
+		AudioSBits::S16, AudioSRate::SR_48K);
+
+	PackedCap packed = PackAudioCap(cap);
+	EXPECT_NE(packed, INVALID_PACKED_CAP);
+	EXPECT_EQ(PackedCapType(packed), MediaType::AUDIO);
+
+	com::AudioCap unpacked = UnpackAudioCap(packed);
+	EXPECT_EQ(unpacked.codec, cap.codec);
+	EXPECT_EQ(unpacked.chnls, cap.chnls);
+	EXPECT_EQ(unpacked.sbits, cap.sbits);
+	EXPECT_EQ(unpacked.srate, cap.srate);
+
+	// Equal if and only if capabilities are equal
+	cap.srate = AudioSRate::SR_16K;
+	EXPECT_NE(PackAudioCap(cap), packed);
+
+	// Codec is ignored
+	cap.srate = AudioSRate::SR_48K;
+	cap.codec = AudioCodec::PCM;
+	EXPECT_EQ(PackedCapWithoutCodec(PackAudioCap(cap)),
+		PackedCapWithoutCodec(packed));
+}
+
+TEST(PinCap, PackUnpackVideo)
+{
+	com::VideoCap cap = MakeVideoCap(VideoCodec::H264, VideoRes::RES_1280x720,
+		PixelFormat::I420);
+
+	PackedCap packed = PackVideoCap(cap);
+	EXPECT_EQ(PackedCapType(packed), MediaType::VIDEO);
+
+	com::VideoCap unpacked = UnpackVideoCap(packed);
+	EXPECT_EQ(unpacked.codec, cap.codec);
+	EXPECT_EQ(unpacked.res, cap.res);
+	EXPECT_EQ(unpacked.format, cap.format);
+
+	// Same fields of another media type differ
+	com::AudioCap audio = MakeAudioCap((AudioCodec)cap.codec,
+		(AudioChnls)cap.res, (AudioSBits)cap.format, AudioSRate::INVALID);
+	EXPECT_NE(PackAudioCap(audio), packed);
+}
+
+TEST(PinCap, PackCapString)
+{
+	std::string audio = "{\"media_type\":1,\"codec\":3,\"channels\":2,"
+		"\"sample_bits\":2,\"sample_rate\":4}";
+
+	PackedCap expect = PackAudioCap(MakeAudioCap(AudioCodec::OPUS,
+		AudioChnls::STEREO, AudioSBits::S16, AudioSRate::SR_48K));
+	EXPECT_EQ(PackCap(audio), expect);
+	EXPECT_EQ(PackCap(audio), expect); // cached
+
+	EXPECT_EQ(PackCap("not json"), INVALID_PACKED_CAP);
+	EXPECT_EQ(PackCap("{\"media_type\":0}"), INVALID_PACKED_CAP);
+
+	PackedCaps packed = PackCaps({ audio, "not json" });
+	ASSERT_EQ(packed.size(), 2u);
+	EXPECT_EQ(packed[0], expect);
+	EXPECT_EQ(packed[1], INVALID_PACKED_CAP);
+}
+
+TEST(PinCap, IntersectPackedCapsKeepOrder)
+{
+	PackedCap a = PackVideoCap(MakeVideoCap(VideoCodec::RAW,
+		VideoRes::RES_1920x1080, PixelFormat::I420));
+	PackedCap b = PackVideoCap(MakeVideoCap(VideoCodec::RAW,
+		VideoRes::RES_1280x720, PixelFormat::I420));
+	PackedCap c = PackVideoCap(MakeVideoCap(VideoCodec::RAW,
+		VideoRes::RES_640x360, PixelFormat::NV12));
+
+	std::vector<uint32_t> indexes = IntersectPackedCaps({ c, a, b,
+		INVALID_PACKED_CAP }, { b, INVALID_PACKED_CAP, c });
+	EXPECT_EQ(indexes, std::vector<uint32_t>({ 0, 2 }));
+
+	EXPECT_TRUE(IntersectPackedCaps({ a }, {}).empty());
+}
+
+TEST(PinCap, ParseCapMaskBits)
+{
+	std::optional<CapMask> mask = ParseCapMask(kAudioCaps);
+	ASSERT_TRUE(mask.has_value());
+	EXPECT_EQ(mask->media_type, MediaType::AUDIO);
+	EXPECT_EQ(mask->codecs, (1u << 2) | (1u << 3));
+	EXPECT_EQ(mask->dim1, (1u << 1) | (1u << 2));
+	EXPECT_EQ(mask->dim2, 1u << 2);
+	EXPECT_EQ(mask->dim3, (1u << 3) | (1u << 4));
+
+	EXPECT_TRUE(TestCapBit(mask->codecs, AudioCodec::OPUS));
+	EXPECT_FALSE(TestCapBit(mask->codecs, AudioCodec::AAC));
+
+	// Cached result is the same
+	std::optional<CapMask> cached = ParseCapMask(kAudioCaps);
+	ASSERT_TRUE(cached.has_value());
+	EXPECT_EQ(cached->codecs, mask->codecs);
+	EXPECT_EQ(cached->dim3, mask->dim3);
+
+	EXPECT_FALSE(ParseCapMask("not json").has_value());
+}
+
+TEST(PinCap, ParseCapOrderKeepsOrder)
+{
+	std::optional<CapOrder> order = ParseCapOrder(kVideoCaps);
+	ASSERT_TRUE(order.has_value());
+	EXPECT_EQ(order->media_type, MediaType::VIDEO);
+	EXPECT_EQ(order->codecs, std::vector<uint8_t>({ 2 }));
+	EXPECT_EQ(order->dim1, std::vector<uint8_t>({ 7, 6, 4 }));
+	EXPECT_EQ(order->dim2, std::vector<uint8_t>({ 4, 2 }));
+	EXPECT_TRUE(order->dim3.empty());
+
+	CapMask mask = ToCapMask(order.value());
+	std::optional<CapMask> parsed = ParseCapMask(kVideoCaps);
+	ASSERT_TRUE(parsed.has_value());
+	EXPECT_EQ(mask.codecs, parsed->codecs);
+	EXPECT_EQ(mask.dim1, parsed->dim1);
+	EXPECT_EQ(mask.dim2, parsed->dim2);
+}
+
+TEST(PinCap, IntersectCapMask)
+{
+	com::AudioCaps caps;
+	caps.codecs = { AudioCodec::OPUS, AudioCodec::AAC };
+	caps.chnlss = { AudioChnls::STEREO };
+	caps.sbitss = { AudioSBits::S16, AudioSBits::FLTP };
+	caps.srates = { AudioSRate::SR_48K };
+
+	CapMask mask = IntersectCapMask(ParseCapMask(kAudioCaps).value(),
+		ToCapMask(caps));
+	EXPECT_EQ(mask.media_type, MediaType::AUDIO);
+	EXPECT_EQ(mask.codecs, 1u << 3);
+	EXPECT_EQ(mask.dim1, 1u << 2);
+	EXPECT_EQ(mask.dim2, 1u << 2);
+	EXPECT_EQ(mask.dim3, 1u << 4);
+	EXPECT_FALSE(IsEmptyCapMask(mask));
+
+	// One empty dimension leaves no capability
+	caps.srates = { AudioSRate::SR_8K };
+	EXPECT_TRUE(IsEmptyCapMask(IntersectCapMask(
+		ParseCapMask(kAudioCaps).value(), ToCapMask(caps))));
+
+	// Different media types
+	CapMask video = ParseCapMask(kVideoCaps).value();
+	EXPECT_TRUE(IsEmptyCapMask(IntersectCapMask(mask, video)));
+}
+
+TEST(PinCap, MatchCapMask)
+{
+	CapMask audio = ParseCapMask(kAudioCaps).value();
+
+	EXPECT_TRUE(MatchCapMask(PackAudioCap(MakeAudioCap(AudioCodec::PCM,
+		AudioChnls::MONO, AudioSBits::S16, AudioSRate::SR_16K)), audio));
+	EXPECT_FALSE(MatchCapMask(PackAudioCap(MakeAudioCap(AudioCodec::PCM,
+		AudioChnls::MONO, AudioSBits::S16, AudioSRate::SR_8K)), audio));
+	EXPECT_FALSE(MatchCapMask(PackAudioCap(MakeAudioCap(AudioCodec::AAC,
+		AudioChnls::MONO, AudioSBits::S16, AudioSRate::SR_16K)), audio));
+
+	// Video has no dimension 3
+	CapMask video = ParseCapMask(kVideoCaps).value();
+	EXPECT_TRUE(MatchCapMask(PackVideoCap(MakeVideoCap(VideoCodec::RAW,
+		VideoRes::RES_640x360, PixelFormat::I420)), video));
+	EXPECT_FALSE(MatchCapMask(PackVideoCap(MakeVideoCap(VideoCodec::RAW,
+		VideoRes::RES_640x480, PixelFormat::I420)), video));
+	EXPECT_FALSE(MatchCapMask(PackVideoCap(MakeVideoCap(VideoCodec::RAW,
+		VideoRes::RES_640x360, PixelFormat::I420)), audio));
+}
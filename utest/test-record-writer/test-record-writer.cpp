@@ -0,0 +1,330 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "record-writer.h"
+#include "public/media-struct.h"
+
+using namespace jukey::stmr;
+using namespace jukey::com;
+
+namespace
+{
+
+const char* kRecordFile = "test-record-writer.mp4";
+
+// AAC-LC, 44100Hz, stereo
+const uint8_t kAacConfig[] = { 0x12, 0x10 };
+
+// Baseline 320x240, carried by each IDR frame as x264 does
+const uint8_t kH264Sps[] = { 0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xC0, 0x0D,
+	0xDA, 0x05, 0x07, 0xE4 };
+const uint8_t kH264Pps[] = { 0x00, 0x00, 0x00, 0x01, 0x68, 0xCE, 0x3C, 0x80 };
+
+// NAL headers of slices
+const uint8_t kH264Idr = 0x65;
+const uint8_t kH264RefSlice = 0x41;
+const uint8_t kH264NonRefSlice = 0x01;
+
+//------------------------------------------------------------------------------
+// Payload bytes are derived from the index, so read back data can be checked
+//------------------------------------------------------------------------------
+std::vector<uint8_t> MakePayload(uint32_t index, uint32_t size)
+{
+	std::vector<uint8_t> payload(size);
+	for (uint32_t i = 0; i < size; i++) {
+		payload[i] = static_cast<uint8_t>(index + i);
+	}
+	return payload;
+}
+
+//------------------------------------------------------------------------------
+// Timestamps are in milliseconds
+//------------------------------------------------------------------------------
+PinData MakePinData(jukey::media::MediaType mt, uint32_t index, int64_t ts,
+	uint64_t drt, bool key)
+{
+	std::vector<uint8_t> payload = MakePayload(index, 100 + index % 50);
+
+	PinData data(mt, payload.data(), (uint32_t)payload.size());
+	data.pts = ts;
+	data.dts = ts;
+	data.drt = drt;
+	data.tbn = 1;
+	data.tbd = 1000;
+
+	if (mt == jukey::media::MediaType::VIDEO) {
+		SPC<jukey::media::VideoFramePara>(data.media_para)->key = key;
+	}
+
+	return data;
+}
+
+//------------------------------------------------------------------------------
+// Annex-b frame of one slice, IDR frame has SPS and PPS ahead
+//------------------------------------------------------------------------------
+PinData MakeH264Data(uint32_t index, uint8_t nal_hdr, uint32_t size)
+{
+	std::vector<uint8_t> frame;
+	if (nal_hdr == kH264Idr) {
+		frame.insert(frame.end(), std::begin(kH264Sps), std::end(kH264Sps));
+		frame.insert(frame.end(), std::begin(kH264Pps), std::end(kH264Pps));
+	}
+	frame.insert(frame.end(), { 0x00, 0x00, 0x00, 0x01, nal_hdr });
+
+	// No zero byte, so no start code in the slice data
+	for (uint32_t i = 0; i < size; i++) {
+		frame.push_back(static_cast<uint8_t>(1 + (index + i) % 255));
+	}
+
+	PinData data(jukey::media::MediaType::VIDEO, frame.data(),
+		(uint32_t)frame.size());
+	data.pts = index * 40;
+	data.dts = index * 40;
+	data.drt = 40;
+	data.tbn = 1;
+	data.tbd = 1000;
+
+	SPC<jukey::media::VideoFramePara>(data.media_para)->key =
+		(nal_hdr == kH264Idr);
+
+	return data;
+}
+
+//------------------------------------------------------------------------------
+// MPEG4 video is muxed as is, H264 goes through h264_mp4toannexb
+//------------------------------------------------------------------------------
+AVFormatContext* CreateFormatContext(bool with_audio,
+	AVCodecID video_codec = AV_CODEC_ID_MPEG4)
+{
+	AVFormatContext* fmt_ctx = nullptr;
+	if (avformat_alloc_output_context2(&fmt_ctx, nullptr, "mp4", kRecordFile)
+		< 0) {
+		return nullptr;
+	}
+
+	AVStream* video = avformat_new_stream(fmt_ctx, nullptr);
+	video->time_base = { 1, 1000 };
+	video->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+	video->codecpar->codec_id = video_codec;
+	video->codecpar->width = 320;
+	video->codecpar->height = 240;
+
+	// Annex-b global header, passed through by h264_mp4toannexb
+	if (video_codec == AV_CODEC_ID_H264) {
+		int size = sizeof(kH264Sps) + sizeof(kH264Pps);
+		video->codecpar->extradata = (uint8_t*)av_mallocz(
+			size + AV_INPUT_BUFFER_PADDING_SIZE);
+		memcpy(video->codecpar->extradata, kH264Sps, sizeof(kH264Sps));
+		memcpy(video->codecpar->extradata + sizeof(kH264Sps), kH264Pps,
+			sizeof(kH264Pps));
+		video->codecpar->extradata_size = size;
+	}
+
+	if (with_audio) {
+		AVStream* audio = avformat_new_stream(fmt_ctx, nullptr);
+		audio->time_base = { 1, 44100 };
+		audio->codecpar->codec_type = AVMEDIA_TYPE_AUDIO;
+		audio->codecpar->codec_id = AV_CODEC_ID_AAC;
+		audio->codecpar->sample_rate = 44100;
+		audio->codecpar->channels = 2;
+		audio->codecpar->channel_layout = AV_CH_LAYOUT_STEREO;
+		audio->codecpar->frame_size = 1024;
+		audio->codecpar->extradata = (uint8_t*)av_mallocz(
+			sizeof(kAacConfig) + AV_INPUT_BUFFER_PADDING_SIZE);
+		memcpy(audio->codecpar->extradata, kAacConfig, sizeof(kAacConfig));
+		audio->codecpar->extradata_size = sizeof(kAacConfig);
+	}
+
+	return fmt_ctx;
+}
+
+//------------------------------------------------------------------------------
+// Read the recorded file back, packets are grouped by stream index
+//------------------------------------------------------------------------------
+bool ReadPackets(std::vector<std::vector<std::vector<uint8_t>>>& packets)
+{
+	AVFormatContext* fmt_ctx = nullptr;
+	if (avformat_open_input(&fmt_ctx, kRecordFile, nullptr, nullptr) < 0) {
+		return false;
+	}
+
+	if (avformat_find_stream_info(fmt_ctx, nullptr) < 0) {
+		avformat_close_input(&fmt_ctx);
+		return false;
+	}
+
+	packets.assign(fmt_ctx->nb_streams, {});
+
+	AVPacket* packet = av_packet_alloc();
+	while (av_read_frame(fmt_ctx, packet) >= 0) {
+		packets[packet->stream_index].emplace_back(packet->data,
+			packet->data + packet->size);
+		av_packet_unref(packet);
+	}
+	av_packet_free(&packet);
+
+	avformat_close_input(&fmt_ctx);
+
+	return true;
+}
+
+//==============================================================================
+//
+//==============================================================================
+class RecordWriterTest : public testing::Test
+{
+protected:
+	virtual void TearDown() override
+	{
+		remove(kRecordFile);
+	}
+};
+
+}
+
+TEST_F(RecordWriterTest, WriteAndReadBack)
+{
+	const uint32_t count = 100;
+
+	RecordWriter writer(kRecordFile);
+	ASSERT_EQ(writer.Start(CreateFormatContext(true)), ERR_CODE_OK);
+
+	for (uint32_t i = 0; i < count; i++) {
+		PinData video = MakePinData(jukey::media::MediaType::VIDEO, i, i * 40,
+			40, i % 25 == 0);
+		ASSERT_EQ(writer.QueuePacket(0, video), ERR_CODE_OK);
+
+		// 1024 samples at 44100Hz
+		PinData audio = MakePinData(jukey::media::MediaType::AUDIO, i,
+			i * 1024 * 1000 / 44100, 23, true);
+		ASSERT_EQ(writer.QueuePacket(1, audio), ERR_CODE_OK);
+	}
+
+	writer.Stop();
+
+	RecordWriterStats stats = writer.Stats();
+	EXPECT_EQ(stats.pushed, count * 2);
+	EXPECT_EQ(stats.written, count * 2);
+	EXPECT_EQ(stats.dropped, 0u);
+	EXPECT_GT(stats.file_bytes, 0u);
+
+	std::vector<std::vector<std::vector<uint8_t>>> packets;
+	ASSERT_TRUE(ReadPackets(packets));
+	ASSERT_EQ(packets.size(), 2u);
+
+	for (const auto& stream_packets : packets) {
+		ASSERT_EQ(stream_packets.size(), count);
+		for (uint32_t i = 0; i < count; i++) {
+			EXPECT_EQ(stream_packets[i], MakePayload(i, 100 + i % 50))
+				<< "packet:" << i;
+		}
+	}
+}
+
+TEST_F(RecordWriterTest, QueueAfterStop)
+{
+	RecordWriter writer(kRecordFile);
+	ASSERT_EQ(writer.Start(CreateFormatContext(false)), ERR_CODE_OK);
+
+	PinData data = MakePinData(jukey::media::MediaType::VIDEO, 0, 0, 40, true);
+	EXPECT_EQ(writer.QueuePacket(0, data), ERR_CODE_OK);
+	EXPECT_EQ(writer.QueuePacket(1, data), ERR_CODE_INVALID_PARAM);
+
+	writer.Stop();
+
+	EXPECT_EQ(writer.QueuePacket(0, data), ERR_CODE_FAILED);
+}
+
+TEST_F(RecordWriterTest, StopWhileQueueing)
+{
+	RecordWriter writer(kRecordFile);
+	ASSERT_EQ(writer.Start(CreateFormatContext(false)), ERR_CODE_OK);
+
+	std::atomic<uint32_t> queued { 0 };
+	std::thread producer([&writer, &queued]() {
+		for (uint32_t i = 0; ; i++) {
+			PinData data = MakePinData(jukey::media::MediaType::VIDEO, i, i * 40,
+				40, true);
+			if (writer.QueuePacket(0, data) != ERR_CODE_OK) {
+				break;
+			}
+			queued++;
+		}
+	});
+
+	while (queued < 100) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// Producer is still queueing
+	writer.Stop();
+	producer.join();
+
+	// Every accepted packet is either written or dropped
+	RecordWriterStats stats = writer.Stats();
+	EXPECT_EQ(stats.written + stats.dropped, queued.load());
+
+	std::vector<std::vector<std::vector<uint8_t>>> packets;
+	ASSERT_TRUE(ReadPackets(packets));
+	ASSERT_EQ(packets.size(), 1u);
+	EXPECT_EQ(packets[0].size(), stats.written);
+}
+
+TEST_F(RecordWriterTest, H264PressureDrop)
+{
+	RecordWriter writer(kRecordFile);
+	ASSERT_EQ(writer.Start(CreateFormatContext(false, AV_CODEC_ID_H264)),
+		ERR_CODE_OK);
+
+	// A frame larger than the queue limit always sees the queue full
+	const uint32_t kSmall = 1000;
+	const uint32_t kHuge = RECORD_QUEUE_MAX_BYTES;
+
+	struct Frame
+	{
+		uint8_t nal_hdr;
+		uint32_t size;
+		bool written;
+	};
+	const Frame frames[] = {
+		{ kH264Idr, kSmall, true },
+		{ kH264RefSlice, kSmall, true },
+		{ kH264NonRefSlice, kHuge, false },  // dropped alone
+		{ kH264RefSlice, kSmall, true },
+		{ kH264RefSlice, kHuge, false },     // dropped, wait for key frame
+		{ kH264RefSlice, kSmall, false },
+		{ kH264NonRefSlice, kSmall, false },
+		{ kH264Idr, kSmall, true },          // key frame ends waiting
+		{ kH264RefSlice, kSmall, true },
+	};
+
+	uint64_t expected_written = 0;
+	for (uint32_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		PinData data = MakeH264Data(i, frames[i].nal_hdr, frames[i].size);
+		ASSERT_EQ(writer.QueuePacket(0, data), ERR_CODE_OK);
+
+		RecordWriterStats stats = writer.Stats();
+		if (frames[i].written) {
+			expected_written++;
+		}
+		EXPECT_EQ(stats.pushed, expected_written) << "frame:" << i;
+		EXPECT_EQ(stats.dropped, i + 1 - expected_written) << "frame:" << i;
+	}
+
+	writer.Stop();
+
+	// Written frames went through the bitstream filter to the muxer
+	RecordWriterStats stats = writer.Stats();
+	EXPECT_EQ(stats.written, expected_written);
+	EXPECT_EQ(stats.queued_bytes, 0u);
+	EXPECT_GT(stats.file_bytes, expected_written * kSmall);
+
+	std::vector<std::vector<std::vector<uint8_t>>> packets;
+	ASSERT_TRUE(ReadPackets(packets));
+	ASSERT_EQ(packets.size(), 1u);
+	EXPECT_EQ(packets[0].size(), expected_written);
+}
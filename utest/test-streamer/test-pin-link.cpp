@@ -0,0 +1,338 @@
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "pin-link.h"
+#include "common-config.h"
+
+using namespace jukey::stmr;
+using namespace jukey::com;
+
+namespace
+{
+
+//==============================================================================
+// Records delivered data, delivery is held while the gate is closed
+//==============================================================================
+class MockSinkPin : public ISinkPin
+{
+public:
+	MockSinkPin(jukey::media::MediaType mt) : m_mt(mt) {}
+
+	// IUnknown
+	virtual void* QueryInterface(const char* iid) override { return nullptr; }
+	virtual uint32_t AddRef() override { return 1; }
+	virtual uint32_t Release() override { return 1; }
+
+	// IPin
+	virtual PinType Type() override { return PinType::SINK; }
+	virtual jukey::media::MediaType MType() override { return m_mt; }
+	virtual std::string StreamId() override { return ""; }
+	virtual IElement* Element() override { return nullptr; }
+	virtual std::string Name() override { return "mock-sink-pin"; }
+	virtual std::string Caps() override { return ""; }
+	virtual std::string Cap() override { return ""; }
+	virtual std::string ToStr() override { return "mock|mock-sink-pin"; }
+	virtual bool Negotiated() override { return true; }
+	virtual PinCaps PrepCaps() override { return PinCaps(); }
+	virtual PinCaps AvaiCaps() override { return PinCaps(); }
+	virtual PackedCaps PackedAvaiCaps() override { return PackedCaps(); }
+	virtual ErrCode OnPinMsg(IPin* pin, const PinMsg& msg) override
+	{
+		return ERR_CODE_OK;
+	}
+
+	virtual ErrCode OnPinData(const PinData& data) override
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_entered = true;
+		m_cv.notify_all();
+		m_cv.wait(lock, [this]() { return m_open; });
+
+		m_received.push_back(data.pts);
+		m_cv.notify_all();
+
+		if (on_data) {
+			lock.unlock();
+			on_data();
+		}
+
+		return ERR_CODE_OK;
+	}
+
+	// ISinkPin
+	virtual ErrCode Init(jukey::media::MediaType media_type, IElement* element,
+		CSTREF pin_name, CSTREF caps, ISinkPinHandler* handler) override
+	{
+		return ERR_CODE_OK;
+	}
+	virtual ISrcPin* SrcPin() override { return nullptr; }
+	virtual void SetSrcPin(ISrcPin* src_pin) override {}
+	virtual ErrCode SetNegotiateCap(IPin* pin, CSTREF cap) override
+	{
+		return ERR_CODE_OK;
+	}
+	virtual ErrCode UpdatePrepCaps(IPin* pin, const PinCaps& caps) override
+	{
+		return ERR_CODE_OK;
+	}
+
+	void Open()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_open = true;
+		m_cv.notify_all();
+	}
+
+	void Close()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_open = false;
+	}
+
+	bool WaitEntered()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_cv.wait_for(lock, std::chrono::seconds(5),
+			[this]() { return m_entered; });
+	}
+
+	std::vector<int64_t> WaitReceived(size_t count)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait_for(lock, std::chrono::seconds(5),
+			[this, count]() { return m_received.size() >= count; });
+		return m_received;
+	}
+
+	std::function<void()> on_data;
+
+private:
+	jukey::media::MediaType m_mt;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_open = true;
+	bool m_entered = false;
+	std::vector<int64_t> m_received;
+};
+
+void PushData(PinLink& link, int64_t pts)
+{
+	PinData data(jukey::media::MediaType::VIDEO);
+	data.pts = pts;
+	EXPECT_EQ(link.OnPinData(data), ERR_CODE_OK);
+}
+
+LinkParam QueuedParam(LinkDropPolicy policy, uint32_t queue_size)
+{
+	LinkParam param(LinkMode::QUEUED);
+	param.drop_policy = policy;
+	param.queue_size = queue_size;
+	return param;
+}
+
+}
+
+TEST(PinLink, DeliverInOrder)
+{
+	MockSinkPin pin(jukey::media::MediaType::VIDEO);
+	PinLinkSP link = PinLink::Create(&pin,
+		QueuedParam(LinkDropPolicy::DROP_OLDEST, 64));
+
+	for (int64_t i = 0; i < 50; i++) {
+		PushData(*link, i);
+	}
+
+	std::vector<int64_t> received = pin.WaitReceived(50);
+	ASSERT_EQ(received.size(), 50u);
+	for (int64_t i = 0; i < 50; i++) {
+		EXPECT_EQ(received[i], i);
+	}
+
+	LinkStats stats = link->Stats();
+	EXPECT_EQ(stats.pushed, 50u);
+	EXPECT_EQ(stats.delivered, 50u);
+	EXPECT_EQ(stats.dropped, 0u);
+}
+
+TEST(PinLink, DropOldestWhenFull)
+{
+	MockSinkPin pin(jukey::media::MediaType::VIDEO);
+	PinLinkSP link = PinLink::Create(&pin,
+		QueuedParam(LinkDropPolicy::DROP_OLDEST, 4));
+
+	// The first data is held in delivery, the others fill the ring
+	pin.Close();
+	PushData(*link, 0);
+	ASSERT_TRUE(pin.WaitEntered());
+
+	for (int64_t i = 1; i <= 10; i++) {
+		PushData(*link, i);
+	}
+	pin.Open();
+
+	std::vector<int64_t> received = pin.WaitReceived(5);
+	EXPECT_EQ(received, std::vector<int64_t>({ 0, 7, 8, 9, 10 }));
+	EXPECT_EQ(link->Stats().dropped, 6u);
+}
+
+TEST(PinLink, BlockUntilSpace)
+{
+	MockSinkPin pin(jukey::media::MediaType::AUDIO);
+	PinLinkSP link = PinLink::Create(&pin,
+		QueuedParam(LinkDropPolicy::BLOCK, 2));
+
+	pin.Close();
+	PushData(*link, 0);
+	ASSERT_TRUE(pin.WaitEntered());
+	PushData(*link, 1);
+	PushData(*link, 2);
+
+	// Space is made by delivery while the producer is blocked
+	std::thread opener([&pin]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		pin.Open();
+	});
+	PushData(*link, 3);
+	opener.join();
+
+	std::vector<int64_t> received = pin.WaitReceived(4);
+	EXPECT_EQ(received, std::vector<int64_t>({ 0, 1, 2, 3 }));
+
+	LinkStats stats = link->Stats();
+	EXPECT_EQ(stats.blocked, 1u);
+	EXPECT_EQ(stats.dropped, 0u);
+}
+
+TEST(PinLink, BlockTimeoutDropsOldest)
+{
+	MockSinkPin pin(jukey::media::MediaType::AUDIO);
+	PinLinkSP link = PinLink::Create(&pin,
+		QueuedParam(LinkDropPolicy::BLOCK, 2));
+
+	pin.Close();
+	PushData(*link, 0);
+	ASSERT_TRUE(pin.WaitEntered());
+	PushData(*link, 1);
+	PushData(*link, 2);
+
+	auto start = std::chrono::steady_clock::now();
+	PushData(*link, 3);
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	EXPECT_GE(elapsed, std::chrono::milliseconds(PIN_LINK_MAX_BLOCK_MS - 10));
+	pin.Open();
+
+	std::vector<int64_t> received = pin.WaitReceived(3);
+	EXPECT_EQ(received, std::vector<int64_t>({ 0, 2, 3 }));
+
+	LinkStats stats = link->Stats();
+	EXPECT_EQ(stats.blocked, 1u);
+	EXPECT_EQ(stats.dropped, 1u);
+}
+
+TEST(PinLink, BlockInWorkerBounded)
+{
+	MockSinkPin pin(jukey::media::MediaType::AUDIO);
+	PinLinkSP link = PinLink::Create(&pin,
+		QueuedParam(LinkDropPolicy::BLOCK, 2));
+
+	StreamSchedulerSP scheduler = StreamScheduler::Instance();
+	StrandId producer = scheduler->CreateStrand("producer");
+
+	pin.Close();
+	PushData(*link, 0);
+	ASSERT_TRUE(pin.WaitEntered());
+
+	// Producer element blocks in worker, the timeout does not depend on spare
+	// threads
+	std::promise<std::chrono::steady_clock::duration> done;
+	scheduler->Post(producer, [&]() {
+		PushData(*link, 1);
+		PushData(*link, 2);
+
+		auto start = std::chrono::steady_clock::now();
+		PushData(*link, 3);
+		done.set_value(std::chrono::steady_clock::now() - start);
+	});
+
+	std::future<std::chrono::steady_clock::duration> result = done.get_future();
+	ASSERT_EQ(result.wait_for(std::chrono::seconds(5)),
+		std::future_status::ready);
+	EXPECT_GE(result.get(), std::chrono::milliseconds(PIN_LINK_MAX_BLOCK_MS - 10));
+	pin.Open();
+
+	std::vector<int64_t> received = pin.WaitReceived(3);
+	EXPECT_EQ(received, std::vector<int64_t>({ 0, 2, 3 }));
+	EXPECT_EQ(link->Stats().dropped, 1u);
+
+	scheduler->DestroyStrand(producer);
+}
+
+TEST(PinLink, ClosedRefusesData)
+{
+	MockSinkPin pin(jukey::media::MediaType::VIDEO);
+	PinLinkSP link = PinLink::Create(&pin,
+		QueuedParam(LinkDropPolicy::DROP_OLDEST, 4));
+
+	PushData(*link, 0);
+	pin.WaitReceived(1);
+	link->Close();
+
+	PinData data(jukey::media::MediaType::VIDEO);
+	EXPECT_NE(link->OnPinData(data), ERR_CODE_OK);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_EQ(pin.WaitReceived(1).size(), 1u);
+}
+
+TEST(PinLink, ReleasedInDelivery)
+{
+	MockSinkPin pin(jukey::media::MediaType::VIDEO);
+	PinLinkSP link = PinLink::Create(&pin,
+		QueuedParam(LinkDropPolicy::DROP_OLDEST, 8));
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool released = false;
+
+	// Sink removes the link in delivery, the way src pin does
+	pin.on_data = [&]() {
+		PinLinkSP removed;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			removed.swap(link);
+		}
+		if (removed) {
+			removed->Close();
+		}
+		removed.reset();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		released = true;
+		cv.notify_all();
+	};
+
+	pin.Close();
+	{
+		PinLinkSP pusher = link;
+		for (int64_t i = 0; i < 4; i++) {
+			PushData(*pusher, i);
+		}
+	}
+	pin.Open();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5),
+		[&released]() { return released; }));
+	lock.unlock();
+
+	// Delivery stops after the data that closed the link
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(pin.WaitReceived(1).size(), 1u);
+}
@@ -0,0 +1,117 @@
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/spsc-ring.h"
+
+using namespace jukey::util;
+
+namespace
+{
+
+std::unique_ptr<int> Item(int value)
+{
+	return std::unique_ptr<int>(new int(value));
+}
+
+}
+
+TEST(SpscRing, Empty)
+{
+	SpscRing<int> ring(4);
+
+	std::unique_ptr<int> item;
+	EXPECT_EQ(ring.Size(), 0u);
+	EXPECT_FALSE(ring.Full());
+	EXPECT_FALSE(ring.Pop(item));
+	EXPECT_EQ(ring.DropOldest(), nullptr);
+}
+
+TEST(SpscRing, Full)
+{
+	SpscRing<int> ring(4);
+
+	for (int i = 0; i < 4; i++) {
+		auto item = Item(i);
+		ASSERT_TRUE(ring.Push(item));
+		EXPECT_EQ(item, nullptr); // moved into ring
+	}
+	EXPECT_TRUE(ring.Full());
+
+	// Item is kept by caller on failure
+	auto item = Item(4);
+	EXPECT_FALSE(ring.Push(item));
+	ASSERT_NE(item, nullptr);
+
+	auto oldest = ring.DropOldest();
+	ASSERT_NE(oldest, nullptr);
+	EXPECT_EQ(*oldest, 0);
+	EXPECT_TRUE(ring.Push(item));
+
+	for (int i = 1; i <= 4; i++) {
+		std::unique_ptr<int> popped;
+		ASSERT_TRUE(ring.Pop(popped));
+		EXPECT_EQ(*popped, i);
+	}
+	EXPECT_EQ(ring.Size(), 0u);
+}
+
+TEST(SpscRing, Wraparound)
+{
+	SpscRing<int> ring(3);
+
+	// Indexes run many times around the slots
+	for (int i = 0; i < 100; i++) {
+		auto item = Item(i);
+		ASSERT_TRUE(ring.Push(item));
+		if (i % 2 == 1) {
+			std::unique_ptr<int> popped;
+			ASSERT_TRUE(ring.Pop(popped));
+			ASSERT_TRUE(ring.Pop(popped));
+			EXPECT_EQ(*popped, i);
+		}
+		else {
+			EXPECT_EQ(ring.Size(), 1u);
+		}
+	}
+}
+
+TEST(SpscRing, ConcurrentDropOldest)
+{
+	const int kCount = 100000;
+	SpscRing<int> ring(8);
+
+	std::vector<int> popped;
+	std::atomic<bool> finished { false };
+	int dropped = 0;
+
+	std::thread consumer([&]() {
+		std::unique_ptr<int> item;
+		while (true) {
+			if (ring.Pop(item)) {
+				popped.push_back(*item);
+			}
+			else if (finished) {
+				if (!ring.Pop(item)) break;
+				popped.push_back(*item);
+			}
+		}
+	});
+
+	for (int i = 0; i < kCount; i++) {
+		auto item = Item(i);
+		while (!ring.Push(item)) {
+			if (ring.DropOldest()) {
+				dropped++;
+			}
+		}
+	}
+	finished = true;
+	consumer.join();
+
+	// Every item is taken exactly once, in order
+	EXPECT_EQ((int)popped.size() + dropped, kCount);
+	for (size_t i = 1; i < popped.size(); i++) {
+		ASSERT_LT(popped[i - 1], popped[i]);
+	}
+}
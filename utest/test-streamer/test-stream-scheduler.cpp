@@ -0,0 +1,308 @@
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "stream-scheduler.h"
+
+using namespace jukey::stmr;
+
+namespace
+{
+
+const auto kTimeout = std::chrono::seconds(5);
+
+// Scheduler is leaked if the test timed out, as destruction would hang
+class SchedulerTest : public testing::Test
+{
+protected:
+	void Create(uint32_t thread_count)
+	{
+		m_scheduler = new StreamScheduler(thread_count);
+	}
+
+	bool Wait(std::future<void>& result)
+	{
+		if (result.wait_for(kTimeout) != std::future_status::ready) {
+			m_scheduler = nullptr;
+			return false;
+		}
+		return true;
+	}
+
+	virtual void TearDown() override
+	{
+		delete m_scheduler;
+	}
+
+	StreamScheduler* m_scheduler = nullptr;
+};
+
+}
+
+TEST_F(SchedulerTest, StrandOrder)
+{
+	Create(4);
+
+	StrandId strand = m_scheduler->CreateStrand("order");
+
+	const int kCount = 1000;
+	std::vector<int> order;
+	std::atomic<int> running { 0 };
+	std::atomic<bool> overlapped { false };
+	std::promise<void> done;
+
+	for (int i = 0; i < kCount; i++) {
+		ASSERT_TRUE(m_scheduler->Post(strand, [&, i]() {
+			if (running.fetch_add(1) != 0) overlapped = true;
+			EXPECT_TRUE(m_scheduler->InStrand(strand));
+			order.push_back(i);
+			running.fetch_sub(1);
+			if (i == kCount - 1) done.set_value();
+		}));
+	}
+
+	std::future<void> result = done.get_future();
+	ASSERT_TRUE(Wait(result));
+
+	EXPECT_FALSE(overlapped);
+	ASSERT_EQ(order.size(), (size_t)kCount);
+	for (int i = 0; i < kCount; i++) {
+		EXPECT_EQ(order[i], i);
+	}
+
+	m_scheduler->DestroyStrand(strand);
+}
+
+TEST_F(SchedulerTest, IdleWorkerSteals)
+{
+	Create(2);
+
+	StrandId busy = m_scheduler->CreateStrand("busy");
+	StrandId other = m_scheduler->CreateStrand("other");
+
+	std::atomic<bool> other_run { false };
+	std::thread::id busy_thread, other_thread;
+	std::promise<void> done;
+
+	// Posted in worker, the strand is queued on the busy worker itself
+	m_scheduler->Post(busy, [&]() {
+		busy_thread = std::this_thread::get_id();
+		m_scheduler->Post(other, [&]() {
+			other_thread = std::this_thread::get_id();
+			other_run = true;
+		});
+
+		auto deadline = std::chrono::steady_clock::now() + kTimeout;
+		while (!other_run && std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		done.set_value();
+	});
+
+	std::future<void> result = done.get_future();
+	ASSERT_TRUE(Wait(result));
+
+	EXPECT_TRUE(other_run);
+	EXPECT_NE(busy_thread, other_thread);
+
+	m_scheduler->DestroyStrand(busy);
+	m_scheduler->DestroyStrand(other);
+}
+
+TEST_F(SchedulerTest, NestedWaitNoDeadlock)
+{
+	Create(1);
+
+	StrandId a = m_scheduler->CreateStrand("a");
+	StrandId b = m_scheduler->CreateStrand("b");
+	StrandId c = m_scheduler->CreateStrand("c");
+
+	std::atomic<bool> a_ready { false }, b_ready { false };
+	std::promise<void> done;
+
+	// b waits for a which waits for c, all posted to the only worker
+	m_scheduler->Post(a, [&]() {
+		m_scheduler->WaitUntil([&]() { return a_ready.load(); });
+		b_ready = true;
+	});
+	m_scheduler->Post(b, [&]() {
+		m_scheduler->WaitUntil([&]() { return b_ready.load(); });
+		done.set_value();
+	});
+	m_scheduler->Post(c, [&]() { a_ready = true; });
+
+	std::future<void> result = done.get_future();
+	ASSERT_TRUE(Wait(result));
+
+	m_scheduler->DestroyStrand(a);
+	m_scheduler->DestroyStrand(b);
+	m_scheduler->DestroyStrand(c);
+}
+
+TEST_F(SchedulerTest, DestroyWaitsForBlockedTask)
+{
+	Create(1);
+
+	StrandId a = m_scheduler->CreateStrand("a");
+	StrandId b = m_scheduler->CreateStrand("b");
+
+	std::atomic<bool> b_started { false }, a_finished { false };
+	std::atomic<bool> finished_before_destroyed { false };
+	std::promise<void> done;
+
+	m_scheduler->Post(a, [&]() {
+		m_scheduler->WaitUntil([&]() { return b_started.load(); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		a_finished = true;
+	});
+	m_scheduler->Post(b, [&]() {
+		b_started = true;
+		m_scheduler->DestroyStrand(a);
+		finished_before_destroyed = a_finished.load();
+		done.set_value();
+	});
+
+	std::future<void> result = done.get_future();
+	ASSERT_TRUE(Wait(result));
+
+	EXPECT_TRUE(finished_before_destroyed);
+
+	m_scheduler->DestroyStrand(b);
+}
+
+TEST_F(SchedulerTest, DestroyBySelf)
+{
+	Create(2);
+
+	StrandId strand = m_scheduler->CreateStrand("self");
+
+	std::atomic<int> run_count { 0 };
+	std::promise<void> done;
+
+	m_scheduler->Post(strand, [&]() {
+		run_count++;
+		m_scheduler->DestroyStrand(strand);
+		done.set_value();
+	});
+	m_scheduler->Post(strand, [&]() { run_count++; });
+
+	std::future<void> result = done.get_future();
+	ASSERT_TRUE(Wait(result));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_EQ(run_count, 1);
+	EXPECT_FALSE(m_scheduler->Post(strand, []() {}));
+}
+
+TEST_F(SchedulerTest, ShutdownWithPendingWork)
+{
+	Create(2);
+
+	StrandId strand = m_scheduler->CreateStrand("process");
+	StrandId waiter = m_scheduler->CreateStrand("waiter");
+
+	std::atomic<int> process_count { 0 };
+	m_scheduler->SetProcess(strand, [&]() -> uint32_t {
+		process_count++;
+		return 1;
+	}, 0);
+
+	// Spare thread is running when the scheduler is destroyed
+	std::atomic<bool> waited { false };
+	m_scheduler->Post(waiter, [&]() {
+		m_scheduler->WaitUntil([&]() { return process_count.load() >= 5; });
+		waited = true;
+	});
+
+	for (int i = 0; i < 100; i++) {
+		m_scheduler->Post(strand, []() {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		});
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + kTimeout;
+	while (!waited && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EXPECT_TRUE(waited);
+
+	delete m_scheduler;
+	m_scheduler = nullptr;
+
+	EXPECT_GE(process_count, 5);
+}
+
+TEST_F(SchedulerTest, SpareThreadReused)
+{
+	Create(1);
+
+	StrandId waiter = m_scheduler->CreateStrand("waiter");
+	StrandId other = m_scheduler->CreateStrand("other");
+
+	// Threads running tasks, the waiter of a round may be taken by the spare
+	// thread of the last round
+	std::mutex mutex;
+	std::set<std::thread::id> thread_ids;
+	auto record = [&]() {
+		std::lock_guard<std::mutex> lock(mutex);
+		thread_ids.insert(std::this_thread::get_id());
+	};
+
+	for (int round = 0; round < 3; round++) {
+		std::atomic<bool> ready { false };
+		std::promise<void> done;
+
+		m_scheduler->Post(waiter, [&]() {
+			record();
+			m_scheduler->WaitUntil([&]() { return ready.load(); });
+			done.set_value();
+		});
+		m_scheduler->Post(other, [&]() {
+			record();
+			ready = true;
+		});
+
+		std::future<void> result = done.get_future();
+		ASSERT_TRUE(Wait(result));
+	}
+
+	// The worker and one spare thread serve all rounds
+	EXPECT_EQ(thread_ids.size(), 2u);
+
+	m_scheduler->DestroyStrand(waiter);
+	m_scheduler->DestroyStrand(other);
+}
+
+TEST_F(SchedulerTest, WaitTimeoutAndNotify)
+{
+	Create(1);
+
+	StrandId waiter = m_scheduler->CreateStrand("waiter");
+
+	std::atomic<bool> flag { false };
+	std::atomic<bool> timed_out { false }, notified { false };
+	std::promise<void> done;
+
+	m_scheduler->Post(waiter, [&]() {
+		timed_out = !m_scheduler->WaitUntil([]() { return false; }, 20);
+		notified = m_scheduler->WaitUntil([&]() { return flag.load(); }, 5000);
+		done.set_value();
+	});
+
+	// Condition set out of any strand, woken only by NotifyWaiters
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	flag = true;
+	m_scheduler->NotifyWaiters();
+
+	std::future<void> result = done.get_future();
+	ASSERT_TRUE(Wait(result));
+
+	EXPECT_TRUE(timed_out);
+	EXPECT_TRUE(notified);
+
+	m_scheduler->DestroyStrand(waiter);
+}
@@ -0,0 +1,168 @@
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "fec-tier.h"
+#include "protocol.h"
+
+using namespace jukey::com;
+using namespace jukey::txp;
+using namespace jukey::prot;
+
+namespace
+{
+
+//==============================================================================
+// Records FEC frames fanned out by tiers
+//==============================================================================
+class FakeSender : public IServerStreamSender
+{
+public:
+	// IUnknown
+	virtual void* QueryInterface(const char* riid) override { return this; }
+	virtual uint32_t AddRef() override { return 1; }
+	virtual uint32_t Release() override { return 1; }
+
+	// IServerStreamSender
+	virtual ErrCode Init(IStreamSenderHandler* sender_handler,
+		IFeedbackHandler* feedback_handler,
+		IPacingScheduler* pacing_scheduler,
+		uint32_t channel_id,
+		uint32_t user_id,
+		const MediaStream& stream) override
+	{
+		return ERR_CODE_OK;
+	}
+	virtual bool SetBitrateConfig(const BitrateConfig& config) override
+	{
+		return true;
+	}
+	virtual jukey::com::Stream Stream() override { return jukey::com::Stream(); }
+	virtual uint32_t ChannelId() override { return 0; }
+	virtual uint32_t UserId() override { return 0; }
+	virtual void InputFecFrameData(const Buffer& buf) override
+	{
+		m_frames.push_back(buf);
+	}
+	virtual void ResetFecGroup() override { m_reset_count++; }
+	virtual void InputRelayData(const Buffer& buf) override {}
+	virtual void InputFeedbackData(const Buffer& buf) override {}
+
+	std::vector<Buffer> m_frames;
+	uint32_t m_reset_count = 0;
+};
+
+//------------------------------------------------------------------------------
+// Segments with headroom, as written by frame packer
+//------------------------------------------------------------------------------
+void WriteSegments(FecTierTable& table, uint8_t layer, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		Buffer seg(FEC_HDR_LEN + 256, 256);
+		seg.start_pos = FEC_HDR_LEN;
+		table.WriteSegmentData(layer, seg);
+	}
+}
+
+}
+
+TEST(FecTier, SameParamsShareEncoder)
+{
+	FecTierTable table;
+	FakeSender first;
+	FakeSender second;
+
+	uint32_t key1 = table.Join(0, 4, 2, 1, &first);
+	uint32_t key2 = table.Join(0, 4, 2, 2, &second);
+
+	EXPECT_EQ(key1, key2);
+	EXPECT_EQ(key1, FecTier::Key(0, 4, 2));
+	EXPECT_EQ(table.Size(), 1u);
+
+	FecTierSP tier = table.Find(key1);
+	ASSERT_TRUE(tier);
+	EXPECT_EQ(tier->Layer(), 0);
+	EXPECT_EQ(tier->K(), 4);
+	EXPECT_EQ(tier->R(), 2);
+
+	// Group numbers start over for each joining sender
+	EXPECT_EQ(first.m_reset_count, 1u);
+	EXPECT_EQ(second.m_reset_count, 1u);
+
+	// One group encoded once, both senders get the same frames
+	WriteSegments(table, 0, 4);
+
+	ASSERT_EQ(first.m_frames.size(), 6u);
+	ASSERT_EQ(second.m_frames.size(), 6u);
+	for (size_t i = 0; i < first.m_frames.size(); i++) {
+		EXPECT_EQ(DP(first.m_frames[i]), DP(second.m_frames[i]));
+
+		FecHdr* hdr = (FecHdr*)DP(first.m_frames[i]);
+		EXPECT_EQ(hdr->seq, i);
+		EXPECT_EQ(hdr->gseq, i);
+		EXPECT_EQ(hdr->group, 0);
+	}
+}
+
+TEST(FecTier, DifferentParamsOrLayer)
+{
+	FecTierTable table;
+	FakeSender base;
+	FakeSender more_fec;
+	FakeSender upper;
+
+	uint32_t base_key = table.Join(0, 4, 1, 1, &base);
+	uint32_t more_key = table.Join(0, 4, 2, 2, &more_fec);
+	uint32_t upper_key = table.Join(1, 4, 1, 3, &upper);
+
+	EXPECT_NE(base_key, more_key);
+	EXPECT_NE(base_key, upper_key);
+	EXPECT_EQ(table.Size(), 3u);
+
+	// Segments of a layer only reach tiers of the layer
+	WriteSegments(table, 0, 4);
+
+	EXPECT_EQ(base.m_frames.size(), 5u);
+	EXPECT_EQ(more_fec.m_frames.size(), 6u);
+	EXPECT_TRUE(upper.m_frames.empty());
+
+	WriteSegments(table, 1, 4);
+
+	EXPECT_EQ(base.m_frames.size(), 5u);
+	EXPECT_EQ(upper.m_frames.size(), 5u);
+}
+
+TEST(FecTier, ReleasedWithLastSender)
+{
+	FecTierTable table;
+	FakeSender first;
+	FakeSender second;
+
+	uint32_t key = table.Join(0, 4, 1, 1, &first);
+	table.Join(0, 4, 1, 2, &second);
+
+	std::weak_ptr<FecTier> tier = table.Find(key);
+	ASSERT_FALSE(tier.expired());
+
+	// Tier is kept while it has any sender
+	EXPECT_TRUE(table.Leave(key, 1));
+	EXPECT_EQ(table.Size(), 1u);
+	EXPECT_FALSE(tier.expired());
+
+	WriteSegments(table, 0, 4);
+	EXPECT_TRUE(first.m_frames.empty());
+	EXPECT_EQ(second.m_frames.size(), 5u);
+
+	EXPECT_TRUE(table.Leave(key, 2));
+	EXPECT_TRUE(table.Empty());
+	EXPECT_TRUE(tier.expired());
+	EXPECT_FALSE(table.Find(key));
+	EXPECT_FALSE(table.Leave(key, 2));
+
+	// Joining again creates a new tier, sequence starts over
+	table.Join(0, 4, 1, 1, &first);
+	WriteSegments(table, 0, 4);
+
+	ASSERT_EQ(first.m_frames.size(), 5u);
+	EXPECT_EQ(((FecHdr*)DP(first.m_frames[0]))->seq, 0);
+}
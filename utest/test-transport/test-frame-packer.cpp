@@ -87,13 +87,13 @@ TEST(FramePack, video_normal)
 	EXPECT_EQ(handler.m_buffers[0].data_len, 1024 + sizeof(SegHdr));
 	EXPECT_EQ(handler.m_buffers[1].data_len, 1024 + sizeof(SegHdr));
 
-	SegHdr* hdr1 = (SegHdr*)(handler.m_buffers[0].data.get());
+	SegHdr* hdr1 = (SegHdr*)DP(handler.m_buffers[0]);
 	EXPECT_EQ(hdr1->fseq, 100);
 	EXPECT_EQ(hdr1->slen, 1040);
 	EXPECT_EQ(hdr1->sseq, 0);
 	EXPECT_EQ(hdr1->st, 0);
 
-	SegHdr* hdr2 = (SegHdr*)(handler.m_buffers[1].data.get());
+	SegHdr* hdr2 = (SegHdr*)DP(handler.m_buffers[1]);
 	EXPECT_EQ(hdr2->fseq, 100);
 	EXPECT_EQ(hdr2->slen, 992);
 	EXPECT_EQ(hdr2->sseq, 1);
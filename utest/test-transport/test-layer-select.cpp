@@ -0,0 +1,48 @@
+#include "gtest/gtest.h"
+#include "transport-common.h"
+#include "common-config.h"
+
+using namespace jukey::txp;
+
+TEST(LayerSelect, UnmeasuredKeepsCurrent)
+{
+	uint32_t layer_kbps[] = { 300, 800, 0 };
+
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 1, 10000), 1);
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 0, 10), 0);
+}
+
+TEST(LayerSelect, HighestFitting)
+{
+	uint32_t layer_kbps[] = { 300, 800, 2000 };
+
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 0, 100), 0);
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 0, 1000), 1);
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 0, 5000), 2);
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 2, 100), 0);
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 1, 0, 5000), 0);
+}
+
+TEST(LayerSelect, SwitchUpNeedsHeadroom)
+{
+	uint32_t layer_kbps[] = { 300, 850, 2000 };
+
+	// 850 * 100 / SFU_LAYER_UP_PERCENT is the least bandwidth to switch up
+	uint32_t up_kbps = 850 * 100 / SFU_LAYER_UP_PERCENT;
+
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 0, 900), 0);
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 0, up_kbps - 1), 0);
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 0, up_kbps), 1);
+}
+
+TEST(LayerSelect, KeepCurrentUntilNotFit)
+{
+	uint32_t layer_kbps[] = { 300, 850, 2000 };
+
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 1, 900), 1);
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 1, 850), 1);
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 1, 849), 0);
+
+	// Switching down to a lower but still higher than base layer
+	EXPECT_EQ(SelectSimulcastLayer(layer_kbps, 3, 2, 1900), 1);
+}
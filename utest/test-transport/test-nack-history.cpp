@@ -0,0 +1,157 @@
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "nack-history.h"
+#include "protocol.h"
+
+using namespace jukey::com;
+using namespace jukey::txp;
+using namespace jukey::prot;
+
+namespace
+{
+
+// Same as the ring size of NackHistory
+const uint32_t kRingSize = 16384;
+
+//------------------------------------------------------------------------------
+// FEC frame without redundancy
+//------------------------------------------------------------------------------
+Buffer MakeFrame(uint32_t seq, uint8_t k = 0, uint8_t gseq = 0)
+{
+	Buffer buf(FEC_HDR_LEN + 100, FEC_HDR_LEN + 100);
+
+	FecHdr* hdr = (FecHdr*)DP(buf);
+	hdr->ver = 0;
+	hdr->K = k;
+	hdr->R = 0;
+	hdr->gseq = gseq;
+	hdr->rtx = 0;
+	hdr->group = 0;
+	hdr->seq = seq;
+
+	return buf;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool Found(NackHistory& history, uint32_t seq)
+{
+	Buffer buf;
+	if (!history.FindFecFrameData(seq, buf)) {
+		return false;
+	}
+	EXPECT_EQ(((FecHdr*)DP(buf))->seq, seq);
+	return true;
+}
+
+}
+
+TEST(NackHistory, FindMarksCopyAsRtx)
+{
+	NackHistory history;
+	Buffer frame = MakeFrame(100);
+	history.SaveFecFrameData(frame);
+
+	Buffer buf;
+	ASSERT_TRUE(history.FindFecFrameData(100, buf));
+	EXPECT_NE(DP(buf), DP(frame));
+	EXPECT_EQ(buf.data_len, frame.data_len);
+	EXPECT_EQ(((FecHdr*)DP(buf))->rtx, 1);
+
+	// Saved packet may still be in the sending path
+	EXPECT_EQ(((FecHdr*)DP(frame))->rtx, 0);
+
+	EXPECT_FALSE(Found(history, 99));
+	EXPECT_FALSE(Found(history, 101));
+}
+
+TEST(NackHistory, SequenceWrap)
+{
+	NackHistory history;
+
+	for (uint32_t seq = 0xFFFFFFF0; seq != 0x10; seq++) {
+		history.SaveFecFrameData(MakeFrame(seq));
+	}
+
+	for (uint32_t seq = 0xFFFFFFF0; seq != 0x10; seq++) {
+		EXPECT_TRUE(Found(history, seq)) << "seq:" << seq;
+	}
+
+	// Older than the oldest across the wrap
+	history.SaveFecFrameData(MakeFrame(0xFFFFFF00));
+	EXPECT_FALSE(Found(history, 0xFFFFFF00));
+
+	// Both sides of the wrap are kept
+	EXPECT_TRUE(Found(history, 0xFFFFFFFF));
+	EXPECT_TRUE(Found(history, 0));
+}
+
+TEST(NackHistory, RingOverwrite)
+{
+	NackHistory history;
+
+	const uint32_t kExtra = 100;
+	for (uint32_t seq = 0; seq < kRingSize + kExtra; seq++) {
+		history.SaveFecFrameData(MakeFrame(seq));
+	}
+
+	// Slots of the oldest sequences are taken by the newest
+	for (uint32_t seq = 0; seq < kExtra; seq++) {
+		EXPECT_FALSE(Found(history, seq)) << "seq:" << seq;
+	}
+	for (uint32_t seq = kExtra; seq < kRingSize + kExtra; seq++) {
+		ASSERT_TRUE(Found(history, seq)) << "seq:" << seq;
+	}
+
+	// Sequence jump moves the whole window, the oldest is the oldest saved
+	// packet and packets before it are ignored
+	history.SaveFecFrameData(MakeFrame(kRingSize * 4));
+	EXPECT_TRUE(Found(history, kRingSize * 4));
+
+	history.SaveFecFrameData(MakeFrame(kRingSize * 4 - 1));
+	EXPECT_FALSE(Found(history, kRingSize * 4 - 1));
+
+	history.SaveFecFrameData(MakeFrame(kRingSize * 4 + 1));
+	EXPECT_TRUE(Found(history, kRingSize * 4 + 1));
+}
+
+TEST(NackHistory, RedundantNotSaved)
+{
+	NackHistory history;
+
+	// k:4, gseq 0~3 are source packets, 4 is redundant
+	history.SaveFecFrameData(MakeFrame(10, 4, 3));
+	history.SaveFecFrameData(MakeFrame(11, 4, 4));
+
+	EXPECT_TRUE(Found(history, 10));
+	EXPECT_FALSE(Found(history, 11));
+}
+
+TEST(NackHistory, Expiry)
+{
+	NackHistory history;
+
+	for (uint32_t seq = 0; seq < 10; seq++) {
+		history.SaveFecFrameData(MakeFrame(seq));
+	}
+	EXPECT_TRUE(Found(history, 0));
+
+	// Cache duration is one second
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+	for (uint32_t seq = 0; seq < 10; seq++) {
+		EXPECT_FALSE(Found(history, seq)) << "seq:" << seq;
+	}
+
+	// Expired packets are released on next saving, history restarts from the
+	// new packet
+	history.SaveFecFrameData(MakeFrame(20));
+	EXPECT_TRUE(Found(history, 20));
+	EXPECT_FALSE(Found(history, 9));
+
+	history.SaveFecFrameData(MakeFrame(15));
+	EXPECT_FALSE(Found(history, 15));
+}
@@ -0,0 +1,366 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "pacing-scheduler.h"
+
+using namespace jukey::base;
+using namespace jukey::com;
+using namespace jukey::txp;
+
+namespace
+{
+
+//==============================================================================
+// Timer manager driven by the test, the loop timer fires on Fire()
+//==============================================================================
+class FakeTimerMgr : public ITimerMgr
+{
+public:
+	// IUnknown
+	virtual void* QueryInterface(const char* riid) override { return this; }
+	virtual uint32_t AddRef() override { return 1; }
+	virtual uint32_t Release() override { return 1; }
+
+	// ITimerMgr
+	virtual void Start() override {}
+	virtual void Stop() override {}
+	virtual TimerId AllocTimer(const TimerParam& param) override
+	{
+		m_func = param.timer_func;
+		return 1;
+	}
+	virtual void FreeTimer(TimerId timer_id) override { m_func = nullptr; }
+	virtual void StartTimer(TimerId timer_id) override {}
+	virtual void StopTimer(TimerId timer_id) override {}
+	virtual bool UpdateTimeout(TimerId timer_id, uint32_t timeout_ms) override
+	{
+		return true;
+	}
+
+	void Fire() { m_func(0); }
+
+private:
+	TimerFunc m_func;
+};
+
+//==============================================================================
+// Only provides the timer manager
+//==============================================================================
+class FakeFactory : public IComFactory
+{
+public:
+	virtual bool Init(const std::string& com_dir) override { return true; }
+	virtual IUnknown* CreateComponent(const std::string& cid,
+		const std::string& owner) override
+	{
+		return nullptr;
+	}
+	virtual void* QueryInterface(const std::string& cid, const std::string& iid,
+		const std::string& owner) override
+	{
+		return cid == CID_TIMER_MGR ? &m_timer_mgr : nullptr;
+	}
+	virtual void GetComponents(const std::string& iid,
+		std::vector<std::string>& cids) override {}
+	virtual void AddComObj(const ComObj& co) override {}
+	virtual void RemoveComObj(const std::string& oid) override {}
+	virtual std::vector<ComObj> GetComObjList(const std::string& cid) override
+	{
+		return {};
+	}
+
+	FakeTimerMgr m_timer_mgr;
+};
+
+//==============================================================================
+// Records packets of all flows in sending order
+//==============================================================================
+class Recorder
+{
+public:
+	void OnData(uint32_t flow, const Buffer& buf)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_sent.push_back(flow);
+		m_bytes[flow] += buf.data_len;
+	}
+
+	std::vector<uint32_t> Sent()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_sent;
+	}
+
+	uint64_t Bytes(uint32_t flow)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_bytes[flow];
+	}
+
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_sent.clear();
+		m_bytes.clear();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<uint32_t> m_sent;
+	std::map<uint32_t, uint64_t> m_bytes;
+};
+
+//==============================================================================
+//
+//==============================================================================
+class FlowHandler : public IPacingSenderHandler
+{
+public:
+	FlowHandler(uint32_t flow, Recorder& recorder)
+		: m_flow(flow), m_recorder(recorder) {}
+
+	virtual void OnPacingData(const Buffer& buf) override
+	{
+		m_recorder.OnData(m_flow, buf);
+		if (m_on_data) {
+			m_on_data();
+		}
+	}
+
+	uint32_t m_flow = 0;
+	Recorder& m_recorder;
+	std::function<void()> m_on_data;
+};
+
+// 1600kbps in a 5ms period with pacing factor 1.0
+const uint32_t kRateKbps = 1600;
+const uint32_t kPeriodBytes = 1000;
+
+//==============================================================================
+//
+//==============================================================================
+class PacingSchedulerTest : public testing::Test
+{
+protected:
+	PacingFlowId AddFlow(FlowHandler& handler, uint32_t rate_kbps = kRateKbps)
+	{
+		PacingFlowId flow_id = m_scheduler.AddFlow(&handler);
+		m_scheduler.SetPacingFactor(flow_id, 1.0);
+		m_scheduler.SetPacingRate(flow_id, rate_kbps);
+		return flow_id;
+	}
+
+	// The first packet is sent directly, the next period has a budget
+	void Prime(PacingFlowId flow_id)
+	{
+		m_scheduler.EnqueueData(flow_id, Buffer(100, 100), DP_LOW);
+	}
+
+	void Enqueue(PacingFlowId flow_id, uint32_t count, uint32_t len)
+	{
+		for (uint32_t i = 0; i < count; i++) {
+			m_scheduler.EnqueueData(flow_id, Buffer(len, len), DP_LOW);
+		}
+	}
+
+	void Fire() { m_factory.m_timer_mgr.Fire(); }
+
+	FakeFactory m_factory;
+	PacingScheduler m_scheduler { &m_factory };
+	Recorder m_recorder;
+};
+
+}
+
+TEST_F(PacingSchedulerTest, QuantumFairness)
+{
+	const uint32_t kFlowCount = 3;
+
+	std::vector<std::unique_ptr<FlowHandler>> handlers;
+	std::vector<PacingFlowId> flows;
+	for (uint32_t i = 0; i < kFlowCount; i++) {
+		handlers.emplace_back(new FlowHandler(i, m_recorder));
+		flows.push_back(AddFlow(*handlers.back()));
+		Prime(flows.back());
+	}
+	Fire();
+	m_recorder.Clear();
+
+	// 20 packets queued and 10 allowed for each flow
+	for (auto flow_id : flows) {
+		Enqueue(flow_id, 20, 100);
+	}
+	Fire();
+
+	std::vector<uint32_t> sent = m_recorder.Sent();
+	ASSERT_EQ(sent.size(), 10 * kFlowCount);
+
+	// One packet per flow in each round
+	for (size_t i = 0; i < sent.size(); i += kFlowCount) {
+		std::vector<bool> seen(kFlowCount, false);
+		for (size_t j = i; j < i + kFlowCount; j++) {
+			EXPECT_FALSE(seen[sent[j]]) << "index:" << j;
+			seen[sent[j]] = true;
+		}
+	}
+
+	for (uint32_t i = 0; i < kFlowCount; i++) {
+		EXPECT_EQ(m_recorder.Bytes(i), kPeriodBytes);
+	}
+}
+
+TEST_F(PacingSchedulerTest, QuantumByRate)
+{
+	FlowHandler slow(0, m_recorder);
+	FlowHandler fast(1, m_recorder);
+
+	PacingFlowId slow_id = AddFlow(slow, kRateKbps);
+	PacingFlowId fast_id = AddFlow(fast, kRateKbps * 2);
+	Prime(slow_id);
+	Prime(fast_id);
+	Fire();
+	m_recorder.Clear();
+
+	Enqueue(slow_id, 30, 100);
+	Enqueue(fast_id, 30, 100);
+	Fire();
+
+	EXPECT_EQ(m_recorder.Bytes(0), kPeriodBytes);
+	EXPECT_EQ(m_recorder.Bytes(1), kPeriodBytes * 2);
+}
+
+TEST_F(PacingSchedulerTest, OvershootCarried)
+{
+	FlowHandler handler(0, m_recorder);
+	PacingFlowId flow_id = AddFlow(handler);
+	Prime(flow_id);
+	Fire();
+	m_recorder.Clear();
+
+	// 300 bytes do not divide the period budget, the last packet of a period
+	// overshoots and the next period sends less
+	const uint32_t kPeriods = 6;
+	for (uint32_t i = 0; i < kPeriods; i++) {
+		Enqueue(flow_id, 4, 300);
+		Fire();
+	}
+
+	uint64_t bytes = m_recorder.Bytes(0);
+	EXPECT_GE(bytes, kPeriods * kPeriodBytes);
+	EXPECT_LT(bytes, kPeriods * kPeriodBytes + 300);
+}
+
+TEST_F(PacingSchedulerTest, RemoveFlowInBurst)
+{
+	FlowHandler first(0, m_recorder);
+	FlowHandler second(1, m_recorder);
+
+	PacingFlowId first_id = AddFlow(first);
+	PacingFlowId second_id = AddFlow(second);
+	Prime(first_id);
+	Prime(second_id);
+	Fire();
+	m_recorder.Clear();
+
+	// Removed by a send callback of the same burst
+	bool removed = false;
+	auto remove = [&]() {
+		if (!removed) {
+			removed = true;
+			m_scheduler.RemoveFlow(second_id);
+		}
+	};
+	first.m_on_data = remove;
+	second.m_on_data = remove;
+
+	Enqueue(first_id, 5, 100);
+	Enqueue(second_id, 5, 100);
+	Fire();
+
+	// At most the packet sending when removed
+	EXPECT_TRUE(removed);
+	EXPECT_LE(m_recorder.Bytes(1), 100u);
+	EXPECT_EQ(m_recorder.Bytes(0), 500u);
+	EXPECT_EQ(m_scheduler.FlowCount(), 1u);
+}
+
+TEST_F(PacingSchedulerTest, RemoveFlowWaitsForBurst)
+{
+	FlowHandler first(0, m_recorder);
+	FlowHandler second(1, m_recorder);
+
+	PacingFlowId first_id = AddFlow(first);
+	PacingFlowId second_id = AddFlow(second);
+	Prime(first_id);
+	Prime(second_id);
+	Fire();
+	m_recorder.Clear();
+
+	// Block the burst in its first packet until the flow is being removed
+	std::promise<void> in_burst;
+	std::atomic<bool> blocked { true };
+	auto block = [&]() {
+		if (blocked.exchange(false)) {
+			in_burst.set_value();
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+	};
+	first.m_on_data = block;
+	second.m_on_data = block;
+
+	Enqueue(first_id, 5, 100);
+	Enqueue(second_id, 5, 100);
+
+	size_t sent_when_removed = 0;
+	std::thread remover([&]() {
+		in_burst.get_future().wait();
+		m_scheduler.RemoveFlow(second_id);
+		sent_when_removed = m_recorder.Sent().size();
+	});
+
+	Fire();
+	remover.join();
+
+	// Burst had finished when RemoveFlow returned
+	EXPECT_EQ(sent_when_removed, m_recorder.Sent().size());
+	EXPECT_EQ(m_recorder.Bytes(0), 500u);
+	EXPECT_LE(m_recorder.Bytes(1), 100u);
+}
+
+TEST_F(PacingSchedulerTest, IdleWakeup)
+{
+	FlowHandler handler(0, m_recorder);
+	PacingFlowId flow_id = AddFlow(handler);
+	Prime(flow_id);
+	Fire();
+	m_recorder.Clear();
+
+	// Idle periods send nothing
+	for (int i = 0; i < 10; i++) {
+		Fire();
+	}
+	EXPECT_TRUE(m_recorder.Sent().empty());
+
+	// Budget is kept while the flow has recent traffic, queued data goes out
+	// in the next period
+	Enqueue(flow_id, 3, 100);
+	EXPECT_TRUE(m_recorder.Sent().empty());
+	Fire();
+	EXPECT_EQ(m_recorder.Sent().size(), 3u);
+
+	// Idle longer than the rate statistics window, the flow still wakes up in
+	// the next period
+	std::this_thread::sleep_for(std::chrono::milliseconds(450));
+	Fire();
+	m_recorder.Clear();
+
+	Enqueue(flow_id, 1, 100);
+	Fire();
+	EXPECT_EQ(m_recorder.Sent().size(), 1u);
+}
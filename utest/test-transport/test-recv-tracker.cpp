@@ -0,0 +1,207 @@
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "recv-tracker.h"
+
+using namespace jukey::txp;
+
+namespace
+{
+
+// Same as the window size of RecvTracker
+const uint32_t kWindowSize = 16384;
+
+typedef std::vector<std::pair<uint32_t, uint32_t>> Reported;
+
+//------------------------------------------------------------------------------
+// Sequence and arrival time(ms) of packets not reported yet
+//------------------------------------------------------------------------------
+Reported Report(RecvTracker& tracker, uint32_t begin_seq)
+{
+	Reported reported;
+	uint32_t count = tracker.ForEachUnreported(begin_seq,
+		[&reported](uint32_t seq, uint32_t recv_ms) {
+			reported.push_back(std::make_pair(seq, recv_ms));
+		});
+	EXPECT_EQ(count, reported.size());
+	return reported;
+}
+
+}
+
+TEST(RecvTracker, SequenceWrap)
+{
+	RecvTracker tracker;
+
+	// 16 bits boundary is an ordinary sequence
+	for (uint32_t seq = 0xFFF0; seq != 0x10010; seq++) {
+		if (seq != 0xFFFF) {
+			tracker.OnRecvPacket(seq, 1000);
+		}
+	}
+	EXPECT_EQ(tracker.MaxSeq(), 0x1000Fu);
+	EXPECT_FALSE(tracker.IsReceived(0xFFFF));
+	EXPECT_TRUE(tracker.IsReceived(0x10000));
+
+	RecvLossStats stats = tracker.CalcLossStats(0xFFF0);
+	EXPECT_EQ(stats.total_count, 32u);
+	EXPECT_EQ(stats.lost_count, 1u);
+
+	// 32 bits wrap, 0xFFFFFFFF and 0 are lost
+	RecvTracker wrapped;
+	for (uint32_t seq = 0xFFFFFFF0; seq != 0x10; seq++) {
+		if (seq != 0xFFFFFFFF && seq != 0) {
+			wrapped.OnRecvPacket(seq, seq * 1000ull);
+		}
+	}
+	EXPECT_EQ(wrapped.MaxSeq(), 0xFu);
+	EXPECT_TRUE(wrapped.IsReceived(0xFFFFFFFE));
+	EXPECT_FALSE(wrapped.IsReceived(0xFFFFFFFF));
+	EXPECT_FALSE(wrapped.IsReceived(0));
+	EXPECT_TRUE(wrapped.IsReceived(1));
+	EXPECT_FALSE(wrapped.IsReceived(0x10));
+
+	stats = wrapped.CalcLossStats(0xFFFFFFF0);
+	EXPECT_EQ(stats.total_count, 32u);
+	EXPECT_EQ(stats.recv_count, 30u);
+	EXPECT_EQ(stats.lost_count, 2u);
+	EXPECT_EQ(stats.max_consecutive_loss, 2u);
+
+	// Reported in order of sequence across the wrap
+	Reported reported = Report(wrapped, 0xFFFFFFF0);
+	ASSERT_EQ(reported.size(), 30u);
+	EXPECT_EQ(reported.front().first, 0xFFFFFFF0u);
+	EXPECT_EQ(reported[14].first, 0xFFFFFFFEu);
+	EXPECT_EQ(reported[15].first, 1u);
+	EXPECT_EQ(reported.back().first, 0xFu);
+	EXPECT_EQ(reported[15].second, 1u);
+}
+
+TEST(RecvTracker, WindowSlide)
+{
+	RecvTracker tracker;
+
+	tracker.OnRecvPacket(5, 0);
+	tracker.OnRecvPacket(kWindowSize + 4, 0);
+	EXPECT_TRUE(tracker.IsReceived(5));
+
+	// Slot of 5 is reused by the new sequence
+	tracker.OnRecvPacket(kWindowSize + 5, 0);
+	EXPECT_FALSE(tracker.IsReceived(5));
+	EXPECT_TRUE(tracker.IsReceived(kWindowSize + 5));
+	EXPECT_EQ(tracker.RecvCount(), 3u);
+
+	// Packets out of window are ignored
+	tracker.OnRecvPacket(5, 0);
+	EXPECT_FALSE(tracker.IsReceived(5));
+	EXPECT_EQ(tracker.RecvCount(), 3u);
+
+	// Sequences slid into the window are cleared
+	tracker.OnRecvPacket(kWindowSize * 2 + 100, 0);
+	for (uint32_t seq = kWindowSize + 101; seq < kWindowSize * 2 + 100; seq++) {
+		ASSERT_FALSE(tracker.IsReceived(seq)) << "seq:" << seq;
+	}
+
+	// A jump larger than window clears all
+	tracker.OnRecvPacket(kWindowSize * 10, 0);
+	RecvLossStats stats = tracker.CalcLossStats(0);
+	EXPECT_EQ(stats.total_count, 1u);
+	EXPECT_EQ(stats.recv_count, 1u);
+
+	// Begin sequence is limited to the window
+	tracker.OnRecvPacket(kWindowSize * 9 + 1, 0);
+	stats = tracker.CalcLossStats(0);
+	EXPECT_EQ(stats.total_count, kWindowSize);
+	EXPECT_EQ(stats.recv_count, 2u);
+	EXPECT_EQ(stats.lost_count, kWindowSize - 2);
+
+	// Nothing after max sequence
+	stats = tracker.CalcLossStats(kWindowSize * 10 + 1);
+	EXPECT_EQ(stats.total_count, 0u);
+	EXPECT_EQ(Report(tracker, kWindowSize * 10 + 1).size(), 0u);
+}
+
+TEST(RecvTracker, LatePacketReported)
+{
+	RecvTracker tracker;
+
+	for (uint32_t seq = 0; seq < 10; seq++) {
+		if (seq != 3 && seq != 4) {
+			tracker.OnRecvPacket(seq, seq * 1000);
+		}
+	}
+
+	Reported reported = Report(tracker, 0);
+	ASSERT_EQ(reported.size(), 8u);
+	EXPECT_EQ(reported[2], std::make_pair(2u, 2u));
+	EXPECT_EQ(reported[3], std::make_pair(5u, 5u));
+
+	// Reported once
+	EXPECT_TRUE(Report(tracker, 0).empty());
+
+	// Late packet is reported by the next feedback, even if its sequence is
+	// before the begin of the next feedback
+	tracker.OnRecvPacket(4, 20000);
+	tracker.OnRecvPacket(10, 21000);
+
+	reported = Report(tracker, 0);
+	ASSERT_EQ(reported.size(), 2u);
+	EXPECT_EQ(reported[0], std::make_pair(4u, 20u));
+	EXPECT_EQ(reported[1], std::make_pair(10u, 21u));
+
+	// Duplicated packet is neither counted nor reported again
+	tracker.OnRecvPacket(4, 30000);
+	EXPECT_EQ(tracker.RecvCount(), 10u);
+	EXPECT_TRUE(Report(tracker, 0).empty());
+
+	// Slid out sequences are not reported as old ones
+	tracker.OnRecvPacket(kWindowSize + 4, 40000);
+	reported = Report(tracker, 0);
+	ASSERT_EQ(reported.size(), 1u);
+	EXPECT_EQ(reported[0].first, kWindowSize + 4);
+}
+
+TEST(RecvTracker, LossStats)
+{
+	RecvTracker tracker;
+
+	// Lost 11~13, 21 and 100 packets crossing words
+	tracker.OnRecvPacket(10, 0);
+	for (uint32_t seq = 14; seq <= 20; seq++) {
+		tracker.OnRecvPacket(seq, 0);
+	}
+	tracker.OnRecvPacket(22, 0);
+	tracker.OnRecvPacket(123, 0);
+
+	// Loss before the first received packet is skipped
+	RecvLossStats stats = tracker.CalcLossStats(0);
+	EXPECT_EQ(stats.total_count, 114u);
+	EXPECT_EQ(stats.recv_count, 10u);
+	EXPECT_EQ(stats.lost_count, 104u);
+	EXPECT_EQ(stats.max_consecutive_loss, 100u);
+
+	stats = tracker.CalcLossStats(14);
+	EXPECT_EQ(stats.total_count, 110u);
+	EXPECT_EQ(stats.recv_count, 9u);
+	EXPECT_EQ(stats.lost_count, 101u);
+	EXPECT_EQ(stats.max_consecutive_loss, 100u);
+
+	stats = tracker.CalcLossStats(23);
+	EXPECT_EQ(stats.total_count, 1u);
+	EXPECT_EQ(stats.lost_count, 0u);
+	EXPECT_EQ(stats.max_consecutive_loss, 0u);
+
+	// Full words of received packets
+	RecvTracker full;
+	for (uint32_t seq = 60; seq < 260; seq++) {
+		if (seq != 130) {
+			full.OnRecvPacket(seq, 0);
+		}
+	}
+	stats = full.CalcLossStats(60);
+	EXPECT_EQ(stats.total_count, 200u);
+	EXPECT_EQ(stats.recv_count, 199u);
+	EXPECT_EQ(stats.lost_count, 1u);
+	EXPECT_EQ(stats.max_consecutive_loss, 1u);
+}
@@ -0,0 +1,135 @@
+#include <vector>
+#include <random>
+
+#include "gtest/gtest.h"
+#include "fec/gf-math.h"
+#include "fec/luigi-fec-encoder.h"
+#include "fec/luigi-fec-decoder.h"
+
+extern "C"
+{
+#include "fec.h"
+}
+
+using namespace jukey::util;
+
+namespace
+{
+
+const GfKernel kKernels[] = {
+	GfKernel::GF_KERNEL_SCALAR,
+	GfKernel::GF_KERNEL_SSSE3,
+	GfKernel::GF_KERNEL_AVX2
+};
+
+std::vector<uint8_t> RandomBytes(uint32_t size, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::vector<uint8_t> bytes(size);
+	for (auto& byte : bytes) {
+		byte = static_cast<uint8_t>(rng());
+	}
+	return bytes;
+}
+
+// Restore the best kernel after each test
+class GfMath : public testing::Test
+{
+protected:
+	virtual void TearDown() override
+	{
+		GfSetKernel(GfBestKernel());
+	}
+};
+
+}
+
+TEST_F(GfMath, MulInv)
+{
+	for (uint32_t a = 1; a < 256; a++) {
+		EXPECT_EQ(GfMul((uint8_t)a, GfInv((uint8_t)a)), 1);
+		EXPECT_EQ(GfMul((uint8_t)a, 0), 0);
+		EXPECT_EQ(GfMul((uint8_t)a, 1), a);
+	}
+}
+
+TEST_F(GfMath, KernelsMatchScalar)
+{
+	// Sizes not multiple of the vector width exercise the tail loop
+	const uint32_t sizes[] = { 1, 15, 16, 31, 32, 33, 1000, 1400 };
+	const uint32_t count = 8;
+
+	for (uint32_t size : sizes) {
+		std::vector<std::vector<uint8_t>> bufs;
+		std::vector<const uint8_t*> srcs;
+		for (uint32_t i = 0; i < count; i++) {
+			bufs.push_back(RandomBytes(size, size * 100 + i));
+			srcs.push_back(bufs[i].data());
+		}
+		std::vector<uint8_t> coeffs = RandomBytes(count, size);
+		coeffs[0] = 0; // zero and one coefficients take the fast path
+		coeffs[1] = 1;
+
+		ASSERT_TRUE(GfSetKernel(GfKernel::GF_KERNEL_SCALAR));
+		std::vector<uint8_t> expect(size);
+		GfLinearCombine(expect.data(), srcs.data(), coeffs.data(), count, size);
+
+		for (GfKernel kernel : kKernels) {
+			if (!GfSetKernel(kernel)) continue; // not supported by current CPU
+
+			std::vector<uint8_t> result(size);
+			GfLinearCombine(result.data(), srcs.data(), coeffs.data(), count,
+				size);
+			EXPECT_EQ(result, expect) << GfKernelName(kernel) << " size:" << size;
+		}
+	}
+}
+
+TEST_F(GfMath, EncodeDecodeMatchRizzo)
+{
+	const uint32_t k = 10, r = 4, size = 1200;
+
+	std::vector<std::vector<uint8_t>> bufs;
+	std::vector<void*> src;
+	for (uint32_t i = 0; i < k; i++) {
+		bufs.push_back(RandomBytes(size, i));
+		src.push_back(bufs[i].data());
+	}
+
+	std::vector<std::vector<uint8_t>> expect(r, std::vector<uint8_t>(size));
+	void* code = fec_new(k, k + r);
+	for (uint32_t i = 0; i < r; i++) {
+		fec_encode(code, src.data(), expect[i].data(), k + i, size);
+	}
+	fec_free(code);
+
+	for (GfKernel kernel : kKernels) {
+		if (!GfSetKernel(kernel)) continue;
+
+		std::vector<std::vector<uint8_t>> red(r, std::vector<uint8_t>(size));
+		std::vector<void*> dst;
+		for (auto& buf : red) {
+			dst.push_back(buf.data());
+		}
+
+		LuigiFecEncoder encoder(k, r);
+		encoder.Encode(src.data(), dst.data(), size);
+		EXPECT_EQ(red, expect) << GfKernelName(kernel);
+
+		// Lose the first r source packets
+		std::vector<std::vector<uint8_t>> work(k);
+		std::vector<void*> data(k);
+		std::vector<int> index(k);
+		for (uint32_t i = 0; i < k; i++) {
+			work[i] = i < r ? red[i] : bufs[i];
+			data[i] = work[i].data();
+			index[i] = i < r ? k + i : i;
+		}
+
+		LuigiFecDecoder decoder(k, r);
+		ASSERT_TRUE(decoder.Decode(data.data(), index.data(), size));
+		for (uint32_t i = 0; i < k; i++) {
+			EXPECT_EQ(work[i], bufs[i]) << GfKernelName(kernel) << " pkt:" << i;
+		}
+	}
+}
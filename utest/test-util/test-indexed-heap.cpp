@@ -0,0 +1,220 @@
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/indexed-heap.h"
+
+using namespace jukey::util;
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Pop all items, keys must not decrease
+//------------------------------------------------------------------------------
+template <typename Heap>
+std::vector<uint64_t> PopAll(Heap& heap)
+{
+	std::vector<uint64_t> keys;
+	while (!heap.Empty()) {
+		keys.push_back(heap.TopKey());
+		heap.Pop();
+	}
+	return keys;
+}
+
+template <typename Heap>
+class IndexedHeapTest : public testing::Test
+{
+protected:
+	Heap m_heap;
+};
+
+typedef testing::Types<
+	IndexedHeap<uint32_t, std::string, 2>,
+	IndexedHeap<uint32_t, std::string, 4>,
+	IndexedHeap<uint32_t, std::string, 8>> HeapTypes;
+
+}
+
+TYPED_TEST_SUITE(IndexedHeapTest, HeapTypes);
+
+TYPED_TEST(IndexedHeapTest, PushPopOrder)
+{
+	const uint64_t keys[] = { 50, 10, 40, 10, 30, 70, 20, 60, 0, 90 };
+
+	for (uint32_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+		EXPECT_TRUE(this->m_heap.Push(i, keys[i], std::to_string(i)));
+	}
+	EXPECT_EQ(this->m_heap.Size(), 10u);
+
+	// Top value and ID belong to the top key
+	EXPECT_EQ(this->m_heap.TopKey(), 0u);
+	EXPECT_EQ(this->m_heap.TopId(), 8u);
+	EXPECT_EQ(this->m_heap.Top(), "8");
+
+	std::vector<uint64_t> popped = PopAll(this->m_heap);
+	std::vector<uint64_t> sorted(std::begin(keys), std::end(keys));
+	std::sort(sorted.begin(), sorted.end());
+	EXPECT_EQ(popped, sorted);
+	EXPECT_TRUE(this->m_heap.Empty());
+}
+
+TYPED_TEST(IndexedHeapTest, DuplicateId)
+{
+	EXPECT_TRUE(this->m_heap.Push(1, 100, "a"));
+	EXPECT_FALSE(this->m_heap.Push(1, 5, "b"));
+
+	uint64_t key = 0;
+	EXPECT_TRUE(this->m_heap.GetKey(1, key));
+	EXPECT_EQ(key, 100u);
+	EXPECT_EQ(this->m_heap.Top(), "a");
+	EXPECT_EQ(this->m_heap.Size(), 1u);
+}
+
+TYPED_TEST(IndexedHeapTest, UpdateByIndex)
+{
+	for (uint32_t i = 0; i < 20; i++) {
+		this->m_heap.Push(i, 100 + i * 10, std::to_string(i));
+	}
+
+	// Decrease key moves to top
+	EXPECT_TRUE(this->m_heap.Update(15, 1));
+	EXPECT_EQ(this->m_heap.TopId(), 15u);
+	EXPECT_EQ(this->m_heap.Top(), "15");
+
+	// Increase key of the top moves it down
+	EXPECT_TRUE(this->m_heap.Update(15, 1000));
+	EXPECT_EQ(this->m_heap.TopId(), 0u);
+
+	// Same key keeps position
+	EXPECT_TRUE(this->m_heap.Update(0, 100));
+	EXPECT_EQ(this->m_heap.TopId(), 0u);
+
+	uint64_t key = 0;
+	EXPECT_TRUE(this->m_heap.GetKey(15, key));
+	EXPECT_EQ(key, 1000u);
+
+	EXPECT_FALSE(this->m_heap.Update(99, 1));
+	EXPECT_FALSE(this->m_heap.GetKey(99, key));
+
+	std::vector<uint64_t> popped = PopAll(this->m_heap);
+	EXPECT_TRUE(std::is_sorted(popped.begin(), popped.end()));
+	EXPECT_EQ(popped.back(), 1000u);
+}
+
+TYPED_TEST(IndexedHeapTest, RemoveByIndex)
+{
+	for (uint32_t i = 0; i < 20; i++) {
+		this->m_heap.Push(i, (i * 7) % 20, std::to_string(i));
+	}
+
+	// Top, an inner node, the last node and a missing one
+	uint32_t top = this->m_heap.TopId();
+	EXPECT_TRUE(this->m_heap.Remove(top));
+	EXPECT_TRUE(this->m_heap.Remove(top == 5 ? 6 : 5));
+	EXPECT_TRUE(this->m_heap.Remove(19));
+	EXPECT_FALSE(this->m_heap.Remove(19));
+	EXPECT_FALSE(this->m_heap.Contains(19));
+	EXPECT_EQ(this->m_heap.Size(), 17u);
+
+	// Removed IDs can be pushed again
+	EXPECT_TRUE(this->m_heap.Push(19, 0, "19"));
+	EXPECT_EQ(this->m_heap.TopId(), 19u);
+
+	std::vector<uint64_t> popped = PopAll(this->m_heap);
+	EXPECT_EQ(popped.size(), 18u);
+	EXPECT_TRUE(std::is_sorted(popped.begin(), popped.end()));
+}
+
+TYPED_TEST(IndexedHeapTest, RandomOpsMatchModel)
+{
+	std::mt19937 rng(12345);
+
+	// ID -> key, and the ordered set of (key, ID)
+	std::map<uint32_t, uint64_t> keys;
+	std::set<std::pair<uint64_t, uint32_t>> ordered;
+
+	for (uint32_t round = 0; round < 20000; round++) {
+		uint32_t id = rng() % 500;
+		uint64_t key = rng() % 1000;
+
+		switch (rng() % 4) {
+		case 0: {
+			bool exists = keys.count(id) != 0;
+			EXPECT_EQ(this->m_heap.Push(id, key, std::to_string(id)), !exists);
+			if (!exists) {
+				keys[id] = key;
+				ordered.insert(std::make_pair(key, id));
+			}
+			break;
+		}
+		case 1: {
+			auto iter = keys.find(id);
+			EXPECT_EQ(this->m_heap.Update(id, key), iter != keys.end());
+			if (iter != keys.end()) {
+				ordered.erase(std::make_pair(iter->second, id));
+				ordered.insert(std::make_pair(key, id));
+				iter->second = key;
+			}
+			break;
+		}
+		case 2: {
+			auto iter = keys.find(id);
+			EXPECT_EQ(this->m_heap.Remove(id), iter != keys.end());
+			if (iter != keys.end()) {
+				ordered.erase(std::make_pair(iter->second, id));
+				keys.erase(iter);
+			}
+			break;
+		}
+		default:
+			if (!keys.empty()) {
+				// Equal keys may pop in any order
+				uint64_t top_key = this->m_heap.TopKey();
+				uint32_t top_id = this->m_heap.TopId();
+				ASSERT_EQ(top_key, ordered.begin()->first);
+				ASSERT_EQ(keys[top_id], top_key);
+				EXPECT_EQ(this->m_heap.Top(), std::to_string(top_id));
+
+				this->m_heap.Pop();
+				ordered.erase(std::make_pair(top_key, top_id));
+				keys.erase(top_id);
+			}
+			break;
+		}
+
+		ASSERT_EQ(this->m_heap.Size(), keys.size());
+	}
+
+	// Every remaining item is indexed with its current key
+	for (const auto& [id, key] : keys) {
+		uint64_t heap_key = 0;
+		ASSERT_TRUE(this->m_heap.GetKey(id, heap_key));
+		EXPECT_EQ(heap_key, key);
+	}
+
+	std::vector<uint64_t> popped = PopAll(this->m_heap);
+	std::vector<uint64_t> expected;
+	for (const auto& item : ordered) {
+		expected.push_back(item.first);
+	}
+	EXPECT_EQ(popped, expected);
+}
+
+TYPED_TEST(IndexedHeapTest, Clear)
+{
+	for (uint32_t i = 0; i < 10; i++) {
+		this->m_heap.Push(i, i, std::to_string(i));
+	}
+
+	this->m_heap.Clear();
+	EXPECT_TRUE(this->m_heap.Empty());
+	EXPECT_FALSE(this->m_heap.Contains(0));
+
+	EXPECT_TRUE(this->m_heap.Push(0, 5, "0"));
+	EXPECT_EQ(this->m_heap.TopKey(), 5u);
+}
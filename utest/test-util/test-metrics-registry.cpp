@@ -0,0 +1,225 @@
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "metrics-registry.h"
+#include "nlohmann/json.hpp"
+
+using namespace jukey::base;
+using namespace jukey::com;
+
+namespace
+{
+
+//==============================================================================
+// Registry only reports its object to the factory
+//==============================================================================
+class FakeFactory : public IComFactory
+{
+public:
+	virtual bool Init(const std::string& com_dir) override { return true; }
+	virtual IUnknown* CreateComponent(const std::string& cid,
+		const std::string& owner) override
+	{
+		return nullptr;
+	}
+	virtual void* QueryInterface(const std::string& cid, const std::string& iid,
+		const std::string& owner) override
+	{
+		return nullptr;
+	}
+	virtual void GetComponents(const std::string& iid,
+		std::vector<std::string>& cids) override {}
+	virtual void AddComObj(const ComObj& co) override {}
+	virtual void RemoveComObj(const std::string& oid) override {}
+	virtual std::vector<ComObj> GetComObjList(const std::string& cid) override
+	{
+		return {};
+	}
+};
+
+//==============================================================================
+// Collector thread is not started, Scrape collects by itself
+//==============================================================================
+class MetricsRegistryTest : public testing::Test
+{
+protected:
+	FakeFactory m_factory;
+	MetricsRegistry m_registry { &m_factory, "test" };
+};
+
+//------------------------------------------------------------------------------
+// Run func in count threads, each thread gets its own shard while count is not
+// larger than METRICS_SHARD_COUNT
+//------------------------------------------------------------------------------
+template<typename Func>
+void RunThreads(uint32_t count, Func func)
+{
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < count; i++) {
+		threads.emplace_back([func, i]() { func(i); });
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+}
+
+TEST_F(MetricsRegistryTest, ShardIndexPerThread)
+{
+	std::vector<uint32_t> indexes(METRICS_SHARD_COUNT);
+	RunThreads(METRICS_SHARD_COUNT, [&indexes](uint32_t i) {
+		indexes[i] = MetricsShardIndex();
+		EXPECT_EQ(indexes[i], MetricsShardIndex());
+	});
+
+	// Round robin assignment, consecutive threads never share a shard
+	std::set<uint32_t> unique(indexes.begin(), indexes.end());
+	EXPECT_EQ(unique.size(), (size_t)METRICS_SHARD_COUNT);
+	for (auto index : indexes) {
+		EXPECT_LT(index, (uint32_t)METRICS_SHARD_COUNT);
+	}
+}
+
+TEST_F(MetricsRegistryTest, CounterShardAggregation)
+{
+	CounterSP counter = m_registry.AddCounter("requests", "", {});
+
+	const uint32_t kThreads = METRICS_SHARD_COUNT * 2;
+	const uint32_t kAdds = 10000;
+	RunThreads(kThreads, [&counter](uint32_t i) {
+		for (uint32_t j = 0; j < kAdds; j++) {
+			counter->Add();
+		}
+		counter->Add(i);
+	});
+
+	uint64_t expected = (uint64_t)kThreads * kAdds
+		+ (uint64_t)kThreads * (kThreads - 1) / 2;
+	EXPECT_EQ(counter->Value(), expected);
+	EXPECT_EQ(m_registry.Scrape(MetricsFormat::METRICS_FORMAT_PROMETHEUS),
+		"# TYPE requests counter\nrequests " + std::to_string(expected) + "\n");
+}
+
+TEST_F(MetricsRegistryTest, HistogramShardAggregation)
+{
+	HistogramSP histogram = m_registry.AddHistogram("delay", "", {},
+		{ 100, 10 }); // sorted on creation
+
+	const uint32_t kThreads = METRICS_SHARD_COUNT;
+	RunThreads(kThreads, [&histogram](uint32_t i) {
+		histogram->Observe(5);   // le 10
+		histogram->Observe(10);  // le 10
+		histogram->Observe(50);  // le 100
+		histogram->Observe(500); // +Inf
+	});
+
+	ASSERT_EQ(histogram->Bounds(), std::vector<uint64_t>({ 10, 100 }));
+	EXPECT_EQ(histogram->Count(), kThreads * 4);
+	EXPECT_EQ(histogram->Sum(), kThreads * 565);
+	EXPECT_EQ(histogram->BucketValue(0), kThreads * 2);
+	EXPECT_EQ(histogram->BucketValue(1), kThreads);
+	EXPECT_EQ(histogram->BucketValue(2), kThreads);
+
+	// Buckets are cumulative in scrape output
+	std::string expected =
+		"# TYPE delay histogram\n"
+		"delay_bucket{le=\"10\"} 32\n"
+		"delay_bucket{le=\"100\"} 48\n"
+		"delay_bucket{le=\"+Inf\"} 64\n"
+		"delay_sum 9040\n"
+		"delay_count 64\n";
+	EXPECT_EQ(m_registry.Scrape(MetricsFormat::METRICS_FORMAT_PROMETHEUS),
+		expected);
+}
+
+TEST_F(MetricsRegistryTest, PrometheusFormat)
+{
+	CounterSP sent = m_registry.AddCounter("net.sent-bytes", "Bytes sent",
+		{ { "dir", "up" }, { "peer-id", "a\"b\\c\nd" } });
+	sent->Add(3);
+
+	GaugeSP sessions = m_registry.AddGauge("sessions", "Active sessions",
+		{ { "shard", "1" } });
+	sessions->Set(7);
+	sessions->Add(-2);
+
+	GaugeSP sessions0 = m_registry.AddGauge("sessions", "Active sessions",
+		{ { "shard", "0" } });
+	sessions0->Set(-4);
+
+	HistogramSP rtt = m_registry.AddHistogram("rtt", "Line1\nLine2", {}, {});
+	rtt->Observe(30);
+
+	// Families sorted by name, series by labels, names and label names are
+	// sanitized, label values and help are escaped
+	std::string expected =
+		"# HELP net_sent_bytes Bytes sent\n"
+		"# TYPE net_sent_bytes counter\n"
+		"net_sent_bytes{dir=\"up\",peer_id=\"a\\\"b\\\\c\\nd\"} 3\n"
+		"# HELP rtt Line1\\nLine2\n"
+		"# TYPE rtt histogram\n"
+		"rtt_bucket{le=\"+Inf\"} 1\n"
+		"rtt_sum 30\n"
+		"rtt_count 1\n"
+		"# HELP sessions Active sessions\n"
+		"# TYPE sessions gauge\n"
+		"sessions{shard=\"0\"} -4\n"
+		"sessions{shard=\"1\"} 5\n";
+	EXPECT_EQ(m_registry.Scrape(MetricsFormat::METRICS_FORMAT_PROMETHEUS),
+		expected);
+}
+
+TEST_F(MetricsRegistryTest, JsonFormat)
+{
+	CounterSP counter = m_registry.AddCounter("frames", "", { { "mt", "video" } });
+	counter->Add(9);
+
+	HistogramSP histogram = m_registry.AddHistogram("jitter", "", {}, { 20 });
+	histogram->Observe(10);
+	histogram->Observe(30);
+
+	nlohmann::json metrics = nlohmann::json::parse(
+		m_registry.Scrape(MetricsFormat::METRICS_FORMAT_JSON));
+	ASSERT_TRUE(metrics.is_array());
+	ASSERT_EQ(metrics.size(), 2u);
+
+	EXPECT_EQ(metrics[0]["name"], "frames");
+	EXPECT_EQ(metrics[0]["type"], "counter");
+	EXPECT_EQ(metrics[0]["labels"]["mt"], "video");
+	EXPECT_EQ(metrics[0]["value"], 9);
+
+	EXPECT_EQ(metrics[1]["name"], "jitter");
+	EXPECT_EQ(metrics[1]["type"], "histogram");
+	EXPECT_EQ(metrics[1]["count"], 2);
+	EXPECT_EQ(metrics[1]["sum"], 40);
+	ASSERT_EQ(metrics[1]["buckets"].size(), 2u);
+	EXPECT_EQ(metrics[1]["buckets"][0]["le"], 20);
+	EXPECT_EQ(metrics[1]["buckets"][0]["count"], 1);
+	EXPECT_EQ(metrics[1]["buckets"][1]["le"], "+Inf");
+	EXPECT_EQ(metrics[1]["buckets"][1]["count"], 2);
+}
+
+TEST_F(MetricsRegistryTest, MergeAndRemove)
+{
+	CounterSP first = m_registry.AddCounter("drops", "", { { "reason", "late" } });
+	CounterSP second = m_registry.AddCounter("drops", "", { { "reason", "late" } });
+	first->Add(2);
+	second->Add(5);
+
+	// Same name and labels are one series
+	EXPECT_EQ(m_registry.Scrape(MetricsFormat::METRICS_FORMAT_PROMETHEUS),
+		"# TYPE drops counter\ndrops{reason=\"late\"} 7\n");
+
+	// Removed metric can still be updated, but is no longer collected
+	m_registry.RemoveMetric(first);
+	first->Add(100);
+	EXPECT_EQ(m_registry.Scrape(MetricsFormat::METRICS_FORMAT_PROMETHEUS),
+		"# TYPE drops counter\ndrops{reason=\"late\"} 5\n");
+
+	m_registry.RemoveMetric(second);
+	EXPECT_EQ(m_registry.Scrape(MetricsFormat::METRICS_FORMAT_PROMETHEUS), "");
+}